@@ -0,0 +1,115 @@
+#ifndef JWEB_HTTP_PARSER_H
+#define JWEB_HTTP_PARSER_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+/**
+ * Incremental HTTP/1.x request parser used by the server core.
+ *
+ * The head is parsed without copying: the request line and the headers
+ * are recorded as slices of the caller's buffer. A caller reading from a
+ * socket calls http_parse_head again whenever more bytes arrive, and the
+ * search for the end of the head resumes where the last call stopped.
+ * The body is then fed through an HttpBody, which decodes Content-Length
+ * and chunked transfer coding as the bytes come in and keeps the decoded
+ * body in memory, or in a temporary file once it outgrows HTTP_BODY_MEMORY.
+ */
+
+#define HTTP_MAX_HEADERS 64
+#define HTTP_BODY_MEMORY (1024 * 1024)
+
+/**
+ * @typedef @struct HTTPSLICE
+ * Bytes of the buffer a head was parsed from, as an offset so the buffer
+ * may move.
+ */
+typedef struct {
+    uint32_t offset;
+    uint32_t length;
+} HttpSlice;
+
+typedef struct {
+    HttpSlice name;
+    HttpSlice value;
+} HttpHeader;
+
+/**
+ * @typedef @struct HTTPHEAD
+ * Request line and headers of one request.
+ */
+typedef struct HttpHead {
+    HttpSlice method;
+    HttpSlice target;
+    int minor_version;          // 0 for HTTP/1.0, 1 for HTTP/1.1
+    HttpHeader headers[HTTP_MAX_HEADERS];
+    int header_count;
+    long content_length;        // -1 without a Content-Length header
+    bool chunked;
+    bool keep_alive;
+    bool expect_continue;       // the client waits for "100 Continue" before sending the body
+} HttpHead;
+
+/**
+ * Parses the head at the start of buf once all of it has arrived.
+ * @param scanned How far earlier calls have searched for the end of the
+ *        head; start at 0 and keep it until the head is complete.
+ * @param max_length Longest head accepted.
+ * @return The head's length in bytes, 0 if it is incomplete, or a negative
+ *         HTTP status (-400, -431, -501) if it is malformed.
+ */
+long http_parse_head(HttpHead* head, const char* buf, size_t length, size_t* scanned, size_t max_length);
+
+/**
+ * Looks a header up by name, ignoring case.
+ * @return The header's value, or NULL.
+ */
+const HttpSlice* http_head_find(const HttpHead* head, const char* buf, const char* name);
+
+typedef enum {
+    HTTP_BODY_LENGTH,
+    HTTP_BODY_CHUNK_SIZE,
+    HTTP_BODY_CHUNK_EXTENSION,
+    HTTP_BODY_CHUNK_DATA,
+    HTTP_BODY_CHUNK_END,
+    HTTP_BODY_TRAILER,
+    HTTP_BODY_DONE
+} HttpBodyState;
+
+/**
+ * @typedef @struct HTTPBODY
+ * Decoder and storage for a request body.
+ */
+typedef struct HttpBody {
+    HttpBodyState state;
+    size_t remaining;           // bytes left of the body, or of the current chunk
+    size_t size;                // decoded bytes so far
+    size_t limit;               // largest body accepted
+    bool line_empty;            // no bytes yet on the current trailer line
+    char* data;                 // the body while it fits in memory
+    size_t capacity;
+    FILE* file;                 // the body once it has been moved to a temporary file
+} HttpBody;
+
+/**
+ * Prepares body for the request described by head.
+ * @param limit Largest body accepted, after decoding.
+ */
+void http_body_init(HttpBody* body, const HttpHead* head, size_t limit);
+
+/**
+ * Decodes as much of data as belongs to the body.
+ * @return Bytes consumed; the rest belongs to the next request once
+ *         body->state is HTTP_BODY_DONE. A negative HTTP status (-400,
+ *         -413, -500) if the body is malformed or too large.
+ */
+long http_body_feed(HttpBody* body, const char* data, size_t length);
+
+/**
+ * Releases the body's memory and closes its file.
+ */
+void http_body_free(HttpBody* body);
+
+#endif
@@ -6,6 +6,21 @@
 #include "value.h"
 #include "eval.h"
 
+/**
+ * Listening socket opened by __listen__, or -1.
+ */
+extern int global_server_fd;
+
+/**
+ * Adds the key=value pairs of a query string to map. Modifies query_string.
+ */
+void parse_query_params(HashMap* map, char* query_string);
+
+/**
+ * Content-Type for a file, from its extension.
+ */
+const char* get_mime_type(const char* filename);
+
 void register_jweb_natives(Env* env);
 
 
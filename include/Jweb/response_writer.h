@@ -0,0 +1,95 @@
+#ifndef JWEB_RESPONSE_WRITER_H
+#define JWEB_RESPONSE_WRITER_H
+
+#include "common.h"
+#include "env.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <sys/uio.h>
+
+/**
+ * Streaming response bodies behind __write__, __flush__ and __end__.
+ *
+ * A writer sends the response head on its first flush and the body as
+ * HTTP/1.1 chunks, so a handler can produce a large export piece by piece
+ * without holding all of it. Small writes are gathered into a buffer of
+ * RESPONSE_WRITER_BUFFER bytes; the head, the chunk framing and the data
+ * leave in one writev. A body that is complete before the buffer first
+ * fills goes out with a Content-Length instead.
+ *
+ * Bytes go to a sink. For __accept__ requests the sink is the blocking
+ * socket itself, so a full socket buffer holds the handler up. For
+ * __serve__ requests the I/O thread does the sending and the handler waits
+ * once too much of its output is still unsent.
+ */
+
+#define RESPONSE_WRITER_BUFFER 16384
+
+/**
+ * Takes the bytes described by iov in order.
+ * @return false once nothing more can be sent (the client is gone).
+ */
+typedef bool (*ResponseSink)(void* ctx, struct iovec* iov, int count);
+
+/**
+ * @typedef @struct RESPONSEWRITER
+ * One streamed response.
+ */
+typedef struct ResponseWriter {
+    ResponseSink sink;
+    void* ctx;
+    int status;
+    char content_type[128];
+    bool chunked;               // false for HTTP/1.0 clients: the body ends when the connection does
+    bool keep_alive;
+    bool head_only;             // a HEAD request: the head without the body
+    bool head_sent;
+    bool ended;
+    bool failed;
+    char* buffer;               // body bytes not yet sent
+    size_t length;
+    size_t capacity;
+} ResponseWriter;
+
+/**
+ * Reason phrase for a status code.
+ */
+const char* http_status_text(int status);
+
+/**
+ * Writes every byte described by iov to a blocking socket, resuming after
+ * partial writes.
+ * @return false if the socket failed or timed out first.
+ */
+bool http_send_iov(int socket, struct iovec* iov, int count);
+
+ResponseWriter* response_writer_new(ResponseSink sink, void* ctx, bool chunked, bool keep_alive, bool head_only);
+
+void response_writer_free(ResponseWriter* w);
+
+/**
+ * Sets the status and Content-Type.
+ * @return false if the head has already been sent.
+ */
+bool response_writer_status(ResponseWriter* w, int status, const char* content_type);
+
+/**
+ * Adds to the body. Sends once RESPONSE_WRITER_BUFFER bytes are waiting.
+ * @return false once the client is gone or the response has ended.
+ */
+bool response_writer_write(ResponseWriter* w, const char* data, size_t length);
+
+/**
+ * Sends the head, if it has not gone yet, and whatever body is waiting.
+ */
+bool response_writer_flush(ResponseWriter* w);
+
+/**
+ * Sends what is left and finishes the body.
+ */
+bool response_writer_end(ResponseWriter* w);
+
+void register_jweb_writer_natives(Env* env);
+
+#endif
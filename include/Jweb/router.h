@@ -0,0 +1,23 @@
+#ifndef JWEB_ROUTER_H
+#define JWEB_ROUTER_H
+
+#include "common.h"
+#include "env.h"
+
+/**
+ * Radix-trie router behind std.http.Router.
+ *
+ * Patterns are compiled into the trie when they are added: static text is
+ * stored as compressed edges, "{name}" matches one path segment and
+ * "{name*}" or a trailing "*" matches the rest of the path. A lookup walks
+ * the path once, trying static edges before parameters before wildcards,
+ * and only allocates for the parameters of the route it finds. Captures
+ * are named per route, so "/users/{id}" and "/users/{uid}" can coexist.
+ *
+ * Routers are referred to from Jackal by a number and live as long as the
+ * process. Lookups may run on several threads at once.
+ */
+
+void register_jweb_router_natives(Env* env);
+
+#endif
@@ -0,0 +1,59 @@
+#ifndef JWEB_SERVER_H
+#define JWEB_SERVER_H
+
+#include "common.h"
+#include "env.h"
+#include "Jweb/http_parser.h"
+#include "Jweb/response_writer.h"
+
+/**
+ * Event-driven HTTP/1.1 server core behind __serve__.
+ *
+ * One thread owns every connection: the listening socket and the clients
+ * are non-blocking and watched by an epoll instance (clients edge-triggered).
+ * Bytes are read into a per-connection buffer and run through the
+ * incremental parser in http_parser.h as they arrive.
+ * Each request is handed to the handler on the task pool's fixed set of
+ * workers; the response comes back through an eventfd and is written out
+ * by the I/O thread. Connections are kept alive per HTTP/1.1, and pipelined
+ * requests are answered in order, one at a time per connection.
+ * Handlers allocate on the workers, where the collector cannot run, so the
+ * I/O thread collects for them whenever every handler in flight is parked
+ * in a blocking wait (sleep, I/O, streaming back-pressure; see
+ * gc_blocking_begin). Once a collection is due, new requests wait for such
+ * a moment, but only briefly: handlers that keep computing do not stall
+ * the others.
+ *
+ * The epoll instance is itself waited on through the event loop, so
+ * __serve__ called from an @async function leaves other fibers running.
+ */
+
+/**
+ * Builds the request map handlers receive: method, path, query, headers,
+ * address, params and body. A JSON body is parsed; a body that was moved
+ * to a temporary file is passed as that file, open for reading.
+ * @param buf The buffer head was parsed from.
+ */
+Value http_request_map(const HttpHead* head, const char* buf, HttpBody* body, const char* address);
+
+/**
+ * Answers the request the calling worker is handling with a file instead
+ * of the handler's return value. The I/O thread sends it with sendfile,
+ * honouring the request's conditional and Range headers.
+ * @return false if the file does not exist (the response becomes a 404) or
+ *         the thread is not running a __serve__ handler.
+ */
+bool http_job_send_file(const char* path);
+
+/**
+ * Writer for streaming the response of the request the calling worker is
+ * handling. Once a handler has one, what it returns is not sent.
+ * @param create Make the writer if the handler has none yet.
+ * @return The writer, or NULL if there is none or the thread is not
+ *         running a __serve__ handler.
+ */
+ResponseWriter* http_job_writer(bool create);
+
+void register_jweb_server_natives(Env* env);
+
+#endif
@@ -0,0 +1,93 @@
+#ifndef JWEB_STATIC_FILE_H
+#define JWEB_STATIC_FILE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <sys/types.h>
+#include <time.h>
+
+/**
+ * Open-file cache for static assets.
+ *
+ * Files are kept open in a least-recently-used cache of STATIC_CACHE_SIZE
+ * entries, together with their stat metadata and the part of the response
+ * head that only depends on the file (type, length, ETag, Last-Modified).
+ * An entry is checked against the file system at most once every
+ * STATIC_CACHE_VALID seconds, so a hot asset costs no open, stat or close.
+ * The body is meant to be sent with sendfile straight from the cached
+ * descriptor.
+ */
+
+#define STATIC_CACHE_SIZE 256
+#define STATIC_CACHE_VALID 1
+
+/**
+ * @typedef @struct STATICFILE
+ * A cached open file. Shared between requests and reference counted.
+ */
+typedef struct StaticFile {
+    char* path;
+    int fd;
+    off_t size;
+    time_t mtime;
+    dev_t dev;
+    ino_t ino;
+    time_t checked;             // when the file was last stat'ed
+    char etag[48];
+    char last_modified[40];
+    char* headers;              // Content-Type, ETag, Last-Modified and Accept-Ranges lines
+    size_t headers_len;
+    int refs;                   // the cache's own reference plus one per user
+    bool cached;
+    struct StaticFile* prev;    // least recently used order, newest first
+    struct StaticFile* next;
+    struct StaticFile* chain;   // next entry in the same hash bucket
+} StaticFile;
+
+/**
+ * @typedef @struct STATICREQUEST
+ * The parts of a request that decide how a file is sent. Header values are
+ * NULL when the request does not have them.
+ */
+typedef struct {
+    const char* if_none_match;
+    const char* if_modified_since;
+    const char* range;
+    const char* if_range;
+    bool head_only;             // a HEAD request: the head without the body
+    bool keep_alive;
+} StaticRequest;
+
+/**
+ * Opens a regular file through the cache.
+ * @return The file, to be given back with static_file_release, or NULL if
+ *         it does not exist or is not a regular file.
+ */
+StaticFile* static_file_open(const char* path);
+
+/**
+ * Gives back a file from static_file_open.
+ */
+void static_file_release(StaticFile* file);
+
+/**
+ * Works out the response to a request for file: 200, 206 for a
+ * satisfiable single Range, 304 when the conditional headers show the
+ * client's copy is current, or 416 for a range past the end.
+ * @param head Receives the response head.
+ * @param head_len Receives the head's length.
+ * @param offset Receives where in the file the body starts.
+ * @param length Receives how many bytes of the file follow the head.
+ * @return The status code.
+ */
+int static_file_respond(const StaticFile* file, const StaticRequest* req, char* head, size_t capacity,
+                        size_t* head_len, off_t* offset, off_t* length);
+
+/**
+ * Sends length bytes of file from offset with sendfile, advancing offset.
+ * @return Bytes sent, or -1 with errno set (EAGAIN on a full non-blocking
+ *         socket).
+ */
+ssize_t static_file_send(int socket, const StaticFile* file, off_t* offset, size_t length);
+
+#endif
@@ -0,0 +1,29 @@
+#ifndef JWEB_TEMPLATE_H
+#define JWEB_TEMPLATE_H
+
+#include "value.h"
+
+/**
+ * Compiled templates behind __render_file__.
+ *
+ * A template file is compiled once into a flat list of instructions:
+ * literal spans, {{name}} and {{name.key}} lookups, @for, @if/@else,
+ * @while and @component blocks. @extends/@yield/@stack and @include are
+ * resolved while compiling, so the layout, the included files and the
+ * components all become part of the one list.
+ *
+ * Compiled templates are cached by path. Every file a template was built
+ * from is stat'ed on each render and the template is compiled again when
+ * one of them has changed. Rendering walks the instructions once and
+ * appends to a single growing buffer.
+ */
+
+/**
+ * Renders the template file at path.
+ * @param data Values for the placeholders, loops and conditions, or NULL.
+ * @param length Receives the length of the result.
+ * @return A malloc'd string, or NULL if the file cannot be read.
+ */
+char* template_render_file(const char* path, HashMap* data, size_t* length);
+
+#endif
@@ -0,0 +1,131 @@
+#ifndef ASYNC_H
+#define ASYNC_H
+
+#include "common.h"
+#include <stdbool.h>
+
+/**
+ * Single-threaded event loop behind @async functions and await.
+ *
+ * Calling an @async function starts a fiber (a coroutine with its own C
+ * stack) and returns a promise right away. The fiber runs on the main
+ * thread whenever the loop gets control: when the main program awaits,
+ * sleeps or blocks on a socket, and after the script has finished. Inside
+ * a fiber, await, sleeps and socket I/O suspend only that fiber; timers
+ * live in a min-heap and file descriptors are watched with epoll, so one
+ * process can keep thousands of operations in flight without a thread each.
+ *
+ * Outside the loop thread (e.g. in a @parallel task) these calls fall back
+ * to plain blocking behaviour.
+ */
+
+typedef enum {
+    PROMISE_PENDING,
+    PROMISE_FULFILLED,
+    PROMISE_REJECTED
+} PromiseState;
+
+struct Fiber;
+
+/**
+ * @typedef @struct PROMISE
+ * Result of an @async call or an asynchronous native. A managed object
+ * (GC_PROMISE).
+ */
+typedef struct Promise {
+    PromiseState state;
+    Value value;                // result, or the thrown value once rejected
+    struct Fiber* waiters;      // fibers suspended in await on this promise
+} Promise;
+
+typedef enum {
+    ASYNC_READ = 1,
+    ASYNC_WRITE = 2
+} AsyncEvents;
+
+/**
+ * @typedef ASYNCIOCALLBACK
+ * Called from the loop when a watched descriptor is ready.
+ * @param events The ASYNC_READ / ASYNC_WRITE bits that are ready.
+ */
+typedef void (*AsyncIoCallback)(void* ctx, int fd, int events);
+
+/**
+ * @typedef ASYNCTIMERCALLBACK
+ * Called from the loop when a timer is due.
+ */
+typedef void (*AsyncTimerCallback)(void* ctx);
+
+typedef struct AsyncTimer AsyncTimer;
+
+/**
+ * Starts a call of an @async function in a new fiber.
+ * @param func A VAL_FUNCTION value; copied, like the arguments.
+ * @param arg_count Number of arguments.
+ * @param args The evaluated arguments; they are copied, not consumed.
+ * @return A VAL_PROMISE value settled with the call's result.
+ */
+Value async_spawn(Value func, int arg_count, Value* args);
+
+/**
+ * Makes a pending promise. Settle it with promise_resolve or promise_reject.
+ */
+Promise* promise_new(void);
+void promise_resolve(Promise* promise, Value value);
+void promise_reject(Promise* promise, Value error);
+
+/**
+ * The await expression. Waits for a promise or a task, letting other fibers
+ * run meanwhile, and returns its result; a rejected promise rethrows its
+ * error. Any other value is returned as is.
+ */
+Value async_await(Value value);
+
+/**
+ * Sleeps without blocking other fibers. Backs __jackal_sleep, so every and
+ * observe loops cooperate with the event loop.
+ */
+void async_sleep_ms(double ms);
+
+/**
+ * Waits until fd is ready for the given ASYNC_READ / ASYNC_WRITE events.
+ * Suspends the calling fiber; the main program runs the loop until then,
+ * or simply polls fd when the loop has nothing else to do.
+ * @param timeout_ms Give up after this long; negative waits forever.
+ * @return false if the wait timed out.
+ */
+bool async_wait_fd(int fd, int events, int timeout_ms);
+
+/**
+ * Calls cb whenever fd is ready for events. Replaces the previous watch of
+ * fd; events 0 removes it.
+ * @return false if fd cannot be watched, e.g. a regular file.
+ */
+bool async_watch(int fd, int events, AsyncIoCallback cb, void* ctx);
+
+/**
+ * Calls cb once after ms milliseconds.
+ * @return A handle for async_timer_cancel, valid until the callback runs.
+ */
+AsyncTimer* async_timer_start(double ms, AsyncTimerCallback cb, void* ctx);
+void async_timer_cancel(AsyncTimer* timer);
+
+/**
+ * Whether the calling thread runs the event loop. Elsewhere promises are
+ * settled synchronously.
+ */
+bool async_loop_thread(void);
+
+/**
+ * Runs the loop until no fiber is ready and no timer or watch is pending.
+ * Called once the main program has finished.
+ */
+void async_run(void);
+
+/**
+ * Registers the loop's natives (__async_sleep) and promise methods.
+ * Must be called on the thread that runs the loop.
+ */
+void register_async_natives(struct Env* env);
+
+#endif
@@ -13,6 +13,7 @@
 #include <stdbool.h>
 #include <stdarg.h>
 #include <stddef.h>
+#include <stdint.h>
 
 #define DEBUG_TRACE_EXECUTION 1
 
@@ -136,6 +137,7 @@ typedef enum {
 struct Node;
 struct Env;
 struct Value;
+struct Shape;
 
 
 /**
@@ -225,6 +227,7 @@ typedef struct Func {
     bool is_async;
     bool is_final;
     bool is_extension;
+    struct Chunk* chunk; // compiled body when the VM created the function, NULL otherwise
 } Func;
 
 struct Value;
@@ -251,6 +254,7 @@ struct Class {
     Interface* interface;  
     char type_name[64];
     bool is_record;  
+    struct Shape* shape; // field layout of a new instance, see shape.h
 };
 
 /**
@@ -277,7 +281,9 @@ struct Interface {
  */
 typedef struct {
     struct Value* class_val;
-    struct Env* fields;
+    struct Shape* shape;  // which field is in which slot
+    struct Value* fields; // shape->slot_count values
+    int field_capacity;
     struct {
         char names[10][64]; // Maksimal 10 parameter generic (K, V, T, dst)
         int count;
@@ -310,46 +316,239 @@ typedef enum {
     VAL_STRUCT_INSTANCE ,
     VAL_NAMESPACE,
     VAL_BOOL,
-    VAL_BYTE 
+    VAL_BYTE,
+    VAL_TASK,
+    VAL_PROMISE,
+    VAL_DATAFRAME,
+    VAL_CSV_CURSOR,
+    VAL_CSV_WRITER
 } ValueType;
 
+/**
+ * @typedef @struct GCOBJECT
+ * Header in front of every object the collector manages (see gc.h).
+ * The payload starts right after it.
+ */
 typedef struct GCObject {
-    bool is_marked;
     struct GCObject* next;
+    struct GCObject* prev;
+    size_t size;
+    uint8_t kind;
+    bool is_marked;
 } GCObject;
 
+/**
+ * @typedef @struct OBJSTRING
+ * Immutable managed string (see string_object.h). A string Value's
+ * payload points at chars, so it still reads as a C string.
+ */
+typedef struct ObjString {
+    uint32_t length;
+    uint32_t hash;
+    bool is_interned;
+    bool is_pinned;     // never collected: identifiers and literals held by the AST or chunks
+    char chars[];
+} ObjString;
+
+/**
+ * @typedef @union VALUEPAYLOAD
+ * The data half of a Value, one member per kind of value. A string's
+ * string always points into a managed ObjString (string_object), so the
+ * Value needs no flag for it.
+ */
+typedef union ValuePayload {
+    bool boolean;
+    unsigned char byte;
+    double number;
+    char* string;
+    Func* function;
+    struct Value* return_val;
+    ValueArray* array;
+    Class* class_obj;
+    Instance* instance;
+    NativeFn native;
+    struct HashMap* map;
+    Interface* interface_obj;
+    LinkedList* list;
+    Enum* enum_obj;
+    FILE* file;
+    StructDefinition *struct_def;
+    StructInstance *struct_instance;
+    struct Env* env;
+    struct Task* task;
+    struct Promise* promise;
+    struct DataFrame* frame;
+    struct CsvCursor* cursor;
+    struct CsvWriter* csv_writer;
+    void* pointer;
+    uint64_t bits;
+} ValuePayload;
+
+#ifdef JACKAL_NAN_BOXING
+
+#if !defined(__x86_64__) || __BYTE_ORDER__ != __ORDER_LITTLE_ENDIAN__
+#error "JACKAL_NAN_BOXING needs x86-64: pointers are packed into the 47 bits below the tag"
+#endif
+
 /**
  * @typedef @struct VALUE
  * Represents a value in the Jackal programming language.
+ * NaN-boxed into 8 bytes. A number is stored as its own IEEE double (NaNs
+ * are canonicalized); anything else is a quiet NaN whose sign bit and bits
+ * 47-50 hold the type + 1 and whose low 47 bits hold the payload. The word
+ * is kept XORed with the nil encoding, so zeroed memory reads as nil just
+ * like the tagged union. Only the accessors below may look inside.
+ */
+typedef struct Value {
+    uint64_t bits;
+} Value;
+
+#define VALUE_QNAN          0x7ff8000000000000ULL
+#define VALUE_SIGN          0x8000000000000000ULL
+#define VALUE_TAG_BITS      (VALUE_SIGN | 0x0007800000000000ULL)
+#define VALUE_PAYLOAD_BITS  0x00007fffffffffffULL
+#define VALUE_TAG(type)     ((((uint64_t)(type) + 1) & 15) << 47 | (((uint64_t)(type) + 1) >> 4) << 63)
+#define VALUE_NIL_BITS      (VALUE_QNAN | VALUE_TAG(VAL_NIL))
+
+static inline Value value_from_bits(uint64_t raw) {
+    return (Value){raw ^ VALUE_NIL_BITS};
+}
+
+static inline uint64_t value_raw(Value value) {
+    return value.bits ^ VALUE_NIL_BITS;
+}
+
+static inline bool value_is_boxed(uint64_t raw) {
+    return (raw & VALUE_QNAN) == VALUE_QNAN && (raw & VALUE_TAG_BITS) != 0;
+}
+
+static inline ValueType value_type(Value value) {
+    uint64_t raw = value_raw(value);
+    if (!value_is_boxed(raw)) return VAL_NUMBER;
+    return (ValueType)((((raw >> 47) & 15) | (raw >> 63) << 4) - 1);
+}
+
+static inline ValuePayload value_payload(Value value) {
+    uint64_t raw = value_raw(value);
+    ValuePayload payload;
+    payload.bits = value_is_boxed(raw) ? raw & VALUE_PAYLOAD_BITS : raw;
+    return payload;
+}
+
+static inline Value value_number(double number) {
+    ValuePayload payload = {.number = number};
+    return value_from_bits(number != number ? VALUE_QNAN : payload.bits);
+}
+
+static inline Value value_box(ValueType type, ValuePayload payload) {
+    if (type == VAL_NUMBER) return value_number(payload.number);
+    uint64_t data = type == VAL_BOOL ? payload.boolean
+                  : type == VAL_BYTE ? payload.byte
+                  : payload.bits & VALUE_PAYLOAD_BITS;
+    return value_from_bits(VALUE_QNAN | VALUE_TAG(type) | data);
+}
+
+#define VALUE_TYPE(value)               value_type(value)
+#define VALUE_PAYLOAD(value)            value_payload(value)
+#define MAKE_VALUE(tag, field, data)    value_box((tag), (ValuePayload){.field = (data)})
+#define NIL_VAL                         ((Value){0})
+#define NUMBER_VAL(n)                   value_number(n)
+
+#else
+
+/**
+ * @typedef @struct VALUE
+ * Represents a value in the Jackal programming language.
+ * A tag plus one 8-byte payload: 16 bytes per array element, map entry,
+ * variable and VM stack slot. Build with -DJACKAL_NAN_BOXING for the
+ * 8-byte encoding; code outside this header only uses the accessors
+ * below, so it compiles unchanged against either layout.
  */
 typedef struct Value {
     ValueType type;
-    union {
-        bool boolean;
-        unsigned char byte;
-        double number;
-        char* string;
-        Func* function;
-        struct Value* return_val;
-        ValueArray* array;
-        Class* class_obj;
-        Instance* instance;
-        NativeFn native;
-        struct HashMap* map;
-        Interface* interface_obj;
-        LinkedList* list;
-        Enum* enum_obj;
-        FILE* file;
-        StructDefinition *struct_def;       
-        StructInstance *struct_instance;
-        struct Env* env;
-        void* pointer;
-        
-    } as;
-    struct GCObject* gc_info;
+    ValuePayload as;
 } Value;
 
-extern GCObject* head ;
+#define VALUE_TYPE(value)               ((value).type)
+#define VALUE_PAYLOAD(value)            ((value).as)
+#define MAKE_VALUE(tag, field, data)    ((Value){(tag), {.field = (data)}})
+#define NIL_VAL                         ((Value){VAL_NIL, {.number = 0}})
+#define NUMBER_VAL(n)                   ((Value){VAL_NUMBER, {.number = (n)}})
+
+#endif
+
+/**
+ * Value accessors. Everything outside this header goes through these
+ * rather than the layout, so checks and representation changes stay in
+ * one place. Build with -DJACKAL_CHECKED_VALUES to make every AS_* verify
+ * the tag and report the call site on a mismatch.
+ */
+#define IS_NIL(value)       (VALUE_TYPE(value) == VAL_NIL)
+#define IS_BOOL(value)      (VALUE_TYPE(value) == VAL_BOOL)
+#define IS_NUMBER(value)    (VALUE_TYPE(value) == VAL_NUMBER)
+#define IS_STRING(value)    (VALUE_TYPE(value) == VAL_STRING)
+#define IS_FUNCTION(value)  (VALUE_TYPE(value) == VAL_FUNCTION)
+#define IS_NATIVE(value)    (VALUE_TYPE(value) == VAL_NATIVE)
+#define IS_ARRAY(value)     (VALUE_TYPE(value) == VAL_ARRAY)
+#define IS_MAP(value)       (VALUE_TYPE(value) == VAL_MAP)
+#define IS_CLASS(value)     (VALUE_TYPE(value) == VAL_CLASS)
+#define IS_INSTANCE(value)  (VALUE_TYPE(value) == VAL_INSTANCE)
+#define IS_RETURN(value)    (VALUE_TYPE(value) == VAL_RETURN)
+#define IS_TASK(value)      (VALUE_TYPE(value) == VAL_TASK)
+#define IS_PROMISE(value)   (VALUE_TYPE(value) == VAL_PROMISE)
+#define IS_DATAFRAME(value) (VALUE_TYPE(value) == VAL_DATAFRAME)
+
+#ifdef JACKAL_CHECKED_VALUES
+void value_type_mismatch(ValueType expected, ValueType actual, const char* file, int line);
+#define VALUE_AS(value, tag, field)                                                 \
+    (__extension__({                                                                \
+        Value checked_ = (value);                                                   \
+        if (VALUE_TYPE(checked_) != (tag))                                          \
+            value_type_mismatch((tag), VALUE_TYPE(checked_), __FILE__, __LINE__);   \
+        VALUE_PAYLOAD(checked_).field;                                              \
+    }))
+#else
+#define VALUE_AS(value, tag, field) (VALUE_PAYLOAD(value).field)
+#endif
+
+#define AS_BOOL(value)            VALUE_AS(value, VAL_BOOL, boolean)
+#define AS_BYTE(value)            VALUE_AS(value, VAL_BYTE, byte)
+#define AS_NUMBER(value)          VALUE_AS(value, VAL_NUMBER, number)
+#define AS_STRING(value)          VALUE_AS(value, VAL_STRING, string)
+#define AS_FUNCTION(value)        VALUE_AS(value, VAL_FUNCTION, function)
+#define AS_RETURN(value)          VALUE_AS(value, VAL_RETURN, return_val)
+#define AS_NATIVE(value)          VALUE_AS(value, VAL_NATIVE, native)
+#define AS_ARRAY(value)           VALUE_AS(value, VAL_ARRAY, array)
+#define AS_MAP(value)             VALUE_AS(value, VAL_MAP, map)
+#define AS_NAMESPACE(value)       VALUE_AS(value, VAL_NAMESPACE, map)
+#define AS_CLASS(value)           VALUE_AS(value, VAL_CLASS, class_obj)
+#define AS_INSTANCE(value)        VALUE_AS(value, VAL_INSTANCE, instance)
+#define AS_INTERFACE(value)       VALUE_AS(value, VAL_INTERFACE, interface_obj)
+#define AS_LINKEDLIST(value)      VALUE_AS(value, VAL_LINKEDLIST, list)
+#define AS_ENUM(value)            VALUE_AS(value, VAL_ENUM, enum_obj)
+#define AS_FILE(value)            VALUE_AS(value, VAL_FILE, file)
+#define AS_STRUCT_DEF(value)      VALUE_AS(value, VAL_STRUCT_DEF, struct_def)
+#define AS_STRUCT_INSTANCE(value) VALUE_AS(value, VAL_STRUCT_INSTANCE, struct_instance)
+#define AS_TASK(value)            VALUE_AS(value, VAL_TASK, task)
+#define AS_PROMISE(value)         VALUE_AS(value, VAL_PROMISE, promise)
+#define AS_DATAFRAME(value)       VALUE_AS(value, VAL_DATAFRAME, frame)
+#define AS_CSV_CURSOR(value)      VALUE_AS(value, VAL_CSV_CURSOR, cursor)
+#define AS_CSV_WRITER(value)      VALUE_AS(value, VAL_CSV_WRITER, csv_writer)
+
+#define BOOL_VAL(b)         MAKE_VALUE(VAL_BOOL, boolean, (b))
+#define STRING_VAL(s)       MAKE_VALUE(VAL_STRING, string, (s))
+#define FUNCTION_VAL(f)     MAKE_VALUE(VAL_FUNCTION, function, (f))
+#define NATIVE_VAL(f)       MAKE_VALUE(VAL_NATIVE, native, (f))
+#define ARRAY_VAL(a)        MAKE_VALUE(VAL_ARRAY, array, (a))
+#define MAP_VAL(m)          MAKE_VALUE(VAL_MAP, map, (m))
+#define NAMESPACE_VAL(m)    MAKE_VALUE(VAL_NAMESPACE, map, (m))
+#define CLASS_VAL(c)        MAKE_VALUE(VAL_CLASS, class_obj, (c))
+#define INSTANCE_VAL(i)     MAKE_VALUE(VAL_INSTANCE, instance, (i))
+#define FILE_VAL(f)         MAKE_VALUE(VAL_FILE, file, (f))
+#define TASK_VAL(t)         MAKE_VALUE(VAL_TASK, task, (t))
+#define PROMISE_VAL(p)      MAKE_VALUE(VAL_PROMISE, promise, (p))
+#define DATAFRAME_VAL(f)    MAKE_VALUE(VAL_DATAFRAME, frame, (f))
+
 
 /**
  * @typedef @struct VAR
@@ -360,6 +559,8 @@ typedef struct Var {
     Value value;
     bool is_const;
     bool is_final;
+    bool in_frame;      // allocated in a frame arena, freed with its Env
+    bool is_shared;     // also bound in importing environments, see link_var
     struct Var* next;
     char expected_type[64];
 } Var;
@@ -414,14 +615,7 @@ typedef struct {
     int column;
 } Token;
 
-typedef struct {
-    Func* func;
-    int arg_count;
-    Value* args;
-} AsyncData;
-
 
-void* jackal_allocate_gc(size_t size);
 
 
 
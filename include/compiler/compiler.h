@@ -4,8 +4,26 @@
 #include "parser.h"
 #include "vm/chunk.h"
 #include <stdbool.h>
+#include <stdint.h>
 
+/**
+ * Compiles a list of resolved statements into a chunk ending in OP_HALT.
+ * Statements without bytecode are emitted as OP_EVAL, so the AST must stay
+ * alive for as long as the chunk is run.
+ * @param program_ast First statement of the list.
+ * @param chunk The chunk to write into.
+ * @return false if a limit of the bytecode format was exceeded.
+ */
 bool compile(Node* program_ast, Chunk* chunk);
-void compile_to_binary(Node* root, const char* path); // Fungsi dari main.c
 
-#endif
\ No newline at end of file
+/**
+ * Compiles a linked list of resolved statements into a standalone .jlo file.
+ * Unlinks the statements from each other.
+ * @param root First statement of the list.
+ * @param path Output file.
+ * @param source_hash jlo_hash() of the source text.
+ * @return false if a statement does not fit the bytecode format or the file cannot be written.
+ */
+bool compile_to_binary(Node* root, const char* path, uint64_t source_hash);
+
+#endif
@@ -0,0 +1,91 @@
+#ifndef JACKAL_JLO_H
+#define JACKAL_JLO_H
+
+#include "parser.h"
+#include "vm/chunk.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+/**
+ * .jlo container layout (host byte order; the cache is not meant to be portable):
+ *   "JLO" magic, 1-byte format version, 8-byte hash of the source text,
+ *   node pool (the resolved AST), then each top-level statement as the index
+ *   of its root node followed by its chunk: code, line table, frame slot
+ *   layout, constant pool, node table (pool indexes) and nested function chunks.
+ * Bump JLO_VERSION whenever Node, the opcodes or the resolver change.
+ */
+#define JLO_MAGIC "JLO"
+#define JLO_VERSION 5
+
+/**
+ * @typedef @struct JLOMODULE
+ * The top-level statements of one source file with their compiled chunks.
+ * The statements are resolved and ready for eval_node; the chunks for the VM.
+ */
+typedef struct {
+    uint64_t source_hash;
+    int count;
+    int capacity;
+    Node** stmts;
+    Chunk** chunks;
+    bool cacheable;     // false if a statement did not fit the bytecode format
+} JloModule;
+
+/**
+ * Initializes an empty module.
+ * @param module The module to initialize.
+ * @param source_hash Hash of the source text the statements come from.
+ */
+void jlo_init(JloModule* module, uint64_t source_hash);
+
+/**
+ * Hashes source text (64-bit FNV-1a) to key the cache.
+ * @param data The source text.
+ * @param length Its length in bytes.
+ */
+uint64_t jlo_hash(const char* data, size_t length);
+
+/**
+ * Compiles a resolved top-level statement and appends it to the module.
+ * @param module The module.
+ * @param stmt The statement; the module takes it, its next pointer must be NULL.
+ */
+void jlo_add_statement(JloModule* module, Node* stmt);
+
+/**
+ * Writes a module to a .jlo file, atomically replacing any existing file.
+ * @return false if the module is not cacheable or the file cannot be written.
+ */
+bool jlo_write(const char* path, const JloModule* module);
+
+/**
+ * Reads a .jlo file.
+ * @param path The file.
+ * @param module Receives the statements and chunks on success.
+ * @param expected_hash Source hash the file must have been built from.
+ * @param check_hash Whether to compare expected_hash (false to run a standalone .jlo).
+ * @return false if the file is missing, stale, from another format version or corrupt.
+ */
+bool jlo_read(const char* path, JloModule* module, uint64_t expected_hash, bool check_hash);
+
+/**
+ * Loads a source file through its .jlo cache.
+ * The cache next to the file is used when its hash matches the current
+ * source; otherwise the file is parsed, resolved and compiled, and the cache
+ * is rewritten (silently skipped when the directory is read-only).
+ * @param source_path Path of the .jackal file.
+ * @param module Receives the statements and chunks.
+ * @param cache_hit Set to whether the cache was used; may be NULL.
+ * @return false if the source file cannot be read.
+ */
+bool jlo_load_cached(const char* source_path, JloModule* module, bool* cache_hit);
+
+/**
+ * Frees the chunks and statement arrays. The statements themselves are left
+ * to the caller, which either frees them after evaluation or keeps them for
+ * the chunks that refer to them.
+ * @param module The module to free.
+ */
+void jlo_free(JloModule* module);
+
+#endif
@@ -0,0 +1,126 @@
+#ifndef CSV_READER_H
+#define CSV_READER_H
+
+#include "common.h"
+#include "value.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * RFC 4180 CSV scanning over memory-mapped files.
+ *
+ * A file is mapped read-only and parsed in place: a record's fields are
+ * slices of the mapping, and only the cells a caller turns into Values are
+ * copied. Delimiters and line ends are located 16 or 32 bytes at a time
+ * with SSE2 or AVX2 (picked at run time, with a scalar loop elsewhere);
+ * quoted fields may hold delimiters, line breaks and doubled quotes.
+ * Numbers are read straight from the mapping.
+ */
+
+/**
+ * @typedef @struct CSVFIELD
+ * One field of a record, pointing into the scanned buffer.
+ */
+typedef struct {
+    const char* data;
+    size_t length;
+    bool quoted;
+    bool escaped;               // quoted and still holding doubled quotes ("")
+} CsvField;
+
+/**
+ * @typedef @struct CSVROW
+ * The fields of the last record scanned. Reused from record to record.
+ */
+typedef struct {
+    CsvField* fields;
+    int count;
+    int capacity;
+} CsvRow;
+
+/**
+ * @typedef @struct CSVMAP
+ * A file mapped for reading.
+ */
+typedef struct {
+    const char* data;
+    size_t size;
+} CsvMap;
+
+#define CSV_STRING_CACHE_SIZE 4096
+#define CSV_STRING_CACHE_MAX 32        // longer cells are rarely repeated
+
+/**
+ * @typedef @struct CSVSTRINGCACHE
+ * Recently made short strings, so a column repeating the same few values
+ * shares one string per value instead of allocating one per cell.
+ * Direct-mapped by hash; the strings must stay reachable from the rows.
+ */
+typedef struct {
+    Value strings[CSV_STRING_CACHE_SIZE];
+} CsvStringCache;
+
+/**
+ * Maps the file at path. An empty file maps to no data.
+ * @return false if it cannot be opened.
+ */
+bool csv_map_open(CsvMap* map, const char* path);
+
+void csv_map_close(CsvMap* map);
+
+/**
+ * Finds the first delimiter, '\n' or '\r' in [p, end).
+ * @return Where it is, or end.
+ */
+const char* csv_find_special(const char* p, const char* end, char delim);
+
+/**
+ * Scans the record starting at p into row.
+ * @param at_end Whether end is the end of the input. If not, a record
+ *        running up to end is left for a later call with more bytes.
+ * @return Bytes the record took, line end included, or 0 if it is
+ *         incomplete (or p == end).
+ */
+size_t csv_parse_row(const char* p, const char* end, char delim, bool at_end, CsvRow* row);
+
+/**
+ * Whether row is an empty line, which readers skip.
+ */
+bool csv_row_blank(const CsvRow* row);
+
+void csv_row_free(CsvRow* row);
+
+/**
+ * Reads a whole field as a decimal number, allowing surrounding spaces.
+ * @return false if it is anything else.
+ */
+bool csv_parse_number(const char* p, size_t length, double* out);
+
+/**
+ * Reads a whole field as an integer of at most 18 digits, allowing
+ * surrounding spaces.
+ * @return false if it is anything else.
+ */
+bool csv_parse_int(const char* p, size_t length, int64_t* out);
+
+/**
+ * Makes a Value of a field: a number when infer_numbers is set and it is
+ * one, otherwise a string with any doubled quotes undone.
+ * @param cache Strings to reuse, or NULL.
+ */
+Value csv_field_value(const CsvField* field, bool infer_numbers, CsvStringCache* cache);
+
+/**
+ * Makes an array of a row's fields, sized to fit.
+ */
+ValueArray* csv_row_array(const CsvRow* row, bool infer_numbers, CsvStringCache* cache);
+
+/**
+ * Reads a whole CSV file into an array of row arrays.
+ * @return NULL if the file cannot be opened.
+ */
+ValueArray* csv_read_file(const char* path, char delim, bool infer_numbers);
+
+#endif
@@ -0,0 +1,150 @@
+#ifndef CSV_STREAM_H
+#define CSV_STREAM_H
+
+#include "common.h"
+#include "env.h"
+#include "csv/csv_reader.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * Row-at-a-time CSV reading and writing, for files too large to load.
+ *
+ * A CsvCursor reads its file with read() into one buffer of
+ * CSV_STREAM_BUFFER bytes, which is only grown for a record longer than
+ * itself, and hands out one row array per record. Scanning state is kept
+ * from record to record, so memory stays flat however long the file is:
+ * the rows a script drops are collected like any other garbage.
+ *
+ * A CsvWriter formats rows into a buffer of the same size and writes it
+ * out whenever it fills. Fields holding the delimiter, a quote or a line
+ * break are quoted. Writers still open when the program exits are flushed.
+ */
+
+#define CSV_STREAM_BUFFER (1 << 20)
+
+/**
+ * @typedef @struct CSVCURSOR
+ * A CSV file being read one record at a time.
+ */
+typedef struct CsvCursor {
+    int fd;                     // -1 once the end is reached or the cursor is closed
+    char delim;
+    char* buffer;
+    size_t capacity;
+    size_t start;               // first byte not yet scanned
+    size_t end;                 // end of the bytes read
+    bool at_eof;                // nothing more to read after buffer[end]
+    CsvRow row;
+    CsvStringCache* cache;
+} CsvCursor;
+
+/**
+ * @typedef @struct CSVOUT
+ * Buffered output to a file descriptor.
+ */
+typedef struct {
+    int fd;
+    char delim;
+    char* buffer;
+    size_t length;
+    bool failed;
+} CsvOut;
+
+/**
+ * @typedef @struct CSVWRITER
+ * A CSV file being written one row at a time.
+ */
+typedef struct CsvWriter {
+    CsvOut out;
+    bool open;
+    struct CsvWriter* next_open;    // in the list flushed at exit
+} CsvWriter;
+
+/**
+ * Opens a managed cursor on the file at path.
+ * @return NULL if it cannot be opened.
+ */
+CsvCursor* csv_cursor_open(const char* path, char delim);
+
+/**
+ * Reads the next record. Blank lines are skipped.
+ * @return Its fields as strings, or NULL at the end of the file.
+ */
+ValueArray* csv_cursor_next(CsvCursor* cursor);
+
+/**
+ * Releases the file and buffers. Later reads return NULL.
+ */
+void csv_cursor_close(CsvCursor* cursor);
+
+/**
+ * Opens path for writing (truncating it, or appending if append is set).
+ * @return false if it cannot be created.
+ */
+bool csv_out_open(CsvOut* out, const char* path, char delim, bool append);
+
+/**
+ * Writes one field, quoting it if it needs to be.
+ */
+void csv_out_field(CsvOut* out, const char* text, size_t length);
+
+/**
+ * Writes a number so it reads back the same, whole numbers without a
+ * fraction or exponent.
+ */
+void csv_out_double(CsvOut* out, double value);
+void csv_out_int(CsvOut* out, int64_t value);
+
+/**
+ * Formats a number the way csv_out_double writes it.
+ * @return The length of the text.
+ */
+int csv_format_number(char text[32], double value);
+
+/**
+ * Writes a cell: strings as fields, numbers as csv_out_double does, and
+ * nothing for nil.
+ */
+void csv_out_value(CsvOut* out, Value value);
+
+void csv_out_delim(CsvOut* out);
+void csv_out_end_row(CsvOut* out);
+
+/**
+ * Writes the cells of row with csv_out_value, separated by the
+ * delimiter, then a line end.
+ */
+void csv_out_row(CsvOut* out, const ValueArray* row);
+
+bool csv_out_flush(CsvOut* out);
+
+/**
+ * Flushes and closes.
+ * @return false if any write failed.
+ */
+bool csv_out_close(CsvOut* out);
+
+/**
+ * Opens a managed writer on path.
+ * @return NULL if it cannot be created.
+ */
+CsvWriter* csv_writer_open(const char* path, char delim, bool append);
+
+/**
+ * Flushes and closes a writer. Closing twice does nothing.
+ * @return false if any write failed.
+ */
+bool csv_writer_close(CsvWriter* writer);
+
+/**
+ * Closes the file of a cursor or writer the collector is about to free.
+ */
+void csv_cursor_finalize(CsvCursor* cursor);
+void csv_writer_finalize(CsvWriter* writer);
+
+void register_csv_stream_natives(Env* env);
+
+#endif
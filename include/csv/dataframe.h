@@ -0,0 +1,206 @@
+#ifndef CSV_DATAFRAME_H
+#define CSV_DATAFRAME_H
+
+#include "common.h"
+#include "env.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * Columnar tables behind the DataFrame value.
+ *
+ * Each column is one contiguous array: doubles, 64-bit integers, or codes
+ * into the column's dictionary of distinct strings. A column with empty
+ * cells also has a bitmap with a bit set for every null row. None of this
+ * is managed memory; the frame is a single GC object, and Values are only
+ * made for the cells a script reads.
+ *
+ * Group-by hashes the key column (string keys are grouped by code), and
+ * aggregates run over the arrays 64 rows at a time, looking at the null
+ * bitmap only for blocks that have nulls.
+ */
+
+typedef enum {
+    COLUMN_DOUBLE,
+    COLUMN_INT,
+    COLUMN_STRING
+} ColumnType;
+
+/**
+ * @typedef @struct STRINGDICT
+ * The distinct strings of a column, numbered in order of first appearance.
+ */
+typedef struct {
+    char* text;                 // every string, each followed by '\0'
+    size_t text_length;
+    size_t text_capacity;
+    size_t* offsets;            // where string i starts in text
+    uint32_t* lengths;
+    uint32_t count;
+    uint32_t capacity;
+    uint32_t* slots;            // hash index of code + 1, 0 when empty
+    uint32_t slot_capacity;
+} StringDict;
+
+/**
+ * @typedef @struct COLUMN
+ * One named column of a frame.
+ */
+typedef struct {
+    char* name;
+    ColumnType type;
+    union {
+        double* doubles;
+        int64_t* ints;
+        uint32_t* codes;
+    } data;
+    uint64_t* nulls;            // bit set for each null row; NULL when there are none
+    StringDict* dict;           // COLUMN_STRING only
+} Column;
+
+/**
+ * @typedef @struct DATAFRAME
+ * A managed table of columns sharing a row count.
+ */
+typedef struct DataFrame {
+    Column* columns;
+    int column_count;
+    size_t rows;
+} DataFrame;
+
+/**
+ * @typedef @struct FEATUREMATRIX
+ * The numeric columns of a frame or an array of rows, one array of
+ * doubles per feature, as the ML natives read them. Nulls read as 0.
+ */
+typedef struct {
+    int rows;
+    int cols;
+    const double** columns;
+    double* owned;              // storage for columns that had to be converted
+} FeatureMatrix;
+
+static inline bool column_is_null(const Column* column, size_t row) {
+    return column->nulls && (column->nulls[row / 64] >> (row % 64) & 1);
+}
+
+/**
+ * Allocates a managed frame of column_count columns and rows rows. Each
+ * column must be set up with frame_column_init before it is used.
+ */
+DataFrame* frame_new(int column_count, size_t rows);
+
+/**
+ * Names a column and allocates its cells, zeroed and not null.
+ */
+void frame_column_init(DataFrame* frame, int index, const char* name, ColumnType type);
+
+/**
+ * Frees the columns of a frame the collector is about to free.
+ */
+void frame_finalize(DataFrame* frame);
+
+/**
+ * Finds a column by name.
+ * @return Its index, or -1.
+ */
+int frame_column_index(const DataFrame* frame, const char* name);
+
+/**
+ * Makes a Value of one cell: nil for a null, a number, or a string.
+ */
+Value frame_cell(const DataFrame* frame, int column, size_t row);
+
+/**
+ * Finds or adds a string.
+ * @return Its code.
+ */
+uint32_t dict_intern(StringDict* dict, const char* chars, size_t length);
+
+void dict_free(StringDict* dict);
+
+/**
+ * Loads a CSV file whose first record names the columns. Each column
+ * gets the narrowest type all of its cells fit; empty cells are nulls.
+ *
+ * The file is cut into ranges that start on a new line outside quotes,
+ * and each range is parsed on its own thread straight into its rows of
+ * the columns; string columns get one dictionary per range, merged in
+ * order afterwards.
+ * @param threads Ranges to read at once, or 0 for one per core
+ *        (JACKAL_THREADS, as for @parallel) with at least 8 MB each.
+ * @return NULL if the file cannot be opened.
+ */
+DataFrame* frame_read_csv(const char* path, char delim, int threads);
+
+/**
+ * Builds a frame from an array of rows whose first row names the
+ * columns, typing the columns as frame_read_csv does.
+ */
+DataFrame* frame_from_rows(ValueArray* matrix);
+
+/**
+ * The frame as an array of rows, the column names first.
+ * @param as_text Make every cell a string, formatted as frame_write_csv
+ * writes it, instead of a typed value.
+ */
+ValueArray* frame_to_rows(const DataFrame* frame, bool as_text);
+
+/**
+ * Writes the frame as CSV, the column names first. Fields holding the
+ * delimiter, a quote or a line break are quoted; nulls are left empty.
+ * @return false if the file cannot be created.
+ */
+bool frame_write_csv(const DataFrame* frame, const char* path);
+
+/**
+ * A new frame with the named columns, in the order given.
+ * Names that are not columns are skipped.
+ */
+DataFrame* frame_select(const DataFrame* frame, ValueArray* names);
+
+/**
+ * A new frame with count rows starting at start.
+ */
+DataFrame* frame_slice(const DataFrame* frame, size_t start, size_t count);
+
+/**
+ * Reorders the rows so row i becomes the old row order[i].
+ */
+void frame_permute(DataFrame* frame, const size_t* order);
+
+/**
+ * Sorts the rows by a column, keeping equal rows in order; nulls go last.
+ * @return false if there is no such column.
+ */
+bool frame_sort(DataFrame* frame, const char* column, bool ascending);
+
+/**
+ * Aggregates a column with op: sum, avg, min, max or count.
+ * Nulls are left out.
+ * @return false if the column or op is unknown.
+ */
+bool frame_aggregate(const DataFrame* frame, const char* column, const char* op, double* out);
+
+/**
+ * Groups the rows by key_column and aggregates target_column in each
+ * group with op (as frame_aggregate). Groups come in order of first
+ * appearance; rows with a null key form a group of their own.
+ * @return A frame of the key and "result" columns, or NULL if a column
+ *         or op is unknown.
+ */
+DataFrame* frame_group_by(const DataFrame* frame, const char* key_column, const char* target_column, const char* op);
+
+/**
+ * Reads data (a DataFrame or an array of number rows) as features.
+ * @return false if data is neither.
+ */
+bool features_from_value(Value data, FeatureMatrix* out);
+
+void features_free(FeatureMatrix* features);
+
+void register_dataframe_natives(Env* env);
+
+#endif
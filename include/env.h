@@ -5,7 +5,9 @@
 
 
 typedef struct Env Env;
+typedef struct FrameArena FrameArena;
 struct Var;
+struct Node;
 
 
 /**
@@ -14,6 +16,55 @@ struct Var;
  */
 Env* env_new(Env* outer);
 
+/**
+ * Make the environment of a call, block or loop.
+ * Scopes the resolver marked frame-local are bump-allocated on the calling
+ * thread's frame stack and released by env_free in LIFO order; everything
+ * else is a normal env_new environment.
+ * @param outer Parent scope
+ * @param scope Body the environment is created for, may be NULL
+ */
+Env* env_push(Env* outer, struct Node* scope);
+
+/**
+ * Frame stacks for code that switches stacks on one thread (async fibers):
+ * each fiber gets its own arena and installs it while it runs.
+ */
+FrameArena* frame_arena_new(void);
+
+/**
+ * The calling thread's frame arena, NULL if it has not made one yet.
+ */
+FrameArena* frame_arena_current(void);
+
+/**
+ * Installs a as the calling thread's frame arena.
+ * @return The arena that was installed before.
+ */
+FrameArena* frame_arena_swap(FrameArena* a);
+
+/**
+ * Marks the values held by the frames of an arena that is not installed.
+ * Only valid inside a root marker.
+ */
+void frame_arena_mark(FrameArena* a);
+
+/**
+ * The calling thread's innermost frame, NULL if there is none.
+ */
+Env* frame_top(void);
+
+/**
+ * Drops the frames a longjmp skipped past, down to top as returned by
+ * frame_top before the jump.
+ */
+void frame_unwind(Env* top);
+
+/**
+ * Frees an arena and its chunks. Its frames must no longer be in use.
+ */
+void frame_arena_free(FrameArena* a);
+
 /**
  * read variable by name
  * @param env environment
@@ -30,6 +81,41 @@ struct Var* find_var(Env* env, const char* name);
  */
 void set_var(Env* env, const char* name, Value value, bool is_const,const char* type_name);
 
+/**
+ * declare variable, reusing the resolver slot when it matches
+ * @param env environment
+ * @param name name of the variable
+ * @param slot_hint slot computed by the resolver, -1 if unknown
+ * @param value value of the variable
+ * @param is_const this true if the variable is const
+ * @param type_name declared type, may be NULL
+ */
+struct Var* define_var(Env* env, const char* name, int slot_hint, Value value, bool is_const, const char* type_name);
+
+/**
+ * share a variable with another environment, used for module imports
+ * @param env environment to bind the variable in; var's own environment
+ * must outlive it
+ * @param var variable to share; reads and writes through either
+ * environment see the same value
+ */
+void link_var(Env* env, struct Var* var);
+
+/**
+ * read variable referenced by a resolved node, falls back to find_var
+ * @param env environment
+ * @param n identifier node annotated by the resolver
+ */
+struct Var* find_resolved_var(Env* env, struct Node* n);
+
+/**
+ * find_resolved_var with the scope distance given by the caller
+ * @param env environment to start from
+ * @param n identifier node annotated by the resolver
+ * @param depth scopes between env and the declaring scope, -1 to look up by name
+ */
+struct Var* find_var_at(Env* env, struct Node* n, int depth);
+
 /**
  * clear the environment 
  */
@@ -17,7 +17,18 @@ typedef struct {
 /**
  * Global exception state for the interpreter.
  */
-extern ExceptionState global_ex_state;
+extern __thread ExceptionState global_ex_state;
+
+/**
+ * Function whose body is being evaluated on this thread, for static locals.
+ */
+extern __thread Func* current_executing_func;
+
+/**
+ * Throws error to the innermost try block of this thread, or reports it
+ * and exits when there is none.
+ */
+void throw_value(Value error);
 
 
 /**
@@ -36,4 +47,146 @@ Value call_jackal_function(Env *env, Value func_val, int arg_count, Value *args)
 
 const char *get_value_type_name(Value val);
 
+/**
+ * Evaluator operations shared with the bytecode VM, so both engines
+ * give the same results and report the same errors.
+ * Unless noted otherwise, operands passed by value are owned by the callee
+ * and argument arrays stay owned by the caller.
+ */
+
+/**
+ * Creates a function value for a NODE_FUNC_DEF or NODE_FUNC_EXPR closing over env.
+ */
+Value make_function(Env *env, struct Node *n);
+
+/**
+ * Applies an arithmetic, comparison or equality operator to two operands.
+ */
+Value eval_binary_op(TokenKind op, Value left, Value right);
+
+/**
+ * Applies an 'as' cast.
+ */
+Value eval_cast(Value val, const char *target_type);
+
+/**
+ * Builds the array for start..end, stepping by step (VAL_NIL for 1).
+ */
+Value make_range(Value start, Value end, Value step);
+
+/**
+ * Reads container[index] for arrays and maps.
+ */
+Value index_get(Value container, Value index);
+
+/**
+ * Stores container[index] = new_val and returns new_val.
+ */
+Value index_set(Value container, Value index, Value new_val);
+
+/**
+ * Returns the interned name of a node, interning it on first use.
+ */
+ObjString *node_key(struct Node *n);
+
+/**
+ * Reads obj.name for structs, maps, enums and instances.
+ * @param key The interned property name.
+ * @param cache The call site's inline cache, or NULL.
+ */
+Value get_property(Value obj, ObjString *key, FieldCache *cache);
+
+/**
+ * Stores obj.name = val on a class instance.
+ * @param key The interned property name.
+ * @param cache The call site's inline cache, or NULL.
+ */
+Value set_property(Value obj, ObjString *key, Value val, FieldCache *cache);
+
+/**
+ * Assigns val to the variable a NODE_ASSIGN node refers to and returns a copy of it.
+ */
+Value assign_ident(Env *env, struct Node *n, Value val);
+
+/**
+ * Assigns val to a variable already looked up for a NODE_ASSIGN node.
+ */
+Value assign_to_var(Var *v, struct Node *n, Value val);
+
+/**
+ * Declares the variable of a plain NODE_VARDECL or NODE_CONSTDECL.
+ */
+Value declare_var(Env *env, struct Node *n, Value val);
+
+/**
+ * Calls a function, native, class or struct with evaluated arguments.
+ */
+Value call_value(Env *env, Value callee, struct Node *template_types, int arg_count, Value *args);
+
+/**
+ * Calls a Jackal function on the current thread; @parallel functions are
+ * not handed to the task pool.
+ */
+Value call_function(Env *env, Func *func, int arg_count, Value *args);
+
+/**
+ * Binds arguments to a function's parameters in call_env, checking declared types.
+ * @return false after reporting a type mismatch.
+ */
+bool bind_call_args(Env *env, Env *call_env, Func *func, int arg_count, Value *args);
+
+/**
+ * Checks a function result against its declared return type.
+ */
+Value check_return_type(Func *func, Value result);
+
+/**
+ * Allocates an instance of a class and fills its fields from the arguments.
+ */
+Value new_instance(Value klass_val, struct Node *template_types, int arg_count, Value *args);
+
+/**
+ * Binds constructor arguments to init's parameters, then 'this'.
+ * @return false after reporting a type mismatch.
+ */
+bool bind_init_args(Env *call_env, Func *init, Value instance, int arg_count, Value *args);
+
+/**
+ * Searches for a method in a class and its superclasses, then in the
+ * scopes the classes were defined in.
+ */
+Var *find_method(Class *klass, const char *name);
+
+/**
+ * Looks up obj.name for a call, reporting undefined and private methods.
+ */
+Func *lookup_method(Value obj, const char *name, bool from_this, MethodCache *cache);
+
+/**
+ * Binds method arguments to parameters in call_env, then 'this'.
+ */
+void bind_method_args(Env *call_env, Func *func, Value receiver, int arg_count, Value *args);
+
+/**
+ * Runs a method looked up with lookup_method on its receiver.
+ */
+Value call_method(Func *func, Value receiver, int arg_count, Value *args);
+
+/**
+ * Calls obj.name(args) on instances and built-in types.
+ * @param name The interned method name.
+ */
+Value invoke_method(Env *env, Value obj, ObjString *name, int arg_count, Value *args, bool from_this,
+                    MethodCache *cache);
+
+/**
+ * Creates the class object for a NODE_CLASS_DEF; the caller adds the methods.
+ */
+Class *begin_class(Env *env, struct Node *n);
+
+/**
+ * Validates a class once its methods are defined and binds its name in env.
+ */
+void end_class(Env *env, struct Node *n, Class *class_obj);
+
 void init_pack_registry();
\ No newline at end of file
@@ -0,0 +1,166 @@
+#ifndef GC_H
+#define GC_H
+
+#include "parser.h"
+
+/**
+ * Mark-and-sweep collector for heap objects reachable from Values.
+ *
+ * Roots are the global environment, anything registered with gc_add_root /
+ * gc_add_root_env / gc_add_root_marker (module environments, the VM stack,
+ * native handles, suspended async fibers), and words on the main thread's
+ * C stack that point at a managed object, so temporaries held by the
+ * evaluator and by natives stay alive without bookkeeping. Collections run
+ * on the main thread when the bytes allocated since the last one pass a
+ * threshold, and only while no other interpreter thread (@parallel) is
+ * running, or every one that is waits inside gc_blocking_begin.
+ *
+ * Set JACKAL_GC_STRESS=1 to collect on every allocation.
+ */
+
+/**
+ * @typedef @enum GCKIND
+ * What a managed object holds, which decides how it is traced and freed.
+ */
+typedef enum {
+    GC_STRING,
+    GC_ARRAY,
+    GC_MAP,
+    GC_INSTANCE,
+    GC_STRUCT_INSTANCE,
+    GC_FUNCTION,
+    GC_CLASS,
+    GC_ENUM,
+    GC_INTERFACE,
+    GC_LIST,
+    GC_ENV,
+    GC_BOX,
+    GC_TASK,
+    GC_PROMISE,
+    GC_FRAME,
+    GC_CSV_CURSOR,
+    GC_CSV_WRITER
+} GCKind;
+
+/**
+ * @typedef @struct GCSTATS
+ * Counters reported by gc.stats().
+ */
+typedef struct {
+    size_t collections;
+    size_t live_objects;
+    size_t live_bytes;
+    size_t freed_bytes;     // total over all collections
+    size_t allocations;     // objects allocated since startup
+    size_t threshold;       // live_bytes that triggers the next collection
+    double last_pause_ms;
+    double total_pause_ms;
+} GCStats;
+
+typedef void (*GCRootMarker)(void *ctx);
+
+/**
+ * Records the main thread and its stack. Call first thing in main.
+ */
+void gc_init(void);
+
+/**
+ * Allocates a zeroed managed object, collecting first if the threshold is reached.
+ * @param size Payload size.
+ * @param kind What the payload is.
+ */
+void *gc_allocate(size_t size, GCKind kind);
+
+/**
+ * Frees a managed object its owner knows to be unreachable.
+ * Pointers the collector does not manage are passed to free().
+ */
+void gc_free(void *ptr);
+
+/**
+ * Whether ptr is the payload of a live managed string.
+ * Safe to call with any address; it is only compared, never read.
+ * Takes the collector's lock, so it is meant for checks in debug builds.
+ */
+bool gc_is_string(const void *ptr);
+
+void gc_add_root(Value *slot);
+void gc_remove_root(Value *slot);
+void gc_add_root_env(Env *env);
+void gc_add_root_marker(GCRootMarker marker, void *ctx);
+void gc_remove_root_marker(GCRootMarker marker, void *ctx);
+
+/**
+ * Marks a value or environment as reachable. Only valid inside a root marker.
+ */
+void gc_mark_value(Value value);
+void gc_mark_env(Env *env);
+
+/**
+ * Conservatively marks every word in [lo, hi) that points at a managed
+ * object, as is done for the C stack. Only valid inside a root marker.
+ */
+void gc_mark_range(const void *lo, const void *hi);
+
+/**
+ * Tells the collector which stack the main thread now runs on, for code
+ * that switches stacks (async fibers). The stack is scanned from the
+ * current stack pointer up to end.
+ * @param end The highest address of the new stack.
+ * @return The previous end.
+ */
+char *gc_swap_stack_end(char *end);
+
+/**
+ * Must be called before starting a thread that evaluates code or reads
+ * Values, and gc_thread_end from that thread when it is done.
+ * Collections are deferred while such threads run.
+ */
+void gc_thread_begin(void);
+void gc_thread_end(void);
+
+/**
+ * Bracket a wait on such a thread that touches no managed memory (a
+ * sleep, a poll, a condition wait). In between the thread does not hold
+ * collections off: the collector scans its stack, registers and frame
+ * arena instead, and gc_blocking_end does not return while one is running.
+ * No-ops on the main thread.
+ */
+void gc_blocking_begin(void);
+void gc_blocking_end(void);
+
+/**
+ * Holds collections off while a native builds a large result in which
+ * nothing becomes garbage, such as every row of a file. Calls nest; each
+ * gc_pause needs a gc_resume.
+ */
+void gc_pause(void);
+void gc_resume(void);
+
+/**
+ * Whether any thread registered with gc_thread_begin is still running.
+ */
+bool gc_threads_running(void);
+
+/**
+ * Whether enough has been allocated since the last collection that one
+ * is due. Lets a thread that does not allocate itself, such as the Jweb
+ * I/O loop, collect on behalf of threads that cannot.
+ */
+bool gc_due(void);
+
+/**
+ * Runs a full collection now if it is safe to.
+ * @return Bytes freed, 0 if the collection had to be deferred.
+ */
+size_t gc_collect(void);
+
+GCStats gc_stats(void);
+
+/**
+ * Registers the gc natives (__gc_collect, __gc_stats) wrapped by the gc
+ * object in std/io.jackal.
+ */
+void register_gc_natives(Env *env);
+
+#endif
@@ -0,0 +1,35 @@
+#ifndef JSON_READER_H
+#define JSON_READER_H
+
+#include "common.h"
+#include "value.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/**
+ * JSON text read straight into Values in one pass, without building a
+ * cJSON tree first.
+ *
+ * Objects become maps with interned keys, arrays become arrays and strings
+ * managed strings. String bodies are scanned 16 bytes at a time for the
+ * closing quote or a backslash, and a string without escapes is copied out
+ * of the input as it stands.
+ *
+ * What is accepted is what cJSON_Parse accepted: anything after the first
+ * value is ignored, a repeated key keeps its last value and nesting deeper
+ * than JSON_PARSE_MAX_DEPTH is an error.
+ */
+
+#define JSON_PARSE_MAX_DEPTH 1000
+
+/**
+ * Parses the JSON value at the start of text.
+ * @param text The input; it does not need to be '\0'-terminated.
+ * @param length Number of bytes of input.
+ * @param out Receives the value.
+ * @return false if the input is not JSON.
+ */
+bool json_parse(const char* text, size_t length, Value* out);
+
+#endif
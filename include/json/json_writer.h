@@ -0,0 +1,50 @@
+#ifndef JSON_WRITER_H
+#define JSON_WRITER_H
+
+#include "common.h"
+#include "value.h"
+
+#include <stddef.h>
+
+/**
+ * JSON text written straight from Values, without building a cJSON tree.
+ *
+ * Output goes into a growable buffer. json_encode keeps one per thread and
+ * reuses it from call to call, so encoding a response costs no allocation
+ * once the buffer has grown to the size of the usual response. Runs of
+ * string bytes that need no escaping are found 16 bytes at a time and
+ * copied whole.
+ *
+ * The text is what cJSON_PrintUnformatted gave: maps in table order,
+ * instances as objects of their fields, whole numbers without a fraction
+ * and other numbers with the fewest of 15 or 17 digits that read back the
+ * same. NaN and infinities are written as null.
+ */
+
+#define JSON_MAX_DEPTH 1000         // deeper (or cyclic) values are written as null
+
+/**
+ * @typedef @struct JSONBUFFER
+ * Text being written.
+ */
+typedef struct {
+    char* data;
+    size_t length;
+    size_t capacity;
+} JsonBuffer;
+
+/**
+ * Appends the JSON text of value.
+ */
+void json_write_value(JsonBuffer* buffer, Value value);
+
+void json_buffer_free(JsonBuffer* buffer);
+
+/**
+ * Encodes value into this thread's buffer.
+ * @param length Receives the length of the text.
+ * @return The text, '\0'-terminated, valid until the thread's next call.
+ */
+const char* json_encode(Value value, size_t* length);
+
+#endif
@@ -8,5 +8,6 @@
 void register_json_natives(Env* env);
 
 Value native_json_parse(int arity, Value *args);
+Value native_json_encode(int arity, Value *args);
 
 #endif
@@ -0,0 +1,69 @@
+#ifndef METHODS_H
+#define METHODS_H
+
+#include "common.h"
+#include "string_object.h"
+
+/**
+ * Method lookup for class instances and built-in types.
+ *
+ * Methods of built-in types (arrays, strings, numbers, ...) live in one
+ * table per ValueType keyed by interned name, filled by natives with
+ * register_method. A call site caches the class or built-in method it
+ * resolved last, so repeated calls skip the lookup. Caches hold an epoch
+ * and are dropped whenever methods change.
+ */
+
+/**
+ * @typedef BUILTINMETHOD
+ * A method of a built-in type.
+ * @param env The caller's environment, for methods that call back into Jackal code.
+ * @param receiver The value the method was called on.
+ * @param arg_count Number of arguments.
+ * @param args The evaluated arguments; owned by the caller.
+ */
+typedef Value (*BuiltinMethod)(struct Env *env, Value receiver, int arg_count, Value *args);
+
+/**
+ * @typedef @struct METHODCACHE
+ * Inline cache of a method call site.
+ */
+typedef struct {
+    Class *klass;          // receiver class last seen
+    Var *method;           // where its method was found, read again on every call
+    ValueType type;        // built-in receiver type last seen
+    BuiltinMethod builtin; // its method, NULL if the last receiver was an instance
+    unsigned epoch;        // method_cache_epoch when the entry was filled
+} MethodCache;
+
+/**
+ * Adds or replaces a method of a built-in type.
+ * @param type The receiver type.
+ * @param name The method name.
+ * @param method The implementation.
+ */
+void register_method(ValueType type, const char *name, BuiltinMethod method);
+
+/**
+ * Returns the method a built-in type registered under name, or NULL.
+ * @param name An interned name; compared by pointer.
+ * @param cache The call site's cache, or NULL.
+ */
+BuiltinMethod builtin_method(ValueType type, ObjString *name, MethodCache *cache);
+
+/**
+ * Looks name up in the methods of klass and its superclasses.
+ * Only the classes themselves are searched, not the scopes they were
+ * defined in.
+ * @param cache The call site's cache, or NULL.
+ * @return The method's variable, or NULL.
+ */
+Var *class_method(Class *klass, const char *name, MethodCache *cache);
+
+/**
+ * Invalidates every method cache. Called after methods are added to an
+ * existing class or a built-in type, and when a class is collected.
+ */
+void method_cache_flush(void);
+
+#endif
@@ -0,0 +1,35 @@
+#ifndef MODULE_H
+#define MODULE_H
+
+#include "parser.h"
+
+/**
+ * Set by --trace-imports: report each module load and its time on stderr.
+ */
+extern bool trace_imports;
+
+/**
+ * Imports a source file into an environment.
+ * The first import of a file (keyed by its canonical path) runs it once in
+ * a module environment below the global one; every import, including
+ * the first, then binds the module's top-level variables in env. They are
+ * shared, not copied: an assignment made through either environment is
+ * seen by both, and a redeclaration in env shadows the module's variable.
+ * A module that is still loading exports what it has defined so far to
+ * the thread loading it (an import cycle); other threads wait for it.
+ * @param env The importing environment.
+ * @param path Path of the .jackal file.
+ * @return false if the file cannot be read.
+ */
+bool module_import(Env *env, const char *path);
+
+/**
+ * Runs a source file directly in env (used for the preloaded stdlib),
+ * registering it so a second run or a later import does not load it again.
+ * @param env The environment to run in.
+ * @param path Path of the .jackal file.
+ * @return false if the file cannot be read.
+ */
+bool module_run(Env *env, const char *path);
+
+#endif
@@ -1,6 +1,8 @@
 #pragma once
 #include "common.h"
 #include "lexer.h"
+#include "shape.h"
+#include "methods.h"
 
 typedef struct Env Env;
 
@@ -11,6 +13,15 @@ typedef struct Env Env;
 struct Env {
     Var* vars;
     struct Env* outer;
+    Var** slots;
+    int count;
+    int capacity;
+    bool is_dynamic;
+    bool is_captured;
+    bool is_frame;            // bump-allocated by env_push, see env.h
+    bool slots_in_frame;      // slots came from the frame arena, not malloc
+    struct Env* frame_below;  // the thread's previous frame
+    void* frame_chunk;        // arena chunk the frame starts in
 };
 
 /**
@@ -71,10 +82,21 @@ typedef enum {
     NODE_BOOL ,
     NODE_WHERE,
     NODE_PACK,
-    NODE_USE
+    NODE_USE,
+    NODE_AWAIT
     
 } NodeKind;
 
+/**
+ * @typedef @enum RESOLVEKIND
+ * How the resolver bound a name: not at all, to a fixed slot, or to the top-level scope.
+ */
+typedef enum {
+    RESOLVE_NONE,
+    RESOLVE_LOCAL,
+    RESOLVE_ROOT
+} ResolveKind;
+
 /**
  * @typedef @struct NODE
  * Represents a node in the Abstract Syntax Tree (AST) of the Jackal programming language.
@@ -119,16 +141,19 @@ typedef struct Node {
     int arity;
     char return_type[64];
     bool is_async;
+
+    ResolveKind resolve_kind;
+    int scope_depth;
+    int scope_slot;
+
+    ObjString* key; // interned name, set on first use by node_key
+    bool is_frame_local; // set by the resolver when the subtree creates no closures
+    FieldCache field_cache;   // NODE_GET and NODE_SET on instances
+    MethodCache method_cache; // method calls through a NODE_GET
     
     
 } Node;
 
-typedef struct {
-    struct Env* env;
-    struct Node* body;
-    Value result;
-} ThreadArgs;
-
 /**
  * @typedef @struct PARSER
  * Represents a parser for the Jackal programming language.
@@ -0,0 +1,17 @@
+#ifndef RESOLVER_H
+#define RESOLVER_H
+
+#include "parser.h"
+
+/**
+ * Resolves variable references in a top-level statement before it is evaluated.
+ * Annotates NODE_IDENT, NODE_THIS, NODE_ASSIGN and NODE_VARDECL with the number
+ * of scopes to walk out and the slot to read, so the evaluator can index the
+ * environment directly instead of searching it by name.
+ * Names the resolver cannot pin down (import, using, with, forward references)
+ * are left unresolved and keep using the name-based lookup.
+ * @param stmt The statement to resolve, evaluated in the caller's environment.
+ */
+void resolve_stmt(Node *stmt);
+
+#endif
@@ -0,0 +1,80 @@
+#ifndef SHAPE_H
+#define SHAPE_H
+
+#include "common.h"
+
+/**
+ * Hidden classes for instance fields.
+ *
+ * An instance keeps its fields in a flat Value array and points at a Shape
+ * that says which field lives in which slot. Shapes form a tree per class:
+ * the root has no fields, and adding a field moves an instance to the child
+ * shape for that name, so instances whose fields were added in the same
+ * order share a shape. Property reads and stores cache the shape they last
+ * saw at the call site, which turns the common case into a pointer compare
+ * and an array load.
+ *
+ * Shapes are never freed, so a call site can keep a pointer to one without
+ * being told when its class is collected.
+ */
+
+/**
+ * @typedef @struct SHAPE
+ * One field layout. Immutable once created, apart from its transitions.
+ */
+typedef struct Shape {
+    struct Shape *parent;
+    int slot_count;
+    ObjString **names;          // names[i] is the field stored in slot i, interned and pinned
+    struct Shape **transitions; // children, one per field name added to this layout
+    int transition_count;
+    int transition_capacity;
+} Shape;
+
+/**
+ * @typedef @struct FIELDCACHE
+ * Inline cache of a NODE_GET or NODE_SET site.
+ */
+typedef struct {
+    Shape *shape;      // receiver shape last seen
+    int slot;          // where that shape keeps the field, -1 if it has none
+    Shape *transition; // for stores that add the field: the shape afterwards
+} FieldCache;
+
+/**
+ * Creates the empty root shape of a class.
+ */
+Shape *shape_new_root(void);
+
+/**
+ * Returns the slot holding name, or -1.
+ * @param name An interned name; compared by pointer.
+ */
+int shape_slot(Shape *shape, ObjString *name);
+
+/**
+ * Returns the shape with name appended to this one, creating it on first use.
+ * @param name An interned name; it is pinned so the shape can keep it.
+ */
+Shape *shape_add(Shape *shape, ObjString *name);
+
+/**
+ * Allocates an instance of klass with no fields.
+ */
+Instance *instance_new(Value klass_val);
+
+/**
+ * Returns the slot of a field, or NULL if the instance does not have it.
+ * @param name An interned name.
+ * @param cache The call site's cache, or NULL.
+ */
+Value *instance_field(Instance *inst, ObjString *name, FieldCache *cache);
+
+/**
+ * Stores a copy of value in a field, adding the field if needed.
+ * @param name An interned name.
+ * @param cache The call site's cache, or NULL.
+ */
+void instance_set_field(Instance *inst, ObjString *name, Value value, FieldCache *cache);
+
+#endif
@@ -0,0 +1,84 @@
+#ifndef STRING_OBJECT_H
+#define STRING_OBJECT_H
+
+#include "common.h"
+
+/**
+ * Managed strings carry their length and FNV-1a hash in an ObjString header
+ * in front of the characters. Identifiers, string literals and map keys are
+ * interned, so two interned strings are equal exactly when they are the
+ * same pointer. The intern table is weak: an interned string that nothing
+ * refers to is still collected, unless it is pinned.
+ * Natives build their string results with string_new or string_copy as
+ * well, never from malloc'd memory, so the collector reclaims them.
+ */
+
+/**
+ * Recovers the header from the characters of a managed string.
+ * Only valid for chars that came from this module.
+ */
+#define STRING_OBJECT(ptr) ((ObjString *)((char *)(ptr) - offsetof(ObjString, chars)))
+
+/**
+ * FNV-1a hash used for strings and map keys.
+ * @param chars The bytes to hash.
+ * @param length Number of bytes.
+ */
+uint32_t string_hash(const char *chars, size_t length);
+
+/**
+ * Copies bytes into a new managed string.
+ * @param chars The bytes to copy.
+ * @param length Number of bytes; a terminating NUL is added.
+ */
+Value string_new(const char *chars, size_t length);
+
+/**
+ * Copies a C string into a new managed string.
+ */
+Value string_copy(const char *chars);
+
+/**
+ * Builds the managed string a + b.
+ */
+Value string_concat(const char *a, size_t a_length, const char *b, size_t b_length);
+
+/**
+ * Returns the interned string with these bytes, creating it if needed.
+ * @param chars The bytes to look up.
+ * @param length Number of bytes.
+ */
+ObjString *string_intern(const char *chars, size_t length);
+
+/**
+ * Like string_intern, and keeps the result alive for the rest of the process.
+ * Used for names held by AST nodes and bytecode chunks, which the collector
+ * does not trace.
+ */
+ObjString *string_intern_pinned(const char *chars);
+
+/**
+ * Returns the header of a string Value, NULL if the Value is not a string
+ * or holds no characters. Every string Value is managed, so this is pointer
+ * arithmetic; -DJACKAL_CHECKED_VALUES builds also ask the collector and
+ * abort on a string that is not.
+ */
+ObjString *string_object(Value value);
+
+/**
+ * Wraps a managed string in a Value.
+ */
+Value string_value(ObjString *string);
+
+/**
+ * Compares two string Values: by pointer, then cached length and hash,
+ * and only then by content.
+ */
+bool string_equals(Value a, Value b);
+
+/**
+ * Drops a dead interned string from the intern table. Called by the collector.
+ */
+void string_forget(ObjString *string);
+
+#endif
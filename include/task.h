@@ -0,0 +1,101 @@
+#ifndef TASK_H
+#define TASK_H
+
+#include "common.h"
+#include <pthread.h>
+#include <stdatomic.h>
+
+/**
+ * Work-stealing thread pool behind @parallel functions.
+ *
+ * Calling a @parallel function queues a Task and returns it right away as
+ * a VAL_TASK value; task.join() waits for the result. The pool has one
+ * worker per core (JACKAL_THREADS overrides it) and starts on first use.
+ * Each worker owns a deque: it pushes and pops its own tasks at the
+ * bottom, and an idle worker steals the oldest task from the top of
+ * another worker's deque. A thread waiting in join runs queued tasks in the
+ * meantime, so tasks that spawn and join subtasks cannot starve the pool.
+ *
+ * Every queued or running task counts as a busy thread for the collector
+ * (see gc_thread_begin), so no collection runs until all tasks finish.
+ */
+
+/**
+ * @typedef TASKWORK
+ * Native work run by task_parallel_for.
+ * @param ctx Shared state passed to task_parallel_for.
+ * @param chunk Which piece of the work to do.
+ */
+typedef void (*TaskWork)(void* ctx, int chunk);
+
+typedef enum {
+    TASK_QUEUED,
+    TASK_RUNNING,
+    TASK_DONE
+} TaskState;
+
+/**
+ * @typedef @struct TASK
+ * One call of a @parallel function. A managed object (GC_TASK).
+ */
+typedef struct Task {
+    Value func;           // the task's own copy of the function
+    Value* args;          // copies of the call arguments
+    int arg_count;
+    Value result;         // valid once state is TASK_DONE
+    bool failed;          // the task threw; result holds the thrown value
+    TaskWork work;        // set instead of func for task_parallel_for chunks
+    void* ctx;
+    int chunk;
+    atomic_int state;
+    pthread_mutex_t lock;
+    pthread_cond_t done;
+} Task;
+
+/**
+ * Queues a call of func on the pool.
+ * @param func A VAL_FUNCTION value; copied, like the arguments.
+ * @param arg_count Number of arguments.
+ * @param args The evaluated arguments; they are copied, not consumed.
+ * @return A VAL_TASK value.
+ */
+Value task_spawn(Value func, int arg_count, Value* args);
+
+/**
+ * Waits for a task, running other queued tasks while it waits.
+ * If the task threw, its error is thrown again in the joining thread.
+ * @return A copy of the task's result.
+ */
+Value task_join(Task* task);
+
+/**
+ * Runs work(ctx, 0) .. work(ctx, chunks - 1) on the pool, the calling
+ * thread included, and returns once all of them have finished.
+ * work may evaluate Jackal code; each chunk gets its own call environments.
+ * If chunks throw, the error of the lowest-numbered one is thrown again in
+ * the caller once every chunk has finished.
+ */
+void task_parallel_for(int chunks, TaskWork work, void* ctx);
+
+/**
+ * Queues work(ctx, 0) on the pool and returns without waiting for it.
+ * work may evaluate Jackal code; no collection runs until it returns.
+ */
+void task_post(TaskWork work, void* ctx);
+
+/**
+ * Number of worker threads, starting the pool if needed.
+ */
+int task_pool_size(void);
+
+/**
+ * Releases what a task owns besides managed values. Called by the collector.
+ */
+void task_finalize(Task* task);
+
+/**
+ * Registers the methods of task values (join, isDone).
+ */
+void register_task_natives(struct Env* env);
+
+#endif
@@ -32,6 +32,7 @@ typedef struct {
 /**
  * @typedef @struct ENTRY
  * Represents a key-value pair in the HashMap.
+ * key is the chars of an interned string owned by the collector.
  */
 typedef struct {
     char* key;
@@ -49,7 +50,7 @@ typedef struct HashMap {
     Entry* entries;
 } HashMap;
 
-#define AS_CSTRING(value) ((value).as.string)
+#define AS_CSTRING(value) AS_STRING(value)
 /**
  * @typedef @struct VALUEARRAY
  * Represents a dynamic array of Values in the Jackal programming language.
@@ -146,7 +147,25 @@ bool map_get(HashMap* map, const char* key, Value* out_val);
  */
 void map_set(HashMap* map, const char* key, Value val);
 
-static Entry *find_entry(Entry *entries, int capacity, const char *key);
+/**
+ * Retrieves a Value by a managed string key, using its cached hash
+ * (and a pointer compare when the key is interned).
+ * @param map The HashMap to retrieve from.
+ * @param key The key.
+ * @param out_val Pointer to store the retrieved Value.
+ * @return true if the key exists and out_val is set, false otherwise.
+ */
+bool map_get_string(HashMap* map, ObjString* key, Value* out_val);
+
+/**
+ * Sets a key-value pair under a managed string key, interning it if needed.
+ * @param map The HashMap to set the value in.
+ * @param key The key of the Value to set.
+ * @param val The Value to set.
+ */
+void map_set_string(HashMap* map, ObjString* key, Value val);
+
+static Entry *find_entry(Entry *entries, int capacity, const char *key, size_t length, uint32_t hash, bool interned);
 
 bool map_delete(HashMap *map, const char *key);
 /**
@@ -184,6 +203,20 @@ Value builtin_array_filter(int argCount, Value* args);
 
 Value builtin_array_reduce(int argCount, Value* args);
 
+/**
+ * parMap, parFilter and parReduce of ArrayStream: like map, filter and
+ * reduce, with the array split into chunks run on the task pool.
+ * parReduce folds each chunk with the callback and the chunk results, in
+ * order, with the combiner (the callback if there is none), which must be
+ * associative. Without a combiner the initial value seeds the first chunk
+ * only; with one it seeds every chunk and must be an identity for it.
+ */
+Value builtin_array_par_map(int argCount, Value* args);
+
+Value builtin_array_par_filter(int argCount, Value* args);
+
+Value builtin_array_par_reduce(int argCount, Value* args);
+
 Value builtin_array_sort(int argCount, Value* args);
 
 Value builtin_array_limit(int argCount, Value* args);
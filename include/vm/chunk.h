@@ -0,0 +1,103 @@
+#ifndef JACKAL_CHUNK_H
+#define JACKAL_CHUNK_H
+
+#include "common.h"
+#include "parser.h"
+#include <stdint.h>
+
+typedef struct Chunk Chunk;
+
+/**
+ * @typedef @struct FUNCPROTO
+ * A function compiled ahead of time: its declaration node (name, parameters,
+ * annotations) and the chunk holding its body.
+ */
+typedef struct {
+    struct Node* decl;
+    Chunk* body;
+} FuncProto;
+
+/**
+ * @typedef @struct CHUNK
+ * A sequence of bytecode with its constant pool.
+ * Operands that need more than a value (variable references, declarations,
+ * statements run by the evaluator) index into the node table.
+ * A function body that creates no closures and delegates nothing to the
+ * evaluator keeps its locals in stack slots: slot 0 is the callee (or 'this'
+ * for a method), slots 1..arity the parameters, then the block locals.
+ * A script keeps its globals in Env and the locals of its blocks and loops
+ * in slots from 0.
+ */
+struct Chunk {
+    int count;
+    int capacity;
+    uint8_t* code;
+    int* lines;
+
+    int slot_count;     // stack slots a frame reserves, 0 when locals live in Env scopes
+    int arity;
+    bool has_receiver;  // slot 0 holds 'this'
+
+    ValueArray constants;
+
+    int node_count;
+    int node_capacity;
+    struct Node** nodes;
+
+    int proto_count;
+    int proto_capacity;
+    FuncProto* protos;
+};
+
+/**
+ * Initializes an empty chunk.
+ * @param chunk The chunk to initialize.
+ */
+void initChunk(Chunk* chunk);
+
+/**
+ * Allocates and initializes a chunk on the heap.
+ * @return The new chunk.
+ */
+Chunk* newChunk(void);
+
+/**
+ * Appends one byte of code.
+ * @param chunk The chunk to append to.
+ * @param byte The opcode or operand byte.
+ * @param line Source line the byte was compiled from.
+ */
+void writeChunk(Chunk* chunk, uint8_t byte, int line);
+
+/**
+ * Adds a constant to the pool, reusing an equal number or string constant.
+ * @param chunk The chunk that owns the pool.
+ * @param value The constant; strings are copied.
+ * @return Index of the constant.
+ */
+int addConstant(Chunk* chunk, Value value);
+
+/**
+ * Adds an AST node to the node table, reusing its index if already present.
+ * @param chunk The chunk that owns the table.
+ * @param node The node; it must outlive the chunk.
+ * @return Index of the node.
+ */
+int addNode(Chunk* chunk, struct Node* node);
+
+/**
+ * Adds a compiled function to the chunk.
+ * @param chunk The enclosing chunk.
+ * @param decl The NODE_FUNC_DEF or NODE_FUNC_EXPR node.
+ * @param body The compiled body; the chunk takes ownership.
+ * @return Index of the prototype.
+ */
+int addProto(Chunk* chunk, struct Node* decl, Chunk* body);
+
+/**
+ * Frees the code, constants and nested function chunks, leaving an empty chunk.
+ * @param chunk The chunk to free.
+ */
+void freeChunk(Chunk* chunk);
+
+#endif
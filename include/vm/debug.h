@@ -1,19 +1,19 @@
 #ifndef DEBUG_H
 #define DEBUG_H
 
-#include <stdint.h>
+#include "vm/chunk.h"
 
 /**
- * @brief print all bytecode content
- * @param code Array Instruction Byte
- * @param length Length of the array
+ * @brief print all bytecode content, then the chunks of the functions it defines
+ * @param chunk The chunk to print
+ * @param name Label for the chunk
  */
-void disassemble_chunk(const char* name, uint8_t* code, int length);
+void disassemble_chunk(Chunk* chunk, const char* name);
 
 /**
  * @brief print 1 insctruction
  * @return Offset for next instruction
  */
-int disassemble_instruction(uint8_t* code, int offset);
+int disassemble_instruction(Chunk* chunk, int offset);
 
-#endif
\ No newline at end of file
+#endif
@@ -3,67 +3,109 @@
 
 #include <stdint.h>
 
+#define OUTER_BY_NAME 0xff
+
 /**
  * this enum contains the opcode for jackal compiler mode
+ * Operands follow the opcode in the code stream: [const] and [node] are
+ * 2-byte indexes into the chunk's constant pool and node table, [proto] indexes
+ * its compiled functions, [offset] is a 2-byte jump distance, [argc] one byte.
+ * [slot] is one byte indexing the frame's stack slots, and [depth] one byte
+ * counting scopes outward from the closure environment (OUTER_BY_NAME when
+ * the resolver could not bind the name).
  * @typedef @enum OpCode
  */
 typedef enum {
-    OP_HALT,        
-    OP_CONST_NUM,  
-    OP_CONST_STR,   
-    OP_ADD,         
-    OP_SUB,        
-    OP_MUL,         
-    OP_DIV,         
-    OP_PRINT,       
-    OP_POP,        
-    OP_GET_VAR,     
-    OP_SET_VAR,
-
+    OP_HALT,
+    OP_CONST_NUM,       // [const]
+    OP_CONST_STR,       // [const]
     OP_NIL,
-    
-    OP_JUMP,        
-    OP_JUMP_IF_FALSE, 
-    OP_DEF_FUNC,   
-    OP_CALL,        
-    OP_RETURN,
+    OP_TRUE,
+    OP_FALSE,
+    OP_POP,
 
     /**
-     * OP for class
+     * OP for arithmetic and comparison
      */
-    OP_CLASS,       
-    OP_METHOD,      
-    OP_GET_PROP,   
-    OP_SET_PROP,
-    OP_INVOKE,
+    OP_ADD,
+    OP_SUB,
+    OP_MUL,
+    OP_DIV,
+    OP_MOD,
+    OP_EQUAL,
+    OP_NOT_EQUAL,
+    OP_GREATER,
+    OP_GREATER_EQUAL,
+    OP_LESS,
+    OP_LESS_EQUAL,
+    OP_NOT,
+    OP_NEGATE,
+    OP_CAST,            // [const] target type name
 
     /**
-     * OP Code for match
+     * OP for variables and scopes
      */
-    OP_DUP,     
-    OP_EQUAL,
+    OP_GET_VAR,         // [node] NODE_IDENT or NODE_THIS
+    OP_SET_VAR,         // [node] NODE_ASSIGN
+    OP_DEF_VAR,         // [node] NODE_VARDECL or NODE_CONSTDECL
+    OP_POST_INC,        // [node] NODE_IDENT
+    OP_POST_DEC,        // [node] NODE_IDENT
+    OP_PUSH_SCOPE,      // [node] block or loop the scope is for (see env_push)
+    OP_POP_SCOPE,
+    OP_GET_LOCAL,       // [slot]
+    OP_SET_LOCAL,       // [slot] leaves the value on the stack
+    OP_DEF_LOCAL,       // [slot]
+    OP_POST_INC_LOCAL,  // [slot]
+    OP_POST_DEC_LOCAL,  // [slot]
+    OP_GET_OUTER,       // [node] NODE_IDENT or NODE_THIS, [depth]
+    OP_SET_OUTER,       // [node] NODE_ASSIGN, [depth]
 
     /**
-     * OP For loop
+     * OP for control flow
      */
+    OP_JUMP,            // [offset]
+    OP_JUMP_IF_FALSE,   // [offset] leaves the condition on the stack
+    OP_JUMP_IF_TRUE,    // [offset] leaves the condition on the stack
+    OP_LOOP,            // [offset] backwards
+    OP_ITER_INIT,       // [offset] to skip the loop when the collection is not an array or CSV cursor
+    OP_ITER_NEXT,       // [node] item variable, [offset] to the loop exit
+    OP_ITER_NEXT_LOCAL, // [slot] item variable, [offset] to the loop exit
 
-    OP_LOOP,
+    /**
+     * OP for functions
+     */
+    OP_CLOSURE,         // [proto]
+    OP_DEF_FUNC,        // [node] NODE_FUNC_DEF
+    OP_IS_MAIN,
+    OP_CALL,            // [argc] [node] NODE_FUNC_CALL
+    OP_RETURN,
+    OP_RETURN_END,      // falling off the end of a body
 
     /**
-     * OP For > and < 
+     * OP for class
      */
+    OP_CLASS,           // [node] NODE_CLASS_DEF, [offset] to skip the body on error
+    OP_METHOD,          // [proto] method of the class on top of the stack
+    OP_END_CLASS,       // [node] NODE_CLASS_DEF
+    OP_GET_PROP,        // [node] NODE_GET, which holds the name and inline cache
+    OP_SET_PROP,        // [node] NODE_GET target of the NODE_SET
+    OP_INVOKE,          // [node] NODE_GET callee, [argc], 1 byte: receiver is 'this'
 
-    OP_GREATER,
-    OP_LESS,
+    /**
+     * OP for arrays and maps
+     */
+    OP_ARRAY,           // 2-byte element count
+    OP_MAP,             // [node] NODE_MAP_LITERAL
+    OP_INDEX_GET,
+    OP_INDEX_SET,
+    OP_RANGE,
 
     /**
-     * OP For Not
+     * Runs a statement the compiler has no bytecode for through eval_node,
+     * in the current scope.
      */
+    OP_EVAL             // [node]
 
-    OP_NOT,
-    OP_NEGATE,
-    OP_DEF_GLOBAL
-         
 } OpCode;
 
-#endif
\ No newline at end of file
+#endif
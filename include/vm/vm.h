@@ -5,23 +5,53 @@
 #include "env.h"
 #include "value.h"
 
-// Kita perlu ukuran tumpukan tetap (fixed stack size) untuk kesederhanaan
-#define STACK_MAX 256
+#define FRAMES_MAX 1024
+#define STACK_MAX (FRAMES_MAX * 64)
+
+/**
+ * @typedef @enum FrameKind
+ * What a call frame is running, which decides what its return produces.
+ */
+typedef enum {
+    FRAME_SCRIPT,
+    FRAME_FUNCTION,
+    FRAME_METHOD,
+    FRAME_INIT
+} FrameKind;
+
+/**
+ * @typedef @struct CallFrame
+ * One active chunk: a top-level statement, a function or a method body.
+ */
+typedef struct {
+    Chunk* chunk;
+    uint8_t* ip;
+
+    Env* env;           // innermost scope; OP_PUSH_SCOPE nests below base_env
+    Env* base_env;      // the call environment holding the parameters, or the closure's for slot frames
+    Func* func;
+    Value receiver;     // 'this' for methods, the new instance for init
+
+    Value* slots;       // first stack slot owned by the frame (the callee)
+    FrameKind kind;
+} CallFrame;
 
 /**
  * @typedef @struct VM
  * Represents the Jackal Virtual Machine structure.
+ * Variables live in the same Env chains the tree-walking evaluator uses, so
+ * statements the compiler delegates with OP_EVAL see the same scopes.
+ * Functions that delegate nothing and create no closures keep their
+ * parameters and locals in stack slots instead (see Chunk).
  */
 typedef struct {
-    Chunk* chunk;     
-    uint8_t* ip;      // Instruction Pointer: menunjuk ke byte instruksi berikutnya yang akan dieksekusi.
-    
-    Value stack[STACK_MAX]; // Execution Stack: array tempat operan disimpan.
-    Value* stackTop;        // Pointer ke lokasi di atas nilai teratas di tumpukan.
-    
-    // Environment global untuk menyimpan variabel global/fungsi
-    Env* globalEnv; 
+    CallFrame frames[FRAMES_MAX];
+    int frameCount;
+
+    Value* stack;
+    Value* stackTop;
 
+    Env* globalEnv;
 } VM;
 
 /**
@@ -34,9 +64,31 @@ typedef enum {
     INTERPRET_RUNTIME_ERROR
 } InterpretResult;
 
+/**
+ * Prepares a VM that runs top-level code in the given environment.
+ * @param vm The VM to initialize.
+ * @param globals The global environment, with natives already registered.
+ */
+void initVM(VM* vm, Env* globals);
 
-void initVM(VM* vm);
+/**
+ * Releases the VM's stack. The global environment belongs to the caller.
+ * @param vm The VM to free.
+ */
 void freeVM(VM* vm);
+
+/**
+ * Runs a compiled top-level chunk to completion.
+ * @param vm The VM.
+ * @param chunk The chunk produced by compile().
+ * @return INTERPRET_OK, or INTERPRET_RUNTIME_ERROR if execution was aborted.
+ */
 InterpretResult interpret(VM* vm, Chunk* chunk);
-void run_binary(const char* path);
-#endif
\ No newline at end of file
+
+/**
+ * Runs a standalone .jlo file produced by `jackal -c`.
+ * @param path The .jlo file.
+ * @param env The global environment.
+ */
+void run_binary(const char* path, Env* env);
+#endif
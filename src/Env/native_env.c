@@ -5,13 +5,14 @@
 #include <sys/stat.h>
 #include <float.h>
 #include "env.h"
+#include "string_object.h"
 
 #define ENV_REGISTER(env, name, func)                                           \
     do                                                                           \
     {                                                                            \
         if (func != NULL)                                                        \
         {                                                                        \
-            set_var(env, name, (Value){VAL_NATIVE, {.native = func}}, true, ""); \
+            set_var(env, name, NATIVE_VAL(func), true, ""); \
         }                                                                        \
         else                                                                     \
         {                                                                        \
@@ -20,11 +21,11 @@
     } while (0)
 
 Value native_env_load(int arity, Value *args) {
-    if (arity < 1 || args[0].type != VAL_STRING)
-        return (Value){VAL_NIL};
+    if (arity < 1 || VALUE_TYPE(args[0]) != VAL_STRING)
+        return NIL_VAL;
 
-    FILE *file = fopen(args[0].as.string, "r");
-    if (!file) return (Value){VAL_NIL};
+    FILE *file = fopen(AS_STRING(args[0]), "r");
+    if (!file) return NIL_VAL;
 
     HashMap* env_map = map_new();
     char line[1024];
@@ -59,12 +60,12 @@ Value native_env_load(int arity, Value *args) {
             char* val_end = value + strlen(value) - 1;
             while(val_end > value && *val_end == ' ') { *val_end = '\0'; val_end--; }
 
-            map_set(env_map, strdup(key), (Value){VAL_STRING, {.string = strdup(value)}});
+            map_set(env_map, strdup(key), string_copy(value));
         }
     }
 
     fclose(file);
-    return (Value){VAL_MAP, {.map = env_map}};
+    return MAP_VAL(env_map);
 }
 
 void register_env_natives(Env *env){
@@ -1,4 +1,5 @@
 #include "File/native_file.h"
+#include "string_object.h"
 #include <stdlib.h>
 #include <string.h>
 #include <errno.h>
@@ -17,7 +18,7 @@ extern int global_argc;
     {                                                                            \
         if (func != NULL)                                                        \
         {                                                                        \
-            set_var(env, name, (Value){VAL_NATIVE, {.native = func}}, true, ""); \
+            set_var(env, name, NATIVE_VAL(func), true, ""); \
         }                                                                        \
         else                                                                     \
         {                                                                        \
@@ -27,141 +28,142 @@ extern int global_argc;
 
 Value native_file_read(int arity, Value *args)
 {
-    if (arity < 1 || args[0].type != VAL_STRING)
-        return (Value){VAL_NIL, {0}};
+    if (arity < 1 || VALUE_TYPE(args[0]) != VAL_STRING)
+        return NIL_VAL;
 
-    FILE *file = fopen(args[0].as.string, "r");
+    FILE *file = fopen(AS_STRING(args[0]), "r");
     if (!file)
-        return (Value){VAL_NIL, {0}};
+        return NIL_VAL;
 
     fseek(file, 0, SEEK_END);
     long fsize = ftell(file);
     fseek(file, 0, SEEK_SET);
 
     char *string = malloc(fsize + 1);
-    fread(string, fsize, 1, file);
+    size_t length = fread(string, 1, fsize, file);
     fclose(file);
 
-    string[fsize] = 0;
-    return (Value){VAL_STRING, {.string = string}};
+    Value result = string_new(string, length);
+    free(string);
+    return result;
 }
 
 Value native_file_getcwd(int arity, Value *args) {
     char cwd[1024];
     if (getcwd(cwd, sizeof(cwd)) != NULL) {
-        return (Value){VAL_STRING, {.string = strdup(cwd)}};
+        return string_copy(cwd);
     }
-    return (Value){VAL_NIL};
+    return NIL_VAL;
 }
 
 Value native_file_realpath(int arity, Value *args) {
-    if (arity < 1 || args[0].type != VAL_STRING) return (Value){VAL_NIL};
+    if (arity < 1 || VALUE_TYPE(args[0]) != VAL_STRING) return NIL_VAL;
     
     char resolved_path[1024];
-    if (realpath(args[0].as.string, resolved_path)) {
-        return (Value){VAL_STRING, {.string = strdup(resolved_path)}};
+    if (realpath(AS_STRING(args[0]), resolved_path)) {
+        return string_copy(resolved_path);
     }
-    return (Value){VAL_NIL};
+    return NIL_VAL;
 }
 
 Value native_file_current_script(int arity, Value *args) {
     if (global_argc > 1 && global_argv[1] != NULL) {
-        return (Value){VAL_STRING, {.string = strdup(global_argv[1])}};
+        return string_copy(global_argv[1]);
     }
-    return (Value){VAL_NIL}; 
+    return NIL_VAL; 
 }
 
 Value native_file_exists(int arity, Value *args)
 {
-    if (arity < 1 || args[0].type != VAL_STRING)
-        return (Value){VAL_BOOL, {.boolean = false}};
+    if (arity < 1 || VALUE_TYPE(args[0]) != VAL_STRING)
+        return BOOL_VAL(false);
 
-    FILE *file = fopen(args[0].as.string, "r");
+    FILE *file = fopen(AS_STRING(args[0]), "r");
 
     if (file)
     {
         fclose(file);
-        return (Value){VAL_BOOL, {.boolean = true}};
+        return BOOL_VAL(true);
     }
 
-    return (Value){VAL_BOOL, {.boolean = false}};
+    return BOOL_VAL(false);
 }
 
 Value native_file_write(int arity, Value *args) {
-    if (arity < 2 || args[0].type != VAL_STRING || args[1].type != VAL_STRING) {
-        return (Value){VAL_NUMBER, {.number = 0}};
+    if (arity < 2 || VALUE_TYPE(args[0]) != VAL_STRING || VALUE_TYPE(args[1]) != VAL_STRING) {
+        return NUMBER_VAL(0);
     }
 
-    FILE *file = fopen(args[0].as.string, "w");
-    if (!file) return (Value){VAL_NUMBER, {.number = 0}};
+    FILE *file = fopen(AS_STRING(args[0]), "w");
+    if (!file) return NUMBER_VAL(0);
 
-    fprintf(file, "%s", args[1].as.string);
+    fprintf(file, "%s", AS_STRING(args[1]));
     fclose(file);
 
-    return (Value){VAL_NUMBER, {.number = 1}};
+    return NUMBER_VAL(1);
 }
 
 Value native_file_append(int arity, Value *args) {
-    if (arity < 2 || args[0].type != VAL_STRING || args[1].type != VAL_STRING) {
-        return (Value){VAL_BOOL, {.boolean = false}};
+    if (arity < 2 || VALUE_TYPE(args[0]) != VAL_STRING || VALUE_TYPE(args[1]) != VAL_STRING) {
+        return BOOL_VAL(false);
     }
 
-    FILE *file = fopen(args[0].as.string, "a");
+    FILE *file = fopen(AS_STRING(args[0]), "a");
     if (!file) {
-        return (Value){VAL_BOOL, {.boolean = false}};
+        return BOOL_VAL(false);
     }
 
-    fprintf(file, "%s", args[1].as.string);
+    fprintf(file, "%s", AS_STRING(args[1]));
     fclose(file);
 
-    return (Value){VAL_BOOL, {.boolean = true}};
+    return BOOL_VAL(true);
 }
 
 Value native_file_size(int arity, Value *args) {
-    if (arity < 1 || args[0].type != VAL_STRING) {
-        return (Value){VAL_NUMBER, {.number = -1}};
+    if (arity < 1 || VALUE_TYPE(args[0]) != VAL_STRING) {
+        return NUMBER_VAL(-1);
     }
 
     struct stat st;
-    if (stat(args[0].as.string, &st) == 0) {
-        return (Value){VAL_NUMBER, {.number = (double)st.st_size}};
+    if (stat(AS_STRING(args[0]), &st) == 0) {
+        return NUMBER_VAL((double)st.st_size);
     }
 
-    return (Value){VAL_NUMBER, {.number = -1}};
+    return NUMBER_VAL(-1);
 }
 Value native_file_create(int arity, Value *args) {
-    if (arity < 1 || args[0].type != VAL_STRING) {
-        return (Value){VAL_BOOL, {.boolean = 0}};
+    if (arity < 1 || VALUE_TYPE(args[0]) != VAL_STRING) {
+        return BOOL_VAL(0);
     }
 
-    FILE *file = fopen(args[0].as.string, "w");
+    FILE *file = fopen(AS_STRING(args[0]), "w");
     
     if (file) {
         fclose(file);
-        return (Value){VAL_BOOL, {.boolean = 1}};
+        return BOOL_VAL(1);
     }
 
-    return (Value){VAL_BOOL, {.boolean = 0}};
+    return BOOL_VAL(0);
 }
 Value native_file_remove(int arity, Value *args) {
-    if (arity < 1 || args[0].type != VAL_STRING) {
-        return (Value){VAL_BOOL, {.boolean = 0}};
+    if (arity < 1 || VALUE_TYPE(args[0]) != VAL_STRING) {
+        return BOOL_VAL(0);
     }
 
-    if (remove(args[0].as.string) == 0) {
-        return (Value){VAL_BOOL, {.boolean = 1}};
+    if (remove(AS_STRING(args[0])) == 0) {
+        return BOOL_VAL(1);
     }
-    return (Value){VAL_BOOL, {.boolean = 0}};
+    return BOOL_VAL(0);
 }
 Value native_file_rename(int arity, Value *args) {
-    if (arity < 2 || args[0].type != VAL_STRING || args[1].type != VAL_STRING) {
-        return (Value){VAL_BOOL, {.boolean = 0}};
+    if (arity < 2 || VALUE_TYPE(args[0]) != VAL_STRING || VALUE_TYPE(args[1]) != VAL_STRING) {
+        return BOOL_VAL(0);
     }
 
-    if (rename(args[0].as.string, args[1].as.string) == 0) {
-        return (Value){VAL_BOOL, {.boolean = 1}};
+    if (rename(AS_STRING(args[0]), AS_STRING(args[1])) == 0) {
+        return BOOL_VAL(1);
     }
-    return (Value){VAL_BOOL, {.boolean = 0}};
+    return BOOL_VAL(0);
 }
 
 void register_file_natives(Env *env)
@@ -1,4 +1,5 @@
 #include "Io/io_native.h"
+#include "string_object.h"
 #include <stdlib.h>
 #include <string.h>
 #include <errno.h>
@@ -8,7 +9,7 @@
     {                                                                            \
         if (func != NULL)                                                        \
         {                                                                        \
-            set_var(env, name, (Value){VAL_NATIVE, {.native = func}}, true, ""); \
+            set_var(env, name, NATIVE_VAL(func), true, ""); \
         }                                                                        \
         else                                                                     \
         {                                                                        \
@@ -31,28 +32,28 @@ char *get_input_raw(const char *prompt)
 }
 
 Value native_input_string(int arity, Value *args) {
-    char* input = get_input_raw(arity > 0 ? args[0].as.string : NULL);
-    if (!input) return (Value){VAL_NIL, {0}};
-    return (Value){VAL_STRING, {.string = strdup(input)}};
+    char* input = get_input_raw(arity > 0 ? AS_STRING(args[0]) : NULL);
+    if (!input) return NIL_VAL;
+    return string_copy(input);
 }
 
 Value native_input_number(int arity, Value *args) {
-    char* input = get_input_raw(arity > 0 ? args[0].as.string : NULL);
-    if (!input) return (Value){VAL_NUMBER, {.number = 0}};
-    return (Value){VAL_NUMBER, {.number = atof(input)}};
+    char* input = get_input_raw(arity > 0 ? AS_STRING(args[0]) : NULL);
+    if (!input) return NUMBER_VAL(0);
+    return NUMBER_VAL(atof(input));
 }
 
 
 Value native_reads(int arity, Value *args) {
 
-    if (arity > 0 && args[0].type == VAL_STRING) {
-        printf("%s", args[0].as.string);
+    if (arity > 0 && VALUE_TYPE(args[0]) == VAL_STRING) {
+        printf("%s", AS_STRING(args[0]));
         fflush(stdout);
     }
 
     char buffer[1024];
     if (fgets(buffer, sizeof(buffer), stdin) == NULL) {
-        return (Value){VAL_NIL, .as = {0}};
+        return NIL_VAL;
     }
 
     size_t len = strlen(buffer);
@@ -64,20 +65,14 @@ Value native_reads(int arity, Value *args) {
     double num = strtod(buffer, &endptr);
 
     if (strlen(buffer) == 0) {
-        char *empty = malloc(1);
-        empty[0] = '\0';
-        return (Value){VAL_STRING, {.string = empty}};
+        return string_new("", 0);
     }
 
     if (*endptr == '\0') {
-        return (Value){VAL_NUMBER, {.number = num}};
+        return NUMBER_VAL(num);
     }
 
-    char *str_copy = malloc(strlen(buffer) + 1);
-    if (str_copy == NULL) return (Value){VAL_NIL, .as = {0}};
-    strcpy(str_copy, buffer);
-
-    return (Value){VAL_STRING, {.string = str_copy}};
+    return string_copy(buffer);
 }
 
 void register_io_natives(Env *env)
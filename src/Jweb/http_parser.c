@@ -0,0 +1,289 @@
+#include "Jweb/http_parser.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <limits.h>
+
+/* tchar from RFC 9110: the characters allowed in methods and header names. */
+static bool is_token_char(unsigned char c) {
+    if (c >= '0' && c <= '9') return true;
+    if ((c | 0x20) >= 'a' && (c | 0x20) <= 'z') return true;
+    return c != '\0' && strchr("!#$%&'*+-.^_`|~", c) != NULL;
+}
+
+static HttpSlice slice(const char* buf, const char* start, const char* end) {
+    return (HttpSlice){(uint32_t)(start - buf), (uint32_t)(end - start)};
+}
+
+static bool slice_equals(const char* buf, HttpSlice s, const char* text) {
+    size_t length = strlen(text);
+    return s.length == length && strncasecmp(buf + s.offset, text, length) == 0;
+}
+
+/** Whether a comma-separated header value lists token, ignoring case. */
+static bool slice_has_token(const char* buf, HttpSlice s, const char* token) {
+    size_t token_len = strlen(token);
+    const char* p = buf + s.offset;
+    const char* end = p + s.length;
+    while (p < end) {
+        while (p < end && (*p == ' ' || *p == '\t' || *p == ',')) p++;
+        const char* start = p;
+        while (p < end && *p != ',') p++;
+        const char* stop = p;
+        while (stop > start && (stop[-1] == ' ' || stop[-1] == '\t')) stop--;
+        if ((size_t)(stop - start) == token_len && strncasecmp(start, token, token_len) == 0) return true;
+    }
+    return false;
+}
+
+static const char* skip_line_end(const char* p, const char* end) {
+    if (p < end && *p == '\r') p++;
+    if (p >= end || *p != '\n') return NULL;
+    return p + 1;
+}
+
+/** Fills in what the server needs to know from the headers. */
+static long interpret_headers(HttpHead* head, const char* buf) {
+    head->content_length = -1;
+    head->chunked = false;
+    head->keep_alive = head->minor_version >= 1;
+    head->expect_continue = false;
+
+    for (int i = 0; i < head->header_count; i++) {
+        HttpHeader* h = &head->headers[i];
+        const char* value = buf + h->value.offset;
+
+        if (slice_equals(buf, h->name, "Content-Length")) {
+            if (h->value.length == 0) return -400;
+            long length = 0;
+            for (uint32_t j = 0; j < h->value.length; j++) {
+                if (value[j] < '0' || value[j] > '9' || length > (LONG_MAX - 9) / 10) return -400;
+                length = length * 10 + (value[j] - '0');
+            }
+            /* Repeated lengths must agree, or the request could be read two ways. */
+            if (head->content_length >= 0 && head->content_length != length) return -400;
+            head->content_length = length;
+        } else if (slice_equals(buf, h->name, "Transfer-Encoding")) {
+            if (!slice_equals(buf, h->value, "chunked")) return -501;
+            head->chunked = true;
+        } else if (slice_equals(buf, h->name, "Connection")) {
+            if (slice_has_token(buf, h->value, "close")) head->keep_alive = false;
+            else if (slice_has_token(buf, h->value, "keep-alive")) head->keep_alive = true;
+        } else if (slice_equals(buf, h->name, "Expect")) {
+            if (slice_equals(buf, h->value, "100-continue")) head->expect_continue = true;
+        }
+    }
+
+    if (head->chunked && head->content_length >= 0) return -400;
+    return 0;
+}
+
+long http_parse_head(HttpHead* head, const char* buf, size_t length, size_t* scanned, size_t max_length) {
+    /* Look for the blank line only among bytes not searched yet, so a head
+       arriving in many small pieces is not rescanned from the start. */
+    size_t head_len = 0;
+    for (size_t i = *scanned > 2 ? *scanned - 2 : 0; i < length; i++) {
+        if (buf[i] != '\n') continue;
+        if ((i >= 1 && buf[i - 1] == '\n') || (i >= 2 && buf[i - 1] == '\r' && buf[i - 2] == '\n')) {
+            head_len = i + 1;
+            break;
+        }
+    }
+    if (head_len == 0) {
+        *scanned = length;
+        return length > max_length ? -431 : 0;
+    }
+    if (head_len > max_length) return -431;
+    *scanned = 0;
+
+    const char* p = buf;
+    const char* end = buf + head_len;
+
+    /* Empty lines before the request line are allowed. */
+    while (p < end && (*p == '\r' || *p == '\n')) p++;
+
+    const char* start = p;
+    while (p < end && is_token_char((unsigned char)*p)) p++;
+    if (p == start || p >= end || *p != ' ') return -400;
+    head->method = slice(buf, start, p);
+    p++;
+
+    start = p;
+    while (p < end && (unsigned char)*p > ' ' && *p != 0x7f) p++;
+    if (p == start || p >= end || *p != ' ') return -400;
+    head->target = slice(buf, start, p);
+    p++;
+
+    if (end - p < 8 || strncmp(p, "HTTP/1.", 7) != 0 || p[7] < '0' || p[7] > '9') return -400;
+    head->minor_version = p[7] - '0';
+    p = skip_line_end(p + 8, end);
+    if (p == NULL) return -400;
+
+    head->header_count = 0;
+    for (;;) {
+        const char* next = skip_line_end(p, end);
+        if (next != NULL) break;        // the blank line that ends the head
+        if (*p == ' ' || *p == '\t') return -400;   // obsolete line folding
+        if (head->header_count == HTTP_MAX_HEADERS) return -431;
+
+        start = p;
+        while (p < end && is_token_char((unsigned char)*p)) p++;
+        if (p == start || p >= end || *p != ':') return -400;
+        HttpSlice name = slice(buf, start, p);
+        p++;
+
+        while (p < end && (*p == ' ' || *p == '\t')) p++;
+        start = p;
+        while (p < end && *p != '\r' && *p != '\n') {
+            unsigned char c = (unsigned char)*p;
+            if ((c < ' ' && c != '\t') || c == 0x7f) return -400;
+            p++;
+        }
+        const char* value_end = p;
+        while (value_end > start && (value_end[-1] == ' ' || value_end[-1] == '\t')) value_end--;
+        p = skip_line_end(p, end);
+        if (p == NULL) return -400;
+
+        head->headers[head->header_count].name = name;
+        head->headers[head->header_count].value = slice(buf, start, value_end);
+        head->header_count++;
+    }
+
+    long status = interpret_headers(head, buf);
+    return status < 0 ? status : (long)head_len;
+}
+
+const HttpSlice* http_head_find(const HttpHead* head, const char* buf, const char* name) {
+    for (int i = 0; i < head->header_count; i++) {
+        if (slice_equals(buf, head->headers[i].name, name)) return &head->headers[i].value;
+    }
+    return NULL;
+}
+
+/* ---- Bodies ---- */
+
+void http_body_init(HttpBody* body, const HttpHead* head, size_t limit) {
+    memset(body, 0, sizeof(*body));
+    body->limit = limit;
+    if (head->chunked) {
+        body->state = HTTP_BODY_CHUNK_SIZE;
+        body->line_empty = true;
+    } else if (head->content_length > 0) {
+        body->state = HTTP_BODY_LENGTH;
+        body->remaining = (size_t)head->content_length;
+    } else {
+        body->state = HTTP_BODY_DONE;
+    }
+}
+
+/** Appends decoded bytes, moving the body to a temporary file once it gets large. */
+static long body_store(HttpBody* body, const char* data, size_t length) {
+    if (body->size + length > body->limit) return -413;
+
+    if (body->file == NULL && body->size + length > HTTP_BODY_MEMORY) {
+        body->file = tmpfile();
+        if (body->file == NULL || fwrite(body->data, 1, body->size, body->file) != body->size) return -500;
+        free(body->data);
+        body->data = NULL;
+        body->capacity = 0;
+    }
+
+    if (body->file) {
+        if (fwrite(data, 1, length, body->file) != length) return -500;
+    } else {
+        if (body->size + length > body->capacity) {
+            size_t capacity = body->capacity < 4096 ? 4096 : body->capacity;
+            while (capacity < body->size + length) capacity *= 2;
+            char* grown = realloc(body->data, capacity);
+            if (grown == NULL) return -500;
+            body->data = grown;
+            body->capacity = capacity;
+        }
+        memcpy(body->data + body->size, data, length);
+    }
+    body->size += length;
+    return 0;
+}
+
+static int hex_value(char c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    if ((c | 0x20) >= 'a' && (c | 0x20) <= 'f') return (c | 0x20) - 'a' + 10;
+    return -1;
+}
+
+long http_body_feed(HttpBody* body, const char* data, size_t length) {
+    if (body->state == HTTP_BODY_LENGTH && body->size + body->remaining > body->limit) return -413;
+
+    size_t used = 0;
+    while (used < length && body->state != HTTP_BODY_DONE) {
+        char c = data[used];
+        switch (body->state) {
+            case HTTP_BODY_LENGTH:
+            case HTTP_BODY_CHUNK_DATA: {
+                size_t n = length - used < body->remaining ? length - used : body->remaining;
+                long status = body_store(body, data + used, n);
+                if (status < 0) return status;
+                used += n;
+                body->remaining -= n;
+                if (body->remaining == 0)
+                    body->state = body->state == HTTP_BODY_LENGTH ? HTTP_BODY_DONE : HTTP_BODY_CHUNK_END;
+                break;
+            }
+
+            case HTTP_BODY_CHUNK_SIZE:
+            case HTTP_BODY_CHUNK_EXTENSION: {
+                int digit = hex_value(c);
+                used++;
+                if (body->state == HTTP_BODY_CHUNK_SIZE && digit >= 0) {
+                    if (body->remaining > (body->limit >> 4)) return -413;
+                    body->remaining = body->remaining * 16 + digit;
+                    body->line_empty = false;
+                } else if (c == '\n') {
+                    if (body->line_empty) return -400;
+                    /* The last chunk has size 0 and is followed by optional trailers. */
+                    body->state = body->remaining > 0 ? HTTP_BODY_CHUNK_DATA : HTTP_BODY_TRAILER;
+                    body->line_empty = true;
+                } else if (c == ';' || c == ' ' || c == '\t' || c == '\r') {
+                    body->state = HTTP_BODY_CHUNK_EXTENSION;
+                } else if (body->state == HTTP_BODY_CHUNK_SIZE) {
+                    return -400;
+                }
+                break;
+            }
+
+            case HTTP_BODY_CHUNK_END:
+                used++;
+                if (c == '\n') {
+                    body->state = HTTP_BODY_CHUNK_SIZE;
+                    body->line_empty = true;
+                } else if (c != '\r') {
+                    return -400;
+                }
+                break;
+
+            case HTTP_BODY_TRAILER:
+                used++;
+                if (c == '\n') {
+                    if (body->line_empty) body->state = HTTP_BODY_DONE;
+                    body->line_empty = true;
+                } else if (c != '\r') {
+                    body->line_empty = false;
+                }
+                break;
+
+            case HTTP_BODY_DONE:
+                break;
+        }
+    }
+
+    if (body->state == HTTP_BODY_DONE && body->file) rewind(body->file);
+    return (long)used;
+}
+
+void http_body_free(HttpBody* body) {
+    free(body->data);
+    if (body->file) fclose(body->file);
+    body->data = NULL;
+    body->file = NULL;
+}
@@ -1,8 +1,14 @@
 #include "Jweb/native_jweb.h"
-#include "json/native_json.h"
+#include "Jweb/server.h"
+#include "Jweb/static_file.h"
+#include "Jweb/template.h"
+#include "Jweb/response_writer.h"
+#include "json/json_reader.h"
+#include "json/json_writer.h"
 #include <stdio.h>      
 #include <stdlib.h>     
 #include <string.h>     
+#include <strings.h>
 #include <unistd.h>     
 #include <sys/socket.h>  
 #include <netinet/in.h>  
@@ -12,6 +18,8 @@
 #include "eval.h"
 #include "value.h"
 #include "common.h"
+#include "gc.h"
+#include "string_object.h"
 #include <openssl/ssl.h>
 #include <sys/stat.h>
 
@@ -36,23 +44,10 @@ extern Env* global_env;
     {                                                                            \
         if (func != NULL)                                                        \
         {                                                                        \
-            set_var(env, name, (Value){VAL_NATIVE, {.native = func}}, true, ""); \
+            set_var(env, name, NATIVE_VAL(func), true, ""); \
         }                                                                        \
     } while (0)
 
-char* read_file_to_string(const char* filename) {
-    FILE* f = fopen(filename, "rb");
-    if (f == NULL) return NULL;
-    fseek(f, 0, SEEK_END);
-    long fsize = ftell(f);
-    fseek(f, 0, SEEK_SET);
-    char* string = malloc(fsize + 1);
-    fread(string, fsize, 1, f);
-    fclose(f);
-    string[fsize] = 0;
-    return string;
-}
-
 const char* get_mime_type(const char* filename) {
     const char* dot = strrchr(filename, '.');
     if (!dot) return "application/octet-stream";
@@ -68,7 +63,7 @@ const char* get_mime_type(const char* filename) {
     return "text/plain";
 }
 
-static void parse_query_params(HashMap* map, char* query_string) {
+void parse_query_params(HashMap* map, char* query_string) {
     if (!query_string || strlen(query_string) == 0) return;
     char* saveptr1;
     char* pair = strtok_r(query_string, "&", &saveptr1);
@@ -77,122 +72,107 @@ static void parse_query_params(HashMap* map, char* query_string) {
         char* key = strtok_r(pair, "=", &saveptr2);
         char* val = strtok_r(NULL, "=", &saveptr2);
         if (key != NULL) {
-            char* final_val = (val != NULL) ? strdup(val) : strdup("");
-            map_set(map, strdup(key), (Value){VAL_STRING, {.string = final_val}});
+            map_set(map, key, string_copy(val != NULL ? val : ""));
         }
         pair = strtok_r(NULL, "&", &saveptr1);
     }
 }
 
+/* A body spilled to a temporary file stays open until the next request. */
+static FILE* last_body_file = NULL;
+
 void* http_connection_handler(void* arg) {
     HttpThreadArgs* args = (HttpThreadArgs*)arg;
     int client_socket = args->client_socket;
-    
-    char buffer[8192];
-    memset(buffer, 0, sizeof(buffer));
-    
-    ssize_t bytes_read = recv(client_socket, buffer, sizeof(buffer) - 1, 0);
-    if (bytes_read <= 0) {
-        close(client_socket);
-        free(args);
-        return NULL;
+    char address[INET_ADDRSTRLEN];
+    inet_ntop(AF_INET, &args->client_addr.sin_addr, address, sizeof(address));
+    free(args);
+
+    if (last_body_file) {
+        fclose(last_body_file);
+        last_body_file = NULL;
     }
 
-    char method[16], full_path[1024];
-    if (sscanf(buffer, "%15s %1023s", method, full_path) < 2) {
+    char* buffer = NULL;
+    size_t length = 0, capacity = 0, scanned = 0;
+    HttpHead head;
+    HttpBody body;
+    long head_len;
+    while ((head_len = http_parse_head(&head, buffer, length, &scanned, 64 * 1024)) == 0) {
+        if (length + 8192 > capacity) {
+            capacity = capacity ? capacity * 2 : 16384;
+            buffer = realloc(buffer, capacity);
+        }
+        ssize_t n = recv(client_socket, buffer + length, capacity - length, 0);
+        if (n <= 0) break;
+        length += n;
+    }
+    if (head_len <= 0) {
         close(client_socket);
-        free(args);
+        free(buffer);
         return NULL;
     }
+    size_t head_size = (size_t)head_len;
 
-    HashMap* query_map = map_new();
-    char *query_part = strchr(full_path, '?');
-    if (query_part) {
-        *query_part = '\0';
-        parse_query_params(query_map, query_part + 1);
+    /* Decode the body straight out of the receive buffer; only the head stays in it. */
+    http_body_init(&body, &head, 64 * 1024 * 1024);
+    if (capacity < head_size + 16384) {
+        capacity = head_size + 16384;
+        buffer = realloc(buffer, capacity);
     }
-
-    HashMap* headers_map = map_new();
-    char* line = strchr(buffer, '\n');
-    if (line) {
-        line++;
-        while (line && *line != '\r' && *line != '\n') {
-            char* end_line = strchr(line, '\n');
-            if (!end_line) break;
-            char* colon = strchr(line, ':');
-            if (colon && colon < end_line) {
-                int key_len = colon - line;
-                char* key = malloc(key_len + 1);
-                strncpy(key, line, key_len);
-                key[key_len] = '\0';
-                char* val_start = colon + 1;
-                while (*val_start == ' ') val_start++;
-                int val_len = end_line - val_start;
-                if (val_len > 0 && *(end_line - 1) == '\r') val_len--;
-                char* val = malloc(val_len + 1);
-                strncpy(val, val_start, val_len);
-                val[val_len] = '\0';
-                map_set(headers_map, key, (Value){VAL_STRING, {.string = val}});
-            }
-            line = end_line + 1;
+    long used = http_body_feed(&body, buffer + head_size, length - head_size);
+    while (used >= 0 && body.state != HTTP_BODY_DONE) {
+        ssize_t n = recv(client_socket, buffer + head_size, capacity - head_size, 0);
+        if (n <= 0) {
+            used = -1;
+            break;
         }
+        used = http_body_feed(&body, buffer + head_size, n);
     }
-
-    HashMap* req_map = map_new();
-    map_set(req_map, "method", (Value){VAL_STRING, {.string = strdup(method)}});
-    map_set(req_map, "path", (Value){VAL_STRING, {.string = strdup(full_path)}});
-    map_set(req_map, "query", (Value){VAL_MAP, {.map = query_map}});
-    map_set(req_map, "headers", (Value){VAL_MAP, {.map = headers_map}});
-    map_set(req_map, "socket_fd", (Value){VAL_NUMBER, {.number = (double)client_socket}});
-    map_set(req_map, "address", (Value){VAL_STRING, {.string = strdup(inet_ntoa(args->client_addr.sin_addr))}});
-    map_set(req_map, "params", (Value){VAL_MAP, {.map = map_new()}});
-
-    char* body_start = strstr(buffer, "\r\n\r\n");
-    if (body_start) {
-        body_start += 4;
-        Value json_arg = (Value){VAL_STRING, {.string = body_start}};
-        map_set(req_map, "body", native_json_parse(1, &json_arg));
-    } else {
-        map_set(req_map, "body", (Value){VAL_NIL});
+    if (used < 0) {
+        http_body_free(&body);
+        close(client_socket);
+        free(buffer);
+        return NULL;
     }
 
-    free(args);
-    return (void*)req_map; 
+    Value req = http_request_map(&head, buffer, &body, address);
+    map_set(AS_MAP(req), "socket_fd", NUMBER_VAL((double)client_socket));
+    last_body_file = body.file;
+    free(body.data);
+    free(buffer);
+    return (void*)AS_MAP(req);
 }
 
 
 
 Value deserialize_to_jackal(char* buffer, int length) {
-    if (length <= 0) return (Value){VAL_NIL};
+    if (length <= 0) return NIL_VAL;
 
     if (buffer[0] == '{' || buffer[0] == '[') {
-        Value json_arg = (Value){VAL_STRING, {.string = buffer}};
-        
-        return native_json_parse(1, &json_arg);
+        Value result;
+        json_parse(buffer, (size_t)length, &result);
+        return result;
     } 
 
     char* endptr;
     double num = strtod(buffer, &endptr);
     if (endptr != buffer) {
-        Value result;
-        result.type = VAL_NUMBER;
-        result.as.number = num;
-        result.gc_info = NULL;
-        return result;
+        return NUMBER_VAL(num);
     }
 
-    return (Value){VAL_NIL};
+    return NIL_VAL;
 }
 
 Value native_jk_remote_call(int arity, Value* args) {
-    if (arity < 3) return (Value){VAL_NIL};
+    if (arity < 3) return NIL_VAL;
 
     char* ip = AS_CSTRING(args[0]);
-    int port = (int)args[1].as.number;
+    int port = (int)AS_NUMBER(args[1]);
     char* func_name = AS_CSTRING(args[2]);
 
     int sock = socket(AF_INET, SOCK_STREAM, 0);
-    if (sock < 0) return (Value){VAL_NIL};
+    if (sock < 0) return NIL_VAL;
 
     struct sockaddr_in serv_addr;
     memset(&serv_addr, 0, sizeof(serv_addr));
@@ -201,12 +181,12 @@ Value native_jk_remote_call(int arity, Value* args) {
     
     if (inet_pton(AF_INET, ip, &serv_addr.sin_addr) <= 0) {
         close(sock);
-        return (Value){VAL_NIL};
+        return NIL_VAL;
     }
 
     if (connect(sock, (struct sockaddr *)&serv_addr, sizeof(serv_addr)) < 0) {
         close(sock);
-        return (Value){VAL_NIL};
+        return NIL_VAL;
     }
 
     send(sock, func_name, strlen(func_name), 0);
@@ -218,7 +198,7 @@ Value native_jk_remote_call(int arity, Value* args) {
 
     if (bytes_received <= 0) {
         free(buffer);
-        return (Value){VAL_NIL};
+        return NIL_VAL;
     }
 
     buffer[bytes_received] = '\0';
@@ -233,27 +213,24 @@ void* async_send_thread(void* arg) {
     Value data_to_encode = async_data->data;
     int client_socket = async_data->client_socket;
 
-    Value json_str_val = builtin_json_encode(1, &data_to_encode);
+    size_t body_len;
+    const char* json_body = json_encode(data_to_encode, &body_len);
 
-    if (json_str_val.type == VAL_STRING) {
-        char* json_body = json_str_val.as.string;
-        size_t body_len = strlen(json_body);
-        
-        char header[512];
-        int header_len = snprintf(header, sizeof(header), 
-            "HTTP/1.1 200 OK\r\n"
-            "Content-Type: application/json\r\n"
-            "Content-Length: %zu\r\n"
-            "Connection: close\r\n\r\n", body_len);
+    char header[512];
+    int header_len = snprintf(header, sizeof(header), 
+        "HTTP/1.1 200 OK\r\n"
+        "Content-Type: application/json\r\n"
+        "Content-Length: %zu\r\n"
+        "Connection: close\r\n\r\n", body_len);
 
-        if (header_len > 0) {
-            send(client_socket, header, header_len, 0);
-            send(client_socket, json_body, body_len, 0);
-        }
+    if (header_len > 0) {
+        struct iovec iov[2] = {{header, (size_t)header_len}, {(void*)json_body, body_len}};
+        http_send_iov(client_socket, iov, 2);
     }
 
     close(client_socket);
     free(async_data);
+    gc_thread_end();
     return NULL;
 }
 
@@ -261,16 +238,16 @@ void* async_send_thread(void* arg) {
 
 
 Value native_web_listen(int arity, Value* args) {
-    if (arity < 1 || args[0].type != VAL_NUMBER) return (Value){VAL_NIL};
-    int port = (int)args[0].as.number;
+    if (arity < 1 || VALUE_TYPE(args[0]) != VAL_NUMBER) return NIL_VAL;
+    int port = (int)AS_NUMBER(args[0]);
 
     global_server_fd = socket(AF_INET, SOCK_STREAM, 0);
-    if (global_server_fd == -1) return (Value){VAL_BOOL, {.boolean = false}};
+    if (global_server_fd == -1) return BOOL_VAL(false);
 
     int opt = 1;
     if (setsockopt(global_server_fd, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt)) < 0) {
         close(global_server_fd);
-        return (Value){VAL_BOOL, {.boolean = false}};
+        return BOOL_VAL(false);
     }
 
     struct sockaddr_in address;
@@ -281,24 +258,24 @@ Value native_web_listen(int arity, Value* args) {
 
     if (bind(global_server_fd, (struct sockaddr *)&address, sizeof(address)) < 0) {
         close(global_server_fd);
-        return (Value){VAL_BOOL, {.boolean = false}};
+        return BOOL_VAL(false);
     }
 
     if (listen(global_server_fd, SOMAXCONN) < 0) {
         close(global_server_fd);
-        return (Value){VAL_BOOL, {.boolean = false}};
+        return BOOL_VAL(false);
     }
 
-    return (Value){VAL_BOOL, {.boolean = true}};
+    return BOOL_VAL(true);
 }
 Value native_web_poll(int arity, Value* args) {
-    if (global_server_fd == -1) return (Value){VAL_NIL};
+    if (global_server_fd == -1) return NIL_VAL;
 
     struct sockaddr_in client_addr;
     socklen_t addrlen = sizeof(client_addr);
     int client_socket = accept(global_server_fd, (struct sockaddr *)&client_addr, &addrlen);
     
-    if (client_socket < 0) return (Value){VAL_NIL};
+    if (client_socket < 0) return NIL_VAL;
 
     struct timeval tv;
     tv.tv_sec = 5;
@@ -312,88 +289,89 @@ Value native_web_poll(int arity, Value* args) {
 
     HashMap* req_map = (HashMap*)http_connection_handler(thread_args);
     
-    if (req_map == NULL) return (Value){VAL_NIL};
+    if (req_map == NULL) return NIL_VAL;
     
-    return (Value){VAL_MAP, {.map = req_map}};
+    return MAP_VAL(req_map);
 }
 
 Value native_web_send_response(int arity, Value* args) {
-    if (arity < 2) return (Value){VAL_NIL};
+    if (arity < 2) return NIL_VAL;
 
     Value socket_val;
-    if (args[0].type == VAL_MAP) {
-        if (!map_get(args[0].as.map, "socket_fd", &socket_val)) return (Value){VAL_NIL};
+    if (VALUE_TYPE(args[0]) == VAL_MAP) {
+        if (!map_get(AS_MAP(args[0]), "socket_fd", &socket_val)) return NIL_VAL;
     } else {
         socket_val = args[0];
     }
-    int client_socket = (int)socket_val.as.number;
+    int client_socket = (int)AS_NUMBER(socket_val);
 
     AsyncResponseData* async_data = malloc(sizeof(AsyncResponseData));
     async_data->client_socket = client_socket;
     async_data->data = args[1];
 
     pthread_t thread;
+    gc_thread_begin();
     pthread_create(&thread, NULL, async_send_thread, async_data);
     pthread_detach(thread);
 
-    return (Value){VAL_BOOL, {.boolean = true}};
+    return BOOL_VAL(true);
 }
 
 Value native_middleware_auth(int arity, Value* args) {
-    if (arity < 1 || args[0].type != VAL_MAP) return (Value){VAL_NIL};
+    if (arity < 1 || VALUE_TYPE(args[0]) != VAL_MAP) return NIL_VAL;
 
-    HashMap* req = args[0].as.map;
+    HashMap* req = AS_MAP(args[0]);
     Value headers_val;
     
-    if (map_get(req, "headers", &headers_val) && headers_val.type == VAL_MAP) {
+    if (map_get(req, "headers", &headers_val) && VALUE_TYPE(headers_val) == VAL_MAP) {
         Value auth_token;
-        if (map_get(headers_val.as.map, "Authorization", &auth_token)) {
-            if (auth_token.type == VAL_STRING && strcmp(auth_token.as.string, "Secret-Jackal-Key") == 0) {
-                return (Value){VAL_NIL};
+        if (map_get(AS_MAP(headers_val), "Authorization", &auth_token)) {
+            if (VALUE_TYPE(auth_token) == VAL_STRING && strcmp(AS_STRING(auth_token), "Secret-Jackal-Key") == 0) {
+                return NIL_VAL;
             }
         }
     }
 
     HashMap* error_res = map_new();
-    map_set(error_res, "error", (Value){VAL_STRING, {.string = strdup("Unauthorized")}});
-    map_set(error_res, "status", (Value){VAL_NUMBER, {.number = 401}});
+    map_set(error_res, "error", string_copy("Unauthorized"));
+    map_set(error_res, "status", NUMBER_VAL(401));
     
-    return (Value){VAL_MAP, {.map = error_res}};
+    return MAP_VAL(error_res);
 }
 
 Value native_web_redirect(int arity, Value* args) {
-    if (arity < 2 || args[1].type != VAL_STRING) return (Value){VAL_NIL};
+    if (arity < 2 || VALUE_TYPE(args[1]) != VAL_STRING) return NIL_VAL;
     int client_socket;
-    if (args[0].type == VAL_MAP) {
+    if (VALUE_TYPE(args[0]) == VAL_MAP) {
         Value socket_val;
-        if (!map_get(args[0].as.map, "socket_fd", &socket_val)) return (Value){VAL_NIL};
-        client_socket = (int)socket_val.as.number;
+        if (!map_get(AS_MAP(args[0]), "socket_fd", &socket_val)) return NIL_VAL;
+        client_socket = (int)AS_NUMBER(socket_val);
     } else {
-        client_socket = (int)args[0].as.number;
+        client_socket = (int)AS_NUMBER(args[0]);
     }
-    char* target_url = args[1].as.string;
+    char* target_url = AS_STRING(args[1]);
     char response[1024];
     int len = sprintf(response, "HTTP/1.1 302 Found\r\nLocation: %s\r\nContent-Length: 0\r\nConnection: close\r\n\r\n", target_url);
     send(client_socket, response, len, 0);
     close(client_socket);
-    return (Value){VAL_BOOL, {.boolean = true}};
+    return BOOL_VAL(true);
 }
 
 Value native_match_route(int arity, Value *args) {
-    if (arity < 2) return (Value){VAL_BOOL, {.boolean = 0}};
-    const char* path = (arity == 3) ? args[1].as.string : args[0].as.string;
-    const char* pattern = (arity == 3) ? args[2].as.string : args[1].as.string;
-    if (strcmp(path, pattern) == 0) return (Value){VAL_BOOL, {.boolean = 1}};
+    if (arity < 2) return BOOL_VAL(0);
+    const char* path = (arity == 3) ? AS_STRING(args[1]) : AS_STRING(args[0]);
+    const char* pattern = (arity == 3) ? AS_STRING(args[2]) : AS_STRING(args[1]);
+    if (strcmp(path, pattern) == 0) return BOOL_VAL(1);
     const char* p = path;
     const char* pt = pattern;
     HashMap* params = NULL;
     if (arity == 3) {
         Value existing_params;
-        if (map_get(args[0].as.map, "params", &existing_params) && existing_params.type == VAL_MAP) {
-            params = existing_params.as.map;
+        if (map_get(AS_MAP(args[0]), "params", &existing_params) && VALUE_TYPE(existing_params) == VAL_MAP) {
+            params = AS_MAP(existing_params);
         } else {
             params = map_new();
-            map_set(args[0].as.map, "params", (Value){VAL_MAP, {.map = params}});
+            map_set(AS_MAP(args[0]), "params", MAP_VAL(params));
         }
     }
     while (*p != '\0' && *pt != '\0') {
@@ -405,399 +383,24 @@ Value native_match_route(int arity, Value *args) {
             const char* start_v = p;
             while (*p != '/' && *p != '\0') p++;
             char val[256] = {0}; strncpy(val, start_v, p - start_v);
-            if (params) map_set(params, strdup(key), (Value){VAL_STRING, {.string = strdup(val)}});
+            if (params) map_set(params, key, string_copy(val));
         } else {
-            if (*p != *pt) return (Value){VAL_BOOL, {.boolean = 0}};
+            if (*p != *pt) return BOOL_VAL(0);
             p++; pt++;
         }
     }
-    return (Value){VAL_BOOL, {.boolean = (*p == '\0' && *pt == '\0')}};
+    return BOOL_VAL((*p == '\0' && *pt == '\0'));
 }
-char* clean_section_tags(char* content) {
-    char *tags[] = {"@section", "@endsection", NULL};
-    for (int i = 0; tags[i] != NULL; i++) {
-        char *pos;
-        while ((pos = strstr(content, tags[i]))) {
-            char *line_end = strchr(pos, '\n');
-            if (!line_end) line_end = pos + strlen(pos);
-            
-            int prefix_len = pos - content;
-            int suffix_len = strlen(line_end);
-            char *new_content = malloc(prefix_len + suffix_len + 1);
-            
-            memcpy(new_content, content, prefix_len);
-            strcpy(new_content + prefix_len, line_end);
-            
-            free(content);
-            content = new_content;
-        }
-    }
-    return content;
-}
-char* extract_section_content(const char* content, const char* section_name) {
-    char start_tag[128];
-    snprintf(start_tag, sizeof(start_tag), "@section(\"%s\")", section_name);
-    
-    char *start_pos = strstr(content, start_tag);
-    if (!start_pos) return strdup("");
-
-    char *block_start = strchr(start_pos, ')') + 1;
-    char *end_pos = strstr(block_start, "@endsection");
-    if (!end_pos) return strdup("");
-
-    int len = end_pos - block_start;
-    char *result = malloc(len + 1);
-    memcpy(result, block_start, len);
-    result[len] = '\0';
-    
-    return result;
-}
-
-
-char* evaluate_template_yields(char* layout_content, const char* child_content) {
-    char *start;
-    while ((start = strstr(layout_content, "@yield"))) {
-        char *open_p = strchr(start, '(');
-        char *close_p = strchr(start, ')');
-        if (!open_p || !close_p) break;
-
-        char section_name[128];
-        sscanf(open_p, "(\"%[^\"]\")", section_name);
-
-        char *replacement = extract_section_content(child_content, section_name);
-        
-        int prefix_len = start - layout_content;
-        int replacement_len = strlen(replacement);
-        int suffix_len = strlen(close_p + 1);
-
-        char *new_content = malloc(prefix_len + replacement_len + suffix_len + 1);
-        memcpy(new_content, layout_content, prefix_len);
-        memcpy(new_content + prefix_len, replacement, replacement_len);
-        strcpy(new_content + prefix_len + replacement_len, close_p + 1);
-
-        free(replacement);
-        free(layout_content);
-        layout_content = new_content;
-    }
-    return layout_content;
-}
-
-char* render_sub_block(const char* template, const char* alias, Value item) {
-    char *result = strdup(template);
-    
-    char raw_placeholder[128];
-    snprintf(raw_placeholder, sizeof(raw_placeholder), "{{%s}}", alias);
-    
-    char *item_val_str = value_to_string(item);
-    char *raw_pos;
-    while ((raw_pos = strstr(result, raw_placeholder))) {
-        int prefix_len = raw_pos - result;
-        int replace_len = strlen(raw_placeholder);
-        int val_len = strlen(item_val_str);
-        
-        char *new_res = malloc(strlen(result) - replace_len + val_len + 1);
-        memcpy(new_res, result, prefix_len);
-        memcpy(new_res + prefix_len, item_val_str, val_len);
-        strcpy(new_res + prefix_len + val_len, raw_pos + replace_len);
-        
-        free(result);
-        result = new_res;
-    }
-    free(item_val_str);
-
-    if (item.type == VAL_MAP) {
-        HashMap *item_map = item.as.map;
-        for (int i = 0; i < item_map->capacity; i++) {
-            Entry *entry = &item_map->entries[i];
-            if (entry->key == NULL) continue;
-
-            char placeholder[128];
-            snprintf(placeholder, sizeof(placeholder), "{{%s.%s}}", alias, entry->key);
-
-            char *val_str = value_to_string(entry->value);
-            char *pos;
-            while ((pos = strstr(result, placeholder))) {
-                int prefix_len = pos - result;
-                int replace_len = strlen(placeholder);
-                int val_len = strlen(val_str);
-                
-                char *new_res = malloc(strlen(result) - replace_len + val_len + 1);
-                memcpy(new_res, result, prefix_len);
-                memcpy(new_res + prefix_len, val_str, val_len);
-                strcpy(new_res + prefix_len + val_len, pos + replace_len);
-                
-                free(result);
-                result = new_res;
-            }
-            free(val_str);
-        }
-    }
-    return result;
-}
-
-char* evaluate_template_includes(char* content) {
-    char *start;
-    while ((start = strstr(content, "@include"))) {
-        char *open_paren = strchr(start, '(');
-        char *close_paren = strchr(start, ')');
-        if (!open_paren || !close_paren || open_paren > close_paren) break;
-
-        char filename[128];
-        char *quote_start = strpbrk(open_paren, "\"'");
-        char *quote_end = quote_start ? strpbrk(quote_start + 1, "\"'") : NULL;
-
-        if (!quote_start || !quote_end || quote_end > close_paren) break;
-
-        int name_len = quote_end - quote_start - 1;
-        strncpy(filename, quote_start + 1, name_len);
-        filename[name_len] = '\0';
-
-        char *include_content = read_file_to_string(filename);
-        if (!include_content) include_content = strdup("");
-
-        int prefix_len = (int)(start - content);
-        int include_len = (int)strlen(include_content);
-        int suffix_len = (int)strlen(close_paren + 1);
-
-        char *new_content = malloc(prefix_len + include_len + suffix_len + 1);
-        if (!new_content) {
-            free(include_content);
-            break;
-        }
-
-        memcpy(new_content, content, prefix_len);
-        memcpy(new_content + prefix_len, include_content, include_len);
-        strcpy(new_content + prefix_len + include_len, close_paren + 1);
-
-        free(include_content);
-        free(content);
-        content = new_content;
-    }
-    return content;
-}
-
-char* evaluate_template_loop(char* content, HashMap* data) {
-    char *start;
-    while ((start = strstr(content, "@for"))) {
-        char *end = strstr(start, "@endfor");
-        if (!end) break;
-
-        char list_name[64], item_alias[64];
-        char *open_p = strchr(start, '(');
-        char *close_p = strchr(start, ')');
-        if (!open_p || !close_p || open_p > close_p) break;
-
-        char loop_inner[128];
-        int inner_len = close_p - open_p - 1;
-        strncpy(loop_inner, open_p + 1, inner_len);
-        loop_inner[inner_len] = '\0';
-
-        if (sscanf(loop_inner, "%s as %s", list_name, item_alias) != 2) break;
-
-        Value list_val;
-        if (!map_get(data, list_name, &list_val) || list_val.type != VAL_ARRAY) {
-            int prefix_len = (int)(start - content);
-            int suffix_len = (int)strlen(end + 7);
-            char *new_content = malloc(prefix_len + suffix_len + 1);
-            memcpy(new_content, content, prefix_len);
-            strcpy(new_content + prefix_len, end + 7);
-            free(content);
-            content = new_content;
-            continue;
-        }
-
-        char *block_start = close_p + 1;
-        int block_len = (int)(end - block_start);
-        char *template_block = strndup(block_start, block_len);
-
-        char *repeated_html = strdup("");
-        ValueArray *items = list_val.as.array;
-
-        for (int i = 0; i < items->count; i++) {
-            char *rendered_item = render_sub_block(template_block, item_alias, items->values[i]);
-            char *temp = malloc(strlen(repeated_html) + strlen(rendered_item) + 1);
-            strcpy(temp, repeated_html);
-            strcat(temp, rendered_item);
-            free(repeated_html);
-            free(rendered_item);
-            repeated_html = temp;
-        }
-
-        int prefix_len = (int)(start - content);
-        int suffix_len = (int)strlen(end + 7);
-        char *final_res = malloc(prefix_len + strlen(repeated_html) + suffix_len + 1);
-        memcpy(final_res, content, prefix_len);
-        memcpy(final_res + prefix_len, repeated_html, strlen(repeated_html));
-        strcpy(final_res + prefix_len + strlen(repeated_html), end + 7);
-
-        free(repeated_html);
-        free(template_block);
-        free(content);
-        content = final_res;
-    }
-    return content;
-}
-
-char* evaluate_template_while(char* content, HashMap* data) {
-    char *start;
-    while ((start = strstr(content, "@while"))) {
-        char *end = strstr(start, "@endwhile");
-        if (!end) break;
-
-        char condition[128];
-        if (sscanf(start, "@while(%[^)])", condition) != 1) break;
-
-        char *block_start = strstr(start, ")") + 1;
-        int block_len = (int)(end - block_start);
-        char *template_block = strndup(block_start, block_len);
-
-        char *repeated_html = strdup("");
-        
-        while (1) {
-            Value val;
-            if (!map_get(data, condition, &val) || !is_value_truthy(val)) break;
-
-            char *rendered = strdup(template_block);
-            char *temp = malloc(strlen(repeated_html) + strlen(rendered) + 1);
-            strcpy(temp, repeated_html);
-            strcat(temp, rendered);
-            
-            free(repeated_html);
-            free(rendered);
-            repeated_html = temp;
-
-            break; 
-        }
-
-        int prefix_len = (int)(start - content);
-        int suffix_len = (int)strlen(end + 9);
-        char *final_res = malloc(prefix_len + strlen(repeated_html) + suffix_len + 1);
-        
-        memcpy(final_res, content, prefix_len);
-        memcpy(final_res + prefix_len, repeated_html, strlen(repeated_html));
-        strcpy(final_res + prefix_len + strlen(repeated_html), end + 9);
-
-        free(repeated_html);
-        free(template_block);
-        free(content);
-        content = final_res;
-    }
-    return content;
-}
-
-char* evaluate_template_routes(char* content) {
-    if (!content) return NULL;
-
-    char *start;
-    while ((start = strstr(content, "{{route("))) {
-        char *end = strstr(start, ")}}");
-        if (!end) break;
-
-        char route_name[64] = {0};
-        if (sscanf(start, "{{route('%[^']')}}", route_name) != 1) {
-            if (sscanf(start, "{{route(\"%[^\"]\")}}", route_name) != 1) break;
-        }
-
-        char *url = "#";
-        if (strcmp(route_name, "dashboard") == 0) url = "/";
-        else if (strcmp(route_name, "profile") == 0) url = "/api/profile";
-        else if (strcmp(route_name, "logout") == 0) url = "/auth/logout";
-
-        int prefix_len = (int)(start - content);
-        int url_len = (int)strlen(url);
-        int suffix_len = (int)strlen(end + 3);
-
-        char *new_content = malloc(prefix_len + url_len + suffix_len + 1);
-        if (!new_content) break;
-
-        memcpy(new_content, content, prefix_len);
-        memcpy(new_content + prefix_len, url, url_len);
-        strcpy(new_content + prefix_len + url_len, end + 3);
-
-        free(content);
-        content = new_content;
-    }
-    return content;
-}
-
-char* evaluate_template_components(char* content, HashMap* data) {
-    char *start;
-    while ((start = strstr(content, "@component"))) {
-        char *end = strstr(start, "@endcomponent");
-        if (!end) break;
-
-        char comp_path[128];
-        if (sscanf(start, "@component(\"%[^\"]\")", comp_path) != 1) break;
-
-        char *comp_content = read_file_to_string(comp_path);
-        if (!comp_content) {
-            memset(start, ' ', (end + 13) - start);
-            continue;
-        }
-
-        char *block_start = strchr(start, ')') + 1;
-        int block_len = end - block_start;
-        char *slot_content = strndup(block_start, block_len);
-
-        for (int i = 0; i < data->capacity; i++) {
-            Entry *entry = &data->entries[i];
-            if (entry->key == NULL) continue;
-            char placeholder[256];
-            snprintf(placeholder, sizeof(placeholder), "{{%s}}", entry->key);
-            char *val_str = value_to_string(entry->value);
-            char *pos;
-            while ((pos = strstr(comp_content, placeholder))) {
-                int p_len = strlen(placeholder);
-                int v_len = strlen(val_str);
-                char *tmp = malloc(strlen(comp_content) - p_len + v_len + 1);
-                int pref = pos - comp_content;
-                memcpy(tmp, comp_content, pref);
-                memcpy(tmp + pref, val_str, v_len);
-                strcpy(tmp + pref + v_len, pos + p_len);
-                free(comp_content);
-                comp_content = tmp;
-            }
-            free(val_str);
-        }
-
-        char *slot_pos = strstr(comp_content, "{{slot}}");
-        if (slot_pos) {
-            int s_len = 8;
-            int v_len = strlen(slot_content);
-            char *tmp = malloc(strlen(comp_content) - s_len + v_len + 1);
-            int pref = slot_pos - comp_content;
-            memcpy(tmp, comp_content, pref);
-            memcpy(tmp + pref, slot_content, v_len);
-            strcpy(tmp + pref + v_len, slot_pos + s_len);
-            free(comp_content);
-            comp_content = tmp;
-        }
-
-        int prefix_len = start - content;
-        int suffix_len = strlen(end + 13);
-        char *new_content = malloc(prefix_len + strlen(comp_content) + suffix_len + 1);
-        memcpy(new_content, content, prefix_len);
-        strcpy(new_content + prefix_len, comp_content);
-        strcpy(new_content + prefix_len + strlen(comp_content), end + 13);
-
-        free(comp_content);
-        free(slot_content);
-        free(content);
-        content = new_content;
-    }
-    return content;
-}
-
 Value native_web_send_docs(int arity, Value* args) {
-    if (arity < 1) return (Value){VAL_NIL};
+    if (arity < 1) return NIL_VAL;
     
     int client_socket;
-    if (args[0].type == VAL_MAP) {
+    if (VALUE_TYPE(args[0]) == VAL_MAP) {
         Value socket_val;
-        if (!map_get(args[0].as.map, "socket_fd", &socket_val)) return (Value){VAL_NIL};
-        client_socket = (int)socket_val.as.number;
+        if (!map_get(AS_MAP(args[0]), "socket_fd", &socket_val)) return NIL_VAL;
+        client_socket = (int)AS_NUMBER(socket_val);
     } else {
-        client_socket = (int)args[0].as.number;
+        client_socket = (int)AS_NUMBER(args[0]);
     }
 
     const char* html = 
@@ -814,190 +417,35 @@ Value native_web_send_docs(int arity, Value* args) {
 
     send(client_socket, html, strlen(html), 0);
     close(client_socket);
-    return (Value){VAL_BOOL, {.boolean = true}};
-}
-
-char* evaluate_template_logic(char* content, HashMap* data) {
-    char *start;
-    while ((start = strstr(content, "@if"))) {
-        char *end = strstr(start, "@endif");
-        if (!end) break;
-
-        char condition[128];
-        if (sscanf(start, "@if(%[^)])", condition) != 1) {
-            if (sscanf(start, "@if (%[^)])", condition) != 1) break;
-        }
-
-        Value val;
-        bool is_true = false;
-        if (map_get(data, condition, &val)) {
-            if (val.type == VAL_BOOL) is_true = val.as.boolean;
-            else if (val.type == VAL_STRING) is_true = strlen(val.as.string) > 0;
-            else if (val.type == VAL_NUMBER) is_true = val.as.number != 0;
-        }
-
-        char *block_start = strstr(start, ")") + 1;
-        char *else_p = strstr(block_start, "@else");
-        if (else_p && else_p > end) else_p = NULL;
-
-        char *selected_text = NULL;
-        int selected_len = 0;
-
-        if (is_true) {
-            char *limit = else_p ? else_p : end;
-            selected_len = limit - block_start;
-            selected_text = malloc(selected_len + 1);
-            memcpy(selected_text, block_start, selected_len);
-            selected_text[selected_len] = '\0';
-        } else if (else_p) {
-            char *else_content_start = else_p + 5;
-            selected_len = end - else_content_start;
-            selected_text = malloc(selected_len + 1);
-            memcpy(selected_text, else_content_start, selected_len);
-            selected_text[selected_len] = '\0';
-        } else {
-            selected_text = strdup("");
-            selected_len = 0;
-        }
-
-        int prefix_len = start - content;
-        int suffix_len = strlen(end + 6);
-        char *new_content = malloc(prefix_len + selected_len + suffix_len + 1);
-
-        memcpy(new_content, content, prefix_len);
-        memcpy(new_content + prefix_len, selected_text, selected_len);
-        strcpy(new_content + prefix_len + selected_len, end + 6);
-
-        free(selected_text);
-        free(content);
-        content = new_content;
-    }
-    return content;
-}
-
-char* evaluate_template_stacks(char* layout_content, const char* child_content) {
-    char *stack_ptr;
-    while ((stack_ptr = strstr(layout_content, "@stack"))) {
-        char *open_p = strchr(stack_ptr, '(');
-        char *close_p = strchr(stack_ptr, ')');
-        if (!open_p || !close_p) break;
-
-        char stack_name[64];
-        sscanf(open_p, "(\"%[^\"]\")", stack_name);
-
-        char push_tag[128];
-        snprintf(push_tag, sizeof(push_tag), "@push(\"%s\")", stack_name);
-        
-        char *push_start = strstr(child_content, push_tag);
-        char *accumulated_push = strdup("");
-
-        if (push_start) {
-            char *block_start = strchr(push_start, ')') + 1;
-            char *push_end = strstr(block_start, "@endpush");
-            if (push_end) {
-                int len = push_end - block_start;
-                free(accumulated_push);
-                accumulated_push = strndup(block_start, len);
-            }
-        }
-
-        int prefix_len = stack_ptr - layout_content;
-        int push_len = strlen(accumulated_push);
-        int suffix_len = strlen(close_p + 1);
-
-        char *new_res = malloc(prefix_len + push_len + suffix_len + 1);
-        memcpy(new_res, layout_content, prefix_len);
-        memcpy(new_res + prefix_len, accumulated_push, push_len);
-        strcpy(new_res + prefix_len + push_len, close_p + 1);
-
-        free(accumulated_push);
-        free(layout_content);
-        layout_content = new_res;
-    }
-    return layout_content;
+    return BOOL_VAL(true);
 }
 
-
+/**
+ * Native '__render_file__': renders a template file.
+ * @param args[0] The template's path.
+ * @param args[1] A map of values for it (optional).
+ * @return The page, or nil if the file cannot be read.
+ */
 Value native_render_file(int arity, Value *args) {
-    if (arity < 1 || args[0].type != VAL_STRING) return (Value){VAL_NIL};
-
-    char *child_content = read_file_to_string(args[0].as.string);
-    if (!child_content) return (Value){VAL_NIL};
-
-    char *final_content = NULL;
-    char *extends_pos = strstr(child_content, "@extends");
-    
-    if (extends_pos == child_content) {
-        char layout_file[128];
-        if (sscanf(extends_pos, "@extends(\"%[^\"]\")", layout_file) == 1) {
-            char *layout_content = read_file_to_string(layout_file);
-            if (layout_content) {
-                final_content = evaluate_template_yields(layout_content, child_content);
-                final_content = evaluate_template_stacks(final_content, child_content);
-                free(child_content);
-            } else {
-                final_content = child_content;
-            }
-        } else {
-            final_content = child_content;
-        }
-    } else {
-        final_content = child_content;
-    }
-
-    final_content = evaluate_template_includes(final_content);
-    final_content = evaluate_template_routes(final_content);
+    if (arity < 1 || VALUE_TYPE(args[0]) != VAL_STRING) return NIL_VAL;
 
-    if (arity >= 2 && args[1].type == VAL_MAP) {
-        HashMap *data = args[1].as.map;
+    HashMap* data = arity >= 2 && VALUE_TYPE(args[1]) == VAL_MAP ? AS_MAP(args[1]) : NULL;
+    size_t length;
+    char* page = template_render_file(AS_STRING(args[0]), data, &length);
+    if (page == NULL) return NIL_VAL;
 
-        final_content = evaluate_template_components(final_content, data);
-        final_content = evaluate_template_while(final_content, data);
-        final_content = evaluate_template_loop(final_content, data);
-        final_content = evaluate_template_logic(final_content, data);
-
-        for (int i = 0; i < data->capacity; i++) {
-            Entry *entry = &data->entries[i];
-            if (entry->key == NULL) continue;
-
-            char placeholder[256];
-            snprintf(placeholder, sizeof(placeholder), "{{%s}}", entry->key);
-            char *val_str = value_to_string(entry->value);
-            char *pos;
-            
-            while ((pos = strstr(final_content, placeholder))) {
-                int prefix_len = pos - final_content;
-                int replace_len = strlen(placeholder);
-                int val_len = strlen(val_str);
-                
-                char *new_res = malloc(strlen(final_content) - replace_len + val_len + 1);
-                memcpy(new_res, final_content, prefix_len);
-                memcpy(new_res + prefix_len, val_str, val_len);
-                strcpy(new_res + prefix_len + val_len, pos + replace_len);
-                
-                free(final_content);
-                final_content = new_res;
-            }
-            free(val_str);
-        }
-    }
-
-    final_content = clean_section_tags(final_content);
-
-    Value res;
-    res.type = VAL_STRING;
-    res.as.string = final_content;
-    res.gc_info = NULL;
+    Value res = string_new(page, length);
+    free(page);
     return res;
 }
 
 Value native_send_html(int arity, Value *args) {
-    if (arity != 2 || args[0].type != VAL_NUMBER || args[1].type != VAL_STRING) {
-        return (Value){VAL_NIL};
+    if (arity != 2 || VALUE_TYPE(args[0]) != VAL_NUMBER || VALUE_TYPE(args[1]) != VAL_STRING) {
+        return NIL_VAL;
     }
 
-    int client_socket = (int)args[0].as.number;
-    const char *html_content = args[1].as.string;
+    int client_socket = (int)AS_NUMBER(args[0]);
+    const char *html_content = AS_STRING(args[1]);
     size_t content_len = strlen(html_content);
 
     char header[512];
@@ -1009,23 +457,22 @@ Value native_send_html(int arity, Value *args) {
         "Connection: close\r\n\r\n", 
         content_len);
 
-    send(client_socket, header, header_len, 0);
-
-    send(client_socket, html_content, content_len, 0);
+    struct iovec iov[2] = {{header, (size_t)header_len}, {(void*)html_content, content_len}};
+    http_send_iov(client_socket, iov, 2);
 
-    return (Value){VAL_BOOL, {.boolean = true}};
+    return BOOL_VAL(true);
 }
 Value native_gateway_forward(int arity, Value* args) {
-    if (arity < 3 || args[0].type != VAL_MAP || args[1].type != VAL_STRING || args[2].type != VAL_NUMBER) {
-        return (Value){VAL_BOOL, {.boolean = false}};
+    if (arity < 3 || VALUE_TYPE(args[0]) != VAL_MAP || VALUE_TYPE(args[1]) != VAL_STRING || VALUE_TYPE(args[2]) != VAL_NUMBER) {
+        return BOOL_VAL(false);
     }
 
     Value socket_val;
-    if (!map_get(args[0].as.map, "socket_fd", &socket_val)) return (Value){VAL_BOOL, {.boolean = false}};
-    int client_socket = (int)socket_val.as.number;
+    if (!map_get(AS_MAP(args[0]), "socket_fd", &socket_val)) return BOOL_VAL(false);
+    int client_socket = (int)AS_NUMBER(socket_val);
 
-    char* target_host = args[1].as.string;
-    int target_port = (int)args[2].as.number;
+    char* target_host = AS_STRING(args[1]);
+    int target_port = (int)AS_NUMBER(args[2]);
 
     int service_socket = socket(AF_INET, SOCK_STREAM, 0);
     struct sockaddr_in service_addr;
@@ -1035,17 +482,17 @@ Value native_gateway_forward(int arity, Value* args) {
 
     if (connect(service_socket, (struct sockaddr *)&service_addr, sizeof(service_addr)) < 0) {
         close(service_socket);
-        return (Value){VAL_BOOL, {.boolean = false}};
+        return BOOL_VAL(false);
     }
 
     Value v_method, v_path;
-    map_get(args[0].as.map, "method", &v_method);
-    map_get(args[0].as.map, "path", &v_path);
+    map_get(AS_MAP(args[0]), "method", &v_method);
+    map_get(AS_MAP(args[0]), "path", &v_path);
 
     char req_line[2048];
     int req_len = sprintf(req_line, "%s %s HTTP/1.1\r\nHost: %s\r\nConnection: close\r\n\r\n", 
-        v_method.as.string, 
-        v_path.as.string, 
+        AS_STRING(v_method), 
+        AS_STRING(v_path), 
         target_host);
     
     send(service_socket, req_line, req_len, 0);
@@ -1059,98 +506,129 @@ Value native_gateway_forward(int arity, Value* args) {
     close(service_socket);
     close(client_socket);
 
-    return (Value){VAL_BOOL, {.boolean = true}};
+    return BOOL_VAL(true);
 }
 
 Value native_check_file_change(int arity, Value* args) {
-    if (arity < 1 || args[0].type != VAL_STRING) {
-        return (Value){VAL_BOOL, {.boolean = false}};
+    if (arity < 1 || VALUE_TYPE(args[0]) != VAL_STRING) {
+        return BOOL_VAL(false);
     }
 
-    char* file_path = args[0].as.string;
+    char* file_path = AS_STRING(args[0]);
     struct stat attr;
 
     if (stat(file_path, &attr) == 0) {
         if (last_mtime == 0) {
             last_mtime = attr.st_mtime;
-            return (Value){VAL_BOOL, {.boolean = false}};
+            return BOOL_VAL(false);
         }
 
         if (attr.st_mtime > last_mtime) {
             last_mtime = attr.st_mtime;
-            return (Value){VAL_BOOL, {.boolean = true}};
+            return BOOL_VAL(true);
         }
     }
 
-    return (Value){VAL_BOOL, {.boolean = false}};
+    return BOOL_VAL(false);
+}
+
+/** Reads the headers that decide how a file is sent from a request map. */
+static void static_request_from_map(StaticRequest* sr, HashMap* req) {
+    memset(sr, 0, sizeof(*sr));
+    Value headers, method;
+    if (req && map_get(req, "method", &method) && VALUE_TYPE(method) == VAL_STRING)
+        sr->head_only = strcmp(AS_STRING(method), "HEAD") == 0;
+    if (req == NULL || !map_get(req, "headers", &headers) || VALUE_TYPE(headers) != VAL_MAP) return;
+
+    HashMap* map = AS_MAP(headers);
+    for (int i = 0; i < map->capacity; i++) {
+        const char* key = map->entries[i].key;
+        Value value = map->entries[i].value;
+        if (key == NULL || VALUE_TYPE(value) != VAL_STRING) continue;
+        if (strcasecmp(key, "If-None-Match") == 0) sr->if_none_match = AS_STRING(value);
+        else if (strcasecmp(key, "If-Modified-Since") == 0) sr->if_modified_since = AS_STRING(value);
+        else if (strcasecmp(key, "Range") == 0) sr->range = AS_STRING(value);
+        else if (strcasecmp(key, "If-Range") == 0) sr->if_range = AS_STRING(value);
+    }
 }
 
+/**
+ * Native '__send_file__': answers a request with a file, honouring
+ * If-None-Match, If-Modified-Since and Range. The file comes from the
+ * open-file cache and is sent with sendfile.
+ * @param args[0] The request, or a socket.
+ * @param args[1] The file's path.
+ * @return false if the file does not exist.
+ */
 Value native_web_send_file(int arity, Value* args) {
-    if (arity < 2 || args[1].type != VAL_STRING) return (Value){VAL_NIL, {0}};
+    if (arity < 2 || VALUE_TYPE(args[1]) != VAL_STRING) return NIL_VAL;
 
     int client_socket;
-    if (args[0].type == VAL_MAP) {
+    HashMap* req = NULL;
+    if (VALUE_TYPE(args[0]) == VAL_MAP) {
+        req = AS_MAP(args[0]);
         Value socket_val;
-        if (!map_get(args[0].as.map, "socket_fd", &socket_val)) return (Value){VAL_NIL, {0}};
-        client_socket = (int)socket_val.as.number;
+        if (!map_get(req, "socket_fd", &socket_val)) {
+            /* A __serve__ request: the server sends the file after the handler returns. */
+            return BOOL_VAL(http_job_send_file(AS_STRING(args[1])));
+        }
+        client_socket = (int)AS_NUMBER(socket_val);
     } else {
-        client_socket = (int)args[0].as.number;
+        client_socket = (int)AS_NUMBER(args[0]);
     }
 
-    const char* file_path = args[1].as.string;
-    FILE* f = fopen(file_path, "rb");
-    if (!f) {
+    const char* file_path = AS_STRING(args[1]);
+    StaticFile* file = static_file_open(file_path);
+    if (!file) {
         char* error404 = "HTTP/1.1 404 Not Found\r\nContent-Length: 0\r\nConnection: close\r\n\r\n";
-        send(client_socket, error404, strlen(error404), 0);
+        send(client_socket, error404, strlen(error404), MSG_NOSIGNAL);
         close(client_socket);
-        return (Value){VAL_BOOL, {.boolean = false}};
+        return BOOL_VAL(false);
     }
 
-    fseek(f, 0, SEEK_END);
-    long file_size = ftell(f);
-    fseek(f, 0, SEEK_SET);
+    StaticRequest sr;
+    static_request_from_map(&sr, req);
+    sr.keep_alive = false;
 
-    char header[512];
-    int header_len = snprintf(header, sizeof(header),
-        "HTTP/1.1 200 OK\r\n"
-        "Content-Type: %s\r\n"
-        "Content-Length: %ld\r\n"
-        "Connection: close\r\n\r\n", 
-        get_mime_type(file_path), file_size);
-    
-    send(client_socket, header, header_len, 0);
+    char header[1024];
+    size_t header_len;
+    off_t offset, length;
+    static_file_respond(file, &sr, header, sizeof(header), &header_len, &offset, &length);
 
-    char buffer[8192];
-    size_t bytes_read;
-    while ((bytes_read = fread(buffer, 1, sizeof(buffer), f)) > 0) {
-        send(client_socket, buffer, bytes_read, 0);
+    /* MSG_MORE lets the head share a packet with the start of the file. */
+    send(client_socket, header, header_len, MSG_NOSIGNAL | (length > 0 ? MSG_MORE : 0));
+    while (length > 0) {
+        ssize_t sent = static_file_send(client_socket, file, &offset, length);
+        if (sent <= 0) break;
+        length -= sent;
     }
 
-    fclose(f);
+    static_file_release(file);
     close(client_socket);
-    return (Value){VAL_BOOL, {.boolean = true}};
+    return BOOL_VAL(true);
 }
 
 Value native_web_send_auto(int arity, Value* args) {
-    if (arity < 2) return (Value){VAL_NIL, {0}};
+    if (arity < 2) return NIL_VAL;
 
     int client_socket;
-    if (args[0].type == VAL_MAP) {
+    if (VALUE_TYPE(args[0]) == VAL_MAP) {
         Value socket_val;
-        if (!map_get(args[0].as.map, "socket_fd", &socket_val)) return (Value){VAL_NIL, {0}};
-        client_socket = (int)socket_val.as.number;
+        if (!map_get(AS_MAP(args[0]), "socket_fd", &socket_val)) return NIL_VAL;
+        client_socket = (int)AS_NUMBER(socket_val);
     } else {
-        client_socket = (int)args[0].as.number;
+        client_socket = (int)AS_NUMBER(args[0]);
     }
 
     Value data = args[1];
 
-    if (data.type == VAL_MAP || data.type == VAL_ARRAY) {
+    if (VALUE_TYPE(data) == VAL_MAP || VALUE_TYPE(data) == VAL_ARRAY) {
         AsyncResponseData* async_data = malloc(sizeof(AsyncResponseData));
         async_data->client_socket = client_socket;
         async_data->data = data;
 
         pthread_t thread;
+        gc_thread_begin();
         pthread_create(&thread, NULL, async_send_thread, async_data);
         pthread_detach(thread);
     } 
@@ -1167,21 +645,21 @@ Value native_web_send_auto(int arity, Value* args) {
             "Content-Length: %zu\r\n"
             "Connection: close\r\n\r\n", content_type, content_len);
 
-        send(client_socket, header, header_len, 0);
-        send(client_socket, raw_content, content_len, 0);
-        
+        struct iovec iov[2] = {{header, (size_t)header_len}, {raw_content, content_len}};
+        http_send_iov(client_socket, iov, 2);
+
         close(client_socket);
         free(raw_content);
     }
 
-    return (Value){VAL_BOOL, {.boolean = true}}; 
+    return BOOL_VAL(true); 
 }
 
 
 Value native_node_listen(int arity, Value* args) {
-    if (arity < 1 || args[0].type != VAL_NUMBER) return (Value){VAL_NIL};
+    if (arity < 1 || VALUE_TYPE(args[0]) != VAL_NUMBER) return NIL_VAL;
     
-    int port = (int)args[0].as.number;
+    int port = (int)AS_NUMBER(args[0]);
     int server_fd = socket(AF_INET, SOCK_STREAM, 0);
     int opt = 1;
     
@@ -1195,7 +673,7 @@ Value native_node_listen(int arity, Value* args) {
     if (bind(server_fd, (struct sockaddr *)&address, sizeof(address)) < 0) {
         perror("[NODE] BIND Failed");
         close(server_fd);
-        return (Value){VAL_BOOL, {.boolean = false}};
+        return BOOL_VAL(false);
     }
     
     listen(server_fd, 5);
@@ -1228,18 +706,14 @@ Value native_node_listen(int arity, Value* args) {
             
             Var* func_var = find_var(global_env, buffer); 
             
-            if (func_var && func_var->value.type == VAL_FUNCTION) {
-                Env* context_env = func_var->value.as.function->env;
+            if (func_var && VALUE_TYPE(func_var->value) == VAL_FUNCTION) {
+                Env* context_env = AS_FUNCTION(func_var->value)->env;
                 if (context_env == NULL) context_env = global_env;
 
                 Value res = call_jackal_function(context_env, func_var->value, 0, NULL);
-                Value json_str_val = builtin_json_encode(1, &res);
-                
-                if (json_str_val.type == VAL_STRING) {
-                    send(new_socket, json_str_val.as.string, strlen(json_str_val.as.string), 0);
-                } else {
-                    send(new_socket, "null", 4, 0);
-                }
+                size_t json_len;
+                const char* json = json_encode(res, &json_len);
+                send(new_socket, json, json_len, 0);
             } else {
                 send(new_socket, "null", 4, 0);
             }
@@ -1248,7 +722,7 @@ Value native_node_listen(int arity, Value* args) {
         fflush(stdout);
         close(new_socket);
     }
-    return (Value){VAL_NIL};
+    return NIL_VAL;
 }
 
 
@@ -2,6 +2,8 @@
 #include "json/native_json.h"
 #include "eval.h"
 #include "value.h"
+#include "gc.h"
+#include "string_object.h"
 
 #include <stdio.h>      
 #include <stdlib.h>     
@@ -14,19 +16,22 @@
 #include <pthread.h>
 
 static HashMap* sessions_storage = NULL;
+static Value sessions_root;
 
 #define JWEB_SESSION_REGISTER(env, name, func)                                           \
     do                                                                           \
     {                                                                            \
         if (func != NULL)                                                        \
         {                                                                        \
-            set_var(env, name, (Value){VAL_NATIVE, {.native = func}}, true, ""); \
+            set_var(env, name, NATIVE_VAL(func), true, ""); \
         }                                                                        \
     } while (0)
 
 static void ensure_session_storage() {
     if (sessions_storage == NULL) {
         sessions_storage = map_new();
+        sessions_root = MAP_VAL(sessions_storage);
+        gc_add_root(&sessions_root);
     }
 }
 
@@ -46,63 +51,65 @@ Value native_session_start(int arity, Value* args) {
     char* sid = generate_sid();
     HashMap* session_data = map_new();
     
-    map_set(sessions_storage, strdup(sid), (Value){VAL_MAP, {.map = session_data}});
-    
-    return (Value){VAL_STRING, {.string = sid}};
+    map_set(sessions_storage, sid, MAP_VAL(session_data));
+
+    Value result = string_copy(sid);
+    free(sid);
+    return result;
 }
 
 Value native_session_set(int arity, Value* args) {
-    if (arity < 3 || args[0].type != VAL_STRING) return (Value){VAL_BOOL, {.boolean = false}};
+    if (arity < 3 || VALUE_TYPE(args[0]) != VAL_STRING) return BOOL_VAL(false);
     ensure_session_storage();
 
-    char* sid = args[0].as.string;
-    char* key = args[1].as.string;
+    char* sid = AS_STRING(args[0]);
+    char* key = AS_STRING(args[1]);
     Value val = args[2];
 
     Value s_map_val;
-    if (map_get(sessions_storage, sid, &s_map_val) && s_map_val.type == VAL_MAP) {
-        map_set(s_map_val.as.map, strdup(key), val);
-        return (Value){VAL_BOOL, {.boolean = true}};
+    if (map_get(sessions_storage, sid, &s_map_val) && VALUE_TYPE(s_map_val) == VAL_MAP) {
+        map_set(AS_MAP(s_map_val), strdup(key), val);
+        return BOOL_VAL(true);
     }
     
-    return (Value){VAL_BOOL, {.boolean = false}};
+    return BOOL_VAL(false);
 }
 
 Value native_session_get(int arity, Value* args) {
-    if (arity < 2 || args[0].type != VAL_STRING) return (Value){VAL_NIL};
+    if (arity < 2 || VALUE_TYPE(args[0]) != VAL_STRING) return NIL_VAL;
     ensure_session_storage();
 
-    char* sid = args[0].as.string;
-    char* key = args[1].as.string;
+    char* sid = AS_STRING(args[0]);
+    char* key = AS_STRING(args[1]);
 
     Value s_map_val;
-    if (map_get(sessions_storage, sid, &s_map_val) && s_map_val.type == VAL_MAP) {
+    if (map_get(sessions_storage, sid, &s_map_val) && VALUE_TYPE(s_map_val) == VAL_MAP) {
         Value result;
-        if (map_get(s_map_val.as.map, key, &result)) {
+        if (map_get(AS_MAP(s_map_val), key, &result)) {
             return result;
         }
     }
     
-    return (Value){VAL_NIL};
+    return NIL_VAL;
 }
 
 Value native_session_destroy(int arity, Value* args) {
-    if (arity < 1 || args[0].type != VAL_STRING) {
-        return (Value){VAL_BOOL, {.boolean = false}};
+    if (arity < 1 || VALUE_TYPE(args[0]) != VAL_STRING) {
+        return BOOL_VAL(false);
     }
 
-    if (sessions_storage == NULL) return (Value){VAL_BOOL, {.boolean = true}};
+    if (sessions_storage == NULL) return BOOL_VAL(true);
 
-    char* sid = args[0].as.string;
+    char* sid = AS_STRING(args[0]);
 
     Value s_map_val;
-    if (map_get(sessions_storage, sid, &s_map_val) && s_map_val.type == VAL_MAP) {
-        map_free(s_map_val.as.map);
+    if (map_get(sessions_storage, sid, &s_map_val) && VALUE_TYPE(s_map_val) == VAL_MAP) {
+        map_free(AS_MAP(s_map_val));
     }
 
     bool success = map_delete(sessions_storage, sid);
 
-    return (Value){VAL_BOOL, {.boolean = success}};
+    return BOOL_VAL(success);
 }
 
 void register_session_native(Env* env){
@@ -0,0 +1,321 @@
+#include "Jweb/response_writer.h"
+#include "Jweb/server.h"
+#include "json/json_writer.h"
+#include "value.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/socket.h>
+
+const char* http_status_text(int status) {
+    switch (status) {
+        case 200: return "OK";
+        case 201: return "Created";
+        case 202: return "Accepted";
+        case 204: return "No Content";
+        case 206: return "Partial Content";
+        case 301: return "Moved Permanently";
+        case 302: return "Found";
+        case 304: return "Not Modified";
+        case 400: return "Bad Request";
+        case 401: return "Unauthorized";
+        case 403: return "Forbidden";
+        case 404: return "Not Found";
+        case 413: return "Payload Too Large";
+        case 431: return "Request Header Fields Too Large";
+        case 500: return "Internal Server Error";
+        case 501: return "Not Implemented";
+        case 503: return "Service Unavailable";
+        default: return "Unknown";
+    }
+}
+
+bool http_send_iov(int socket, struct iovec* iov, int count) {
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    while (count > 0) {
+        msg.msg_iov = iov;
+        msg.msg_iovlen = count;
+        ssize_t n = sendmsg(socket, &msg, MSG_NOSIGNAL);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return false;
+        }
+        while (count > 0 && (size_t)n >= iov->iov_len) {
+            n -= iov->iov_len;
+            iov++;
+            count--;
+        }
+        if (count > 0) {
+            iov->iov_base = (char*)iov->iov_base + n;
+            iov->iov_len -= n;
+        }
+    }
+    return true;
+}
+
+/* ---- Writers ---- */
+
+ResponseWriter* response_writer_new(ResponseSink sink, void* ctx, bool chunked, bool keep_alive, bool head_only) {
+    ResponseWriter* w = calloc(1, sizeof(ResponseWriter));
+    w->sink = sink;
+    w->ctx = ctx;
+    w->status = 200;
+    strcpy(w->content_type, "text/plain");
+    w->chunked = chunked;
+    w->keep_alive = keep_alive && chunked;
+    w->head_only = head_only;
+    return w;
+}
+
+void response_writer_free(ResponseWriter* w) {
+    if (w == NULL) return;
+    free(w->buffer);
+    free(w);
+}
+
+bool response_writer_status(ResponseWriter* w, int status, const char* content_type) {
+    if (w->head_sent) return false;
+    w->status = status;
+    if (content_type) snprintf(w->content_type, sizeof(w->content_type), "%s", content_type);
+    return true;
+}
+
+/**
+ * Sends the head if it is still due, then the buffered body followed by
+ * extra as a single chunk, then the last chunk if the body ends here. All
+ * of it is handed to the sink at once.
+ */
+static bool writer_send(ResponseWriter* w, const char* extra, size_t extra_len, bool last) {
+    if (w->failed) return false;
+
+    char head[512];
+    char size_line[24];
+    static const char crlf[] = "\r\n";
+    static const char last_chunk[] = "0\r\n\r\n";
+    struct iovec iov[6];
+    int count = 0;
+    size_t body_len = w->length + extra_len;
+
+    if (!w->head_sent) {
+        /* Nothing sent yet and nothing more to come: a plain response will do. */
+        char framing[48] = "";
+        if (last) {
+            w->chunked = false;
+            snprintf(framing, sizeof(framing), "Content-Length: %zu\r\n", body_len);
+        } else if (w->chunked) {
+            strcpy(framing, "Transfer-Encoding: chunked\r\n");
+        }
+        int n = snprintf(head, sizeof(head),
+            "HTTP/1.1 %d %s\r\n"
+            "Content-Type: %s\r\n"
+            "%s"
+            "Server: SnapEngine/1.0\r\n"
+            "Connection: %s\r\n\r\n",
+            w->status, http_status_text(w->status), w->content_type, framing, w->keep_alive ? "keep-alive" : "close");
+        iov[count++] = (struct iovec){head, n < (int)sizeof(head) ? (size_t)n : sizeof(head) - 1};
+        w->head_sent = true;
+    }
+
+    if (!w->head_only && body_len > 0) {
+        if (w->chunked) {
+            int n = snprintf(size_line, sizeof(size_line), "%zx\r\n", body_len);
+            iov[count++] = (struct iovec){size_line, (size_t)n};
+        }
+        if (w->length > 0) iov[count++] = (struct iovec){w->buffer, w->length};
+        if (extra_len > 0) iov[count++] = (struct iovec){(void*)extra, extra_len};
+        if (w->chunked) iov[count++] = (struct iovec){(void*)crlf, 2};
+    }
+    if (last && w->chunked && !w->head_only) iov[count++] = (struct iovec){(void*)last_chunk, 5};
+    w->length = 0;
+
+    if (count > 0 && !w->sink(w->ctx, iov, count)) {
+        w->failed = true;
+        return false;
+    }
+    return true;
+}
+
+bool response_writer_write(ResponseWriter* w, const char* data, size_t length) {
+    if (w->ended || w->failed) return false;
+    if (length == 0) return true;
+
+    /* A write that fills the buffer goes out with it, without being copied. */
+    if (w->length + length >= RESPONSE_WRITER_BUFFER) return writer_send(w, data, length, false);
+
+    if (w->buffer == NULL) {
+        w->buffer = malloc(RESPONSE_WRITER_BUFFER);
+        w->capacity = RESPONSE_WRITER_BUFFER;
+    }
+    memcpy(w->buffer + w->length, data, length);
+    w->length += length;
+    return true;
+}
+
+bool response_writer_flush(ResponseWriter* w) {
+    if (w->ended || w->failed) return false;
+    if (w->head_sent && w->length == 0) return true;
+    return writer_send(w, NULL, 0, false);
+}
+
+bool response_writer_end(ResponseWriter* w) {
+    if (w->ended) return !w->failed;
+    w->ended = true;
+    return writer_send(w, NULL, 0, true);
+}
+
+/* ---- Writers of __accept__ requests, by socket ---- */
+
+static ResponseWriter** socket_writers = NULL;
+static int socket_writer_capacity = 0;
+static pthread_mutex_t socket_writers_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static bool socket_sink(void* ctx, struct iovec* iov, int count) {
+    return http_send_iov((int)(intptr_t)ctx, iov, count);
+}
+
+static ResponseWriter* socket_writer(int socket, HashMap* req, bool create) {
+    if (socket < 0) return NULL;
+    pthread_mutex_lock(&socket_writers_lock);
+    if (socket >= socket_writer_capacity && create) {
+        int capacity = socket_writer_capacity < 64 ? 64 : socket_writer_capacity;
+        while (capacity <= socket) capacity *= 2;
+        socket_writers = realloc(socket_writers, sizeof(ResponseWriter*) * capacity);
+        memset(socket_writers + socket_writer_capacity, 0,
+               sizeof(ResponseWriter*) * (capacity - socket_writer_capacity));
+        socket_writer_capacity = capacity;
+    }
+    ResponseWriter* w = socket < socket_writer_capacity ? socket_writers[socket] : NULL;
+    if (w == NULL && create) {
+        Value method;
+        bool head_only = req && map_get(req, "method", &method) && VALUE_TYPE(method) == VAL_STRING &&
+                         strcmp(AS_STRING(method), "HEAD") == 0;
+        w = response_writer_new(socket_sink, (void*)(intptr_t)socket, true, false, head_only);
+        socket_writers[socket] = w;
+    }
+    pthread_mutex_unlock(&socket_writers_lock);
+    return w;
+}
+
+/** Ends a socket's response, then closes the socket as __accept__ responses always do. */
+static bool socket_writer_end(int socket, ResponseWriter* w) {
+    bool ok = response_writer_end(w);
+    pthread_mutex_lock(&socket_writers_lock);
+    socket_writers[socket] = NULL;
+    pthread_mutex_unlock(&socket_writers_lock);
+    response_writer_free(w);
+    close(socket);
+    return ok;
+}
+
+/* ---- Natives ---- */
+
+/**
+ * Finds the writer for a request: an __accept__ request (or its socket)
+ * by its socket, a __serve__ request through the worker running it.
+ * @param socket Receives the socket, or -1.
+ */
+static ResponseWriter* writer_for(Value req, bool create, int* socket) {
+    *socket = -1;
+    if (VALUE_TYPE(req) == VAL_NUMBER) {
+        *socket = (int)AS_NUMBER(req);
+        return socket_writer(*socket, NULL, create);
+    }
+    if (VALUE_TYPE(req) != VAL_MAP) return NULL;
+
+    Value socket_val;
+    if (map_get(AS_MAP(req), "socket_fd", &socket_val) && VALUE_TYPE(socket_val) == VAL_NUMBER) {
+        *socket = (int)AS_NUMBER(socket_val);
+        return socket_writer(*socket, AS_MAP(req), create);
+    }
+    return http_job_writer(create);
+}
+
+/** Writes a value as text, maps and arrays as JSON. */
+static bool writer_write_value(ResponseWriter* w, Value chunk) {
+    if (VALUE_TYPE(chunk) == VAL_NIL) return true;
+    if (VALUE_TYPE(chunk) == VAL_STRING) return response_writer_write(w, AS_STRING(chunk), strlen(AS_STRING(chunk)));
+
+    bool ok;
+    if (VALUE_TYPE(chunk) == VAL_MAP || VALUE_TYPE(chunk) == VAL_ARRAY) {
+        size_t length;
+        const char* json = json_encode(chunk, &length);
+        ok = response_writer_write(w, json, length);
+    } else {
+        char* text = value_to_string(chunk);
+        ok = response_writer_write(w, text, strlen(text));
+        free(text);
+    }
+    return ok;
+}
+
+/**
+ * Native '__stream__': sets the status and Content-Type of a streamed
+ * response before anything has been written.
+ * @param args[0] The request.
+ * @param args[1] Status code.
+ * @param args[2] Content-Type (optional).
+ * @return false if the head has already been sent.
+ */
+Value native_response_stream(int arity, Value* args) {
+    if (arity < 2 || VALUE_TYPE(args[1]) != VAL_NUMBER) return BOOL_VAL(false);
+    int socket;
+    ResponseWriter* w = writer_for(args[0], true, &socket);
+    if (w == NULL) return BOOL_VAL(false);
+    const char* content_type = arity >= 3 && VALUE_TYPE(args[2]) == VAL_STRING ? AS_STRING(args[2]) : NULL;
+    return BOOL_VAL(response_writer_status(w, (int)AS_NUMBER(args[1]), content_type));
+}
+
+/**
+ * Native '__write__': adds to the body of a streamed response.
+ * @param args[0] The request.
+ * @param args[1] Text, or a map or array to write as JSON.
+ * @return false once the client is gone.
+ */
+Value native_response_write(int arity, Value* args) {
+    if (arity < 2) return BOOL_VAL(false);
+    int socket;
+    ResponseWriter* w = writer_for(args[0], true, &socket);
+    if (w == NULL) return BOOL_VAL(false);
+    return BOOL_VAL(writer_write_value(w, args[1]));
+}
+
+/**
+ * Native '__flush__': sends what has been written so far.
+ * @param args[0] The request.
+ */
+Value native_response_flush(int arity, Value* args) {
+    if (arity < 1) return BOOL_VAL(false);
+    int socket;
+    ResponseWriter* w = writer_for(args[0], true, &socket);
+    if (w == NULL) return BOOL_VAL(false);
+    return BOOL_VAL(response_writer_flush(w));
+}
+
+/**
+ * Native '__end__': finishes a streamed response.
+ * @param args[0] The request.
+ * @param args[1] A last piece of the body (optional).
+ */
+Value native_response_end(int arity, Value* args) {
+    if (arity < 1) return BOOL_VAL(false);
+    int socket;
+    ResponseWriter* w = writer_for(args[0], true, &socket);
+    if (w == NULL) return BOOL_VAL(false);
+
+    bool ok = arity < 2 || writer_write_value(w, args[1]);
+    if (socket >= 0) return BOOL_VAL(socket_writer_end(socket, w) && ok);
+    return BOOL_VAL(response_writer_end(w) && ok);
+}
+
+void register_jweb_writer_natives(Env* env) {
+    set_var(env, "__stream__", NATIVE_VAL(native_response_stream), true, "");
+    set_var(env, "__write__", NATIVE_VAL(native_response_write), true, "");
+    set_var(env, "__flush__", NATIVE_VAL(native_response_flush), true, "");
+    set_var(env, "__end__", NATIVE_VAL(native_response_end), true, "");
+}
@@ -0,0 +1,382 @@
+#include "Jweb/router.h"
+#include "value.h"
+#include "gc.h"
+#include "string_object.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+#define ROUTER_MAX_PARAMS 32
+
+typedef struct {
+    char method[16];            // "*" accepts any method
+    Value handler;
+    char** names;               // the route's parameter and wildcard names, in path order
+    int name_count;
+} RouteHandler;
+
+/**
+ * @typedef @struct ROUTENODE
+ * One edge of the trie. Static nodes match their label; the parameter and
+ * wildcard children of a node match a segment and the rest of the path.
+ * Captures are unnamed in the trie, so routes may name the same segment
+ * differently; each handler binds them to its own names by position.
+ */
+typedef struct RouteNode {
+    char* label;                    // static text; NULL for parameter and wildcard nodes
+    size_t label_len;
+    struct RouteNode** children;    // static children, each starting with a different byte
+    char* index;                    // first byte of each child's label, for memchr
+    int child_count;
+    struct RouteNode* param;
+    struct RouteNode* wildcard;
+    RouteHandler* handlers;
+    int handler_count;
+} RouteNode;
+
+typedef struct {
+    RouteNode* root;
+    pthread_rwlock_t lock;          // routes are added under the write lock
+} Router;
+
+typedef struct {
+    const char* value;
+    size_t length;
+} RouteCapture;
+
+typedef struct {
+    RouteCapture captures[ROUTER_MAX_PARAMS];
+    int count;
+} RouteMatch;
+
+static Router** routers = NULL;
+static int router_count = 0;
+static pthread_mutex_t routers_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/* ---- Building ---- */
+
+static RouteNode* node_new(const char* label, size_t label_len) {
+    RouteNode* node = calloc(1, sizeof(RouteNode));
+    if (label) {
+        node->label = strndup(label, label_len);
+        node->label_len = label_len;
+    }
+    return node;
+}
+
+static void node_add_child(RouteNode* node, RouteNode* child) {
+    node->children = realloc(node->children, sizeof(RouteNode*) * (node->child_count + 1));
+    node->index = realloc(node->index, node->child_count + 1);
+    node->children[node->child_count] = child;
+    node->index[node->child_count] = child->label[0];
+    node->child_count++;
+}
+
+/**
+ * Adds static text below node, splitting an edge where the text and an
+ * existing label part ways.
+ * @return The node that ends the text.
+ */
+static RouteNode* insert_static(RouteNode* node, const char* text, size_t length) {
+    while (length > 0) {
+        char* hit = node->child_count > 0 ? memchr(node->index, text[0], node->child_count) : NULL;
+        if (hit == NULL) {
+            RouteNode* child = node_new(text, length);
+            node_add_child(node, child);
+            return child;
+        }
+
+        int slot = hit - node->index;
+        RouteNode* child = node->children[slot];
+        size_t common = 0;
+        while (common < length && common < child->label_len && child->label[common] == text[common]) common++;
+
+        if (common < child->label_len) {
+            RouteNode* split = node_new(child->label, common);
+            char* rest = strndup(child->label + common, child->label_len - common);
+            free(child->label);
+            child->label = rest;
+            child->label_len -= common;
+            node_add_child(split, child);
+            node->children[slot] = split;
+            child = split;
+        }
+
+        node = child;
+        text += common;
+        length -= common;
+    }
+    return node;
+}
+
+static RouteNode* insert_capture(RouteNode** slot) {
+    if (*slot == NULL) *slot = node_new(NULL, 0);
+    return *slot;
+}
+
+static void free_names(char** names, int count) {
+    for (int i = 0; i < count; i++) free(names[i]);
+    free(names);
+}
+
+/** Sets the handler for method, taking ownership of names. */
+static void node_set_handler(RouteNode* node, const char* method, Value handler, char** names, int name_count) {
+    RouteHandler* entry = NULL;
+    for (int i = 0; i < node->handler_count && entry == NULL; i++) {
+        if (strcmp(node->handlers[i].method, method) == 0) entry = &node->handlers[i];
+    }
+    if (entry) {
+        free_names(entry->names, entry->name_count);
+    } else {
+        node->handlers = realloc(node->handlers, sizeof(RouteHandler) * (node->handler_count + 1));
+        entry = &node->handlers[node->handler_count++];
+        snprintf(entry->method, sizeof(entry->method), "%s", method);
+    }
+    entry->handler = copy_value(handler);
+    entry->names = names;
+    entry->name_count = name_count;
+}
+
+/**
+ * Compiles pattern into the trie.
+ * @return false if the pattern is malformed or has more than
+ *         ROUTER_MAX_PARAMS parameters.
+ */
+static bool router_add(Router* router, const char* method, const char* pattern, Value handler) {
+    RouteNode* node = router->root;
+    const char* p = pattern;
+    char** names = malloc(sizeof(char*) * ROUTER_MAX_PARAMS);
+    int name_count = 0;
+    bool valid = true;
+
+    while (*p && valid) {
+        bool wildcard = *p == '*' && p[1] == '\0' && (p == pattern || p[-1] == '/');
+        if ((*p == '{' || wildcard) && name_count == ROUTER_MAX_PARAMS) {
+            valid = false;
+        } else if (*p == '{') {
+            const char* close = strchr(p, '}');
+            if (close == NULL || close == p + 1) {
+                valid = false;
+                continue;
+            }
+            const char* name = p + 1;
+            size_t name_len = close - name;
+            p = close + 1;
+
+            if (name[name_len - 1] == '*') {
+                if (*p != '\0' || name_len == 1) {
+                    valid = false;
+                    continue;
+                }
+                node = insert_capture(&node->wildcard);
+                names[name_count++] = strndup(name, name_len - 1);
+            } else {
+                if (*p != '\0' && *p != '/') {
+                    valid = false;
+                    continue;
+                }
+                node = insert_capture(&node->param);
+                names[name_count++] = strndup(name, name_len);
+            }
+        } else if (wildcard) {
+            node = insert_capture(&node->wildcard);
+            names[name_count++] = strdup("*");
+            p++;
+        } else {
+            const char* stop = p;
+            while (*stop && *stop != '{' && !(*stop == '*' && stop[1] == '\0' && stop[-1] == '/')) stop++;
+            node = insert_static(node, p, stop - p);
+            p = stop;
+        }
+    }
+    if (!valid) {
+        free_names(names, name_count);
+        return false;
+    }
+
+    node_set_handler(node, method, handler, names, name_count);
+    return true;
+}
+
+/* ---- Matching ---- */
+
+static RouteHandler* node_handler(RouteNode* node, const char* method) {
+    RouteHandler* any = NULL;
+    for (int i = 0; i < node->handler_count; i++) {
+        if (strcmp(node->handlers[i].method, method) == 0) return &node->handlers[i];
+        if (node->handlers[i].method[0] == '*') any = &node->handlers[i];
+    }
+    return any;
+}
+
+/**
+ * Matches the rest of a path below node: static edges first, then a
+ * parameter, then a wildcard, backing up when a branch leads nowhere.
+ */
+static RouteHandler* match_node(RouteNode* node, const char* path, size_t length, const char* method, RouteMatch* match) {
+    if (length == 0) {
+        RouteHandler* handler = node_handler(node, method);
+        if (handler) return handler;
+    } else {
+        char* hit = node->child_count > 0 ? memchr(node->index, path[0], node->child_count) : NULL;
+        if (hit) {
+            RouteNode* child = node->children[hit - node->index];
+            if (child->label_len <= length && memcmp(child->label, path, child->label_len) == 0) {
+                RouteHandler* handler = match_node(child, path + child->label_len, length - child->label_len, method, match);
+                if (handler) return handler;
+            }
+        }
+
+        if (node->param && match->count < ROUTER_MAX_PARAMS) {
+            const char* slash = memchr(path, '/', length);
+            size_t segment = slash ? (size_t)(slash - path) : length;
+            if (segment > 0) {
+                match->captures[match->count++] = (RouteCapture){path, segment};
+                RouteHandler* handler = match_node(node->param, path + segment, length - segment, method, match);
+                if (handler) return handler;
+                match->count--;
+            }
+        }
+    }
+
+    if (node->wildcard && match->count < ROUTER_MAX_PARAMS) {
+        RouteHandler* handler = node_handler(node->wildcard, method);
+        if (handler) {
+            match->captures[match->count++] = (RouteCapture){path, length};
+            return handler;
+        }
+    }
+    return NULL;
+}
+
+/**
+ * Looks up a path, ignoring its query string.
+ * @param params Receives the captured parameters when not NULL.
+ * @return The route's handler, or nil.
+ */
+static Value router_lookup(Router* router, const char* method, const char* path, HashMap* params) {
+    RouteMatch match;
+    match.count = 0;
+
+    pthread_rwlock_rdlock(&router->lock);
+    RouteHandler* found = match_node(router->root, path, strcspn(path, "?"), method, &match);
+    Value handler = found ? copy_value(found->handler) : NIL_VAL;
+
+    /* The captures are bound under the lock: re-adding the route replaces its names. */
+    if (found && params) {
+        for (int i = 0; i < match.count; i++)
+            map_set(params, found->names[i], string_new(match.captures[i].value, match.captures[i].length));
+    }
+    pthread_rwlock_unlock(&router->lock);
+    return handler;
+}
+
+static void mark_node(RouteNode* node) {
+    for (int i = 0; i < node->handler_count; i++) gc_mark_value(node->handlers[i].handler);
+    for (int i = 0; i < node->child_count; i++) mark_node(node->children[i]);
+    if (node->param) mark_node(node->param);
+    if (node->wildcard) mark_node(node->wildcard);
+}
+
+static void mark_routers(void* ctx) {
+    for (int i = 0; i < router_count; i++) mark_node(routers[i]->root);
+}
+
+static Router* router_get(Value handle) {
+    if (VALUE_TYPE(handle) != VAL_NUMBER) return NULL;
+    int id = (int)AS_NUMBER(handle);
+    pthread_mutex_lock(&routers_lock);
+    Router* router = id >= 0 && id < router_count ? routers[id] : NULL;
+    pthread_mutex_unlock(&routers_lock);
+    return router;
+}
+
+/* ---- Natives ---- */
+
+/**
+ * Native '__router_new__': makes an empty router.
+ * @return Its handle.
+ */
+Value native_router_new(int arity, Value* args) {
+    Router* router = calloc(1, sizeof(Router));
+    router->root = node_new(NULL, 0);
+    pthread_rwlock_init(&router->lock, NULL);
+
+    pthread_mutex_lock(&routers_lock);
+    if (router_count == 0) gc_add_root_marker(mark_routers, NULL);
+    routers = realloc(routers, sizeof(Router*) * (router_count + 1));
+    routers[router_count] = router;
+    int id = router_count++;
+    pthread_mutex_unlock(&routers_lock);
+
+    return NUMBER_VAL(id);
+}
+
+/**
+ * Native '__router_add__': adds a route.
+ * @param args[0] The router.
+ * @param args[1] The method, or "*" for any.
+ * @param args[2] The pattern, e.g. "/users/{id}" or "/static/{path*}".
+ * @param args[3] The handler, or any value to get back from a match.
+ * @return false if the pattern is invalid.
+ */
+Value native_router_add(int arity, Value* args) {
+    if (arity < 4 || VALUE_TYPE(args[1]) != VAL_STRING || VALUE_TYPE(args[2]) != VAL_STRING) return BOOL_VAL(false);
+    Router* router = router_get(args[0]);
+    if (router == NULL) return BOOL_VAL(false);
+
+    pthread_rwlock_wrlock(&router->lock);
+    bool added = router_add(router, AS_STRING(args[1]), AS_STRING(args[2]), args[3]);
+    pthread_rwlock_unlock(&router->lock);
+    return BOOL_VAL(added);
+}
+
+/**
+ * Native '__router_match__': looks up a method and path.
+ * @return A map with "handler" and "params", or nil.
+ */
+Value native_router_match(int arity, Value* args) {
+    if (arity < 3 || VALUE_TYPE(args[1]) != VAL_STRING || VALUE_TYPE(args[2]) != VAL_STRING) return NIL_VAL;
+    Router* router = router_get(args[0]);
+    if (router == NULL) return NIL_VAL;
+
+    HashMap* params = map_new();
+    Value handler = router_lookup(router, AS_STRING(args[1]), AS_STRING(args[2]), params);
+    if (VALUE_TYPE(handler) == VAL_NIL) return NIL_VAL;
+
+    HashMap* result = map_new();
+    map_set(result, "handler", handler);
+    map_set(result, "params", MAP_VAL(params));
+    return MAP_VAL(result);
+}
+
+/**
+ * Native '__router_dispatch__': looks up a request by its "method" and
+ * "path", storing the captured parameters in its "params" map.
+ * @return The route's handler, or nil.
+ */
+Value native_router_dispatch(int arity, Value* args) {
+    if (arity < 2 || VALUE_TYPE(args[1]) != VAL_MAP) return NIL_VAL;
+    Router* router = router_get(args[0]);
+    if (router == NULL) return NIL_VAL;
+
+    HashMap* req = AS_MAP(args[1]);
+    Value method, path, params;
+    if (!map_get(req, "method", &method) || VALUE_TYPE(method) != VAL_STRING) return NIL_VAL;
+    if (!map_get(req, "path", &path) || VALUE_TYPE(path) != VAL_STRING) return NIL_VAL;
+    if (!map_get(req, "params", &params) || VALUE_TYPE(params) != VAL_MAP) {
+        params = MAP_VAL(map_new());
+        map_set(req, "params", params);
+    }
+
+    return router_lookup(router, AS_STRING(method), AS_STRING(path), AS_MAP(params));
+}
+
+void register_jweb_router_natives(Env* env) {
+    set_var(env, "__router_new__", NATIVE_VAL(native_router_new), true, "");
+    set_var(env, "__router_add__", NATIVE_VAL(native_router_add), true, "");
+    set_var(env, "__router_match__", NATIVE_VAL(native_router_match), true, "");
+    set_var(env, "__router_dispatch__", NATIVE_VAL(native_router_dispatch), true, "");
+}
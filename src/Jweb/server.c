@@ -0,0 +1,866 @@
+#include "Jweb/server.h"
+#include "Jweb/native_jweb.h"
+#include "Jweb/http_parser.h"
+#include "Jweb/static_file.h"
+#include "Jweb/response_writer.h"
+#include "json/json_reader.h"
+#include "json/json_writer.h"
+#include "eval.h"
+#include "value.h"
+#include "gc.h"
+#include "string_object.h"
+#include "task.h"
+#include "async.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <time.h>
+#include <sys/socket.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/resource.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#define SERVER_MAX_EVENTS 256
+#define SERVER_READ_CHUNK 16384
+#define SERVER_MAX_HEADER (64 * 1024)
+#define SERVER_MAX_INPUT (SERVER_MAX_HEADER + SERVER_READ_CHUNK)   // unparsed bytes read ahead of the parser
+#define SERVER_MAX_BODY (256L * 1024 * 1024)
+#define SERVER_MAX_PENDING_OUT (1024 * 1024)   // stop reading pipelined requests past this much unsent output
+#define SERVER_GC_WAIT_POLLS 50                 // 1 ms polls to wait for busy threads before dispatching without collecting
+#define SERVER_GC_RETRY_MS 1000                 // how long after such a timeout requests go straight through again
+
+extern Env* global_env;
+
+/**
+ * @typedef @struct CONNECTION
+ * State of one client socket, owned by the I/O thread.
+ */
+typedef struct Connection {
+    int fd;
+    unsigned generation;    // bumped on close, so a late response for an old client is dropped
+    bool open;
+    bool busy;              // one of its requests is with a worker
+    bool keep_alive;        // keep the socket once the pending response is out
+    bool read_closed;       // the peer will send nothing more
+    bool read_pending;      // reading stopped at SERVER_MAX_INPUT; the rest waits in the kernel
+    char* in;               // bytes read but not yet parsed
+    size_t in_len;
+    size_t in_cap;
+    char* out;              // response bytes the socket has not taken yet
+    size_t out_len;
+    size_t out_sent;
+    size_t out_cap;
+    size_t scanned;         // how much of in the head parser has searched already
+    struct ServerJob* job;  // request whose body is still arriving
+    StaticFile* file;       // file being sent after out, for __send_file__
+    off_t file_offset;
+    off_t file_remaining;
+    struct ServerJob* stream; // request whose handler is streaming its response here
+    char address[INET6_ADDRSTRLEN];
+} Connection;
+
+typedef struct Server Server;
+
+/**
+ * @typedef @struct SERVERJOB
+ * One request travelling to a worker and its response travelling back.
+ */
+typedef struct ServerJob {
+    Server* server;
+    int fd;
+    unsigned generation;
+    HttpHead head;              // slices of head_data
+    char* head_data;
+    HttpBody body;
+    char address[INET6_ADDRSTRLEN];
+    bool keep_alive;
+    char* response;
+    size_t response_len;
+    StaticFile* file;           // sent after the response head, if the handler called __send_file__
+    off_t file_offset;
+    off_t file_length;
+    ResponseWriter* writer;     // set once the handler streams its response
+    /* Streamed bytes on their way to the I/O thread, under the server's done_lock. */
+    char* stream;
+    size_t stream_len;
+    size_t stream_cap;
+    size_t stream_pending;      // written by the handler and not yet on the wire
+    bool stream_queued;         // on the server's streaming list
+    bool stream_failed;         // the connection is gone
+    struct ServerJob* stream_next;
+    /* Streamed bytes the I/O thread has taken and not yet queued. */
+    char* taken;
+    size_t taken_len;
+    size_t taken_cap;
+    struct ServerJob* taken_next;
+    struct ServerJob* next;
+} ServerJob;
+
+struct Server {
+    int listen_fd;
+    int epoll_fd;
+    int wake_fd;                // eventfd the workers signal once a response is ready
+    Value handler;
+    Connection** conns;         // indexed by fd
+    int conn_capacity;
+    pthread_mutex_t done_lock;
+    pthread_cond_t drained;     // a streaming connection has sent all it was given
+    ServerJob* done;            // finished jobs waiting for the I/O thread
+    ServerJob* streaming;       // jobs with streamed bytes waiting for the I/O thread
+    int in_flight;              // jobs posted to workers and not yet back
+    ServerJob* held;            // requests kept back until a due collection has run
+    ServerJob* held_tail;
+    int held_polls;             // polls spent waiting for other threads to let the collector run
+    double hold_after;          // monotonic ms before which requests are not held again
+};
+
+static double server_now_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000.0 + ts.tv_nsec / 1e6;
+}
+
+static bool buffer_reserve(char** data, size_t* capacity, size_t needed) {
+    if (needed <= *capacity) return true;
+    size_t new_capacity = *capacity < 4096 ? 4096 : *capacity;
+    while (new_capacity < needed) new_capacity *= 2;
+    char* grown = realloc(*data, new_capacity);
+    if (!grown) return false;
+    *data = grown;
+    *capacity = new_capacity;
+    return true;
+}
+
+/**
+ * Formats a complete response into a malloc'd buffer.
+ * @param length Receives the number of bytes.
+ */
+static char* format_response(int status, const char* content_type, const char* body, size_t body_len,
+                             bool keep_alive, size_t* length) {
+    char header[256];
+    int header_len = snprintf(header, sizeof(header),
+        "HTTP/1.1 %d %s\r\n"
+        "Content-Type: %s\r\n"
+        "Content-Length: %zu\r\n"
+        "Server: SnapEngine/1.0\r\n"
+        "Connection: %s\r\n\r\n",
+        status, http_status_text(status), content_type, body_len, keep_alive ? "keep-alive" : "close");
+
+    char* response = malloc(header_len + body_len);
+    memcpy(response, header, header_len);
+    if (body_len > 0) memcpy(response + header_len, body, body_len);
+    *length = header_len + body_len;
+    return response;
+}
+
+/* ---- Requests ---- */
+
+Value http_request_map(const HttpHead* head, const char* buf, HttpBody* body, const char* address) {
+    HashMap* headers_map = map_new();
+    for (int i = 0; i < head->header_count; i++) {
+        const HttpHeader* h = &head->headers[i];
+        map_set_string(headers_map, string_intern(buf + h->name.offset, h->name.length),
+                       string_new(buf + h->value.offset, h->value.length));
+    }
+
+    const char* target = buf + head->target.offset;
+    const char* query = memchr(target, '?', head->target.length);
+    size_t path_len = query ? (size_t)(query - target) : head->target.length;
+    HashMap* query_map = map_new();
+    if (query) {
+        char* query_string = strndup(query + 1, head->target.length - path_len - 1);
+        parse_query_params(query_map, query_string);
+        free(query_string);
+    }
+
+    HashMap* req_map = map_new();
+    map_set(req_map, "method", string_new(buf + head->method.offset, head->method.length));
+    map_set(req_map, "path", string_new(target, path_len));
+    map_set(req_map, "query", MAP_VAL(query_map));
+    map_set(req_map, "headers", MAP_VAL(headers_map));
+    map_set(req_map, "address", string_copy(address));
+    map_set(req_map, "params", MAP_VAL(map_new()));
+
+    Value body_value = NIL_VAL;
+    if (body->file) {
+        body_value = FILE_VAL(body->file);
+    } else if (body->size > 0) {
+        bool is_json = (body->data[0] == '{' || body->data[0] == '[') &&
+                       json_parse(body->data, body->size, &body_value);
+        if (!is_json) body_value = string_new(body->data, body->size);
+    }
+    map_set(req_map, "body", body_value);
+
+    return MAP_VAL(req_map);
+}
+
+static void job_free(ServerJob* job) {
+    if (job->file) static_file_release(job->file);
+    response_writer_free(job->writer);
+    free(job->stream);
+    free(job->taken);
+    http_body_free(&job->body);
+    free(job->head_data);
+    free(job->response);
+    free(job);
+}
+
+/* ---- Workers ---- */
+
+/* The request this worker's handler is answering, for __send_file__. */
+static __thread ServerJob* current_job = NULL;
+
+/** Drops a response a handler set up before it threw or replaced it. */
+static void job_reset_response(ServerJob* job) {
+    free(job->response);
+    job->response = NULL;
+    if (job->file) static_file_release(job->file);
+    job->file = NULL;
+    response_writer_free(job->writer);
+    job->writer = NULL;
+}
+
+static void job_wake_server(Server* server) {
+    uint64_t one = 1;
+    ssize_t written = write(server->wake_fd, &one, sizeof(one));
+    (void)written;
+}
+
+/**
+ * Sink of a streamed response: hands the bytes to the I/O thread, then
+ * holds the handler up while more than SERVER_MAX_PENDING_OUT of them are
+ * still unsent.
+ */
+static bool job_stream_sink(void* ctx, struct iovec* iov, int count) {
+    ServerJob* job = ctx;
+    Server* server = job->server;
+    size_t total = 0;
+    for (int i = 0; i < count; i++) total += iov[i].iov_len;
+
+    pthread_mutex_lock(&server->done_lock);
+    if (job->stream_failed || !buffer_reserve(&job->stream, &job->stream_cap, job->stream_len + total)) {
+        pthread_mutex_unlock(&server->done_lock);
+        return false;
+    }
+    for (int i = 0; i < count; i++) {
+        memcpy(job->stream + job->stream_len, iov[i].iov_base, iov[i].iov_len);
+        job->stream_len += iov[i].iov_len;
+    }
+    job->stream_pending += total;
+    if (!job->stream_queued) {
+        job->stream_queued = true;
+        job->stream_next = server->streaming;
+        server->streaming = job;
+        job_wake_server(server);
+    }
+    if (job->stream_pending > SERVER_MAX_PENDING_OUT && !job->stream_failed) {
+        /* A slow client must not keep the I/O thread from collecting. */
+        gc_blocking_begin();
+        while (job->stream_pending > SERVER_MAX_PENDING_OUT && !job->stream_failed) {
+            pthread_cond_wait(&server->drained, &server->done_lock);
+        }
+        gc_blocking_end();
+    }
+    bool ok = !job->stream_failed;
+    pthread_mutex_unlock(&server->done_lock);
+    return ok;
+}
+
+ResponseWriter* http_job_writer(bool create) {
+    ServerJob* job = current_job;
+    if (job == NULL || (job->writer == NULL && !create)) return job ? job->writer : NULL;
+    if (job->writer == NULL) {
+        job_reset_response(job);
+        bool head_only = job->head.method.length == 4 && memcmp(job->head_data + job->head.method.offset, "HEAD", 4) == 0;
+        job->writer = response_writer_new(job_stream_sink, job, job->head.minor_version >= 1, job->keep_alive, head_only);
+    }
+    return job->writer;
+}
+
+/** Copies a request header into buf, or returns NULL if it is missing. */
+static const char* job_header(ServerJob* job, const char* name, char* buf, size_t capacity) {
+    const HttpSlice* value = http_head_find(&job->head, job->head_data, name);
+    if (value == NULL) return NULL;
+    size_t length = value->length < capacity - 1 ? value->length : capacity - 1;
+    memcpy(buf, job->head_data + value->offset, length);
+    buf[length] = '\0';
+    return buf;
+}
+
+bool http_job_send_file(const char* path) {
+    ServerJob* job = current_job;
+    if (job == NULL || (job->writer && job->writer->head_sent)) return false;
+    job_reset_response(job);
+
+    StaticFile* file = static_file_open(path);
+    if (file == NULL) {
+        job->response = format_response(404, "text/plain", NULL, 0, job->keep_alive, &job->response_len);
+        return false;
+    }
+
+    char if_none_match[256], if_modified_since[64], range[128], if_range[128];
+    StaticRequest req;
+    req.if_none_match = job_header(job, "If-None-Match", if_none_match, sizeof(if_none_match));
+    req.if_modified_since = job_header(job, "If-Modified-Since", if_modified_since, sizeof(if_modified_since));
+    req.range = job_header(job, "Range", range, sizeof(range));
+    req.if_range = job_header(job, "If-Range", if_range, sizeof(if_range));
+    req.head_only = job->head.method.length == 4 && memcmp(job->head_data + job->head.method.offset, "HEAD", 4) == 0;
+    req.keep_alive = job->keep_alive;
+
+    char head[1024];
+    static_file_respond(file, &req, head, sizeof(head), &job->response_len, &job->file_offset, &job->file_length);
+    job->response = malloc(job->response_len);
+    memcpy(job->response, head, job->response_len);
+
+    if (job->file_length > 0) job->file = file;
+    else static_file_release(file);
+    return true;
+}
+
+/**
+ * Turns what the handler returned into a response, the way __send__ does:
+ * maps and arrays as JSON, markup as HTML, anything else as text.
+ */
+static void job_respond(ServerJob* job, Value result) {
+    if (VALUE_TYPE(result) == VAL_NIL) {
+        job->response = format_response(204, "text/plain", NULL, 0, job->keep_alive, &job->response_len);
+        return;
+    }
+
+    if (VALUE_TYPE(result) == VAL_MAP || VALUE_TYPE(result) == VAL_ARRAY) {
+        size_t length;
+        const char* json = json_encode(result, &length);
+        job->response = format_response(200, "application/json", json, length, job->keep_alive, &job->response_len);
+        return;
+    }
+
+    bool is_string = VALUE_TYPE(result) == VAL_STRING;
+    char* text = is_string ? AS_STRING(result) : value_to_string(result);
+    const char* content_type = strchr(text, '<') ? "text/html" : "text/plain";
+    job->response = format_response(200, content_type, text, strlen(text), job->keep_alive, &job->response_len);
+    if (!is_string) free(text);
+}
+
+/** Runs the handler for one request on a pool worker. */
+static void job_run(void* ctx, int chunk) {
+    ServerJob* job = ctx;
+    Server* server = job->server;
+
+    /* A throw the handler does not catch becomes a 500 instead of ending the
+       process. The thread's own exception state is put back afterwards: a
+       worker helping out inside task_join may be in a try block. */
+    ExceptionState saved = global_ex_state;
+    ServerJob* saved_job = current_job;
+    current_job = job;
+    global_ex_state.active = 1;
+    if (setjmp(global_ex_state.buf) == 0) {
+        Env* env = IS_FUNCTION(server->handler) ? AS_FUNCTION(server->handler)->env : global_env;
+        Value request = http_request_map(&job->head, job->head_data, &job->body, job->address);
+        Value result = call_value(env, server->handler, NULL, 1, &request);
+        /* Once a handler streams, its return value is not sent. */
+        if (job->writer) {
+            response_writer_end(job->writer);
+            job->keep_alive = job->writer->keep_alive;
+        } else if (job->response == NULL) {
+            job_respond(job, result);
+        }
+    } else {
+        char* error = value_to_string(global_ex_state.error_val);
+        fprintf(stderr, "[SnapEngine] handler error: %s\n", error);
+        free(error);
+        if (job->writer && job->writer->head_sent) {
+            /* Too late for a 500: cut the body short so the client sees it is incomplete. */
+            job->keep_alive = false;
+        } else {
+            job_reset_response(job);
+            job->response = format_response(500, "text/plain", NULL, 0, job->keep_alive, &job->response_len);
+        }
+    }
+    current_job = saved_job;
+    global_ex_state = saved;
+    http_body_free(&job->body);
+
+    pthread_mutex_lock(&server->done_lock);
+    bool was_empty = server->done == NULL;
+    job->next = server->done;
+    server->done = job;
+    pthread_mutex_unlock(&server->done_lock);
+
+    if (was_empty) job_wake_server(server);
+}
+
+/* ---- Connections ---- */
+
+static Connection* conn_slot(Server* server, int fd) {
+    if (fd >= server->conn_capacity) {
+        int capacity = server->conn_capacity < 1024 ? 1024 : server->conn_capacity;
+        while (capacity <= fd) capacity *= 2;
+        server->conns = realloc(server->conns, sizeof(Connection*) * capacity);
+        memset(server->conns + server->conn_capacity, 0, sizeof(Connection*) * (capacity - server->conn_capacity));
+        server->conn_capacity = capacity;
+    }
+    if (server->conns[fd] == NULL) server->conns[fd] = calloc(1, sizeof(Connection));
+    return server->conns[fd];
+}
+
+/** Lets a handler streaming to c carry on once the socket has taken its bytes, or stop if c is gone. */
+static void conn_release_stream(Server* server, Connection* c, bool failed) {
+    ServerJob* job = c->stream;
+    pthread_mutex_lock(&server->done_lock);
+    job->stream_pending = job->stream_len;
+    if (failed) job->stream_failed = true;
+    pthread_cond_broadcast(&server->drained);
+    pthread_mutex_unlock(&server->done_lock);
+}
+
+static void conn_close(Server* server, Connection* c) {
+    if (c->stream) {
+        conn_release_stream(server, c, true);
+        c->stream = NULL;
+    }
+    if (c->job) {
+        job_free(c->job);
+        c->job = NULL;
+    }
+    if (c->file) {
+        static_file_release(c->file);
+        c->file = NULL;
+    }
+    close(c->fd);
+    free(c->in);
+    free(c->out);
+    c->in = c->out = NULL;
+    c->in_len = c->in_cap = 0;
+    c->out_len = c->out_sent = c->out_cap = 0;
+    c->scanned = 0;
+    c->open = false;
+    c->busy = false;
+    c->read_pending = false;
+    c->generation++;
+}
+
+/** Drops bytes the parser is done with from the front of the input. */
+static void conn_consume(Connection* c, size_t used) {
+    if (used == 0) return;
+    memmove(c->in, c->in + used, c->in_len - used + 1);
+    c->in_len -= used;
+}
+
+static void conn_process(Server* server, Connection* c);
+
+/**
+ * Posts a request to the workers. The collector only runs on the main
+ * thread and only while every worker is idle or parked in a blocking wait,
+ * and the workers are where every handler allocates, so once a collection
+ * is due new requests are held back until the handlers still running reach
+ * such a point and the I/O thread has collected.
+ */
+static void server_dispatch(Server* server, ServerJob* job) {
+    if (server->held || (gc_due() && server_now_ms() >= server->hold_after)) {
+        job->next = NULL;
+        if (server->held_tail) server->held_tail->next = job;
+        else server->held = job;
+        server->held_tail = job;
+        return;
+    }
+    server->in_flight++;
+    task_post(job_run, job);
+}
+
+/**
+ * Collects once no handler is running outside a blocking wait, then posts
+ * the requests held back for it. A handler busy computing (or an @parallel
+ * task) can keep that from happening for a long time: after a short wait
+ * the held requests go out anyway, and none are held for a while.
+ */
+static void server_collect(Server* server) {
+    if (gc_due()) {
+        if (!gc_threads_running()) {
+            gc_collect();
+        } else if (server->held == NULL) {
+            return;
+        } else if (++server->held_polls < SERVER_GC_WAIT_POLLS) {
+            return;
+        } else {
+            server->hold_after = server_now_ms() + SERVER_GC_RETRY_MS;
+        }
+    }
+    server->held_polls = 0;
+    if (server->held == NULL) return;
+
+    ServerJob* job = server->held;
+    server->held = server->held_tail = NULL;
+    while (job) {
+        ServerJob* next = job->next;
+        server->in_flight++;
+        task_post(job_run, job);
+        job = next;
+    }
+}
+
+/**
+ * Writes as much pending output as the socket takes, then the file being
+ * sent, if any, straight from the page cache. What is left goes out on the
+ * next EPOLLOUT edge.
+ */
+static void conn_flush(Server* server, Connection* c) {
+    while (c->out_sent < c->out_len) {
+        ssize_t n = send(c->fd, c->out + c->out_sent, c->out_len - c->out_sent, MSG_NOSIGNAL);
+        if (n > 0) {
+            c->out_sent += n;
+        } else if (n < 0 && errno == EINTR) {
+            continue;
+        } else if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            return;
+        } else {
+            conn_close(server, c);
+            return;
+        }
+    }
+    c->out_len = c->out_sent = 0;
+    if (c->stream) conn_release_stream(server, c, false);
+
+    while (c->file) {
+        ssize_t n = static_file_send(c->fd, c->file, &c->file_offset, c->file_remaining);
+        if (n > 0) {
+            c->file_remaining -= n;
+            if (c->file_remaining == 0) {
+                static_file_release(c->file);
+                c->file = NULL;
+            }
+        } else if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            return;
+        } else {
+            conn_close(server, c);      // the file shrank or the peer is gone
+            return;
+        }
+    }
+
+    if (!c->busy && (!c->keep_alive || (c->read_closed && c->in_len == 0))) conn_close(server, c);
+}
+
+static void conn_queue(Server* server, Connection* c, const char* data, size_t length) {
+    if (!buffer_reserve(&c->out, &c->out_cap, c->out_len + length)) {
+        conn_close(server, c);
+        return;
+    }
+    memcpy(c->out + c->out_len, data, length);
+    c->out_len += length;
+    conn_flush(server, c);
+}
+
+/** Answers a request that cannot be parsed and drops the connection after it. */
+static void conn_fail(Server* server, Connection* c, int status) {
+    size_t length;
+    char* response = format_response(status, "text/plain", http_status_text(status), strlen(http_status_text(status)),
+                                     false, &length);
+    c->keep_alive = false;
+    c->in_len = 0;
+    c->scanned = 0;
+    conn_queue(server, c, response, length);
+    free(response);
+}
+
+/**
+ * Reads until the socket is drained, as edge-triggered readiness requires,
+ * or until SERVER_MAX_INPUT bytes wait for the parser. In that case the
+ * rest stays in the kernel, which pushes back on the client, and
+ * conn_process reads it once the connection has caught up: no new edge is
+ * needed, since the bytes already arrived.
+ */
+static void conn_read(Server* server, Connection* c) {
+    c->read_pending = false;
+    while (c->in_len < SERVER_MAX_INPUT) {
+        size_t room = SERVER_MAX_INPUT - c->in_len;
+        if (room > SERVER_READ_CHUNK) room = SERVER_READ_CHUNK;
+        if (!buffer_reserve(&c->in, &c->in_cap, c->in_len + room + 1)) {
+            conn_close(server, c);
+            return;
+        }
+        ssize_t n = recv(c->fd, c->in + c->in_len, room, 0);
+        if (n > 0) {
+            c->in_len += n;
+            c->in[c->in_len] = '\0';
+        } else if (n == 0) {
+            c->read_closed = true;
+            return;
+        } else if (errno == EINTR) {
+            continue;
+        } else if (errno == EAGAIN || errno == EWOULDBLOCK) {
+            return;
+        } else {
+            conn_close(server, c);
+            return;
+        }
+    }
+    c->read_pending = true;
+}
+
+/* ---- Requests ---- */
+
+/**
+ * Hands the next request of a connection to a worker once its head and
+ * body are in. The body is decoded as it arrives, so only the head and a
+ * partly read chunk ever sit in the connection's buffer. Requests
+ * pipelined behind it wait in the buffer, and past SERVER_MAX_INPUT in the
+ * kernel, until its response is queued.
+ */
+static void conn_process(Server* server, Connection* c) {
+    for (;;) {
+        if (!c->open || c->busy || c->file || c->out_len - c->out_sent > SERVER_MAX_PENDING_OUT) return;
+        if (c->read_pending) {
+            conn_read(server, c);
+            if (!c->open) return;
+        }
+
+        if (c->job == NULL) {
+            HttpHead head;
+            long head_len = http_parse_head(&head, c->in, c->in_len, &c->scanned, SERVER_MAX_HEADER);
+            if (head_len < 0) {
+                conn_fail(server, c, (int)-head_len);
+                return;
+            }
+            if (head_len == 0) {
+                if (c->read_closed && c->out_len == 0) conn_close(server, c);
+                return;
+            }
+
+            /* The head is copied out once; the header slices point into the copy. */
+            ServerJob* job = calloc(1, sizeof(ServerJob));
+            job->server = server;
+            job->fd = c->fd;
+            job->generation = c->generation;
+            job->head = head;
+            job->head_data = malloc(head_len);
+            memcpy(job->head_data, c->in, head_len);
+            job->keep_alive = head.keep_alive;
+            memcpy(job->address, c->address, sizeof(job->address));
+            http_body_init(&job->body, &head, SERVER_MAX_BODY);
+            conn_consume(c, head_len);
+
+            c->job = job;
+            c->keep_alive = head.keep_alive;
+            if (head.expect_continue && job->body.state != HTTP_BODY_DONE && c->in_len == 0) {
+                static const char continue_line[] = "HTTP/1.1 100 Continue\r\n\r\n";
+                conn_queue(server, c, continue_line, sizeof(continue_line) - 1);
+                if (!c->open) return;
+            }
+        }
+
+        long used = http_body_feed(&c->job->body, c->in, c->in_len);
+        if (used < 0) {
+            job_free(c->job);
+            c->job = NULL;
+            conn_fail(server, c, (int)-used);
+            return;
+        }
+        conn_consume(c, used);
+
+        if (c->job->body.state != HTTP_BODY_DONE) {
+            if (c->read_pending) continue;      // more of the body is already in the kernel
+            if (c->read_closed) conn_close(server, c);
+            return;
+        }
+
+        ServerJob* job = c->job;
+        c->job = NULL;
+        c->busy = true;
+        server_dispatch(server, job);
+        return;
+    }
+}
+
+/* ---- I/O thread ---- */
+
+static void server_accept(Server* server) {
+    for (;;) {
+        struct sockaddr_storage addr;
+        socklen_t addrlen = sizeof(addr);
+        int fd = accept4(server->listen_fd, (struct sockaddr*)&addr, &addrlen, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (fd < 0) {
+            if (errno == EINTR || errno == ECONNABORTED) continue;
+            return;
+        }
+
+        Connection* c = conn_slot(server, fd);
+        c->fd = fd;
+        c->open = true;
+        c->busy = false;
+        c->keep_alive = true;
+        c->read_closed = false;
+        c->read_pending = false;
+        if (addr.ss_family == AF_INET6)
+            inet_ntop(AF_INET6, &((struct sockaddr_in6*)&addr)->sin6_addr, c->address, sizeof(c->address));
+        else
+            inet_ntop(AF_INET, &((struct sockaddr_in*)&addr)->sin_addr, c->address, sizeof(c->address));
+
+        struct epoll_event ev;
+        ev.events = EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET;
+        ev.data.fd = fd;
+        if (epoll_ctl(server->epoll_fd, EPOLL_CTL_ADD, fd, &ev) < 0) conn_close(server, c);
+    }
+}
+
+/** Moves bytes a handler streamed into its connection's output. */
+static void conn_take_stream(Server* server, Connection* c, ServerJob* job) {
+    c->stream = job;
+    if (c->out_len == 0) {
+        /* Nothing else waiting: the job's buffer becomes the output as it is. */
+        free(c->out);
+        c->out = job->taken;
+        c->out_len = job->taken_len;
+        c->out_cap = job->taken_cap;
+        c->out_sent = 0;
+        job->taken = NULL;
+        conn_flush(server, c);
+    } else {
+        conn_queue(server, c, job->taken, job->taken_len);
+    }
+}
+
+/**
+ * Queues what the workers have produced on their connections: streamed
+ * bytes first, then finished responses. Both lists are taken together so
+ * a handler's last streamed bytes never come after its completion.
+ */
+static void server_complete(Server* server) {
+    uint64_t count;
+    ssize_t got = read(server->wake_fd, &count, sizeof(count));
+    (void)got;
+
+    ServerJob* streamed = NULL;
+    pthread_mutex_lock(&server->done_lock);
+    for (ServerJob* job = server->streaming; job; job = job->stream_next) {
+        job->taken = job->stream;
+        job->taken_len = job->stream_len;
+        job->taken_cap = job->stream_cap;
+        job->stream = NULL;
+        job->stream_len = job->stream_cap = 0;
+        job->stream_queued = false;
+        job->taken_next = streamed;
+        streamed = job;
+    }
+    server->streaming = NULL;
+    ServerJob* job = server->done;
+    server->done = NULL;
+    pthread_mutex_unlock(&server->done_lock);
+
+    for (; streamed; streamed = streamed->taken_next) {
+        Connection* c = server->conns[streamed->fd];
+        if (c->open && c->generation == streamed->generation) {
+            conn_take_stream(server, c, streamed);
+        } else {
+            pthread_mutex_lock(&server->done_lock);
+            streamed->stream_failed = true;
+            pthread_cond_broadcast(&server->drained);
+            pthread_mutex_unlock(&server->done_lock);
+        }
+        free(streamed->taken);
+        streamed->taken = NULL;
+    }
+
+    while (job) {
+        ServerJob* next = job->next;
+        server->in_flight--;
+        Connection* c = server->conns[job->fd];
+        if (c->open && c->generation == job->generation) {
+            c->busy = false;
+            c->keep_alive = job->keep_alive;
+            if (c->stream == job) c->stream = NULL;
+            if (job->file) {
+                c->file = job->file;
+                c->file_offset = job->file_offset;
+                c->file_remaining = job->file_length;
+                job->file = NULL;
+            }
+            if (job->response) conn_queue(server, c, job->response, job->response_len);
+            else conn_flush(server, c);
+            conn_process(server, c);
+        }
+        job_free(job);
+        job = next;
+    }
+}
+
+static void server_poll(Server* server) {
+    struct epoll_event events[SERVER_MAX_EVENTS];
+    int n = epoll_wait(server->epoll_fd, events, SERVER_MAX_EVENTS, 0);
+    for (int i = 0; i < n; i++) {
+        int fd = events[i].data.fd;
+        if (fd == server->listen_fd) {
+            server_accept(server);
+            continue;
+        }
+        if (fd == server->wake_fd) {
+            server_complete(server);
+            continue;
+        }
+
+        Connection* c = server->conns[fd];
+        if (!c->open) continue;
+        if (events[i].events & (EPOLLIN | EPOLLRDHUP | EPOLLHUP | EPOLLERR)) conn_read(server, c);
+        if (c->open && (events[i].events & EPOLLOUT) && (c->out_len > 0 || c->file)) conn_flush(server, c);
+        if (c->open) conn_process(server, c);
+    }
+}
+
+static void mark_server(void* ctx) {
+    Server* server = ctx;
+    gc_mark_value(server->handler);
+}
+
+/**
+ * Native '__serve__': serves the socket opened by __listen__, calling
+ * handler(req) for every request and sending back what it returns.
+ * Never returns once the server is up.
+ * @param args[0] The handler.
+ * @return false if there is no socket to serve.
+ */
+Value native_web_serve(int arity, Value* args) {
+    if (arity < 1 || VALUE_TYPE(args[0]) == VAL_NIL || global_server_fd == -1) return BOOL_VAL(false);
+
+    /* Thousands of clients need thousands of descriptors. */
+    struct rlimit limit;
+    if (getrlimit(RLIMIT_NOFILE, &limit) == 0 && limit.rlim_cur < limit.rlim_max) {
+        limit.rlim_cur = limit.rlim_max;
+        setrlimit(RLIMIT_NOFILE, &limit);
+    }
+
+    Server* server = calloc(1, sizeof(Server));
+    server->listen_fd = global_server_fd;
+    server->handler = args[0];
+    server->epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    server->wake_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    pthread_mutex_init(&server->done_lock, NULL);
+    pthread_cond_init(&server->drained, NULL);
+    fcntl(server->listen_fd, F_SETFL, fcntl(server->listen_fd, F_GETFL, 0) | O_NONBLOCK);
+
+    struct epoll_event ev;
+    ev.events = EPOLLIN;
+    ev.data.fd = server->listen_fd;
+    epoll_ctl(server->epoll_fd, EPOLL_CTL_ADD, server->listen_fd, &ev);
+    ev.data.fd = server->wake_fd;
+    epoll_ctl(server->epoll_fd, EPOLL_CTL_ADD, server->wake_fd, &ev);
+
+    gc_add_root_marker(mark_server, server);
+    task_pool_size();
+
+    for (;;) {
+        /* While a collection is due, look for a moment when it can run. */
+        async_wait_fd(server->epoll_fd, ASYNC_READ, server->held ? 1 : gc_due() ? 10 : -1);
+        server_poll(server);
+        server_collect(server);
+    }
+    return BOOL_VAL(true);
+}
+
+void register_jweb_server_natives(Env* env) {
+    set_var(env, "__serve__", NATIVE_VAL(native_web_serve), true, "");
+}
@@ -0,0 +1,279 @@
+#include "Jweb/static_file.h"
+#include "Jweb/native_jweb.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/stat.h>
+#include <sys/sendfile.h>
+
+#define STATIC_CACHE_BUCKETS (STATIC_CACHE_SIZE * 2)
+
+static StaticFile* buckets[STATIC_CACHE_BUCKETS];
+static StaticFile* newest = NULL;
+static StaticFile* oldest = NULL;
+static int cached_count = 0;
+static pthread_mutex_t cache_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static unsigned path_hash(const char* path) {
+    unsigned hash = 2166136261u;
+    for (const unsigned char* p = (const unsigned char*)path; *p; p++) hash = (hash ^ *p) * 16777619u;
+    return hash % STATIC_CACHE_BUCKETS;
+}
+
+/* ---- Cache bookkeeping, all under cache_lock ---- */
+
+static StaticFile* cache_find(const char* path) {
+    for (StaticFile* file = buckets[path_hash(path)]; file; file = file->chain) {
+        if (strcmp(file->path, path) == 0) return file;
+    }
+    return NULL;
+}
+
+static void lru_unlink(StaticFile* file) {
+    if (file->prev) file->prev->next = file->next;
+    else newest = file->next;
+    if (file->next) file->next->prev = file->prev;
+    else oldest = file->prev;
+    file->prev = file->next = NULL;
+}
+
+static void lru_push(StaticFile* file) {
+    file->prev = NULL;
+    file->next = newest;
+    if (newest) newest->prev = file;
+    newest = file;
+    if (oldest == NULL) oldest = file;
+}
+
+static void file_unref(StaticFile* file) {
+    if (--file->refs > 0) return;
+    close(file->fd);
+    free(file->headers);
+    free(file->path);
+    free(file);
+}
+
+/** Drops the cache's reference; requests still sending the file keep it open. */
+static void cache_remove(StaticFile* file) {
+    StaticFile** link = &buckets[path_hash(file->path)];
+    while (*link != file) link = &(*link)->chain;
+    *link = file->chain;
+    lru_unlink(file);
+    file->cached = false;
+    cached_count--;
+    file_unref(file);
+}
+
+static void cache_insert(StaticFile* file) {
+    unsigned bucket = path_hash(file->path);
+    file->chain = buckets[bucket];
+    buckets[bucket] = file;
+    lru_push(file);
+    file->cached = true;
+    cached_count++;
+    while (cached_count > STATIC_CACHE_SIZE) cache_remove(oldest);
+}
+
+/* ---- Opening ---- */
+
+static bool same_file(const StaticFile* file, const struct stat* st) {
+    return file->dev == st->st_dev && file->ino == st->st_ino && file->size == st->st_size &&
+           file->mtime == st->st_mtime;
+}
+
+static StaticFile* file_load(const char* path, time_t now) {
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return NULL;
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode)) {
+        close(fd);
+        return NULL;
+    }
+
+    StaticFile* file = calloc(1, sizeof(StaticFile));
+    file->path = strdup(path);
+    file->fd = fd;
+    file->size = st.st_size;
+    file->mtime = st.st_mtime;
+    file->dev = st.st_dev;
+    file->ino = st.st_ino;
+    file->checked = now;
+
+    snprintf(file->etag, sizeof(file->etag), "\"%lx-%llx\"", (unsigned long)file->mtime,
+             (unsigned long long)file->size);
+    struct tm tm;
+    gmtime_r(&file->mtime, &tm);
+    strftime(file->last_modified, sizeof(file->last_modified), "%a, %d %b %Y %H:%M:%S GMT", &tm);
+
+    int length = snprintf(NULL, 0,
+        "Content-Type: %s\r\nETag: %s\r\nLast-Modified: %s\r\nAccept-Ranges: bytes\r\n",
+        get_mime_type(path), file->etag, file->last_modified);
+    file->headers = malloc(length + 1);
+    snprintf(file->headers, length + 1,
+        "Content-Type: %s\r\nETag: %s\r\nLast-Modified: %s\r\nAccept-Ranges: bytes\r\n",
+        get_mime_type(path), file->etag, file->last_modified);
+    file->headers_len = length;
+    return file;
+}
+
+StaticFile* static_file_open(const char* path) {
+    time_t now = time(NULL);
+
+    pthread_mutex_lock(&cache_lock);
+    StaticFile* file = cache_find(path);
+    if (file && now - file->checked < STATIC_CACHE_VALID) {
+        lru_unlink(file);
+        lru_push(file);
+        file->refs++;
+        pthread_mutex_unlock(&cache_lock);
+        return file;
+    }
+    pthread_mutex_unlock(&cache_lock);
+
+    /* Stale or missing: check the file system without holding the lock. */
+    struct stat st;
+    bool exists = stat(path, &st) == 0 && S_ISREG(st.st_mode);
+
+    pthread_mutex_lock(&cache_lock);
+    file = cache_find(path);
+    if (file && exists && same_file(file, &st)) {
+        file->checked = now;
+        lru_unlink(file);
+        lru_push(file);
+        file->refs++;
+        pthread_mutex_unlock(&cache_lock);
+        return file;
+    }
+    if (file) cache_remove(file);
+    pthread_mutex_unlock(&cache_lock);
+    if (!exists) return NULL;
+
+    file = file_load(path, now);
+    if (file == NULL) return NULL;
+    file->refs = 2;     // the cache's and the caller's
+
+    pthread_mutex_lock(&cache_lock);
+    StaticFile* raced = cache_find(path);
+    if (raced) cache_remove(raced);
+    cache_insert(file);
+    pthread_mutex_unlock(&cache_lock);
+    return file;
+}
+
+void static_file_release(StaticFile* file) {
+    pthread_mutex_lock(&cache_lock);
+    file_unref(file);
+    pthread_mutex_unlock(&cache_lock);
+}
+
+/* ---- Responses ---- */
+
+static bool etag_matches(const StaticFile* file, const char* if_none_match) {
+    while (*if_none_match == ' ' || *if_none_match == '\t') if_none_match++;
+    if (strcmp(if_none_match, "*") == 0) return true;
+    return strstr(if_none_match, file->etag) != NULL;   // also finds W/"..." and lists
+}
+
+static bool not_modified_since(const StaticFile* file, const char* if_modified_since) {
+    struct tm tm;
+    memset(&tm, 0, sizeof(tm));
+    const char* end = strptime(if_modified_since, "%a, %d %b %Y %H:%M:%S GMT", &tm);
+    return end != NULL && file->mtime <= timegm(&tm);
+}
+
+/**
+ * Reads a single "bytes=" range.
+ * @return 1 for a satisfiable range, 0 for a header to ignore (malformed
+ *         or several ranges), -1 for a range past the end of the file.
+ */
+static int parse_range(const char* range, off_t size, off_t* start, off_t* length) {
+    if (strncasecmp(range, "bytes=", 6) != 0 || strchr(range, ',') != NULL) return 0;
+    const char* p = range + 6;
+    char* end;
+
+    if (*p == '-') {
+        long long suffix = strtoll(p + 1, &end, 10);
+        if (end == p + 1 || *end != '\0' || suffix < 0) return 0;
+        if (suffix == 0 || size == 0) return -1;
+        if (suffix > size) suffix = size;
+        *start = size - suffix;
+        *length = suffix;
+        return 1;
+    }
+
+    long long first = strtoll(p, &end, 10);
+    if (end == p || *end != '-' || first < 0) return 0;
+    p = end + 1;
+    long long last = size - 1;
+    if (*p != '\0') {
+        last = strtoll(p, &end, 10);
+        if (end == p || *end != '\0' || last < first) return 0;
+        if (last > size - 1) last = size - 1;
+    }
+    if (first >= size) return -1;
+
+    *start = first;
+    *length = last - first + 1;
+    return 1;
+}
+
+int static_file_respond(const StaticFile* file, const StaticRequest* req, char* head, size_t capacity,
+                        size_t* head_len, off_t* offset, off_t* length) {
+    int status = 200;
+    *offset = 0;
+    *length = file->size;
+
+    /* If-None-Match wins over If-Modified-Since when both are sent. */
+    if (req->if_none_match ? etag_matches(file, req->if_none_match)
+                           : req->if_modified_since && not_modified_since(file, req->if_modified_since)) {
+        status = 304;
+    } else if (req->range && (req->if_range == NULL || strcmp(req->if_range, file->etag) == 0 ||
+                              strcmp(req->if_range, file->last_modified) == 0)) {
+        int range = parse_range(req->range, file->size, offset, length);
+        if (range > 0) status = 206;
+        else if (range < 0) status = 416;
+    }
+
+    char extra[96] = "";
+    if (status == 206) {
+        snprintf(extra, sizeof(extra), "Content-Range: bytes %lld-%lld/%lld\r\n", (long long)*offset,
+                 (long long)(*offset + *length - 1), (long long)file->size);
+    } else if (status == 416) {
+        snprintf(extra, sizeof(extra), "Content-Range: bytes */%lld\r\n", (long long)file->size);
+    }
+    if (status == 304 || status == 416) *length = 0;
+
+    /* A 304 leaves out Content-Length, which would otherwise describe the full file. */
+    char content_length[48] = "";
+    if (status != 304) snprintf(content_length, sizeof(content_length), "Content-Length: %lld\r\n", (long long)*length);
+
+    const char* text = status == 200 ? "OK" : status == 206 ? "Partial Content"
+                     : status == 304 ? "Not Modified" : "Range Not Satisfiable";
+    int n = snprintf(head, capacity,
+        "HTTP/1.1 %d %s\r\n"
+        "%s"
+        "%s"
+        "%s"
+        "Server: SnapEngine/1.0\r\n"
+        "Connection: %s\r\n\r\n",
+        status, text, file->headers, extra, content_length, req->keep_alive ? "keep-alive" : "close");
+    *head_len = n < (int)capacity ? (size_t)n : capacity - 1;
+
+    if (req->head_only) *length = 0;
+    return status;
+}
+
+ssize_t static_file_send(int socket, const StaticFile* file, off_t* offset, size_t length) {
+    for (;;) {
+        ssize_t n = sendfile(socket, file->fd, offset, length);
+        if (n < 0 && errno == EINTR) continue;
+        return n;
+    }
+}
@@ -0,0 +1,657 @@
+#include "Jweb/template.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <sys/stat.h>
+
+#define TEMPLATE_CACHE_BUCKETS 64
+#define TEMPLATE_MAX_DEPTH 16       // nested loops, components and includes
+#define TEMPLATE_MAX_NAME 128
+
+typedef enum {
+    OP_TEXT,
+    OP_VAR,
+    OP_IF,
+    OP_FOR,
+    OP_COMPONENT,
+    OP_SLOT
+} TemplateOpType;
+
+/**
+ * @typedef @struct TEMPLATEOP
+ * One instruction. Blocks are followed by the instructions of their body
+ * and know where it ends, so rendering a block is rendering a range.
+ */
+typedef struct {
+    TemplateOpType type;
+    bool loose;         // @while: any truthy value, not only booleans, strings and numbers
+    size_t start;       // OP_TEXT and OP_VAR: span of the template's text; a VAR prints it when the name is unknown
+    size_t length;
+    char* name;         // OP_VAR and OP_IF: the name, its dotted parts separated by '\0'; OP_FOR: the list
+    int parts;
+    char* alias;        // OP_FOR: the loop variable
+    int middle;         // OP_IF: first op of the @else branch; OP_COMPONENT: first op after the slot
+    int end;            // first op after the block
+} TemplateOp;
+
+/**
+ * @typedef @struct TEMPLATESOURCE
+ * A file a template was built from, as it was when it was read.
+ */
+typedef struct {
+    char* path;
+    bool exists;
+    struct timespec mtime;
+    off_t size;
+    ino_t ino;
+} TemplateSource;
+
+typedef struct Template {
+    char* path;
+    char* text;                 // the composed page, then each component's text
+    TemplateOp* ops;
+    int op_count;
+    TemplateSource* sources;
+    int source_count;
+    int refs;                   // the cache's own reference plus one per render
+    struct Template* next;      // next entry in the same hash bucket
+} Template;
+
+typedef struct {
+    char* data;
+    size_t length;
+    size_t capacity;
+} TemplateBuffer;
+
+typedef struct {
+    Template* t;
+    TemplateBuffer text;
+    int op_capacity;
+    int depth;
+} Compiler;
+
+typedef struct {
+    const char* name;
+    Value value;
+} TemplateScope;
+
+typedef struct {
+    const Template* t;
+    HashMap* data;
+    TemplateBuffer out;
+    TemplateScope scopes[TEMPLATE_MAX_DEPTH];
+    int scope_count;
+    int slots[TEMPLATE_MAX_DEPTH][2];   // op ranges of the slots of the components being rendered
+    int slot_count;
+} Renderer;
+
+static Template* cache[TEMPLATE_CACHE_BUCKETS];
+static pthread_mutex_t cache_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static void buffer_append(TemplateBuffer* b, const char* s, size_t n) {
+    if (b->length + n + 1 > b->capacity) {
+        size_t capacity = b->capacity < 4096 ? 4096 : b->capacity;
+        while (capacity < b->length + n + 1) capacity *= 2;
+        b->data = realloc(b->data, capacity);
+        b->capacity = capacity;
+    }
+    memcpy(b->data + b->length, s, n);
+    b->length += n;
+    b->data[b->length] = '\0';
+}
+
+static bool starts_with(const char* p, const char* end, const char* prefix) {
+    size_t n = strlen(prefix);
+    return (size_t)(end - p) >= n && memcmp(p, prefix, n) == 0;
+}
+
+/* ---- Sources ---- */
+
+static void add_source(Template* t, const char* path, const struct stat* st) {
+    t->sources = realloc(t->sources, sizeof(TemplateSource) * (t->source_count + 1));
+    TemplateSource* s = &t->sources[t->source_count++];
+    memset(s, 0, sizeof(*s));
+    s->path = strdup(path);
+    s->exists = st != NULL;
+    if (st) {
+        s->mtime = st->st_mtim;
+        s->size = st->st_size;
+        s->ino = st->st_ino;
+    }
+}
+
+/**
+ * Reads a file the template depends on. Missing files are recorded too, so
+ * creating one later recompiles the template.
+ * @return A malloc'd string, or NULL if the file cannot be read.
+ */
+static char* load_source(Template* t, const char* path, size_t* length) {
+    FILE* f = fopen(path, "rb");
+    struct stat st;
+    if (f == NULL || fstat(fileno(f), &st) != 0) {
+        if (f) fclose(f);
+        add_source(t, path, NULL);
+        return NULL;
+    }
+    add_source(t, path, &st);
+
+    char* text = malloc(st.st_size + 1);
+    *length = fread(text, 1, st.st_size, f);
+    text[*length] = '\0';
+    fclose(f);
+    return text;
+}
+
+static bool template_fresh(const Template* t) {
+    for (int i = 0; i < t->source_count; i++) {
+        const TemplateSource* s = &t->sources[i];
+        struct stat st;
+        bool exists = stat(s->path, &st) == 0;
+        if (exists != s->exists) return false;
+        if (exists && (st.st_mtim.tv_sec != s->mtime.tv_sec || st.st_mtim.tv_nsec != s->mtime.tv_nsec ||
+                       st.st_size != s->size || st.st_ino != s->ino)) return false;
+    }
+    return true;
+}
+
+/* ---- Composing: @extends, @yield, @stack and @include ---- */
+
+/** Appends the text between open_tag's closing parenthesis and close_tag. */
+static void append_block(TemplateBuffer* out, const char* src, const char* open_tag, const char* close_tag) {
+    const char* start = strstr(src, open_tag);
+    if (start == NULL) return;
+    start = strchr(start, ')') + 1;
+    const char* end = strstr(start, close_tag);
+    if (end) buffer_append(out, start, end - start);
+}
+
+/** Fills the layout's @yield and @stack slots from the child's sections and pushes. */
+static void compose_layout(TemplateBuffer* out, const char* layout, size_t layout_len, const char* child) {
+    const char* p = layout;
+    const char* end = layout + layout_len;
+    const char* copied = p;
+
+    while ((p = memchr(p, '@', end - p)) != NULL) {
+        bool yield = starts_with(p, end, "@yield");
+        if (!yield && !starts_with(p, end, "@stack")) {
+            p++;
+            continue;
+        }
+        const char* open = memchr(p, '(', end - p);
+        const char* close = memchr(p, ')', end - p);
+        if (open == NULL || close == NULL) break;
+
+        char name[TEMPLATE_MAX_NAME] = "";
+        sscanf(open, "(\"%127[^\"]\")", name);
+        char tag[TEMPLATE_MAX_NAME + 16];
+        snprintf(tag, sizeof(tag), yield ? "@section(\"%s\")" : "@push(\"%s\")", name);
+
+        buffer_append(out, copied, p - copied);
+        append_block(out, child, tag, yield ? "@endsection" : "@endpush");
+        p = copied = close + 1;
+    }
+    buffer_append(out, copied, end - copied);
+}
+
+/** Copies src to out with every @include("file") replaced by the file. */
+static void compose_includes(Compiler* c, TemplateBuffer* out, const char* src, size_t length, int depth) {
+    const char* p = src;
+    const char* end = src + length;
+    const char* copied = p;
+
+    while ((p = memchr(p, '@', end - p)) != NULL) {
+        if (!starts_with(p, end, "@include")) {
+            p++;
+            continue;
+        }
+        const char* open = memchr(p, '(', end - p);
+        const char* close = open ? memchr(open, ')', end - open) : NULL;
+        const char* quote = open ? strpbrk(open, "\"'") : NULL;
+        const char* quote_end = quote ? strpbrk(quote + 1, "\"'") : NULL;
+        if (!close || !quote_end || quote_end > close || quote_end - quote - 1 >= TEMPLATE_MAX_NAME) break;
+
+        char path[TEMPLATE_MAX_NAME];
+        memcpy(path, quote + 1, quote_end - quote - 1);
+        path[quote_end - quote - 1] = '\0';
+
+        buffer_append(out, copied, p - copied);
+        size_t included_len;
+        char* included = load_source(c->t, path, &included_len);
+        if (included) {
+            if (depth < TEMPLATE_MAX_DEPTH) compose_includes(c, out, included, included_len, depth + 1);
+            else buffer_append(out, included, included_len);
+            free(included);
+        }
+        p = copied = close + 1;
+    }
+    buffer_append(out, copied, end - copied);
+}
+
+/* ---- Compiling ---- */
+
+static int add_op(Compiler* c, TemplateOpType type) {
+    Template* t = c->t;
+    if (t->op_count == c->op_capacity) {
+        c->op_capacity = c->op_capacity < 16 ? 16 : c->op_capacity * 2;
+        t->ops = realloc(t->ops, sizeof(TemplateOp) * c->op_capacity);
+    }
+    memset(&t->ops[t->op_count], 0, sizeof(TemplateOp));
+    t->ops[t->op_count].type = type;
+    return t->op_count++;
+}
+
+static void add_text(Compiler* c, size_t start, size_t end) {
+    if (end <= start) return;
+    int op = add_op(c, OP_TEXT);
+    c->t->ops[op].start = start;
+    c->t->ops[op].length = end - start;
+}
+
+/** Stores a trimmed name with its dotted parts split, for lookups without copying. */
+static void set_name(TemplateOp* op, const char* name, size_t length) {
+    while (length > 0 && (*name == ' ' || *name == '\t')) name++, length--;
+    while (length > 0 && (name[length - 1] == ' ' || name[length - 1] == '\t')) length--;
+    op->name = strndup(name, length);
+    op->parts = 1;
+    for (char* dot = strchr(op->name, '.'); dot; dot = strchr(dot + 1, '.')) {
+        *dot = '\0';
+        op->parts++;
+    }
+}
+
+static const char* route_url(const char* name) {
+    if (strcmp(name, "dashboard") == 0) return "/";
+    if (strcmp(name, "profile") == 0) return "/api/profile";
+    if (strcmp(name, "logout") == 0) return "/auth/logout";
+    return "#";
+}
+
+/** Compiles "{{...}}" spanning [start, close + 2). */
+static void compile_placeholder(Compiler* c, size_t start, size_t close, bool in_component) {
+    const char* inner = c->text.data + start + 2;
+    size_t inner_len = close - start - 2;
+    while (inner_len > 0 && *inner == ' ') inner++, inner_len--;
+    while (inner_len > 0 && inner[inner_len - 1] == ' ') inner_len--;
+
+    if (inner_len > 6 && strncmp(inner, "route(", 6) == 0) {
+        char name[TEMPLATE_MAX_NAME] = "";
+        if (sscanf(inner, "route('%127[^']')", name) != 1) sscanf(inner, "route(\"%127[^\"]\")", name);
+        const char* url = route_url(name);
+        size_t url_start = c->text.length;
+        buffer_append(&c->text, url, strlen(url));
+        add_text(c, url_start, c->text.length);
+        return;
+    }
+    if (in_component && inner_len == 4 && strncmp(inner, "slot", 4) == 0) {
+        add_op(c, OP_SLOT);
+        return;
+    }
+
+    size_t offset = inner - c->text.data;
+    int op = add_op(c, OP_VAR);
+    c->t->ops[op].start = start;
+    c->t->ops[op].length = close + 2 - start;
+    set_name(&c->t->ops[op], c->text.data + offset, inner_len);
+}
+
+static int compile_until(Compiler* c, size_t* pos, size_t end, const char* const* stops, int stop_count,
+                         bool in_component);
+
+/**
+ * Reads "(...)" after a directive name.
+ * @return The offset just past ')', or 0 if there is none.
+ */
+static size_t directive_argument(Compiler* c, size_t pos, size_t end, size_t* arg_start, size_t* arg_end) {
+    const char* p = c->text.data + pos;
+    const char* limit = c->text.data + end;
+    while (p < limit && *p == ' ') p++;
+    if (p >= limit || *p != '(') return 0;
+    const char* close = memchr(p, ')', limit - p);
+    if (close == NULL) return 0;
+    *arg_start = p + 1 - c->text.data;
+    *arg_end = close - c->text.data;
+    return close + 1 - c->text.data;
+}
+
+/**
+ * Compiles the directive at pos, if it is one.
+ * @return The offset after it, or 0 to treat the '@' as text.
+ */
+static size_t compile_directive(Compiler* c, size_t pos, size_t end, bool in_component) {
+    const char* p = c->text.data + pos;
+    const char* limit = c->text.data + end;
+    size_t arg_start, arg_end, after;
+
+    /* Section markers left in a page are dropped up to the end of their line. */
+    if (starts_with(p, limit, "@section") || starts_with(p, limit, "@endsection")) {
+        const char* line_end = memchr(p, '\n', limit - p);
+        return line_end ? (size_t)(line_end - c->text.data) : end;
+    }
+
+    bool is_if = starts_with(p, limit, "@if");
+    bool is_while = starts_with(p, limit, "@while");
+    if (is_if || is_while) {
+        after = directive_argument(c, pos + (is_if ? 3 : 6), end, &arg_start, &arg_end);
+        if (after == 0) return 0;
+        int op = add_op(c, OP_IF);
+        c->t->ops[op].loose = is_while;
+        set_name(&c->t->ops[op], c->text.data + arg_start, arg_end - arg_start);
+
+        static const char* const if_stops[] = {"@else", "@endif"};
+        static const char* const while_stops[] = {"@endwhile"};
+        int stop = is_if ? compile_until(c, &after, end, if_stops, 2, in_component)
+                         : compile_until(c, &after, end, while_stops, 1, in_component);
+        c->t->ops[op].middle = c->t->op_count;
+        if (is_if && stop == 0) compile_until(c, &after, end, if_stops + 1, 1, in_component);
+        c->t->ops[op].end = c->t->op_count;
+        return after;
+    }
+
+    if (starts_with(p, limit, "@for")) {
+        after = directive_argument(c, pos + 4, end, &arg_start, &arg_end);
+        char list[TEMPLATE_MAX_NAME], alias[TEMPLATE_MAX_NAME];
+        char inner[2 * TEMPLATE_MAX_NAME + 8];
+        if (after == 0 || arg_end - arg_start >= sizeof(inner)) return 0;
+        memcpy(inner, c->text.data + arg_start, arg_end - arg_start);
+        inner[arg_end - arg_start] = '\0';
+        if (sscanf(inner, "%127s as %127s", list, alias) != 2) return 0;
+
+        int op = add_op(c, OP_FOR);
+        set_name(&c->t->ops[op], list, strlen(list));
+        c->t->ops[op].alias = strdup(alias);
+
+        static const char* const for_stops[] = {"@endfor"};
+        compile_until(c, &after, end, for_stops, 1, in_component);
+        c->t->ops[op].end = c->t->op_count;
+        return after;
+    }
+
+    if (starts_with(p, limit, "@component")) {
+        char path[TEMPLATE_MAX_NAME];
+        after = directive_argument(c, pos + 10, end, &arg_start, &arg_end);
+        if (after == 0 || sscanf(c->text.data + arg_start, "\"%127[^\"]\"", path) != 1) return 0;
+
+        int op = add_op(c, OP_COMPONENT);
+        static const char* const component_stops[] = {"@endcomponent"};
+        compile_until(c, &after, end, component_stops, 1, in_component);
+        c->t->ops[op].middle = c->t->op_count;
+
+        /* The component's own text goes after everything read so far. */
+        size_t length;
+        char* source = c->depth < TEMPLATE_MAX_DEPTH ? load_source(c->t, path, &length) : NULL;
+        if (source) {
+            size_t start = c->text.length;
+            buffer_append(&c->text, source, length);
+            free(source);
+            c->depth++;
+            compile_until(c, &start, c->text.length, NULL, 0, true);
+            c->depth--;
+        }
+        c->t->ops[op].end = c->t->op_count;
+        return after;
+    }
+
+    return 0;
+}
+
+/**
+ * Compiles text from *pos until one of stops or end.
+ * @return The index of the stop that ended it, or -1 at end.
+ */
+static int compile_until(Compiler* c, size_t* pos, size_t end, const char* const* stops, int stop_count,
+                         bool in_component) {
+    size_t text_start = *pos;
+    while (*pos < end) {
+        /* Re-read the base each time: components and routes grow the text. */
+        const char* p = c->text.data + *pos;
+        const char* limit = c->text.data + end;
+
+        if (p[0] == '{' && p + 1 < limit && p[1] == '{') {
+            const char* close = memmem(p + 2, limit - p - 2, "}}", 2);
+            if (close && close > p + 2) {
+                add_text(c, text_start, *pos);
+                size_t close_at = close - c->text.data;
+                compile_placeholder(c, *pos, close_at, in_component);
+                *pos = text_start = close_at + 2;
+                continue;
+            }
+        } else if (p[0] == '@') {
+            for (int i = 0; i < stop_count; i++) {
+                if (starts_with(p, limit, stops[i])) {
+                    add_text(c, text_start, *pos);
+                    *pos += strlen(stops[i]);
+                    return i;
+                }
+            }
+            int ops_before = c->t->op_count;
+            add_text(c, text_start, *pos);
+            size_t after = compile_directive(c, *pos, end, in_component);
+            if (after > 0) {
+                *pos = text_start = after;
+                continue;
+            }
+            c->t->op_count = ops_before;    // not a directive: the '@' stays in the text run
+        }
+        (*pos)++;
+    }
+    add_text(c, text_start, *pos);
+    return -1;
+}
+
+static void template_free(Template* t) {
+    for (int i = 0; i < t->op_count; i++) {
+        free(t->ops[i].name);
+        free(t->ops[i].alias);
+    }
+    for (int i = 0; i < t->source_count; i++) free(t->sources[i].path);
+    free(t->ops);
+    free(t->sources);
+    free(t->text);
+    free(t->path);
+    free(t);
+}
+
+static Template* template_compile(const char* path) {
+    Template* t = calloc(1, sizeof(Template));
+    t->path = strdup(path);
+    Compiler c = {t, {NULL, 0, 0}, 0, 0};
+
+    size_t child_len;
+    char* child = load_source(t, path, &child_len);
+    if (child == NULL) {
+        template_free(t);
+        return NULL;
+    }
+
+    TemplateBuffer page = {NULL, 0, 0};
+    char layout_path[TEMPLATE_MAX_NAME];
+    size_t layout_len;
+    char* layout = NULL;
+    if (strncmp(child, "@extends", 8) == 0 && sscanf(child, "@extends(\"%127[^\"]\")", layout_path) == 1)
+        layout = load_source(t, layout_path, &layout_len);
+
+    if (layout) {
+        compose_layout(&page, layout, layout_len, child);
+        free(layout);
+    } else {
+        buffer_append(&page, child, child_len);
+    }
+    free(child);
+
+    compose_includes(&c, &c.text, page.data, page.length, 0);
+    free(page.data);
+
+    size_t pos = 0;
+    compile_until(&c, &pos, c.text.length, NULL, 0, false);
+    t->text = c.text.data;
+    return t;
+}
+
+/* ---- Rendering ---- */
+
+static bool lookup(Renderer* r, const char* name, int parts, Value* out) {
+    bool found = false;
+    for (int i = r->scope_count - 1; i >= 0 && !found; i--) {
+        if (strcmp(r->scopes[i].name, name) == 0) {
+            *out = r->scopes[i].value;
+            found = true;
+        }
+    }
+    if (!found && (r->data == NULL || !map_get(r->data, name, out))) return false;
+
+    for (int i = 1; i < parts; i++) {
+        name += strlen(name) + 1;
+        if (VALUE_TYPE(*out) != VAL_MAP || !map_get(AS_MAP(*out), name, out)) return false;
+    }
+    return true;
+}
+
+/** @if accepts true, non-empty strings and non-zero numbers. */
+static bool if_truthy(Value v) {
+    if (VALUE_TYPE(v) == VAL_BOOL) return AS_BOOL(v);
+    if (VALUE_TYPE(v) == VAL_STRING) return AS_STRING(v)[0] != '\0';
+    if (VALUE_TYPE(v) == VAL_NUMBER) return AS_NUMBER(v) != 0;
+    return false;
+}
+
+static void render_value(Renderer* r, Value v) {
+    if (VALUE_TYPE(v) == VAL_STRING) {
+        buffer_append(&r->out, AS_STRING(v), strlen(AS_STRING(v)));
+        return;
+    }
+    char* text = value_to_string(v);
+    buffer_append(&r->out, text, strlen(text));
+    free(text);
+}
+
+static void render_range(Renderer* r, int from, int to) {
+    const Template* t = r->t;
+    int i = from;
+    while (i < to) {
+        const TemplateOp* op = &t->ops[i];
+        Value v;
+        switch (op->type) {
+            case OP_TEXT:
+                buffer_append(&r->out, t->text + op->start, op->length);
+                i++;
+                break;
+
+            case OP_VAR:
+                if (lookup(r, op->name, op->parts, &v)) render_value(r, v);
+                else buffer_append(&r->out, t->text + op->start, op->length);
+                i++;
+                break;
+
+            case OP_IF: {
+                bool taken = lookup(r, op->name, op->parts, &v) && (op->loose ? is_value_truthy(v) : if_truthy(v));
+                if (taken) render_range(r, i + 1, op->middle);
+                else render_range(r, op->middle, op->end);
+                i = op->end;
+                break;
+            }
+
+            case OP_FOR:
+                if (lookup(r, op->name, op->parts, &v) && VALUE_TYPE(v) == VAL_ARRAY && r->scope_count < TEMPLATE_MAX_DEPTH) {
+                    ValueArray* items = AS_ARRAY(v);
+                    TemplateScope* scope = &r->scopes[r->scope_count++];
+                    scope->name = op->alias;
+                    for (int k = 0; k < items->count; k++) {
+                        scope->value = items->values[k];
+                        render_range(r, i + 1, op->end);
+                    }
+                    r->scope_count--;
+                }
+                i = op->end;
+                break;
+
+            case OP_COMPONENT:
+                if (r->slot_count < TEMPLATE_MAX_DEPTH) {
+                    r->slots[r->slot_count][0] = i + 1;
+                    r->slots[r->slot_count][1] = op->middle;
+                    r->slot_count++;
+                    render_range(r, op->middle, op->end);
+                    r->slot_count--;
+                }
+                i = op->end;
+                break;
+
+            case OP_SLOT:
+                /* The slot belongs to the page around the component, so it
+                   renders with that page's own slot, if any. */
+                if (r->slot_count > 0) {
+                    int* slot = r->slots[--r->slot_count];
+                    render_range(r, slot[0], slot[1]);
+                    r->slot_count++;
+                }
+                i++;
+                break;
+        }
+    }
+}
+
+/* ---- Cache ---- */
+
+static unsigned path_hash(const char* path) {
+    unsigned hash = 2166136261u;
+    for (const unsigned char* p = (const unsigned char*)path; *p; p++) hash = (hash ^ *p) * 16777619u;
+    return hash % TEMPLATE_CACHE_BUCKETS;
+}
+
+static void template_release(Template* t) {
+    pthread_mutex_lock(&cache_lock);
+    bool last = --t->refs == 0;
+    pthread_mutex_unlock(&cache_lock);
+    if (last) template_free(t);
+}
+
+/** Replaces the cached template for path with t, which may be NULL. */
+static void cache_store(const char* path, Template* t) {
+    Template* old = NULL;
+    pthread_mutex_lock(&cache_lock);
+    Template** link = &cache[path_hash(path)];
+    while (*link && strcmp((*link)->path, path) != 0) link = &(*link)->next;
+    if (*link) {
+        old = *link;
+        *link = old->next;
+    }
+    if (t) {
+        t->refs = 2;    // the cache's and the caller's
+        t->next = cache[path_hash(path)];
+        cache[path_hash(path)] = t;
+    }
+    pthread_mutex_unlock(&cache_lock);
+    if (old) template_release(old);
+}
+
+static Template* template_get(const char* path) {
+    pthread_mutex_lock(&cache_lock);
+    Template* t = cache[path_hash(path)];
+    while (t && strcmp(t->path, path) != 0) t = t->next;
+    if (t) t->refs++;
+    pthread_mutex_unlock(&cache_lock);
+
+    if (t && template_fresh(t)) return t;
+    if (t) template_release(t);
+
+    t = template_compile(path);
+    cache_store(path, t);
+    return t;
+}
+
+char* template_render_file(const char* path, HashMap* data, size_t* length) {
+    Template* t = template_get(path);
+    if (t == NULL) return NULL;
+
+    Renderer r;
+    memset(&r, 0, sizeof(r));
+    r.t = t;
+    r.data = data;
+    buffer_append(&r.out, "", 0);
+    render_range(&r, 0, t->op_count);
+    template_release(t);
+
+    *length = r.out.length;
+    return r.out.data;
+}
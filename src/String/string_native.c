@@ -1,4 +1,6 @@
 #include "String/string_native.h"
+#include "methods.h"
+#include "string_object.h"
 #include <stdlib.h>
 #include <string.h>
 #include <errno.h>
@@ -6,7 +8,7 @@
 #define STRING_REGISTER(env, name, func) \
     do { \
         if (func != NULL) { \
-            set_var(env, name, (Value){VAL_NATIVE, {.native = func}}, true, ""); \
+            set_var(env, name, NATIVE_VAL(func), true, ""); \
         } else { \
             printf("Socket Error: Native function '%s' not implemented!\n", name); \
         } \
@@ -14,11 +16,11 @@
 
 
 Value native_string_uppercase(int arg_count, Value* args) {
-    if (arg_count < 1 || args[0].type != VAL_STRING) {
-        return (Value){VAL_NIL, {0}};
+    if (arg_count < 1 || VALUE_TYPE(args[0]) != VAL_STRING) {
+        return NIL_VAL;
     }
 
-    const char* source = args[0].as.string;
+    const char* source = AS_STRING(args[0]);
     int length = strlen(source);
     
     char* result = malloc(length + 1);
@@ -28,91 +30,93 @@ Value native_string_uppercase(int arg_count, Value* args) {
     }
     result[length] = '\0';
 
-    Value res_val = (Value){VAL_STRING, {.string = result}};
+    Value res_val = string_new(result, length);
+    free(result);
     return res_val;
 }
 
 Value native_string_lowercase(int arg_count, Value* args) {
-    if (arg_count < 1 || args[0].type != VAL_STRING) {
-        return (Value){VAL_NIL, {0}};
+    if (arg_count < 1 || VALUE_TYPE(args[0]) != VAL_STRING) {
+        return NIL_VAL;
     }
 
-    const char* source = args[0].as.string;
+    const char* source = AS_STRING(args[0]);
     int length = strlen(source);
     
     char* result = malloc(length + 1);
-    if (result == NULL) return (Value){VAL_NIL, {0}};
+    if (result == NULL) return NIL_VAL;
     
     for (int i = 0; i < length; i++) {
         result[i] = (char)tolower((unsigned char)source[i]);
     }
     result[length] = '\0';
 
-    Value res_val = (Value){VAL_STRING, {.string = result}};
+    Value res_val = string_new(result, length);
+    free(result);
     return res_val;
 }
 
 Value native_string_startswith(int arg_count, Value* args) {
-    if (arg_count < 2 || args[0].type != VAL_STRING || args[1].type != VAL_STRING) {
-        return (Value){VAL_NUMBER, {.number = 0}};
+    if (arg_count < 2 || VALUE_TYPE(args[0]) != VAL_STRING || VALUE_TYPE(args[1]) != VAL_STRING) {
+        return NUMBER_VAL(0);
     }
 
-    const char* str = args[0].as.string;
-    const char* prefix = args[1].as.string;
+    const char* str = AS_STRING(args[0]);
+    const char* prefix = AS_STRING(args[1]);
     size_t str_len = strlen(str);
     size_t prefix_len = strlen(prefix);
 
-    if (prefix_len > str_len) return (Value){VAL_NUMBER, {.number = 0}};
+    if (prefix_len > str_len) return NUMBER_VAL(0);
 
     if (strncmp(str, prefix, prefix_len) == 0) {
-        return (Value){VAL_NUMBER, {.number = 1}};
+        return NUMBER_VAL(1);
     }
-    return (Value){VAL_NUMBER, {.number = 0}};
+    return NUMBER_VAL(0);
 }
 
 Value native_string_endswith(int arg_count, Value* args) {
-    if (arg_count < 2 || args[0].type != VAL_STRING || args[1].type != VAL_STRING) {
-        return (Value){VAL_NUMBER, {.number = 0}};
+    if (arg_count < 2 || VALUE_TYPE(args[0]) != VAL_STRING || VALUE_TYPE(args[1]) != VAL_STRING) {
+        return NUMBER_VAL(0);
     }
 
-    const char* str = args[0].as.string;
-    const char* suffix = args[1].as.string;
+    const char* str = AS_STRING(args[0]);
+    const char* suffix = AS_STRING(args[1]);
     size_t str_len = strlen(str);
     size_t suffix_len = strlen(suffix);
 
-    if (suffix_len > str_len) return (Value){VAL_NUMBER, {.number = 0}};
+    if (suffix_len > str_len) return NUMBER_VAL(0);
 
     if (strcmp(str + str_len - suffix_len, suffix) == 0) {
-        return (Value){VAL_NUMBER, {.number = 1}};
+        return NUMBER_VAL(1);
     }
-    return (Value){VAL_NUMBER, {.number = 0}};
+    return NUMBER_VAL(0);
 }
 
 Value native_string_contains(int arg_count, Value* args) {
-    if (arg_count < 2 || args[0].type != VAL_STRING || args[1].type != VAL_STRING) {
-        return (Value){VAL_BOOL, {.boolean = false}};
+    if (arg_count < 2 || VALUE_TYPE(args[0]) != VAL_STRING || VALUE_TYPE(args[1]) != VAL_STRING) {
+        return BOOL_VAL(false);
     }
 
-    const char* str = args[0].as.string;
-    const char* needle = args[1].as.string;
+    const char* str = AS_STRING(args[0]);
+    const char* needle = AS_STRING(args[1]);
 
     if (strstr(str, needle) != NULL) {
-        return (Value){VAL_BOOL, {.boolean = true}};
+        return BOOL_VAL(true);
     }
-    return (Value){VAL_BOOL, {.boolean = false}};
+    return BOOL_VAL(false);
 }
 
 Value native_string_replace(int arg_count, Value* args) {
-    if (arg_count < 3 || args[0].type != VAL_STRING || 
-        args[1].type != VAL_STRING || args[2].type != VAL_STRING) {
-        return (Value){VAL_NIL, {0}};
+    if (arg_count < 3 || VALUE_TYPE(args[0]) != VAL_STRING || 
+        VALUE_TYPE(args[1]) != VAL_STRING || VALUE_TYPE(args[2]) != VAL_STRING) {
+        return NIL_VAL;
     }
 
-    const char* str = args[0].as.string;
-    const char* old_sub = args[1].as.string;
-    const char* new_sub = args[2].as.string;
+    const char* str = AS_STRING(args[0]);
+    const char* old_sub = AS_STRING(args[1]);
+    const char* new_sub = AS_STRING(args[2]);
 
-    if (strlen(old_sub) == 0) return (Value){VAL_STRING, {.string = strdup(str)}};
+    if (strlen(old_sub) == 0) return string_copy(str);
 
     char *result;
     int i, count = 0;
@@ -127,7 +131,7 @@ Value native_string_replace(int arg_count, Value* args) {
     }
 
     result = (char *)malloc(i + count * (new_len - old_len) + 1);
-    if (result == NULL) return (Value){VAL_NIL, {0}};
+    if (result == NULL) return NIL_VAL;
 
     i = 0;
     while (*str) {
@@ -141,43 +145,57 @@ Value native_string_replace(int arg_count, Value* args) {
     }
     result[i] = '\0';
 
-    return (Value){VAL_STRING, {.string = result}};
+    Value res_val = string_new(result, i);
+    free(result);
+    return res_val;
 }
 Value native_string_trim(int arg_count, Value* args) {
-    if (arg_count < 1 || args[0].type != VAL_STRING) return (Value){VAL_NIL, {0}, NULL};
+    if (arg_count < 1 || VALUE_TYPE(args[0]) != VAL_STRING) return NIL_VAL;
     
-    char* str = args[0].as.string;
+    char* str = AS_STRING(args[0]);
     char* end;
 
     while(isspace((unsigned char)*str)) str++;
 
-    if(*str == 0) return (Value){VAL_STRING, {.string = strdup("")}, NULL};
+    if(*str == 0) return string_new("", 0);
 
     end = str + strlen(str) - 1;
     while(end > str && isspace((unsigned char)*end)) end--;
 
-    int len = (int)(end - str + 1);
-    char* trimmed = malloc(len + 1);
-    strncpy(trimmed, str, len);
-    trimmed[len] = '\0';
-
-    return (Value){VAL_STRING, {.string = trimmed}, NULL};
+    return string_new(str, (size_t)(end - str + 1));
 }
 
 Value native_str_contains(int arity, Value* args) {
-    if (arity < 2 || args[0].type != VAL_STRING || args[1].type != VAL_STRING) {
-        return (Value){VAL_BOOL, {.boolean = false}};
+    if (arity < 2 || VALUE_TYPE(args[0]) != VAL_STRING || VALUE_TYPE(args[1]) != VAL_STRING) {
+        return BOOL_VAL(false);
     }
 
-    const char* haystack = args[0].as.string;
-    const char* needle = args[1].as.string;   
+    const char* haystack = AS_STRING(args[0]);
+    const char* needle = AS_STRING(args[1]);   
 
     if (strstr(haystack, needle) != NULL) {
-        return (Value){VAL_BOOL, {.boolean = true}};
+        return BOOL_VAL(true);
     }
 
-    return (Value){VAL_BOOL, {.boolean = false}};
+    return BOOL_VAL(false);
+}
+/* ---- Methods of strings, called as str.name() ---- */
+
+static Value string_method_to_number(Env *env, Value receiver, int arg_count, Value *args)
+{
+    return NUMBER_VAL(atof(AS_STRING(receiver)));
+}
+
+static Value string_method_to_string(Env *env, Value receiver, int arg_count, Value *args)
+{
+    return copy_value(receiver);
+}
+
+static Value string_method_length(Env *env, Value receiver, int arg_count, Value *args)
+{
+    return NUMBER_VAL((double)strlen(AS_STRING(receiver)));
 }
+
 void register_string_natives(Env* env) {
     STRING_REGISTER(env, "__str_toUpper", native_string_uppercase);
     STRING_REGISTER(env, "__str_toLower", native_string_lowercase);
@@ -187,4 +205,8 @@ void register_string_natives(Env* env) {
     STRING_REGISTER(env, "__str_replace", native_string_replace);
     STRING_REGISTER(env, "__str_trim", native_string_trim);
     STRING_REGISTER(env,"__str_contains__",native_string_contains);
+
+    register_method(VAL_STRING, "toNumber", string_method_to_number);
+    register_method(VAL_STRING, "toString", string_method_to_string);
+    register_method(VAL_STRING, "length", string_method_length);
 }
\ No newline at end of file
@@ -1,4 +1,6 @@
 #include"System/system_native.h"
+#include "string_object.h"
+#include "gc.h"
 #include <stdlib.h>
 #include <string.h>
 #include <errno.h>
@@ -22,7 +24,7 @@ extern char** global_argv;
 #define SYS_REGISTER(env, name, func) \
     do { \
         if (func != NULL) { \
-            set_var(env, name, (Value){VAL_NATIVE, {.native = func}}, true, ""); \
+            set_var(env, name, NATIVE_VAL(func), true, ""); \
         } else { \
             printf("Error: Native function '%s' not implemented!\n", name); \
         } \
@@ -30,81 +32,83 @@ extern char** global_argv;
 
 Value native_system_platform(int arg_count, Value* args) {
     #ifdef _WIN32
-        return (Value){VAL_STRING, {.string = strdup("windows")}};
+        return string_copy("windows");
     #elif __APPLE__
         #include <TargetConditionals.h>
         #if TARGET_OS_IPHONE
-            return (Value){VAL_STRING, {.string = strdup("ios")}};
+            return string_copy("ios");
         #else
-            return (Value){VAL_STRING, {.string = strdup("macos")}};
+            return string_copy("macos");
         #endif
     #elif __linux__
-        return (Value){VAL_STRING, {.string = strdup("linux")}};
+        return string_copy("linux");
     #elif __unix__
-        return (Value){VAL_STRING, {.string = strdup("unix")}};
+        return string_copy("unix");
     #else
-        return (Value){VAL_STRING, {.string = strdup("unknown")}};
+        return string_copy("unknown");
     #endif
 }
 
 Value native_system_platform_id(int arg_count, Value* args) {
     #ifdef _WIN32
-        return (Value){VAL_NUMBER, {.number = WINDOWS}};
+        return NUMBER_VAL(WINDOWS);
     #elif __APPLE__
-        return (Value){VAL_NUMBER, {.number = MACOS}};
+        return NUMBER_VAL(MACOS);
     #elif __linux__
-        return (Value){VAL_NUMBER, {.number = LINUX}};
+        return NUMBER_VAL(LINUX);
     #elif __unix__
-        return (Value){VAL_NUMBER, {.number = UNIX}};
+        return NUMBER_VAL(UNIX);
     #else
-        return (Value){VAL_NUMBER, {.number = UNKNOWN}};
+        return NUMBER_VAL(UNKNOWN);
     #endif
 }
 Value native_system_exec(int arg_count, Value* args) {
-    if (arg_count < 1 || args[0].type != VAL_STRING) {
-        return (Value){VAL_NUMBER, {.number = -1}};
+    if (arg_count < 1 || VALUE_TYPE(args[0]) != VAL_STRING) {
+        return NUMBER_VAL(-1);
     }
     
-    int result = system(args[0].as.string);
-    return (Value){VAL_NUMBER, {.number = (double)result}};
+    int result = system(AS_STRING(args[0]));
+    return NUMBER_VAL((double)result);
 }
 
 Value native_sys_sleep(int arg_count, Value* args) {
-    if (arg_count < 1 || args[0].type != VAL_NUMBER) return (Value){VAL_NIL, {0}};
-    int ms = (int)args[0].as.number;
+    if (arg_count < 1 || VALUE_TYPE(args[0]) != VAL_NUMBER) return NIL_VAL;
+    int ms = (int)AS_NUMBER(args[0]);
 #ifdef _WIN32
     Sleep(ms);
 #else
+    gc_blocking_begin();
     usleep(ms * 1000);
+    gc_blocking_end();
 #endif
-    return (Value){VAL_NIL, {0}};
+    return NIL_VAL;
 }
 
 Value native_sys_now(int arg_count, Value* args) {
     struct timeval tv;
     gettimeofday(&tv, NULL);
     double ms = (double)(tv.tv_sec) * 1000 + (double)(tv.tv_usec) / 1000;
-    return (Value){VAL_NUMBER, {.number = ms}};
+    return NUMBER_VAL(ms);
 }
 
 Value native_system_getenv(int arg_count, Value* args) {
-    if (arg_count < 1 || args[0].type != VAL_STRING) {
-        return (Value){VAL_NIL, {0}, NULL};
+    if (arg_count < 1 || VALUE_TYPE(args[0]) != VAL_STRING) {
+        return NIL_VAL;
     }
     
-    char* val = getenv(args[0].as.string);
-    if (val == NULL) return (Value){VAL_NIL, {0}, NULL};
+    char* val = getenv(AS_STRING(args[0]));
+    if (val == NULL) return NIL_VAL;
     
-    return (Value){VAL_STRING, {.string = strdup(val)}, NULL};
+    return string_copy(val);
 }
 
 Value native_system_exit(int arg_count, Value* args) {
     int code = 0;
-    if (arg_count > 0 && args[0].type == VAL_NUMBER) {
-        code = (int)args[0].as.number;
+    if (arg_count > 0 && VALUE_TYPE(args[0]) == VAL_NUMBER) {
+        code = (int)AS_NUMBER(args[0]);
     }
     exit(code); 
-    return (Value){VAL_NIL, {0}, NULL};
+    return NIL_VAL;
 }
 
 Value native_system_cwd(int arg_count, Value* args) {
@@ -115,28 +119,28 @@ Value native_system_cwd(int arg_count, Value* args) {
         if (getcwd(cwd, sizeof(cwd)) != NULL)
     #endif
     {
-        return (Value){VAL_STRING, {.string = strdup(cwd)}, NULL};
+        return string_copy(cwd);
     }
-    return (Value){VAL_NIL, {0}, NULL};
+    return NIL_VAL;
 }
 
 Value native_system_args(int arg_count, Value* args) {
     ValueArray* array = array_new();
 
     for (int i = 0; i < global_argc; i++) {
-        Value str_val = (Value){VAL_STRING, {.string = strdup(global_argv[i])}, NULL};
+        Value str_val = string_copy(global_argv[i]);
         
         array_append(array, str_val);
     }
 
-    return (Value){VAL_ARRAY, {.array = array}, NULL};
+    return ARRAY_VAL(array);
 }
 void register_sys_natives(Env* env){
 
-    set_var(env, "WINDOWS", (Value){VAL_NUMBER, {.number = WINDOWS}}, true, "");
-    set_var(env, "MACOS",   (Value){VAL_NUMBER, {.number = MACOS}}, true, "");
-    set_var(env, "LINUX",   (Value){VAL_NUMBER, {.number = LINUX}}, true, "");
-    set_var(env, "UNIX",    (Value){VAL_NUMBER, {.number = UNIX}}, true, "");
+    set_var(env, "WINDOWS", NUMBER_VAL(WINDOWS), true, "");
+    set_var(env, "MACOS",   NUMBER_VAL(MACOS), true, "");
+    set_var(env, "LINUX",   NUMBER_VAL(LINUX), true, "");
+    set_var(env, "UNIX",    NUMBER_VAL(UNIX), true, "");
 
     SYS_REGISTER(env,"__sys_run",native_system_exec);
     SYS_REGISTER(env,"__sys_sleep",native_sys_sleep);
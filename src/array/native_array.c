@@ -6,13 +6,15 @@
 #include <sys/stat.h>
 #include "env.h"
 #include "eval.h"
+#include "methods.h"
+#include "task.h"
 
 #define ARRAY_REGISTER(env, name, func)                                           \
     do                                                                           \
     {                                                                            \
         if (func != NULL)                                                        \
         {                                                                        \
-            set_var(env, name, (Value){VAL_NATIVE, {.native = func}}, true, ""); \
+            set_var(env, name, NATIVE_VAL(func), true, ""); \
         }                                                                        \
         else                                                                     \
         {                                                                        \
@@ -22,13 +24,13 @@
 
 Value builtin_array_distinct(int argCount, Value *args)
 {
-    if (argCount != 1 || args[0].type != VAL_ARRAY)
+    if (argCount != 1 || VALUE_TYPE(args[0]) != VAL_ARRAY)
     {
         print_error("distinct() requires an Array.");
-        return (Value){VAL_NIL, {0}};
+        return NIL_VAL;
     }
 
-    ValueArray *old_arr = args[0].as.array;
+    ValueArray *old_arr = AS_ARRAY(args[0]);
     ValueArray *new_arr = array_new();
 
     for (int i = 0; i < old_arr->count; i++)
@@ -37,7 +39,7 @@ Value builtin_array_distinct(int argCount, Value *args)
         for (int j = 0; j < new_arr->count; j++)
         {
             Value eq = eval_equals(old_arr->values[i], new_arr->values[j]);
-            if (eq.as.number == 1.0)
+            if (AS_NUMBER(eq) == 1.0)
             {
                 is_dup = true;
                 break;
@@ -48,18 +50,18 @@ Value builtin_array_distinct(int argCount, Value *args)
             array_append(new_arr, copy_value(old_arr->values[i]));
         }
     }
-    return (Value){VAL_ARRAY, {.array = new_arr}};
+    return ARRAY_VAL(new_arr);
 }
 
 Value builtin_array_anyMatch(int argCount, Value *args)
 {
-    if (argCount != 2 || args[0].type != VAL_ARRAY)
+    if (argCount != 2 || VALUE_TYPE(args[0]) != VAL_ARRAY)
     {
         print_error("anyMatch() requires 2 arguments: (Array, Callback).");
-        return (Value){VAL_NUMBER, {.number = 0.0}};
+        return NUMBER_VAL(0.0);
     }
 
-    ValueArray *arr = args[0].as.array;
+    ValueArray *arr = AS_ARRAY(args[0]);
     Value callback = args[1];
 
     for (int i = 0; i < arr->count; i++)
@@ -71,22 +73,22 @@ Value builtin_array_anyMatch(int argCount, Value *args)
         if (is_value_truthy(res))
         {
             free_value(res);
-            return (Value){VAL_NUMBER, {.number = 1.0}};
+            return NUMBER_VAL(1.0);
         }
         free_value(res);
     }
-    return (Value){VAL_NUMBER, {.number = 0.0}};
+    return NUMBER_VAL(0.0);
 }
 
 Value builtin_array_map(int argCount, Value *args)
 {
-    if (argCount != 2 || args[0].type != VAL_ARRAY || args[1].type != VAL_FUNCTION)
+    if (argCount != 2 || VALUE_TYPE(args[0]) != VAL_ARRAY || VALUE_TYPE(args[1]) != VAL_FUNCTION)
     {
         print_error("map() expects (Array, Callback).");
-        return (Value){VAL_NIL, {0}};
+        return NIL_VAL;
     }
 
-    ValueArray *old_arr = args[0].as.array;
+    ValueArray *old_arr = AS_ARRAY(args[0]);
     Value callback = args[1];
     ValueArray *new_arr = array_new();
 
@@ -97,17 +99,17 @@ Value builtin_array_map(int argCount, Value *args)
         array_append(new_arr, new_val);
     }
 
-    return (Value){VAL_ARRAY, {.array = new_arr}};
+    return ARRAY_VAL(new_arr);
 }
 Value builtin_array_filter(int argCount, Value *args)
 {
-    if (argCount != 2 || args[0].type != VAL_ARRAY || args[1].type != VAL_FUNCTION)
+    if (argCount != 2 || VALUE_TYPE(args[0]) != VAL_ARRAY || VALUE_TYPE(args[1]) != VAL_FUNCTION)
     {
         print_error("filter() expects (Array, Callback).");
-        return (Value){VAL_NIL, {0}};
+        return NIL_VAL;
     }
 
-    ValueArray *old_arr = args[0].as.array;
+    ValueArray *old_arr = AS_ARRAY(args[0]);
     Value callback = args[1];
     ValueArray *new_arr = array_new();
 
@@ -122,18 +124,18 @@ Value builtin_array_filter(int argCount, Value *args)
         free_value(result);
     }
 
-    return (Value){VAL_ARRAY, {.array = new_arr}};
+    return ARRAY_VAL(new_arr);
 }
 
 Value builtin_array_reduce(int argCount, Value *args)
 {
-    if (argCount < 2 || args[0].type != VAL_ARRAY || args[1].type != VAL_FUNCTION)
+    if (argCount < 2 || VALUE_TYPE(args[0]) != VAL_ARRAY || VALUE_TYPE(args[1]) != VAL_FUNCTION)
     {
         print_error("reduce() expects at least (Array, Callback).");
-        return (Value){VAL_NIL, {0}};
+        return NIL_VAL;
     }
 
-    ValueArray *arr = args[0].as.array;
+    ValueArray *arr = AS_ARRAY(args[0]);
     Value callback = args[1];
     Value accumulator;
     int start_index = 0;
@@ -146,7 +148,7 @@ Value builtin_array_reduce(int argCount, Value *args)
     else
     {
         if (arr->count == 0)
-            return (Value){VAL_NIL, {0}};
+            return NIL_VAL;
         accumulator = copy_value(arr->values[0]);
         start_index = 1;
     }
@@ -162,15 +164,231 @@ Value builtin_array_reduce(int argCount, Value *args)
     return accumulator;
 }
 
+/* ---- Parallel map, filter and reduce ----
+ * The array is cut into contiguous chunks, a few per worker so that uneven
+ * callbacks still balance out, and each chunk runs on the task pool. Every
+ * callback invocation gets its own call environment on the thread running
+ * it, so chunks share nothing but the source array and the callback.
+ * A throw in the callback ends its chunk; once every chunk has finished,
+ * task_parallel_for throws the first chunk's error in the caller. */
+
+#define PAR_MIN_CHUNK 256
+#define PAR_CHUNKS_PER_WORKER 4
+
+typedef struct
+{
+    ValueArray *source;
+    Func *callback;
+    int chunk_size;
+    Value *results;   // parMap: one result per element
+    bool *keep;       // parFilter: whether each element passed
+    Value *partials;  // parReduce: one accumulator per chunk
+    Value initial;
+    bool has_initial;
+    bool seed_every_chunk;  // parReduce: initial starts every chunk, not just the first
+} ParallelJob;
+
+/**
+ * Splits count elements into chunks and returns how many there are.
+ */
+static int par_split(int count, int *chunk_size)
+{
+    int chunks = (task_pool_size() + 1) * PAR_CHUNKS_PER_WORKER;
+    int max_chunks = (count + PAR_MIN_CHUNK - 1) / PAR_MIN_CHUNK;
+    if (chunks > max_chunks)
+        chunks = max_chunks;
+    if (chunks < 1)
+        chunks = 1;
+    *chunk_size = (count + chunks - 1) / chunks;
+    return *chunk_size > 0 ? (count + *chunk_size - 1) / *chunk_size : 0;
+}
+
+static Value par_call(Func *callback, int arg_count, Value *args)
+{
+    return call_function(callback->env, callback, arg_count, args);
+}
+
+static void par_map_chunk(void *ctx, int chunk)
+{
+    ParallelJob *job = ctx;
+    int lo = chunk * job->chunk_size;
+    int hi = lo + job->chunk_size < job->source->count ? lo + job->chunk_size : job->source->count;
+    for (int i = lo; i < hi; i++)
+    {
+        Value arg = job->source->values[i];
+        job->results[i] = par_call(job->callback, 1, &arg);
+    }
+}
+
+static void par_filter_chunk(void *ctx, int chunk)
+{
+    ParallelJob *job = ctx;
+    int lo = chunk * job->chunk_size;
+    int hi = lo + job->chunk_size < job->source->count ? lo + job->chunk_size : job->source->count;
+    for (int i = lo; i < hi; i++)
+    {
+        Value arg = job->source->values[i];
+        Value result = par_call(job->callback, 1, &arg);
+        job->keep[i] = is_value_truthy(result);
+        free_value(result);
+    }
+}
+
+static void par_reduce_chunk(void *ctx, int chunk)
+{
+    ParallelJob *job = ctx;
+    int lo = chunk * job->chunk_size;
+    int hi = lo + job->chunk_size < job->source->count ? lo + job->chunk_size : job->source->count;
+
+    Value acc;
+    if (job->has_initial && (chunk == 0 || job->seed_every_chunk))
+    {
+        acc = copy_value(job->initial);
+    }
+    else
+    {
+        acc = copy_value(job->source->values[lo]);
+        lo++;
+    }
+
+    for (int i = lo; i < hi; i++)
+    {
+        Value cb_args[2] = {acc, job->source->values[i]};
+        Value next_acc = par_call(job->callback, 2, cb_args);
+        free_value(acc);
+        acc = next_acc;
+    }
+    job->partials[chunk] = acc;
+}
+
+Value builtin_array_par_map(int argCount, Value *args)
+{
+    if (argCount != 2 || VALUE_TYPE(args[0]) != VAL_ARRAY || VALUE_TYPE(args[1]) != VAL_FUNCTION)
+    {
+        print_error("parMap() expects (Array, Callback).");
+        return NIL_VAL;
+    }
+
+    ValueArray *source = AS_ARRAY(args[0]);
+    ValueArray *new_arr = array_new();
+    int count = source->count;
+    if (count > new_arr->capacity)
+    {
+        new_arr->values = realloc(new_arr->values, sizeof(Value) * count);
+        new_arr->capacity = count;
+    }
+    for (int i = 0; i < count; i++)
+        new_arr->values[i] = NIL_VAL;
+    new_arr->count = count;
+
+    ParallelJob job = {.source = source, .callback = AS_FUNCTION(args[1]), .results = new_arr->values};
+    int chunks = par_split(count, &job.chunk_size);
+    task_parallel_for(chunks, par_map_chunk, &job);
+
+    return ARRAY_VAL(new_arr);
+}
+
+Value builtin_array_par_filter(int argCount, Value *args)
+{
+    if (argCount != 2 || VALUE_TYPE(args[0]) != VAL_ARRAY || VALUE_TYPE(args[1]) != VAL_FUNCTION)
+    {
+        print_error("parFilter() expects (Array, Callback).");
+        return NIL_VAL;
+    }
+
+    ValueArray *source = AS_ARRAY(args[0]);
+    int count = source->count;
+    bool *keep = calloc(count > 0 ? count : 1, sizeof(bool));
+
+    ParallelJob job = {.source = source, .callback = AS_FUNCTION(args[1]), .keep = keep};
+    int chunks = par_split(count, &job.chunk_size);
+
+    /* keep is malloc'd, so a callback error is caught here to free it. */
+    ExceptionState saved = global_ex_state;
+    global_ex_state.active = 1;
+    if (setjmp(global_ex_state.buf) != 0)
+    {
+        Value error = global_ex_state.error_val;
+        global_ex_state = saved;
+        free(keep);
+        throw_value(error);
+    }
+    task_parallel_for(chunks, par_filter_chunk, &job);
+    global_ex_state = saved;
+
+    ValueArray *new_arr = array_new();
+    for (int i = 0; i < count; i++)
+    {
+        if (keep[i])
+            array_append(new_arr, copy_value(source->values[i]));
+    }
+    free(keep);
+
+    return ARRAY_VAL(new_arr);
+}
+
+Value builtin_array_par_reduce(int argCount, Value *args)
+{
+    if (argCount < 2 || VALUE_TYPE(args[0]) != VAL_ARRAY || VALUE_TYPE(args[1]) != VAL_FUNCTION ||
+        (argCount > 3 && VALUE_TYPE(args[3]) != VAL_FUNCTION && VALUE_TYPE(args[3]) != VAL_NIL))
+    {
+        print_error("parReduce() expects (Array, Callback, Initial?, Combiner?).");
+        return NIL_VAL;
+    }
+
+    ValueArray *source = AS_ARRAY(args[0]);
+    bool has_initial = argCount >= 3 && VALUE_TYPE(args[2]) != VAL_NIL;
+    Func *combiner = argCount > 3 && VALUE_TYPE(args[3]) == VAL_FUNCTION ? AS_FUNCTION(args[3]) : AS_FUNCTION(args[1]);
+    if (source->count == 0)
+        return has_initial ? copy_value(args[2]) : NIL_VAL;
+
+    /* Kept in a managed array so the collector still sees the partial
+       results while they are combined below. */
+    ValueArray *partials = array_new();
+
+    ParallelJob job = {
+        .source = source,
+        .callback = AS_FUNCTION(args[1]),
+        .initial = has_initial ? args[2] : NIL_VAL,
+        .has_initial = has_initial,
+        .seed_every_chunk = combiner != AS_FUNCTION(args[1]),
+    };
+    int chunks = par_split(source->count, &job.chunk_size);
+    if (chunks > partials->capacity)
+    {
+        partials->values = realloc(partials->values, sizeof(Value) * chunks);
+        partials->capacity = chunks;
+    }
+    job.partials = partials->values;
+    task_parallel_for(chunks, par_reduce_chunk, &job);
+    partials->count = chunks;
+
+    /* Without a combiner, only the first chunk starts from the initial
+       value and the others from their first element, so an initial value
+       counts once whatever the number of chunks. With one, every chunk
+       starts from the initial value, which lets the accumulator be of
+       another type than the elements. */
+    Value accumulator = copy_value(partials->values[0]);
+    for (int i = 1; i < chunks; i++)
+    {
+        Value cb_args[2] = {accumulator, partials->values[i]};
+        Value next_acc = par_call(combiner, 2, cb_args);
+        free_value(accumulator);
+        accumulator = next_acc;
+    }
+
+    return accumulator;
+}
+
 Value builtin_array_sort(int argCount, Value *args)
 {
-    if (argCount != 2 || args[0].type != VAL_ARRAY || args[1].type != VAL_FUNCTION)
+    if (argCount != 2 || VALUE_TYPE(args[0]) != VAL_ARRAY || VALUE_TYPE(args[1]) != VAL_FUNCTION)
     {
         print_error("sorted() expects (Array, Callback).");
-        return (Value){VAL_NIL, {0}};
+        return NIL_VAL;
     }
 
-    ValueArray *old_arr = args[0].as.array;
+    ValueArray *old_arr = AS_ARRAY(args[0]);
     ValueArray *new_arr = array_new();
     for (int i = 0; i < old_arr->count; i++)
     {
@@ -185,7 +403,7 @@ Value builtin_array_sort(int argCount, Value *args)
 
             Value result = call_jackal_function(NULL, args[1], 2, cb_args);
 
-            if (result.type == VAL_NUMBER && result.as.number > 0)
+            if (VALUE_TYPE(result) == VAL_NUMBER && AS_NUMBER(result) > 0)
             {
                 Value temp = new_arr->values[j];
                 new_arr->values[j] = new_arr->values[j + 1];
@@ -195,29 +413,29 @@ Value builtin_array_sort(int argCount, Value *args)
         }
     }
 
-    return (Value){VAL_ARRAY, {.array = new_arr}};
+    return ARRAY_VAL(new_arr);
 }
 
 Value builtin_array_mean(int argCount, Value *args)
 {
     if (args == NULL)
-        return (Value){VAL_NIL, {0}};
+        return NIL_VAL;
 
     Value receiver = args[-1];
-    if (receiver.type != VAL_ARRAY)
-        return (Value){VAL_NIL, {0}};
+    if (VALUE_TYPE(receiver) != VAL_ARRAY)
+        return NIL_VAL;
 
-    ValueArray *arr = receiver.as.array;
+    ValueArray *arr = AS_ARRAY(receiver);
     if (arr == NULL || arr->values == NULL)
-        return (Value){VAL_NIL, {0}};
+        return NIL_VAL;
 
     double sum = 0;
     int count = 0;
     for (int i = 0; i < arr->count; i++)
     {
-        if (arr->values[i].type == VAL_NUMBER)
+        if (VALUE_TYPE(arr->values[i]) == VAL_NUMBER)
         {
-            sum += arr->values[i].as.number;
+            sum += AS_NUMBER(arr->values[i]);
             count++;
         }
     }
@@ -225,9 +443,9 @@ Value builtin_array_mean(int argCount, Value *args)
     double result = (count > 0) ? (sum / count) : 0;
 
     ValueArray *resArr = array_new();
-    array_append(resArr, (Value){VAL_NUMBER, {.number = result}});
+    array_append(resArr, NUMBER_VAL(result));
 
-    return (Value){VAL_ARRAY, {.array = resArr}};
+    return ARRAY_VAL(resArr);
 }
 
 
@@ -235,24 +453,24 @@ Value builtin_array_mean(int argCount, Value *args)
 Value builtin_array_max(int argCount, Value *args)
 {
     if (args == NULL)
-        return (Value){VAL_NIL, {0}};
+        return NIL_VAL;
 
     Value receiver = args[-1];
-    if (receiver.type != VAL_ARRAY)
-        return (Value){VAL_NIL, {0}};
+    if (VALUE_TYPE(receiver) != VAL_ARRAY)
+        return NIL_VAL;
 
-    ValueArray *arr = receiver.as.array;
+    ValueArray *arr = AS_ARRAY(receiver);
     if (arr == NULL || arr->values == NULL || arr->count == 0)
-        return (Value){VAL_NIL, {0}};
+        return NIL_VAL;
 
     double maxVal = -1.7976931348623158e+308;
     int found = 0;
 
     for (int i = 0; i < arr->count; i++)
     {
-        if (arr->values[i].type == VAL_NUMBER)
+        if (VALUE_TYPE(arr->values[i]) == VAL_NUMBER)
         {
-            double current = arr->values[i].as.number;
+            double current = AS_NUMBER(arr->values[i]);
             if (!found || current > maxVal)
             {
                 maxVal = current;
@@ -262,25 +480,25 @@ Value builtin_array_max(int argCount, Value *args)
     }
 
     if (!found)
-        return (Value){VAL_NIL, {0}};
+        return NIL_VAL;
 
     ValueArray *resArr = array_new();
-    array_append(resArr, (Value){VAL_NUMBER, {.number = maxVal}});
+    array_append(resArr, NUMBER_VAL(maxVal));
 
-    return (Value){VAL_ARRAY, {.array = resArr}};
+    return ARRAY_VAL(resArr);
 }
 
 Value builtin_array_limit(int argCount, Value *args)
 {
 
-    if (argCount != 2 || args[0].type != VAL_ARRAY || args[1].type != VAL_NUMBER)
+    if (argCount != 2 || VALUE_TYPE(args[0]) != VAL_ARRAY || VALUE_TYPE(args[1]) != VAL_NUMBER)
     {
         print_error("limit() requires (Array, Number).");
-        return (Value){VAL_NIL, {0}};
+        return NIL_VAL;
     }
 
-    ValueArray *old_arr = args[0].as.array;
-    int limit = (int)args[1].as.number;
+    ValueArray *old_arr = AS_ARRAY(args[0]);
+    int limit = (int)AS_NUMBER(args[1]);
 
     if (limit < 0)
         limit = 0;
@@ -294,19 +512,19 @@ Value builtin_array_limit(int argCount, Value *args)
         array_append(new_arr, copy_value(old_arr->values[i]));
     }
 
-    return (Value){VAL_ARRAY, {.array = new_arr}};
+    return ARRAY_VAL(new_arr);
 }
 
 
 Value builtin_array_to_tree(int argCount, Value *args)
 {
-    if (argCount < 2 || args[0].type != VAL_ARRAY || args[1].type != VAL_STRING)
+    if (argCount < 2 || VALUE_TYPE(args[0]) != VAL_ARRAY || VALUE_TYPE(args[1]) != VAL_STRING)
     {
-        return (Value){VAL_NIL, {0}};
+        return NIL_VAL;
     }
 
-    ValueArray *src = args[0].as.array;
-    char *mode = args[1].as.string;
+    ValueArray *src = AS_ARRAY(args[0]);
+    char *mode = AS_STRING(args[1]);
     ValueArray *result = array_new();
 
     if (strcmp(mode, "inorder") == 0)
@@ -322,7 +540,110 @@ Value builtin_array_to_tree(int argCount, Value *args)
         postorder_traverse_logic(src, result, 0);
     }
 
-    return (Value){VAL_ARRAY, {.array = result}};
+    return ARRAY_VAL(result);
+}
+
+/* ---- Methods of arrays, called as arr.name(args) ---- */
+
+static Value array_method_length(Env *env, Value receiver, int arg_count, Value *args)
+{
+    return NUMBER_VAL((double)AS_ARRAY(receiver)->count);
+}
+
+static Value array_method_push(Env *env, Value receiver, int arg_count, Value *args)
+{
+    for (int i = 0; i < arg_count; i++)
+    {
+        array_append(AS_ARRAY(receiver), copy_value(args[i]));
+    }
+    return NIL_VAL;
+}
+
+static Value array_method_each(Env *env, Value receiver, int arg_count, Value *args)
+{
+    if (arg_count < 1)
+    {
+        print_error("Error: each() expects a callback function.");
+        return NIL_VAL;
+    }
+
+    Value callback = args[0];
+
+    if (VALUE_TYPE(callback) != VAL_FUNCTION && VALUE_TYPE(callback) != VAL_NATIVE)
+    {
+        print_error("Error: argument to each() must be a function.");
+        return NIL_VAL;
+    }
+
+    ValueArray *array = AS_ARRAY(receiver);
+    for (int i = 0; i < array->count; i++)
+    {
+        Value cb_args[1] = {array->values[i]};
+
+        Value result = call_jackal_function(env, callback, 1, cb_args);
+
+        free_value(result);
+    }
+
+    return NIL_VAL;
+}
+
+static Value array_method_contains(Env *env, Value receiver, int arg_count, Value *args)
+{
+    if (arg_count < 1)
+    {
+        print_error("Error: contains() expects at least 1 argument.");
+        return BOOL_VAL(0);
+    }
+
+    Value search_val = args[0];
+
+    if (VALUE_TYPE(search_val) != VAL_STRING)
+    {
+        print_error("Error: contains() argument must be a string.");
+        return BOOL_VAL(0);
+    }
+
+    ValueArray *array = AS_ARRAY(receiver);
+    bool found = false;
+
+    for (int i = 0; i < array->count; i++)
+    {
+        if (VALUE_TYPE(array->values[i]) == VAL_STRING)
+        {
+            if (strcmp(AS_STRING(array->values[i]), AS_STRING(search_val)) == 0)
+            {
+                found = true;
+                break;
+            }
+        }
+    }
+
+    return BOOL_VAL(found ? 1 : 0);
+}
+
+static Value array_method_pop(Env *env, Value receiver, int arg_count, Value *args)
+{
+    return array_pop(AS_ARRAY(receiver));
+}
+
+static Value array_method_remove(Env *env, Value receiver, int arg_count, Value *args)
+{
+    if (arg_count != 1)
+    {
+        print_error("Error: remove() takes exactly 1 argument (index).");
+        return NIL_VAL;
+    }
+
+    Value index_val = args[0];
+    if (VALUE_TYPE(index_val) != VAL_NUMBER)
+    {
+        print_error("Error: remove() argument must be a number.");
+        return NIL_VAL;
+    }
+
+    array_delete(AS_ARRAY(receiver), (int)AS_NUMBER(index_val));
+    return NIL_VAL;
 }
 
 void register_array_natives(Env *env){
@@ -331,10 +652,19 @@ void register_array_natives(Env *env){
     ARRAY_REGISTER(env,"__array_map",builtin_array_map);
     ARRAY_REGISTER(env,"__array_filter",builtin_array_filter);
     ARRAY_REGISTER(env,"__array_reduce",builtin_array_reduce);
+    ARRAY_REGISTER(env,"__array_par_map",builtin_array_par_map);
+    ARRAY_REGISTER(env,"__array_par_filter",builtin_array_par_filter);
+    ARRAY_REGISTER(env,"__array_par_reduce",builtin_array_par_reduce);
     ARRAY_REGISTER(env,"__array_sort",builtin_array_sort);
     ARRAY_REGISTER(env,"__array_mean",builtin_array_mean);
     ARRAY_REGISTER(env,"__array_max",builtin_array_max);
     ARRAY_REGISTER(env,"__array_limit",builtin_array_limit);
     ARRAY_REGISTER(env,"__array_to_tree",builtin_array_to_tree);
-    
+
+    register_method(VAL_ARRAY, "length", array_method_length);
+    register_method(VAL_ARRAY, "push", array_method_push);
+    register_method(VAL_ARRAY, "each", array_method_each);
+    register_method(VAL_ARRAY, "contains", array_method_contains);
+    register_method(VAL_ARRAY, "pop", array_method_pop);
+    register_method(VAL_ARRAY, "remove", array_method_remove);
 }
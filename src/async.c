@@ -0,0 +1,746 @@
+#include "async.h"
+#include "eval.h"
+#include "env.h"
+#include "value.h"
+#include "gc.h"
+#include "methods.h"
+#include "task.h"
+#include <errno.h>
+#include <math.h>
+#include <poll.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/mman.h>
+#include <time.h>
+#include <ucontext.h>
+#include <unistd.h>
+
+#if defined(__SANITIZE_ADDRESS__)
+#include <sanitizer/common_interface_defs.h>
+#define ASYNC_ASAN 1
+#endif
+
+#define FIBER_STACK_SIZE (8 * 1024 * 1024)   // like a main thread; pages are only committed when touched
+#define FIBER_GUARD_SIZE 4096
+#define FIBER_STACK_POOL 64
+#define MAX_EVENTS 256
+
+/**
+ * @typedef @struct FIBER
+ * An @async call in progress, or the main program (main_fiber) while a
+ * fiber runs. Holds everything that is per-thread for the evaluator and
+ * has to be swapped with the C stack.
+ */
+typedef struct Fiber {
+    ucontext_t context;
+    char* stack;                // mapping with a guard page below; NULL for the main program
+    char* stack_top;            // highest address of the stack
+    char* sp;                   // stack pointer when the fiber last switched away
+    const void* asan_bottom;    // stack bounds and fake stack for AddressSanitizer
+    size_t asan_size;
+    void* asan_fake_stack;
+
+    Promise* promise;
+    Value func;
+    Value* args;
+    int arg_count;
+
+    ExceptionState ex_state;
+    Func* executing_func;
+    FrameArena* arena;
+
+    AsyncTimer* timer;          // timeout of the current wait
+    int wait_fd;                // descriptor waited on, -1 if none
+    bool io_ready;
+    bool woken;                 // main program only: a wake arrived
+    bool queued;
+    bool finished;
+
+    struct Fiber* next_ready;
+    struct Fiber* next_waiter;  // other fibers awaiting the same promise
+    struct Fiber* prev;         // list of live fibers
+    struct Fiber* next;
+} Fiber;
+
+struct AsyncTimer {
+    double due;
+    unsigned long seq;          // keeps timers with the same due time in FIFO order
+    AsyncTimerCallback cb;
+    void* ctx;
+    Value keep;                 // managed value the timer holds on to
+    int index;                  // position in the heap
+};
+
+typedef struct {
+    AsyncIoCallback cb;
+    void* ctx;
+    int events;
+} Watch;
+
+static __thread bool is_loop_thread = false;
+
+static Fiber main_fiber;
+static Fiber* current = &main_fiber;
+static Fiber* fibers = NULL;
+static Fiber* ready_head = NULL;
+static Fiber* ready_tail = NULL;
+
+static AsyncTimer** timers = NULL;
+static int timer_count = 0;
+static int timer_capacity = 0;
+static unsigned long timer_seq = 0;
+
+static int epoll_fd = -1;
+static Watch* watches = NULL;
+static int watch_capacity = 0;
+static int watch_count = 0;
+
+static char* stack_pool[FIBER_STACK_POOL];
+static int stack_pool_count = 0;
+
+static void loop_once(void);
+
+static double now_ms(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000.0 + ts.tv_nsec / 1e6;
+}
+
+static bool loop_has_work(void)
+{
+    return ready_head != NULL || timer_count > 0 || watch_count > 0;
+}
+
+/* ---- Timers ---- */
+
+static bool timer_before(AsyncTimer* a, AsyncTimer* b)
+{
+    return a->due < b->due || (a->due == b->due && a->seq < b->seq);
+}
+
+static void heap_set(int index, AsyncTimer* timer)
+{
+    timers[index] = timer;
+    timer->index = index;
+}
+
+static void heap_up(int index)
+{
+    AsyncTimer* timer = timers[index];
+    while (index > 0)
+    {
+        int parent = (index - 1) / 2;
+        if (!timer_before(timer, timers[parent]))
+            break;
+        heap_set(index, timers[parent]);
+        index = parent;
+    }
+    heap_set(index, timer);
+}
+
+static void heap_down(int index)
+{
+    AsyncTimer* timer = timers[index];
+    for (;;)
+    {
+        int child = index * 2 + 1;
+        if (child >= timer_count)
+            break;
+        if (child + 1 < timer_count && timer_before(timers[child + 1], timers[child]))
+            child++;
+        if (!timer_before(timers[child], timer))
+            break;
+        heap_set(index, timers[child]);
+        index = child;
+    }
+    heap_set(index, timer);
+}
+
+static void heap_remove(AsyncTimer* timer)
+{
+    int index = timer->index;
+    AsyncTimer* last = timers[--timer_count];
+    if (index < timer_count)
+    {
+        heap_set(index, last);
+        heap_up(index);
+        heap_down(last->index);
+    }
+}
+
+AsyncTimer* async_timer_start(double ms, AsyncTimerCallback cb, void* ctx)
+{
+    if (timer_count == timer_capacity)
+    {
+        timer_capacity = timer_capacity < 16 ? 16 : timer_capacity * 2;
+        timers = realloc(timers, sizeof(AsyncTimer*) * timer_capacity);
+    }
+
+    AsyncTimer* timer = malloc(sizeof(AsyncTimer));
+    timer->due = now_ms() + (ms > 0 ? ms : 0);
+    timer->seq = timer_seq++;
+    timer->cb = cb;
+    timer->ctx = ctx;
+    timer->keep = NIL_VAL;
+    heap_set(timer_count++, timer);
+    heap_up(timer->index);
+    return timer;
+}
+
+void async_timer_cancel(AsyncTimer* timer)
+{
+    if (timer == NULL)
+        return;
+    heap_remove(timer);
+    free(timer);
+}
+
+static void fire_timers(void)
+{
+    double now = now_ms();
+    while (timer_count > 0 && timers[0]->due <= now)
+    {
+        AsyncTimer* timer = timers[0];
+        heap_remove(timer);
+        timer->cb(timer->ctx);
+        free(timer);
+    }
+}
+
+/* ---- Watches ---- */
+
+static int loop_epoll(void)
+{
+    if (epoll_fd < 0)
+        epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    return epoll_fd;
+}
+
+bool async_watch(int fd, int events, AsyncIoCallback cb, void* ctx)
+{
+    if (fd < 0)
+        return false;
+    if (fd >= watch_capacity)
+    {
+        int capacity = watch_capacity < 64 ? 64 : watch_capacity;
+        while (capacity <= fd)
+            capacity *= 2;
+        watches = realloc(watches, sizeof(Watch) * capacity);
+        memset(watches + watch_capacity, 0, sizeof(Watch) * (capacity - watch_capacity));
+        watch_capacity = capacity;
+    }
+
+    Watch* watch = &watches[fd];
+    struct epoll_event ev = {0};
+    ev.events = ((events & ASYNC_READ) ? EPOLLIN : 0) | ((events & ASYNC_WRITE) ? EPOLLOUT : 0);
+    ev.data.fd = fd;
+
+    if (events == 0)
+    {
+        if (watch->events)
+        {
+            epoll_ctl(loop_epoll(), EPOLL_CTL_DEL, fd, &ev);
+            watch_count--;
+        }
+        *watch = (Watch){NULL, NULL, 0};
+        return true;
+    }
+
+    /* The table can be out of date when fd was closed and reused while
+       watched, since closing removes it from the epoll set. */
+    int op = watch->events ? EPOLL_CTL_MOD : EPOLL_CTL_ADD;
+    if (epoll_ctl(loop_epoll(), op, fd, &ev) < 0)
+    {
+        if (errno == EEXIST)
+            op = EPOLL_CTL_MOD;
+        else if (errno == ENOENT)
+            op = EPOLL_CTL_ADD;
+        else
+            return false;
+        if (epoll_ctl(loop_epoll(), op, fd, &ev) < 0)
+            return false;
+    }
+
+    if (!watch->events)
+        watch_count++;
+    *watch = (Watch){cb, ctx, events};
+    return true;
+}
+
+static void poll_watches(int timeout_ms)
+{
+    struct epoll_event events[MAX_EVENTS];
+    int n = epoll_wait(loop_epoll(), events, MAX_EVENTS, timeout_ms);
+    for (int i = 0; i < n; i++)
+    {
+        int fd = events[i].data.fd;
+        uint32_t ev = events[i].events;
+        int ready = ((ev & (EPOLLIN | EPOLLHUP | EPOLLERR)) ? ASYNC_READ : 0) |
+                    ((ev & (EPOLLOUT | EPOLLHUP | EPOLLERR)) ? ASYNC_WRITE : 0);
+
+        /* An earlier callback in this batch may have removed the watch. */
+        if (fd < watch_capacity && watches[fd].cb && (watches[fd].events & ready))
+            watches[fd].cb(watches[fd].ctx, fd, watches[fd].events & ready);
+    }
+}
+
+/* ---- Fibers ---- */
+
+static void wake(Fiber* fiber)
+{
+    if (fiber == &main_fiber)
+    {
+        main_fiber.woken = true;
+        return;
+    }
+    if (fiber->queued)
+        return;
+    fiber->queued = true;
+    fiber->next_ready = NULL;
+    if (ready_tail)
+        ready_tail->next_ready = fiber;
+    else
+        ready_head = fiber;
+    ready_tail = fiber;
+}
+
+/** Address just below the caller's frame, so the saved registers of the caller are above it. */
+static __attribute__((noinline)) char* stack_pointer(void)
+{
+    return __builtin_frame_address(0);
+}
+
+/**
+ * Moves the thread from the current fiber to another one, swapping the
+ * evaluator's per-thread state along with the C stack.
+ */
+static void switch_to(Fiber* to)
+{
+    Fiber* from = current;
+    from->ex_state = global_ex_state;
+    from->executing_func = current_executing_func;
+    from->arena = frame_arena_swap(to->arena);
+    from->stack_top = gc_swap_stack_end(to->stack_top);
+    from->sp = stack_pointer();
+
+    global_ex_state = to->ex_state;
+    current_executing_func = to->executing_func;
+    current = to;
+
+#ifdef ASYNC_ASAN
+    __sanitizer_start_switch_fiber(from->finished ? NULL : &from->asan_fake_stack, to->asan_bottom, to->asan_size);
+#endif
+    swapcontext(&from->context, &to->context);
+#ifdef ASYNC_ASAN
+    __sanitizer_finish_switch_fiber(from->asan_fake_stack, NULL, NULL);
+#endif
+}
+
+/**
+ * Gives control to the loop until wake() is called for the current fiber.
+ * The main program runs the loop itself, and stops early if it runs dry.
+ */
+static void suspend(void)
+{
+    if (current != &main_fiber)
+    {
+        switch_to(&main_fiber);
+        return;
+    }
+    while (!main_fiber.woken && loop_has_work())
+        loop_once();
+}
+
+static void fiber_main(void)
+{
+    Fiber* fiber = current;
+#ifdef ASYNC_ASAN
+    __sanitizer_finish_switch_fiber(NULL, &main_fiber.asan_bottom, &main_fiber.asan_size);
+#endif
+
+    /* A throw that nothing in the fiber catches rejects its promise. */
+    global_ex_state.active = 1;
+    if (setjmp(global_ex_state.buf) == 0)
+    {
+        Func* func = AS_FUNCTION(fiber->func);
+        current_executing_func = func;
+        promise_resolve(fiber->promise, call_function(func->env, func, fiber->arg_count, fiber->args));
+    }
+    else
+    {
+        promise_reject(fiber->promise, global_ex_state.error_val);
+    }
+
+    fiber->finished = true;
+    switch_to(&main_fiber);
+}
+
+static char* stack_alloc(void)
+{
+    if (stack_pool_count > 0)
+        return stack_pool[--stack_pool_count];
+
+    char* stack = mmap(NULL, FIBER_GUARD_SIZE + FIBER_STACK_SIZE, PROT_READ | PROT_WRITE,
+                       MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE | MAP_STACK, -1, 0);
+    if (stack == MAP_FAILED)
+        return NULL;
+    mprotect(stack, FIBER_GUARD_SIZE, PROT_NONE);
+    return stack;
+}
+
+static void stack_release(char* stack)
+{
+    if (stack_pool_count < FIBER_STACK_POOL)
+        stack_pool[stack_pool_count++] = stack;
+    else
+        munmap(stack, FIBER_GUARD_SIZE + FIBER_STACK_SIZE);
+}
+
+static Fiber* fiber_new(void)
+{
+    char* stack = stack_alloc();
+    if (stack == NULL)
+        return NULL;
+
+    Fiber* fiber = calloc(1, sizeof(Fiber));
+    fiber->stack = stack;
+    fiber->stack_top = stack + FIBER_GUARD_SIZE + FIBER_STACK_SIZE;
+    fiber->asan_bottom = stack + FIBER_GUARD_SIZE;
+    fiber->asan_size = FIBER_STACK_SIZE;
+    fiber->arena = frame_arena_new();
+    fiber->wait_fd = -1;
+
+    getcontext(&fiber->context);
+    fiber->context.uc_stack.ss_sp = stack + FIBER_GUARD_SIZE;
+    fiber->context.uc_stack.ss_size = FIBER_STACK_SIZE;
+    fiber->context.uc_link = NULL;
+    makecontext(&fiber->context, fiber_main, 0);
+
+    fiber->next = fibers;
+    if (fibers)
+        fibers->prev = fiber;
+    fibers = fiber;
+    return fiber;
+}
+
+static void fiber_free(Fiber* fiber)
+{
+    if (fiber->prev)
+        fiber->prev->next = fiber->next;
+    else
+        fibers = fiber->next;
+    if (fiber->next)
+        fiber->next->prev = fiber->prev;
+
+    stack_release(fiber->stack);
+    frame_arena_free(fiber->arena);
+    free(fiber->args);
+    free(fiber);
+}
+
+/** Runs the fibers that are ready now; ones woken meanwhile wait for the next round. */
+static void run_ready(void)
+{
+    Fiber* batch = ready_head;
+    ready_head = ready_tail = NULL;
+    while (batch)
+    {
+        Fiber* fiber = batch;
+        batch = fiber->next_ready;
+        fiber->queued = false;
+
+        switch_to(fiber);
+        if (fiber->finished)
+            fiber_free(fiber);
+    }
+}
+
+static void loop_once(void)
+{
+    run_ready();
+
+    int timeout = -1;
+    if (ready_head || main_fiber.woken)
+        timeout = 0;
+    else if (timer_count > 0)
+    {
+        double wait = timers[0]->due - now_ms();
+        timeout = wait <= 0 ? 0 : (int)ceil(wait);
+    }
+
+    if (watch_count > 0 || timeout > 0)
+        poll_watches(timeout);
+    fire_timers();
+}
+
+/* ---- Marking ---- */
+
+static void mark_fiber(Fiber* fiber)
+{
+    gc_mark_value(fiber->func);
+    for (int i = 0; i < fiber->arg_count; i++)
+        gc_mark_value(fiber->args[i]);
+    if (fiber->promise)
+        gc_mark_value(PROMISE_VAL(fiber->promise));
+
+    /* The running fiber's stack is scanned by the collector itself, and a
+       fiber that has not started yet has nothing on its stack. */
+    if (fiber == current || fiber->sp == NULL)
+        return;
+    gc_mark_range(fiber->sp, fiber->stack_top);
+    gc_mark_range(&fiber->context, (char*)&fiber->context + sizeof(ucontext_t));
+    gc_mark_range(&fiber->ex_state.buf, (char*)&fiber->ex_state.buf + sizeof(jmp_buf));
+    gc_mark_value(fiber->ex_state.error_val);
+    frame_arena_mark(fiber->arena);
+}
+
+static void mark_loop(void* ctx)
+{
+    (void)ctx;
+    for (Fiber* fiber = fibers; fiber; fiber = fiber->next)
+        mark_fiber(fiber);
+    mark_fiber(&main_fiber);
+    for (int i = 0; i < timer_count; i++)
+        gc_mark_value(timers[i]->keep);
+}
+
+/* ---- Promises ---- */
+
+Promise* promise_new(void)
+{
+    return gc_allocate(sizeof(Promise), GC_PROMISE);
+}
+
+static void settle(Promise* promise, PromiseState state, Value value)
+{
+    if (promise->state != PROMISE_PENDING)
+        return;
+    promise->state = state;
+    promise->value = value;
+
+    /* Waiters were pushed in front; wake them in the order they arrived. */
+    Fiber* reversed = NULL;
+    while (promise->waiters)
+    {
+        Fiber* fiber = promise->waiters;
+        promise->waiters = fiber->next_waiter;
+        fiber->next_waiter = reversed;
+        reversed = fiber;
+    }
+    for (Fiber* fiber = reversed; fiber; fiber = fiber->next_waiter)
+        wake(fiber);
+}
+
+void promise_resolve(Promise* promise, Value value)
+{
+    settle(promise, PROMISE_FULFILLED, value);
+}
+
+void promise_reject(Promise* promise, Value error)
+{
+    settle(promise, PROMISE_REJECTED, error);
+}
+
+/* ---- Public API ---- */
+
+bool async_loop_thread(void)
+{
+    return is_loop_thread;
+}
+
+Value async_spawn(Value func, int arg_count, Value* args)
+{
+    Promise* promise = promise_new();
+    Value result = PROMISE_VAL(promise);
+
+    Fiber* fiber = is_loop_thread ? fiber_new() : NULL;
+    if (fiber == NULL)
+    {
+        /* No loop on this thread (or no memory for a stack): run the call
+           to completion here, as a plain call would. */
+        Func* fn = AS_FUNCTION(func);
+        promise_resolve(promise, call_function(fn->env, fn, arg_count, args));
+        return result;
+    }
+
+    fiber->promise = promise;
+    fiber->func = copy_value(func);
+    fiber->args = arg_count > 0 ? calloc(arg_count, sizeof(Value)) : NULL;
+    fiber->arg_count = arg_count;
+    for (int i = 0; i < arg_count; i++)
+        fiber->args[i] = copy_value(args[i]);
+    wake(fiber);
+    return result;
+}
+
+static void fiber_timeout(void* ctx)
+{
+    Fiber* fiber = ctx;
+    fiber->timer = NULL;
+    if (fiber->wait_fd >= 0)
+        async_watch(fiber->wait_fd, 0, NULL, NULL);
+    wake(fiber);
+}
+
+static void fiber_io_ready(void* ctx, int fd, int events)
+{
+    Fiber* fiber = ctx;
+    fiber->io_ready = true;
+    async_watch(fd, 0, NULL, NULL);
+    async_timer_cancel(fiber->timer);
+    fiber->timer = NULL;
+    wake(fiber);
+}
+
+void async_sleep_ms(double ms)
+{
+    if (!is_loop_thread || (current == &main_fiber && !loop_has_work()))
+    {
+        if (ms > 0)
+        {
+            gc_blocking_begin();
+            usleep((useconds_t)(ms * 1000));
+            gc_blocking_end();
+        }
+        return;
+    }
+
+    current->woken = false;
+    current->timer = async_timer_start(ms, fiber_timeout, current);
+    suspend();
+}
+
+bool async_wait_fd(int fd, int events, int timeout_ms)
+{
+    if (!is_loop_thread || (current == &main_fiber && !loop_has_work()))
+    {
+        struct pollfd pfd = {fd, (short)(((events & ASYNC_READ) ? POLLIN : 0) | ((events & ASYNC_WRITE) ? POLLOUT : 0)), 0};
+        int n;
+        gc_blocking_begin();
+        do
+            n = poll(&pfd, 1, timeout_ms < 0 ? -1 : timeout_ms);
+        while (n < 0 && errno == EINTR);
+        gc_blocking_end();
+        return n != 0;
+    }
+
+    Fiber* fiber = current;
+    if (!async_watch(fd, events, fiber_io_ready, fiber))
+        return true;
+
+    fiber->woken = false;
+    fiber->io_ready = false;
+    fiber->wait_fd = fd;
+    fiber->timer = timeout_ms >= 0 ? async_timer_start(timeout_ms, fiber_timeout, fiber) : NULL;
+    suspend();
+    fiber->wait_fd = -1;
+    return fiber->io_ready;
+}
+
+Value async_await(Value value)
+{
+    if (IS_TASK(value))
+    {
+        /* Poll while other fibers can make progress meanwhile; otherwise
+           join, which also helps run queued tasks. */
+        Task* task = AS_TASK(value);
+        while (is_loop_thread && (current != &main_fiber || loop_has_work()) &&
+               atomic_load(&task->state) != TASK_DONE)
+            async_sleep_ms(1);
+        return task_join(task);
+    }
+
+    if (!IS_PROMISE(value))
+        return value;
+
+    Promise* promise = AS_PROMISE(value);
+    if (promise->state == PROMISE_PENDING)
+    {
+        if (!is_loop_thread)
+        {
+            print_error("await on a pending promise is only possible on the main thread.");
+            return NIL_VAL;
+        }
+
+        Fiber* fiber = current;
+        fiber->woken = false;
+        fiber->next_waiter = promise->waiters;
+        promise->waiters = fiber;
+        suspend();
+
+        if (promise->state == PROMISE_PENDING)
+        {
+            /* Only the main program gets here: the loop ran dry. */
+            for (Fiber** link = &promise->waiters; *link; link = &(*link)->next_waiter)
+            {
+                if (*link == fiber)
+                {
+                    *link = fiber->next_waiter;
+                    break;
+                }
+            }
+            print_error("await on a promise that can never settle.");
+            return NIL_VAL;
+        }
+    }
+
+    if (promise->state == PROMISE_REJECTED)
+        throw_value(copy_value(promise->value));
+    return copy_value(promise->value);
+}
+
+void async_run(void)
+{
+    if (!is_loop_thread)
+        return;
+    while (loop_has_work())
+        loop_once();
+}
+
+/* ---- Natives ---- */
+
+static void sleep_done(void* ctx)
+{
+    promise_resolve(ctx, NIL_VAL);
+}
+
+/**
+ * __async_sleep(ms): a promise settled after ms milliseconds, without
+ * blocking anything meanwhile.
+ */
+static Value native_async_sleep(int arg_count, Value* args)
+{
+    double ms = arg_count > 0 && IS_NUMBER(args[0]) ? AS_NUMBER(args[0]) : 0;
+    Promise* promise = promise_new();
+    Value result = PROMISE_VAL(promise);
+
+    if (!is_loop_thread)
+    {
+        async_sleep_ms(ms);
+        promise_resolve(promise, NIL_VAL);
+        return result;
+    }
+
+    AsyncTimer* timer = async_timer_start(ms, sleep_done, promise);
+    timer->keep = result;
+    return result;
+}
+
+static Value promise_method_is_done(Env* env, Value receiver, int arg_count, Value* args)
+{
+    return BOOL_VAL(AS_PROMISE(receiver)->state != PROMISE_PENDING);
+}
+
+void register_async_natives(struct Env* env)
+{
+    if (!is_loop_thread)
+    {
+        is_loop_thread = true;
+        gc_add_root_marker(mark_loop, NULL);
+    }
+
+    set_var(env, "__async_sleep", NATIVE_VAL(native_async_sleep), true, "");
+    register_method(VAL_PROMISE, "isDone", promise_method_is_done);
+}
@@ -1,9 +1,10 @@
 #include "collections/linkedlist.h"
 #include "value.h" 
+#include "gc.h"
 #include <stdlib.h>
 
 LinkedList* linkedlist_new(void) {
-    LinkedList* list = malloc(sizeof(LinkedList));
+    LinkedList* list = gc_allocate(sizeof(LinkedList), GC_LIST);
     list->head = NULL;
     list->tail = NULL;
     list->count = 0;
@@ -18,7 +19,7 @@ void linkedlist_free(LinkedList* list) {
         free(current);
         current = next;
     }
-    free(list);
+    gc_free(list);
 }
 
 void linkedlist_append(LinkedList* list, Value val) {
@@ -49,7 +50,7 @@ void linkedlist_prepend(LinkedList* list, Value val) {
 }
 
 Value linkedlist_remove_first(LinkedList* list) {
-    if (list->head == NULL) return (Value){VAL_NIL, {0}};
+    if (list->head == NULL) return NIL_VAL;
 
     LLNode* old_head = list->head;
     Value val = old_head->value; 
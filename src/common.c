@@ -5,33 +5,6 @@
 
 size_t bytesAllocated = 0;
 
-GCObject* gc_head = NULL;
-
-void* jackal_allocate_gc(size_t size) {
-    GCObject* obj = malloc(sizeof(GCObject) + size);
-    if (obj == NULL) return NULL;
-    
-    obj->is_marked = false;
-    obj->next = gc_head;
-    gc_head = obj;
-
-    return (void*)(obj + 1);
-}
-
-void gc_sweep() {
-    GCObject** current = &gc_head;
-    while (*current) {
-        if (!(*current)->is_marked) {
-            GCObject* unreached = *current;
-            *current = unreached->next;
-            
-            free(unreached);
-        } else {
-            (*current)->is_marked = false;
-            current = &(*current)->next;
-        }
-    }
-}
 /**
  * src/common.c
  * @param message Error message to be printed.
@@ -65,4 +38,14 @@ void jackal_free(void* ptr, size_t size) {
     if (ptr == NULL) return;
     free(ptr);
     bytesAllocated -= size; 
-}
\ No newline at end of file
+}
+#ifdef JACKAL_CHECKED_VALUES
+/**
+ * Reports an AS_* accessor applied to a Value of another type and aborts,
+ * so the failing call site is the top of the backtrace.
+ */
+void value_type_mismatch(ValueType expected, ValueType actual, const char* file, int line) {
+    fprintf(stderr, "Fatal Error: %s:%d: expected value type %d, got %d\n", file, line, expected, actual);
+    abort();
+}
+#endif
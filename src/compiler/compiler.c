@@ -1,206 +1,1030 @@
 #include "compiler/compiler.h"
+#include "compiler/jlo.h"
 #include "vm/opcode.h"
 #include "common.h"
 #include "value.h"
+#include "string_object.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <stdint.h>
 
+/**
+ * @typedef @struct LOOP
+ * Jump bookkeeping for the innermost loop being compiled.
+ * break and continue first pop every scope opened inside the loop body.
+ */
+typedef struct Loop {
+    struct Loop* enclosing;
+    int scope_depth;
+    int* breaks;
+    int break_count;
+    int break_capacity;
+    int* continues;
+    int continue_count;
+    int continue_capacity;
+} Loop;
 
-static void emit_byte(Chunk* chunk, uint8_t byte) {
-    writeChunk(chunk, byte);
+#define SLOT_MAX 256
+
+/**
+ * @typedef @struct LOCAL
+ * A variable kept in a stack slot; its index in Compiler.locals is the slot.
+ */
+typedef struct {
+    const char* name;
+    int depth;
+    bool is_const;
+} Local;
+
+/**
+ * @typedef @struct COMPILER
+ * State for compiling one function body or top-level statement.
+ * scope_depth counts the scopes opened since the chunk started; they are
+ * runtime Env scopes unless use_slots is set.
+ */
+typedef struct {
+    Chunk* chunk;
+    Loop* loop;
+    int scope_depth;
+    int line;
+    bool had_error;
+
+    bool use_slots;         // locals go in stack slots (see Chunk)
+    bool slots_failed;      // the body needs Env scopes after all
+    bool top_level;         // compiling a script: outermost declarations are globals
+    Node* block_stmt;       // statement of the innermost block being compiled
+    Local locals[SLOT_MAX];
+    int local_count;
+} Compiler;
+
+static void compile_stmt(Compiler* c, Node* n, bool keep);
+static void compile_expr(Compiler* c, Node* n);
+static bool is_compiled(Compiler* c, Node* n);
+
+static void emit_byte(Compiler* c, uint8_t byte) {
+    writeChunk(c->chunk, byte, c->line);
+}
+
+static void emit_bytes(Compiler* c, uint8_t byte1, uint8_t byte2) {
+    emit_byte(c, byte1);
+    emit_byte(c, byte2);
+}
+
+static void emit_short(Compiler* c, int value) {
+    if (value > UINT16_MAX) {
+        fprintf(stderr, "Error: Too many constants or nodes in one chunk (> 65535)!\n");
+        c->had_error = true;
+    }
+    emit_bytes(c, (uint8_t)((value >> 8) & 0xff), (uint8_t)(value & 0xff));
+}
+
+static void emit_constant_operand(Compiler* c, OpCode op, Value value) {
+    emit_byte(c, op);
+    emit_short(c, addConstant(c->chunk, value));
+}
+
+static void emit_name_operand(Compiler* c, OpCode op, const char* name) {
+    emit_constant_operand(c, op, string_value(string_intern_pinned(name)));
+}
+
+static void emit_node_operand(Compiler* c, OpCode op, Node* n) {
+    emit_byte(c, op);
+    emit_short(c, addNode(c->chunk, n));
+}
+
+static int emit_jump(Compiler* c, OpCode op) {
+    emit_byte(c, op);
+    emit_byte(c, 0xff);
+    emit_byte(c, 0xff);
+    return c->chunk->count - 2;
+}
+
+static void patch_jump(Compiler* c, int offset) {
+    int jump = c->chunk->count - offset - 2;
+    if (jump > UINT16_MAX) {
+        fprintf(stderr, "Error: Too much code to jump over!\n");
+        c->had_error = true;
+    }
+
+    c->chunk->code[offset] = (uint8_t)((jump >> 8) & 0xff);
+    c->chunk->code[offset + 1] = (uint8_t)(jump & 0xff);
+}
+
+static void emit_loop(Compiler* c, int loop_start) {
+    emit_byte(c, OP_LOOP);
+    int offset = c->chunk->count - loop_start + 2;
+    if (offset > UINT16_MAX) {
+        fprintf(stderr, "Error: Loop body too large!\n");
+        c->had_error = true;
+    }
+    emit_short(c, offset);
+}
+
+/**
+ * Opens a scope for a block or loop.
+ * @param scope The node whose scope this is, which decides whether an Env
+ * scope can live in the frame arena.
+ */
+static void push_scope(Compiler* c, Node* scope) {
+    if (!c->use_slots) emit_node_operand(c, OP_PUSH_SCOPE, scope);
+    c->scope_depth++;
+}
+
+static void pop_scope(Compiler* c) {
+    if (!c->use_slots) emit_byte(c, OP_POP_SCOPE);
+    c->scope_depth--;
+    while (c->local_count > 0 && c->locals[c->local_count - 1].depth > c->scope_depth) {
+        c->local_count--;
+    }
+}
+
+/**
+ * Gives up on stack slots for the function being compiled; compile_function
+ * then compiles it again with Env scopes.
+ */
+static void need_env(Compiler* c) {
+    c->slots_failed = true;
+}
+
+static int resolve_local(Compiler* c, const char* name) {
+    for (int i = c->local_count - 1; i >= 0; i--) {
+        if (strcmp(c->locals[i].name, name) == 0) return i;
+    }
+    return -1;
+}
+
+/**
+ * Declares a local in the innermost scope and returns its slot.
+ * Redeclaring a name in the same scope reuses its slot, as define_var does.
+ */
+static int declare_local(Compiler* c, const char* name, bool is_const) {
+    for (int i = c->local_count - 1; i >= 0 && c->locals[i].depth == c->scope_depth; i--) {
+        if (strcmp(c->locals[i].name, name) == 0) {
+            c->locals[i].is_const = is_const;
+            return i;
+        }
+    }
+
+    if (c->local_count == SLOT_MAX) {
+        need_env(c);
+        return 0;
+    }
+    c->locals[c->local_count] = (Local){name, c->scope_depth, is_const};
+    if (c->local_count >= c->chunk->slot_count) c->chunk->slot_count = c->local_count + 1;
+    return c->local_count++;
+}
+
+/**
+ * Whether declarations go to the global Env: the outermost scope of a
+ * script, which has no slots.
+ */
+static bool declares_global(Compiler* c) {
+    return c->top_level && c->scope_depth == 0;
+}
+
+/**
+ * Emits OP_GET_OUTER or OP_SET_OUTER for a variable declared outside the
+ * function, or for a global in a script. The resolver counted the scopes
+ * open here as well, and for a function the call scope holding the
+ * parameters, which a slot frame does not have at runtime.
+ */
+static void emit_outer(Compiler* c, OpCode op, Node* n) {
+    int depth = OUTER_BY_NAME;
+    if (n->resolve_kind != RESOLVE_NONE) {
+        depth = n->scope_depth - c->scope_depth - (c->top_level ? 0 : 1);
+        if (depth < 0 || depth >= OUTER_BY_NAME) {
+            need_env(c);
+            depth = 0;
+        }
+    }
+    emit_node_operand(c, op, n);
+    emit_byte(c, (uint8_t)depth);
+}
+
+static void add_jump(int** jumps, int* count, int* capacity, int offset) {
+    if (*count == *capacity) {
+        *capacity = *capacity < 4 ? 4 : *capacity * 2;
+        *jumps = realloc(*jumps, sizeof(int) * *capacity);
+    }
+    (*jumps)[(*count)++] = offset;
+}
+
+static void begin_loop(Compiler* c, Loop* loop) {
+    memset(loop, 0, sizeof(Loop));
+    loop->enclosing = c->loop;
+    loop->scope_depth = c->scope_depth;
+    c->loop = loop;
+}
+
+static void patch_jumps(Compiler* c, int* jumps, int count) {
+    for (int i = 0; i < count; i++) {
+        patch_jump(c, jumps[i]);
+    }
+}
+
+static void end_loop(Compiler* c, Loop* loop) {
+    free(loop->breaks);
+    free(loop->continues);
+    c->loop = loop->enclosing;
 }
 
-static void emit_bytes(Chunk* chunk, uint8_t byte1, uint8_t byte2) {
-    emit_byte(chunk, byte1);
-    emit_byte(chunk, byte2);
+/**
+ * Emits a break or continue: closes the scopes opened inside the loop body,
+ * then jumps to a target that is patched once the loop is compiled.
+ */
+static void emit_loop_exit(Compiler* c, bool is_break) {
+    Loop* loop = c->loop;
+    for (int depth = c->scope_depth; depth > loop->scope_depth && !c->use_slots; depth--) {
+        emit_byte(c, OP_POP_SCOPE);
+    }
+
+    int jump = emit_jump(c, OP_JUMP);
+    if (is_break) {
+        add_jump(&loop->breaks, &loop->break_count, &loop->break_capacity, jump);
+    } else {
+        add_jump(&loop->continues, &loop->continue_count, &loop->continue_capacity, jump);
+    }
 }
 
-static void emit_constant_operand(Chunk* chunk, OpCode op, Value value) {
-    int constant_index = addConstant(chunk, value);
-    if (constant_index > 255) {
-        fprintf(stderr, "Error: Too many constants in one chunk (> 256)!\n");
+static bool list_has_loop_jump(Node* n);
+
+/**
+ * Whether a statement contains a break or continue for an enclosing loop.
+ * Nested loops and functions own the jumps inside them.
+ */
+static bool node_has_loop_jump(Node* n) {
+    if (!n) return false;
+
+    switch (n->kind) {
+        case NODE_BREAK_STMT:
+        case NODE_CONTINUE_STMT:
+            return true;
+        case NODE_WHILE_STMT:
+        case NODE_FOR_STMT:
+        case NODE_FOR_EACH:
+        case NODE_FOR_IN:
+        case NODE_EVERY_LOOP:
+        case NODE_FUNC_DEF:
+        case NODE_FUNC_EXPR:
+        case NODE_CLASS_DEF:
+        case NODE_EXTENSION:
+            return false;
+        default:
+            return list_has_loop_jump(n->left) || list_has_loop_jump(n->right) ||
+                   list_has_loop_jump(n->super_template_types);
+    }
+}
+
+static bool list_has_loop_jump(Node* n) {
+    for (; n; n = n->next) {
+        if (node_has_loop_jump(n)) return true;
+    }
+    return false;
+}
+
+/**
+ * Whether a loop body hands a break or continue to the evaluator.
+ * eval_node reports those as VAL_BREAK / VAL_CONTINUE results that only a
+ * loop run by eval_node understands, so such loops are delegated whole.
+ */
+static bool delegates_loop_jump(Compiler* c, Node* n) {
+    if (!n) return false;
+
+    switch (n->kind) {
+        case NODE_BLOCK:
+            for (Node* stmt = n->left; stmt; stmt = stmt->next) {
+                if (delegates_loop_jump(c, stmt)) return true;
+            }
+            return false;
+        case NODE_IF_STMT:
+            return delegates_loop_jump(c, n->right->left) || delegates_loop_jump(c, n->right->right);
+        case NODE_BREAK_STMT:
+        case NODE_CONTINUE_STMT:
+            return false;
+        default:
+            return !is_compiled(c, n) && node_has_loop_jump(n);
+    }
+}
+
+/**
+ * Maps a binary operator token to its opcode.
+ * @return The opcode, or -1 for operators only eval_node implements.
+ */
+static int binary_opcode(TokenKind op) {
+    switch (op) {
+        case TOKEN_PLUS: return OP_ADD;
+        case TOKEN_MINUS: return OP_SUB;
+        case TOKEN_STAR: return OP_MUL;
+        case TOKEN_SLASH: return OP_DIV;
+        case TOKEN_PERCENT: return OP_MOD;
+        case TOKEN_EQUAL_EQUAL: return OP_EQUAL;
+        case TOKEN_BANG_EQUAL: return OP_NOT_EQUAL;
+        case TOKEN_GREATER: return OP_GREATER;
+        case TOKEN_GREATER_EQUAL: return OP_GREATER_EQUAL;
+        case TOKEN_LESS: return OP_LESS;
+        case TOKEN_LESS_EQUAL: return OP_LESS_EQUAL;
+        default: return -1;
+    }
+}
+
+static bool is_compiled_class(Node* n) {
+    if (n->is_record || n->is_singleton) return false;
+
+    for (Node* member = n->left; member; member = member->next) {
+        if (member->kind != NODE_FUNC_DEF || member->is_main) return false;
+    }
+    return true;
+}
+
+/**
+ * Whether the compiler has bytecode for a node.
+ * Everything else runs through OP_EVAL.
+ */
+static bool is_compiled(Compiler* c, Node* n) {
+    switch (n->kind) {
+        case NODE_NUMBER:
+        case NODE_STRING:
+        case NODE_BOOL:
+        case NODE_IDENT:
+        case NODE_THIS:
+        case NODE_ASSIGN:
+        case NODE_CONSTDECL:
+        case NODE_FUNC_EXPR:
+        case NODE_FUNC_DEF:
+        case NODE_RETURN_STMT:
+        case NODE_ARRAY_LITERAL:
+        case NODE_MAP_LITERAL:
+        case NODE_ARRAY_ACCESS:
+        case NODE_ARRAY_ASSIGN:
+        case NODE_GET:
+        case NODE_SET:
+        case NODE_RANGE_EXPR:
+        case NODE_BLOCK:
+        case NODE_IF_STMT:
+            return true;
+
+        case NODE_UNARY:
+            return n->op == TOKEN_MINUS || n->op == TOKEN_BANG;
+
+        case NODE_BINOP:
+            return n->op == TOKEN_PIPE_PIPE || n->op == TOKEN_OR || n->op == TOKEN_AND_AND ||
+                   n->op == TOKEN_AS || binary_opcode(n->op) != -1;
+
+        case NODE_POST_INC:
+        case NODE_POST_DEC:
+            return n->left && n->left->kind == NODE_IDENT;
+
+        case NODE_VARDECL:
+            return !(n->left && n->left->kind == NODE_DESTRUCTURE) && !n->is_static && n->template_types == NULL;
+
+        case NODE_FUNC_CALL:
+            return !(n->left->kind == NODE_IDENT && strcmp(n->left->name, "read") == 0);
+
+        case NODE_WHILE_STMT:
+            return !delegates_loop_jump(c, n->right);
+        case NODE_FOR_STMT:
+            return !delegates_loop_jump(c, n->right->right->right);
+        case NODE_FOR_EACH:
+            return !delegates_loop_jump(c, n->super_template_types);
+
+        case NODE_BREAK_STMT:
+        case NODE_CONTINUE_STMT:
+            return c->loop != NULL;
+
+        case NODE_CLASS_DEF:
+            return is_compiled_class(n);
+
+        default:
+            return false;
+    }
+}
+
+/**
+ * Whether a node can only run with its variables in Env scopes: closures
+ * capture the scope and the evaluator looks names up in it.
+ */
+static bool needs_env(Compiler* c, Node* n) {
+    switch (n->kind) {
+        case NODE_FUNC_EXPR:
+        case NODE_FUNC_DEF:
+        case NODE_CLASS_DEF:
+            return true;
+        default:
+            return !is_compiled(c, n);
+    }
+}
+
+/**
+ * Compiles a function body into a new chunk.
+ * @param use_slots Whether to keep parameters and locals in stack slots.
+ * @return The chunk, or NULL if use_slots was asked for and the body needs
+ * Env scopes.
+ */
+static Chunk* compile_body(Compiler* enclosing, Node* decl, bool is_method, bool use_slots) {
+    Compiler c;
+    memset(&c, 0, sizeof(Compiler));
+    c.chunk = newChunk();
+    c.line = decl->line;
+    c.use_slots = use_slots;
+
+    if (use_slots) {
+        declare_local(&c, is_method ? "this" : "", true);
+        for (Node* param = decl->left; param; param = param->next) {
+            /* Typed parameters are checked by bind_call_args; repeated
+               names bind differently. */
+            if (param->type_name[0] != '\0' || declare_local(&c, param->name, false) != c.local_count - 1) {
+                need_env(&c);
+            }
+        }
+        c.chunk->arity = c.local_count - 1;
+        c.chunk->has_receiver = is_method;
+    }
+
+    Node* body = decl->right;
+    if (body && body->kind == NODE_BLOCK) {
+        push_scope(&c, body);
+        Node* stmt = body->left;
+        if (!stmt) emit_byte(&c, OP_NIL);
+        while (stmt) {
+            c.block_stmt = stmt;
+            compile_stmt(&c, stmt, stmt->next == NULL);
+            stmt = stmt->next;
+        }
+        pop_scope(&c);
+    } else {
+        compile_stmt(&c, body, true);
+    }
+    emit_byte(&c, OP_RETURN_END);
+
+    if (c.slots_failed) {
+        freeChunk(c.chunk);
+        free(c.chunk);
+        return NULL;
+    }
+    if (c.had_error) enclosing->had_error = true;
+    return c.chunk;
+}
+
+/**
+ * Compiles a function body into its own chunk and registers it on the
+ * enclosing chunk. Bodies that create no closures and delegate nothing to
+ * the evaluator keep their locals in stack slots; the rest, and init
+ * methods (run with typed parameters by bind_init_args), use Env scopes.
+ * @return Index of the prototype.
+ */
+static int compile_function(Compiler* enclosing, Node* decl, bool is_method) {
+    Chunk* body = NULL;
+    if (!(is_method && strcmp(decl->name, "init") == 0)) {
+        body = compile_body(enclosing, decl, is_method, true);
+    }
+    if (body == NULL) {
+        body = compile_body(enclosing, decl, is_method, false);
+    }
+    return addProto(enclosing->chunk, decl, body);
+}
+
+static void compile_get(Compiler* c, Node* n) {
+    if (!c->use_slots) {
+        emit_node_operand(c, OP_GET_VAR, n);
+        return;
+    }
+
+    int slot = resolve_local(c, n->name);
+    if (slot >= 0) {
+        emit_bytes(c, OP_GET_LOCAL, (uint8_t)slot);
+    } else {
+        emit_outer(c, OP_GET_OUTER, n);
+    }
+}
+
+static void compile_assign(Compiler* c, Node* n) {
+    compile_expr(c, n->right);
+    if (!c->use_slots) {
+        emit_node_operand(c, OP_SET_VAR, n);
         return;
     }
-    emit_bytes(chunk, op, (uint8_t)constant_index);
+
+    int slot = resolve_local(c, n->name);
+    if (slot < 0) {
+        emit_outer(c, OP_SET_OUTER, n);
+        return;
+    }
+    /* assign_ident reports writes to constants. */
+    if (c->locals[slot].is_const) need_env(c);
+    emit_bytes(c, OP_SET_LOCAL, (uint8_t)slot);
+}
+
+static void compile_post_inc(Compiler* c, Node* n, bool is_inc) {
+    if (!c->use_slots) {
+        emit_node_operand(c, is_inc ? OP_POST_INC : OP_POST_DEC, n->left);
+        return;
+    }
+
+    int slot = resolve_local(c, n->left->name);
+    if (slot < 0 && c->top_level) {
+        /* A global: looked up from the script's Env by name. */
+        emit_node_operand(c, is_inc ? OP_POST_INC : OP_POST_DEC, n->left);
+        return;
+    }
+    if (slot < 0) need_env(c);
+    emit_bytes(c, is_inc ? OP_POST_INC_LOCAL : OP_POST_DEC_LOCAL, (uint8_t)(slot < 0 ? 0 : slot));
+}
+
+/**
+ * Declares the variable of a plain declaration whose value is on the stack.
+ */
+static void compile_declare(Compiler* c, Node* n) {
+    if (!c->use_slots || declares_global(c)) {
+        emit_node_operand(c, OP_DEF_VAR, n);
+        return;
+    }
+
+    /* A declaration that is not a statement of its own block (say the body
+       of an if without braces) only exists once it runs, and typed ones are
+       checked on every assignment: both need a real Var. */
+    if (n != c->block_stmt || n->type_name[0] != '\0') need_env(c);
+    int slot = declare_local(c, n->name, n->kind == NODE_CONSTDECL || n->is_final);
+    emit_bytes(c, OP_DEF_LOCAL, (uint8_t)slot);
+}
+
+static void compile_args(Compiler* c, Node* args, int* count) {
+    *count = 0;
+    for (Node* arg = args; arg; arg = arg->next) {
+        compile_expr(c, arg);
+        (*count)++;
+    }
+    if (*count > 255) {
+        fprintf(stderr, "Error: Can't have more than 255 arguments.\n");
+        c->had_error = true;
+    }
 }
 
-static void emit_jump(Chunk* chunk, OpCode op, int* offset_placeholder) {
-    emit_byte(chunk, op);
-    
-    *offset_placeholder = chunk->count;
-    emit_byte(chunk, 0xff);
-    emit_byte(chunk, 0xff);
+static void compile_call(Compiler* c, Node* n) {
+    int arg_count;
+
+    if (n->left->kind == NODE_GET) {
+        Node* get_node = n->left;
+        compile_expr(c, get_node->left);
+        compile_args(c, n->right, &arg_count);
+        emit_node_operand(c, OP_INVOKE, get_node);
+        emit_byte(c, (uint8_t)arg_count);
+        emit_byte(c, get_node->left->kind == NODE_THIS);
+        return;
+    }
+
+    compile_expr(c, n->left);
+    compile_args(c, n->right, &arg_count);
+    emit_bytes(c, OP_CALL, (uint8_t)arg_count);
+    emit_short(c, addNode(c->chunk, n));
 }
 
-static void patch_jump(Chunk* chunk, int offset) {
-    uint16_t jump = (uint16_t)(chunk->count - offset - 2);
-    
-    chunk->code[offset] = (uint8_t)((jump >> 8) & 0xff);
-    chunk->code[offset + 1] = (uint8_t)(jump & 0xff);
+static void compile_binop(Compiler* c, Node* n) {
+    if (n->op == TOKEN_PIPE_PIPE || n->op == TOKEN_OR || n->op == TOKEN_AND_AND) {
+        compile_expr(c, n->left);
+        int end_jump = emit_jump(c, n->op == TOKEN_AND_AND ? OP_JUMP_IF_FALSE : OP_JUMP_IF_TRUE);
+        emit_byte(c, OP_POP);
+        compile_expr(c, n->right);
+        patch_jump(c, end_jump);
+        return;
+    }
+
+    if (n->op == TOKEN_AS) {
+        compile_expr(c, n->left);
+        emit_name_operand(c, OP_CAST, n->type_name);
+        return;
+    }
+
+    compile_expr(c, n->left);
+    compile_expr(c, n->right);
+    emit_byte(c, (uint8_t)binary_opcode(n->op));
 }
 
-static void compile_node(Node* n, Chunk* chunk) {
-    if (!n) return;
+static void compile_expr(Compiler* c, Node* n) {
+    if (!n) {
+        emit_byte(c, OP_NIL);
+        return;
+    }
+
+    int previous_line = c->line;
+    if (n->line > 0) c->line = n->line;
+
+    if (c->use_slots && needs_env(c, n)) {
+        need_env(c);
+        c->line = previous_line;
+        return;
+    }
+
+    if (!is_compiled(c, n)) {
+        emit_node_operand(c, OP_EVAL, n);
+        c->line = previous_line;
+        return;
+    }
 
     switch (n->kind) {
-        case NODE_NUMBER: {
-            Value val = (Value){VAL_NUMBER, {.number = n->value}};
-            emit_constant_operand(chunk, OP_CONST_NUM, val);
+        case NODE_NUMBER:
+            emit_constant_operand(c, OP_CONST_NUM, NUMBER_VAL(n->value));
             break;
-        }
 
-        case NODE_STRING: {
-            Value val = (Value){VAL_STRING, {.string = strdup(n->name)}};
-            emit_constant_operand(chunk, OP_CONST_STR, val);
-            free((char*)val.as.string);
+        case NODE_STRING:
+            emit_name_operand(c, OP_CONST_STR, n->name);
             break;
-        }
 
-        case NODE_IDENT: {
-            Value name_val = (Value){VAL_STRING, {.string = strdup(n->name)}};
-            emit_constant_operand(chunk, OP_GET_VAR, name_val);
-            free((char*)name_val.as.string);
+        case NODE_BOOL:
+            emit_byte(c, n->value != 0.0 ? OP_TRUE : OP_FALSE);
             break;
-        }
 
-        case NODE_UNARY: {
-            compile_node(n->right, chunk);
-            
-            switch (n->op) {
-                case TOKEN_MINUS: emit_byte(chunk, OP_SUB); break; 
-                case TOKEN_BANG: emit_byte(chunk, OP_NOT); break;
-                default: break;
-            }
+        case NODE_IDENT:
+        case NODE_THIS:
+            compile_get(c, n);
             break;
-        }
 
-        case NODE_BINOP: {
-            compile_node(n->left, chunk);
-            compile_node(n->right, chunk);
-            
-            switch (n->op) {
-                case TOKEN_PLUS: emit_byte(chunk, OP_ADD); break;
-                case TOKEN_MINUS: emit_byte(chunk, OP_SUB); break;
-                case TOKEN_STAR: emit_byte(chunk, OP_MUL); break;
-                case TOKEN_SLASH: emit_byte(chunk, OP_DIV); break;
-                case TOKEN_EQUAL_EQUAL: emit_byte(chunk, OP_EQUAL); break;
-                case TOKEN_GREATER: emit_byte(chunk, OP_GREATER); break;
-                case TOKEN_LESS: emit_byte(chunk, OP_LESS); break;
-                default: break;
-            }
+        case NODE_UNARY:
+            compile_expr(c, n->right);
+            emit_byte(c, n->op == TOKEN_MINUS ? OP_NEGATE : OP_NOT);
             break;
-        }
-        
-        case NODE_VARDECL: { 
-            compile_node(n->right, chunk); 
-            
-            Value name_val = (Value){VAL_STRING, {.string = strdup(n->name)}};
-            emit_constant_operand(chunk, OP_DEF_GLOBAL, name_val);
-            free((char*)name_val.as.string);
+
+        case NODE_BINOP:
+            compile_binop(c, n);
             break;
-        }
 
-        case NODE_ASSIGN: { 
-            compile_node(n->left, chunk); 
-            
-            Value name_val = (Value){VAL_STRING, {.string = strdup(n->name)}};
-            emit_constant_operand(chunk, OP_SET_VAR, name_val);
-            free((char*)name_val.as.string);
+        case NODE_ASSIGN:
+            compile_assign(c, n);
             break;
-        }
-        
-        case NODE_PRINT: {
-            compile_node(n->right, chunk);
-            emit_byte(chunk, OP_PRINT);
+
+        case NODE_POST_INC:
+            compile_post_inc(c, n, true);
             break;
-        }
-        
-        case NODE_BLOCK: {
-            Node* current = n->left;
-            while (current) {
-                compile_node(current, chunk);
-                emit_byte(chunk, OP_POP); 
-                current = current->next;
+
+        case NODE_POST_DEC:
+            compile_post_inc(c, n, false);
+            break;
+
+        case NODE_FUNC_EXPR:
+            emit_byte(c, OP_CLOSURE);
+            emit_short(c, compile_function(c, n, false));
+            break;
+
+        case NODE_FUNC_CALL:
+            compile_call(c, n);
+            break;
+
+        case NODE_ARRAY_LITERAL: {
+            Node* item = n->left;
+            for (int i = 0; i < n->arity; i++) {
+                compile_expr(c, item);
+                item = item->next;
             }
+            emit_byte(c, OP_ARRAY);
+            emit_short(c, n->arity);
             break;
         }
 
-        case NODE_IF_STMT: {
-            compile_node(n->left, chunk);
-            
-            int then_jump_placeholder;
-            emit_jump(chunk, OP_JUMP_IF_FALSE, &then_jump_placeholder);
-            emit_byte(chunk, OP_POP); 
-            
-            compile_node(n->right->left, chunk);
-            
-            if (n->right->right) {
-                int else_jump_placeholder;
-                emit_jump(chunk, OP_JUMP, &else_jump_placeholder);
-                
-                patch_jump(chunk, then_jump_placeholder);
-                emit_byte(chunk, OP_POP); 
-                
-                compile_node(n->right->right, chunk);
-                patch_jump(chunk, else_jump_placeholder);
-            } else {
-                patch_jump(chunk, then_jump_placeholder);
-                emit_byte(chunk, OP_POP); 
+        case NODE_MAP_LITERAL:
+            for (Node* entry = n->left; entry; entry = entry->next) {
+                compile_expr(c, entry->left);
             }
-            
+            emit_node_operand(c, OP_MAP, n);
             break;
-        }
-        
-        case NODE_WHILE_STMT: {
-            int loop_start = chunk->count;
-            
-            compile_node(n->left, chunk);
-            
-            int exit_jump_placeholder;
-            emit_jump(chunk, OP_JUMP_IF_FALSE, &exit_jump_placeholder);
-            emit_byte(chunk, OP_POP); 
-            
-            compile_node(n->right, chunk);
-            
-            emit_byte(chunk, OP_POP); 
-            
-            uint16_t jump_back = (uint16_t)(loop_start - chunk->count - 2); 
-            emit_byte(chunk, OP_LOOP); 
-            emit_byte(chunk, (uint8_t)((jump_back >> 8) & 0xff));
-            emit_byte(chunk, (uint8_t)(jump_back & 0xff));
-            
-            patch_jump(chunk, exit_jump_placeholder);
-            emit_byte(chunk, OP_POP); 
-            
+
+        case NODE_ARRAY_ACCESS:
+            compile_expr(c, n->left);
+            compile_expr(c, n->right);
+            emit_byte(c, OP_INDEX_GET);
             break;
-        }
 
+        case NODE_ARRAY_ASSIGN:
+            compile_expr(c, n->right);
+            compile_expr(c, n->left->left);
+            compile_expr(c, n->left->right);
+            emit_byte(c, OP_INDEX_SET);
+            break;
+
+        case NODE_GET:
+            compile_expr(c, n->left);
+            emit_node_operand(c, OP_GET_PROP, n);
+            break;
+
+        case NODE_SET:
+            compile_expr(c, n->left->left);
+            compile_expr(c, n->right);
+            emit_node_operand(c, OP_SET_PROP, n->left);
+            break;
+
+        case NODE_RANGE_EXPR:
+            compile_expr(c, n->left);
+            compile_expr(c, n->right);
+            compile_expr(c, n->next);
+            emit_byte(c, OP_RANGE);
+            break;
+
+        default:
+            /* Statements used as values, e.g. the branches of an if. */
+            compile_stmt(c, n, true);
+            break;
+    }
+
+    c->line = previous_line;
+}
+
+static void compile_block(Compiler* c, Node* n, bool keep) {
+    push_scope(c, n);
+    Node* stmt = n->left;
+    if (!stmt && keep) emit_byte(c, OP_NIL);
+    while (stmt) {
+        c->block_stmt = stmt;
+        compile_stmt(c, stmt, keep && stmt->next == NULL);
+        stmt = stmt->next;
+    }
+    pop_scope(c);
+}
+
+static void compile_if(Compiler* c, Node* n, bool keep) {
+    compile_expr(c, n->left);
+
+    int else_jump = emit_jump(c, OP_JUMP_IF_FALSE);
+    emit_byte(c, OP_POP);
+    compile_stmt(c, n->right->left, keep);
+
+    int end_jump = emit_jump(c, OP_JUMP);
+    patch_jump(c, else_jump);
+    emit_byte(c, OP_POP);
+
+    if (n->right->right) {
+        compile_stmt(c, n->right->right, keep);
+    } else if (keep) {
+        emit_byte(c, OP_NIL);
+    }
+    patch_jump(c, end_jump);
+}
+
+static void compile_while(Compiler* c, Node* n) {
+    Loop loop;
+    int loop_start = c->chunk->count;
+    begin_loop(c, &loop);
+
+    compile_expr(c, n->left);
+    int exit_jump = emit_jump(c, OP_JUMP_IF_FALSE);
+    emit_byte(c, OP_POP);
+
+    compile_stmt(c, n->right, false);
+
+    patch_jumps(c, loop.continues, loop.continue_count);
+    emit_loop(c, loop_start);
+
+    patch_jump(c, exit_jump);
+    emit_byte(c, OP_POP);
+    patch_jumps(c, loop.breaks, loop.break_count);
+    end_loop(c, &loop);
+}
+
+static void compile_for(Compiler* c, Node* n) {
+    Node* condition = n->right->left;
+    Node* increment = n->right->right->left;
+    Node* body = n->right->right->right;
+
+    push_scope(c, n);
+    c->block_stmt = n->left;
+    compile_stmt(c, n->left, false);
+
+    Loop loop;
+    int loop_start = c->chunk->count;
+    begin_loop(c, &loop);
+
+    compile_expr(c, condition);
+    int exit_jump = emit_jump(c, OP_JUMP_IF_FALSE);
+    emit_byte(c, OP_POP);
+
+    compile_stmt(c, body, false);
+
+    patch_jumps(c, loop.continues, loop.continue_count);
+    compile_expr(c, increment);
+    emit_byte(c, OP_POP);
+    emit_loop(c, loop_start);
+
+    patch_jump(c, exit_jump);
+    emit_byte(c, OP_POP);
+    patch_jumps(c, loop.breaks, loop.break_count);
+    end_loop(c, &loop);
+
+    pop_scope(c);
+}
+
+static void compile_for_each(Compiler* c, Node* n) {
+    compile_expr(c, n->right);
+    int skip_jump = emit_jump(c, OP_ITER_INIT);
+
+    push_scope(c, n);
+    int item_slot = c->use_slots ? declare_local(c, n->left->name, false) : 0;
+
+    Loop loop;
+    int loop_start = c->chunk->count;
+    begin_loop(c, &loop);
+
+    if (c->use_slots) {
+        emit_bytes(c, OP_ITER_NEXT_LOCAL, (uint8_t)item_slot);
+    } else {
+        emit_node_operand(c, OP_ITER_NEXT, n->left);
+    }
+    int exit_jump = c->chunk->count;
+    emit_byte(c, 0xff);
+    emit_byte(c, 0xff);
+
+    compile_stmt(c, n->super_template_types, false);
+
+    patch_jumps(c, loop.continues, loop.continue_count);
+    emit_loop(c, loop_start);
+
+    patch_jump(c, exit_jump);
+    patch_jumps(c, loop.breaks, loop.break_count);
+    end_loop(c, &loop);
+
+    pop_scope(c);
+    emit_byte(c, OP_POP);
+    emit_byte(c, OP_POP);
+    patch_jump(c, skip_jump);
+}
+
+static void compile_func_def(Compiler* c, Node* n) {
+    emit_byte(c, OP_CLOSURE);
+    emit_short(c, compile_function(c, n, false));
+    emit_node_operand(c, OP_DEF_FUNC, n);
+
+    if (n->is_main) {
+        emit_byte(c, OP_IS_MAIN);
+        int skip_jump = emit_jump(c, OP_JUMP_IF_FALSE);
+        emit_byte(c, OP_POP);
+        emit_node_operand(c, OP_GET_VAR, n);
+        emit_bytes(c, OP_CALL, 0);
+        emit_short(c, addNode(c->chunk, n));
+        emit_byte(c, OP_POP);
+        int end_jump = emit_jump(c, OP_JUMP);
+        patch_jump(c, skip_jump);
+        emit_byte(c, OP_POP);
+        patch_jump(c, end_jump);
+    }
+}
+
+static void compile_class(Compiler* c, Node* n) {
+    emit_node_operand(c, OP_CLASS, n);
+    int skip_jump = c->chunk->count;
+    emit_byte(c, 0xff);
+    emit_byte(c, 0xff);
+
+    for (Node* method = n->left; method; method = method->next) {
+        emit_byte(c, OP_METHOD);
+        emit_short(c, compile_function(c, method, true));
+    }
+
+    emit_node_operand(c, OP_END_CLASS, n);
+    patch_jump(c, skip_jump);
+}
+
+/**
+ * Compiles a statement.
+ * @param keep Whether to leave the statement's value on the stack, which is
+ * what eval_node would return for it (used for the last statement of a body).
+ */
+static void compile_stmt(Compiler* c, Node* n, bool keep) {
+    if (!n) {
+        if (keep) emit_byte(c, OP_NIL);
+        return;
+    }
+
+    int previous_line = c->line;
+    if (n->line > 0) c->line = n->line;
+
+    if (c->use_slots && needs_env(c, n)) {
+        need_env(c);
+        c->line = previous_line;
+        return;
+    }
+
+    if (!is_compiled(c, n)) {
+        emit_node_operand(c, OP_EVAL, n);
+        if (!keep) emit_byte(c, OP_POP);
+        c->line = previous_line;
+        return;
+    }
+
+    bool pushes_value = false;
+
+    switch (n->kind) {
+        case NODE_VARDECL:
+        case NODE_CONSTDECL:
+            compile_expr(c, n->right);
+            compile_declare(c, n);
+            break;
 
         case NODE_FUNC_DEF:
-        case NODE_FUNC_CALL:
-        case NODE_RETURN_STMT:
+            compile_func_def(c, n);
+            break;
+
         case NODE_CLASS_DEF:
+            compile_class(c, n);
+            break;
+
+        case NODE_RETURN_STMT:
+            compile_expr(c, n->left);
+            emit_byte(c, OP_RETURN);
+            break;
+
+        case NODE_BREAK_STMT:
+            emit_loop_exit(c, true);
+            break;
+
+        case NODE_CONTINUE_STMT:
+            emit_loop_exit(c, false);
+            break;
+
+        case NODE_BLOCK:
+            compile_block(c, n, keep);
+            pushes_value = keep;
+            break;
+
+        case NODE_IF_STMT:
+            compile_if(c, n, keep);
+            pushes_value = keep;
+            break;
+
+        case NODE_WHILE_STMT:
+            compile_while(c, n);
+            break;
+
+        case NODE_FOR_STMT:
+            compile_for(c, n);
+            break;
+
+        case NODE_FOR_EACH:
+            compile_for_each(c, n);
+            break;
+
         default:
+            compile_expr(c, n);
+            pushes_value = true;
+            if (!keep) {
+                emit_byte(c, OP_POP);
+                pushes_value = keep;
+            }
             break;
     }
+
+    if (keep && !pushes_value) emit_byte(c, OP_NIL);
+    c->line = previous_line;
+}
+
+bool compile_to_binary(Node* root, const char* path, uint64_t source_hash) {
+    JloModule module;
+    jlo_init(&module, source_hash);
+
+    Node* current = root;
+    while (current) {
+        Node* next = current->next;
+        current->next = NULL;
+        jlo_add_statement(&module, current);
+        current = next;
+    }
+
+    bool ok = jlo_write(path, &module);
+    jlo_free(&module);
+    return ok;
 }
 
-void compile_to_binary(Node* root, const char* path) {
-    (void)root;
-    (void)path;
+/**
+ * Compiles a statement of a script. The scopes its blocks and loops open
+ * keep their locals in stack slots of the script frame, as function bodies
+ * do; a statement that needs Env scopes after all (closures, code the
+ * evaluator runs) is compiled again with them.
+ */
+static void compile_top_stmt(Compiler* c, Node* n) {
+    int start = c->chunk->count;
+    int slot_count = c->chunk->slot_count;
+
+    c->use_slots = true;
+    c->slots_failed = false;
+    compile_stmt(c, n, false);
+    c->use_slots = false;
+    if (!c->slots_failed) return;
+
+    c->chunk->count = start;
+    c->chunk->slot_count = slot_count;
+    compile_stmt(c, n, false);
 }
 
 bool compile(Node* program_ast, Chunk* chunk) {
     if (!program_ast) return false;
-    
+
+    Compiler c;
+    memset(&c, 0, sizeof(Compiler));
+    c.chunk = chunk;
+    c.top_level = true;
+
     Node* current = program_ast;
     while (current) {
-        compile_node(current, chunk);
+        compile_top_stmt(&c, current);
         current = current->next;
     }
-    
-    emit_byte(chunk, OP_HALT); 
-    return true;
-}
\ No newline at end of file
+
+    emit_byte(&c, OP_HALT);
+    return !c.had_error;
+}
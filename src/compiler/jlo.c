@@ -0,0 +1,605 @@
+#include "compiler/jlo.h"
+#include "compiler/compiler.h"
+#include "resolver.h"
+#include "lexer.h"
+#include "value.h"
+#include "string_object.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+
+#define GROW_CAPACITY(capacity) ((capacity) < 8 ? 8 : (capacity) * 2)
+
+/**
+ * @typedef @struct BYTEBUFFER
+ * Growable output buffer for the writer.
+ */
+typedef struct {
+    uint8_t* data;
+    size_t count;
+    size_t capacity;
+} ByteBuffer;
+
+/**
+ * @typedef @struct NODEMAP
+ * Numbers every node reachable from the module so pointers can be written
+ * as pool indexes. order lists the nodes by index.
+ */
+typedef struct {
+    Node** keys;
+    int* indexes;
+    int capacity;
+    Node** order;
+    int count;
+    int order_capacity;
+} NodeMap;
+
+/**
+ * @typedef @struct READER
+ * Bounds-checked cursor over a .jlo file loaded in memory.
+ */
+typedef struct {
+    const uint8_t* data;
+    size_t length;
+    size_t pos;
+    bool failed;
+    Node** nodes;
+    int node_count;
+} Reader;
+
+void jlo_init(JloModule* module, uint64_t source_hash) {
+    memset(module, 0, sizeof(JloModule));
+    module->source_hash = source_hash;
+    module->cacheable = true;
+}
+
+uint64_t jlo_hash(const char* data, size_t length) {
+    uint64_t hash = 14695981039346656037ULL;
+    for (size_t i = 0; i < length; i++) {
+        hash ^= (uint8_t)data[i];
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+static void module_append(JloModule* module, Node* stmt, Chunk* chunk) {
+    if (module->count == module->capacity) {
+        module->capacity = GROW_CAPACITY(module->capacity);
+        module->stmts = realloc(module->stmts, sizeof(Node*) * module->capacity);
+        module->chunks = realloc(module->chunks, sizeof(Chunk*) * module->capacity);
+    }
+    module->stmts[module->count] = stmt;
+    module->chunks[module->count] = chunk;
+    module->count++;
+}
+
+void jlo_add_statement(JloModule* module, Node* stmt) {
+    Chunk* chunk = newChunk();
+    if (!compile(stmt, chunk)) {
+        module->cacheable = false;
+    }
+    module_append(module, stmt, chunk);
+}
+
+void jlo_free(JloModule* module) {
+    for (int i = 0; i < module->count; i++) {
+        freeChunk(module->chunks[i]);
+        free(module->chunks[i]);
+    }
+    free(module->stmts);
+    free(module->chunks);
+    jlo_init(module, 0);
+}
+
+/* ---- Writer ---- */
+
+static void buf_write(ByteBuffer* b, const void* data, size_t size) {
+    if (b->count + size > b->capacity) {
+        while (b->count + size > b->capacity) {
+            b->capacity = GROW_CAPACITY(b->capacity);
+        }
+        b->data = realloc(b->data, b->capacity);
+    }
+    memcpy(b->data + b->count, data, size);
+    b->count += size;
+}
+
+static void buf_u8(ByteBuffer* b, uint8_t value) { buf_write(b, &value, sizeof(value)); }
+static void buf_i32(ByteBuffer* b, int32_t value) { buf_write(b, &value, sizeof(value)); }
+static void buf_u64(ByteBuffer* b, uint64_t value) { buf_write(b, &value, sizeof(value)); }
+static void buf_f64(ByteBuffer* b, double value) { buf_write(b, &value, sizeof(value)); }
+
+static void buf_string(ByteBuffer* b, const char* str) {
+    if (!str) {
+        buf_i32(b, -1);
+        return;
+    }
+    int32_t length = (int32_t)strlen(str);
+    buf_i32(b, length);
+    buf_write(b, str, length);
+}
+
+static int map_find(NodeMap* map, Node* node) {
+    if (map->capacity == 0) return -1;
+    size_t i = ((uintptr_t)node >> 4) & (map->capacity - 1);
+    while (map->keys[i]) {
+        if (map->keys[i] == node) return map->indexes[i];
+        i = (i + 1) & (map->capacity - 1);
+    }
+    return -1;
+}
+
+static void map_insert(NodeMap* map, Node* node, int index) {
+    size_t i = ((uintptr_t)node >> 4) & (map->capacity - 1);
+    while (map->keys[i]) {
+        i = (i + 1) & (map->capacity - 1);
+    }
+    map->keys[i] = node;
+    map->indexes[i] = index;
+}
+
+static void map_grow(NodeMap* map) {
+    Node** old_keys = map->keys;
+    int* old_indexes = map->indexes;
+    int old_capacity = map->capacity;
+
+    map->capacity = map->capacity < 64 ? 64 : map->capacity * 2;
+    map->keys = calloc(map->capacity, sizeof(Node*));
+    map->indexes = calloc(map->capacity, sizeof(int));
+    for (int i = 0; i < old_capacity; i++) {
+        if (old_keys[i]) map_insert(map, old_keys[i], old_indexes[i]);
+    }
+    free(old_keys);
+    free(old_indexes);
+}
+
+/**
+ * Numbers a node and everything reachable from it, depth first.
+ */
+static void map_collect(NodeMap* map, Node* root) {
+    int stack_capacity = 64;
+    int stack_count = 0;
+    Node** stack = malloc(sizeof(Node*) * stack_capacity);
+    stack[stack_count++] = root;
+
+    while (stack_count > 0) {
+        Node* node = stack[--stack_count];
+        if (!node || map_find(map, node) >= 0) continue;
+
+        if ((map->count + 1) * 2 > map->capacity) map_grow(map);
+        if (map->count == map->order_capacity) {
+            map->order_capacity = GROW_CAPACITY(map->order_capacity);
+            map->order = realloc(map->order, sizeof(Node*) * map->order_capacity);
+        }
+        map_insert(map, node, map->count);
+        map->order[map->count++] = node;
+
+        if (stack_count + 5 > stack_capacity) {
+            stack_capacity *= 2;
+            stack = realloc(stack, sizeof(Node*) * stack_capacity);
+        }
+        stack[stack_count++] = node->template_types;
+        stack[stack_count++] = node->super_template_types;
+        stack[stack_count++] = node->next;
+        stack[stack_count++] = node->right;
+        stack[stack_count++] = node->left;
+    }
+    free(stack);
+}
+
+static void map_collect_chunk(NodeMap* map, Chunk* chunk) {
+    for (int i = 0; i < chunk->node_count; i++) {
+        map_collect(map, chunk->nodes[i]);
+    }
+    for (int i = 0; i < chunk->proto_count; i++) {
+        map_collect(map, chunk->protos[i].decl);
+        map_collect_chunk(map, chunk->protos[i].body);
+    }
+}
+
+static void write_node(ByteBuffer* b, NodeMap* map, Node* n) {
+    buf_i32(b, n->kind);
+    buf_i32(b, n->op);
+    buf_string(b, n->name);
+    buf_string(b, n->string_value);
+    buf_string(b, n->super_name);
+    buf_string(b, n->interface_name);
+    buf_string(b, n->type_name);
+    buf_string(b, n->return_type);
+    buf_f64(b, n->value);
+
+    buf_i32(b, n->left ? map_find(map, n->left) : -1);
+    buf_i32(b, n->right ? map_find(map, n->right) : -1);
+    buf_i32(b, n->next ? map_find(map, n->next) : -1);
+    buf_i32(b, n->super_template_types ? map_find(map, n->super_template_types) : -1);
+    buf_i32(b, n->template_types ? map_find(map, n->template_types) : -1);
+
+    bool flags[] = {
+        n->is_private, n->is_singleton, n->is_override, n->is_deprecated,
+        n->is_record, n->is_main, n->is_memoize, n->is_paralel, n->is_static,
+        n->is_final, n->is_macro, n->is_platform_specific, n->is_async,
+        n->is_frame_local,
+    };
+    for (size_t i = 0; i < sizeof(flags) / sizeof(flags[0]); i++) {
+        buf_u8(b, flags[i]);
+    }
+
+    buf_i32(b, n->line);
+    buf_i32(b, n->arity);
+    buf_i32(b, n->resolve_kind);
+    buf_i32(b, n->scope_depth);
+    buf_i32(b, n->scope_slot);
+    buf_string(b, n->deprecated_message);
+    buf_string(b, n->target_os);
+}
+
+static void write_chunk(ByteBuffer* b, NodeMap* map, Chunk* chunk) {
+    buf_i32(b, chunk->count);
+    buf_write(b, chunk->code, chunk->count);
+    buf_write(b, chunk->lines, sizeof(int) * chunk->count);
+    buf_i32(b, chunk->slot_count);
+    buf_i32(b, chunk->arity);
+    buf_u8(b, chunk->has_receiver);
+
+    buf_i32(b, chunk->constants.count);
+    for (int i = 0; i < chunk->constants.count; i++) {
+        Value constant = chunk->constants.values[i];
+        buf_u8(b, (uint8_t)VALUE_TYPE(constant));
+        if (VALUE_TYPE(constant) == VAL_NUMBER) {
+            buf_f64(b, AS_NUMBER(constant));
+        } else {
+            buf_string(b, AS_STRING(constant));
+        }
+    }
+
+    buf_i32(b, chunk->node_count);
+    for (int i = 0; i < chunk->node_count; i++) {
+        buf_i32(b, map_find(map, chunk->nodes[i]));
+    }
+
+    buf_i32(b, chunk->proto_count);
+    for (int i = 0; i < chunk->proto_count; i++) {
+        buf_i32(b, map_find(map, chunk->protos[i].decl));
+        write_chunk(b, map, chunk->protos[i].body);
+    }
+}
+
+bool jlo_write(const char* path, const JloModule* module) {
+    if (!module->cacheable) return false;
+
+    NodeMap map;
+    memset(&map, 0, sizeof(NodeMap));
+    for (int i = 0; i < module->count; i++) {
+        map_collect(&map, module->stmts[i]);
+        map_collect_chunk(&map, module->chunks[i]);
+    }
+
+    ByteBuffer b = {0};
+    buf_write(&b, JLO_MAGIC, 3);
+    buf_u8(&b, JLO_VERSION);
+    buf_u64(&b, module->source_hash);
+
+    buf_i32(&b, map.count);
+    for (int i = 0; i < map.count; i++) {
+        write_node(&b, &map, map.order[i]);
+    }
+
+    buf_i32(&b, module->count);
+    for (int i = 0; i < module->count; i++) {
+        buf_i32(&b, map_find(&map, module->stmts[i]));
+        write_chunk(&b, &map, module->chunks[i]);
+    }
+
+    free(map.keys);
+    free(map.indexes);
+    free(map.order);
+
+    /* Write to a private name first so a concurrent reader never sees half a file. */
+    char tmp_path[4096];
+    snprintf(tmp_path, sizeof(tmp_path), "%s.tmp.%ld", path, (long)getpid());
+
+    FILE* f = fopen(tmp_path, "wb");
+    bool ok = f != NULL;
+    if (f) {
+        ok = fwrite(b.data, 1, b.count, f) == b.count;
+        ok = fclose(f) == 0 && ok;
+        ok = ok && rename(tmp_path, path) == 0;
+        if (!ok) remove(tmp_path);
+    }
+
+    free(b.data);
+    return ok;
+}
+
+/* ---- Reader ---- */
+
+static bool rd_bytes(Reader* r, void* out, size_t size) {
+    if (r->failed || r->length - r->pos < size) {
+        r->failed = true;
+        memset(out, 0, size);
+        return false;
+    }
+    memcpy(out, r->data + r->pos, size);
+    r->pos += size;
+    return true;
+}
+
+static uint8_t rd_u8(Reader* r) { uint8_t v; rd_bytes(r, &v, sizeof(v)); return v; }
+static int32_t rd_i32(Reader* r) { int32_t v; rd_bytes(r, &v, sizeof(v)); return v; }
+static uint64_t rd_u64(Reader* r) { uint64_t v; rd_bytes(r, &v, sizeof(v)); return v; }
+static double rd_f64(Reader* r) { double v; rd_bytes(r, &v, sizeof(v)); return v; }
+
+/**
+ * Reads a count, failing if it is negative or larger than the bytes left.
+ */
+static int rd_count(Reader* r) {
+    int32_t count = rd_i32(r);
+    if (count < 0 || (size_t)count > r->length - r->pos) {
+        r->failed = true;
+        return 0;
+    }
+    return count;
+}
+
+/** Reads a string into a fixed-size Node field. */
+static void rd_field(Reader* r, char* field, size_t size) {
+    int32_t length = rd_i32(r);
+    if (length < 0 || (size_t)length >= size) {
+        r->failed = true;
+        field[0] = '\0';
+        return;
+    }
+    rd_bytes(r, field, length);
+    field[length] = '\0';
+}
+
+/** Reads a nullable heap string. */
+static char* rd_string(Reader* r) {
+    int32_t length = rd_i32(r);
+    if (length < 0 || r->failed) return NULL;
+    if ((size_t)length > r->length - r->pos) {
+        r->failed = true;
+        return NULL;
+    }
+    char* str = malloc(length + 1);
+    rd_bytes(r, str, length);
+    str[length] = '\0';
+    return str;
+}
+
+static Node* rd_node_ref(Reader* r) {
+    int32_t index = rd_i32(r);
+    if (index == -1) return NULL;
+    if (index < 0 || index >= r->node_count) {
+        r->failed = true;
+        return NULL;
+    }
+    return r->nodes[index];
+}
+
+static void read_node(Reader* r, Node* n) {
+    n->kind = (NodeKind)rd_i32(r);
+    n->op = (TokenKind)rd_i32(r);
+    rd_field(r, n->name, sizeof(n->name));
+    rd_field(r, n->string_value, sizeof(n->string_value));
+    rd_field(r, n->super_name, sizeof(n->super_name));
+    rd_field(r, n->interface_name, sizeof(n->interface_name));
+    rd_field(r, n->type_name, sizeof(n->type_name));
+    rd_field(r, n->return_type, sizeof(n->return_type));
+    n->value = rd_f64(r);
+
+    n->left = rd_node_ref(r);
+    n->right = rd_node_ref(r);
+    n->next = rd_node_ref(r);
+    n->super_template_types = rd_node_ref(r);
+    n->template_types = rd_node_ref(r);
+
+    bool* flags[] = {
+        &n->is_private, &n->is_singleton, &n->is_override, &n->is_deprecated,
+        &n->is_record, &n->is_main, &n->is_memoize, &n->is_paralel, &n->is_static,
+        &n->is_final, &n->is_macro, &n->is_platform_specific, &n->is_async,
+        &n->is_frame_local,
+    };
+    for (size_t i = 0; i < sizeof(flags) / sizeof(flags[0]); i++) {
+        *flags[i] = rd_u8(r) != 0;
+    }
+
+    n->line = rd_i32(r);
+    n->arity = rd_i32(r);
+    n->resolve_kind = (ResolveKind)rd_i32(r);
+    n->scope_depth = rd_i32(r);
+    n->scope_slot = rd_i32(r);
+    n->deprecated_message = rd_string(r);
+    n->target_os = rd_string(r);
+}
+
+static Chunk* read_chunk(Reader* r, int depth) {
+    Chunk* chunk = newChunk();
+    if (depth > 256) {
+        r->failed = true;
+        return chunk;
+    }
+
+    int count = rd_count(r);
+    chunk->code = malloc(count > 0 ? count : 1);
+    chunk->lines = malloc(sizeof(int) * (count > 0 ? count : 1));
+    rd_bytes(r, chunk->code, count);
+    rd_bytes(r, chunk->lines, sizeof(int) * count);
+    chunk->count = r->failed ? 0 : count;
+    chunk->capacity = count;
+    chunk->slot_count = rd_i32(r);
+    chunk->arity = rd_i32(r);
+    chunk->has_receiver = rd_u8(r) != 0;
+    if (chunk->slot_count < 0 || chunk->slot_count > 256 || chunk->arity < 0 || chunk->arity >= 256) r->failed = true;
+
+    int constant_count = rd_count(r);
+    chunk->constants.values = malloc(sizeof(Value) * (constant_count > 0 ? constant_count : 1));
+    chunk->constants.capacity = constant_count;
+    for (int i = 0; i < constant_count && !r->failed; i++) {
+        Value constant = NIL_VAL;
+        ValueType type = (ValueType)rd_u8(r);
+        if (type == VAL_NUMBER) {
+            constant = NUMBER_VAL(rd_f64(r));
+        } else if (type == VAL_STRING) {
+            char* chars = rd_string(r);
+            if (chars) {
+                constant = string_value(string_intern_pinned(chars));
+                free(chars);
+            } else {
+                r->failed = true;
+            }
+        } else {
+            r->failed = true;
+        }
+        if (r->failed) break;
+        chunk->constants.values[chunk->constants.count++] = constant;
+    }
+
+    int node_count = rd_count(r);
+    chunk->nodes = malloc(sizeof(Node*) * (node_count > 0 ? node_count : 1));
+    chunk->node_capacity = node_count;
+    for (int i = 0; i < node_count && !r->failed; i++) {
+        Node* node = rd_node_ref(r);
+        if (!node) r->failed = true;
+        chunk->nodes[chunk->node_count++] = node;
+    }
+
+    int proto_count = rd_count(r);
+    chunk->protos = malloc(sizeof(FuncProto) * (proto_count > 0 ? proto_count : 1));
+    chunk->proto_capacity = proto_count;
+    for (int i = 0; i < proto_count && !r->failed; i++) {
+        Node* decl = rd_node_ref(r);
+        Chunk* body = read_chunk(r, depth + 1);
+        chunk->protos[chunk->proto_count++] = (FuncProto){decl, body};
+        if (!decl) r->failed = true;
+    }
+
+    return chunk;
+}
+
+static uint8_t* read_whole_file(const char* path, size_t* length) {
+    FILE* f = fopen(path, "rb");
+    if (!f) return NULL;
+
+    fseek(f, 0, SEEK_END);
+    long size = ftell(f);
+    rewind(f);
+    if (size < 0) {
+        fclose(f);
+        return NULL;
+    }
+
+    uint8_t* data = malloc(size + 1);
+    if (data && fread(data, 1, size, f) != (size_t)size) {
+        free(data);
+        data = NULL;
+    }
+    fclose(f);
+
+    if (data) {
+        data[size] = '\0';
+        *length = (size_t)size;
+    }
+    return data;
+}
+
+bool jlo_read(const char* path, JloModule* module, uint64_t expected_hash, bool check_hash) {
+    size_t length = 0;
+    uint8_t* data = read_whole_file(path, &length);
+    if (!data) return false;
+
+    Reader r = {data, length, 0, false, NULL, 0};
+
+    char magic[3];
+    rd_bytes(&r, magic, 3);
+    uint8_t version = rd_u8(&r);
+    uint64_t source_hash = rd_u64(&r);
+    if (r.failed || memcmp(magic, JLO_MAGIC, 3) != 0 || version != JLO_VERSION ||
+        (check_hash && source_hash != expected_hash)) {
+        free(data);
+        return false;
+    }
+
+    r.node_count = rd_count(&r);
+    r.nodes = malloc(sizeof(Node*) * (r.node_count > 0 ? r.node_count : 1));
+    for (int i = 0; i < r.node_count; i++) {
+        r.nodes[i] = calloc(1, sizeof(Node));
+    }
+    for (int i = 0; i < r.node_count && !r.failed; i++) {
+        read_node(&r, r.nodes[i]);
+    }
+
+    jlo_init(module, source_hash);
+    int stmt_count = rd_count(&r);
+    for (int i = 0; i < stmt_count && !r.failed; i++) {
+        Node* stmt = rd_node_ref(&r);
+        Chunk* chunk = read_chunk(&r, 0);
+        if (!stmt) r.failed = true;
+        module_append(module, stmt, chunk);
+    }
+
+    if (r.failed) {
+        jlo_free(module);
+        for (int i = 0; i < r.node_count; i++) {
+            free(r.nodes[i]->deprecated_message);
+            free(r.nodes[i]->target_os);
+            free(r.nodes[i]);
+        }
+    }
+
+    free(r.nodes);
+    free(data);
+    return !r.failed;
+}
+
+/* ---- Cache ---- */
+
+static char* cache_path_for(const char* source_path) {
+    size_t length = strlen(source_path);
+    char* path = malloc(length + 5);
+    strcpy(path, source_path);
+
+    char* dot = strrchr(path, '.');
+    char* slash = strrchr(path, '/');
+    if (dot && (!slash || dot > slash)) {
+        strcpy(dot, ".jlo");
+    } else {
+        strcat(path, ".jlo");
+    }
+    return path;
+}
+
+bool jlo_load_cached(const char* source_path, JloModule* module, bool* cache_hit) {
+    size_t length = 0;
+    char* source = (char*)read_whole_file(source_path, &length);
+    if (!source) return false;
+
+    uint64_t hash = jlo_hash(source, length);
+    char* cache_path = cache_path_for(source_path);
+
+    bool hit = jlo_read(cache_path, module, hash, true);
+    if (cache_hit) *cache_hit = hit;
+
+    if (!hit) {
+        Lexer L;
+        Parser P;
+        lexer_init(&L, source);
+        parser_init(&P, &L);
+
+        jlo_init(module, hash);
+        while (P.current.kind != TOKEN_END) {
+            Node* stmt = parse_stmt(&P);
+            if (stmt) {
+                resolve_stmt(stmt);
+                jlo_add_statement(module, stmt);
+            }
+        }
+        jlo_write(cache_path, module);
+    }
+
+    free(cache_path);
+    free(source);
+    return true;
+}
@@ -0,0 +1,342 @@
+#include "csv/csv_reader.h"
+#include "string_object.h"
+#include "gc.h"
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define CSV_X86 1
+#endif
+
+/* ---- Mapping ---- */
+
+bool csv_map_open(CsvMap* map, const char* path) {
+    map->data = NULL;
+    map->size = 0;
+
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return false;
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        close(fd);
+        return false;
+    }
+    if (st.st_size == 0) {
+        close(fd);
+        return true;
+    }
+
+    void* data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED) return false;
+    madvise(data, st.st_size, MADV_SEQUENTIAL);
+    map->data = data;
+    map->size = st.st_size;
+    return true;
+}
+
+void csv_map_close(CsvMap* map) {
+    if (map->data) munmap((void*)map->data, map->size);
+    map->data = NULL;
+    map->size = 0;
+}
+
+/* ---- Structural characters ---- */
+
+static const char* find_special_scalar(const char* p, const char* end, char delim) {
+    for (; p < end; p++) {
+        char c = *p;
+        if (c == delim || c == '\n' || c == '\r') return p;
+    }
+    return end;
+}
+
+#ifdef CSV_X86
+static const char* find_special_sse2(const char* p, const char* end, char delim) {
+    const __m128i d = _mm_set1_epi8(delim);
+    const __m128i lf = _mm_set1_epi8('\n');
+    const __m128i cr = _mm_set1_epi8('\r');
+    for (; end - p >= 16; p += 16) {
+        __m128i block = _mm_loadu_si128((const __m128i*)p);
+        __m128i hits = _mm_or_si128(_mm_cmpeq_epi8(block, d),
+                                    _mm_or_si128(_mm_cmpeq_epi8(block, lf), _mm_cmpeq_epi8(block, cr)));
+        unsigned mask = (unsigned)_mm_movemask_epi8(hits);
+        if (mask) return p + __builtin_ctz(mask);
+    }
+    return find_special_scalar(p, end, delim);
+}
+
+__attribute__((target("avx2")))
+static const char* find_special_avx2(const char* p, const char* end, char delim) {
+    const __m256i d = _mm256_set1_epi8(delim);
+    const __m256i lf = _mm256_set1_epi8('\n');
+    const __m256i cr = _mm256_set1_epi8('\r');
+    for (; end - p >= 32; p += 32) {
+        __m256i block = _mm256_loadu_si256((const __m256i*)p);
+        __m256i hits = _mm256_or_si256(_mm256_cmpeq_epi8(block, d),
+                                       _mm256_or_si256(_mm256_cmpeq_epi8(block, lf), _mm256_cmpeq_epi8(block, cr)));
+        unsigned mask = (unsigned)_mm256_movemask_epi8(hits);
+        if (mask) return p + __builtin_ctz(mask);
+    }
+    return find_special_sse2(p, end, delim);
+}
+#endif
+
+typedef const char* (*FindSpecial)(const char*, const char*, char);
+
+static FindSpecial pick_find_special(void) {
+#ifdef CSV_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) return find_special_avx2;
+    if (__builtin_cpu_supports("sse2")) return find_special_sse2;
+#endif
+    return find_special_scalar;
+}
+
+const char* csv_find_special(const char* p, const char* end, char delim) {
+    static FindSpecial find = NULL;     // the same choice on every thread, so the race is harmless
+    if (find == NULL) find = pick_find_special();
+    /* Short fields are common: look at the first bytes before setting up vectors. */
+    for (int i = 0; i < 8 && p < end; i++, p++) {
+        char c = *p;
+        if (c == delim || c == '\n' || c == '\r') return p;
+    }
+    return find(p, end, delim);
+}
+
+/* ---- Records ---- */
+
+static void row_push(CsvRow* row, const char* data, size_t length, bool quoted, bool escaped) {
+    if (row->count == row->capacity) {
+        row->capacity = row->capacity ? row->capacity * 2 : 16;
+        row->fields = realloc(row->fields, sizeof(CsvField) * row->capacity);
+    }
+    row->fields[row->count++] = (CsvField){data, length, quoted, escaped};
+}
+
+size_t csv_parse_row(const char* start, const char* end, char delim, bool at_end, CsvRow* row) {
+    const char* p = start;
+    row->count = 0;
+    if (p >= end) return 0;
+
+    for (;;) {
+        if (p < end && *p == '"') {
+            const char* q = p + 1;
+            bool escaped = false;
+            for (;;) {
+                q = memchr(q, '"', end - q);
+                if (q == NULL) {
+                    /* No closing quote: wait for more, or take the rest of the input. */
+                    if (!at_end) return 0;
+                    row_push(row, p + 1, end - p - 1, true, escaped);
+                    return end - start;
+                }
+                if (q + 1 < end && q[1] == '"') {
+                    escaped = true;
+                    q += 2;
+                    continue;
+                }
+                if (q + 1 == end && !at_end) return 0;     // may yet turn out to be a doubled quote
+                break;
+            }
+            const char* open = p;
+            p = q + 1;
+            if (p < end && *p != delim && *p != '\n' && *p != '\r') {
+                /* Text after the closing quote is kept, stray quote and all. */
+                const char* s = csv_find_special(p, end, delim);
+                if (s == end && !at_end) return 0;
+                row_push(row, open + 1, s - open - 1, true, true);
+                p = s;
+            } else {
+                row_push(row, open + 1, q - open - 1, true, escaped);
+            }
+        } else {
+            const char* s = csv_find_special(p, end, delim);
+            row_push(row, p, s - p, false, false);
+            p = s;
+        }
+
+        if (p == end) return at_end ? (size_t)(end - start) : 0;
+        if (*p == delim) {
+            p++;
+            continue;
+        }
+        if (*p == '\r') {
+            p++;
+            if (p < end && *p == '\n') p++;
+            else if (p == end && !at_end) return 0;
+        } else {
+            p++;
+        }
+        return p - start;
+    }
+}
+
+bool csv_row_blank(const CsvRow* row) {
+    return row->count == 1 && row->fields[0].length == 0 && !row->fields[0].quoted;
+}
+
+void csv_row_free(CsvRow* row) {
+    free(row->fields);
+    row->fields = NULL;
+    row->count = row->capacity = 0;
+}
+
+/* ---- Values ---- */
+
+static const double exact_powers[] = {
+    1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+bool csv_parse_number(const char* p, size_t length, double* out) {
+    const char* end = p + length;
+    while (p < end && *p == ' ') p++;
+    while (end > p && end[-1] == ' ') end--;
+    if (p == end) return false;
+
+    const char* start = p;
+    bool negative = false;
+    if (*p == '-' || *p == '+') negative = *p++ == '-';
+
+    uint64_t mantissa = 0;
+    int digits = 0, dropped = 0, exponent = 0;
+    bool any = false;
+    for (; p < end && *p >= '0' && *p <= '9'; p++, any = true) {
+        if (digits < 19) {
+            mantissa = mantissa * 10 + (*p - '0');
+            if (mantissa) digits++;
+        } else {
+            dropped++;
+        }
+    }
+    if (p < end && *p == '.') {
+        for (p++; p < end && *p >= '0' && *p <= '9'; p++, any = true) {
+            if (digits < 19) {
+                mantissa = mantissa * 10 + (*p - '0');
+                if (mantissa) digits++;
+                exponent--;
+            }
+        }
+    }
+    if (!any) return false;
+    if (p < end && (*p == 'e' || *p == 'E')) {
+        p++;
+        bool exp_negative = false;
+        if (p < end && (*p == '-' || *p == '+')) exp_negative = *p++ == '-';
+        if (p == end || *p < '0' || *p > '9') return false;
+        int e = 0;
+        for (; p < end && *p >= '0' && *p <= '9'; p++) {
+            if (e < 100000) e = e * 10 + (*p - '0');
+        }
+        exponent += exp_negative ? -e : e;
+    }
+    if (p != end) return false;
+    exponent += dropped;
+
+    /* Exact when the digits fit a double and the power of ten is exact too. */
+    if (mantissa < (1ULL << 53) && exponent >= -22 && exponent <= 22) {
+        double value = (double)mantissa;
+        value = exponent < 0 ? value / exact_powers[-exponent] : value * exact_powers[exponent];
+        *out = negative ? -value : value;
+        return true;
+    }
+
+    size_t n = end - start;
+    char small[64];
+    char* copy = n < sizeof(small) ? small : malloc(n + 1);
+    memcpy(copy, start, n);
+    copy[n] = '\0';
+    *out = strtod(copy, NULL);
+    if (copy != small) free(copy);
+    return true;
+}
+
+bool csv_parse_int(const char* p, size_t length, int64_t* out) {
+    const char* end = p + length;
+    while (p < end && *p == ' ') p++;
+    while (end > p && end[-1] == ' ') end--;
+
+    bool negative = false;
+    if (p < end && (*p == '-' || *p == '+')) negative = *p++ == '-';
+    if (p == end || end - p > 18) return false;
+
+    int64_t value = 0;
+    for (; p < end; p++) {
+        if (*p < '0' || *p > '9') return false;
+        value = value * 10 + (*p - '0');
+    }
+    *out = negative ? -value : value;
+    return true;
+}
+
+static Value cached_string(CsvStringCache* cache, const char* chars, size_t length) {
+    if (cache == NULL || length > CSV_STRING_CACHE_MAX) return string_new(chars, length);
+
+    Value* slot = &cache->strings[string_hash(chars, length) % CSV_STRING_CACHE_SIZE];
+    if (VALUE_TYPE(*slot) == VAL_STRING && STRING_OBJECT(AS_STRING(*slot))->length == length &&
+        memcmp(AS_STRING(*slot), chars, length) == 0) {
+        return *slot;
+    }
+    *slot = string_new(chars, length);
+    return *slot;
+}
+
+Value csv_field_value(const CsvField* field, bool infer_numbers, CsvStringCache* cache) {
+    double number;
+    if (infer_numbers && csv_parse_number(field->data, field->length, &number)) return NUMBER_VAL(number);
+    if (!field->escaped) return cached_string(cache, field->data, field->length);
+
+    char small[256];
+    char* text = field->length < sizeof(small) ? small : malloc(field->length);
+    size_t n = 0;
+    for (size_t i = 0; i < field->length; i++) {
+        text[n++] = field->data[i];
+        if (field->data[i] == '"' && i + 1 < field->length && field->data[i + 1] == '"') i++;
+    }
+    Value value = cached_string(cache, text, n);
+    if (text != small) free(text);
+    return value;
+}
+
+ValueArray* csv_row_array(const CsvRow* row, bool infer_numbers, CsvStringCache* cache) {
+    ValueArray* arr = array_new();
+    if (row->count > arr->capacity) {
+        arr->values = realloc(arr->values, sizeof(Value) * row->count);
+        arr->capacity = row->count;
+    }
+    /* Counted as they are made, so a collection while making the next one keeps them. */
+    for (int i = 0; i < row->count; i++) arr->values[arr->count++] = csv_field_value(&row->fields[i], infer_numbers, cache);
+    return arr;
+}
+
+ValueArray* csv_read_file(const char* path, char delim, bool infer_numbers) {
+    CsvMap map;
+    if (!csv_map_open(&map, path)) return NULL;
+
+    ValueArray* matrix = array_new();
+    CsvRow row = {0};
+    CsvStringCache* cache = calloc(1, sizeof(CsvStringCache));
+    const char* p = map.data;
+    const char* end = map.data + map.size;
+    gc_pause();                         // every row made is kept, so collecting midway frees nothing
+    while (p < end) {
+        size_t used = csv_parse_row(p, end, delim, true, &row);
+        p += used;
+        if (csv_row_blank(&row)) continue;
+        array_append(matrix, ARRAY_VAL(csv_row_array(&row, infer_numbers, cache)));
+    }
+    gc_resume();
+
+    free(cache);
+    csv_row_free(&row);
+    csv_map_close(&map);
+    return matrix;
+}
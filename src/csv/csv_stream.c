@@ -0,0 +1,424 @@
+#include "csv/csv_stream.h"
+#include "methods.h"
+#include "gc.h"
+#include "value.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <math.h>
+#include <pthread.h>
+#include <unistd.h>
+
+/* ---- Cursors ---- */
+
+CsvCursor* csv_cursor_open(const char* path, char delim) {
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return NULL;
+#ifdef POSIX_FADV_SEQUENTIAL
+    posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+#endif
+
+    CsvCursor* cursor = gc_allocate(sizeof(CsvCursor), GC_CSV_CURSOR);
+    cursor->fd = fd;
+    cursor->delim = delim;
+    cursor->buffer = malloc(CSV_STREAM_BUFFER);
+    cursor->capacity = CSV_STREAM_BUFFER;
+    cursor->cache = calloc(1, sizeof(CsvStringCache));
+    return cursor;
+}
+
+void csv_cursor_close(CsvCursor* cursor) {
+    if (cursor->fd >= 0) close(cursor->fd);
+    cursor->fd = -1;
+    free(cursor->buffer);
+    cursor->buffer = NULL;
+    cursor->start = cursor->end = cursor->capacity = 0;
+    cursor->at_eof = true;
+    csv_row_free(&cursor->row);
+}
+
+void csv_cursor_finalize(CsvCursor* cursor) {
+    csv_cursor_close(cursor);
+    free(cursor->cache);
+    cursor->cache = NULL;
+}
+
+/**
+ * Moves the unscanned bytes to the front of the buffer, growing it if they
+ * fill it, and reads more after them.
+ */
+static void cursor_fill(CsvCursor* cursor) {
+    size_t pending = cursor->end - cursor->start;
+    if (cursor->start > 0) {
+        memmove(cursor->buffer, cursor->buffer + cursor->start, pending);
+        cursor->start = 0;
+        cursor->end = pending;
+    }
+    if (cursor->end == cursor->capacity) {
+        cursor->capacity *= 2;
+        cursor->buffer = realloc(cursor->buffer, cursor->capacity);
+    }
+
+    ssize_t n;
+    do {
+        n = read(cursor->fd, cursor->buffer + cursor->end, cursor->capacity - cursor->end);
+    } while (n < 0 && errno == EINTR);
+    if (n < 0) print_error("CSV read failed: %s", strerror(errno));
+    if (n <= 0) {
+        cursor->at_eof = true;
+        return;
+    }
+    cursor->end += n;
+}
+
+ValueArray* csv_cursor_next(CsvCursor* cursor) {
+    while (cursor->buffer) {
+        const char* p = cursor->buffer + cursor->start;
+        size_t used = csv_parse_row(p, cursor->buffer + cursor->end, cursor->delim, cursor->at_eof, &cursor->row);
+        if (used == 0) {
+            /* At the end only once every byte is scanned, since at_eof makes each record complete. */
+            if (cursor->at_eof) {
+                csv_cursor_close(cursor);
+                return NULL;
+            }
+            cursor_fill(cursor);
+            continue;
+        }
+        cursor->start += used;
+        if (csv_row_blank(&cursor->row)) continue;
+        return csv_row_array(&cursor->row, false, cursor->cache);
+    }
+    return NULL;
+}
+
+/* ---- Output ---- */
+
+bool csv_out_open(CsvOut* out, const char* path, char delim, bool append) {
+    int flags = O_WRONLY | O_CREAT | O_CLOEXEC | (append ? O_APPEND : O_TRUNC);
+    out->fd = open(path, flags, 0644);
+    out->delim = delim;
+    out->buffer = NULL;
+    out->length = 0;
+    out->failed = false;
+    if (out->fd < 0) return false;
+    out->buffer = malloc(CSV_STREAM_BUFFER);
+    return true;
+}
+
+bool csv_out_flush(CsvOut* out) {
+    size_t done = 0;
+    while (done < out->length && !out->failed) {
+        ssize_t n = write(out->fd, out->buffer + done, out->length - done);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            out->failed = true;
+            break;
+        }
+        done += n;
+    }
+    out->length = 0;
+    return !out->failed;
+}
+
+bool csv_out_close(CsvOut* out) {
+    if (out->fd < 0) return !out->failed;
+    csv_out_flush(out);
+    if (close(out->fd) != 0) out->failed = true;
+    out->fd = -1;
+    free(out->buffer);
+    out->buffer = NULL;
+    return !out->failed;
+}
+
+/** Makes room for n more bytes, n being at most CSV_STREAM_BUFFER. */
+static inline void out_reserve(CsvOut* out, size_t n) {
+    if (out->length + n > CSV_STREAM_BUFFER) csv_out_flush(out);
+}
+
+static inline void out_char(CsvOut* out, char c) {
+    out_reserve(out, 1);
+    out->buffer[out->length++] = c;
+}
+
+static void out_bytes(CsvOut* out, const char* data, size_t length) {
+    if (length >= CSV_STREAM_BUFFER) {
+        csv_out_flush(out);
+        for (size_t done = 0; done < length && !out->failed;) {
+            ssize_t n = write(out->fd, data + done, length - done);
+            if (n < 0 && errno == EINTR) continue;
+            if (n < 0) out->failed = true;
+            else done += n;
+        }
+        return;
+    }
+    out_reserve(out, length);
+    memcpy(out->buffer + out->length, data, length);
+    out->length += length;
+}
+
+void csv_out_field(CsvOut* out, const char* text, size_t length) {
+    bool quote = false;
+    for (size_t i = 0; i < length && !quote; i++) {
+        char c = text[i];
+        quote = c == out->delim || c == '"' || c == '\n' || c == '\r';
+    }
+    if (!quote) {
+        out_bytes(out, text, length);
+        return;
+    }
+
+    out_char(out, '"');
+    const char* run = text;
+    const char* end = text + length;
+    for (const char* q; (q = memchr(run, '"', end - run)) != NULL; run = q + 1) {
+        out_bytes(out, run, q + 1 - run);
+        out_char(out, '"');
+    }
+    out_bytes(out, run, end - run);
+    out_char(out, '"');
+}
+
+void csv_out_int(CsvOut* out, int64_t value) {
+    char digits[24];
+    int n = 0;
+    uint64_t magnitude = value < 0 ? -(uint64_t)value : (uint64_t)value;
+    do {
+        digits[sizeof(digits) - 1 - n++] = (char)('0' + magnitude % 10);
+        magnitude /= 10;
+    } while (magnitude);
+    if (value < 0) digits[sizeof(digits) - 1 - n++] = '-';
+    out_bytes(out, digits + sizeof(digits) - n, n);
+}
+
+int csv_format_number(char text[32], double value) {
+    if (value == floor(value) && fabs(value) < 1e18) return snprintf(text, 32, "%lld", (long long)value);
+    int n = snprintf(text, 32, "%.15g", value);
+    if (strtod(text, NULL) != value) n = snprintf(text, 32, "%.17g", value);
+    return n;
+}
+
+void csv_out_double(CsvOut* out, double value) {
+    if (value == floor(value) && fabs(value) < 1e18) {
+        csv_out_int(out, (int64_t)value);
+        return;
+    }
+    char text[32];
+    out_bytes(out, text, csv_format_number(text, value));
+}
+
+void csv_out_delim(CsvOut* out) {
+    out_char(out, out->delim);
+}
+
+void csv_out_end_row(CsvOut* out) {
+    out_char(out, '\n');
+}
+
+void csv_out_value(CsvOut* out, Value value) {
+    switch (VALUE_TYPE(value)) {
+        case VAL_NIL:
+            break;
+        case VAL_NUMBER:
+            csv_out_double(out, AS_NUMBER(value));
+            break;
+        case VAL_STRING:
+            csv_out_field(out, AS_STRING(value), strlen(AS_STRING(value)));
+            break;
+        case VAL_BOOL:
+            out_bytes(out, AS_BOOL(value) ? "true" : "false", AS_BOOL(value) ? 4 : 5);
+            break;
+        default: {
+            char* text = value_to_string(value);
+            csv_out_field(out, text, strlen(text));
+            free(text);
+            break;
+        }
+    }
+}
+
+void csv_out_row(CsvOut* out, const ValueArray* row) {
+    for (int i = 0; i < row->count; i++) {
+        if (i > 0) out_char(out, out->delim);
+        csv_out_value(out, row->values[i]);
+    }
+    out_char(out, '\n');
+}
+
+/* ---- Writers ---- */
+
+static CsvWriter* open_writers = NULL;
+static pthread_mutex_t open_writers_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/** Flushes the writers a script left open. */
+static void flush_open_writers(void) {
+    pthread_mutex_lock(&open_writers_lock);
+    for (CsvWriter* w = open_writers; w; w = w->next_open) {
+        csv_out_close(&w->out);
+        w->open = false;
+    }
+    open_writers = NULL;
+    pthread_mutex_unlock(&open_writers_lock);
+}
+
+static void flush_writers_at_exit(void) {
+    atexit(flush_open_writers);
+}
+
+CsvWriter* csv_writer_open(const char* path, char delim, bool append) {
+    static pthread_once_t at_exit = PTHREAD_ONCE_INIT;
+    CsvOut out;
+    if (!csv_out_open(&out, path, delim, append)) return NULL;
+    pthread_once(&at_exit, flush_writers_at_exit);
+
+    CsvWriter* writer = gc_allocate(sizeof(CsvWriter), GC_CSV_WRITER);
+    writer->out = out;
+    writer->open = true;
+    pthread_mutex_lock(&open_writers_lock);
+    writer->next_open = open_writers;
+    open_writers = writer;
+    pthread_mutex_unlock(&open_writers_lock);
+    return writer;
+}
+
+bool csv_writer_close(CsvWriter* writer) {
+    pthread_mutex_lock(&open_writers_lock);
+    if (!writer->open) {
+        pthread_mutex_unlock(&open_writers_lock);
+        return !writer->out.failed;
+    }
+    for (CsvWriter** link = &open_writers; *link; link = &(*link)->next_open) {
+        if (*link == writer) {
+            *link = writer->next_open;
+            break;
+        }
+    }
+    writer->open = false;
+    pthread_mutex_unlock(&open_writers_lock);
+    return csv_out_close(&writer->out);
+}
+
+void csv_writer_finalize(CsvWriter* writer) {
+    csv_writer_close(writer);
+}
+
+/* ---- Natives ---- */
+
+static char delim_arg(int arity, Value* args, int index) {
+    return arity > index && VALUE_TYPE(args[index]) == VAL_STRING && AS_STRING(args[index])[0] ? AS_STRING(args[index])[0] : ',';
+}
+
+/**
+ * Native '__csv_stream': opens a CSV file for reading a record at a time.
+ * @param args[0] Path.
+ * @param args[1] Delimiter (optional, ",").
+ * @return A CsvCursor, or nil if the file cannot be opened.
+ */
+Value native_csv_stream(int arity, Value* args) {
+    if (arity < 1 || VALUE_TYPE(args[0]) != VAL_STRING) {
+        print_error("csv_stream expects at least 1 argument (path)");
+        return NIL_VAL;
+    }
+    CsvCursor* cursor = csv_cursor_open(AS_STRING(args[0]), delim_arg(arity, args, 1));
+    if (cursor == NULL) {
+        print_error("Could not open file: %s", AS_STRING(args[0]));
+        return NIL_VAL;
+    }
+    return MAKE_VALUE(VAL_CSV_CURSOR, cursor, cursor);
+}
+
+/**
+ * Native '__csv_writer': opens a CSV file for writing a row at a time.
+ * @param args[0] Path.
+ * @param args[1] Delimiter (optional, ",").
+ * @param args[2] Whether to append instead of truncating (optional).
+ * @return A CsvWriter, or nil if the file cannot be created.
+ */
+Value native_csv_writer(int arity, Value* args) {
+    if (arity < 1 || VALUE_TYPE(args[0]) != VAL_STRING) {
+        print_error("csv_writer expects at least 1 argument (path)");
+        return NIL_VAL;
+    }
+    bool append = arity > 2 && VALUE_TYPE(args[2]) == VAL_BOOL && AS_BOOL(args[2]);
+    CsvWriter* writer = csv_writer_open(AS_STRING(args[0]), delim_arg(arity, args, 1), append);
+    if (writer == NULL) {
+        print_error("Could not create file: %s", AS_STRING(args[0]));
+        return NIL_VAL;
+    }
+    return MAKE_VALUE(VAL_CSV_WRITER, csv_writer, writer);
+}
+
+static Value cursor_method_next(Env* env, Value receiver, int arg_count, Value* args) {
+    ValueArray* row = csv_cursor_next(AS_CSV_CURSOR(receiver));
+    return row ? ARRAY_VAL(row) : NIL_VAL;
+}
+
+static Value cursor_method_batch(Env* env, Value receiver, int arg_count, Value* args) {
+    if (arg_count < 1 || VALUE_TYPE(args[0]) != VAL_NUMBER || AS_NUMBER(args[0]) < 1) {
+        print_error("Error: batch() expects a positive row count.");
+        return NIL_VAL;
+    }
+    size_t n = (size_t)AS_NUMBER(args[0]);
+    ValueArray* rows = array_new();
+    for (size_t i = 0; i < n; i++) {
+        ValueArray* row = csv_cursor_next(AS_CSV_CURSOR(receiver));
+        if (row == NULL) break;
+        array_append(rows, ARRAY_VAL(row));
+    }
+    return ARRAY_VAL(rows);
+}
+
+static Value cursor_method_close(Env* env, Value receiver, int arg_count, Value* args) {
+    csv_cursor_close(AS_CSV_CURSOR(receiver));
+    return NIL_VAL;
+}
+
+static Value writer_method_write(Env* env, Value receiver, int arg_count, Value* args) {
+    CsvWriter* writer = AS_CSV_WRITER(receiver);
+    if (arg_count < 1 || VALUE_TYPE(args[0]) != VAL_ARRAY) {
+        print_error("Error: write() expects an Array of cells.");
+        return BOOL_VAL(false);
+    }
+    if (!writer->open) return BOOL_VAL(false);
+    csv_out_row(&writer->out, AS_ARRAY(args[0]));
+    return BOOL_VAL(!writer->out.failed);
+}
+
+static Value writer_method_write_all(Env* env, Value receiver, int arg_count, Value* args) {
+    CsvWriter* writer = AS_CSV_WRITER(receiver);
+    if (arg_count < 1 || VALUE_TYPE(args[0]) != VAL_ARRAY) {
+        print_error("Error: writeAll() expects an Array of rows.");
+        return BOOL_VAL(false);
+    }
+    if (!writer->open) return BOOL_VAL(false);
+    ValueArray* rows = AS_ARRAY(args[0]);
+    for (int i = 0; i < rows->count; i++) {
+        if (VALUE_TYPE(rows->values[i]) == VAL_ARRAY) csv_out_row(&writer->out, AS_ARRAY(rows->values[i]));
+    }
+    return BOOL_VAL(!writer->out.failed);
+}
+
+static Value writer_method_flush(Env* env, Value receiver, int arg_count, Value* args) {
+    CsvWriter* writer = AS_CSV_WRITER(receiver);
+    return BOOL_VAL(writer->open && csv_out_flush(&writer->out));
+}
+
+static Value writer_method_close(Env* env, Value receiver, int arg_count, Value* args) {
+    return BOOL_VAL(csv_writer_close(AS_CSV_WRITER(receiver)));
+}
+
+void register_csv_stream_natives(Env* env) {
+    set_var(env, "__csv_stream", NATIVE_VAL(native_csv_stream), true, "");
+    set_var(env, "__csv_writer", NATIVE_VAL(native_csv_writer), true, "");
+
+    register_method(VAL_CSV_CURSOR, "next", cursor_method_next);
+    register_method(VAL_CSV_CURSOR, "batch", cursor_method_batch);
+    register_method(VAL_CSV_CURSOR, "close", cursor_method_close);
+
+    register_method(VAL_CSV_WRITER, "write", writer_method_write);
+    register_method(VAL_CSV_WRITER, "writeAll", writer_method_write_all);
+    register_method(VAL_CSV_WRITER, "flush", writer_method_flush);
+    register_method(VAL_CSV_WRITER, "close", writer_method_close);
+}
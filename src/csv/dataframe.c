@@ -0,0 +1,1424 @@
+#include "csv/dataframe.h"
+#include "csv/csv_reader.h"
+#include "csv/csv_stream.h"
+#include "methods.h"
+#include "string_object.h"
+#include "gc.h"
+#include "value.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <math.h>
+#include <pthread.h>
+#include <unistd.h>
+
+/* ---- Dictionaries ---- */
+
+static inline const char* dict_string(const StringDict* dict, uint32_t code) {
+    return dict->text + dict->offsets[code];
+}
+
+static void dict_grow_slots(StringDict* dict) {
+    uint32_t capacity = dict->slot_capacity ? dict->slot_capacity * 2 : 64;
+    uint32_t* slots = calloc(capacity, sizeof(uint32_t));
+    for (uint32_t code = 0; code < dict->count; code++) {
+        uint32_t i = string_hash(dict_string(dict, code), dict->lengths[code]) & (capacity - 1);
+        while (slots[i]) i = (i + 1) & (capacity - 1);
+        slots[i] = code + 1;
+    }
+    free(dict->slots);
+    dict->slots = slots;
+    dict->slot_capacity = capacity;
+}
+
+uint32_t dict_intern(StringDict* dict, const char* chars, size_t length) {
+    if ((dict->count + 1) * 2 > dict->slot_capacity) dict_grow_slots(dict);
+
+    uint32_t mask = dict->slot_capacity - 1;
+    uint32_t i = string_hash(chars, length) & mask;
+    for (; dict->slots[i]; i = (i + 1) & mask) {
+        uint32_t code = dict->slots[i] - 1;
+        if (dict->lengths[code] == length && memcmp(dict_string(dict, code), chars, length) == 0) return code;
+    }
+
+    if (dict->count == dict->capacity) {
+        dict->capacity = dict->capacity ? dict->capacity * 2 : 16;
+        dict->offsets = realloc(dict->offsets, sizeof(size_t) * dict->capacity);
+        dict->lengths = realloc(dict->lengths, sizeof(uint32_t) * dict->capacity);
+    }
+    if (dict->text_length + length + 1 > dict->text_capacity) {
+        size_t capacity = dict->text_capacity ? dict->text_capacity * 2 : 256;
+        while (capacity < dict->text_length + length + 1) capacity *= 2;
+        dict->text = realloc(dict->text, capacity);
+        dict->text_capacity = capacity;
+    }
+    memcpy(dict->text + dict->text_length, chars, length);
+    dict->text[dict->text_length + length] = '\0';
+    dict->offsets[dict->count] = dict->text_length;
+    dict->lengths[dict->count] = (uint32_t)length;
+    dict->text_length += length + 1;
+    dict->slots[i] = ++dict->count;
+    return dict->count - 1;
+}
+
+void dict_free(StringDict* dict) {
+    if (dict == NULL) return;
+    free(dict->text);
+    free(dict->offsets);
+    free(dict->lengths);
+    free(dict->slots);
+    free(dict);
+}
+
+static StringDict* dict_copy(const StringDict* src) {
+    StringDict* dict = calloc(1, sizeof(StringDict));
+    *dict = *src;
+    dict->text = malloc(src->text_capacity ? src->text_capacity : 1);
+    memcpy(dict->text, src->text, src->text_length);
+    dict->offsets = malloc(sizeof(size_t) * (src->capacity ? src->capacity : 1));
+    memcpy(dict->offsets, src->offsets, sizeof(size_t) * src->count);
+    dict->lengths = malloc(sizeof(uint32_t) * (src->capacity ? src->capacity : 1));
+    memcpy(dict->lengths, src->lengths, sizeof(uint32_t) * src->count);
+    dict->slots = malloc(sizeof(uint32_t) * (src->slot_capacity ? src->slot_capacity : 1));
+    memcpy(dict->slots, src->slots, sizeof(uint32_t) * src->slot_capacity);
+    return dict;
+}
+
+/* ---- Frames and columns ---- */
+
+static size_t null_words(size_t rows) {
+    return rows ? (rows + 63) / 64 : 1;
+}
+
+static size_t cell_size(ColumnType type) {
+    switch (type) {
+        case COLUMN_DOUBLE: return sizeof(double);
+        case COLUMN_INT: return sizeof(int64_t);
+        case COLUMN_STRING: return sizeof(uint32_t);
+    }
+    return sizeof(double);
+}
+
+DataFrame* frame_new(int column_count, size_t rows) {
+    DataFrame* frame = gc_allocate(sizeof(DataFrame), GC_FRAME);
+    frame->columns = calloc(column_count ? column_count : 1, sizeof(Column));
+    frame->column_count = column_count;
+    frame->rows = rows;
+    return frame;
+}
+
+void frame_column_init(DataFrame* frame, int index, const char* name, ColumnType type) {
+    Column* column = &frame->columns[index];
+    column->name = strdup(name);
+    column->type = type;
+    column->data.doubles = calloc(frame->rows ? frame->rows : 1, cell_size(type));
+    if (type == COLUMN_STRING) column->dict = calloc(1, sizeof(StringDict));
+}
+
+void frame_finalize(DataFrame* frame) {
+    for (int i = 0; i < frame->column_count; i++) {
+        Column* column = &frame->columns[i];
+        free(column->name);
+        free(column->data.doubles);
+        free(column->nulls);
+        dict_free(column->dict);
+    }
+    free(frame->columns);
+    frame->columns = NULL;
+    frame->column_count = 0;
+}
+
+int frame_column_index(const DataFrame* frame, const char* name) {
+    for (int i = 0; i < frame->column_count; i++) {
+        if (strcmp(frame->columns[i].name, name) == 0) return i;
+    }
+    return -1;
+}
+
+static void column_set_null(DataFrame* frame, int index, size_t row) {
+    Column* column = &frame->columns[index];
+    if (column->nulls == NULL) column->nulls = calloc(null_words(frame->rows), sizeof(uint64_t));
+    column->nulls[row / 64] |= 1ULL << (row % 64);
+}
+
+Value frame_cell(const DataFrame* frame, int index, size_t row) {
+    const Column* column = &frame->columns[index];
+    if (column_is_null(column, row)) return NIL_VAL;
+    switch (column->type) {
+        case COLUMN_DOUBLE: return NUMBER_VAL(column->data.doubles[row]);
+        case COLUMN_INT: return NUMBER_VAL((double)column->data.ints[row]);
+        case COLUMN_STRING: {
+            uint32_t code = column->data.codes[row];
+            return string_new(dict_string(column->dict, code), column->dict->lengths[code]);
+        }
+    }
+    return NIL_VAL;
+}
+
+/**
+ * Like frame_cell, but a string column makes each distinct string once.
+ * @param strings One slot per code of the column, zeroed (nil) at first.
+ */
+static Value frame_cell_shared(const DataFrame* frame, int index, size_t row, Value* strings) {
+    const Column* column = &frame->columns[index];
+    if (column->type != COLUMN_STRING || column_is_null(column, row)) return frame_cell(frame, index, row);
+    uint32_t code = column->data.codes[row];
+    if (VALUE_TYPE(strings[code]) == VAL_NIL) strings[code] = frame_cell(frame, index, row);
+    return strings[code];
+}
+
+/**
+ * A cell as the text a CSV file holds for it: numbers formatted as the
+ * writer formats them, empty for a null.
+ */
+static Value frame_cell_text(const DataFrame* frame, int index, size_t row, Value* strings) {
+    const Column* column = &frame->columns[index];
+    if (column_is_null(column, row)) return string_new("", 0);
+    char text[32];
+    switch (column->type) {
+        case COLUMN_DOUBLE: return string_new(text, csv_format_number(text, column->data.doubles[row]));
+        case COLUMN_INT: return string_new(text, snprintf(text, sizeof(text), "%lld", (long long)column->data.ints[row]));
+        case COLUMN_STRING: return frame_cell_shared(frame, index, row, strings);
+    }
+    return NIL_VAL;
+}
+
+/** Copies rows [start, start + count) of src into column index of frame, named and typed as src. */
+static void column_copy_range(DataFrame* frame, int index, const Column* src, size_t start, size_t count) {
+    frame_column_init(frame, index, src->name, src->type);
+    Column* column = &frame->columns[index];
+    size_t size = cell_size(src->type);
+    memcpy(column->data.doubles, (const char*)src->data.doubles + start * size, count * size);
+    if (src->type == COLUMN_STRING) {
+        dict_free(column->dict);
+        column->dict = dict_copy(src->dict);
+    }
+    if (src->nulls) {
+        for (size_t i = 0; i < count; i++) {
+            if (column_is_null(src, start + i)) column_set_null(frame, index, i);
+        }
+    }
+}
+
+/* ---- Typing and loading ---- */
+
+/**
+ * What a cell can be stored as, narrowest first. A column takes the
+ * widest kind among its cells.
+ */
+typedef enum {
+    CELL_NULL,
+    CELL_INT,
+    CELL_DOUBLE,
+    CELL_STRING
+} CellKind;
+
+static CellKind classify_text(const char* data, size_t length, CellKind at_least) {
+    if (length == 0) return CELL_NULL;
+    int64_t i;
+    double d;
+    if (at_least <= CELL_INT && csv_parse_int(data, length, &i)) return CELL_INT;
+    if (csv_parse_number(data, length, &d)) return CELL_DOUBLE;
+    return CELL_STRING;
+}
+
+static ColumnType column_type_of(CellKind kind) {
+    switch (kind) {
+        case CELL_INT: return COLUMN_INT;
+        case CELL_STRING: return COLUMN_STRING;
+        default: return COLUMN_DOUBLE;
+    }
+}
+
+/** Stores a non-empty cell's text, which classify_text found to fit the column. */
+static void column_set_text(DataFrame* frame, int index, size_t row, const char* data, size_t length) {
+    Column* column = &frame->columns[index];
+    if (length == 0) {
+        column_set_null(frame, index, row);
+        return;
+    }
+    switch (column->type) {
+        case COLUMN_INT:
+            if (!csv_parse_int(data, length, &column->data.ints[row])) column_set_null(frame, index, row);
+            break;
+        case COLUMN_DOUBLE:
+            if (!csv_parse_number(data, length, &column->data.doubles[row])) column_set_null(frame, index, row);
+            break;
+        case COLUMN_STRING:
+            column->data.codes[row] = dict_intern(column->dict, data, length);
+            break;
+    }
+}
+
+/**
+ * A field's text with doubled quotes undone, in scratch if it had any.
+ */
+static const char* field_text(const CsvField* field, char** scratch, size_t* scratch_capacity, size_t* length) {
+    if (!field->escaped) {
+        *length = field->length;
+        return field->data;
+    }
+    if (*scratch_capacity < field->length + 1) {
+        *scratch_capacity = field->length + 1;
+        *scratch = realloc(*scratch, *scratch_capacity);
+    }
+    size_t n = 0;
+    for (size_t i = 0; i < field->length; i++) {
+        (*scratch)[n++] = field->data[i];
+        if (field->data[i] == '"' && i + 1 < field->length && field->data[i + 1] == '"') i++;
+    }
+    *length = n;
+    return *scratch;
+}
+
+static char* trimmed_copy(const char* data, size_t length) {
+    while (length > 0 && isspace((unsigned char)*data)) {
+        data++;
+        length--;
+    }
+    while (length > 0 && isspace((unsigned char)data[length - 1])) length--;
+    char* copy = malloc(length + 1);
+    memcpy(copy, data, length);
+    copy[length] = '\0';
+    return copy;
+}
+
+/* ---- Loading CSV files ---- */
+
+#define INGEST_MIN_CHUNK (8 << 20)      // bytes below which another thread costs more than it saves
+#define INGEST_MAX_THREADS 64
+
+/**
+ * @typedef @struct INGESTCHUNK
+ * The records of a mapped file that begin in [start, end), read by one thread.
+ */
+typedef struct {
+    const char* start;
+    const char* end;
+    const char* file_end;
+    char delim;
+    int column_count;
+    size_t quotes;              // '"' bytes in the range, for placing the boundaries
+    size_t rows;
+    CellKind* kinds;
+    bool* has_nulls;
+    bool aligned;               // the last record ended exactly at end
+    DataFrame* frame;
+    size_t first_row;
+    StringDict** dicts;         // this chunk's strings, per string column
+    uint32_t** remaps;          // their codes in the frame's dictionaries
+} IngestChunk;
+
+static int ingest_threads(size_t bytes, int requested) {
+    long count = requested;
+    if (count <= 0) {
+        const char* configured = getenv("JACKAL_THREADS");
+        count = configured ? strtol(configured, NULL, 10) : sysconf(_SC_NPROCESSORS_ONLN);
+        long fit = (long)(bytes / INGEST_MIN_CHUNK);
+        if (fit < count) count = fit;
+    }
+    if (count < 1) count = 1;
+    if (count > INGEST_MAX_THREADS) count = INGEST_MAX_THREADS;
+    return (int)count;
+}
+
+/** Runs work on every chunk, each on its own thread, the first on this one. */
+static void run_chunks(IngestChunk* chunks, int count, void* (*work)(void*)) {
+    if (count == 1) {
+        work(&chunks[0]);
+        return;
+    }
+    pthread_t* threads = malloc(sizeof(pthread_t) * count);
+    for (int i = 1; i < count; i++) pthread_create(&threads[i], NULL, work, &chunks[i]);
+    work(&chunks[0]);
+    for (int i = 1; i < count; i++) pthread_join(threads[i], NULL);
+    free(threads);
+}
+
+static void* chunk_count_quotes(void* arg) {
+    IngestChunk* chunk = arg;
+    size_t quotes = 0;
+    for (const char* q = chunk->start; (q = memchr(q, '"', chunk->end - q)) != NULL; q++) quotes++;
+    chunk->quotes = quotes;
+    return NULL;
+}
+
+/**
+ * Cuts [body, end) into count ranges that each start on a new record. A
+ * cut is moved forward to the next line end outside quotes, telling which
+ * line ends are inside quotes by the number of quotes before them. That
+ * count can be thrown off by stray quotes in unquoted fields, so the
+ * ranges are confirmed when they are read (see chunk_scan).
+ */
+static void split_chunks(IngestChunk* chunks, int count, const char* body, const char* end) {
+    size_t size = end - body;
+    for (int i = 0; i < count; i++) {
+        chunks[i].start = body + size / count * i;
+        chunks[i].end = i + 1 < count ? body + size / count * (i + 1) : end;
+    }
+    if (count == 1) return;
+
+    run_chunks(chunks, count, chunk_count_quotes);
+    size_t quotes = 0;
+    const char* previous = body;
+    for (int i = 1; i < count; i++) {
+        quotes += chunks[i - 1].quotes;
+        bool quoted = quotes % 2;
+        const char* cut = end;
+        for (const char* p = chunks[i].start; p < end; p++) {
+            if (*p == '"') quoted = !quoted;
+            else if (*p == '\n' && !quoted) {
+                cut = p + 1;
+                break;
+            }
+        }
+        if (cut < previous) cut = previous;
+        chunks[i - 1].end = chunks[i].start = cut;
+        previous = cut;
+    }
+    chunks[0].start = body;
+}
+
+/**
+ * First pass over a chunk: counts its records and finds what each column
+ * holds. Records are read with the rest of the file in view, so one that
+ * runs past the end of the chunk is read whole and shows the chunk started
+ * or ended inside a record.
+ */
+static void* chunk_scan(void* arg) {
+    IngestChunk* chunk = arg;
+    CsvRow row = {0};
+    const char* p = chunk->start;
+    while (p < chunk->end) {
+        p += csv_parse_row(p, chunk->file_end, chunk->delim, true, &row);
+        if (csv_row_blank(&row)) continue;
+        chunk->rows++;
+        for (int i = 0; i < chunk->column_count; i++) {
+            if (i >= row.count || row.fields[i].length == 0) {
+                chunk->has_nulls[i] = true;
+                continue;
+            }
+            if (chunk->kinds[i] == CELL_STRING) continue;
+            CellKind kind = classify_text(row.fields[i].data, row.fields[i].length, chunk->kinds[i]);
+            if (kind > chunk->kinds[i]) chunk->kinds[i] = kind;
+        }
+    }
+    chunk->aligned = p == chunk->end;
+    csv_row_free(&row);
+    return NULL;
+}
+
+/** Sets a null bit; neighbouring chunks may share the word. */
+static inline void chunk_set_null(Column* column, size_t row) {
+    __atomic_fetch_or(&column->nulls[row / 64], 1ULL << (row % 64), __ATOMIC_RELAXED);
+}
+
+/**
+ * Second pass over a chunk: fills its rows of the frame. Strings go into
+ * the chunk's own dictionaries, to be renumbered by stitch_strings.
+ */
+static void* chunk_fill(void* arg) {
+    IngestChunk* chunk = arg;
+    DataFrame* frame = chunk->frame;
+    CsvRow row = {0};
+    char* scratch = NULL;
+    size_t scratch_capacity = 0;
+    size_t r = chunk->first_row;
+
+    for (const char* p = chunk->start; p < chunk->end;) {
+        p += csv_parse_row(p, chunk->file_end, chunk->delim, true, &row);
+        if (csv_row_blank(&row)) continue;
+        for (int i = 0; i < chunk->column_count; i++) {
+            Column* column = &frame->columns[i];
+            size_t length = 0;
+            const char* text = i < row.count ? field_text(&row.fields[i], &scratch, &scratch_capacity, &length) : NULL;
+            if (length == 0) {
+                chunk_set_null(column, r);
+                continue;
+            }
+            switch (column->type) {
+                case COLUMN_INT:
+                    csv_parse_int(text, length, &column->data.ints[r]);
+                    break;
+                case COLUMN_DOUBLE:
+                    csv_parse_number(text, length, &column->data.doubles[r]);
+                    break;
+                case COLUMN_STRING:
+                    column->data.codes[r] = dict_intern(chunk->dicts[i], text, length);
+                    break;
+            }
+        }
+        r++;
+    }
+
+    free(scratch);
+    csv_row_free(&row);
+    return NULL;
+}
+
+static void* chunk_renumber(void* arg) {
+    IngestChunk* chunk = arg;
+    for (int i = 0; i < chunk->column_count; i++) {
+        const uint32_t* remap = chunk->remaps[i];
+        if (remap == NULL) continue;
+        uint32_t* codes = chunk->frame->columns[i].data.codes + chunk->first_row;
+        for (size_t r = 0; r < chunk->rows; r++) codes[r] = remap[codes[r]];
+    }
+    return NULL;
+}
+
+/**
+ * Merges the chunks' dictionaries into the frame's, in chunk order, so
+ * strings are numbered by first appearance as a single thread would.
+ */
+static void stitch_strings(DataFrame* frame, IngestChunk* chunks, int count) {
+    bool renumber = false;
+    for (int i = 0; i < frame->column_count; i++) {
+        Column* column = &frame->columns[i];
+        if (column->type != COLUMN_STRING) continue;
+        dict_free(column->dict);
+        column->dict = chunks[0].dicts[i];
+        chunks[0].dicts[i] = NULL;
+        for (int k = 1; k < count; k++) {
+            const StringDict* local = chunks[k].dicts[i];
+            if (local->count == 0) continue;
+            uint32_t* remap = malloc(sizeof(uint32_t) * local->count);
+            bool identity = true;
+            for (uint32_t code = 0; code < local->count; code++) {
+                remap[code] = dict_intern(column->dict, dict_string(local, code), local->lengths[code]);
+                identity = identity && remap[code] == code;
+            }
+            if (identity) {
+                free(remap);
+                continue;
+            }
+            chunks[k].remaps[i] = remap;
+            renumber = true;
+        }
+    }
+    if (renumber) run_chunks(chunks, count, chunk_renumber);
+}
+
+static void chunks_free(IngestChunk* chunks, int count) {
+    for (int k = 0; k < count; k++) {
+        for (int i = 0; i < chunks[k].column_count; i++) {
+            dict_free(chunks[k].dicts[i]);
+            free(chunks[k].remaps[i]);
+        }
+        free(chunks[k].kinds);
+        free(chunks[k].has_nulls);
+        free(chunks[k].dicts);
+        free(chunks[k].remaps);
+    }
+    free(chunks);
+}
+
+static IngestChunk* chunks_new(int count, const char* body, const char* end, char delim, int column_count) {
+    IngestChunk* chunks = calloc(count, sizeof(IngestChunk));
+    split_chunks(chunks, count, body, end);
+    for (int k = 0; k < count; k++) {
+        int columns = column_count ? column_count : 1;
+        chunks[k].file_end = end;
+        chunks[k].delim = delim;
+        chunks[k].column_count = column_count;
+        chunks[k].kinds = calloc(columns, sizeof(CellKind));
+        chunks[k].has_nulls = calloc(columns, sizeof(bool));
+        chunks[k].dicts = calloc(columns, sizeof(StringDict*));
+        chunks[k].remaps = calloc(columns, sizeof(uint32_t*));
+    }
+    return chunks;
+}
+
+DataFrame* frame_read_csv(const char* path, char delim, int threads) {
+    CsvMap map;
+    if (!csv_map_open(&map, path)) return NULL;
+
+    const char* p = map.data;
+    const char* end = map.data + map.size;
+    CsvRow row = {0};
+    char* scratch = NULL;
+    size_t scratch_capacity = 0;
+
+    /* The first record names the columns. */
+    int column_count = 0;
+    char** names = NULL;
+    while (p < end) {
+        p += csv_parse_row(p, end, delim, true, &row);
+        if (csv_row_blank(&row)) continue;
+        column_count = row.count;
+        names = malloc(sizeof(char*) * column_count);
+        for (int i = 0; i < column_count; i++) {
+            size_t length;
+            const char* text = field_text(&row.fields[i], &scratch, &scratch_capacity, &length);
+            names[i] = trimmed_copy(text, length);
+        }
+        break;
+    }
+    free(scratch);
+    csv_row_free(&row);
+    const char* body = p;
+
+    /*
+     * A first pass counts the records and finds what each column holds, so
+     * the second fills columns of the right type and size. Each pass runs
+     * over the chunks in parallel; if a chunk boundary turns out to fall
+     * inside a record, the file is read again as one chunk.
+     */
+    int count = ingest_threads(end - body, threads);
+    IngestChunk* chunks = chunks_new(count, body, end, delim, column_count);
+    run_chunks(chunks, count, chunk_scan);
+    for (int k = 0; k < count; k++) {
+        if (chunks[k].aligned) continue;
+        chunks_free(chunks, count);
+        count = 1;
+        chunks = chunks_new(count, body, end, delim, column_count);
+        run_chunks(chunks, count, chunk_scan);
+        break;
+    }
+
+    size_t rows = 0;
+    for (int k = 0; k < count; k++) {
+        chunks[k].first_row = rows;
+        rows += chunks[k].rows;
+    }
+    DataFrame* frame = frame_new(column_count, rows);
+    for (int i = 0; i < column_count; i++) {
+        CellKind kind = CELL_NULL;
+        bool has_nulls = false;
+        for (int k = 0; k < count; k++) {
+            if (chunks[k].kinds[i] > kind) kind = chunks[k].kinds[i];
+            has_nulls = has_nulls || chunks[k].has_nulls[i];
+        }
+        frame_column_init(frame, i, names[i], column_type_of(kind));
+        free(names[i]);
+        if (has_nulls) frame->columns[i].nulls = calloc(null_words(rows), sizeof(uint64_t));
+        if (frame->columns[i].type == COLUMN_STRING) {
+            for (int k = 0; k < count; k++) chunks[k].dicts[i] = calloc(1, sizeof(StringDict));
+        }
+    }
+    free(names);
+
+    for (int k = 0; k < count; k++) chunks[k].frame = frame;
+    run_chunks(chunks, count, chunk_fill);
+    stitch_strings(frame, chunks, count);
+
+    chunks_free(chunks, count);
+    csv_map_close(&map);
+    return frame;
+}
+
+static CellKind classify_value(Value value, CellKind at_least) {
+    switch (VALUE_TYPE(value)) {
+        case VAL_NIL:
+            return CELL_NULL;
+        case VAL_NUMBER: {
+            double d = AS_NUMBER(value);
+            if (at_least <= CELL_INT && d == floor(d) && fabs(d) < 1e18) return CELL_INT;
+            return CELL_DOUBLE;
+        }
+        case VAL_STRING:
+            return classify_text(AS_STRING(value), strlen(AS_STRING(value)), at_least);
+        default:
+            return CELL_STRING;
+    }
+}
+
+static void column_set_value(DataFrame* frame, int index, size_t row, Value value) {
+    Column* column = &frame->columns[index];
+    if (VALUE_TYPE(value) == VAL_NIL) {
+        column_set_null(frame, index, row);
+    } else if (VALUE_TYPE(value) == VAL_STRING) {
+        column_set_text(frame, index, row, AS_STRING(value), strlen(AS_STRING(value)));
+    } else if (VALUE_TYPE(value) == VAL_NUMBER && column->type == COLUMN_INT) {
+        column->data.ints[row] = (int64_t)AS_NUMBER(value);
+    } else if (VALUE_TYPE(value) == VAL_NUMBER && column->type == COLUMN_DOUBLE) {
+        column->data.doubles[row] = AS_NUMBER(value);
+    } else {
+        char* text = value_to_string(value);
+        column_set_text(frame, index, row, text, strlen(text));
+        free(text);
+    }
+}
+
+DataFrame* frame_from_rows(ValueArray* matrix) {
+    ValueArray* header = matrix->count > 0 && VALUE_TYPE(matrix->values[0]) == VAL_ARRAY ? AS_ARRAY(matrix->values[0]) : NULL;
+    int column_count = header ? header->count : 0;
+    size_t rows = matrix->count > 0 ? matrix->count - 1 : 0;
+
+    CellKind* kinds = calloc(column_count ? column_count : 1, sizeof(CellKind));
+    for (size_t r = 0; r < rows; r++) {
+        Value row = matrix->values[r + 1];
+        if (VALUE_TYPE(row) != VAL_ARRAY) continue;
+        int n = AS_ARRAY(row)->count < column_count ? AS_ARRAY(row)->count : column_count;
+        for (int i = 0; i < n; i++) {
+            if (kinds[i] == CELL_STRING) continue;
+            CellKind kind = classify_value(AS_ARRAY(row)->values[i], kinds[i]);
+            if (kind > kinds[i]) kinds[i] = kind;
+        }
+    }
+
+    DataFrame* frame = frame_new(column_count, rows);
+    for (int i = 0; i < column_count; i++) {
+        Value name = header->values[i];
+        char* text = VALUE_TYPE(name) == VAL_STRING ? NULL : value_to_string(name);
+        char* trimmed = text ? trimmed_copy(text, strlen(text)) : trimmed_copy(AS_STRING(name), strlen(AS_STRING(name)));
+        frame_column_init(frame, i, trimmed, column_type_of(kinds[i]));
+        free(trimmed);
+        free(text);
+    }
+    free(kinds);
+
+    for (size_t r = 0; r < rows; r++) {
+        Value row = matrix->values[r + 1];
+        int n = VALUE_TYPE(row) == VAL_ARRAY ? AS_ARRAY(row)->count : 0;
+        for (int i = 0; i < column_count; i++) {
+            if (i < n) column_set_value(frame, i, r, AS_ARRAY(row)->values[i]);
+            else column_set_null(frame, i, r);
+        }
+    }
+    return frame;
+}
+
+ValueArray* frame_to_rows(const DataFrame* frame, bool as_text) {
+    ValueArray* matrix = array_new();
+    Value** strings = calloc(frame->column_count ? frame->column_count : 1, sizeof(Value*));
+    gc_pause();     // every row made is kept
+
+    ValueArray* header = array_new();
+    for (int i = 0; i < frame->column_count; i++) {
+        const Column* column = &frame->columns[i];
+        array_append(header, string_new(column->name, strlen(column->name)));
+        if (column->type == COLUMN_STRING) strings[i] = calloc(column->dict->count ? column->dict->count : 1, sizeof(Value));
+    }
+    array_append(matrix, ARRAY_VAL(header));
+
+    for (size_t r = 0; r < frame->rows; r++) {
+        ValueArray* row = array_new();
+        for (int i = 0; i < frame->column_count; i++) {
+            array_append(row, as_text ? frame_cell_text(frame, i, r, strings[i]) : frame_cell_shared(frame, i, r, strings[i]));
+        }
+        array_append(matrix, ARRAY_VAL(row));
+    }
+
+    gc_resume();
+    for (int i = 0; i < frame->column_count; i++) free(strings[i]);
+    free(strings);
+    return matrix;
+}
+
+bool frame_write_csv(const DataFrame* frame, const char* path) {
+    CsvOut out;
+    if (!csv_out_open(&out, path, ',', false)) return false;
+
+    for (int i = 0; i < frame->column_count; i++) {
+        if (i > 0) csv_out_delim(&out);
+        csv_out_field(&out, frame->columns[i].name, strlen(frame->columns[i].name));
+    }
+    csv_out_end_row(&out);
+
+    for (size_t r = 0; r < frame->rows; r++) {
+        for (int i = 0; i < frame->column_count; i++) {
+            const Column* column = &frame->columns[i];
+            if (i > 0) csv_out_delim(&out);
+            if (column_is_null(column, r)) continue;
+            switch (column->type) {
+                case COLUMN_DOUBLE: csv_out_double(&out, column->data.doubles[r]); break;
+                case COLUMN_INT: csv_out_int(&out, column->data.ints[r]); break;
+                case COLUMN_STRING: {
+                    uint32_t code = column->data.codes[r];
+                    csv_out_field(&out, dict_string(column->dict, code), column->dict->lengths[code]);
+                    break;
+                }
+            }
+        }
+        csv_out_end_row(&out);
+    }
+    return csv_out_close(&out);
+}
+
+/** One column as an array of cells. */
+static ValueArray* frame_column_values(const DataFrame* frame, int index) {
+    const Column* column = &frame->columns[index];
+    Value* strings = column->type == COLUMN_STRING ? calloc(column->dict->count ? column->dict->count : 1, sizeof(Value)) : NULL;
+    ValueArray* values = array_new();
+    if (frame->rows > (size_t)values->capacity) {
+        values->values = realloc(values->values, sizeof(Value) * frame->rows);
+        values->capacity = (int)frame->rows;
+    }
+    for (size_t r = 0; r < frame->rows; r++) values->values[values->count++] = frame_cell_shared(frame, index, r, strings);
+    free(strings);
+    return values;
+}
+
+/* ---- Reshaping ---- */
+
+DataFrame* frame_select(const DataFrame* frame, ValueArray* names) {
+    int* indices = malloc(sizeof(int) * (names->count ? names->count : 1));
+    int count = 0;
+    for (int i = 0; i < names->count; i++) {
+        if (VALUE_TYPE(names->values[i]) != VAL_STRING) continue;
+        int index = frame_column_index(frame, AS_STRING(names->values[i]));
+        if (index >= 0) indices[count++] = index;
+    }
+
+    DataFrame* selected = frame_new(count, frame->rows);
+    for (int i = 0; i < count; i++) column_copy_range(selected, i, &frame->columns[indices[i]], 0, frame->rows);
+    free(indices);
+    return selected;
+}
+
+DataFrame* frame_slice(const DataFrame* frame, size_t start, size_t count) {
+    if (start > frame->rows) start = frame->rows;
+    if (count > frame->rows - start) count = frame->rows - start;
+    DataFrame* slice = frame_new(frame->column_count, count);
+    for (int i = 0; i < frame->column_count; i++) column_copy_range(slice, i, &frame->columns[i], start, count);
+    return slice;
+}
+
+void frame_permute(DataFrame* frame, const size_t* order) {
+    size_t rows = frame->rows;
+    for (int i = 0; i < frame->column_count; i++) {
+        Column* column = &frame->columns[i];
+        switch (column->type) {
+            case COLUMN_DOUBLE: {
+                double* data = malloc(sizeof(double) * (rows ? rows : 1));
+                for (size_t r = 0; r < rows; r++) data[r] = column->data.doubles[order[r]];
+                free(column->data.doubles);
+                column->data.doubles = data;
+                break;
+            }
+            case COLUMN_INT: {
+                int64_t* data = malloc(sizeof(int64_t) * (rows ? rows : 1));
+                for (size_t r = 0; r < rows; r++) data[r] = column->data.ints[order[r]];
+                free(column->data.ints);
+                column->data.ints = data;
+                break;
+            }
+            case COLUMN_STRING: {
+                uint32_t* data = malloc(sizeof(uint32_t) * (rows ? rows : 1));
+                for (size_t r = 0; r < rows; r++) data[r] = column->data.codes[order[r]];
+                free(column->data.codes);
+                column->data.codes = data;
+                break;
+            }
+        }
+        if (column->nulls) {
+            uint64_t* nulls = calloc(null_words(rows), sizeof(uint64_t));
+            for (size_t r = 0; r < rows; r++) {
+                if (column_is_null(column, order[r])) nulls[r / 64] |= 1ULL << (r % 64);
+            }
+            free(column->nulls);
+            column->nulls = nulls;
+        }
+    }
+}
+
+/* ---- Sorting ---- */
+
+/** A row's sort key; the row number breaks ties so the sort is stable. */
+typedef struct {
+    union {
+        double d;
+        int64_t i;
+    } key;
+    size_t row;
+} SortKey;
+
+static int compare_double_asc(const void* a, const void* b) {
+    const SortKey* x = a;
+    const SortKey* y = b;
+    if (x->key.d != y->key.d) return x->key.d < y->key.d ? -1 : 1;
+    return x->row < y->row ? -1 : x->row > y->row;
+}
+
+static int compare_double_desc(const void* a, const void* b) {
+    const SortKey* x = a;
+    const SortKey* y = b;
+    if (x->key.d != y->key.d) return x->key.d > y->key.d ? -1 : 1;
+    return x->row < y->row ? -1 : x->row > y->row;
+}
+
+static int compare_int_asc(const void* a, const void* b) {
+    const SortKey* x = a;
+    const SortKey* y = b;
+    if (x->key.i != y->key.i) return x->key.i < y->key.i ? -1 : 1;
+    return x->row < y->row ? -1 : x->row > y->row;
+}
+
+static int compare_int_desc(const void* a, const void* b) {
+    const SortKey* x = a;
+    const SortKey* y = b;
+    if (x->key.i != y->key.i) return x->key.i > y->key.i ? -1 : 1;
+    return x->row < y->row ? -1 : x->row > y->row;
+}
+
+typedef struct {
+    const char* chars;
+    uint32_t code;
+} DictEntry;
+
+static int compare_dict_entries(const void* a, const void* b) {
+    return strcmp(((const DictEntry*)a)->chars, ((const DictEntry*)b)->chars);
+}
+
+/** The position of each string of dict in sorted order, by code. */
+static int64_t* dict_ranks(const StringDict* dict) {
+    DictEntry* entries = malloc(sizeof(DictEntry) * (dict->count ? dict->count : 1));
+    for (uint32_t code = 0; code < dict->count; code++) entries[code] = (DictEntry){dict_string(dict, code), code};
+    qsort(entries, dict->count, sizeof(DictEntry), compare_dict_entries);
+    int64_t* ranks = malloc(sizeof(int64_t) * (dict->count ? dict->count : 1));
+    for (uint32_t i = 0; i < dict->count; i++) ranks[entries[i].code] = i;
+    free(entries);
+    return ranks;
+}
+
+bool frame_sort(DataFrame* frame, const char* name, bool ascending) {
+    int index = frame_column_index(frame, name);
+    if (index < 0) return false;
+    const Column* column = &frame->columns[index];
+    size_t rows = frame->rows;
+
+    SortKey* keys = malloc(sizeof(SortKey) * (rows ? rows : 1));
+    size_t* order = malloc(sizeof(size_t) * (rows ? rows : 1));
+    int64_t* ranks = column->type == COLUMN_STRING ? dict_ranks(column->dict) : NULL;
+
+    size_t count = 0, nulls = 0;
+    for (size_t r = 0; r < rows; r++) {
+        if (column_is_null(column, r)) {
+            order[rows - 1 - nulls++] = r;      // nulls fill the end, reversed for now
+            continue;
+        }
+        SortKey* key = &keys[count++];
+        key->row = r;
+        switch (column->type) {
+            case COLUMN_DOUBLE: key->key.d = column->data.doubles[r]; break;
+            case COLUMN_INT: key->key.i = column->data.ints[r]; break;
+            case COLUMN_STRING: key->key.i = ranks[column->data.codes[r]]; break;
+        }
+    }
+
+    if (column->type == COLUMN_DOUBLE) qsort(keys, count, sizeof(SortKey), ascending ? compare_double_asc : compare_double_desc);
+    else qsort(keys, count, sizeof(SortKey), ascending ? compare_int_asc : compare_int_desc);
+
+    for (size_t i = 0; i < count; i++) order[i] = keys[i].row;
+    for (size_t i = 0; i < nulls / 2; i++) {
+        size_t t = order[count + i];
+        order[count + i] = order[rows - 1 - i];
+        order[rows - 1 - i] = t;
+    }
+    frame_permute(frame, order);
+
+    free(ranks);
+    free(order);
+    free(keys);
+    return true;
+}
+
+/* ---- Aggregates ---- */
+
+typedef enum {
+    AGG_SUM,
+    AGG_AVG,
+    AGG_MIN,
+    AGG_MAX,
+    AGG_COUNT
+} AggregateOp;
+
+static bool parse_aggregate(const char* op, AggregateOp* out) {
+    static const char* names[] = {"sum", "avg", "min", "max", "count"};
+    for (int i = 0; i < 5; i++) {
+        if (strcmp(op, names[i]) == 0) {
+            *out = (AggregateOp)i;
+            return true;
+        }
+    }
+    return false;
+}
+
+typedef struct {
+    double sum;
+    double min;
+    double max;
+    size_t count;
+} Totals;
+
+#define TOTALS_INIT ((Totals){0, INFINITY, -INFINITY, 0})
+
+/* Four independent lanes, so the loop has no chain of dependent adds and the compiler can keep them in vector registers. */
+static void totals_add_doubles(Totals* t, const double* v, size_t n) {
+    double s[4] = {0, 0, 0, 0};
+    double lo[4] = {t->min, t->min, t->min, t->min};
+    double hi[4] = {t->max, t->max, t->max, t->max};
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        for (int k = 0; k < 4; k++) {
+            double x = v[i + k];
+            s[k] += x;
+            lo[k] = x < lo[k] ? x : lo[k];
+            hi[k] = x > hi[k] ? x : hi[k];
+        }
+    }
+    for (; i < n; i++) {
+        s[0] += v[i];
+        lo[0] = v[i] < lo[0] ? v[i] : lo[0];
+        hi[0] = v[i] > hi[0] ? v[i] : hi[0];
+    }
+    t->sum += (s[0] + s[1]) + (s[2] + s[3]);
+    for (int k = 0; k < 4; k++) {
+        if (lo[k] < t->min) t->min = lo[k];
+        if (hi[k] > t->max) t->max = hi[k];
+    }
+    t->count += n;
+}
+
+static void totals_add_ints(Totals* t, const int64_t* v, size_t n) {
+    int64_t s[4] = {0, 0, 0, 0};
+    int64_t lo = INT64_MAX, hi = INT64_MIN;
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        for (int k = 0; k < 4; k++) s[k] += v[i + k];
+    }
+    for (; i < n; i++) s[0] += v[i];
+    for (i = 0; i < n; i++) {
+        lo = v[i] < lo ? v[i] : lo;
+        hi = v[i] > hi ? v[i] : hi;
+    }
+    t->sum += (double)((s[0] + s[1]) + (s[2] + s[3]));
+    if (n > 0 && lo < t->min) t->min = (double)lo;
+    if (n > 0 && hi > t->max) t->max = (double)hi;
+    t->count += n;
+}
+
+/** Totals of the non-null cells of a numeric column, a block of 64 rows at a time. */
+static void column_totals(const Column* column, size_t rows, Totals* t) {
+    if (column->nulls == NULL) {
+        if (column->type == COLUMN_DOUBLE) totals_add_doubles(t, column->data.doubles, rows);
+        else totals_add_ints(t, column->data.ints, rows);
+        return;
+    }
+    for (size_t start = 0; start < rows; start += 64) {
+        size_t n = rows - start < 64 ? rows - start : 64;
+        uint64_t nulls = column->nulls[start / 64];
+        if (nulls == 0) {
+            if (column->type == COLUMN_DOUBLE) totals_add_doubles(t, column->data.doubles + start, n);
+            else totals_add_ints(t, column->data.ints + start, n);
+            continue;
+        }
+        for (size_t k = 0; k < n; k++) {
+            if (nulls >> k & 1) continue;
+            if (column->type == COLUMN_DOUBLE) totals_add_doubles(t, column->data.doubles + start + k, 1);
+            else totals_add_ints(t, column->data.ints + start + k, 1);
+        }
+    }
+}
+
+/** The aggregate's value, or false if it has none (no cells to take a mean, min or max of). */
+static bool totals_result(const Totals* t, AggregateOp op, double* out) {
+    switch (op) {
+        case AGG_SUM: *out = t->sum; return true;
+        case AGG_COUNT: *out = (double)t->count; return true;
+        case AGG_AVG: *out = t->count ? t->sum / t->count : 0; return t->count > 0;
+        case AGG_MIN: *out = t->min; return t->count > 0;
+        case AGG_MAX: *out = t->max; return t->count > 0;
+    }
+    return false;
+}
+
+static size_t non_null_count(const Column* column, size_t rows) {
+    if (column->nulls == NULL) return rows;
+    size_t nulls = 0;
+    for (size_t w = 0; w < null_words(rows); w++) nulls += __builtin_popcountll(column->nulls[w]);
+    return rows - nulls;
+}
+
+bool frame_aggregate(const DataFrame* frame, const char* name, const char* op_name, double* out) {
+    AggregateOp op;
+    int index = frame_column_index(frame, name);
+    if (index < 0 || !parse_aggregate(op_name, &op)) return false;
+    const Column* column = &frame->columns[index];
+
+    if (op == AGG_COUNT) {
+        *out = (double)non_null_count(column, frame->rows);
+        return true;
+    }
+    if (column->type == COLUMN_STRING) return false;
+
+    Totals t = TOTALS_INIT;
+    column_totals(column, frame->rows, &t);
+    if (!totals_result(&t, op, out)) *out = 0;
+    return true;
+}
+
+/* ---- Group-by ---- */
+
+#define NO_GROUP UINT32_MAX
+
+/**
+ * @typedef @struct GROUPINDEX
+ * Numeric keys to group numbers, open addressing on the key's bits.
+ */
+typedef struct {
+    uint64_t* keys;
+    uint32_t* groups;           // NO_GROUP marks an empty slot
+    size_t capacity;
+    size_t count;
+} GroupIndex;
+
+static uint64_t hash_key(uint64_t x) {
+    x ^= x >> 33;
+    x *= 0xff51afd7ed558ccdULL;
+    x ^= x >> 33;
+    return x;
+}
+
+static void group_index_init(GroupIndex* index, size_t capacity) {
+    index->capacity = capacity;
+    index->count = 0;
+    index->keys = malloc(sizeof(uint64_t) * capacity);
+    index->groups = malloc(sizeof(uint32_t) * capacity);
+    memset(index->groups, 0xff, sizeof(uint32_t) * capacity);
+}
+
+/** The group of key, made next_group if it has none yet. */
+static uint32_t group_index_find(GroupIndex* index, uint64_t key, uint32_t next_group) {
+    if ((index->count + 1) * 2 > index->capacity) {
+        GroupIndex grown;
+        group_index_init(&grown, index->capacity * 2);
+        for (size_t i = 0; i < index->capacity; i++) {
+            if (index->groups[i] != NO_GROUP) group_index_find(&grown, index->keys[i], index->groups[i]);
+        }
+        free(index->keys);
+        free(index->groups);
+        *index = grown;
+    }
+    size_t mask = index->capacity - 1;
+    for (size_t i = hash_key(key) & mask;; i = (i + 1) & mask) {
+        if (index->groups[i] == NO_GROUP) {
+            index->keys[i] = key;
+            index->groups[i] = next_group;
+            index->count++;
+            return next_group;
+        }
+        if (index->keys[i] == key) return index->groups[i];
+    }
+}
+
+/** The bits a numeric key is grouped on; equal numbers give equal bits. */
+static uint64_t key_bits(const Column* column, size_t row) {
+    if (column->type == COLUMN_INT) return (uint64_t)column->data.ints[row];
+    double d = column->data.doubles[row];
+    if (d == 0) d = 0;      // -0.0 groups with 0.0
+    uint64_t bits;
+    memcpy(&bits, &d, sizeof(bits));
+    return bits;
+}
+
+DataFrame* frame_group_by(const DataFrame* frame, const char* key_name, const char* target_name, const char* op_name) {
+    AggregateOp op;
+    int key_index = frame_column_index(frame, key_name);
+    int target_index = frame_column_index(frame, target_name);
+    if (key_index < 0 || target_index < 0 || !parse_aggregate(op_name, &op)) return NULL;
+    const Column* key = &frame->columns[key_index];
+    const Column* target = &frame->columns[target_index];
+    if (target->type == COLUMN_STRING && op != AGG_COUNT) return NULL;
+
+    size_t rows = frame->rows;
+    uint32_t* groups = malloc(sizeof(uint32_t) * (rows ? rows : 1));
+    size_t* first_rows = NULL;      // the first row of each group, for its key
+    uint32_t group_count = 0, capacity = 0;
+    uint32_t null_group = NO_GROUP;
+
+    uint32_t* by_code = NULL;
+    GroupIndex index = {0};
+    if (key->type == COLUMN_STRING) {
+        by_code = malloc(sizeof(uint32_t) * (key->dict->count ? key->dict->count : 1));
+        memset(by_code, 0xff, sizeof(uint32_t) * key->dict->count);
+    } else {
+        group_index_init(&index, 64);
+    }
+
+    for (size_t r = 0; r < rows; r++) {
+        uint32_t g;
+        if (column_is_null(key, r)) {
+            if (null_group == NO_GROUP) null_group = group_count;
+            g = null_group;
+        } else if (by_code) {
+            uint32_t* slot = &by_code[key->data.codes[r]];
+            if (*slot == NO_GROUP) *slot = group_count;
+            g = *slot;
+        } else {
+            g = group_index_find(&index, key_bits(key, r), group_count);
+        }
+        if (g == group_count) {
+            if (group_count == capacity) {
+                capacity = capacity ? capacity * 2 : 64;
+                first_rows = realloc(first_rows, sizeof(size_t) * capacity);
+            }
+            first_rows[group_count++] = r;
+        }
+        groups[r] = g;
+    }
+    free(by_code);
+    free(index.keys);
+    free(index.groups);
+
+    Totals* totals = malloc(sizeof(Totals) * (group_count ? group_count : 1));
+    for (uint32_t g = 0; g < group_count; g++) totals[g] = TOTALS_INIT;
+    for (size_t r = 0; r < rows; r++) {
+        if (column_is_null(target, r)) continue;
+        Totals* t = &totals[groups[r]];
+        double x = target->type == COLUMN_DOUBLE ? target->data.doubles[r]
+                 : target->type == COLUMN_INT ? (double)target->data.ints[r] : 0;
+        t->sum += x;
+        if (x < t->min) t->min = x;
+        if (x > t->max) t->max = x;
+        t->count++;
+    }
+
+    DataFrame* result = frame_new(2, group_count);
+    frame_column_init(result, 0, key->name, key->type);
+    frame_column_init(result, 1, "result", COLUMN_DOUBLE);
+    Column* keys = &result->columns[0];
+    Column* values = &result->columns[1];
+    for (uint32_t g = 0; g < group_count; g++) {
+        size_t r = first_rows[g];
+        if (g == null_group) {
+            column_set_null(result, 0, g);
+        } else {
+            switch (key->type) {
+                case COLUMN_DOUBLE: keys->data.doubles[g] = key->data.doubles[r]; break;
+                case COLUMN_INT: keys->data.ints[g] = key->data.ints[r]; break;
+                case COLUMN_STRING: {
+                    uint32_t code = key->data.codes[r];
+                    keys->data.codes[g] = dict_intern(keys->dict, dict_string(key->dict, code), key->dict->lengths[code]);
+                    break;
+                }
+            }
+        }
+        if (!totals_result(&totals[g], op, &values->data.doubles[g])) column_set_null(result, 1, g);
+    }
+
+    free(totals);
+    free(first_rows);
+    free(groups);
+    return result;
+}
+
+/* ---- Features ---- */
+
+bool features_from_value(Value data, FeatureMatrix* out) {
+    memset(out, 0, sizeof(*out));
+
+    if (VALUE_TYPE(data) == VAL_DATAFRAME) {
+        const DataFrame* frame = AS_DATAFRAME(data);
+        size_t rows = frame->rows;
+        int cols = 0, converted = 0;
+        for (int i = 0; i < frame->column_count; i++) {
+            const Column* column = &frame->columns[i];
+            if (column->type == COLUMN_STRING) continue;
+            cols++;
+            if (column->type == COLUMN_INT || column->nulls) converted++;
+        }
+        out->rows = (int)rows;
+        out->cols = cols;
+        out->columns = malloc(sizeof(double*) * (cols ? cols : 1));
+        out->owned = converted ? malloc(sizeof(double) * rows * converted) : NULL;
+
+        double* next = out->owned;
+        int j = 0;
+        for (int i = 0; i < frame->column_count; i++) {
+            const Column* column = &frame->columns[i];
+            if (column->type == COLUMN_STRING) continue;
+            if (column->type == COLUMN_DOUBLE && column->nulls == NULL) {
+                out->columns[j++] = column->data.doubles;      // read in place
+                continue;
+            }
+            for (size_t r = 0; r < rows; r++) {
+                if (column_is_null(column, r)) next[r] = 0;
+                else next[r] = column->type == COLUMN_INT ? (double)column->data.ints[r] : column->data.doubles[r];
+            }
+            out->columns[j++] = next;
+            next += rows;
+        }
+        return true;
+    }
+
+    if (VALUE_TYPE(data) == VAL_ARRAY) {
+        ValueArray* matrix = AS_ARRAY(data);
+        int rows = matrix->count;
+        int cols = rows > 0 && VALUE_TYPE(matrix->values[0]) == VAL_ARRAY ? AS_ARRAY(matrix->values[0])->count : 0;
+        out->rows = rows;
+        out->cols = cols;
+        out->columns = malloc(sizeof(double*) * (cols ? cols : 1));
+        size_t cells = (size_t)rows * cols;
+        out->owned = malloc(sizeof(double) * (cells ? cells : 1));
+        for (int j = 0; j < cols; j++) out->columns[j] = out->owned + (size_t)j * rows;
+        for (int r = 0; r < rows; r++) {
+            ValueArray* row = VALUE_TYPE(matrix->values[r]) == VAL_ARRAY ? AS_ARRAY(matrix->values[r]) : NULL;
+            for (int j = 0; j < cols; j++) {
+                Value cell = row && j < row->count ? row->values[j] : NIL_VAL;
+                out->owned[(size_t)j * rows + r] = VALUE_TYPE(cell) == VAL_NUMBER ? AS_NUMBER(cell) : 0;
+            }
+        }
+        return true;
+    }
+    return false;
+}
+
+void features_free(FeatureMatrix* features) {
+    free(features->columns);
+    free(features->owned);
+    features->columns = NULL;
+    features->owned = NULL;
+}
+
+/* ---- Natives ---- */
+
+/**
+ * Native '__frame_read': loads a CSV file as a DataFrame.
+ * @param args[0] Path.
+ * @param args[1] Delimiter (optional, ",").
+ * @param args[2] Threads to read with (optional; 0 picks by size and cores).
+ */
+Value native_frame_read(int arity, Value* args) {
+    if (arity < 1 || VALUE_TYPE(args[0]) != VAL_STRING) {
+        print_error("frame_read expects at least 1 argument (path)");
+        return NIL_VAL;
+    }
+    char delim = arity > 1 && VALUE_TYPE(args[1]) == VAL_STRING && AS_STRING(args[1])[0] ? AS_STRING(args[1])[0] : ',';
+    int threads = arity > 2 && VALUE_TYPE(args[2]) == VAL_NUMBER ? (int)AS_NUMBER(args[2]) : 0;
+    DataFrame* frame = frame_read_csv(AS_STRING(args[0]), delim, threads);
+    if (frame == NULL) {
+        print_error("Could not open file: %s", AS_STRING(args[0]));
+        return NIL_VAL;
+    }
+    return DATAFRAME_VAL(frame);
+}
+
+/**
+ * Native '__frame_from': builds a DataFrame from rows, the first naming the columns.
+ */
+Value native_frame_from(int arity, Value* args) {
+    if (arity < 1) return NIL_VAL;
+    if (VALUE_TYPE(args[0]) == VAL_DATAFRAME) return args[0];
+    if (VALUE_TYPE(args[0]) != VAL_ARRAY) {
+        print_error("frame_from expects an Array of rows");
+        return NIL_VAL;
+    }
+    return DATAFRAME_VAL(frame_from_rows(AS_ARRAY(args[0])));
+}
+
+/**
+ * Native '__frame_rows': a DataFrame as an array of rows, the column names
+ * first. With a true second argument every cell is a string, as Csv.get()
+ * returned them before frames.
+ */
+Value native_frame_rows(int arity, Value* args) {
+    if (arity < 1 || VALUE_TYPE(args[0]) != VAL_DATAFRAME) return arity > 0 ? args[0] : NIL_VAL;
+    bool as_text = arity > 1 && is_value_truthy(args[1]);
+    return ARRAY_VAL(frame_to_rows(AS_DATAFRAME(args[0]), as_text));
+}
+
+static Value frame_method_rows(Env* env, Value receiver, int arg_count, Value* args) {
+    return NUMBER_VAL((double)AS_DATAFRAME(receiver)->rows);
+}
+
+static Value frame_method_columns(Env* env, Value receiver, int arg_count, Value* args) {
+    const DataFrame* frame = AS_DATAFRAME(receiver);
+    ValueArray* names = array_new();
+    for (int i = 0; i < frame->column_count; i++) {
+        array_append(names, string_new(frame->columns[i].name, strlen(frame->columns[i].name)));
+    }
+    return ARRAY_VAL(names);
+}
+
+static Value frame_method_column(Env* env, Value receiver, int arg_count, Value* args) {
+    if (arg_count < 1 || VALUE_TYPE(args[0]) != VAL_STRING) {
+        print_error("Error: column() expects a column name.");
+        return NIL_VAL;
+    }
+    int index = frame_column_index(AS_DATAFRAME(receiver), AS_STRING(args[0]));
+    if (index < 0) return NIL_VAL;
+    return ARRAY_VAL(frame_column_values(AS_DATAFRAME(receiver), index));
+}
+
+static Value frame_method_row(Env* env, Value receiver, int arg_count, Value* args) {
+    const DataFrame* frame = AS_DATAFRAME(receiver);
+    if (arg_count < 1 || VALUE_TYPE(args[0]) != VAL_NUMBER || AS_NUMBER(args[0]) < 0 || AS_NUMBER(args[0]) >= frame->rows) {
+        return NIL_VAL;
+    }
+    size_t r = (size_t)AS_NUMBER(args[0]);
+    ValueArray* row = array_new();
+    for (int i = 0; i < frame->column_count; i++) array_append(row, frame_cell(frame, i, r));
+    return ARRAY_VAL(row);
+}
+
+static Value frame_method_select(Env* env, Value receiver, int arg_count, Value* args) {
+    if (arg_count < 1 || VALUE_TYPE(args[0]) != VAL_ARRAY) {
+        print_error("Error: select() expects an Array of column names.");
+        return NIL_VAL;
+    }
+    return DATAFRAME_VAL(frame_select(AS_DATAFRAME(receiver), AS_ARRAY(args[0])));
+}
+
+static Value frame_method_sort(Env* env, Value receiver, int arg_count, Value* args) {
+    if (arg_count < 1 || VALUE_TYPE(args[0]) != VAL_STRING) {
+        print_error("Error: sort() expects a column name.");
+        return NIL_VAL;
+    }
+    bool ascending = arg_count < 2 || VALUE_TYPE(args[1]) != VAL_STRING || strcmp(AS_STRING(args[1]), "desc") != 0;
+    frame_sort(AS_DATAFRAME(receiver), AS_STRING(args[0]), ascending);
+    return receiver;
+}
+
+static Value frame_method_group_by(Env* env, Value receiver, int arg_count, Value* args) {
+    if (arg_count < 3 || VALUE_TYPE(args[0]) != VAL_STRING || VALUE_TYPE(args[1]) != VAL_STRING || VALUE_TYPE(args[2]) != VAL_STRING) {
+        print_error("Error: groupBy() expects (String group_col, String target_col, String op).");
+        return NIL_VAL;
+    }
+    DataFrame* grouped = frame_group_by(AS_DATAFRAME(receiver), AS_STRING(args[0]), AS_STRING(args[1]), AS_STRING(args[2]));
+    if (grouped == NULL) {
+        print_error("GroupBy Error: Column not found.");
+        return NIL_VAL;
+    }
+    return DATAFRAME_VAL(grouped);
+}
+
+static Value frame_method_aggregate(Env* env, Value receiver, int arg_count, Value* args) {
+    if (arg_count < 2 || VALUE_TYPE(args[0]) != VAL_STRING || VALUE_TYPE(args[1]) != VAL_STRING) {
+        print_error("Error: aggregate() expects (String column, String op).");
+        return NIL_VAL;
+    }
+    double result;
+    if (!frame_aggregate(AS_DATAFRAME(receiver), AS_STRING(args[0]), AS_STRING(args[1]), &result)) return NIL_VAL;
+    return NUMBER_VAL(result);
+}
+
+static Value frame_method_head(Env* env, Value receiver, int arg_count, Value* args) {
+    size_t n = arg_count > 0 && VALUE_TYPE(args[0]) == VAL_NUMBER && AS_NUMBER(args[0]) > 0 ? (size_t)AS_NUMBER(args[0]) : 0;
+    if (arg_count == 0) n = 10;
+    return DATAFRAME_VAL(frame_slice(AS_DATAFRAME(receiver), 0, n));
+}
+
+static Value frame_method_to_array(Env* env, Value receiver, int arg_count, Value* args) {
+    return ARRAY_VAL(frame_to_rows(AS_DATAFRAME(receiver), false));
+}
+
+void register_dataframe_natives(Env* env) {
+    set_var(env, "__frame_read", NATIVE_VAL(native_frame_read), true, "");
+    set_var(env, "__frame_from", NATIVE_VAL(native_frame_from), true, "");
+    set_var(env, "__frame_rows", NATIVE_VAL(native_frame_rows), true, "");
+
+    register_method(VAL_DATAFRAME, "rows", frame_method_rows);
+    register_method(VAL_DATAFRAME, "columns", frame_method_columns);
+    register_method(VAL_DATAFRAME, "column", frame_method_column);
+    register_method(VAL_DATAFRAME, "row", frame_method_row);
+    register_method(VAL_DATAFRAME, "select", frame_method_select);
+    register_method(VAL_DATAFRAME, "sort", frame_method_sort);
+    register_method(VAL_DATAFRAME, "groupBy", frame_method_group_by);
+    register_method(VAL_DATAFRAME, "aggregate", frame_method_aggregate);
+    register_method(VAL_DATAFRAME, "head", frame_method_head);
+    register_method(VAL_DATAFRAME, "toArray", frame_method_to_array);
+}
@@ -1,4 +1,8 @@
 #include "csv/native_csv.h"
+#include "csv/csv_reader.h"
+#include "csv/dataframe.h"
+#include "csv/csv_stream.h"
+#include "string_object.h"
 
 #include <stdlib.h>
 #include <string.h>
@@ -11,8 +15,6 @@ static int sort_col_idx = 0;
 static bool sort_asc = true;
 
 typedef struct {
-    char* key;
-    double value;
     double total_value;
     int count;
 } GroupEntry;
@@ -22,7 +24,7 @@ typedef struct {
     {                                                                            \
         if (func != NULL)                                                        \
         {                                                                        \
-            set_var(env, name, (Value){VAL_NATIVE, {.native = func}}, true, ""); \
+            set_var(env, name, NATIVE_VAL(func), true, ""); \
         }                                                                        \
         else                                                                     \
         {                                                                        \
@@ -42,8 +44,8 @@ char* trim_whitespace(char* str) {
 
 int get_column_index(ValueArray *header, const char *col_name) {
     for (int i = 0; i < header->count; i++) {
-        if (header->values[i].type == VAL_STRING && 
-            strcmp(header->values[i].as.string, col_name) == 0) {
+        if (VALUE_TYPE(header->values[i]) == VAL_STRING && 
+            strcmp(AS_STRING(header->values[i]), col_name) == 0) {
             return i;
         }
     }
@@ -51,11 +53,11 @@ int get_column_index(ValueArray *header, const char *col_name) {
 }
 
 static int compare_rows(const void *a, const void *b) {
-    Value val_a = ((Value*)a)->as.array->values[sort_col_idx];
-    Value val_b = ((Value*)b)->as.array->values[sort_col_idx];
+    Value val_a = AS_ARRAY(*((Value*)a))->values[sort_col_idx];
+    Value val_b = AS_ARRAY(*((Value*)b))->values[sort_col_idx];
 
-    double num_a = (val_a.type == VAL_NUMBER) ? val_a.as.number : (val_a.type == VAL_STRING ? atof(val_a.as.string) : 0);
-    double num_b = (val_b.type == VAL_NUMBER) ? val_b.as.number : (val_b.type == VAL_STRING ? atof(val_b.as.string) : 0);
+    double num_a = (VALUE_TYPE(val_a) == VAL_NUMBER) ? AS_NUMBER(val_a) : (VALUE_TYPE(val_a) == VAL_STRING ? atof(AS_STRING(val_a)) : 0);
+    double num_b = (VALUE_TYPE(val_b) == VAL_NUMBER) ? AS_NUMBER(val_b) : (VALUE_TYPE(val_b) == VAL_STRING ? atof(AS_STRING(val_b)) : 0);
 
     if (num_a < num_b) return sort_asc ? -1 : 1;
     if (num_a > num_b) return sort_asc ? 1 : -1;
@@ -72,52 +74,36 @@ void print_separator(int *widths, int col_count) {
 }
 
 Value native_read_csv(int arity, Value *args) {
-    if (arity < 1 || args[0].type != VAL_STRING) {
+    if (arity < 1 || VALUE_TYPE(args[0]) != VAL_STRING) {
         print_error("csv_read expects at least 1 argument (path)");
-        return (Value){VAL_NIL, {0}};
+        return NIL_VAL;
     }
 
-    const char *path = args[0].as.string;
-    const char *delim = (arity > 1 && args[1].type == VAL_STRING) ? args[1].as.string : ",";
+    const char *path = AS_STRING(args[0]);
+    const char *delim = (arity > 1 && VALUE_TYPE(args[1]) == VAL_STRING && AS_STRING(args[1])[0]) ? AS_STRING(args[1]) : ",";
 
-    FILE *file = fopen(path, "r");
-    if (!file) {
+    ValueArray *matrix = csv_read_file(path, delim[0], false);
+    if (!matrix) {
         print_error("Could not open file: %s", path);
-        return (Value){VAL_NIL, {0}};
+        return NIL_VAL;
     }
-
-    ValueArray *matrix = array_new();
-    char line[1024];
-
-    while (fgets(line, sizeof(line), file)) {
-        line[strcspn(line, "\r\n")] = 0;
-
-        ValueArray *row = array_new();
-        char *token = strtok(line, delim);
-
-        while (token != NULL) {
-            Value val_str = (Value){VAL_STRING, {.string = strdup(token)}};
-            array_append(row, val_str);
-            token = strtok(NULL, delim);
-        }
-        array_append(matrix, (Value){VAL_ARRAY, {.array = row}});
-    }
-
-    fclose(file);
-    return (Value){VAL_ARRAY, {.array = matrix}};
+    return ARRAY_VAL(matrix);
 }
 Value native_csv_select(int arity, Value *args) {
-    if (arity < 2 || args[0].type != VAL_ARRAY || args[1].type != VAL_ARRAY) {
+    if (arity >= 2 && VALUE_TYPE(args[0]) == VAL_DATAFRAME && VALUE_TYPE(args[1]) == VAL_ARRAY) {
+        return DATAFRAME_VAL(frame_select(AS_DATAFRAME(args[0]), AS_ARRAY(args[1])));
+    }
+    if (arity < 2 || VALUE_TYPE(args[0]) != VAL_ARRAY || VALUE_TYPE(args[1]) != VAL_ARRAY) {
         print_error("csv_select expects (Array data, Array columns)");
-        return (Value){VAL_NIL, {0}};
+        return NIL_VAL;
     }
 
-    ValueArray *matrix = args[0].as.array;
-    ValueArray *target_cols = args[1].as.array;
+    ValueArray *matrix = AS_ARRAY(args[0]);
+    ValueArray *target_cols = AS_ARRAY(args[1]);
 
-    if (matrix->count == 0) return (Value){VAL_ARRAY, {.array = array_new()}};
+    if (matrix->count == 0) return ARRAY_VAL(array_new());
 
-    ValueArray *header = matrix->values[0].as.array;
+    ValueArray *header = AS_ARRAY(matrix->values[0]);
     ValueArray *result_matrix = array_new();
     
     int col_indices[32];
@@ -126,8 +112,8 @@ Value native_csv_select(int arity, Value *args) {
     for (int i = 0; i < target_cols->count && i < 32; i++) {
         int found_idx = -1;
         for (int j = 0; j < header->count; j++) {
-            if (header->values[j].type == VAL_STRING &&
-                strcmp(header->values[j].as.string, target_cols->values[i].as.string) == 0) {
+            if (VALUE_TYPE(header->values[j]) == VAL_STRING &&
+                strcmp(AS_STRING(header->values[j]), AS_STRING(target_cols->values[i])) == 0) {
                 found_idx = j;
                 break;
             }
@@ -138,7 +124,7 @@ Value native_csv_select(int arity, Value *args) {
     }
 
     for (int i = 0; i < matrix->count; i++) {
-        ValueArray *row = matrix->values[i].as.array;
+        ValueArray *row = AS_ARRAY(matrix->values[i]);
         ValueArray *new_row = array_new();
 
         for (int j = 0; j < col_count; j++) {
@@ -147,34 +133,39 @@ Value native_csv_select(int arity, Value *args) {
                 array_append(new_row, copy_value(row->values[target_idx]));
             }
         }
-        array_append(result_matrix, (Value){VAL_ARRAY, {.array = new_row}});
+        array_append(result_matrix, ARRAY_VAL(new_row));
     }
 
-    return (Value){VAL_ARRAY, {.array = result_matrix}};
+    return ARRAY_VAL(result_matrix);
 }
 
 Value native_csv_aggregate(int arity, Value *args) {
-    if (arity < 3 || args[0].type != VAL_ARRAY || args[1].type != VAL_STRING || args[2].type != VAL_STRING) {
+    if (arity >= 3 && VALUE_TYPE(args[0]) == VAL_DATAFRAME && VALUE_TYPE(args[1]) == VAL_STRING && VALUE_TYPE(args[2]) == VAL_STRING) {
+        double result;
+        if (!frame_aggregate(AS_DATAFRAME(args[0]), AS_STRING(args[1]), AS_STRING(args[2]), &result)) return NIL_VAL;
+        return NUMBER_VAL(result);
+    }
+    if (arity < 3 || VALUE_TYPE(args[0]) != VAL_ARRAY || VALUE_TYPE(args[1]) != VAL_STRING || VALUE_TYPE(args[2]) != VAL_STRING) {
         print_error("csv_aggregate expects (Array data, String column, String op)");
-        return (Value){VAL_NIL, {0}};
+        return NIL_VAL;
     }
 
-    ValueArray *matrix = args[0].as.array;
-    const char *col_name = args[1].as.string;
-    const char *op = args[2].as.string;
+    ValueArray *matrix = AS_ARRAY(args[0]);
+    const char *col_name = AS_STRING(args[1]);
+    const char *op = AS_STRING(args[2]);
 
-    if (matrix->count < 2) return (Value){VAL_NUMBER, {.number = 0}};
+    if (matrix->count < 2) return NUMBER_VAL(0);
 
-    ValueArray *header = matrix->values[0].as.array;
+    ValueArray *header = AS_ARRAY(matrix->values[0]);
     int col_idx = -1;
     for (int i = 0; i < header->count; i++) {
-        if (header->values[i].type == VAL_STRING && strcmp(header->values[i].as.string, col_name) == 0) {
+        if (VALUE_TYPE(header->values[i]) == VAL_STRING && strcmp(AS_STRING(header->values[i]), col_name) == 0) {
             col_idx = i;
             break;
         }
     }
 
-    if (col_idx == -1) return (Value){VAL_NIL, {0}};
+    if (col_idx == -1) return NIL_VAL;
 
     double sum = 0;
     double min = DBL_MAX;
@@ -182,39 +173,43 @@ Value native_csv_aggregate(int arity, Value *args) {
     int count = 0;
 
     for (int i = 1; i < matrix->count; i++) {
-        ValueArray *row = matrix->values[i].as.array;
-        if (col_idx < row->count && row->values[col_idx].type == VAL_STRING) {
-            double val = atof(row->values[col_idx].as.string);
+        ValueArray *row = AS_ARRAY(matrix->values[i]);
+        if (col_idx < row->count && VALUE_TYPE(row->values[col_idx]) == VAL_STRING) {
+            double val = atof(AS_STRING(row->values[col_idx]));
             sum += val;
             if (val < min) min = val;
             if (val > max) max = val;
             count++;
         }
     }
-    if (strcmp(op, "sum") == 0) return (Value){VAL_NUMBER, {.number = sum}};
-    if (strcmp(op, "avg") == 0) return (Value){VAL_NUMBER, {.number = count > 0 ? sum / count : 0}};
-    if (strcmp(op, "min") == 0) return (Value){VAL_NUMBER, {.number = min == DBL_MAX ? 0 : min}};
-    if (strcmp(op, "max") == 0) return (Value){VAL_NUMBER, {.number = max == -DBL_MAX ? 0 : max}};
+    if (strcmp(op, "sum") == 0) return NUMBER_VAL(sum);
+    if (strcmp(op, "avg") == 0) return NUMBER_VAL(count > 0 ? sum / count : 0);
+    if (strcmp(op, "min") == 0) return NUMBER_VAL(min == DBL_MAX ? 0 : min);
+    if (strcmp(op, "max") == 0) return NUMBER_VAL(max == -DBL_MAX ? 0 : max);
 
-    return (Value){VAL_NIL, {0}};
+    return NIL_VAL;
 }
 
 
 Value native_csv_sort(int arity, Value *args) {
-    if (arity < 3 || args[0].type != VAL_ARRAY || args[1].type != VAL_STRING || args[2].type != VAL_STRING) {
-        return (Value){VAL_NIL, {0}};
+    if (arity >= 3 && VALUE_TYPE(args[0]) == VAL_DATAFRAME && VALUE_TYPE(args[1]) == VAL_STRING && VALUE_TYPE(args[2]) == VAL_STRING) {
+        frame_sort(AS_DATAFRAME(args[0]), AS_STRING(args[1]), strcmp(AS_STRING(args[2]), "asc") == 0);
+        return args[0];
+    }
+    if (arity < 3 || VALUE_TYPE(args[0]) != VAL_ARRAY || VALUE_TYPE(args[1]) != VAL_STRING || VALUE_TYPE(args[2]) != VAL_STRING) {
+        return NIL_VAL;
     }
 
-    ValueArray *matrix = args[0].as.array;
-    const char *col_name = args[1].as.string;
-    sort_asc = strcmp(args[2].as.string, "asc") == 0;
+    ValueArray *matrix = AS_ARRAY(args[0]);
+    const char *col_name = AS_STRING(args[1]);
+    sort_asc = strcmp(AS_STRING(args[2]), "asc") == 0;
 
     if (matrix->count < 2) return args[0];
 
-    ValueArray *header = matrix->values[0].as.array;
+    ValueArray *header = AS_ARRAY(matrix->values[0]);
     sort_col_idx = -1;
     for (int i = 0; i < header->count; i++) {
-        if (header->values[i].type == VAL_STRING && strcmp(header->values[i].as.string, col_name) == 0) {
+        if (VALUE_TYPE(header->values[i]) == VAL_STRING && strcmp(AS_STRING(header->values[i]), col_name) == 0) {
             sort_col_idx = i;
             break;
         }
@@ -227,54 +222,59 @@ Value native_csv_sort(int arity, Value *args) {
     return args[0];
 }
 Value native_csv_write(int arity, Value *args) {
-    if (arity < 2 || args[0].type != VAL_STRING || args[1].type != VAL_ARRAY) {
+    if (arity < 2 || VALUE_TYPE(args[0]) != VAL_STRING || (VALUE_TYPE(args[1]) != VAL_ARRAY && VALUE_TYPE(args[1]) != VAL_DATAFRAME)) {
         print_error("csv_write expects (string path, Array data)");
-        return (Value){VAL_NIL, {0}};
+        return NIL_VAL;
     }
 
-    const char *path = args[0].as.string;
-    ValueArray *matrix = args[1].as.array;
-    FILE *file = fopen(path, "w");
+    const char *path = AS_STRING(args[0]);
+    if (VALUE_TYPE(args[1]) == VAL_DATAFRAME) {
+        if (!frame_write_csv(AS_DATAFRAME(args[1]), path)) {
+            print_error("Could not create file: %s", path);
+            return NIL_VAL;
+        }
+        return BOOL_VAL(true);
+    }
+    ValueArray *matrix = AS_ARRAY(args[1]);
+    CsvOut out;
 
-    if (!file) {
+    if (!csv_out_open(&out, path, ',', false)) {
         print_error("Could not create file: %s", path);
-        return (Value){VAL_NIL, {0}};
+        return NIL_VAL;
     }
 
     for (int i = 0; i < matrix->count; i++) {
-        ValueArray *row = matrix->values[i].as.array;
-        for (int j = 0; j < row->count; j++) {
-            const char *str = value_to_string(row->values[j]);
-            fprintf(file, "%s", str);
-            
-            if (j < row->count - 1) {
-                fprintf(file, ",");
-            }
-            free((void*)str);
-        }
-        fprintf(file, "\n");
+        if (VALUE_TYPE(matrix->values[i]) == VAL_ARRAY) csv_out_row(&out, AS_ARRAY(matrix->values[i]));
     }
 
-    fclose(file);
-    return (Value){VAL_BOOL, {.boolean = true}};
+    return BOOL_VAL(csv_out_close(&out));
 }
 
 Value native_csv_group_by(int arity, Value *args) {
     if (arity < 4) {
         print_error("groupBy expects (Array data, String group_col, String target_col, String op)");
-        return (Value){VAL_NIL, {0}};
+        return NIL_VAL;
+    }
+
+    if (VALUE_TYPE(args[0]) == VAL_DATAFRAME) {
+        DataFrame *grouped = frame_group_by(AS_DATAFRAME(args[0]), AS_STRING(args[1]), AS_STRING(args[2]), AS_STRING(args[3]));
+        if (!grouped) {
+            print_error("GroupBy Error: Column not found.");
+            return NIL_VAL;
+        }
+        return DATAFRAME_VAL(grouped);
     }
 
-    ValueArray *matrix = args[0].as.array;
-    char *group_col_name = args[1].as.string;
-    char *target_col_name = args[2].as.string;
-    char *op = args[3].as.string;
+    ValueArray *matrix = AS_ARRAY(args[0]);
+    char *group_col_name = AS_STRING(args[1]);
+    char *target_col_name = AS_STRING(args[2]);
+    char *op = AS_STRING(args[3]);
 
-    ValueArray *header = matrix->values[0].as.array;
+    ValueArray *header = AS_ARRAY(matrix->values[0]);
     int g_idx = -1, t_idx = -1;
 
     for (int i = 0; i < header->count; i++) {
-        char* h_name = strdup(header->values[i].as.string);
+        char* h_name = strdup(AS_STRING(header->values[i]));
         char* clean_h = trim_whitespace(h_name);
         if (strcmp(clean_h, group_col_name) == 0) g_idx = i;
         if (strcmp(clean_h, target_col_name) == 0) t_idx = i;
@@ -283,63 +283,59 @@ Value native_csv_group_by(int arity, Value *args) {
 
     if (g_idx == -1 || t_idx == -1) {
         print_error("GroupBy Error: Column not found.");
-        return (Value){VAL_NIL, {0}};
+        return NIL_VAL;
     }
 
-    GroupEntry groups[512]; 
-    int group_count = 0;
+    /* Keys are numbered as they first appear; a group's number indexes its totals. */
+    StringDict *keys = calloc(1, sizeof(StringDict));
+    GroupEntry *groups = NULL;
+    uint32_t group_count = 0, group_capacity = 0;
 
     for (int i = 1; i < matrix->count; i++) {
-        ValueArray *row = matrix->values[i].as.array;
-        char* raw_key = row->values[g_idx].as.string;
+        ValueArray *row = AS_ARRAY(matrix->values[i]);
+        char* raw_key = AS_STRING(row->values[g_idx]);
         
         char* key_copy = strdup(raw_key);
         char* key = trim_whitespace(key_copy);
         
-        double val = (row->values[t_idx].type == VAL_NUMBER) ? 
-                      row->values[t_idx].as.number : atof(row->values[t_idx].as.string);
-
-        int found_idx = -1;
-        for (int k = 0; k < group_count; k++) {
-            if (strcmp(groups[k].key, key) == 0) {
-                found_idx = k;
-                break;
+        double val = (VALUE_TYPE(row->values[t_idx]) == VAL_NUMBER) ? 
+                      AS_NUMBER(row->values[t_idx]) : atof(AS_STRING(row->values[t_idx]));
+
+        uint32_t g = dict_intern(keys, key, strlen(key));
+        free(key_copy);
+        if (g == group_count) {
+            if (group_count == group_capacity) {
+                group_capacity = group_capacity ? group_capacity * 2 : 64;
+                groups = realloc(groups, sizeof(GroupEntry) * group_capacity);
             }
+            groups[group_count++] = (GroupEntry){0, 0};
         }
-
-        if (found_idx != -1) {
-            groups[found_idx].total_value += val;
-            groups[found_idx].count++;
-            free(key_copy); 
-        } else {
-            groups[group_count].key = strdup(key);
-            groups[group_count].total_value = val;
-            groups[group_count].count = 1;
-            group_count++;
-            free(key_copy);
-        }
+        groups[g].total_value += val;
+        groups[g].count++;
     }
 
     ValueArray *res_matrix = array_new();
     
     ValueArray *h_row = array_new();
-    array_append(h_row, (Value){VAL_STRING, {.string = strdup(group_col_name)}});
-    array_append(h_row, (Value){VAL_STRING, {.string = strdup("result")}});
-    array_append(res_matrix, (Value){VAL_ARRAY, {.array = h_row}});
+    array_append(h_row, string_new(group_col_name, strlen(group_col_name)));
+    array_append(h_row, string_new("result", 6));
+    array_append(res_matrix, ARRAY_VAL(h_row));
 
-    for (int i = 0; i < group_count; i++) {
+    for (uint32_t i = 0; i < group_count; i++) {
         ValueArray *d_row = array_new();
-        array_append(d_row, (Value){VAL_STRING, {.string = groups[i].key}});
+        array_append(d_row, string_new(keys->text + keys->offsets[i], keys->lengths[i]));
         
         double final_val = groups[i].total_value;
         if (strcmp(op, "count") == 0) final_val = (double)groups[i].count;
         else if (strcmp(op, "avg") == 0) final_val /= groups[i].count;
 
-        array_append(d_row, (Value){VAL_NUMBER, {.number = final_val}});
-        array_append(res_matrix, (Value){VAL_ARRAY, {.array = d_row}});
+        array_append(d_row, NUMBER_VAL(final_val));
+        array_append(res_matrix, ARRAY_VAL(d_row));
     }
 
-    return (Value){VAL_ARRAY, {.array = res_matrix}};
+    free(groups);
+    dict_free(keys);
+    return ARRAY_VAL(res_matrix);
 }
 
 // Value native_csv_join(int arity, Value *args) {
@@ -407,6 +403,8 @@ void register_csv_natives(Env *env){
     CSV_REGISTER(env,"__csv_sort",native_csv_sort);
     CSV_REGISTER(env,"__csv_write",native_csv_write);
     CSV_REGISTER(env,"__csv_group_by",native_csv_group_by);
+    register_dataframe_natives(env);
+    register_csv_stream_natives(env);
     // CSV_REGISTER(env,"__csv_join",native_csv_join);
 
 }
\ No newline at end of file
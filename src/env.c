@@ -1,17 +1,214 @@
 #include "env.h"
 #include "value.h"
 #include "parser.h"
+#include "gc.h"
+#include <pthread.h>
 #include <stdlib.h>
 #include <string.h>
 
+#define FRAME_CHUNK_SIZE (64 * 1024)
+#define FRAME_ALIGN 16
+
+/**
+ * @typedef @struct FRAMECHUNK
+ * One block of a thread's frame arena. Chunks are kept once allocated and
+ * reused as the frame stack grows and shrinks.
+ */
+typedef struct FrameChunk {
+    struct FrameChunk* prev;
+    struct FrameChunk* next;
+    char* top;
+    char* end;
+    char data[];
+} FrameChunk;
+
+/**
+ * @typedef @struct FRAMEARENA
+ * Per-thread (or per-fiber) stack of frame environments and their variables.
+ */
+struct FrameArena {
+    FrameChunk* chunk;  // chunk holding the top of the stack
+    Env* top_frame;
+};
+
+static __thread FrameArena* arena = NULL;
+static pthread_key_t arena_key;
+static pthread_once_t arena_once = PTHREAD_ONCE_INIT;
+
+void frame_arena_free(FrameArena* a) {
+    if (a == NULL) return;
+    FrameChunk* chunk = a->chunk;
+    while (chunk && chunk->prev) chunk = chunk->prev;
+    while (chunk) {
+        FrameChunk* next = chunk->next;
+        free(chunk);
+        chunk = next;
+    }
+    free(a);
+}
+
+/**
+ * Frees a thread's arena when the thread exits.
+ */
+static void arena_destroy(void* data) {
+    frame_arena_free(data);
+}
+
+void frame_arena_mark(FrameArena* a) {
+    if (a == NULL) return;
+    for (Env* e = a->top_frame; e; e = e->frame_below) {
+        for (Var* v = e->vars; v; v = v->next) gc_mark_value(v->value);
+        gc_mark_env(e->outer);
+    }
+}
+
+/**
+ * Marks the values held by the main thread's frames. Collections only run
+ * on the main thread while no other thread is evaluating, so its arena is
+ * the only other one that can hold live frames; the collector marks those
+ * of threads parked in gc_blocking_begin, and the event loop those of
+ * suspended async fibers.
+ */
+static void mark_frames(void* ctx) {
+    (void)ctx;
+    frame_arena_mark(arena);
+}
+
+static void arena_init_once(void) {
+    pthread_key_create(&arena_key, arena_destroy);
+    gc_add_root_marker(mark_frames, NULL);
+}
+
+static FrameArena* current_arena(void) {
+    if (arena == NULL) {
+        pthread_once(&arena_once, arena_init_once);
+        arena = calloc(1, sizeof(FrameArena));
+        pthread_setspecific(arena_key, arena);
+    }
+    return arena;
+}
+
+FrameArena* frame_arena_new(void) {
+    pthread_once(&arena_once, arena_init_once);
+    return calloc(1, sizeof(FrameArena));
+}
+
+FrameArena* frame_arena_current(void) {
+    return arena;
+}
+
+FrameArena* frame_arena_swap(FrameArena* a) {
+    FrameArena* previous = arena;
+    arena = a;
+    return previous;
+}
+
+Env* frame_top(void) {
+    return arena != NULL ? arena->top_frame : NULL;
+}
+
+void frame_unwind(Env* top) {
+    if (arena == NULL || arena->top_frame == top) return;
+    Env* lowest = arena->top_frame;
+    while (lowest->frame_below != top) lowest = lowest->frame_below;
+    FrameChunk* chunk = lowest->frame_chunk;
+    chunk->top = (char*)lowest;
+    arena->chunk = chunk;
+    arena->top_frame = top;
+}
+
+static FrameChunk* chunk_new(size_t size) {
+    if (size < FRAME_CHUNK_SIZE) size = FRAME_CHUNK_SIZE;
+    FrameChunk* chunk = malloc(sizeof(FrameChunk) + size);
+    chunk->prev = NULL;
+    chunk->next = NULL;
+    chunk->top = chunk->data;
+    chunk->end = chunk->data + size;
+    return chunk;
+}
+
+/**
+ * Bump-allocates size bytes on top of the current thread's frame stack.
+ * Moves on to the next chunk when the current one is full, reusing chunks
+ * left over from deeper recursion.
+ */
+static void* frame_alloc(FrameArena* a, size_t size) {
+    size = (size + FRAME_ALIGN - 1) & ~(size_t)(FRAME_ALIGN - 1);
+    FrameChunk* chunk = a->chunk;
+    if (chunk == NULL) {
+        chunk = a->chunk = chunk_new(size);
+    } else if (chunk->top + size > chunk->end) {
+        FrameChunk* next = chunk->next;
+        if (next == NULL || (size_t)(next->end - next->data) < size) {
+            FrameChunk* grown = chunk_new(size);
+            grown->prev = chunk;
+            grown->next = next;
+            if (next) next->prev = grown;
+            chunk->next = grown;
+            next = grown;
+        }
+        next->top = next->data;
+        chunk = a->chunk = next;
+    }
+    void* ptr = chunk->top;
+    chunk->top += size;
+    return ptr;
+}
+
+/* Serialises declarations in heap environments while @parallel tasks run.
+   Lookups take no lock, so a slot array replaced during that time is kept
+   on the retired list until no task can still be reading it. */
+static pthread_mutex_t env_lock = PTHREAD_MUTEX_INITIALIZER;
+static Var*** retired_slots = NULL;
+static int retired_count = 0;
+static int retired_capacity = 0;
+
+static void retire_slots(Var** slots) {
+    if (retired_count == retired_capacity) {
+        retired_capacity = retired_capacity < 8 ? 8 : retired_capacity * 2;
+        retired_slots = realloc(retired_slots, sizeof(Var**) * retired_capacity);
+    }
+    retired_slots[retired_count++] = slots;
+}
+
+static void free_retired_slots(void) {
+    for (int i = 0; i < retired_count; i++) free(retired_slots[i]);
+    retired_count = 0;
+}
+
+/**
+ * Whether env is the innermost frame of the calling thread, the only one
+ * that may still grow in place.
+ */
+static bool is_top_frame(Env* env) {
+    return env->is_frame && arena != NULL && arena->top_frame == env;
+}
+
 
 /**
  * @typedef @struct ENV
  * Represents an environment (scope) in the Jackal programming language.
  */
 Env* env_new(Env* outer) {
-    Env* env = calloc(1, sizeof(Env));
+    Env* env = gc_allocate(sizeof(Env), GC_ENV);
+    env->outer = outer;
+    return env;
+}
+/**
+ * Pushes a call, block or loop environment. Frame-local scopes come from
+ * the thread's frame arena; the rest fall back to env_new.
+ */
+Env* env_push(Env* outer, struct Node* scope) {
+    if (scope == NULL || !scope->is_frame_local) return env_new(outer);
+
+    FrameArena* a = current_arena();
+    Env* env = frame_alloc(a, sizeof(Env));
+    memset(env, 0, sizeof(Env));
     env->outer = outer;
+    env->is_frame = true;
+    env->frame_below = a->top_frame;
+    env->frame_chunk = a->chunk;
+    a->top_frame = env;
     return env;
 }
 /**
@@ -20,14 +217,14 @@ Env* env_new(Env* outer) {
  * @param name The name of the variable to find.
  * @return A pointer to the Var if found, otherwise NULL.
  */
+static int env_slot_of(Env* env, const char* name);
+
 Var* find_var(Env* env, const char* name) {
     if (env == NULL || name == NULL) return NULL;
 
-    for (Var* v = env->vars; v; v = v->next) {
-        if (v->name != NULL && strcmp(v->name, name) == 0) {
-            return v;
-        }
-    }
+    /* The slots, not the vars list, since they also hold linked bindings. */
+    int slot = env_slot_of(env, name);
+    if (slot >= 0) return env->slots[slot];
 
     if (env->outer != NULL && env->outer != env) {
         return find_var(env->outer, name);
@@ -36,49 +233,255 @@ Var* find_var(Env* env, const char* name) {
     return NULL;
 }
 /**
- * Sets a variable in the given environment.
- * @param env The environment to set the variable in.
+ * Returns the slot of a variable bound directly in env, or -1.
+ * @param env The environment to search (outer scopes are not searched).
  * @param name The name of the variable.
- * @param value The value to assign to the variable.
- * @param is_const Boolean indicating if the variable is constant.
  */
-void set_var(Env* env, const char* name, Value value, bool is_const, const char* type_name) {
-    Var* n = malloc(sizeof(Var));
-    if (!n) return;
+static int env_slot_of(Env* env, const char* name) {
+    /* Newest first, where lookups of a script's own names end early. */
+    for (int i = env->count - 1; i >= 0; i--) {
+        if (strcmp(env->slots[i]->name, name) == 0) {
+            return i;
+        }
+    }
+    return -1;
+}
+/**
+ * Whether v is one of env's own variables rather than one linked into it.
+ */
+static bool env_owns(Env* env, Var* v) {
+    for (Var* own = env->vars; own; own = own->next) {
+        if (own == v) return true;
+    }
+    return false;
+}
+/**
+ * Makes room for one more slot in env.
+ * @param in_frame Whether env is the thread's top frame.
+ * @param shared Whether other threads may be reading env meanwhile.
+ */
+static bool grow_slots(Env* env, bool in_frame, bool shared) {
+    if (env->count < env->capacity) return true;
+
+    int new_capacity = env->capacity < 8 ? 8 : env->capacity * 2;
+    Var** slots;
+    if (in_frame || env->slots_in_frame) {
+        slots = in_frame ? frame_alloc(arena, sizeof(Var*) * new_capacity) : malloc(sizeof(Var*) * new_capacity);
+        if (!slots) return false;
+        if (env->count > 0) memcpy(slots, env->slots, sizeof(Var*) * env->count);
+        if (!env->slots_in_frame) free(env->slots);
+        env->slots_in_frame = in_frame;
+    } else if (shared) {
+        slots = malloc(sizeof(Var*) * new_capacity);
+        if (!slots) return false;
+        if (env->count > 0) memcpy(slots, env->slots, sizeof(Var*) * env->count);
+        if (env->slots) retire_slots(env->slots);
+    } else {
+        if (retired_count > 0) free_retired_slots();
+        slots = realloc(env->slots, sizeof(Var*) * new_capacity);
+        if (!slots) return false;
+    }
+    env->slots = slots;
+    env->capacity = new_capacity;
+    return true;
+}
+/**
+ * Body of define_var.
+ * @param shared Whether other threads may be reading env meanwhile.
+ */
+static Var* declare_in(Env* env, const char* name, int slot_hint, Value value, bool is_const, const char* type_name, bool shared) {
+    int slot = -1;
+    if (slot_hint >= 0 && slot_hint < env->count && strcmp(env->slots[slot_hint]->name, name) == 0) {
+        slot = slot_hint;
+    } else {
+        slot = env_slot_of(env, name);
+    }
+
+    /* A binding linked in from a module is shadowed, not overwritten. */
+    if (slot >= 0 && env->slots[slot]->is_shared && !env_owns(env, env->slots[slot])) {
+        Var* n = malloc(sizeof(Var));
+        if (!n) return NULL;
+        memset(n, 0, sizeof(Var));
+        strcpy(n->name, name);
+        n->next = env->vars;
+        env->vars = n;
+        env->slots[slot] = n;
+    }
+
+    if (slot >= 0) {
+        Var* v = env->slots[slot];
+        Value old = v->value;
+        v->value = copy_value(value);
+        free_value(old);
+        v->is_const = is_const;
+        v->is_final = false;
+        strcpy(v->expected_type, type_name ? type_name : "");
+        return v;
+    }
+
+    bool in_frame = is_top_frame(env);
+    if (!grow_slots(env, in_frame, shared)) return NULL;
+
+    Var* n = in_frame ? frame_alloc(arena, sizeof(Var)) : malloc(sizeof(Var));
+    if (!n) return NULL;
+    n->in_frame = in_frame;
+    n->is_shared = false;
     strcpy(n->name, name);
     n->value = copy_value(value);
     n->is_const = is_const;
+    n->is_final = false;
     strcpy(n->expected_type, type_name ? type_name : ""); 
     n->next = env->vars;
+    env->slots[env->count] = n;
+    if (shared) __atomic_thread_fence(__ATOMIC_RELEASE);
     env->vars = n;
+    env->count++;
+    return n;
+}
+
+/**
+ * Declares a variable in the given environment and returns it.
+ * Redeclaring a name in the same environment reuses its slot, so slot
+ * indexes handed out by the resolver stay valid.
+ * @param env The environment to declare the variable in.
+ * @param name The name of the variable.
+ * @param slot_hint Slot computed by the resolver, or -1 if unknown.
+ * @param value The value to assign to the variable.
+ * @param is_const Boolean indicating if the variable is constant.
+ * @param type_name Declared type of the variable, or NULL.
+ * Heap environments are locked while @parallel tasks may be running.
+ */
+Var* define_var(Env* env, const char* name, int slot_hint, Value value, bool is_const, const char* type_name) {
+    if (env->is_frame || !gc_threads_running()) {
+        return declare_in(env, name, slot_hint, value, is_const, type_name, false);
+    }
+    pthread_mutex_lock(&env_lock);
+    Var* v = declare_in(env, name, slot_hint, value, is_const, type_name, true);
+    pthread_mutex_unlock(&env_lock);
+    return v;
+}
+/**
+ * Binds var, which belongs to an environment that outlives env, in env
+ * under its own name, replacing whatever env bound to that name before.
+ * Both environments then read and write the same variable.
+ * @param env The environment to bind the variable in.
+ * @param var The variable to share.
+ */
+void link_var(Env* env, Var* var) {
+    bool shared = !env->is_frame && gc_threads_running();
+    if (shared) pthread_mutex_lock(&env_lock);
+
+    var->is_shared = true;
+    int slot = env_slot_of(env, var->name);
+    if (slot >= 0) {
+        env->slots[slot] = var;
+    } else if (grow_slots(env, is_top_frame(env), shared)) {
+        env->slots[env->count] = var;
+        if (shared) __atomic_thread_fence(__ATOMIC_RELEASE);
+        env->count++;
+    }
+
+    if (shared) pthread_mutex_unlock(&env_lock);
+}
+/**
+ * Sets a variable in the given environment.
+ * @param env The environment to set the variable in.
+ * @param name The name of the variable.
+ * @param value The value to assign to the variable.
+ * @param is_const Boolean indicating if the variable is constant.
+ */
+void set_var(Env* env, const char* name, Value value, bool is_const, const char* type_name) {
+    define_var(env, name, -1, value, is_const, type_name);
+}
+/**
+ * Finds the variable an identifier node refers to, using the slot assigned
+ * by the resolver when it is still valid and falling back to find_var.
+ * @param env The environment the node is evaluated in.
+ * @param n The NODE_IDENT, NODE_THIS or NODE_ASSIGN node.
+ * @return A pointer to the Var if found, otherwise NULL.
+ */
+Var* find_resolved_var(Env* env, struct Node* n) {
+    return find_var_at(env, n, n->scope_depth);
+}
+/**
+ * Body of find_resolved_var for callers whose env is not the one the
+ * resolver counted from, such as VM frames that keep their own scopes in
+ * stack slots.
+ * @param env The environment to start from.
+ * @param n The resolved node.
+ * @param depth Number of scopes between env and the one declaring n,
+ * or -1 to look the name up.
+ * @return A pointer to the Var if found, otherwise NULL.
+ */
+Var* find_var_at(Env* env, struct Node* n, int depth) {
+    if (n->resolve_kind != RESOLVE_NONE && depth >= 0) {
+        Env* target = env;
+        for (int i = 0; i < depth && target; i++) {
+            if (target->is_dynamic) {
+                target = NULL;
+                break;
+            }
+            target = target->outer;
+        }
+
+        if (target) {
+            int slot = n->scope_slot;
+            if (slot >= 0 && slot < target->count && strcmp(target->slots[slot]->name, n->name) == 0) {
+                return target->slots[slot];
+            }
+
+            if (n->resolve_kind == RESOLVE_ROOT) {
+                slot = env_slot_of(target, n->name);
+                if (slot >= 0) {
+                    n->scope_slot = slot;
+                    return target->slots[slot];
+                }
+            }
+        }
+    }
+
+    return find_var(env, n->name);
 }
 /**
  * Frees the memory associated with an environment and its variables.
+ * Environments captured by a closure are left to the collector, which
+ * frees them once no closure refers to them.
  * @param env The environment to be freed.
  * 
  */
 void env_free(Env* env) {
-    if (env == NULL) return;
+    if (env == NULL || env->is_captured) return;
     Var* v = env->vars;
     while (v) {
         Var* next = v->next;
         free_value(v->value); 
-        free(v);
+        if (!v->in_frame) free(v);
         v = next;
     }
-    free(env);
+    if (!env->slots_in_frame) free(env->slots);
+
+    if (env->is_frame) {
+        /* Popping a frame also drops any frame above it that a longjmp
+           skipped past. */
+        FrameChunk* chunk = env->frame_chunk;
+        chunk->top = (char*)env;
+        arena->chunk = chunk;
+        arena->top_frame = env->frame_below;
+        return;
+    }
+    gc_free(env);
 }
 
 int assign_var(Env* env, const char* name, Value value) {
-    for (Var* v = env->vars; v; v = v->next) {
-        if (strcmp(v->name, name) == 0) {
-            if (v->is_const || v->is_final) {
-                return 0; 
-            }
-            free_value(v->value);
-            v->value = copy_value(value);
-            return 1; 
+    int slot = env_slot_of(env, name);
+    if (slot >= 0) {
+        Var* v = env->slots[slot];
+        if (v->is_const || v->is_final) {
+            return 0; 
         }
+        free_value(v->value);
+        v->value = copy_value(value);
+        return 1; 
     }
     if (env->outer) return assign_var(env->outer, name, value);
     return 0; 
@@ -2,6 +2,15 @@
 #include "value.h"
 #include "env.h"
 #include "common.h"
+#include "resolver.h"
+#include "module.h"
+#include "gc.h"
+#include "string_object.h"
+#include "shape.h"
+#include "methods.h"
+#include "task.h"
+#include "async.h"
+#include "csv/csv_stream.h"
 #include<errno.h>
 #include <string.h>
 #include <stdbool.h>
@@ -26,16 +35,30 @@ const char *get_platform_name()
 #endif
 }
 
-Func *current_executing_func = NULL;
+/* Per thread, since @parallel tasks evaluate code on pool threads. */
+__thread Func *current_executing_func = NULL;
 /**
  * @include collections DSA stl
  */
 #include "collections/linkedlist.h"
 /**
- * Global exception state for the interpreter.
+ * Exception state for the interpreter, one per thread.
  */
 
-ExceptionState global_ex_state = {.active = 0};
+__thread ExceptionState global_ex_state = {.active = 0};
+
+void throw_value(Value error)
+{
+    if (global_ex_state.active)
+    {
+        global_ex_state.error_val = error;
+        longjmp(global_ex_state.buf, 1);
+    }
+    printf("Uncaught Exception: ");
+    print_value(error);
+    printf("\n");
+    exit(1);
+}
 
 /**
  * @brief Recursively searches for a method in a class and its superclasses.
@@ -43,57 +66,26 @@ ExceptionState global_ex_state = {.active = 0};
  * @param name The name of the method to find.
  * @return Pointer to the Var representing the method, or NULL if not found.
  */
-static Var *find_method(Class *klass, const char *name);
 
 /**
  * @brief Checks if two values are both numbers.
  */
 static bool is_number(Value a, Value b)
 {
-    return a.type == VAL_NUMBER && b.type == VAL_NUMBER;
+    return IS_NUMBER(a) && IS_NUMBER(b);
 }
 
 /**
  * @brief Checks if two values are both strings.
  */
 
-static bool is_string(Value a, Value b) { return a.type == VAL_STRING && b.type == VAL_STRING; }
-
-/**
- * @brief Reads the content of a file into a string.
- * @param filename The name of the file to read.
- * @return A pointer to the file content string, or NULL on failure.
- */
-static char *read_file(const char *filename)
-{
-    FILE *f = fopen(filename, "r");
-    if (!f)
-        return NULL;
-    fseek(f, 0, SEEK_END);
-    long len = ftell(f);
-    rewind(f);
-    char *source = malloc(len + 1);
-    if (source)
-    {
-        fread(source, 1, len, f);
-        source[len] = '\0';
-    }
-    fclose(f);
-    return source;
-}
+static bool is_string(Value a, Value b) { return IS_STRING(a) && IS_STRING(b); }
 
 bool is_integer_value(Value val)
 {
-    if (val.type != VAL_NUMBER)
+    if (VALUE_TYPE(val) != VAL_NUMBER)
         return false;
-    return val.as.number == floor(val.as.number);
-}
-
-void *parallel_wrapper(void *arg)
-{
-    ThreadArgs *t_args = (ThreadArgs *)arg;
-    t_args->result = eval_node(t_args->env, t_args->body);
-    return NULL;
+    return AS_NUMBER(val) == floor(AS_NUMBER(val));
 }
 
 /**
@@ -101,7 +93,7 @@ void *parallel_wrapper(void *arg)
  */
 const char *get_value_type_name(Value val)
 {
-    switch (val.type)
+    switch (VALUE_TYPE(val))
     {
     case VAL_NIL:
         return "None";
@@ -122,15 +114,25 @@ const char *get_value_type_name(Value val)
     case VAL_NATIVE:
         return "Function";
     case VAL_CLASS:
-        return val.as.class_obj->name;
+        return AS_CLASS(val)->name;
     case VAL_INSTANCE:
-        return val.as.instance->class_val->as.class_obj->name;
+        return AS_CLASS(*AS_INSTANCE(val)->class_val)->name;
     case VAL_INTERFACE:
-        return val.as.interface_obj->name;
+        return AS_INTERFACE(val)->name;
     case VAL_ENUM:
-        return val.as.enum_obj->name;
+        return AS_ENUM(val)->name;
     case VAL_FILE:
         return "File";
+    case VAL_TASK:
+        return "Task";
+    case VAL_PROMISE:
+        return "Promise";
+    case VAL_DATAFRAME:
+        return "DataFrame";
+    case VAL_CSV_CURSOR:
+        return "CsvCursor";
+    case VAL_CSV_WRITER:
+        return "CsvWriter";
     default:
         return "unknown";
     }
@@ -155,15 +157,15 @@ static bool check_template_match(Value val, const char *expected_template_type)
 
 static bool match_pattern(Value value, Value pattern)
 {
-    if (pattern.type == VAL_NIL)
+    if (VALUE_TYPE(pattern) == VAL_NIL)
         return true;
-    if (value.type != pattern.type)
+    if (VALUE_TYPE(value) != VALUE_TYPE(pattern))
         return false;
 
-    if (value.type == VAL_ARRAY)
+    if (VALUE_TYPE(value) == VAL_ARRAY)
     {
-        ValueArray *vArr = value.as.array;
-        ValueArray *pArr = pattern.as.array;
+        ValueArray *vArr = AS_ARRAY(value);
+        ValueArray *pArr = AS_ARRAY(pattern);
         if (vArr->count != pArr->count)
             return false;
         for (int i = 0; i < vArr->count; i++)
@@ -174,16 +176,16 @@ static bool match_pattern(Value value, Value pattern)
         return true;
     }
 
-    if (value.type == VAL_MAP)
+    if (VALUE_TYPE(value) == VAL_MAP)
     {
-        HashMap *vMap = value.as.map;
-        HashMap *pMap = pattern.as.map;
+        HashMap *vMap = AS_MAP(value);
+        HashMap *pMap = AS_MAP(pattern);
         for (int i = 0; i < pMap->capacity; i++)
         {
             if (pMap->entries[i].key != NULL)
             {
                 Value found;
-                if (!map_get(vMap, pMap->entries[i].key, &found))
+                if (!map_get_string(vMap, STRING_OBJECT(pMap->entries[i].key), &found))
                     return false;
                 if (!match_pattern(found, pMap->entries[i].value))
                     return false;
@@ -193,11 +195,11 @@ static bool match_pattern(Value value, Value pattern)
     }
 
     Value eq = eval_equals(value, pattern);
-    return eq.as.number == 1.0;
+    return AS_NUMBER(eq) == 1.0;
 }
 static bool is_type_alias_match(const char *expected_type, Value actual_val)
 {
-    if (actual_val.type == VAL_NUMBER)
+    if (VALUE_TYPE(actual_val) == VAL_NUMBER)
     {
         if (strcmp(expected_type, "Int") == 0)
         {
@@ -221,26 +223,18 @@ static bool is_type_alias_match(const char *expected_type, Value actual_val)
 
     return false;
 }
-void *async_wrapper(void *data)
-{
-    AsyncData *ad = (AsyncData *)data;
-    eval_node(ad->func->body_head, ad->func->env);
-    free(ad);
-    return NULL;
-}
-
 /**
  * @brief call stream built in method
  *
  */
 Value call_jackal_function(Env *env, Value func_val, int arg_count, Value *args)
 {
-    Func *func = func_val.as.function;
+    Func *func = AS_FUNCTION(func_val);
 
-    if (func_val.type != VAL_FUNCTION)
+    if (VALUE_TYPE(func_val) != VAL_FUNCTION)
     {
         print_error("Invalid callback: not a function.");
-        return (Value){VAL_NIL, {0}};
+        return NIL_VAL;
     }
 
     if (func->is_platform_specific && func->target_os != NULL)
@@ -251,21 +245,14 @@ Value call_jackal_function(Env *env, Value func_val, int arg_count, Value *args)
             if (!(strcmp(func->target_os, "unix") == 0 &&
                   (strcmp(current_os, "macos") == 0 || strcmp(current_os, "linux") == 0)))
             {
-                return (Value){VAL_NIL, {0}};
+                return NIL_VAL;
             }
         }
     }
 
     if (func->is_async)
     {
-        pthread_t thread;
-        AsyncData *data = malloc(sizeof(AsyncData));
-        data->func = func;
-        data->arg_count = arg_count;
-        data->args = args;
-        pthread_create(&thread, NULL, async_wrapper, data);
-        pthread_detach(thread);
-        return (Value){VAL_NIL, {0}};
+        return async_spawn(func_val, arg_count, args);
     }
 
     if (arg_count != func->arity)
@@ -273,7 +260,7 @@ Value call_jackal_function(Env *env, Value func_val, int arg_count, Value *args)
         char buffer[128];
         snprintf(buffer, sizeof(buffer), "Function expected %d arguments but got %d.", func->arity, arg_count);
         print_error(buffer);
-        return (Value){VAL_NIL, {0}};
+        return NIL_VAL;
     }
 
     if (func->is_deprecated)
@@ -292,7 +279,7 @@ Value call_jackal_function(Env *env, Value func_val, int arg_count, Value *args)
     if (func->is_memoized && arg_count > 0)
     {
         char key[64];
-        snprintf(key, sizeof(key), "%g", args[0].as.number);
+        snprintf(key, sizeof(key), "%g", AS_NUMBER(args[0]));
         Value cached_res;
         if (map_get(func->cache, key, &cached_res))
         {
@@ -300,10 +287,17 @@ Value call_jackal_function(Env *env, Value func_val, int arg_count, Value *args)
         }
     }
 
+    if (func->is_parallel)
+    {
+        /* Natives calling back into Jackal need the value, not a task. */
+        Value task = task_spawn(func_val, arg_count, args);
+        return task_join(AS_TASK(task));
+    }
+
     Func *previous_func = current_executing_func;
     current_executing_func = func;
 
-    Env *call_env = env_new(func->env);
+    Env *call_env = env_push(func->env, func->body_head);
     Node *param = func->params_head;
     for (int i = 0; i < arg_count; i++)
     {
@@ -316,29 +310,14 @@ Value call_jackal_function(Env *env, Value func_val, int arg_count, Value *args)
         param = param->next;
     }
 
-    Value result;
-    if (func->is_parallel)
-    {
-        pthread_t thread;
-        ThreadArgs *t_args = malloc(sizeof(ThreadArgs));
-        t_args->env = call_env;
-        t_args->body = func->body_head;
-        pthread_create(&thread, NULL, parallel_wrapper, t_args);
-        pthread_join(thread, NULL);
-        result = t_args->result;
-        free(t_args);
-    }
-    else
-    {
-        result = eval_node(call_env, func->body_head);
-    }
+    Value result = eval_node(call_env, func->body_head);
 
     current_executing_func = previous_func;
 
     Value actual_return = result;
-    if (result.type == VAL_RETURN)
+    if (VALUE_TYPE(result) == VAL_RETURN)
     {
-        actual_return = *result.as.return_val;
+        actual_return = *AS_RETURN(result);
     }
 
     if (func->return_type[0] != '\0')
@@ -346,7 +325,7 @@ Value call_jackal_function(Env *env, Value func_val, int arg_count, Value *args)
         const char *actual_type_name = get_value_type_name(actual_return);
 
         bool type_matches = false;
-        if (strcmp(func->return_type, "Array") == 0 && actual_return.type == VAL_ARRAY)
+        if (strcmp(func->return_type, "Array") == 0 && VALUE_TYPE(actual_return) == VAL_ARRAY)
         {
             type_matches = true;
         }
@@ -355,7 +334,7 @@ Value call_jackal_function(Env *env, Value func_val, int arg_count, Value *args)
         {
             type_matches = true;
         }
-        else if (actual_return.type == VAL_NUMBER)
+        else if (VALUE_TYPE(actual_return) == VAL_NUMBER)
         {
             if (strcmp(func->return_type, "Int") == 0 || strcmp(func->return_type, "Float") == 0 || strcmp(func->return_type, "Number") == 0)
             {
@@ -366,707 +345,1566 @@ Value call_jackal_function(Env *env, Value func_val, int arg_count, Value *args)
         if (!type_matches)
         {
             print_error("Type Mismatch: Function expected return type '%s' but got '%s'.", func->return_type, actual_type_name);
-            if (result.type == VAL_RETURN)
-                free(result.as.return_val);
+            if (VALUE_TYPE(result) == VAL_RETURN)
+                gc_free(AS_RETURN(result));
             env_free(call_env);
-            return (Value){VAL_NIL, {0}};
+            return NIL_VAL;
         }
     }
 
     if (func->is_memoized && arg_count > 0)
     {
         char key[64];
-        snprintf(key, sizeof(key), "%g", args[0].as.number);
+        snprintf(key, sizeof(key), "%g", AS_NUMBER(args[0]));
         map_set(func->cache, key, actual_return);
     }
 
     env_free(call_env);
 
-    if (result.type == VAL_RETURN)
+    if (VALUE_TYPE(result) == VAL_RETURN)
     {
-        free(result.as.return_val);
+        gc_free(AS_RETURN(result));
     }
 
     return actual_return;
 }
 /**
- * @brief Recursively searches for a method in a class and its superclasses.
+ * @brief Searches for a method in a class and its superclasses, then in
+ * the scopes the classes were defined in.
  * @param klass The class to search in.
  * @param name The name of the method to find.
  * @return Pointer to the Var representing the method, or NULL if not found.
  */
-static Var *find_method(Class *klass, const char *name)
+Var *find_method(Class *klass, const char *name)
 {
-
-    Var *method = find_var(klass->methods, name);
+    Var *method = class_method(klass, name, NULL);
     if (method)
         return method;
 
-    if (klass->superclass)
+    for (Class *c = klass; c; c = c->superclass)
     {
-        return find_method(klass->superclass, name);
+        method = find_var(c->methods->outer, name);
+        if (method)
+            return method;
     }
 
     return NULL;
 }
 
 /**
- * @brief Main evaluation function.
- * Recursively evaluates an AST node in a given environment.
- * @param env The current variable environment.
- * @param n The AST node to evaluate.
- * @return The result of the evaluation as a Value.
+ * @brief Marks an environment chain as captured by a closure.
+ * A captured environment outlives the call or block that created it,
+ * so env_free leaves it in place for the closure to keep using.
+ * @param env The environment the closure was created in.
  */
-
-Value eval_node(Env *env, Node *n)
+static void capture_env(Env *env)
 {
-
-    if (!n)
-        return (Value){.type = VAL_NIL, .as = {0}};
-
-    switch (n->kind)
+    for (Env *e = env; e && !e->is_captured; e = e->outer)
     {
+        e->is_captured = true;
+    }
+}
 
-    case NODE_BOOL:
-        return (Value){VAL_BOOL, {.boolean = (n->value != 0.0)}};
+/**
+ * @brief Creates a function value for a NODE_FUNC_DEF or NODE_FUNC_EXPR.
+ * @param env The environment the function closes over.
+ * @param n The declaration node.
+ * @return A VAL_FUNCTION value.
+ */
+Value make_function(Env *env, Node *n)
+{
+    Func *func;
+    Value val;
 
-    case NODE_FUNC_EXPR:
+    if (n->kind == NODE_FUNC_EXPR)
     {
-        Func *func = jackal_allocate_gc(sizeof(Func));
-        
-        strcpy(func->return_type, n->return_type);
-        
-        func->params_head = n->left;
-        func->body_head = n->right;
-        func->env = env;
-        func->arity = n->arity;
-
-        Value val;
-        val.type = VAL_FUNCTION;
-        val.as.function = func;
-        val.gc_info = ((GCObject *)func) - 1;
-
-        return val;
+        func = gc_allocate(sizeof(Func), GC_FUNCTION);
+        val = FUNCTION_VAL(func);
     }
-
-    case NODE_BREAK_STMT:
-        return (Value){VAL_BREAK, {0}};
-
-    case NODE_CONTINUE_STMT:
-        return (Value){VAL_CONTINUE, {0}};
-
-    case NODE_ENUM_DEF:
+    else
     {
-        Enum *en = malloc(sizeof(Enum));
-        strcpy(en->name, n->name);
-        en->values = env_new(NULL);
+        func = gc_allocate(sizeof(Func), GC_FUNCTION);
+        val = FUNCTION_VAL(func);
 
-        Node *entry = n->left;
-        while (entry)
-        {
-            Value val;
-            if (entry->kind == NODE_STRING)
-            {
-                val = (Value){VAL_STRING, {.string = strdup(entry->string_value)}};
-            }
-            else
-            {
-                val = (Value){VAL_NUMBER, {.number = entry->value}};
-            }
+        func->is_private = n->is_private;
+        func->is_deprecated = n->is_deprecated;
+        func->is_memoized = n->is_memoize;
+        func->is_async = n->is_async;
+        func->is_final = n->is_final;
+        func->is_parallel = n->is_paralel;
+        func->deprecated_message = n->deprecated_message ? strdup(n->deprecated_message) : NULL;
 
-            set_var(en->values, entry->name, val, true, "");
-            entry = entry->next;
+        func->is_platform_specific = n->is_platform_specific;
+        if (n->is_platform_specific && n->target_os != NULL)
+        {
+            func->target_os = strdup(n->target_os);
         }
 
-        Value enum_val = (Value){VAL_ENUM, {.enum_obj = en}};
-        set_var(env, n->name, enum_val, true, "");
-        return (Value){VAL_NIL, {0}};
+        func->static_vars = map_new();
+        if (func->is_memoized)
+        {
+            func->cache = map_new();
+        }
     }
 
-    case NODE_THROW_STMT:
-    {
-        Value err_val = eval_node(env, n->left);
+    strcpy(func->return_type, n->return_type);
+    func->params_head = n->left;
+    func->body_head = n->right;
+    func->env = env;
+    func->arity = n->arity;
+
+    capture_env(env);
+    return val;
+}
 
-        if (global_ex_state.active)
+/**
+ * @brief Applies an arithmetic, comparison or equality operator.
+ * Takes ownership of both operands.
+ * @param op The operator token.
+ * @param left The evaluated left operand.
+ * @param right The evaluated right operand.
+ * @return The result, or VAL_NIL after reporting an error.
+ */
+Value eval_binary_op(TokenKind op, Value left, Value right)
+{
+    switch (op)
+    {
+    case TOKEN_PLUS:
+        if (is_number(left, right))
         {
-            global_ex_state.error_val = err_val;
-            longjmp(global_ex_state.buf, 1);
+            return NUMBER_VAL(AS_NUMBER(left) + AS_NUMBER(right));
         }
-        else
+        if (is_string(left, right))
         {
-            printf("Uncaught Exception: ");
-            print_value(err_val);
-            printf("\n");
-            exit(1);
+            ObjString *l = string_object(left);
+            ObjString *r = string_object(right);
+            size_t len_left = l ? l->length : strlen(AS_STRING(left));
+            size_t len_right = r ? r->length : strlen(AS_STRING(right));
+            Value result = string_concat(AS_STRING(left), len_left, AS_STRING(right), len_right);
+            free_value(left);
+            free_value(right);
+            return result;
         }
-        return (Value){VAL_NIL, {0}};
-    }
-
-    case NODE_TRY_STMT:
-    {
-        jmp_buf old_buf;
-        memcpy(old_buf, global_ex_state.buf, sizeof(jmp_buf));
-        int was_active = global_ex_state.active;
-
-        global_ex_state.active = 1;
-        if (setjmp(global_ex_state.buf) == 0)
+        print_error("Operands must be two numbers or two strings for '+'.");
+        break;
+    case TOKEN_MINUS:
+        if (is_number(left, right))
         {
-            Value res = eval_node(env, n->left);
-
-            memcpy(global_ex_state.buf, old_buf, sizeof(jmp_buf));
-            global_ex_state.active = was_active;
-            return res;
+            return NUMBER_VAL(AS_NUMBER(left) - AS_NUMBER(right));
         }
-        else
+        print_error("Operands must be numbers for '-'.");
+        break;
+    case TOKEN_STAR:
+        if (is_number(left, right))
         {
-            memcpy(global_ex_state.buf, old_buf, sizeof(jmp_buf));
-            global_ex_state.active = was_active;
-
-            Env *catch_env = env_new(env);
-            set_var(catch_env, n->name, global_ex_state.error_val, false, "");
-
-            Value catch_res = eval_node(catch_env, n->right);
+            return NUMBER_VAL(AS_NUMBER(left) * AS_NUMBER(right));
+        }
+        print_error("Operands must be numbers for '*'.");
+        break;
+    case TOKEN_SLASH:
+        if (is_number(left, right))
+        {
+            return NUMBER_VAL(AS_NUMBER(left) / AS_NUMBER(right));
+        }
+        print_error("Operands must be numbers for '/'.");
+        break;
 
-            env_free(catch_env);
+    case TOKEN_PERCENT:
+        if (is_number(left, right))
+        {
 
-            return catch_res;
+            return NUMBER_VAL(fmod(AS_NUMBER(left), AS_NUMBER(right)));
         }
-    }
-    case NODE_RANGE_EXPR:
-    {
-        Value start = eval_node(env, n->left);
-        Value end = eval_node(env, n->right);
-        double step_val = 1.0;
+        print_error("Operands must be numbers for '%'.");
+        break;
 
-        if (n->next != NULL)
+    case TOKEN_GREATER:
+        if (is_number(left, right))
         {
-            Value step_v = eval_node(env, n->next);
-            if (step_v.type == VAL_NUMBER)
-            {
-                step_val = step_v.as.number;
-            }
-            free_value(step_v);
+            return BOOL_VAL(AS_NUMBER(left) > AS_NUMBER(right));
         }
-
-        if (start.type != VAL_NUMBER || end.type != VAL_NUMBER)
+        if (is_string(left, right))
         {
-            free_value(start);
-            free_value(end);
-            return (Value){VAL_NIL, {0}};
+            return BOOL_VAL(strcmp(AS_STRING(left), AS_STRING(right)) > 0);
         }
+        print_error("Operands must be numbers or strings for '>'.");
+        break;
 
-        ValueArray *arr = array_new();
-        double s = start.as.number;
-        double e = end.as.number;
+    case TOKEN_GREATER_EQUAL:
+        if (is_number(left, right))
+        {
+            return BOOL_VAL(AS_NUMBER(left) >= AS_NUMBER(right));
+        }
+        print_error("Operands must be numbers for '>='.");
+        break;
 
-        if (s <= e)
+    case TOKEN_LESS:
+        if (is_number(left, right))
         {
-            for (double i = s; i <= e; i += step_val)
-                array_append(arr, (Value){VAL_NUMBER, {.number = i}});
+            return BOOL_VAL(AS_NUMBER(left) < AS_NUMBER(right));
         }
-        else
+        if (is_string(left, right))
         {
-            for (double i = s; i >= e; i -= step_val)
-                array_append(arr, (Value){VAL_NUMBER, {.number = i}});
+            return BOOL_VAL(strcmp(AS_STRING(left), AS_STRING(right)) < 0);
         }
+        print_error("Operands must be numbers or strings for '<'.");
+        break;
 
-        free_value(start);
-        free_value(end);
-        return (Value){VAL_ARRAY, {.array = arr}};
+    case TOKEN_LESS_EQUAL:
+        if (is_number(left, right))
+        {
+            return BOOL_VAL(AS_NUMBER(left) <= AS_NUMBER(right));
+        }
+        print_error("Operands must be numbers for '<='.");
+        break;
+
+    case TOKEN_EQUAL_EQUAL:
+    {
+        Value eq = eval_equals(left, right);
+        free_value(left);
+        free_value(right);
+        return BOOL_VAL(is_value_truthy(eq));
     }
-    case NODE_MAP_LITERAL:
+
+    case TOKEN_BANG_EQUAL:
     {
-        HashMap *map = map_new();
-        Node *entry = n->left;
-        while (entry)
+        Value eq = eval_equals(left, right);
+        bool is_not_equal = !is_value_truthy(eq);
+        free_value(left);
+        free_value(right);
+        return BOOL_VAL(is_not_equal);
+    }
+    default:
+        print_error("Unknown binary operator.");
+    }
+
+    free_value(left);
+    free_value(right);
+    return NIL_VAL;
+}
+
+/**
+ * @brief Applies an 'as' cast to an evaluated value.
+ * @param val The value to cast, owned by the callee.
+ * @param target_type The type name after 'as'.
+ */
+Value eval_cast(Value val, const char *target_type)
+{
+    if (strcmp(target_type, "String") == 0)
+    {
+        if (VALUE_TYPE(val) == VAL_NUMBER)
         {
-            Value val = eval_node(env, entry->left);
-            map_set(map, entry->name, val);
-            free_value(val);
-            entry = entry->next;
+            char str[32];
+            int length = snprintf(str, sizeof(str), "%g", AS_NUMBER(val));
+            return string_new(str, length);
         }
-        return (Value){VAL_MAP, {.map = map}};
+        return val;
     }
 
-    case NODE_IMPORT:
+    if (strcmp(target_type, "Number") == 0)
     {
-        char *source = read_file(n->name);
-        if (!source)
+        if (VALUE_TYPE(val) == VAL_STRING)
         {
-            printf("Runtime Error: Cannot open import file '%s'\n", n->name);
-            return (Value){VAL_NIL, {0}};
+            double num = atof(AS_STRING(val));
+            free_value(val);
+            return NUMBER_VAL(num);
         }
+        return val;
+    }
 
-        Lexer imp_lex;
-        Parser imp_parser;
-        lexer_init(&imp_lex, source);
-        parser_init(&imp_parser, &imp_lex);
+    print_error("Runtime Error: Cannot cast to type %s", target_type);
+    return NIL_VAL;
+}
 
-        while (imp_parser.current.kind != TOKEN_END)
-        {
-            Node *stmt = parse_stmt(&imp_parser);
-            if (stmt)
-            {
-                Value res = eval_node(env, stmt);
-                free_value(res);
-                free_node(stmt);
-            }
-        }
+/**
+ * @brief Builds the array for a range expression.
+ * @param start The first bound.
+ * @param end The last bound, inclusive.
+ * @param step The step, or VAL_NIL for 1.
+ */
+Value make_range(Value start, Value end, Value step)
+{
+    double step_val = 1.0;
+    if (VALUE_TYPE(step) == VAL_NUMBER)
+    {
+        step_val = AS_NUMBER(step);
+    }
+    free_value(step);
 
-        free(source);
-        return (Value){VAL_NIL, {0}};
+    if (VALUE_TYPE(start) != VAL_NUMBER || VALUE_TYPE(end) != VAL_NUMBER)
+    {
+        free_value(start);
+        free_value(end);
+        return NIL_VAL;
     }
 
-    case NODE_NUMBER:
-        return (Value){VAL_NUMBER, {.number = n->value}};
+    ValueArray *arr = array_new();
+    double s = AS_NUMBER(start);
+    double e = AS_NUMBER(end);
 
-    case NODE_UNARY:
+    if (s <= e)
     {
-        Value right = eval_node(env, n->right);
+        for (double i = s; i <= e; i += step_val)
+            array_append(arr, NUMBER_VAL(i));
+    }
+    else
+    {
+        for (double i = s; i >= e; i -= step_val)
+            array_append(arr, NUMBER_VAL(i));
+    }
 
-        switch (n->op)
+    free_value(start);
+    free_value(end);
+    return ARRAY_VAL(arr);
+}
+
+/**
+ * @brief Returns the interned name of a node, interning it on first use.
+ */
+ObjString *node_key(Node *n)
+{
+    if (n->key == NULL)
+        n->key = string_intern_pinned(n->name);
+    return n->key;
+}
+
+/**
+ * @brief Reads container[index] for arrays and maps.
+ * Takes ownership of both operands.
+ */
+Value index_get(Value container, Value index)
+{
+    if (VALUE_TYPE(container) == VAL_ARRAY)
+    {
+        if (VALUE_TYPE(index) != VAL_NUMBER)
         {
-        case TOKEN_MINUS:
+            print_error("Array index must be a number.");
+            free_value(container);
+            free_value(index);
+            return NIL_VAL;
+        }
+        int idx = (int)AS_NUMBER(index);
+        if (idx < 0 || idx >= AS_ARRAY(container)->count)
         {
-            if (right.type != VAL_NUMBER)
-            {
-                print_error("Operand for '-' must be a number.");
-                free_value(right);
-                return (Value){VAL_NIL, {0}};
-            }
-            double val = -right.as.number;
-            free_value(right);
-            return (Value){VAL_NUMBER, {.number = val}};
+            print_error("Array index out of bounds.");
+            free_value(container);
+            free_value(index);
+            return NIL_VAL;
         }
-
-        case TOKEN_BANG:
+        Value result = copy_value(AS_ARRAY(container)->values[idx]);
+        free_value(container);
+        free_value(index);
+        return result;
+    }
+    else if (VALUE_TYPE(container) == VAL_MAP)
+    {
+        if (VALUE_TYPE(index) != VAL_STRING)
         {
-            bool is_true = is_value_truthy(right);
-            free_value(right);
-            return (Value){VAL_NUMBER, {.number = is_true ? 0.0 : 1.0}};
+            print_error("Map key must be a string.");
+            free_value(container);
+            free_value(index);
+            return NIL_VAL;
         }
-
-        default:
-            break;
+        Value result;
+        ObjString *key = string_object(index);
+        if (key ? map_get_string(AS_MAP(container), key, &result) : map_get(AS_MAP(container), AS_STRING(index), &result))
+        {
+            free_value(container);
+            free_value(index);
+            return copy_value(result);
+        }
+        else
+        {
+            free_value(container);
+            free_value(index);
+            return NIL_VAL;
         }
-        return (Value){VAL_NIL, {0}};
     }
 
-    /**
-     * Strings must be heap-allocated because they are passed around by pointer.
-     */
-    case NODE_STRING:
+    print_error("Invalid access operation (not an array or map).");
+    free_value(container);
+    free_value(index);
+    return NIL_VAL;
+}
+
+/**
+ * @brief Stores container[index] = new_val for arrays and maps.
+ * Takes ownership of the container and index; new_val is returned to the caller.
+ */
+Value index_set(Value container, Value index, Value new_val)
+{
+    if (VALUE_TYPE(container) == VAL_ARRAY)
     {
-        char *str_copy = malloc(strlen(n->name) + 1);
-        if (str_copy)
+        if (VALUE_TYPE(index) != VAL_NUMBER)
+        {
+            print_error("Array index must be a number.");
+            return NIL_VAL;
+        }
+        int idx = (int)AS_NUMBER(index);
+        if (idx < 0 || idx >= AS_ARRAY(container)->count)
         {
-            strcpy(str_copy, n->name);
+            print_error("Array index out of bounds.");
+            return NIL_VAL;
         }
-        return (Value){VAL_STRING, {.string = str_copy}};
+        free_value(AS_ARRAY(container)->values[idx]);
+        AS_ARRAY(container)->values[idx] = copy_value(new_val);
+    }
+    else if (VALUE_TYPE(container) == VAL_MAP)
+    {
+        if (VALUE_TYPE(index) != VAL_STRING)
+        {
+            print_error("Map key must be a string.");
+            return NIL_VAL;
+        }
+        ObjString *key = string_object(index);
+        if (key)
+            map_set_string(AS_MAP(container), key, new_val);
+        else
+            map_set(AS_MAP(container), AS_STRING(index), new_val);
+    }
+    else
+    {
+        print_error("Invalid assignment target.");
     }
 
-    case NODE_WHEN_EXPR:
+    free_value(container);
+    free_value(index);
+    return new_val;
+}
+
+/**
+ * @brief Reads obj.name for structs, maps, enums and instances.
+ * Takes ownership of obj.
+ * @param key The interned property name.
+ * @param cache The call site's inline cache, or NULL.
+ */
+Value get_property(Value obj, ObjString *key, FieldCache *cache)
+{
+    const char *name = key->chars;
+
+    if (VALUE_TYPE(obj) == VAL_NIL)
     {
-        Node *case_node = n->left;
-        Value default_result = (Value){VAL_NIL, {0}};
-        bool found_default = false;
+        return NIL_VAL;
+    }
 
-        while (case_node)
+    if (VALUE_TYPE(obj) == VAL_STRUCT_INSTANCE)
+    {
+        StructInstance *s_inst = AS_STRUCT_INSTANCE(obj);
+        StructDefinition *s_def = s_inst->definition;
+
+        for (int i = 0; i < s_def->field_count; i++)
         {
-            if (case_node->left == NULL)
+            if (s_def->field_names[i] != NULL && strcmp(s_def->field_names[i], name) == 0)
             {
-                default_result = eval_node(env, case_node->right);
-                found_default = true;
+
+                return copy_value(s_inst->values[i]);
             }
-            else
-            {
-                Value cond = eval_node(env, case_node->left);
-                bool is_true = is_value_truthy(cond);
-                free_value(cond);
+        }
 
-                if (is_true)
+        char msg[128];
+        snprintf(msg, sizeof(msg), "Property '%s' not found in struct '%s'.", name, s_def->name);
+        print_error(msg);
+        return NIL_VAL;
+    }
+
+    else if (VALUE_TYPE(obj) == VAL_MAP)
+    {
+        Value result;
+        if (map_get_string(AS_MAP(obj), key, &result))
+        {
+            return copy_value(result);
+        }
+    }
+
+    if (VALUE_TYPE(obj) == VAL_ENUM)
+    {
+        Var *constant = find_var(AS_ENUM(obj)->values, name);
+        if (constant)
+        {
+            return copy_value(constant->value);
+        }
+        print_error("Undefined enum constant.");
+        return NIL_VAL;
+    }
+
+    if (VALUE_TYPE(obj) != VAL_INSTANCE)
+    {
+        print_error("Undefined property.");
+        free_value(obj);
+        return NIL_VAL;
+    }
+
+    Value *field = instance_field(AS_INSTANCE(obj), key, cache);
+    if (field)
+    {
+        Value result = copy_value(*field);
+        free_value(obj);
+        return result;
+    }
+
+    Var *method = find_method(AS_CLASS(*AS_INSTANCE(obj)->class_val), name);
+    if (method)
+    {
+        Value result = copy_value(method->value);
+        free_value(obj);
+        return result;
+    }
+
+    print_error("Undefined property.");
+    free_value(obj);
+    return NIL_VAL;
+}
+
+/**
+ * @brief Stores obj.name = val on a class instance.
+ * Takes ownership of obj and val.
+ * @param key The interned property name.
+ * @param cache The call site's inline cache, or NULL.
+ */
+Value set_property(Value obj, ObjString *key, Value val, FieldCache *cache)
+{
+    if (VALUE_TYPE(obj) != VAL_INSTANCE)
+    {
+        print_error("Only instances have fields.");
+        free_value(obj);
+        free_value(val);
+        return NIL_VAL;
+    }
+
+    if (AS_CLASS(*AS_INSTANCE(obj)->class_val)->is_record)
+    {
+        print_error("Cannot modify field of immutable record instance.");
+        free_value(obj);
+        free_value(val);
+        return NIL_VAL;
+    }
+
+    instance_set_field(AS_INSTANCE(obj), key, val, cache);
+
+    free_value(val);
+
+    return NIL_VAL;
+}
+
+/**
+ * @brief Assigns to the variable a NODE_ASSIGN node refers to.
+ * @param env The environment the assignment runs in.
+ * @param n The NODE_ASSIGN node.
+ * @param val The new value, owned by the callee.
+ * @return A copy of the stored value, or VAL_NIL after reporting an error.
+ */
+Value assign_ident(Env *env, Node *n, Value val)
+{
+    return assign_to_var(find_resolved_var(env, n), n, val);
+}
+
+/**
+ * @brief Body of assign_ident once the variable has been looked up.
+ * @param v The variable, or NULL if the name is not defined.
+ * @param n The NODE_ASSIGN node, for error messages.
+ * @param val The new value, owned by the callee.
+ */
+Value assign_to_var(Var *v, Node *n, Value val)
+{
+    if (v == NULL)
+    {
+        print_error("Runtime Error: Variable '%s' is not defined.", n->name);
+        free_value(val);
+        return NIL_VAL;
+    }
+
+    if (v->is_final || v->is_const)
+    {
+        print_error("Fatal Error: Variable '%s' is marked @final or const and cannot be modified.", n->name);
+        free_value(val);
+        return NIL_VAL;
+    }
+
+    if (v->expected_type[0] != '\0')
+    {
+        const char *actual_type = get_value_type_name(val);
+        if (strcmp(v->expected_type, actual_type) != 0)
+        {
+            print_error("Type Mismatch: Cannot assign '%s' to variable '%s' of type '%s'",
+                        actual_type, v->name, v->expected_type);
+            free_value(val);
+            return NIL_VAL;
+        }
+    }
+
+    free_value(v->value);
+    v->value = val;
+
+    return copy_value(v->value);
+}
+
+/**
+ * @brief Declares the variable of a plain NODE_VARDECL or NODE_CONSTDECL.
+ * Destructuring and @static declarations are handled by eval_node.
+ * @param env The environment to declare in.
+ * @param n The declaration node.
+ * @param val The initial value, owned by the callee.
+ */
+Value declare_var(Env *env, Node *n, Value val)
+{
+    const char *actual_type = get_value_type_name(val);
+    if (n->type_name[0] != '\0' && strcmp(n->type_name, actual_type) != 0)
+    {
+        if (n->kind == NODE_CONSTDECL)
+            print_error("Type Mismatch: '%s' expected but got '%s'", n->type_name, actual_type);
+        else
+            print_error("Type Mismatch: Expected %s but got %s", n->type_name, actual_type);
+        free_value(val);
+        return NIL_VAL;
+    }
+
+    int slot = n->resolve_kind == RESOLVE_LOCAL ? n->scope_slot : -1;
+    Var *v = define_var(env, n->name, slot, val, (n->kind == NODE_CONSTDECL), n->type_name);
+    if (v && n->kind == NODE_VARDECL)
+    {
+        v->is_final = n->is_final;
+    }
+    free_value(val);
+    return NIL_VAL;
+}
+
+/**
+ * @brief Checks that an argument matches a declared parameter type.
+ * Instances match their own class and any superclass named in env.
+ */
+static bool param_type_matches(Env *env, const char *expected_type, Value v)
+{
+    if (strcmp(expected_type, "Array") == 0 && VALUE_TYPE(v) == VAL_ARRAY)
+    {
+        return true;
+    }
+    if (strcmp(expected_type, get_value_type_name(v)) == 0)
+    {
+        return true;
+    }
+    if (VALUE_TYPE(v) == VAL_INSTANCE)
+    {
+        Var *expected_class_var = find_var(env, expected_type);
+        if (expected_class_var && VALUE_TYPE(expected_class_var->value) == VAL_CLASS)
+        {
+            Class *expected_class = AS_CLASS(expected_class_var->value);
+            Class *current_class = AS_CLASS(*AS_INSTANCE(v)->class_val);
+            while (current_class)
+            {
+                if (strcmp(current_class->name, expected_class->name) == 0)
                 {
-                    Value result = eval_node(env, case_node->right);
-                    if (found_default)
-                        free_value(default_result);
-                    return result;
+                    return true;
                 }
+                current_class = current_class->superclass;
             }
-            case_node = case_node->next;
         }
+    }
+    return false;
+}
 
-        return default_result;
+/**
+ * @brief Binds call arguments to a function's parameters, checking declared types.
+ * @param env The caller's environment, used to look up class names.
+ * @param call_env The new call environment.
+ * @param func The function being called.
+ * @param arg_count Number of arguments.
+ * @param args The evaluated arguments; they are copied, not consumed.
+ * @return false after reporting a type mismatch.
+ */
+bool bind_call_args(Env *env, Env *call_env, Func *func, int arg_count, Value *args)
+{
+    Node *param = func->params_head;
+    for (int i = 0; i < arg_count && param; i++)
+    {
+        if (param->type_name[0] != '\0' && !param_type_matches(env, param->type_name, args[i]))
+        {
+            print_error("Type Mismatch for parameter '%s'. Expected '%s' but got '%s'.",
+                        param->name, param->type_name, get_value_type_name(args[i]));
+            return false;
+        }
+
+        set_var(call_env, param->name, args[i], false, "");
+        param = param->next;
     }
+    return true;
+}
 
-    case NODE_MATCH_STMT:
+/**
+ * @brief Checks a function result against its declared return type.
+ * @param func The function that returned.
+ * @param result The returned value, owned by the callee.
+ * @return The result, or VAL_NIL after reporting a mismatch.
+ */
+Value check_return_type(Func *func, Value result)
+{
+    if (func->return_type[0] == '\0')
     {
-        Value m_val = eval_node(env, n->left);
-        Node *c_node = n->right;
-        while (c_node)
+        return result;
+    }
+
+    const char *actual_type = get_value_type_name(result);
+    if (strcmp(func->return_type, "Array") == 0 && VALUE_TYPE(result) == VAL_ARRAY)
+    {
+        return result;
+    }
+    if (strcmp(func->return_type, actual_type) == 0)
+    {
+        return result;
+    }
+
+    print_error("Type Mismatch: Function expected return type '%s' but got '%s'.",
+                func->return_type, actual_type);
+    free_value(result);
+    return NIL_VAL;
+}
+
+/**
+ * @brief Runs a function body in a call environment and unwraps its result.
+ * A body without a return statement yields the value of its last statement.
+ */
+static Value run_body(Env *call_env, Node *body)
+{
+    Value result = eval_node(call_env, body);
+    if (VALUE_TYPE(result) == VAL_RETURN)
+    {
+        Value ret = *AS_RETURN(result);
+        gc_free(AS_RETURN(result));
+        return ret;
+    }
+    return result;
+}
+
+/**
+ * @brief Allocates an instance of a class and fills its fields from the arguments.
+ * @param klass_val The VAL_CLASS value.
+ * @param template_types Generic arguments from the call site, or NULL.
+ * @param arg_count Number of constructor arguments.
+ * @param args The evaluated arguments; they are copied, not consumed.
+ */
+Value new_instance(Value klass_val, Node *template_types, int arg_count, Value *args)
+{
+    Class *klass = AS_CLASS(klass_val);
+    Instance *inst = instance_new(klass_val);
+
+    Node *t_node = template_types;
+    int t_idx = 0;
+    while (t_node && t_idx < 10)
+    {
+        strncpy(inst->templates.names[t_idx++], t_node->name, 63);
+        t_node = t_node->next;
+    }
+    inst->templates.count = t_idx;
+
+    Var *field_def = klass->methods->vars;
+    for (int i = 0; i < arg_count && field_def; i++)
+    {
+        instance_set_field(inst, string_intern(field_def->name, strlen(field_def->name)), args[i], NULL);
+        field_def = field_def->next;
+    }
+
+    return INSTANCE_VAL(inst);
+}
+
+/**
+ * @brief Binds constructor arguments to init's parameters, then 'this'.
+ * Single-letter parameter types K and V resolve to the instance's generic arguments.
+ * @return false after reporting a type mismatch.
+ */
+bool bind_init_args(Env *call_env, Func *init, Value instance, int arg_count, Value *args)
+{
+    Instance *inst = AS_INSTANCE(instance);
+    Node *param_node = init->params_head;
+
+    for (int i = 0; i < arg_count && param_node; i++)
+    {
+        Value arg_val = args[i];
+        const char *actual_type = get_value_type_name(arg_val);
+        const char *expected = param_node->type_name;
+
+        if (expected != NULL && strlen(expected) == 1 && expected[0] >= 'A' && expected[0] <= 'Z')
         {
-            if (c_node->left != NULL)
+            int template_idx = 0;
+            if (expected[0] == 'K')
+                template_idx = 0;
+            else if (expected[0] == 'V')
+                template_idx = 1;
+
+            if (template_idx < inst->templates.count)
             {
-                Value pat = eval_node(env, c_node->left);
-                if (match_pattern(m_val, pat))
-                {
-                    free_value(pat);
-                    Value res = eval_node(env, c_node->right);
-                    free_value(m_val);
-                    return res;
-                }
-                free_value(pat);
+                expected = inst->templates.names[template_idx];
             }
-            else
+        }
+
+        if (expected != NULL && expected[0] != '\0')
+        {
+            bool is_match = false;
+            if (strcmp(expected, actual_type) == 0)
+                is_match = true;
+            else if (is_type_alias_match(expected, arg_val))
+                is_match = true;
+            else if (VALUE_TYPE(arg_val) == VAL_INSTANCE)
+                is_match = true;
+
+            if (!is_match)
             {
-                free_value(m_val);
-                return eval_node(env, c_node->right);
+                print_error("Type Mismatch: Parameter '%s' expects %s, but got %s",
+                            param_node->name, expected, actual_type);
+                return false;
             }
-            c_node = c_node->next;
         }
-        free_value(m_val);
-        return (Value){VAL_NIL, {0}};
+
+        set_var(call_env, param_node->name, arg_val, false, expected);
+        param_node = param_node->next;
+    }
+    set_var(call_env, "this", instance, true, "");
+    return true;
+}
+
+/**
+ * @brief Instantiates a class and runs its init method.
+ */
+static Value construct_instance(Value callee, Node *template_types, int arg_count, Value *args)
+{
+    Value instance_val = new_instance(callee, template_types, arg_count, args);
+
+    Var *init_method = find_method(AS_CLASS(callee), "init");
+    if (init_method)
+    {
+        Func *func = AS_FUNCTION(init_method->value);
+        Env *call_env = env_push(func->env, func->body_head);
+
+        if (!bind_init_args(call_env, func, instance_val, arg_count, args))
+        {
+            env_free(call_env);
+            return NIL_VAL;
+        }
+
+        Value init_result = run_body(call_env, func->body_head);
+        free_value(init_result);
+        env_free(call_env);
+    }
+    return instance_val;
+}
+
+/**
+ * @brief Creates a struct instance, then evaluates its computed fields.
+ */
+static Value construct_struct(Env *env, StructDefinition *s_def, int arg_count, Value *args)
+{
+    StructInstance *s_inst = gc_allocate(sizeof(StructInstance), GC_STRUCT_INSTANCE);
+    s_inst->definition = s_def;
+    s_inst->values = malloc(sizeof(Value) * s_def->field_count);
+
+    for (int i = 0; i < s_def->field_count; i++)
+    {
+        s_inst->values[i] = NIL_VAL;
+    }
+
+    Env *temp_env = env_new(env);
+
+    for (int i = 0; i < s_def->field_count && i < arg_count; i++)
+    {
+        s_inst->values[i] = copy_value(args[i]);
+        set_var(temp_env, s_def->field_names[i], args[i], false, "");
+    }
+
+    if (s_def->computed_body != NULL)
+    {
+        Node *stmt = s_def->computed_body;
+        while (stmt)
+        {
+            if (stmt->kind == NODE_VARDECL)
+            {
+                eval_node(temp_env, stmt);
+                Var *v = find_var(temp_env, stmt->name);
+                if (v)
+                {
+                    for (int j = 0; j < s_def->field_count; j++)
+                    {
+                        if (strcmp(s_def->field_names[j], stmt->name) == 0)
+                        {
+                            s_inst->values[j] = copy_value(v->value);
+                            break;
+                        }
+                    }
+                }
+            }
+            stmt = stmt->next;
+        }
+    }
+
+    env_free(temp_env);
+    return MAKE_VALUE(VAL_STRUCT_INSTANCE, struct_instance, s_inst);
+}
+
+/**
+ * @brief Calls a function, native, class or struct with evaluated arguments.
+ * @param env The caller's environment.
+ * @param callee The value being called.
+ * @param template_types Generic arguments from the call site, or NULL.
+ * @param arg_count Number of arguments.
+ * @param args The evaluated arguments; the caller still owns and frees them.
+ * @return The call result.
+ */
+Value call_value(Env *env, Value callee, Node *template_types, int arg_count, Value *args)
+{
+    if (VALUE_TYPE(callee) == VAL_CLASS)
+    {
+        return construct_instance(callee, template_types, arg_count, args);
+    }
+
+    if (VALUE_TYPE(callee) == VAL_STRUCT_DEF)
+    {
+        return construct_struct(env, AS_STRUCT_DEF(callee), arg_count, args);
+    }
+
+    if (VALUE_TYPE(callee) == VAL_FUNCTION)
+    {
+        if (AS_FUNCTION(callee)->is_parallel)
+        {
+            return task_spawn(callee, arg_count, args);
+        }
+        if (AS_FUNCTION(callee)->is_async)
+        {
+            return async_spawn(callee, arg_count, args);
+        }
+        return call_function(env, AS_FUNCTION(callee), arg_count, args);
+    }
+
+    if (VALUE_TYPE(callee) == VAL_NATIVE)
+    {
+        return AS_NATIVE(callee)(arg_count, args);
+    }
+
+    return NIL_VAL;
+}
+
+/**
+ * @brief Calls a Jackal function on the current thread, even if it is @parallel.
+ * @param env The caller's environment, used to look up class names in parameter types.
+ * @param func The function.
+ * @param arg_count Number of arguments.
+ * @param args The evaluated arguments; the caller still owns and frees them.
+ * @return The call result.
+ */
+Value call_function(Env *env, Func *func, int arg_count, Value *args)
+{
+    Env *call_env = env_push(func->env, func->body_head);
+
+    if (!bind_call_args(env, call_env, func, arg_count, args))
+    {
+        env_free(call_env);
+        return NIL_VAL;
+    }
+
+    Value result = run_body(call_env, func->body_head);
+    env_free(call_env);
+    return check_return_type(func, result);
+}
+
+/**
+ * @brief Looks up a method on an instance for a call.
+ * Reports undefined and private methods, and warns about deprecated ones.
+ * @param obj The receiver instance.
+ * @param name The method name.
+ * @param from_this Whether the receiver expression was 'this'.
+ * @param cache The call site's inline cache, or NULL.
+ * @return The method, or NULL after reporting an error.
+ */
+Func *lookup_method(Value obj, const char *name, bool from_this, MethodCache *cache)
+{
+    Class *klass = AS_CLASS(*AS_INSTANCE(obj)->class_val);
+    Var *method_var = class_method(klass, name, cache);
+    if (!method_var)
+        method_var = find_method(klass, name);
+    if (!method_var || VALUE_TYPE(method_var->value) != VAL_FUNCTION)
+    {
+        print_error("Undefined method.");
+        return NULL;
+    }
+
+    Func *func = AS_FUNCTION(method_var->value);
+
+    if (func->is_private && !from_this)
+    {
+        print_error("Cannot access private method '%s' outside of class context.", name);
+        return NULL;
+    }
+    if (func->is_deprecated)
+    {
+        printf("Warning: Method '%s' is deprecated.\n", name);
+    }
+    return func;
+}
+
+/**
+ * @brief Binds method arguments to parameters, then 'this'.
+ */
+void bind_method_args(Env *call_env, Func *func, Value receiver, int arg_count, Value *args)
+{
+    Node *param = func->params_head;
+    for (int i = 0; i < arg_count && param; i++)
+    {
+        set_var(call_env, param->name, args[i], false, "");
+        param = param->next;
+    }
+    set_var(call_env, "this", receiver, true, "");
+}
+
+/**
+ * @brief Runs a method body with 'this' bound to the receiver.
+ * Only an explicit return produces a value; falling off the end yields nil.
+ * @param func The method, as returned by lookup_method.
+ * @param receiver The instance the method was looked up on.
+ * @param arg_count Number of arguments.
+ * @param args The evaluated arguments; the caller still owns and frees them.
+ */
+Value call_method(Func *func, Value receiver, int arg_count, Value *args)
+{
+    Env *call_env = env_push(func->env, func->body_head);
+    bind_method_args(call_env, func, receiver, arg_count, args);
+
+    Value res = eval_node(call_env, func->body_head);
+
+    env_free(call_env);
+
+    if (VALUE_TYPE(res) == VAL_RETURN)
+    {
+        Value ret = *AS_RETURN(res);
+        gc_free(AS_RETURN(res));
+        return ret;
+    }
+    free_value(res);
+    return NIL_VAL;
+}
+
+/**
+ * @brief Calls obj.name(args) for instances, the natives stored in maps and
+ * the methods registered for built-in types.
+ * @param env The caller's environment.
+ * @param obj The receiver.
+ * @param name The interned method name.
+ * @param arg_count Number of arguments.
+ * @param args The evaluated arguments; the caller still owns and frees them.
+ * @param from_this Whether the receiver expression was 'this'.
+ * @param cache The call site's inline cache, or NULL.
+ */
+Value invoke_method(Env *env, Value obj, ObjString *name, int arg_count, Value *args, bool from_this, MethodCache *cache)
+{
+    if (VALUE_TYPE(obj) == VAL_INSTANCE)
+    {
+        Func *func = lookup_method(obj, name->chars, from_this, cache);
+        if (!func)
+        {
+            return NIL_VAL;
+        }
+        return call_method(func, obj, arg_count, args);
     }
 
-    case NODE_WITH:
+    if (VALUE_TYPE(obj) == VAL_MAP)
     {
-        Value obj = eval_node(env, n->left);
-        Env *with_env = env_new(env);
-
-        if (obj.type == VAL_INSTANCE)
-        {
-            Var *v = obj.as.instance->fields->vars;
-            while (v)
-            {
-                set_var(with_env, v->name, v->value, false, "");
-                v = v->next;
-            }
-        }
-        else if (obj.type == VAL_MAP)
+        Value method_val;
+        if (map_get_string(AS_MAP(obj), name, &method_val))
         {
-            HashMap *map = obj.as.map;
-            for (int i = 0; i < map->capacity; i++)
+            if (VALUE_TYPE(method_val) != VAL_NATIVE)
             {
-                if (map->entries[i].key != NULL)
-                {
-                    set_var(with_env, map->entries[i].key, map->entries[i].value, false, "");
-                }
+                print_error("Map value is not a callable function.");
+                return NIL_VAL;
             }
+            return AS_NATIVE(method_val)(arg_count, args);
         }
+    }
 
-        set_var(with_env, "it", obj, true, "");
+    BuiltinMethod method = builtin_method(VALUE_TYPE(obj), name, cache);
+    if (method)
+    {
+        return method(env, obj, arg_count, args);
+    }
 
-        Value result = eval_node(with_env, n->right);
+    switch (VALUE_TYPE(obj))
+    {
+    case VAL_NUMBER:
+        print_error("Undefined method '%s' for Number.", name->chars);
+        break;
+    case VAL_MAP:
+        print_error("Undefined method for Map.");
+        break;
+    case VAL_ARRAY:
+        print_error("Undefined method for Array.");
+        break;
+    case VAL_STRING:
+        print_error("Undefined method for String.");
+        break;
+    case VAL_DATAFRAME:
+        print_error("Undefined method '%s' for DataFrame.", name->chars);
+        break;
+    case VAL_CSV_CURSOR:
+        print_error("Undefined method '%s' for CsvCursor.", name->chars);
+        break;
+    case VAL_CSV_WRITER:
+        print_error("Undefined method '%s' for CsvWriter.", name->chars);
+        break;
+    default:
+        print_error("Only instances, arrays, and strings have methods.");
+        break;
+    }
+    return NIL_VAL;
+}
+
+/**
+ * @brief Creates the class object for a NODE_CLASS_DEF, resolving its
+ * superclass and interface. Methods are added by the caller.
+ * @return The class, or NULL after reporting an invalid superclass.
+ */
+Class *begin_class(Env *env, Node *n)
+{
+    if (strlen(n->super_name) > 0)
+    {
+        Var *super_var = find_var(env, n->super_name);
+        if (!super_var || VALUE_TYPE(super_var->value) != VAL_CLASS)
+        {
+            print_error("Superclass '%s' not found or invalid.", n->super_name);
+            return NULL;
+        }
 
-        if (obj.type == VAL_FILE && obj.as.file != NULL)
+        if (super_var->is_final)
         {
-            fclose(obj.as.file);
+            print_error("Fatal Error: Cannot inherit from @final class '%s'.", n->super_name);
+            exit(1);
         }
+    }
 
-        env_free(with_env);
-        free_value(obj);
-        return result;
+    Class *class_obj = gc_allocate(sizeof(Class), GC_CLASS);
+    strcpy(class_obj->name, n->name);
+    class_obj->methods = env_new(env);
+    class_obj->superclass = NULL;
+    class_obj->interface = NULL;
+    class_obj->is_record = n->is_record;
+    class_obj->shape = shape_new_root();
+
+    if (strlen(n->super_name) > 0)
+    {
+        Var *super_var = find_var(env, n->super_name);
+        class_obj->superclass = AS_CLASS(super_var->value);
     }
 
-    case NODE_ARRAY_LITERAL:
+    if (strlen(n->interface_name) > 0)
     {
-        ValueArray *arr = array_new();
-        Node *item = n->left;
-        for (int i = 0; i < n->arity; i++)
+        Var *iface_var = find_var(env, n->interface_name);
+        if (iface_var && VALUE_TYPE(iface_var->value) == VAL_INTERFACE)
         {
-            Value val = eval_node(env, item);
-            array_append(arr, val);
-            item = item->next;
+            class_obj->interface = AS_INTERFACE(iface_var->value);
         }
-        return (Value){VAL_ARRAY, {.array = arr}};
     }
 
-    case NODE_ARRAY_ACCESS:
-    {
-        Value container = eval_node(env, n->left);
-        Value index = eval_node(env, n->right);
-
-        /**
-         * Unused variables to hold evaluated values.
-         */
+    return class_obj;
+}
 
-        if (container.type == VAL_ARRAY)
+/**
+ * @brief Checks @override markers and interface methods once all methods
+ * of a class are defined, then binds the class name in env.
+ */
+void end_class(Env *env, Node *n, Class *class_obj)
+{
+    Node *check_node = n->left;
+    while (check_node)
+    {
+        if (check_node->is_override)
         {
-            if (index.type != VAL_NUMBER)
-            {
-                print_error("Array index must be a number.");
-                free_value(container);
-                free_value(index);
-                return (Value){.type = VAL_NIL, .as = {0}};
-            }
-            int idx = (int)index.as.number;
-            if (idx < 0 || idx >= container.as.array->count)
+            bool found_in_parent = false;
+            if (class_obj->superclass != NULL)
             {
-                print_error("Array index out of bounds.");
-                free_value(container);
-                free_value(index);
-                return (Value){.type = VAL_NIL, .as = {0}};
+                if (find_method(class_obj->superclass, check_node->name) != NULL)
+                {
+                    found_in_parent = true;
+                }
             }
-            Value result = copy_value(container.as.array->values[idx]);
-            free_value(container);
-            free_value(index);
-            return result;
-        }
-        else if (container.type == VAL_MAP)
-        {
-            if (index.type != VAL_STRING)
+            if (!found_in_parent && class_obj->interface != NULL)
             {
-                print_error("Map key must be a string.");
-                free_value(container);
-                free_value(index);
-                return (Value){.type = VAL_NIL, .as = {0}};
+                if (find_var(class_obj->interface->methods, check_node->name) != NULL)
+                {
+                    found_in_parent = true;
+                }
             }
-            Value result;
-            if (map_get(container.as.map, index.as.string, &result))
+            if (!found_in_parent)
             {
-                free_value(container);
-                free_value(index);
-                return copy_value(result);
+                print_error("Method '%s' marked @override but does not override any method.", check_node->name);
             }
-            else
+        }
+        check_node = check_node->next;
+    }
+
+    if (class_obj->interface)
+    {
+        Interface *iface = class_obj->interface;
+        Var *required_method = iface->methods->vars;
+        while (required_method)
+        {
+            Var *implemented = find_method(class_obj, required_method->name);
+            if (!implemented)
             {
-                free_value(container);
-                free_value(index);
-                return (Value){.type = VAL_NIL, .as = {0}};
+                print_error("Class '%s' must implement method '%s' from interface '%s'.", class_obj->name, required_method->name, iface->name);
             }
+            required_method = required_method->next;
         }
+    }
 
-        print_error("Invalid access operation (not an array or map).");
-        free_value(container);
-        free_value(index);
-        return (Value){.type = VAL_NIL, .as = {0}};
+    Value class_val = CLASS_VAL(class_obj);
+    set_var(env, n->name, class_val, true, "");
+
+    Var *v_class = find_var(env, n->name);
+    if (v_class)
+    {
+        v_class->is_final = n->is_final;
     }
+}
 
-    case NODE_ARRAY_ASSIGN:
+/**
+ * @brief Main evaluation function.
+ * Recursively evaluates an AST node in a given environment.
+ * @param env The current variable environment.
+ * @param n The AST node to evaluate.
+ * @return The result of the evaluation as a Value.
+ */
+
+Value eval_node(Env *env, Node *n)
+{
+
+    if (!n)
+        return NIL_VAL;
+
+    switch (n->kind)
     {
-        Value new_val = eval_node(env, n->right);
 
-        Node *access_node = n->left;
+    case NODE_BOOL:
+        return BOOL_VAL((n->value != 0.0));
 
-        Value container = eval_node(env, access_node->left);
-        Value index = eval_node(env, access_node->right);
+    case NODE_FUNC_EXPR:
+        return make_function(env, n);
+
+    case NODE_BREAK_STMT:
+        return MAKE_VALUE(VAL_BREAK, pointer, NULL);
+
+    case NODE_CONTINUE_STMT:
+        return MAKE_VALUE(VAL_CONTINUE, pointer, NULL);
+
+    case NODE_ENUM_DEF:
+    {
+        Enum *en = gc_allocate(sizeof(Enum), GC_ENUM);
+        strcpy(en->name, n->name);
+        en->values = env_new(NULL);
 
-        if (container.type == VAL_ARRAY)
+        Node *entry = n->left;
+        while (entry)
         {
-            if (index.type != VAL_NUMBER)
-            {
-                print_error("Array index must be a number.");
-                return (Value){.type = VAL_NIL, .as = {0}};
-            }
-            int idx = (int)index.as.number;
-            if (idx < 0 || idx >= container.as.array->count)
+            Value val;
+            if (entry->kind == NODE_STRING)
             {
-                print_error("Array index out of bounds.");
-                return (Value){.type = VAL_NIL, .as = {0}};
+                val = string_copy(entry->string_value);
             }
-            free_value(container.as.array->values[idx]);
-            container.as.array->values[idx] = copy_value(new_val);
-        }
-        else if (container.type == VAL_MAP)
-        {
-            if (index.type != VAL_STRING)
+            else
             {
-                print_error("Map key must be a string.");
-                return (Value){.type = VAL_NIL, .as = {0}};
+                val = NUMBER_VAL(entry->value);
             }
-            map_set(container.as.map, index.as.string, new_val);
-        }
-        else
-        {
-            print_error("Invalid assignment target.");
+
+            set_var(en->values, entry->name, val, true, "");
+            entry = entry->next;
         }
 
-        free_value(container);
-        free_value(index);
-        return new_val;
+        Value enum_val = MAKE_VALUE(VAL_ENUM, enum_obj, en);
+        set_var(env, n->name, enum_val, true, "");
+        return NIL_VAL;
     }
 
-    case NODE_IDENT:
+    case NODE_THROW_STMT:
     {
-        Var *v = find_var(env, n->name);
-        if (!v)
-        {
-            print_error("Undefined identifier '%s'.", n->name);
-            return (Value){.type = VAL_NIL, .as = {0}};
-        }
-        return copy_value(v->value);
+        throw_value(eval_node(env, n->left));
+        return NIL_VAL;
     }
 
-    case NODE_THIS:
+    case NODE_TRY_STMT:
     {
-        Var *v = find_var(env, n->name);
-        if (!v)
+        jmp_buf old_buf;
+        memcpy(old_buf, global_ex_state.buf, sizeof(jmp_buf));
+        int was_active = global_ex_state.active;
+
+        global_ex_state.active = 1;
+        if (setjmp(global_ex_state.buf) == 0)
         {
-            print_error("'this' is not defined.");
-            return (Value){.type = VAL_NIL, .as = {0}};
+            Value res = eval_node(env, n->left);
+
+            memcpy(global_ex_state.buf, old_buf, sizeof(jmp_buf));
+            global_ex_state.active = was_active;
+            return res;
         }
-        return copy_value(v->value);
-    }
+        else
+        {
+            memcpy(global_ex_state.buf, old_buf, sizeof(jmp_buf));
+            global_ex_state.active = was_active;
 
-  case NODE_ASSIGN:
-{
-    Var *v = find_var(env, n->name);
+            Env *catch_env = env_new(env);
+            set_var(catch_env, n->name, global_ex_state.error_val, false, "");
 
-    if (v == NULL)
+            Value catch_res = eval_node(catch_env, n->right);
+
+            env_free(catch_env);
+
+            return catch_res;
+        }
+    }
+    case NODE_RANGE_EXPR:
     {
-        print_error("Runtime Error: Variable '%s' is not defined.", n->name);
-        return (Value){VAL_NIL, {0}};
+        Value start = eval_node(env, n->left);
+        Value end = eval_node(env, n->right);
+        Value step = eval_node(env, n->next);
+        return make_range(start, end, step);
     }
-
-    if (v->is_final || v->is_const)
+    case NODE_MAP_LITERAL:
     {
-        print_error("Fatal Error: Variable '%s' is marked @final or const and cannot be modified.", n->name);
-        return (Value){VAL_NIL, {0}};
+        HashMap *map = map_new();
+        Node *entry = n->left;
+        while (entry)
+        {
+            Value val = eval_node(env, entry->left);
+            map_set_string(map, node_key(entry), val);
+            free_value(val);
+            entry = entry->next;
+        }
+        return MAP_VAL(map);
     }
 
-    Value val = eval_node(env, n->right);
-
-    if (v->expected_type[0] != '\0')
+    case NODE_IMPORT:
     {
-        const char *actual_type = get_value_type_name(val);
-        if (strcmp(v->expected_type, actual_type) != 0)
+        if (!module_import(env, n->name))
         {
-            print_error("Type Mismatch: Cannot assign '%s' to variable '%s' of type '%s'",
-                        actual_type, v->name, v->expected_type);
-            free_value(val);
-            return (Value){VAL_NIL, {0}};
+            printf("Runtime Error: Cannot open import file '%s'\n", n->name);
         }
+        return NIL_VAL;
     }
 
-    free_value(v->value);
-    v->value = copy_value(val);
+    case NODE_NUMBER:
+        return NUMBER_VAL(n->value);
 
-    return v->value;
-}
-    case NODE_CONSTDECL:
+    case NODE_UNARY:
     {
-        Value val = eval_node(env, n->right);
-        const char *actual_type = get_value_type_name(val);
+        Value right = eval_node(env, n->right);
 
-        if (n->type_name[0] != '\0' && strcmp(n->type_name, actual_type) != 0)
+        switch (n->op)
         {
-            print_error("Type Mismatch: '%s' expected but got '%s'", n->type_name, actual_type);
-            free_value(val);
-            return (Value){VAL_NIL, {0}};
+        case TOKEN_MINUS:
+        {
+            if (VALUE_TYPE(right) != VAL_NUMBER)
+            {
+                print_error("Operand for '-' must be a number.");
+                free_value(right);
+                return NIL_VAL;
+            }
+            double val = -AS_NUMBER(right);
+            free_value(right);
+            return NUMBER_VAL(val);
         }
 
-        set_var(env, n->name, val, (n->kind == NODE_CONSTDECL), n->type_name);
-        free_value(val);
-        return (Value){VAL_NIL, {0}};
+        case TOKEN_BANG:
+        {
+            bool is_true = is_value_truthy(right);
+            free_value(right);
+            return NUMBER_VAL(is_true ? 0.0 : 1.0);
+        }
+
+        default:
+            break;
+        }
+        return NIL_VAL;
     }
 
-    case NODE_GET:
+    /**
+     * Literals are interned once and shared by every evaluation.
+     */
+    case NODE_STRING:
+        return string_value(node_key(n));
+
+    case NODE_WHEN_EXPR:
     {
-        Value obj = eval_node(env, n->left);
+        Node *case_node = n->left;
+        Value default_result = NIL_VAL;
+        bool found_default = false;
 
-        if (obj.type == VAL_NIL)
+        while (case_node)
         {
-            return (Value){.type = VAL_NIL, .as = {.number = 0}};
+            if (case_node->left == NULL)
+            {
+                default_result = eval_node(env, case_node->right);
+                found_default = true;
+            }
+            else
+            {
+                Value cond = eval_node(env, case_node->left);
+                bool is_true = is_value_truthy(cond);
+                free_value(cond);
+
+                if (is_true)
+                {
+                    Value result = eval_node(env, case_node->right);
+                    if (found_default)
+                        free_value(default_result);
+                    return result;
+                }
+            }
+            case_node = case_node->next;
         }
 
-        if (obj.type == VAL_STRUCT_INSTANCE)
+        return default_result;
+    }
+
+    case NODE_MATCH_STMT:
+    {
+        Value m_val = eval_node(env, n->left);
+        Node *c_node = n->right;
+        while (c_node)
         {
-            StructInstance *s_inst = obj.as.struct_instance;
-            StructDefinition *s_def = s_inst->definition;
-
-            for (int i = 0; i < s_def->field_count; i++)
+            if (c_node->left != NULL)
             {
-                if (s_def->field_names[i] != NULL && strcmp(s_def->field_names[i], n->name) == 0)
+                Value pat = eval_node(env, c_node->left);
+                if (match_pattern(m_val, pat))
                 {
-
-                    return copy_value(s_inst->values[i]);
+                    free_value(pat);
+                    Value res = eval_node(env, c_node->right);
+                    free_value(m_val);
+                    return res;
                 }
+                free_value(pat);
             }
-
-            char msg[128];
-            snprintf(msg, sizeof(msg), "Property '%s' not found in struct '%s'.", n->name, s_def->name);
-            print_error(msg);
-            return (Value){VAL_NIL, {0}};
+            else
+            {
+                free_value(m_val);
+                return eval_node(env, c_node->right);
+            }
+            c_node = c_node->next;
         }
+        free_value(m_val);
+        return NIL_VAL;
+    }
+
+    case NODE_WITH:
+    {
+        Value obj = eval_node(env, n->left);
+        Env *with_env = env_new(env);
 
-        else if (obj.type == VAL_MAP)
+        if (VALUE_TYPE(obj) == VAL_INSTANCE)
         {
-            Value result;
-            if (map_get(obj.as.map, n->name, &result))
+            Instance *inst = AS_INSTANCE(obj);
+            for (int i = inst->shape->slot_count - 1; i >= 0; i--)
             {
-                return copy_value(result);
+                set_var(with_env, inst->shape->names[i]->chars, inst->fields[i], false, "");
             }
         }
-
-        if (obj.type == VAL_ENUM)
+        else if (VALUE_TYPE(obj) == VAL_MAP)
         {
-            Var *constant = find_var(obj.as.enum_obj->values, n->name);
-            if (constant)
+            HashMap *map = AS_MAP(obj);
+            for (int i = 0; i < map->capacity; i++)
             {
-                return copy_value(constant->value);
+                if (map->entries[i].key != NULL)
+                {
+                    set_var(with_env, map->entries[i].key, map->entries[i].value, false, "");
+                }
             }
-            print_error("Undefined enum constant.");
-            return (Value){VAL_NIL, {0}};
         }
 
-        Var *field = find_var(obj.as.instance->fields, n->name);
-        if (field)
+        set_var(with_env, "it", obj, true, "");
+
+        Value result = eval_node(with_env, n->right);
+
+        if (VALUE_TYPE(obj) == VAL_FILE && AS_FILE(obj) != NULL)
         {
-            Value result = copy_value(field->value);
-            free_value(obj);
-            return result;
+            fclose(AS_FILE(obj));
         }
 
-        Var *method = find_method(obj.as.instance->class_val->as.class_obj, n->name);
-        if (method)
+        env_free(with_env);
+        free_value(obj);
+        return result;
+    }
+
+    case NODE_ARRAY_LITERAL:
+    {
+        ValueArray *arr = array_new();
+        Node *item = n->left;
+        for (int i = 0; i < n->arity; i++)
         {
-            Value result = copy_value(method->value);
-            free_value(obj);
-            return result;
+            Value val = eval_node(env, item);
+            array_append(arr, val);
+            item = item->next;
         }
+        return ARRAY_VAL(arr);
+    }
 
-        print_error("Undefined property.");
-        free_value(obj);
-        return (Value){.type = VAL_NIL, .as = {0}};
+    case NODE_ARRAY_ACCESS:
+    {
+        Value container = eval_node(env, n->left);
+        Value index = eval_node(env, n->right);
+        return index_get(container, index);
     }
 
-    case NODE_SET:
+    case NODE_ARRAY_ASSIGN:
     {
-        Value obj = eval_node(env, n->left->left);
-        if (obj.type != VAL_INSTANCE)
+        Value new_val = eval_node(env, n->right);
+
+        Node *access_node = n->left;
+
+        Value container = eval_node(env, access_node->left);
+        Value index = eval_node(env, access_node->right);
+        return index_set(container, index, new_val);
+    }
+
+    case NODE_IDENT:
+    {
+        Var *v = find_resolved_var(env, n);
+        if (!v)
         {
-            print_error("Only instances have fields.");
-            free_value(obj);
-            return (Value){.type = VAL_NIL, .as = {0}};
+            print_error("Undefined identifier '%s'.", n->name);
+            return NIL_VAL;
         }
+        return copy_value(v->value);
+    }
 
-        if (obj.as.instance->class_val->as.class_obj->is_record)
+    case NODE_THIS:
+    {
+        Var *v = find_resolved_var(env, n);
+        if (!v)
         {
-            print_error("Cannot modify field of immutable record instance.");
-            free_value(obj);
-            return (Value){.type = VAL_NIL, .as = {0}};
+            print_error("'this' is not defined.");
+            return NIL_VAL;
         }
+        return copy_value(v->value);
+    }
 
-        Value val = eval_node(env, n->right);
+    case NODE_ASSIGN:
+        return assign_ident(env, n, eval_node(env, n->right));
 
-        set_var(obj.as.instance->fields, n->left->name, val, false, "");
+    case NODE_CONSTDECL:
+        return declare_var(env, n, eval_node(env, n->right));
 
-        free_value(val);
+    case NODE_GET:
+        return get_property(eval_node(env, n->left), node_key(n), &n->field_cache);
 
-        return (Value){.type = VAL_NIL, .as = {0}};
+    case NODE_SET:
+    {
+        Value obj = eval_node(env, n->left->left);
+        Value val = eval_node(env, n->right);
+        return set_property(obj, node_key(n->left), val, &n->left->field_cache);
     }
 
     case NODE_WHERE:
     {
         Value left_val = eval_node(env, n->left);
 
-        if (left_val.type != VAL_ARRAY)
+        if (VALUE_TYPE(left_val) != VAL_ARRAY)
         {
             print_error("'where' operator can only be used on Arrays.");
             free_value(left_val);
-            return (Value){VAL_NIL, {0}};
+            return NIL_VAL;
         }
 
-        ValueArray *source = left_val.as.array;
+        ValueArray *source = AS_ARRAY(left_val);
         ValueArray *filtered = array_new();
 
         Env *where_env = env_new(env);
@@ -1087,7 +1925,7 @@ Value eval_node(Env *env, Node *n)
 
         env_free(where_env);
         free_value(left_val);
-        return (Value){VAL_ARRAY, {.array = filtered}};
+        return ARRAY_VAL(filtered);
     }
 
     case NODE_POST_INC:
@@ -1098,47 +1936,47 @@ Value eval_node(Env *env, Node *n)
         if (lvalue == NULL)
         {
             print_error("Runtime Error: Invalid left-hand side in assignment.");
-            return (Value){VAL_NIL, {0}};
+            return NIL_VAL;
         }
 
         if (lvalue->kind == NODE_IDENT)
         {
 
-            Var *v = find_var(env, lvalue->name);
-            if (v == NULL || v->value.type != VAL_NUMBER)
+            Var *v = find_resolved_var(env, lvalue);
+            if (v == NULL || VALUE_TYPE(v->value) != VAL_NUMBER)
             {
                 print_error("Operand for '++' must be a number variable.");
-                return (Value){.type = VAL_NIL, .as = {0}};
+                return NIL_VAL;
             }
-            double old_val = v->value.as.number;
-            v->value.as.number++;
-            return (Value){VAL_NUMBER, {.number = old_val}};
+            double old_val = AS_NUMBER(v->value);
+            v->value = NUMBER_VAL(old_val + 1);
+            return NUMBER_VAL(old_val);
         }
         else if (lvalue->kind == NODE_GET)
         {
             Value obj = eval_node(env, lvalue->left);
-            if (obj.type != VAL_INSTANCE)
+            if (VALUE_TYPE(obj) != VAL_INSTANCE)
             {
                 print_error("Invalid l-value for '++'.");
-                return (Value){.type = VAL_NIL, .as = {0}};
+                return NIL_VAL;
             }
 
-            Var *v = find_var(obj.as.instance->fields, lvalue->name);
-            if (v == NULL || v->value.type != VAL_NUMBER)
+            Value *field = instance_field(AS_INSTANCE(obj), node_key(lvalue), &lvalue->field_cache);
+            if (field == NULL || VALUE_TYPE(*field) != VAL_NUMBER)
             {
                 print_error("Operand for '++' must be a number property.");
                 free_value(obj);
-                return (Value){.type = VAL_NIL, .as = {0}};
+                return NIL_VAL;
             }
 
-            double old_val = v->value.as.number;
-            v->value.as.number++;
+            double old_val = AS_NUMBER(*field);
+            *field = NUMBER_VAL(old_val + 1);
             free_value(obj);
-            return (Value){VAL_NUMBER, {.number = old_val}};
+            return NUMBER_VAL(old_val);
         }
 
         print_error("Invalid l-value for '++'.");
-        return (Value){.type = VAL_NIL, .as = {0}};
+        return NIL_VAL;
     }
 
     case NODE_POST_DEC:
@@ -1147,50 +1985,46 @@ Value eval_node(Env *env, Node *n)
 
         if (lvalue->kind == NODE_IDENT)
         {
-            Var *v = find_var(env, lvalue->name);
-            if (v == NULL || v->value.type != VAL_NUMBER)
+            Var *v = find_resolved_var(env, lvalue);
+            if (v == NULL || VALUE_TYPE(v->value) != VAL_NUMBER)
             {
                 print_error("Operand for '--' must be a number variable.");
-                return (Value){.type = VAL_NIL, .as = {0}};
+                return NIL_VAL;
             }
-            double old_val = v->value.as.number;
-            v->value.as.number--;
-            return (Value){VAL_NUMBER, {.number = old_val}};
+            double old_val = AS_NUMBER(v->value);
+            v->value = NUMBER_VAL(old_val - 1);
+            return NUMBER_VAL(old_val);
         }
         else if (lvalue->kind == NODE_GET)
         {
 
             Value obj = eval_node(env, lvalue->left);
-            if (obj.type != VAL_INSTANCE)
+            if (VALUE_TYPE(obj) != VAL_INSTANCE)
             {
                 print_error("Invalid l-value for '--'.");
-                return (Value){.type = VAL_NIL, .as = {0}};
+                return NIL_VAL;
             }
 
-            Var *v = find_var(obj.as.instance->fields, lvalue->name);
-            if (v == NULL || v->value.type != VAL_NUMBER)
+            Value *field = instance_field(AS_INSTANCE(obj), node_key(lvalue), &lvalue->field_cache);
+            if (field == NULL || VALUE_TYPE(*field) != VAL_NUMBER)
             {
                 print_error("Operand for '--' must be a number property.");
                 free_value(obj);
-                return (Value){.type = VAL_NIL, .as = {0}};
+                return NIL_VAL;
             }
 
-            double old_val = v->value.as.number;
-            v->value.as.number--;
+            double old_val = AS_NUMBER(*field);
+            *field = NUMBER_VAL(old_val - 1);
             free_value(obj);
-            return (Value){VAL_NUMBER, {.number = old_val}};
+            return NUMBER_VAL(old_val);
         }
 
         print_error("Invalid l-value for '--'.");
-        return (Value){.type = VAL_NIL, .as = {0}};
+        return NIL_VAL;
     }
 
     case NODE_BINOP:
     {
-
-        Value left = eval_node(env, n->left);
-        Value right = eval_node(env, n->right);
-
         /**
          * Token (||)
          * Or
@@ -1208,33 +2042,7 @@ Value eval_node(Env *env, Node *n)
 
         if (n->op == TOKEN_AS)
         {
-            Value val = eval_node(env, n->left);
-            const char *target_type = n->type_name;
-
-            if (strcmp(target_type, "String") == 0)
-            {
-                if (val.type == VAL_NUMBER)
-                {
-                    char *str = malloc(32);
-                    snprintf(str, 32, "%g", val.as.number);
-                    return (Value){VAL_STRING, {.string = str}};
-                }
-                return val;
-            }
-
-            if (strcmp(target_type, "Number") == 0)
-            {
-                if (val.type == VAL_STRING)
-                {
-                    double num = atof(val.as.string);
-                    free_value(val);
-                    return (Value){VAL_NUMBER, {.number = num}};
-                }
-                return val;
-            }
-
-            print_error("Runtime Error: Cannot cast to type %s", target_type);
-            return (Value){VAL_NIL, {0}};
+            return eval_cast(eval_node(env, n->left), n->type_name);
         }
 
         /**
@@ -1252,174 +2060,61 @@ Value eval_node(Env *env, Node *n)
             return eval_node(env, n->right);
         }
 
-        switch (n->op)
-        {
-        case TOKEN_PLUS:
-            if (is_number(left, right))
-            {
-                return (Value){VAL_NUMBER, {.number = left.as.number + right.as.number}};
-            }
-            if (is_string(left, right))
-            {
-                size_t len_left = strlen(left.as.string);
-                size_t len_right = strlen(right.as.string);
-                char *new_string = malloc(len_left + len_right + 1);
-                if (new_string)
-                {
-                    strcpy(new_string, left.as.string);
-                    strcat(new_string, right.as.string);
-                }
-                free_value(left);
-                free_value(right);
-                return (Value){VAL_STRING, {.string = new_string}};
-            }
-            print_error("Operands must be two numbers or two strings for '+'.");
-            break;
-        case TOKEN_MINUS:
-            if (is_number(left, right))
-            {
-                return (Value){VAL_NUMBER, {.number = left.as.number - right.as.number}};
-            }
-            print_error("Operands must be numbers for '-'.");
-            break;
-        case TOKEN_STAR:
-            if (is_number(left, right))
-            {
-                return (Value){VAL_NUMBER, {.number = left.as.number * right.as.number}};
-            }
-            print_error("Operands must be numbers for '*'.");
-            break;
-        case TOKEN_SLASH:
-            if (is_number(left, right))
-            {
-                return (Value){VAL_NUMBER, {.number = left.as.number / right.as.number}};
-            }
-            print_error("Operands must be numbers for '/'.");
-            break;
-
-        case TOKEN_PERCENT:
-            if (is_number(left, right))
-            {
-
-                return (Value){VAL_NUMBER, {.number = fmod(left.as.number, right.as.number)}};
-            }
-            print_error("Operands must be numbers for '%'.");
-            break;
-
-        case TOKEN_GREATER:
-            if (is_number(left, right))
-            {
-                return (Value){VAL_BOOL, {.boolean = left.as.number > right.as.number}};
-            }
-            if (is_string(left, right))
-            {
-                return (Value){VAL_BOOL, {.boolean = strcmp(left.as.string, right.as.string) > 0}};
-            }
-            print_error("Operands must be numbers or strings for '>'.");
-            break;
-
-        case TOKEN_GREATER_EQUAL:
-            if (is_number(left, right))
-            {
-                return (Value){VAL_BOOL, {.boolean = left.as.number >= right.as.number}};
-            }
-            print_error("Operands must be numbers for '>='.");
-            break;
-
-        case TOKEN_LESS:
-            if (is_number(left, right))
-            {
-                return (Value){VAL_BOOL, {.boolean = left.as.number < right.as.number}};
-            }
-            if (is_string(left, right))
-            {
-                return (Value){VAL_BOOL, {.boolean = strcmp(left.as.string, right.as.string) < 0}};
-            }
-            print_error("Operands must be numbers or strings for '<'.");
-            break;
-
-        case TOKEN_LESS_EQUAL:
-            if (is_number(left, right))
-            {
-                return (Value){VAL_BOOL, {.boolean = left.as.number <= right.as.number}};
-            }
-            print_error("Operands must be numbers for '<='.");
-            break;
-
-        case TOKEN_EQUAL_EQUAL:
-        {
-            Value eq = eval_equals(left, right);
-            free_value(left);
-            free_value(right);
-            return (Value){VAL_BOOL, {.boolean = is_value_truthy(eq)}};
-        }
-
-        case TOKEN_BANG_EQUAL:
-        {
-            Value eq = eval_equals(left, right);
-            bool is_not_equal = !is_value_truthy(eq);
-            free_value(left);
-            free_value(right);
-            return (Value){VAL_BOOL, {.boolean = is_not_equal}};
-        }
-        default:
-            print_error("Unknown binary operator.");
-        }
-
-        free_value(left);
-        free_value(right);
-        return (Value){.type = VAL_NIL, .as = {0}};
+        Value left = eval_node(env, n->left);
+        Value right = eval_node(env, n->right);
+        return eval_binary_op(n->op, left, right);
     }
 
     case NODE_EXTENSION:
     {
         Var *target_var = find_var(env, n->name);
-        if (target_var && target_var->value.type == VAL_CLASS)
+        if (target_var && VALUE_TYPE(target_var->value) == VAL_CLASS)
         {
-            Class *klass = target_var->value.as.class_obj;
+            Class *klass = AS_CLASS(target_var->value);
+            klass->methods->is_dynamic = true;
             Node *method_node = n->left;
             while (method_node)
             {
-                Value method_val;
-                method_val.type = VAL_FUNCTION;
-                method_val.as.function = malloc(sizeof(Func));
-                Func *f = method_val.as.function;
-                memset(f, 0, sizeof(Func));
+                Func *f = gc_allocate(sizeof(Func), GC_FUNCTION);
+                Value method_val = FUNCTION_VAL(f);
                 f->params_head = method_node->left;
                 f->body_head = method_node->right;
                 f->env = env;
+                method_node->left = NULL;
+                method_node->right = NULL;
                 set_var(klass->methods, method_node->name, method_val, false, "function");
                 method_node = method_node->next;
             }
+            method_cache_flush();
         }
-        return (Value){VAL_NIL, {0}};
+        return NIL_VAL;
     }
 
     case NODE_VARDECL:
     {
         Value val = eval_node(env, n->right);
 
-        if (val.type == VAL_ARRAY && n->template_types != NULL)
+        if (VALUE_TYPE(val) == VAL_ARRAY && n->template_types != NULL)
         {
-            strcpy(val.as.array->element_type, n->template_types->name);
+            strcpy(AS_ARRAY(val)->element_type, n->template_types->name);
 
-            for (int i = 0; i < val.as.array->count; i++)
+            for (int i = 0; i < AS_ARRAY(val)->count; i++)
             {
-                if (!check_template_match(val.as.array->values[i], n->template_types->name))
+                if (!check_template_match(AS_ARRAY(val)->values[i], n->template_types->name))
                 {
                     print_error("Type Mismatch: Initial element at index %d does not match Array<%s>",
                                 i, n->template_types->name);
                     free_value(val);
-                    return (Value){VAL_NIL, {0}};
+                    return NIL_VAL;
                 }
             }
         }
 
         if (n->left && n->left->kind == NODE_DESTRUCTURE)
         {
-            if (val.type == VAL_ARRAY)
+            if (VALUE_TYPE(val) == VAL_ARRAY)
             {
-                ValueArray *arr = val.as.array;
+                ValueArray *arr = AS_ARRAY(val);
                 Node *var_node = n->left->left;
                 int i = 0;
                 while (var_node && i < arr->count)
@@ -1432,20 +2127,20 @@ Value eval_node(Env *env, Node *n)
                     i++;
                 }
             }
-            else if (val.type == VAL_MAP)
+            else if (VALUE_TYPE(val) == VAL_MAP)
             {
-                HashMap *map = val.as.map;
+                HashMap *map = AS_MAP(val);
                 Node *var_node = n->left->left;
                 while (var_node)
                 {
                     Value out_val;
-                    if (map_get(map, var_node->name, &out_val))
+                    if (map_get_string(map, node_key(var_node), &out_val))
                     {
                         set_var(env, var_node->name, out_val, false, "");
                     }
                     else
                     {
-                        set_var(env, var_node->name, (Value){VAL_NIL, {0}}, false, "");
+                        set_var(env, var_node->name, NIL_VAL, false, "");
                     }
                     Var *v = find_var(env, var_node->name);
                     if (v)
@@ -1453,20 +2148,20 @@ Value eval_node(Env *env, Node *n)
                     var_node = var_node->next;
                 }
             }
-            else if (val.type == VAL_INSTANCE)
+            else if (VALUE_TYPE(val) == VAL_INSTANCE)
             {
-                Instance *inst = val.as.instance;
+                Instance *inst = AS_INSTANCE(val);
                 Node *var_node = n->left->left;
                 while (var_node)
                 {
-                    Var *field = find_var(inst->fields, var_node->name);
+                    Value *field = instance_field(inst, node_key(var_node), NULL);
                     if (field)
                     {
-                        set_var(env, var_node->name, field->value, false, "");
+                        set_var(env, var_node->name, *field, false, "");
                     }
                     else
                     {
-                        set_var(env, var_node->name, (Value){VAL_NIL, {0}}, false, "");
+                        set_var(env, var_node->name, NIL_VAL, false, "");
                     }
                     Var *v = find_var(env, var_node->name);
                     if (v)
@@ -1475,7 +2170,7 @@ Value eval_node(Env *env, Node *n)
                 }
             }
             free_value(val);
-            return (Value){VAL_NIL, {0}};
+            return NIL_VAL;
         }
 
         if (n->is_static && current_executing_func != NULL)
@@ -1488,7 +2183,7 @@ Value eval_node(Env *env, Node *n)
                 if (v)
                     v->is_final = n->is_final;
                 free_value(val);
-                return (Value){VAL_NIL, {0}};
+                return NIL_VAL;
             }
 
             const char *actual_type = get_value_type_name(val);
@@ -1496,7 +2191,7 @@ Value eval_node(Env *env, Node *n)
             {
                 print_error("Type Mismatch: Expected %s but got %s", n->type_name, actual_type);
                 free_value(val);
-                return (Value){VAL_NIL, {0}};
+                return NIL_VAL;
             }
 
             map_set(current_executing_func->static_vars, n->name, val);
@@ -1504,24 +2199,10 @@ Value eval_node(Env *env, Node *n)
             Var *v = find_var(env, n->name);
             if (v)
                 v->is_final = n->is_final;
-            return (Value){VAL_NIL, {0}};
+            return NIL_VAL;
         }
 
-        const char *actual_type = get_value_type_name(val);
-        if (n->type_name[0] != '\0' && strcmp(n->type_name, actual_type) != 0)
-        {
-            print_error("Type Mismatch: Expected %s but got %s", n->type_name, actual_type);
-            free_value(val);
-            return (Value){VAL_NIL, {0}};
-        }
-
-        set_var(env, n->name, val, false, n->type_name);
-        Var *v = find_var(env, n->name);
-        if (v)
-        {
-            v->is_final = n->is_final;
-        }
-        return (Value){VAL_NIL, {0}};
+        return declare_var(env, n, val);
     }
 
         // case NODE_PRINT:
@@ -1543,7 +2224,7 @@ Value eval_node(Env *env, Node *n)
         Node *then_branch = n->right->left;
         Node *else_branch = n->right->right;
 
-        Value result = (Value){.type = VAL_NIL, .as = {0}};
+        Value result = NIL_VAL;
         if (is_true)
         {
             result = eval_node(env, then_branch);
@@ -1558,7 +2239,7 @@ Value eval_node(Env *env, Node *n)
 
     case NODE_INTERFACE_DEF:
     {
-        Interface *iface = malloc(sizeof(Interface));
+        Interface *iface = gc_allocate(sizeof(Interface), GC_INTERFACE);
         strcpy(iface->name, n->name);
         iface->methods = env_new(NULL);
 
@@ -1566,15 +2247,15 @@ Value eval_node(Env *env, Node *n)
         while (method)
         {
 
-            Value arity_val = (Value){VAL_NUMBER, {.number = (double)method->arity}};
+            Value arity_val = NUMBER_VAL((double)method->arity);
             set_var(iface->methods, method->name, arity_val, true, "");
 
             method = method->next;
         }
 
-        Value iface_val = (Value){VAL_INTERFACE, {.interface_obj = iface}};
+        Value iface_val = MAKE_VALUE(VAL_INTERFACE, interface_obj, iface);
         set_var(env, n->name, iface_val, true, "");
-        return (Value){VAL_NIL, {0}};
+        return NIL_VAL;
     }
 
     case NODE_STRUCT_DEF:
@@ -1583,7 +2264,7 @@ Value eval_node(Env *env, Node *n)
         if (!s_def)
         {
             print_error("Fatal: Out of memory during struct definition.");
-            return (Value){VAL_NIL, {0}};
+            return NIL_VAL;
         }
 
         strcpy(s_def->name, n->name);
@@ -1630,68 +2311,33 @@ Value eval_node(Env *env, Node *n)
             body_node = body_node->next;
         }
 
-        Value s_val = (Value){VAL_STRUCT_DEF, {.struct_def = s_def}};
+        Value s_val = MAKE_VALUE(VAL_STRUCT_DEF, struct_def, s_def);
         set_var(env, n->name, s_val, true, "");
 
-        return (Value){VAL_NIL, {0}};
+        return NIL_VAL;
     }
     case NODE_CLASS_DEF:
     {
-        if (strlen(n->super_name) > 0)
-        {
-            Var *super_var = find_var(env, n->super_name);
-            if (!super_var || super_var->value.type != VAL_CLASS)
-            {
-                print_error("Superclass '%s' not found or invalid.", n->super_name);
-                return (Value){.type = VAL_NIL, .as = {0}};
-            }
-
-            if (super_var->is_final)
-            {
-                print_error("Fatal Error: Cannot inherit from @final class '%s'.", n->super_name);
-                exit(1);
-            }
-        }
-
-        Class *class_obj = malloc(sizeof(Class));
-        strcpy(class_obj->name, n->name);
-        class_obj->methods = env_new(env);
-        class_obj->superclass = NULL;
-        class_obj->interface = NULL;
-        class_obj->is_record = n->is_record;
-
-        if (strlen(n->super_name) > 0)
-        {
-            Var *super_var = find_var(env, n->super_name);
-            class_obj->superclass = super_var->value.as.class_obj;
-        }
-
-        if (strlen(n->interface_name) > 0)
+        Class *class_obj = begin_class(env, n);
+        if (!class_obj)
         {
-            Var *iface_var = find_var(env, n->interface_name);
-            if (iface_var && iface_var->value.type == VAL_INTERFACE)
-            {
-                class_obj->interface = iface_var->value.as.interface_obj;
-            }
+            return NIL_VAL;
         }
 
         if (n->is_record)
         {
-            Value class_val = (Value){VAL_CLASS, {.class_obj = class_obj}};
+            Value class_val = CLASS_VAL(class_obj);
             set_var(env, n->name, class_val, true, "");
             Var *v_class = find_var(env, n->name);
             if (v_class)
                 v_class->is_final = n->is_final;
-            return (Value){.type = VAL_NIL, .as = {0}};
+            return NIL_VAL;
         }
 
         if (n->is_singleton)
         {
-            Value class_val = (Value){VAL_CLASS, {.class_obj = class_obj}};
-            Instance *inst = malloc(sizeof(Instance));
-            inst->class_val = malloc(sizeof(Value));
-            *inst->class_val = class_val;
-            inst->fields = env_new(NULL);
+            Value class_val = CLASS_VAL(class_obj);
+            Instance *inst = instance_new(class_val);
 
             Node *method = n->left;
             while (method)
@@ -1704,16 +2350,16 @@ Value eval_node(Env *env, Node *n)
             Node *param_node = n->right;
             while (param_node)
             {
-                set_var(inst->fields, param_node->name, (Value){VAL_STRING, {.string = strdup("")}}, false, "");
+                instance_set_field(inst, node_key(param_node), string_copy(""), NULL);
                 param_node = param_node->next;
             }
 
-            Value instance_val = (Value){VAL_INSTANCE, {.instance = inst}};
+            Value instance_val = INSTANCE_VAL(inst);
             set_var(env, n->name, instance_val, true, "");
             Var *v_class = find_var(env, n->name);
             if (v_class)
                 v_class->is_final = n->is_final;
-            return (Value){.type = VAL_NIL, .as = {0}};
+            return NIL_VAL;
         }
 
         Node *method = n->left;
@@ -1725,119 +2371,32 @@ Value eval_node(Env *env, Node *n)
             method = next_method;
         }
 
-        Node *check_node = n->left;
-        while (check_node)
-        {
-            if (check_node->is_override)
-            {
-                bool found_in_parent = false;
-                if (class_obj->superclass != NULL)
-                {
-                    if (find_method(class_obj->superclass, check_node->name) != NULL)
-                    {
-                        found_in_parent = true;
-                    }
-                }
-                if (!found_in_parent && class_obj->interface != NULL)
-                {
-                    if (find_var(class_obj->interface->methods, check_node->name) != NULL)
-                    {
-                        found_in_parent = true;
-                    }
-                }
-                if (!found_in_parent)
-                {
-                    print_error("Method '%s' marked @override but does not override any method.", check_node->name);
-                }
-            }
-            check_node = check_node->next;
-        }
-
-        if (class_obj->interface)
-        {
-            Interface *iface = class_obj->interface;
-            Var *required_method = iface->methods->vars;
-            while (required_method)
-            {
-                Var *implemented = find_method(class_obj, required_method->name);
-                if (!implemented)
-                {
-                    print_error("Class '%s' must implement method '%s' from interface '%s'.", class_obj->name, required_method->name, iface->name);
-                }
-                required_method = required_method->next;
-            }
-        }
-
-        Value class_val = (Value){VAL_CLASS, {.class_obj = class_obj}};
-        set_var(env, n->name, class_val, true, "");
-
-        Var *v_class = find_var(env, n->name);
-        if (v_class)
-        {
-            v_class->is_final = n->is_final;
-        }
-
-        return (Value){.type = VAL_NIL, .as = {0}};
+        end_class(env, n, class_obj);
+        return NIL_VAL;
     }
 
-    case NODE_FUNC_DEF:
-    {
-        Func *func = malloc(sizeof(Func));
-        if (!func)
-            return (Value){VAL_NIL, {0}};
-
-        strcpy(func->return_type, n->return_type);
-        func->params_head = n->left;
-        func->body_head = n->right;
-        func->env = env;
-        func->arity = n->arity;
-        func->is_private = n->is_private;
-        func->is_deprecated = n->is_deprecated;
-        func->is_memoized = n->is_memoize;
-        func->is_async = n->is_async;
-        func->is_final = n->is_final;
-        func->is_parallel = n->is_paralel;
-
-        func->deprecated_message = n->deprecated_message ? strdup(n->deprecated_message) : NULL;
-
-        func->is_platform_specific = n->is_platform_specific;
-        if (n->is_platform_specific && n->target_os != NULL)
-        {
-            func->target_os = strdup(n->target_os);
-        }
-        else
-        {
-            func->target_os = NULL;
-        }
-
-        func->static_vars = map_new();
-
-        if (func->is_memoized)
-        {
-            func->cache = map_new();
-        }
-        else
-        {
-            func->cache = NULL;
-        }
-
+    case NODE_FUNC_DEF:
+    {
+        Value func_val = make_function(env, n);
+        if (VALUE_TYPE(func_val) != VAL_FUNCTION)
+            return NIL_VAL;
+
         n->left = NULL;
         n->right = NULL;
 
-        Value func_val = (Value){VAL_FUNCTION, {.function = func}};
         set_var(env, n->name, func_val, true, "");
 
         if (n->is_main)
         {
             struct Var *name_var = find_var(env, "__name__");
-            if (name_var && name_var->value.type == VAL_STRING && strcmp(name_var->value.as.string, "main") == 0)
+            if (name_var && VALUE_TYPE(name_var->value) == VAL_STRING && strcmp(AS_STRING(name_var->value), "main") == 0)
             {
                 Value args[0];
                 call_jackal_function(env, func_val, 0, args);
             }
         }
 
-        return (Value){VAL_NIL, {0}};
+        return NIL_VAL;
     }
     case NODE_NAMESPACES:
     {
@@ -1858,9 +2417,7 @@ Value eval_node(Env *env, Node *n)
             v = v->next;
         }
 
-        Value ns_val;
-        ns_val.type = VAL_NAMESPACE;
-        ns_val.as.map = ns_map;
+        Value ns_val = NAMESPACE_VAL(ns_map);
 
         set_var(env, n->name, ns_val, true, "namespace");
 
@@ -1871,15 +2428,16 @@ Value eval_node(Env *env, Node *n)
     case NODE_USING:
     {
         Node *target = n->left;
+        env->is_dynamic = true;
 
         if (target != NULL)
         {
             while (target)
             {
                 Var *ns_var = find_var(env, target->name);
-                if (ns_var && ns_var->value.type == VAL_NAMESPACE)
+                if (ns_var && VALUE_TYPE(ns_var->value) == VAL_NAMESPACE)
                 {
-                    HashMap *ns_map = ns_var->value.as.map;
+                    HashMap *ns_map = AS_NAMESPACE(ns_var->value);
                     for (int i = 0; i < ns_map->capacity; i++)
                     {
                         if (ns_map->entries[i].key != NULL)
@@ -1898,9 +2456,9 @@ Value eval_node(Env *env, Node *n)
         else
         {
             Var *ns_var = find_var(env, n->name);
-            if (ns_var && ns_var->value.type == VAL_NAMESPACE)
+            if (ns_var && VALUE_TYPE(ns_var->value) == VAL_NAMESPACE)
             {
-                HashMap *ns_map = ns_var->value.as.map;
+                HashMap *ns_map = AS_NAMESPACE(ns_var->value);
                 for (int i = 0; i < ns_map->capacity; i++)
                 {
                     if (ns_map->entries[i].key != NULL)
@@ -1914,7 +2472,7 @@ Value eval_node(Env *env, Node *n)
                 print_error("Namespace '%s' not found", n->name);
             }
         }
-        return (Value){VAL_NIL, {0}};
+        return NIL_VAL;
     }
 
     case NODE_FUNC_CALL:
@@ -1929,601 +2487,75 @@ Value eval_node(Env *env, Node *n)
                 size_t len = strlen(buffer);
                 if (len > 0 && buffer[len - 1] == '\n')
                     buffer[len - 1] = '\0';
-                char *str = malloc(len + 1);
-                strcpy(str, buffer);
-                return (Value){VAL_STRING, {.string = str}};
+                return string_copy(buffer);
             }
-            return (Value){VAL_NIL, .as = {0}};
+            return NIL_VAL;
         }
 
+        Value args[255];
+        int arg_count = 0;
+
         if (n->left->kind == NODE_GET)
         {
             Node *get_node = n->left;
             Value obj = eval_node(env, get_node->left);
 
-            if (obj.type == VAL_NUMBER)
-            {
-                if (strcmp(get_node->name, "toString") == 0)
-                {
-                    char buffer[64];
-
-                    sprintf(buffer, "%g", obj.as.number);
-
-                    char *str_copy = malloc(strlen(buffer) + 1);
-                    strcpy(str_copy, buffer);
-
-                    return (Value){VAL_STRING, {.string = str_copy}};
-                }
-
-                print_error("Undefined method '%s' for Number.", get_node->name);
-                return (Value){VAL_NIL, {0}};
-            }
-
-            if (obj.type == VAL_MAP)
-            {
-                Value method_val;
-                if (!map_get(obj.as.map, get_node->name, &method_val))
-                {
-                    print_error("Undefined method for Map.");
-                    return (Value){VAL_NIL, {0}};
-                }
-
-                if (method_val.type != VAL_NATIVE)
-                {
-                    print_error("Map value is not a callable function.");
-                    return (Value){VAL_NIL, {0}};
-                }
-
-                NativeFn native = method_val.as.native;
-                Value args[255];
-                int arg_count = 0;
-                Node *arg_node = n->right;
-                while (arg_node)
-                {
-                    args[arg_count++] = eval_node(env, arg_node);
-                    arg_node = arg_node->next;
-                }
-
-                Value res = native(arg_count, args);
-                for (int i = 0; i < arg_count; i++)
-                    free_value(args[i]);
-                return res;
-            }
-
-            if (obj.type == VAL_ARRAY)
-            {
-                Value callback = (Value){VAL_NIL, {0}};
-
-                if (n->right)
-                {
-                    callback = eval_node(env, n->right);
-                }
-
-                if (strcmp(get_node->name, "length") == 0)
-                {
-                    return (Value){VAL_NUMBER, {.number = (double)obj.as.array->count}};
-                }
-
-                if (strcmp(get_node->name, "push") == 0)
-                {
-                    Node *arg = n->right;
-                    while (arg)
-                    {
-                        Value val = eval_node(env, arg);
-                        array_append(obj.as.array, copy_value(val));
-                        free_value(val);
-                        arg = arg->next;
-                    }
-                    return (Value){VAL_NIL, {0}};
-                }
-                if (strcmp(get_node->name, "each") == 0)
-                {
-                    if (n->arity < 1)
-                    {
-                        print_error("Error: each() expects a callback function.");
-                        return (Value){VAL_NIL, {0}, NULL};
-                    }
-
-                    Value callback = eval_node(env, n->right);
-
-                    if (callback.type != VAL_FUNCTION && callback.type != VAL_NATIVE)
-                    {
-                        print_error("Error: argument to each() must be a function.");
-                        free_value(callback);
-                        return (Value){VAL_NIL, {0}, NULL};
-                    }
-
-                    ValueArray *array = obj.as.array;
-                    for (int i = 0; i < array->count; i++)
-                    {
-                        Value args[1] = {array->values[i]};
-
-                        
-                        Value result = call_jackal_function(env, callback, 1, args);
-
-                        free_value(result);
-                    }
-
-                    free_value(callback);
-                    return (Value){VAL_NIL, {0}, NULL};
-                }
-
-                if (strcmp(get_node->name, "contains") == 0)
-                {
-                    if (n->arity < 1)
-                    {
-                        print_error("Error: contains() expects at least 1 argument.");
-                        return (Value){VAL_BOOL, {.boolean = 0}};
-                    }
-
-                    Value search_val = eval_node(env, n->right);
-
-                    if (search_val.type != VAL_STRING)
-                    {
-                        print_error("Error: contains() argument must be a string.");
-                        free_value(search_val);
-                        return (Value){VAL_BOOL, {.boolean = 0}};
-                    }
-
-                    ValueArray *array = obj.as.array;
-                    bool found = false;
-
-                    for (int i = 0; i < array->count; i++)
-                    {
-                        if (array->values[i].type == VAL_STRING)
-                        {
-                            if (strcmp(array->values[i].as.string, search_val.as.string) == 0)
-                            {
-                                found = true;
-                                break;
-                            }
-                        }
-                    }
-
-                    free_value(search_val);
-                    return (Value){VAL_BOOL, {.boolean = found ? 1 : 0}};
-                }
-
-                if (strcmp(get_node->name, "pop") == 0)
-                {
-                    return array_pop(obj.as.array);
-                }
-
-                if (strcmp(get_node->name, "remove") == 0)
-                {
-
-                    if (n->arity != 1)
-                    {
-                        print_error("Error: remove() takes exactly 1 argument (index).");
-                        return (Value){VAL_NIL, {0}};
-                    }
-
-                    Value index_val = eval_node(env, n->right);
-                    if (index_val.type != VAL_NUMBER)
-                    {
-                        print_error("Error: remove() argument must be a number.");
-                        free_value(index_val);
-                        return (Value){VAL_NIL, {0}};
-                    }
-
-                    int index = (int)index_val.as.number;
-                    array_delete(obj.as.array, index);
-
-                    free_value(index_val);
-                    return (Value){VAL_NIL, {0}};
-                }
-
-                print_error("Undefined method for Array.");
-                return (Value){VAL_NIL, {0}};
-            }
-
-            if (obj.type == VAL_STRING)
-            {
-
-                if (strcmp(get_node->name, "toNumber") == 0)
-                {
-
-                    double val = atof(obj.as.string);
-                    free_value(obj);
-                    return (Value){VAL_NUMBER, {.number = val}};
-                }
-
-                if (strcmp(get_node->name, "toString") == 0)
-                {
-                    return obj;
-                }
-
-                if (strcmp(get_node->name, "length") == 0)
-                {
-                    return (Value){VAL_NUMBER, {.number = (double)strlen(obj.as.string)}};
-                }
-
-                print_error("Undefined method for String.");
-                return (Value){VAL_NIL, {0}};
-            }
-
-            if (obj.type == VAL_INSTANCE)
+            for (Node *arg_node = n->right; arg_node; arg_node = arg_node->next)
             {
-
-                Var *method_var = find_method(obj.as.instance->class_val->as.class_obj, get_node->name);
-                if (!method_var)
-                {
-                    print_error("Undefined method.");
-                    return (Value){VAL_NIL, .as = {0}};
-                }
-
-                Func *func = method_var->value.as.function;
-
-                if (func->is_private)
-                {
-                    if (get_node->left->kind != NODE_THIS)
-                    {
-                        print_error("Cannot access private method '%s' outside of class context.", get_node->name);
-                        return (Value){VAL_NIL, .as = {0}};
-                    }
-                }
-                if (func->is_deprecated)
-                {
-                    printf("Warning: Method '%s' is deprecated.\n", get_node->name);
-                }
-                Env *call_env = env_new(func->env);
-
-                Var *this_var = malloc(sizeof(Var));
-                strcpy(this_var->name, "this");
-                this_var->value = obj;
-                this_var->next = call_env->vars;
-                call_env->vars = this_var;
-
-                Node *arg = n->right;
-                Node *param = func->params_head;
-                for (int i = 0; i < n->arity; i++)
-                {
-                    Value v = eval_node(env, arg);
-                    set_var(call_env, param->name, v, false, "");
-                    free_value(v);
-                    arg = arg->next;
-                    param = param->next;
-                }
-
-                Value res = eval_node(call_env, func->body_head);
-
-                call_env->vars = this_var->next;
-                free(this_var);
-                env_free(call_env);
-
-                if (res.type == VAL_RETURN)
-                {
-                    Value ret = *res.as.return_val;
-                    free(res.as.return_val);
-                    return ret;
-                }
-                return (Value){VAL_NIL, .as = {0}};
+                args[arg_count++] = eval_node(env, arg_node);
             }
 
-            print_error("Only instances, arrays, and strings have methods.");
-            return (Value){.type = VAL_NIL, .as = {0}};
+            Value res = invoke_method(env, obj, node_key(get_node), arg_count, args, get_node->left->kind == NODE_THIS,
+                                      &get_node->method_cache);
+            for (int i = 0; i < arg_count; i++)
+                free_value(args[i]);
+            return res;
         }
 
         Value callee = eval_node(env, n->left);
 
-        if (callee.type == VAL_CLASS)
-        {
-            Class *klass = callee.as.class_obj;
-            Instance *inst = malloc(sizeof(Instance));
-            memset(inst, 0, sizeof(Instance));
-            inst->class_val = malloc(sizeof(Value));
-            *inst->class_val = callee;
-            inst->fields = env_new(NULL);
-
-            Node *t_node = n->template_types;
-            int t_idx = 0;
-            while (t_node && t_idx < 10)
-            {
-                strncpy(inst->templates.names[t_idx++], t_node->name, 63);
-                t_node = t_node->next;
-            }
-            inst->templates.count = t_idx;
-
-            Value instance_val = (Value){VAL_INSTANCE, {.instance = inst}};
-
-            Var *field_def = klass->methods->vars;
-            Node *arg_ptr = n->right;
-            while (arg_ptr && field_def)
-            {
-                Value arg_val = eval_node(env, arg_ptr);
-                set_var(inst->fields, field_def->name, arg_val, false, field_def->expected_type);
-                free_value(arg_val);
-                arg_ptr = arg_ptr->next;
-                field_def = field_def->next;
-            }
-
-            Var *init_method = find_method(klass, "init");
-            if (init_method)
-            {
-                Func *func = init_method->value.as.function;
-                Env *call_env = env_new(func->env);
-                set_var(call_env, "this", instance_val, true, "");
-
-                Node *arg_node = n->right;
-                Node *param_node = func->params_head;
-
-                for (int i = 0; i < n->arity; i++)
-                {
-                    if (param_node == NULL)
-                        break;
-
-                    Value arg_val = eval_node(env, arg_node);
-                    const char *actual_type = get_value_type_name(arg_val);
-                    const char *expected = param_node->type_name;
-
-                    if (expected != NULL && strlen(expected) == 1 && expected[0] >= 'A' && expected[0] <= 'Z')
-                    {
-                        int template_idx = 0;
-                        if (expected[0] == 'K')
-                            template_idx = 0;
-                        else if (expected[0] == 'V')
-                            template_idx = 1;
-
-                        if (template_idx < inst->templates.count)
-                        {
-                            expected = inst->templates.names[template_idx];
-                        }
-                    }
-
-                    if (expected != NULL && expected[0] != '\0')
-                    {
-                        bool is_match = false;
-                        if (strcmp(expected, actual_type) == 0)
-                            is_match = true;
-                        else if (is_type_alias_match(expected, arg_val))
-                            is_match = true;
-                        else if (arg_val.type == VAL_INSTANCE)
-                            is_match = true;
-
-                        if (!is_match)
-                        {
-                            print_error("Type Mismatch: Parameter '%s' expects %s, but got %s",
-                                        param_node->name, expected, actual_type);
-                            free_value(arg_val);
-                            env_free(call_env);
-                            return (Value){VAL_NIL, {0}};
-                        }
-                    }
-
-                    set_var(call_env, param_node->name, arg_val, false, expected);
-                    free_value(arg_val);
-                    arg_node = arg_node->next;
-                    param_node = param_node->next;
-                }
-
-                Value init_result = eval_node(call_env, func->body_head);
-                if (init_result.type == VAL_RETURN)
-                {
-                    free_value(*init_result.as.return_val);
-                    free(init_result.as.return_val);
-                }
-                else
-                {
-                    free_value(init_result);
-                }
-                env_free(call_env);
-            }
-            return instance_val;
-        }
-        if (callee.type == VAL_STRUCT_DEF)
-        {
-            StructDefinition *s_def = callee.as.struct_def;
-            StructInstance *s_inst = malloc(sizeof(StructInstance));
-            s_inst->definition = s_def;
-            s_inst->values = malloc(sizeof(Value) * s_def->field_count);
-
-            for (int i = 0; i < s_def->field_count; i++)
-            {
-                s_inst->values[i] = (Value){VAL_NIL, {0}};
-            }
-
-            Env *temp_env = env_new(env);
-            Node *arg_node = n->right;
-
-            for (int i = 0; i < s_def->field_count; i++)
-            {
-                if (arg_node != NULL)
-                {
-                    Value val = eval_node(env, arg_node);
-                    s_inst->values[i] = copy_value(val);
-                    set_var(temp_env, s_def->field_names[i], val, false, "");
-                    arg_node = arg_node->next;
-                }
-            }
-
-            if (s_def->computed_body != NULL)
-            {
-                Node *stmt = s_def->computed_body;
-                while (stmt)
-                {
-                    if (stmt->kind == NODE_VARDECL)
-                    {
-                        eval_node(temp_env, stmt);
-                        Var *v = find_var(temp_env, stmt->name);
-                        if (v)
-                        {
-                            for (int j = 0; j < s_def->field_count; j++)
-                            {
-                                if (strcmp(s_def->field_names[j], stmt->name) == 0)
-                                {
-                                    s_inst->values[j] = copy_value(v->value);
-                                    break;
-                                }
-                            }
-                        }
-                    }
-                    stmt = stmt->next;
-                }
-            }
-
-            env_free(temp_env);
-            return (Value){VAL_STRUCT_INSTANCE, {.struct_instance = s_inst}};
-        }
-        if (callee.type == VAL_FUNCTION)
-        {
-            Func *func = callee.as.function;
-            Env *call_env = env_new(func->env);
-            Node *arg = n->right;
-            Node *param = func->params_head;
-
-            const char *expected_type = NULL;
-            const char *actual_type = NULL;
-            Value v = (Value){VAL_NIL, {0}};
-
-            for (int i = 0; i < n->arity; i++)
-            {
-                v = eval_node(env, arg);
-
-                if (param->type_name[0] != '\0')
-                {
-                    expected_type = param->type_name;
-                    actual_type = get_value_type_name(v);
-
-                    bool is_match = false;
-
-                    if (strcmp(expected_type, "Array") == 0 && v.type == VAL_ARRAY)
-                    {
-
-                        is_match = true;
-                    }
-                    else if (strcmp(expected_type, actual_type) == 0)
-                    {
-                        is_match = true;
-                    }
-                    else if (v.type == VAL_INSTANCE)
-                    {
-                        Var *expected_class_var = find_var(env, expected_type);
-                        if (expected_class_var && expected_class_var->value.type == VAL_CLASS)
-                        {
-                            Class *expected_class = expected_class_var->value.as.class_obj;
-                            Class *current_class = v.as.instance->class_val->as.class_obj;
-                            while (current_class)
-                            {
-                                if (strcmp(current_class->name, expected_class->name) == 0)
-                                {
-                                    is_match = true;
-                                    break;
-                                }
-                                current_class = current_class->superclass;
-                            }
-                        }
-                    }
-
-                    if (!is_match)
-                        goto type_mismatch_error;
-                }
-
-                set_var(call_env, param->name, v, false, "");
-                free_value(v);
-                arg = arg->next;
-                param = param->next;
-            }
-
-            Value result = eval_node(call_env, func->body_head);
-            env_free(call_env);
-
-            Value final_result = (Value){VAL_NIL, {0}};
-            if (result.type == VAL_RETURN)
-            {
-                final_result = *result.as.return_val;
-                free(result.as.return_val);
-            }
-            else
-            {
-                final_result = result;
-            }
-
-            if (func->return_type[0] != '\0')
-            {
-                expected_type = func->return_type;
-                actual_type = get_value_type_name(final_result);
-
-                bool return_match = false;
-                if (strcmp(expected_type, "Array") == 0 && final_result.type == VAL_ARRAY)
-                {
-                    return_match = true;
-                }
-                else if (strcmp(expected_type, actual_type) == 0)
-                {
-                    return_match = true;
-                }
-
-                if (!return_match)
-                {
-                    print_error("Type Mismatch: Function expected return type '%s' but got '%s'.",
-                                expected_type, actual_type);
-                    free_value(final_result);
-                    return (Value){VAL_NIL, {0}};
-                }
-            }
-
-            return final_result;
-
-        type_mismatch_error:
-            print_error("Type Mismatch for parameter '%s'. Expected '%s' but got '%s'.",
-                        param->name, expected_type, actual_type);
-            free_value(v);
-            env_free(call_env);
-            return (Value){VAL_NIL, {0}};
-        }
-
-        if (callee.type == VAL_NATIVE)
+        for (Node *arg_node = n->right; arg_node; arg_node = arg_node->next)
         {
-            NativeFn native = callee.as.native;
-            Value args[255];
-            int arg_count = 0;
-            Node *arg_node = n->right;
-            while (arg_node)
-            {
-                args[arg_count++] = eval_node(env, arg_node);
-
-                arg_node = arg_node->next;
-            }
-            Value res = native(arg_count, args);
-            for (int i = 0; i < arg_count; i++)
-                free_value(args[i]);
-            return res;
+            args[arg_count++] = eval_node(env, arg_node);
         }
 
-        return (Value){VAL_NIL, {0}};
+        Value res = call_value(env, callee, n->template_types, arg_count, args);
+        for (int i = 0; i < arg_count; i++)
+            free_value(args[i]);
+        return res;
     }
 
     case NODE_RETURN_STMT:
     {
-        Value *ret = malloc(sizeof(Value));
+        Value *ret = gc_allocate(sizeof(Value), GC_BOX);
         if (n->left)
         {
             *ret = eval_node(env, n->left);
         }
         else
         {
-            *ret = (Value){.type = VAL_NIL, .as = {0}};
+            *ret = NIL_VAL;
         }
-        return (Value){VAL_RETURN, {.return_val = ret}};
+        return MAKE_VALUE(VAL_RETURN, return_val, ret);
     }
 
     case NODE_BLOCK:
     {
-        Env *block_env = env_new(env);
+        Env *block_env = env_push(env, n);
 
         Node *current = n->left;
-        Value result = (Value){.type = VAL_NIL, .as = {0}};
+        Value result = NIL_VAL;
 
         while (current)
         {
             free_value(result);
             result = eval_node(block_env, current);
-            if (result.type == VAL_RETURN)
+            if (VALUE_TYPE(result) == VAL_RETURN)
             {
                 break;
             }
 
-            if (result.type == VAL_RETURN || result.type == VAL_BREAK || result.type == VAL_CONTINUE)
+            if (VALUE_TYPE(result) == VAL_RETURN || VALUE_TYPE(result) == VAL_BREAK || VALUE_TYPE(result) == VAL_CONTINUE)
             {
                 break;
             }
@@ -2543,17 +2575,17 @@ Value eval_node(Env *env, Node *n)
             free_value(cond);
 
             Value result = eval_node(env, n->right);
-            if (result.type == VAL_RETURN)
+            if (VALUE_TYPE(result) == VAL_RETURN)
             {
                 return result;
             }
 
-            if (result.type == VAL_BREAK)
+            if (VALUE_TYPE(result) == VAL_BREAK)
             {
                 free_value(result);
                 break;
             }
-            if (result.type == VAL_CONTINUE)
+            if (VALUE_TYPE(result) == VAL_CONTINUE)
             {
                 free_value(result);
             }
@@ -2566,12 +2598,12 @@ Value eval_node(Env *env, Node *n)
         }
 
         free_value(cond);
-        return (Value){.type = VAL_NIL, .as = {0}};
+        return NIL_VAL;
     }
 
     case NODE_FOR_STMT:
     {
-        Env *for_env = env_new(env);
+        Env *for_env = env_push(env, n);
 
         Value init_res = eval_node(for_env, n->left);
         free_value(init_res);
@@ -2591,20 +2623,20 @@ Value eval_node(Env *env, Node *n)
             free_value(cond_res);
 
             Value body_res = eval_node(for_env, body);
-            if (body_res.type == VAL_RETURN)
+            if (VALUE_TYPE(body_res) == VAL_RETURN)
             {
                 env_free(for_env);
                 return body_res;
             }
             free_value(body_res);
 
-            if (body_res.type == VAL_BREAK)
+            if (VALUE_TYPE(body_res) == VAL_BREAK)
             {
                 free_value(body_res);
                 break;
             }
 
-            if (body_res.type == VAL_CONTINUE)
+            if (VALUE_TYPE(body_res) == VAL_CONTINUE)
             {
                 free_value(body_res);
             }
@@ -2618,7 +2650,7 @@ Value eval_node(Env *env, Node *n)
         }
 
         env_free(for_env);
-        return (Value){.type = VAL_NIL, .as = {0}};
+        return NIL_VAL;
     }
 
     case NODE_FOR_EACH:
@@ -2629,14 +2661,43 @@ Value eval_node(Env *env, Node *n)
 
         Value collection_val = eval_node(env, collection_expr);
 
-        if (collection_val.type != VAL_ARRAY)
+        if (VALUE_TYPE(collection_val) == VAL_CSV_CURSOR)
+        {
+            CsvCursor *cursor = AS_CSV_CURSOR(collection_val);
+            Env *loop_env = env_push(env, n);
+            ValueArray *row;
+
+            while ((row = csv_cursor_next(cursor)) != NULL)
+            {
+                set_var(loop_env, item_var->name, ARRAY_VAL(row), false, "");
+
+                Value result = eval_node(loop_env, body);
+
+                if (VALUE_TYPE(result) == VAL_RETURN)
+                {
+                    env_free(loop_env);
+                    return result;
+                }
+                if (VALUE_TYPE(result) == VAL_BREAK)
+                {
+                    free_value(result);
+                    break;
+                }
+                free_value(result);
+            }
+
+            env_free(loop_env);
+            return NIL_VAL;
+        }
+
+        if (VALUE_TYPE(collection_val) != VAL_ARRAY)
         {
             free_value(collection_val);
-            return (Value){VAL_NIL, {0}};
+            return NIL_VAL;
         }
 
-        ValueArray *arr = collection_val.as.array;
-        Env *loop_env = env_new(env);
+        ValueArray *arr = AS_ARRAY(collection_val);
+        Env *loop_env = env_push(env, n);
 
         for (int i = 0; i < arr->count; i++)
         {
@@ -2644,12 +2705,12 @@ Value eval_node(Env *env, Node *n)
 
             Value result = eval_node(loop_env, body);
 
-            if (result.type == VAL_RETURN)
+            if (VALUE_TYPE(result) == VAL_RETURN)
             {
                 env_free(loop_env);
                 return result;
             }
-            if (result.type == VAL_BREAK)
+            if (VALUE_TYPE(result) == VAL_BREAK)
             {
                 free_value(result);
                 break;
@@ -2662,7 +2723,7 @@ Value eval_node(Env *env, Node *n)
         {
             array_free(arr);
         }
-        return (Value){VAL_NIL, {0}};
+        return NIL_VAL;
     }
     case NODE_FOR_IN:
     {
@@ -2673,14 +2734,14 @@ Value eval_node(Env *env, Node *n)
 
         Value map_val = eval_node(env, iteree_expr);
 
-        if (map_val.type != VAL_MAP)
+        if (VALUE_TYPE(map_val) != VAL_MAP)
         {
             print_error("for-in loop expression must evaluate to a Map.");
             free_value(map_val);
-            return (Value){VAL_NIL, {0}};
+            return NIL_VAL;
         }
 
-        HashMap *map = map_val.as.map;
+        HashMap *map = AS_MAP(map_val);
         Env *loop_env = env_new(env);
 
         for (int i = 0; i < map->capacity; i++)
@@ -2690,19 +2751,7 @@ Value eval_node(Env *env, Node *n)
             if (entry->key != NULL)
             {
 
-                Value key_copy;
-                key_copy.type = VAL_STRING;
-
-                size_t len = strlen(entry->key);
-                key_copy.as.string = malloc(len + 1);
-                if (key_copy.as.string == NULL)
-                {
-                    env_free(loop_env);
-                    free_value(map_val);
-                    print_error("Memory allocation failed for string key.");
-                    return (Value){VAL_NIL, {0}};
-                }
-                strcpy(key_copy.as.string, entry->key);
+                Value key_copy = string_value(STRING_OBJECT(entry->key));
 
                 set_var(loop_env, key_var->name, key_copy, true, "");
                 free_value(key_copy);
@@ -2713,12 +2762,12 @@ Value eval_node(Env *env, Node *n)
 
                 Value result = eval_node(loop_env, body);
 
-                if (result.type == VAL_BREAK)
+                if (VALUE_TYPE(result) == VAL_BREAK)
                 {
                     free_value(result);
                     break;
                 }
-                if (result.type == VAL_CONTINUE)
+                if (VALUE_TYPE(result) == VAL_CONTINUE)
                 {
                     free_value(result);
                     continue;
@@ -2729,7 +2778,7 @@ Value eval_node(Env *env, Node *n)
 
         env_free(loop_env);
         free_value(map_val);
-        return (Value){VAL_NIL, {0}};
+        return NIL_VAL;
     }
 
     case NODE_EVERY_LOOP:
@@ -2737,25 +2786,25 @@ Value eval_node(Env *env, Node *n)
         Env *every_env = env_new(env);
 
         Value time_val = eval_node(every_env, n->left);
-        if (time_val.type != VAL_NUMBER || time_val.as.number < 0)
+        if (VALUE_TYPE(time_val) != VAL_NUMBER || AS_NUMBER(time_val) < 0)
         {
             print_error("Every loop time must be a non-negative number (milliseconds).");
             free_value(time_val);
             env_free(every_env);
-            return (Value){.type = VAL_NIL, .as = {0}};
+            return NIL_VAL;
         }
 
         Value sleep_time_ms = time_val;
 
         Var *sleep_var = find_var(every_env, "__jackal_sleep");
-        if (!sleep_var || sleep_var->value.type != VAL_NATIVE)
+        if (!sleep_var || VALUE_TYPE(sleep_var->value) != VAL_NATIVE)
         {
             print_error("Internal error: __jackal_sleep native function not found.");
             free_value(sleep_time_ms);
             env_free(every_env);
-            return (Value){.type = VAL_NIL, .as = {0}};
+            return NIL_VAL;
         }
-        NativeFn sleep_fn = sleep_var->value.as.native;
+        NativeFn sleep_fn = AS_NATIVE(sleep_var->value);
 
         Node *body = n->right->left;
         Node *until_condition = n->right->right;
@@ -2775,10 +2824,10 @@ Value eval_node(Env *env, Node *n)
 
             Value body_res = eval_node(every_env, body);
 
-            if (body_res.type == VAL_RETURN || body_res.type == VAL_BREAK || body_res.type == VAL_CONTINUE)
+            if (VALUE_TYPE(body_res) == VAL_RETURN || VALUE_TYPE(body_res) == VAL_BREAK || VALUE_TYPE(body_res) == VAL_CONTINUE)
             {
                 free_value(body_res);
-                if (body_res.type == VAL_RETURN || body_res.type == VAL_BREAK)
+                if (VALUE_TYPE(body_res) == VAL_RETURN || VALUE_TYPE(body_res) == VAL_BREAK)
                 {
                     break;
                 }
@@ -2789,7 +2838,7 @@ Value eval_node(Env *env, Node *n)
 
         free_value(sleep_time_ms);
         env_free(every_env);
-        return (Value){.type = VAL_NIL, .as = {0}};
+        return NIL_VAL;
     }
 
     case NODE_OBSERVE_STMT:
@@ -2809,7 +2858,7 @@ Value eval_node(Env *env, Node *n)
 
                     Value action_result = eval_node(env, current_case->right);
 
-                    if (action_result.type == VAL_BREAK || action_result.type == VAL_RETURN)
+                    if (VALUE_TYPE(action_result) == VAL_BREAK || VALUE_TYPE(action_result) == VAL_RETURN)
                     {
                         free_value(action_result);
                         free_value(condition_result);
@@ -2820,18 +2869,21 @@ Value eval_node(Env *env, Node *n)
                 free_value(condition_result);
             }
             Var *sleep_var = find_var(env, "__jackal_sleep");
-            if (sleep_var && sleep_var->value.type == VAL_NATIVE)
+            if (sleep_var && VALUE_TYPE(sleep_var->value) == VAL_NATIVE)
             {
-                Value args[1] = {(Value){VAL_NUMBER, {.number = 1.0}}};
-                Value sleep_res = sleep_var->value.as.native(1, args);
+                Value args[1] = {NUMBER_VAL(1.0)};
+                Value sleep_res = AS_NATIVE(sleep_var->value)(1, args);
                 free_value(sleep_res);
             }
         }
 
-        return (Value){.type = VAL_NIL, .as = {0}};
+        return NIL_VAL;
     }
 
+    case NODE_AWAIT:
+        return async_await(eval_node(env, n->left));
+
     default:
-        return (Value){.type = VAL_NIL, .as = {0}};
+        return NIL_VAL;
     }
 }
@@ -0,0 +1,821 @@
+#include "gc.h"
+#include "value.h"
+#include "eval.h"
+#include "collections/linkedlist.h"
+#include "string_object.h"
+#include "shape.h"
+#include "methods.h"
+#include "task.h"
+#include "async.h"
+#include "csv/dataframe.h"
+#include "csv/csv_stream.h"
+#include <pthread.h>
+#include <setjmp.h>
+#include <stdatomic.h>
+#include <time.h>
+
+#define GC_MIN_THRESHOLD (4 * 1024 * 1024)
+#define GC_TOMBSTONE ((void *)1)
+
+/**
+ * @typedef @struct ROOTMARKER
+ * A callback that marks roots the collector cannot see by itself.
+ */
+typedef struct
+{
+    GCRootMarker marker;
+    void *ctx;
+} RootMarker;
+
+/**
+ * @typedef @struct BLOCKEDTHREAD
+ * A thread parked in gc_blocking_begin: what the collector scans for it
+ * while it does not count as busy.
+ */
+typedef struct BlockedThread
+{
+    jmp_buf registers;
+    char *stack_lo;         // the stack below this is not in use by its callers
+    char *stack_hi;
+    FrameArena *arena;
+    ExceptionState *ex_state;
+    struct BlockedThread *next;
+} BlockedThread;
+
+static pthread_mutex_t gc_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_t main_thread;
+static char *stack_end = NULL;
+static atomic_int busy_threads = 0;
+static atomic_int pauses = 0;
+static bool collecting = false;
+static bool stress = false;
+
+static GCObject *objects = NULL;
+static GCStats stats = {0, 0, 0, 0, 0, GC_MIN_THRESHOLD, 0, 0};
+
+/* Open-addressed set of payload addresses, to recognise managed pointers
+   found on the stack and to tell managed objects from malloc'd ones. */
+static void **object_set = NULL;
+static size_t set_capacity = 0;
+static size_t set_used = 0;
+static uintptr_t lowest_object = UINTPTR_MAX;
+static uintptr_t highest_object = 0;
+
+static GCObject **gray = NULL;
+static size_t gray_count = 0;
+static size_t gray_capacity = 0;
+
+static Value **root_slots = NULL;
+static int root_slot_count = 0;
+static int root_slot_capacity = 0;
+
+static Env **root_envs = NULL;
+static int root_env_count = 0;
+static int root_env_capacity = 0;
+
+static RootMarker *root_markers = NULL;
+static int root_marker_count = 0;
+static int root_marker_capacity = 0;
+
+static BlockedThread *blocked_threads = NULL;
+static __thread BlockedThread blocked_self;
+static __thread char *thread_stack_end = NULL;
+
+#define GROW_ARRAY(array, count, capacity)                              \
+    do                                                                  \
+    {                                                                   \
+        if ((count) == (capacity))                                      \
+        {                                                               \
+            (capacity) = (capacity) < 8 ? 8 : (capacity) * 2;           \
+            (array) = realloc((array), sizeof(*(array)) * (capacity));  \
+        }                                                               \
+    } while (0)
+
+static double now_ms(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000.0 + ts.tv_nsec / 1e6;
+}
+
+static size_t hash_pointer(void *ptr)
+{
+    uint64_t x = (uint64_t)(uintptr_t)ptr >> 4;
+    x *= 0x9E3779B97F4A7C15ULL;
+    return (size_t)(x >> 16);
+}
+
+static long set_find(void *ptr)
+{
+    if (set_capacity == 0)
+        return -1;
+    size_t i = hash_pointer(ptr) & (set_capacity - 1);
+    while (object_set[i] != NULL)
+    {
+        if (object_set[i] == ptr)
+            return (long)i;
+        i = (i + 1) & (set_capacity - 1);
+    }
+    return -1;
+}
+
+static void set_insert_slot(void **slots, size_t capacity, void *ptr)
+{
+    size_t i = hash_pointer(ptr) & (capacity - 1);
+    while (slots[i] != NULL && slots[i] != GC_TOMBSTONE)
+        i = (i + 1) & (capacity - 1);
+    slots[i] = ptr;
+}
+
+static void set_insert(void *ptr)
+{
+    if ((set_used + 1) * 4 > set_capacity * 3)
+    {
+        size_t capacity = set_capacity < 1024 ? 1024 : set_capacity;
+        while ((stats.live_objects + 1) * 2 > capacity)
+            capacity *= 2;
+
+        void **slots = calloc(capacity, sizeof(void *));
+        for (size_t i = 0; i < set_capacity; i++)
+        {
+            if (object_set[i] != NULL && object_set[i] != GC_TOMBSTONE)
+                set_insert_slot(slots, capacity, object_set[i]);
+        }
+        free(object_set);
+        object_set = slots;
+        set_capacity = capacity;
+        set_used = stats.live_objects;
+    }
+
+    set_insert_slot(object_set, set_capacity, ptr);
+    set_used++;
+
+    if ((uintptr_t)ptr < lowest_object)
+        lowest_object = (uintptr_t)ptr;
+    if ((uintptr_t)ptr > highest_object)
+        highest_object = (uintptr_t)ptr;
+}
+
+/** Unlinks an object from the object list and the set; the caller holds the lock. */
+static void forget_object(GCObject *obj, long slot)
+{
+    object_set[slot] = GC_TOMBSTONE;
+
+    if (obj->prev)
+        obj->prev->next = obj->next;
+    else
+        objects = obj->next;
+    if (obj->next)
+        obj->next->prev = obj->prev;
+
+    stats.live_objects--;
+    stats.live_bytes -= sizeof(GCObject) + obj->size;
+}
+
+void gc_init(void)
+{
+    main_thread = pthread_self();
+
+    pthread_attr_t attr;
+    void *stack_addr = NULL;
+    size_t stack_size = 0;
+    if (pthread_getattr_np(main_thread, &attr) == 0)
+    {
+        pthread_attr_getstack(&attr, &stack_addr, &stack_size);
+        pthread_attr_destroy(&attr);
+        stack_end = (char *)stack_addr + stack_size;
+    }
+
+    const char *stress_env = getenv("JACKAL_GC_STRESS");
+    stress = stress_env && strcmp(stress_env, "1") == 0;
+}
+
+char *gc_swap_stack_end(char *end)
+{
+    char *previous = stack_end;
+    stack_end = end;
+    return previous;
+}
+
+void *gc_allocate(size_t size, GCKind kind)
+{
+    if (stress || stats.live_bytes >= stats.threshold)
+        gc_collect();
+
+    GCObject *obj = calloc(1, sizeof(GCObject) + size);
+    if (obj == NULL)
+    {
+        fprintf(stderr, "Fatal Error: Out of Memory!\n");
+        exit(1);
+    }
+    obj->kind = kind;
+    obj->size = size;
+
+    pthread_mutex_lock(&gc_lock);
+    obj->next = objects;
+    if (objects)
+        objects->prev = obj;
+    objects = obj;
+    set_insert(obj + 1);
+    stats.live_objects++;
+    stats.live_bytes += sizeof(GCObject) + size;
+    stats.allocations++;
+    pthread_mutex_unlock(&gc_lock);
+
+    return obj + 1;
+}
+
+void gc_free(void *ptr)
+{
+    if (ptr == NULL)
+        return;
+
+    pthread_mutex_lock(&gc_lock);
+    long slot = set_find(ptr);
+    if (slot < 0)
+    {
+        pthread_mutex_unlock(&gc_lock);
+        free(ptr);
+        return;
+    }
+    GCObject *obj = (GCObject *)ptr - 1;
+    forget_object(obj, slot);
+    pthread_mutex_unlock(&gc_lock);
+
+    free(obj);
+}
+
+bool gc_is_string(const void *ptr)
+{
+    pthread_mutex_lock(&gc_lock);
+    bool found = set_find((void *)ptr) >= 0 && ((GCObject *)ptr - 1)->kind == GC_STRING;
+    pthread_mutex_unlock(&gc_lock);
+    return found;
+}
+
+void gc_add_root(Value *slot)
+{
+    pthread_mutex_lock(&gc_lock);
+    GROW_ARRAY(root_slots, root_slot_count, root_slot_capacity);
+    root_slots[root_slot_count++] = slot;
+    pthread_mutex_unlock(&gc_lock);
+}
+
+void gc_remove_root(Value *slot)
+{
+    pthread_mutex_lock(&gc_lock);
+    for (int i = 0; i < root_slot_count; i++)
+    {
+        if (root_slots[i] == slot)
+        {
+            root_slots[i] = root_slots[--root_slot_count];
+            break;
+        }
+    }
+    pthread_mutex_unlock(&gc_lock);
+}
+
+void gc_add_root_env(Env *env)
+{
+    pthread_mutex_lock(&gc_lock);
+    GROW_ARRAY(root_envs, root_env_count, root_env_capacity);
+    root_envs[root_env_count++] = env;
+    pthread_mutex_unlock(&gc_lock);
+}
+
+void gc_add_root_marker(GCRootMarker marker, void *ctx)
+{
+    pthread_mutex_lock(&gc_lock);
+    GROW_ARRAY(root_markers, root_marker_count, root_marker_capacity);
+    root_markers[root_marker_count++] = (RootMarker){marker, ctx};
+    pthread_mutex_unlock(&gc_lock);
+}
+
+void gc_remove_root_marker(GCRootMarker marker, void *ctx)
+{
+    pthread_mutex_lock(&gc_lock);
+    for (int i = 0; i < root_marker_count; i++)
+    {
+        if (root_markers[i].marker == marker && root_markers[i].ctx == ctx)
+        {
+            root_markers[i] = root_markers[--root_marker_count];
+            break;
+        }
+    }
+    pthread_mutex_unlock(&gc_lock);
+}
+
+void gc_thread_begin(void)
+{
+    atomic_fetch_add(&busy_threads, 1);
+}
+
+void gc_thread_end(void)
+{
+    atomic_fetch_sub(&busy_threads, 1);
+}
+
+__attribute__((noinline)) void gc_blocking_begin(void)
+{
+    if (pthread_equal(pthread_self(), main_thread))
+        return;
+
+    if (thread_stack_end == NULL)
+    {
+        pthread_attr_t attr;
+        void *stack_addr = NULL;
+        size_t stack_size = 0;
+        if (pthread_getattr_np(pthread_self(), &attr) != 0)
+            return;
+        pthread_attr_getstack(&attr, &stack_addr, &stack_size);
+        pthread_attr_destroy(&attr);
+        thread_stack_end = (char *)stack_addr + stack_size;
+    }
+
+    char here;
+    setjmp(blocked_self.registers);
+    blocked_self.stack_lo = &here;
+    blocked_self.stack_hi = thread_stack_end;
+    blocked_self.arena = frame_arena_current();
+    blocked_self.ex_state = &global_ex_state;
+
+    pthread_mutex_lock(&gc_lock);
+    blocked_self.next = blocked_threads;
+    blocked_threads = &blocked_self;
+    atomic_fetch_sub(&busy_threads, 1);
+    pthread_mutex_unlock(&gc_lock);
+}
+
+void gc_blocking_end(void)
+{
+    if (pthread_equal(pthread_self(), main_thread) || thread_stack_end == NULL)
+        return;
+
+    /* Taking the lock waits out a collection that is scanning this thread. */
+    pthread_mutex_lock(&gc_lock);
+    for (BlockedThread **link = &blocked_threads; *link; link = &(*link)->next)
+    {
+        if (*link == &blocked_self)
+        {
+            *link = blocked_self.next;
+            break;
+        }
+    }
+    atomic_fetch_add(&busy_threads, 1);
+    pthread_mutex_unlock(&gc_lock);
+}
+
+void gc_pause(void)
+{
+    atomic_fetch_add(&pauses, 1);
+}
+
+void gc_resume(void)
+{
+    atomic_fetch_sub(&pauses, 1);
+}
+
+bool gc_threads_running(void)
+{
+    return atomic_load(&busy_threads) > 0;
+}
+
+/* ---- Mark ---- */
+
+static void mark_object(void *ptr)
+{
+    if (ptr == NULL || set_find(ptr) < 0)
+        return;
+
+    GCObject *obj = (GCObject *)ptr - 1;
+    if (obj->is_marked)
+        return;
+    obj->is_marked = true;
+
+    GROW_ARRAY(gray, gray_count, gray_capacity);
+    gray[gray_count++] = obj;
+}
+
+void gc_mark_value(Value value)
+{
+    switch (VALUE_TYPE(value))
+    {
+    case VAL_STRING:
+        if (AS_STRING(value))
+            mark_object(STRING_OBJECT(AS_STRING(value)));
+        break;
+    case VAL_FUNCTION:
+        mark_object(AS_FUNCTION(value));
+        break;
+    case VAL_RETURN:
+        mark_object(AS_RETURN(value));
+        break;
+    case VAL_ARRAY:
+        mark_object(AS_ARRAY(value));
+        break;
+    case VAL_CLASS:
+        mark_object(AS_CLASS(value));
+        break;
+    case VAL_INSTANCE:
+        mark_object(AS_INSTANCE(value));
+        break;
+    case VAL_MAP:
+        mark_object(AS_MAP(value));
+        break;
+    case VAL_ENUM:
+        mark_object(AS_ENUM(value));
+        break;
+    case VAL_LINKEDLIST:
+        mark_object(AS_LINKEDLIST(value));
+        break;
+    case VAL_INTERFACE:
+        mark_object(AS_INTERFACE(value));
+        break;
+    case VAL_STRUCT_INSTANCE:
+        mark_object(AS_STRUCT_INSTANCE(value));
+        break;
+    case VAL_NAMESPACE:
+        mark_object(AS_NAMESPACE(value));
+        break;
+    case VAL_TASK:
+        mark_object(AS_TASK(value));
+        break;
+    case VAL_PROMISE:
+        mark_object(AS_PROMISE(value));
+        break;
+    case VAL_DATAFRAME:
+        mark_object(AS_DATAFRAME(value));
+        break;
+    case VAL_CSV_CURSOR:
+        mark_object(AS_CSV_CURSOR(value));
+        break;
+    case VAL_CSV_WRITER:
+        mark_object(AS_CSV_WRITER(value));
+        break;
+    default:
+        break;
+    }
+}
+
+void gc_mark_env(Env *env)
+{
+    mark_object(env);
+}
+
+/** Marks whatever a managed object refers to. */
+static void trace_object(GCObject *obj)
+{
+    void *payload = obj + 1;
+
+    switch ((GCKind)obj->kind)
+    {
+    case GC_STRING:
+    case GC_FRAME:
+    case GC_CSV_WRITER:
+        break;
+    case GC_CSV_CURSOR:
+    {
+        CsvCursor *cursor = payload;
+        for (int i = 0; cursor->cache && i < CSV_STRING_CACHE_SIZE; i++)
+            gc_mark_value(cursor->cache->strings[i]);
+        break;
+    }
+    case GC_ARRAY:
+    {
+        ValueArray *arr = payload;
+        for (int i = 0; i < arr->count; i++)
+            gc_mark_value(arr->values[i]);
+        break;
+    }
+    case GC_MAP:
+    {
+        HashMap *map = payload;
+        for (int i = 0; i < map->capacity; i++)
+        {
+            if (map->entries[i].key != NULL)
+            {
+                mark_object(STRING_OBJECT(map->entries[i].key));
+                gc_mark_value(map->entries[i].value);
+            }
+        }
+        break;
+    }
+    case GC_INSTANCE:
+    {
+        Instance *inst = payload;
+        if (inst->class_val)
+            gc_mark_value(*inst->class_val);
+        for (int i = 0; inst->shape && i < inst->shape->slot_count; i++)
+            gc_mark_value(inst->fields[i]);
+        break;
+    }
+    case GC_STRUCT_INSTANCE:
+    {
+        StructInstance *inst = payload;
+        if (inst->values && inst->definition)
+        {
+            for (int i = 0; i < inst->definition->field_count; i++)
+                gc_mark_value(inst->values[i]);
+        }
+        break;
+    }
+    case GC_FUNCTION:
+    {
+        Func *func = payload;
+        mark_object(func->env);
+        mark_object(func->static_vars);
+        mark_object(func->cache);
+        break;
+    }
+    case GC_CLASS:
+    {
+        Class *klass = payload;
+        mark_object(klass->methods);
+        mark_object(klass->superclass);
+        mark_object(klass->interface);
+        break;
+    }
+    case GC_ENUM:
+        mark_object(((Enum *)payload)->values);
+        break;
+    case GC_INTERFACE:
+        mark_object(((Interface *)payload)->methods);
+        break;
+    case GC_LIST:
+        for (LLNode *node = ((LinkedList *)payload)->head; node; node = node->next)
+            gc_mark_value(node->value);
+        break;
+    case GC_ENV:
+    {
+        Env *env = payload;
+        for (Var *v = env->vars; v; v = v->next)
+            gc_mark_value(v->value);
+        mark_object(env->outer);
+        break;
+    }
+    case GC_BOX:
+        gc_mark_value(*(Value *)payload);
+        break;
+    case GC_TASK:
+    {
+        Task *task = payload;
+        gc_mark_value(task->func);
+        for (int i = 0; i < task->arg_count; i++)
+            gc_mark_value(task->args[i]);
+        gc_mark_value(task->result);
+        break;
+    }
+    case GC_PROMISE:
+        gc_mark_value(((Promise *)payload)->value);
+        break;
+    }
+}
+
+/** Marks every word in [lo, hi) that points at a managed object or at the chars of a managed string. */
+static void scan_word(uintptr_t word)
+{
+    if (word >= lowest_object && word <= highest_object + offsetof(ObjString, chars))
+    {
+        mark_object((void *)word);
+        mark_object(STRING_OBJECT(word));   // a string's chars
+    }
+}
+
+__attribute__((no_sanitize_address)) static void scan_range(const void *lo, const void *hi)
+{
+    uintptr_t p = ((uintptr_t)lo + sizeof(void *) - 1) & ~(uintptr_t)(sizeof(void *) - 1);
+    for (; p + sizeof(void *) <= (uintptr_t)hi; p += sizeof(void *))
+    {
+        uintptr_t word = *(const uintptr_t *)p;
+        scan_word(word);
+#ifdef JACKAL_NAN_BOXING
+        // a boxed Value keeps its pointer under the tag bits
+        uint64_t raw = word ^ VALUE_NIL_BITS;
+        if (value_is_boxed(raw))
+            scan_word(raw & VALUE_PAYLOAD_BITS);
+#endif
+    }
+}
+
+void gc_mark_range(const void *lo, const void *hi)
+{
+    scan_range(lo, hi);
+}
+
+/** Spills the registers into a jmp_buf and scans the live part of the stack. */
+static __attribute__((noinline)) void scan_stack(void)
+{
+    jmp_buf registers;
+    setjmp(registers);
+    scan_range(&registers, stack_end);
+}
+
+static void mark_roots(void)
+{
+    for (int i = 0; i < root_slot_count; i++)
+        gc_mark_value(*root_slots[i]);
+    for (int i = 0; i < root_env_count; i++)
+        mark_object(root_envs[i]);
+    for (int i = 0; i < root_marker_count; i++)
+        root_markers[i].marker(root_markers[i].ctx);
+
+    gc_mark_value(global_ex_state.error_val);
+    scan_range(&global_ex_state.buf, (char *)&global_ex_state.buf + sizeof(jmp_buf));
+    if (stack_end)
+        scan_stack();
+
+    for (BlockedThread *t = blocked_threads; t; t = t->next)
+    {
+        scan_range(&t->registers, (char *)&t->registers + sizeof(jmp_buf));
+        scan_range(t->stack_lo, t->stack_hi);
+        frame_arena_mark(t->arena);
+        gc_mark_value(t->ex_state->error_val);
+    }
+}
+
+/* ---- Sweep ---- */
+
+/** Releases what a dead object owns besides its own block. */
+static void finalize_object(GCObject *obj)
+{
+    void *payload = obj + 1;
+
+    switch ((GCKind)obj->kind)
+    {
+    case GC_ARRAY:
+        free(((ValueArray *)payload)->values);
+        break;
+    case GC_STRING:
+        if (((ObjString *)payload)->is_interned)
+            string_forget(payload);
+        break;
+    case GC_MAP:
+        free(((HashMap *)payload)->entries);
+        break;
+    case GC_INSTANCE:
+        free(((Instance *)payload)->class_val);
+        free(((Instance *)payload)->fields);
+        break;
+    case GC_CLASS:
+        /* A new class may reuse the address, and the methods cached for
+           this one are freed with its environment. */
+        method_cache_flush();
+        break;
+    case GC_STRUCT_INSTANCE:
+        free(((StructInstance *)payload)->values);
+        break;
+    case GC_LIST:
+    {
+        LLNode *node = ((LinkedList *)payload)->head;
+        while (node)
+        {
+            LLNode *next = node->next;
+            free(node);
+            node = next;
+        }
+        break;
+    }
+    case GC_ENV:
+    {
+        Env *env = payload;
+        Var *v = env->vars;
+        while (v)
+        {
+            Var *next = v->next;
+            free(v);
+            v = next;
+        }
+        free(env->slots);
+        break;
+    }
+    case GC_TASK:
+        task_finalize(payload);
+        break;
+    case GC_FRAME:
+        frame_finalize(payload);
+        break;
+    case GC_CSV_CURSOR:
+        csv_cursor_finalize(payload);
+        break;
+    case GC_CSV_WRITER:
+        csv_writer_finalize(payload);
+        break;
+    default:
+        break;
+    }
+}
+
+static size_t sweep(void)
+{
+    size_t freed = 0;
+    GCObject *obj = objects;
+    while (obj)
+    {
+        GCObject *next = obj->next;
+        bool pinned = obj->kind == GC_STRING && ((ObjString *)(obj + 1))->is_pinned;
+        if (obj->is_marked || pinned)
+        {
+            obj->is_marked = false;
+        }
+        else
+        {
+            freed += sizeof(GCObject) + obj->size;
+            forget_object(obj, set_find(obj + 1));
+            finalize_object(obj);
+            free(obj);
+        }
+        obj = next;
+    }
+    return freed;
+}
+
+bool gc_due(void)
+{
+    pthread_mutex_lock(&gc_lock);
+    bool due = stress || stats.live_bytes >= stats.threshold;
+    pthread_mutex_unlock(&gc_lock);
+    return due;
+}
+
+size_t gc_collect(void)
+{
+    if (collecting || !pthread_equal(pthread_self(), main_thread) || atomic_load(&busy_threads) > 0 ||
+        atomic_load(&pauses) > 0)
+        return 0;
+
+    pthread_mutex_lock(&gc_lock);
+    /* Checked again under the lock: a thread leaving gc_blocking_end counts
+       itself busy again while holding it. */
+    if (atomic_load(&busy_threads) > 0)
+    {
+        pthread_mutex_unlock(&gc_lock);
+        return 0;
+    }
+    collecting = true;
+    double start = now_ms();
+
+    mark_roots();
+    while (gray_count > 0)
+        trace_object(gray[--gray_count]);
+    size_t freed = sweep();
+
+    stats.collections++;
+    stats.freed_bytes += freed;
+    stats.threshold = stats.live_bytes * 2 > GC_MIN_THRESHOLD ? stats.live_bytes * 2 : GC_MIN_THRESHOLD;
+    stats.last_pause_ms = now_ms() - start;
+    stats.total_pause_ms += stats.last_pause_ms;
+    pthread_mutex_unlock(&gc_lock);
+
+    collecting = false;
+    return freed;
+}
+
+GCStats gc_stats(void)
+{
+    pthread_mutex_lock(&gc_lock);
+    GCStats copy = stats;
+    pthread_mutex_unlock(&gc_lock);
+    return copy;
+}
+
+/* ---- Natives ---- */
+
+/**
+ * @brief Native '__gc_collect': runs a collection.
+ * @return The number of bytes freed.
+ */
+static Value native_gc_collect(int argCount, Value *args)
+{
+    (void)argCount;
+    (void)args;
+    return NUMBER_VAL((double)gc_collect());
+}
+
+/**
+ * @brief Native '__gc_stats': reports the collector counters.
+ * @return A map of collections, objects, bytes, freed, threshold,
+ * last_pause_ms and total_pause_ms.
+ */
+static Value native_gc_stats(int argCount, Value *args)
+{
+    (void)argCount;
+    (void)args;
+    GCStats s = gc_stats();
+
+    HashMap *map = map_new();
+    map_set(map, "collections", NUMBER_VAL((double)s.collections));
+    map_set(map, "objects", NUMBER_VAL((double)s.live_objects));
+    map_set(map, "bytes", NUMBER_VAL((double)s.live_bytes));
+    map_set(map, "freed", NUMBER_VAL((double)s.freed_bytes));
+    map_set(map, "allocations", NUMBER_VAL((double)s.allocations));
+    map_set(map, "threshold", NUMBER_VAL((double)s.threshold));
+    map_set(map, "last_pause_ms", NUMBER_VAL(s.last_pause_ms));
+    map_set(map, "total_pause_ms", NUMBER_VAL(s.total_pause_ms));
+    return MAP_VAL(map);
+}
+
+void register_gc_natives(Env *env)
+{
+    set_var(env, "__gc_collect", NATIVE_VAL(native_gc_collect), true, "");
+    set_var(env, "__gc_stats", NATIVE_VAL(native_gc_stats), true, "");
+}
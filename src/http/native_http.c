@@ -5,7 +5,11 @@
 #include <math.h>
 #include <sys/stat.h>
 #include <stdio.h>
+#include <pthread.h>
 #include "env.h"
+#include "async.h"
+#include "string_object.h"
+#include "gc.h"
 
 #if __has_include(<curl/curl.h>)
     #include <curl/curl.h>
@@ -17,15 +21,89 @@
 #define HTTP_REGISTER(env, name, func)                                           \
     do                                                                           \
     {                                                                            \
-        set_var(env, name, (Value){VAL_NATIVE, {.native = func}}, true, "");     \
+        set_var(env, name, NATIVE_VAL(func), true, "");     \
     } while (0)
 
 #if HAS_CURL
+#define HTTP_IDLE_HANDLES 16            // easy handles kept per thread for the next request
+#define HTTP_MAX_HOST_CONNECTIONS 16    // further requests to a host wait for a free connection
+
 struct HttpBuffer {
     char *data;
     size_t size;
 };
 
+/**
+ * @typedef @struct HTTPTRANSFER
+ * One request in flight on the event loop's curl multi handle.
+ */
+typedef struct HttpTransfer {
+    CURL *curl;
+    struct HttpBuffer body;
+    struct curl_slist *headers;
+    bool status_only;          // settle with the response code instead of the body
+    Promise *promise;
+    int index;                 // position in a batch
+} HttpTransfer;
+
+static CURLM *multi = NULL;
+static AsyncTimer *multi_timer = NULL;
+
+/*
+ * Connections are cached by multi handles: the event loop's, and one per
+ * other thread that makes requests, since libcurl cannot share a
+ * connection cache between threads. Resolved addresses and TLS sessions
+ * are shared by all of them. Finished easy handles are kept for reuse.
+ */
+static pthread_once_t curl_once = PTHREAD_ONCE_INIT;
+static CURLSH *share = NULL;
+static pthread_mutex_t share_locks[CURL_LOCK_DATA_LAST];
+static __thread CURLM *thread_multi = NULL;
+static __thread CURL *idle_handles[HTTP_IDLE_HANDLES];
+static __thread int idle_count = 0;
+
+static void share_lock(CURL *handle, curl_lock_data data, curl_lock_access access, void *userp) {
+    pthread_mutex_lock(&share_locks[data]);
+}
+
+static void share_unlock(CURL *handle, curl_lock_data data, void *userp) {
+    pthread_mutex_unlock(&share_locks[data]);
+}
+
+static void curl_setup(void) {
+    curl_global_init(CURL_GLOBAL_ALL);
+    for (int i = 0; i < CURL_LOCK_DATA_LAST; i++) pthread_mutex_init(&share_locks[i], NULL);
+    share = curl_share_init();
+    curl_share_setopt(share, CURLSHOPT_LOCKFUNC, share_lock);
+    curl_share_setopt(share, CURLSHOPT_UNLOCKFUNC, share_unlock);
+    curl_share_setopt(share, CURLSHOPT_SHARE, CURL_LOCK_DATA_DNS);
+    curl_share_setopt(share, CURLSHOPT_SHARE, CURL_LOCK_DATA_SSL_SESSION);
+}
+
+static CURLM *multi_new(void) {
+    CURLM *m = curl_multi_init();
+    curl_multi_setopt(m, CURLMOPT_MAX_HOST_CONNECTIONS, (long)HTTP_MAX_HOST_CONNECTIONS);
+    return m;
+}
+
+static CURL *handle_acquire(void) {
+    pthread_once(&curl_once, curl_setup);
+    CURL *curl;
+    if (idle_count > 0) {
+        curl = idle_handles[--idle_count];
+        curl_easy_reset(curl);
+    } else {
+        curl = curl_easy_init();
+    }
+    if (curl) curl_easy_setopt(curl, CURLOPT_SHARE, share);
+    return curl;
+}
+
+static void handle_release(CURL *curl) {
+    if (idle_count < HTTP_IDLE_HANDLES) idle_handles[idle_count++] = curl;
+    else curl_easy_cleanup(curl);
+}
+
 static size_t write_callback(void *contents, size_t size, size_t nmemb, void *userp) {
     size_t realsize = size * nmemb;
     struct HttpBuffer *mem = (struct HttpBuffer *)userp;
@@ -40,157 +118,344 @@ static size_t write_callback(void *contents, size_t size, size_t nmemb, void *us
 
     return realsize;
 }
-#endif
 
-Value native_http_get(int arity, Value *args) {
-#if HAS_CURL
-    if (arity < 1 || args[0].type != VAL_STRING) {
-        return (Value){VAL_NIL};
+static HttpTransfer *transfer_new(void) {
+    HttpTransfer *t = calloc(1, sizeof(HttpTransfer));
+    t->body.data = malloc(1);
+    t->body.data[0] = '\0';
+    t->curl = handle_acquire();
+    if (t->curl) {
+        curl_easy_setopt(t->curl, CURLOPT_WRITEFUNCTION, write_callback);
+        curl_easy_setopt(t->curl, CURLOPT_WRITEDATA, (void *)&t->body);
+        curl_easy_setopt(t->curl, CURLOPT_PRIVATE, t);
     }
+    return t;
+}
 
-    CURL *curl_handle;
-    CURLcode res;
-    struct HttpBuffer chunk = {malloc(1), 0};
+/**
+ * The natives' result for a finished transfer: the body (nil on failure),
+ * or the response code for status requests.
+ */
+static Value transfer_finish(HttpTransfer *t, CURLcode res) {
+    Value result = NIL_VAL;
+    if (t->status_only) {
+        long response_code = 0;
+        if (res == CURLE_OK) curl_easy_getinfo(t->curl, CURLINFO_RESPONSE_CODE, &response_code);
+        result = NUMBER_VAL((double)response_code);
+    } else if (res == CURLE_OK) {
+        result = string_copy(t->body.data);
+    }
 
-    curl_global_init(CURL_GLOBAL_ALL);
-    curl_handle = curl_easy_init();
+    if (t->curl) handle_release(t->curl);
+    curl_slist_free_all(t->headers);
+    free(t->body.data);
+    free(t);
+    return result;
+}
+
+static void check_multi_info(void) {
+    CURLMsg *msg;
+    int pending;
+    while ((msg = curl_multi_info_read(multi, &pending))) {
+        if (msg->msg != CURLMSG_DONE) continue;
+        HttpTransfer *t = NULL;
+        CURLcode res = msg->data.result;
+        curl_easy_getinfo(msg->easy_handle, CURLINFO_PRIVATE, (char **)&t);
+        curl_multi_remove_handle(multi, msg->easy_handle);
+
+        Promise *promise = t->promise;
+        promise_resolve(promise, transfer_finish(t, res));
+    }
+}
+
+static void on_socket_ready(void *ctx, int fd, int events) {
+    int flags = ((events & ASYNC_READ) ? CURL_CSELECT_IN : 0) | ((events & ASYNC_WRITE) ? CURL_CSELECT_OUT : 0);
+    int running;
+    curl_multi_socket_action(multi, fd, flags, &running);
+    check_multi_info();
+}
+
+static int on_socket(CURL *easy, curl_socket_t s, int what, void *userp, void *socketp) {
+    int events = 0;
+    if (what == CURL_POLL_IN || what == CURL_POLL_INOUT) events |= ASYNC_READ;
+    if (what == CURL_POLL_OUT || what == CURL_POLL_INOUT) events |= ASYNC_WRITE;
+    async_watch(s, events, on_socket_ready, NULL);
+    return 0;
+}
+
+static void on_timeout(void *ctx) {
+    int running;
+    multi_timer = NULL;
+    curl_multi_socket_action(multi, CURL_SOCKET_TIMEOUT, 0, &running);
+    check_multi_info();
+}
+
+static int on_timer(CURLM *m, long timeout_ms, void *userp) {
+    async_timer_cancel(multi_timer);
+    multi_timer = timeout_ms >= 0 ? async_timer_start((double)timeout_ms, on_timeout, NULL) : NULL;
+    return 0;
+}
 
-    if (curl_handle) {
-        curl_easy_setopt(curl_handle, CURLOPT_URL, args[0].as.string);
-        curl_easy_setopt(curl_handle, CURLOPT_WRITEFUNCTION, write_callback);
-        curl_easy_setopt(curl_handle, CURLOPT_WRITEDATA, (void *)&chunk);
-        curl_easy_setopt(curl_handle, CURLOPT_TIMEOUT, 10L);
+/**
+ * Starts a transfer on the event loop's multi handle.
+ * @return The promise it settles.
+ */
+static Value loop_start(HttpTransfer *t) {
+    if (multi == NULL) {
+        multi = multi_new();
+        curl_multi_setopt(multi, CURLMOPT_SOCKETFUNCTION, on_socket);
+        curl_multi_setopt(multi, CURLMOPT_TIMERFUNCTION, on_timer);
+    }
 
-        res = curl_easy_perform(curl_handle);
+    Promise *promise = promise_new();
+    t->promise = promise;
+    curl_multi_add_handle(multi, t->curl);
+    return PROMISE_VAL(promise);
+}
 
-        if (res != CURLE_OK) {
-            free(chunk.data);
-            curl_easy_cleanup(curl_handle);
-            return (Value){VAL_NIL};
+/**
+ * Runs the transfers added to the calling thread's multi handle until count
+ * of them have finished, storing each result at results[t->index]. The
+ * collector may run while the thread waits, so results must be somewhere
+ * it looks: a stack Value or a managed array, not malloc'd memory.
+ */
+static void thread_drive(int count, Value *results) {
+    while (count > 0) {
+        int running;
+        curl_multi_perform(thread_multi, &running);
+
+        CURLMsg *msg;
+        int pending;
+        while ((msg = curl_multi_info_read(thread_multi, &pending))) {
+            if (msg->msg != CURLMSG_DONE) continue;
+            HttpTransfer *t = NULL;
+            CURLcode res = msg->data.result;
+            curl_easy_getinfo(msg->easy_handle, CURLINFO_PRIVATE, (char **)&t);
+            curl_multi_remove_handle(thread_multi, msg->easy_handle);
+            results[t->index] = transfer_finish(t, res);
+            count--;
+        }
+        if (count > 0) {
+            gc_blocking_begin();
+            curl_multi_poll(thread_multi, NULL, 0, 1000, NULL);
+            gc_blocking_end();
         }
-        curl_easy_cleanup(curl_handle);
     }
+}
 
-    Value result = (Value){VAL_STRING, {.string = strdup(chunk.data)}};
-    free(chunk.data);
+static void thread_start(HttpTransfer *t) {
+    if (thread_multi == NULL) thread_multi = multi_new();
+    curl_multi_add_handle(thread_multi, t->curl);
+}
+
+/**
+ * Runs a transfer. On the event loop's thread it joins the loop's multi
+ * handle, so a fiber waiting for the response lets the others run and any
+ * number of requests can be in flight at once; elsewhere it blocks on the
+ * thread's own multi handle, which keeps its connections for the next call.
+ */
+static Value http_perform(HttpTransfer *t) {
+    if (!t->curl) return transfer_finish(t, CURLE_FAILED_INIT);
+    if (async_loop_thread()) return async_await(loop_start(t));
+
+    Value result = NIL_VAL;
+    t->index = 0;
+    thread_start(t);
+    thread_drive(1, &result);
     return result;
+}
+
+/** Sends headers given as an array of "Name: value" lines or a map of names to values. */
+static void transfer_add_headers(HttpTransfer *t, Value headers) {
+    if (VALUE_TYPE(headers) == VAL_ARRAY) {
+        ValueArray *arr = AS_ARRAY(headers);
+        for (int i = 0; i < arr->count; i++) {
+            if (VALUE_TYPE(arr->values[i]) == VAL_STRING) t->headers = curl_slist_append(t->headers, AS_STRING(arr->values[i]));
+        }
+    } else if (VALUE_TYPE(headers) == VAL_MAP) {
+        HashMap *map = AS_MAP(headers);
+        for (int i = 0; i < map->capacity; i++) {
+            if (map->entries[i].key == NULL) continue;
+            char *value = value_to_string(map->entries[i].value);
+            size_t length = strlen(map->entries[i].key) + strlen(value) + 3;
+            char *line = malloc(length);
+            snprintf(line, length, "%s: %s", map->entries[i].key, value);
+            t->headers = curl_slist_append(t->headers, line);
+            free(line);
+            free(value);
+        }
+    } else {
+        return;
+    }
+    curl_easy_setopt(t->curl, CURLOPT_HTTPHEADER, t->headers);
+}
+#endif
+
+Value native_http_get(int arity, Value *args) {
+#if HAS_CURL
+    if (arity < 1 || VALUE_TYPE(args[0]) != VAL_STRING) {
+        return NIL_VAL;
+    }
+
+    HttpTransfer *t = transfer_new();
+    if (t->curl) {
+        curl_easy_setopt(t->curl, CURLOPT_URL, AS_STRING(args[0]));
+        curl_easy_setopt(t->curl, CURLOPT_TIMEOUT, 10L);
+    }
+    return http_perform(t);
 #else
     fprintf(stderr, "Error: HTTP support (libcurl) not compiled into Jackal.\n");
-    return (Value){VAL_NIL};
+    return NIL_VAL;
 #endif
 }
 
 Value native_http_post(int arity, Value *args) {
 #if HAS_CURL
-    if (arity < 2 || args[0].type != VAL_STRING || args[1].type != VAL_STRING) {
-        return (Value){VAL_NIL};
+    if (arity < 2 || VALUE_TYPE(args[0]) != VAL_STRING || VALUE_TYPE(args[1]) != VAL_STRING) {
+        return NIL_VAL;
     }
 
-    CURL *curl_handle;
-    CURLcode res;
-    struct HttpBuffer chunk = {malloc(1), 0};
-
-    curl_handle = curl_easy_init();
-
-    if (curl_handle) {
-        curl_easy_setopt(curl_handle, CURLOPT_URL, args[0].as.string);
-        curl_easy_setopt(curl_handle, CURLOPT_POST, 1L);
-        curl_easy_setopt(curl_handle, CURLOPT_POSTFIELDS, args[1].as.string);
-        curl_easy_setopt(curl_handle, CURLOPT_WRITEFUNCTION, write_callback);
-        curl_easy_setopt(curl_handle, CURLOPT_WRITEDATA, (void *)&chunk);
-        curl_easy_setopt(curl_handle, CURLOPT_USERAGENT, "Jackal-Interpreter/1.0");
-
-        res = curl_easy_perform(curl_handle);
-
-        if (res != CURLE_OK) {
-            free(chunk.data);
-            curl_easy_cleanup(curl_handle);
-            return (Value){VAL_NIL};
-        }
-        curl_easy_cleanup(curl_handle);
+    HttpTransfer *t = transfer_new();
+    if (t->curl) {
+        curl_easy_setopt(t->curl, CURLOPT_URL, AS_STRING(args[0]));
+        curl_easy_setopt(t->curl, CURLOPT_POST, 1L);
+        curl_easy_setopt(t->curl, CURLOPT_COPYPOSTFIELDS, AS_STRING(args[1]));
+        curl_easy_setopt(t->curl, CURLOPT_USERAGENT, "Jackal-Interpreter/1.0");
+        if (arity >= 3) transfer_add_headers(t, args[2]);
     }
-
-    Value result = (Value){VAL_STRING, {.string = strdup(chunk.data)}};
-    free(chunk.data);
-    return result;
+    return http_perform(t);
 #else
-    return (Value){VAL_NIL};
+    return NIL_VAL;
 #endif
 }
 
 Value native_http_get_headers(int arity, Value *args) {
 #if HAS_CURL
-    if (arity < 2 || args[0].type != VAL_STRING || args[1].type != VAL_ARRAY) {
-        return (Value){VAL_NIL};
+    if (arity < 2 || VALUE_TYPE(args[0]) != VAL_STRING || VALUE_TYPE(args[1]) != VAL_ARRAY) {
+        return NIL_VAL;
     }
 
-    CURL *curl_handle;
-    CURLcode res;
-    struct HttpBuffer chunk = {malloc(1), 0};
-    struct curl_slist *header_list = NULL;
-
-    ValueArray *arr = args[1].as.array; 
-
-    curl_handle = curl_easy_init();
-    if (curl_handle) {
-        for (int i = 0; i < arr->count; i++) {
-            Value item = arr->values[i];
-            if (item.type == VAL_STRING) {
-                header_list = curl_slist_append(header_list, item.as.string);
-            }
-        }
-
-        curl_easy_setopt(curl_handle, CURLOPT_URL, args[0].as.string);
-        curl_easy_setopt(curl_handle, CURLOPT_HTTPHEADER, header_list);
-        curl_easy_setopt(curl_handle, CURLOPT_WRITEFUNCTION, write_callback);
-        curl_easy_setopt(curl_handle, CURLOPT_WRITEDATA, (void *)&chunk);
-        curl_easy_setopt(curl_handle, CURLOPT_USERAGENT, "Jackal-Interpreter/1.0");
-
-        res = curl_easy_perform(curl_handle);
-        curl_slist_free_all(header_list);
-        
-        if (res != CURLE_OK) {
-            free(chunk.data);
-            curl_easy_cleanup(curl_handle);
-            return (Value){VAL_NIL};
-        }
-        curl_easy_cleanup(curl_handle);
+    HttpTransfer *t = transfer_new();
+    if (t->curl) {
+        transfer_add_headers(t, args[1]);
+        curl_easy_setopt(t->curl, CURLOPT_URL, AS_STRING(args[0]));
+        curl_easy_setopt(t->curl, CURLOPT_USERAGENT, "Jackal-Interpreter/1.0");
     }
-
-    Value result = (Value){VAL_STRING, {.string = strdup(chunk.data)}};
-    free(chunk.data);
-    return result;
+    return http_perform(t);
 #else
-    return (Value){VAL_NIL};
+    return NIL_VAL;
 #endif
 }
 
 Value native_http_get_status(int arity, Value *args) {
 #if HAS_CURL
-    if (arity < 1 || args[0].type != VAL_STRING) return (Value){VAL_NUMBER, {.number = 0}};
+    if (arity < 1 || VALUE_TYPE(args[0]) != VAL_STRING) return NUMBER_VAL(0);
 
-    CURL *curl_handle = curl_easy_init();
-    long response_code = 0;
+    HttpTransfer *t = transfer_new();
+    t->status_only = true;
+    if (t->curl) {
+        curl_easy_setopt(t->curl, CURLOPT_URL, AS_STRING(args[0]));
+        curl_easy_setopt(t->curl, CURLOPT_NOBODY, 1L);
+    }
+    return http_perform(t);
+#else
+    return NUMBER_VAL(0);
+#endif
+}
 
-    if (curl_handle) {
-        curl_easy_setopt(curl_handle, CURLOPT_URL, args[0].as.string);
-        curl_easy_setopt(curl_handle, CURLOPT_NOBODY, 1L); 
-        CURLcode res = curl_easy_perform(curl_handle);
+/**
+ * Native 'http_request': the request behind std.network.http.Request.
+ * @param args[0] Method, e.g. "GET" or "POST".
+ * @param args[1] URL.
+ * @param args[2] Request body, or nil.
+ * @param args[3] Headers as a map or an array of lines (optional).
+ * @return The response body, or nil on failure.
+ */
+Value native_http_request(int arity, Value *args) {
+#if HAS_CURL
+    if (arity < 2 || VALUE_TYPE(args[0]) != VAL_STRING || VALUE_TYPE(args[1]) != VAL_STRING) {
+        return NIL_VAL;
+    }
 
-        if (res == CURLE_OK) {
-            curl_easy_getinfo(curl_handle, CURLINFO_RESPONSE_CODE, &response_code);
+    HttpTransfer *t = transfer_new();
+    if (t->curl) {
+        curl_easy_setopt(t->curl, CURLOPT_URL, AS_STRING(args[1]));
+        curl_easy_setopt(t->curl, CURLOPT_CUSTOMREQUEST, AS_STRING(args[0]));
+        curl_easy_setopt(t->curl, CURLOPT_USERAGENT, "Jackal-Interpreter/1.0");
+        curl_easy_setopt(t->curl, CURLOPT_TIMEOUT, 10L);
+        if (arity >= 3 && VALUE_TYPE(args[2]) == VAL_STRING) {
+            curl_easy_setopt(t->curl, CURLOPT_COPYPOSTFIELDS, AS_STRING(args[2]));
         }
-        curl_easy_cleanup(curl_handle);
+        if (arity >= 4) transfer_add_headers(t, args[3]);
     }
-    return (Value){VAL_NUMBER, {.number = (double)response_code}};
+    return http_perform(t);
 #else
-    return (Value){VAL_NUMBER, {.number = 0}};
+    return NIL_VAL;
 #endif
 }
 
+/**
+ * Native '__http_get_all': fetches many URLs at once, reusing connections
+ * to the same hosts.
+ * @param args[0] Array of URLs.
+ * @param args[1] Headers sent with each request, as for http_request (optional).
+ * @return Array of the bodies in the same order, nil where a request failed.
+ */
+Value native_http_get_all(int arity, Value *args) {
+    ValueArray *results = array_new();
+    Value result = ARRAY_VAL(results);
+#if HAS_CURL
+    if (arity < 1 || VALUE_TYPE(args[0]) != VAL_ARRAY) return result;
+
+    ValueArray *urls = AS_ARRAY(args[0]);
+    int count = urls->count;
+    bool on_loop = async_loop_thread();
+    int started = 0;
+
+    for (int i = 0; i < count; i++) {
+        Value url = urls->values[i];
+        HttpTransfer *t = VALUE_TYPE(url) == VAL_STRING ? transfer_new() : NULL;
+        if (t && !t->curl) {
+            transfer_finish(t, CURLE_FAILED_INIT);
+            t = NULL;
+        }
+        if (t == NULL) {
+            array_append(results, NIL_VAL);
+            continue;
+        }
+
+        curl_easy_setopt(t->curl, CURLOPT_URL, AS_STRING(url));
+        curl_easy_setopt(t->curl, CURLOPT_TIMEOUT, 10L);
+        if (arity >= 2) transfer_add_headers(t, args[1]);
+
+        /* On the loop the array holds each promise until it is awaited;
+           elsewhere a nil that thread_drive replaces with the body. */
+        if (on_loop) {
+            array_append(results, loop_start(t));
+        } else {
+            t->index = i;
+            thread_start(t);
+            array_append(results, NIL_VAL);
+            started++;
+        }
+    }
+
+    if (on_loop) {
+        for (int i = 0; i < count; i++) results->values[i] = async_await(results->values[i]);
+    } else {
+        /* Straight into the array, which the collector sees while the
+           thread waits for the other transfers. */
+        thread_drive(started, results->values);
+    }
+#endif
+    return result;
+}
+
 void register_http_natives(Env *env){
     HTTP_REGISTER(env,"__http_get",native_http_get);
     HTTP_REGISTER(env,"__http_post",native_http_post);
     HTTP_REGISTER(env,"__http_header",native_http_get_headers);
     HTTP_REGISTER(env,"__http_status",native_http_get_status);
+    HTTP_REGISTER(env,"__http_get_all",native_http_get_all);
+    HTTP_REGISTER(env,"http_request",native_http_request);
 }
\ No newline at end of file
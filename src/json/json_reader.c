@@ -0,0 +1,358 @@
+#include "json/json_reader.h"
+#include "string_object.h"
+#include "gc.h"
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+/**
+ * @typedef @struct JSONPARSER
+ * Input being read, and a scratch buffer for strings with escapes.
+ */
+typedef struct {
+    const char* p;
+    const char* end;
+    int depth;
+    char* scratch;
+    size_t scratch_capacity;
+} JsonParser;
+
+static bool parse_value(JsonParser* parser, Value* out);
+
+static inline void skip_whitespace(JsonParser* parser) {
+    while (parser->p < parser->end && (unsigned char)*parser->p <= ' ') parser->p++;
+}
+
+/* ---- Strings ---- */
+
+/** Finds the first '"' or '\\' in [p, end), or end. */
+static const char* find_quote_or_escape(const char* p, const char* end) {
+#ifdef __SSE2__
+    const __m128i quote = _mm_set1_epi8('"');
+    const __m128i backslash = _mm_set1_epi8('\\');
+    for (; end - p >= 16; p += 16) {
+        __m128i block = _mm_loadu_si128((const __m128i*)p);
+        __m128i hits = _mm_or_si128(_mm_cmpeq_epi8(block, quote), _mm_cmpeq_epi8(block, backslash));
+        unsigned mask = (unsigned)_mm_movemask_epi8(hits);
+        if (mask) return p + __builtin_ctz(mask);
+    }
+#endif
+    for (; p < end; p++) {
+        if (*p == '"' || *p == '\\') return p;
+    }
+    return end;
+}
+
+static char* scratch_reserve(JsonParser* parser, size_t length, size_t n) {
+    if (length + n > parser->scratch_capacity) {
+        size_t capacity = parser->scratch_capacity ? parser->scratch_capacity * 2 : 256;
+        while (capacity < length + n) capacity *= 2;
+        parser->scratch = realloc(parser->scratch, capacity);
+        parser->scratch_capacity = capacity;
+    }
+    return parser->scratch + length;
+}
+
+static bool parse_hex4(const char* p, const char* end, uint32_t* out) {
+    if (end - p < 4) return false;
+    uint32_t code = 0;
+    for (int i = 0; i < 4; i++) {
+        char c = p[i];
+        code <<= 4;
+        if (c >= '0' && c <= '9') code |= (uint32_t)(c - '0');
+        else if (c >= 'a' && c <= 'f') code |= (uint32_t)(c - 'a' + 10);
+        else if (c >= 'A' && c <= 'F') code |= (uint32_t)(c - 'A' + 10);
+        else return false;
+    }
+    *out = code;
+    return true;
+}
+
+/**
+ * Decodes a \u escape (a surrogate pair counts as one) at p, which points
+ * just past the 'u', into UTF-8.
+ * @return Number of UTF-8 bytes written, 0 if the escape is malformed.
+ */
+static int decode_unicode(const char** p, const char* end, char* utf8) {
+    uint32_t code;
+    if (!parse_hex4(*p, end, &code)) return 0;
+    *p += 4;
+    if (code >= 0xDC00 && code <= 0xDFFF) return 0;
+    if (code >= 0xD800 && code <= 0xDBFF) {
+        uint32_t low;
+        if (end - *p < 6 || (*p)[0] != '\\' || (*p)[1] != 'u') return 0;
+        if (!parse_hex4(*p + 2, end, &low) || low < 0xDC00 || low > 0xDFFF) return 0;
+        *p += 6;
+        code = 0x10000 + (((code & 0x3FF) << 10) | (low & 0x3FF));
+    }
+
+    if (code < 0x80) {
+        utf8[0] = (char)code;
+        return 1;
+    }
+    if (code < 0x800) {
+        utf8[0] = (char)(0xC0 | (code >> 6));
+        utf8[1] = (char)(0x80 | (code & 0x3F));
+        return 2;
+    }
+    if (code < 0x10000) {
+        utf8[0] = (char)(0xE0 | (code >> 12));
+        utf8[1] = (char)(0x80 | ((code >> 6) & 0x3F));
+        utf8[2] = (char)(0x80 | (code & 0x3F));
+        return 3;
+    }
+    utf8[0] = (char)(0xF0 | (code >> 18));
+    utf8[1] = (char)(0x80 | ((code >> 12) & 0x3F));
+    utf8[2] = (char)(0x80 | ((code >> 6) & 0x3F));
+    utf8[3] = (char)(0x80 | (code & 0x3F));
+    return 4;
+}
+
+/**
+ * Reads a string whose opening quote is at parser->p.
+ * @param chars Receives the text: the input itself if it has no escapes,
+ *              otherwise the scratch buffer.
+ */
+static bool parse_string_body(JsonParser* parser, const char** chars, size_t* length) {
+    const char* start = ++parser->p;
+    const char* hit = find_quote_or_escape(start, parser->end);
+    if (hit == parser->end) return false;
+    if (*hit == '"') {
+        *chars = start;
+        *length = (size_t)(hit - start);
+        parser->p = hit + 1;
+        return true;
+    }
+
+    size_t used = 0;
+    const char* p = start;
+    for (;;) {
+        size_t run = (size_t)(hit - p);
+        memcpy(scratch_reserve(parser, used, run + 4), p, run);
+        used += run;
+        if (hit == parser->end) return false;
+        if (*hit == '"') break;
+
+        p = hit + 1;
+        if (p == parser->end) return false;
+        char* dest = parser->scratch + used;
+        switch (*p++) {
+            case '"': *dest = '"'; used++; break;
+            case '\\': *dest = '\\'; used++; break;
+            case '/': *dest = '/'; used++; break;
+            case 'b': *dest = '\b'; used++; break;
+            case 'f': *dest = '\f'; used++; break;
+            case 'n': *dest = '\n'; used++; break;
+            case 'r': *dest = '\r'; used++; break;
+            case 't': *dest = '\t'; used++; break;
+            case 'u': {
+                int n = decode_unicode(&p, parser->end, dest);
+                if (n == 0) return false;
+                used += (size_t)n;
+                break;
+            }
+            default:
+                return false;
+        }
+        hit = find_quote_or_escape(p, parser->end);
+    }
+    *chars = parser->scratch;
+    *length = used;
+    parser->p = hit + 1;
+    return true;
+}
+
+/* ---- Numbers ---- */
+
+static const double powers_of_ten[] = {
+    1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+static inline bool is_digit(char c) {
+    return c >= '0' && c <= '9';
+}
+
+/**
+ * Reads a number in plain JSON form whose digits fit in 2^53 and whose
+ * scale is at most 10^22 either way: both are exact doubles, so one
+ * multiply or divide rounds correctly.
+ * @return false to leave the number to strtod.
+ */
+static bool parse_number_fast(const char* p, const char* end, double* out, const char** stop) {
+    bool negative = false;
+    if (p < end && *p == '-') {
+        negative = true;
+        p++;
+    }
+    if (p == end || !is_digit(*p)) return false;
+
+    uint64_t mantissa = 0;
+    int digits = 0;
+    int exponent = 0;
+    for (; p < end && is_digit(*p); p++) {
+        mantissa = mantissa * 10 + (uint64_t)(*p - '0');
+        if (mantissa != 0) digits++;
+    }
+    if (p < end && *p == '.') {
+        p++;
+        if (p == end || !is_digit(*p)) return false;
+        for (; p < end && is_digit(*p); p++) {
+            mantissa = mantissa * 10 + (uint64_t)(*p - '0');
+            if (mantissa != 0) digits++;
+            exponent--;
+        }
+    }
+    if (p < end && (*p == 'e' || *p == 'E')) {
+        p++;
+        bool negative_exponent = false;
+        if (p < end && (*p == '+' || *p == '-')) negative_exponent = *p++ == '-';
+        if (p == end || !is_digit(*p)) return false;
+        int e = 0;
+        for (; p < end && is_digit(*p); p++) {
+            if (e > 10000) return false;
+            e = e * 10 + (*p - '0');
+        }
+        exponent += negative_exponent ? -e : e;
+    }
+    if (digits > 15 || mantissa > (1ULL << 53) || exponent < -22 || exponent > 22) return false;
+
+    double value = (double)mantissa;
+    value = exponent < 0 ? value / powers_of_ten[-exponent] : value * powers_of_ten[exponent];
+    *out = negative ? -value : value;
+    *stop = p;
+    return true;
+}
+
+static bool parse_number(JsonParser* parser, Value* out) {
+    double number;
+    const char* stop;
+    if (!parse_number_fast(parser->p, parser->end, &number, &stop)) {
+        /* Long or unusual numbers: strtod on a terminated copy of the span. */
+        const char* p = parser->p;
+        while (p < parser->end && (is_digit(*p) || *p == '+' || *p == '-' || *p == '.' || *p == 'e' || *p == 'E')) p++;
+        size_t length = (size_t)(p - parser->p);
+        char local[64];
+        char* copy = length < sizeof(local) ? local : malloc(length + 1);
+        memcpy(copy, parser->p, length);
+        copy[length] = '\0';
+        char* copy_stop;
+        number = strtod(copy, &copy_stop);
+        stop = parser->p + (copy_stop - copy);
+        if (copy != local) free(copy);
+        if (stop == parser->p) return false;
+    }
+    parser->p = stop;
+    *out = NUMBER_VAL(number);
+    return true;
+}
+
+/* ---- Values ---- */
+
+static bool parse_array(JsonParser* parser, Value* out) {
+    ValueArray* arr = array_new();
+    *out = ARRAY_VAL(arr);
+    parser->p++;
+    skip_whitespace(parser);
+    if (parser->p < parser->end && *parser->p == ']') {
+        parser->p++;
+        return true;
+    }
+    for (;;) {
+        Value element;
+        if (!parse_value(parser, &element)) return false;
+        array_append(arr, element);
+        skip_whitespace(parser);
+        if (parser->p == parser->end) return false;
+        char c = *parser->p++;
+        if (c == ']') return true;
+        if (c != ',') return false;
+    }
+}
+
+static bool parse_object(JsonParser* parser, Value* out) {
+    HashMap* map = map_new();
+    *out = MAP_VAL(map);
+    parser->p++;
+    skip_whitespace(parser);
+    if (parser->p < parser->end && *parser->p == '}') {
+        parser->p++;
+        return true;
+    }
+    for (;;) {
+        const char* chars;
+        size_t length;
+        skip_whitespace(parser);
+        if (parser->p == parser->end || *parser->p != '"') return false;
+        if (!parse_string_body(parser, &chars, &length)) return false;
+        ObjString* key = string_intern(chars, length);
+
+        skip_whitespace(parser);
+        if (parser->p == parser->end || *parser->p != ':') return false;
+        parser->p++;
+        Value member;
+        if (!parse_value(parser, &member)) return false;
+        map_set_string(map, key, member);
+
+        skip_whitespace(parser);
+        if (parser->p == parser->end) return false;
+        char c = *parser->p++;
+        if (c == '}') return true;
+        if (c != ',') return false;
+    }
+}
+
+static bool parse_literal(JsonParser* parser, const char* word, size_t length) {
+    if ((size_t)(parser->end - parser->p) < length || memcmp(parser->p, word, length) != 0) return false;
+    parser->p += length;
+    return true;
+}
+
+static bool parse_value(JsonParser* parser, Value* out) {
+    skip_whitespace(parser);
+    if (parser->p == parser->end) return false;
+
+    switch (*parser->p) {
+        case '"': {
+            const char* chars;
+            size_t length;
+            if (!parse_string_body(parser, &chars, &length)) return false;
+            *out = string_new(chars, length);
+            return true;
+        }
+        case '{':
+        case '[': {
+            if (++parser->depth > JSON_PARSE_MAX_DEPTH) return false;
+            bool ok = *parser->p == '{' ? parse_object(parser, out) : parse_array(parser, out);
+            parser->depth--;
+            return ok;
+        }
+        case 't':
+            *out = BOOL_VAL(true);
+            return parse_literal(parser, "true", 4);
+        case 'f':
+            *out = BOOL_VAL(false);
+            return parse_literal(parser, "false", 5);
+        case 'n':
+            *out = NIL_VAL;
+            return parse_literal(parser, "null", 4);
+        default:
+            if (is_digit(*parser->p) || *parser->p == '-') return parse_number(parser, out);
+            return false;
+    }
+}
+
+bool json_parse(const char* text, size_t length, Value* out) {
+    JsonParser parser = {text, text + length, 0, NULL, 0};
+    gc_pause();                         // every value made is kept, so collecting midway frees nothing
+    bool ok = parse_value(&parser, out);
+    gc_resume();
+    free(parser.scratch);
+    if (!ok) *out = NIL_VAL;
+    return ok;
+}
@@ -0,0 +1,219 @@
+#include "json/json_writer.h"
+#include "shape.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#define JSON_BUFFER_KEEP (1 << 20)  // a thread's buffer grown past this is dropped before the next call
+
+static void buffer_reserve(JsonBuffer* buffer, size_t n) {
+    if (buffer->length + n <= buffer->capacity) return;
+    size_t capacity = buffer->capacity ? buffer->capacity * 2 : 256;
+    while (capacity < buffer->length + n) capacity *= 2;
+    buffer->data = realloc(buffer->data, capacity);
+    buffer->capacity = capacity;
+}
+
+static inline void buffer_append(JsonBuffer* buffer, const char* data, size_t length) {
+    buffer_reserve(buffer, length);
+    memcpy(buffer->data + buffer->length, data, length);
+    buffer->length += length;
+}
+
+static inline void buffer_char(JsonBuffer* buffer, char c) {
+    buffer_reserve(buffer, 1);
+    buffer->data[buffer->length++] = c;
+}
+
+void json_buffer_free(JsonBuffer* buffer) {
+    free(buffer->data);
+    buffer->data = NULL;
+    buffer->length = buffer->capacity = 0;
+}
+
+/* ---- Strings ---- */
+
+static inline bool needs_escape(unsigned char c) {
+    return c == '"' || c == '\\' || c < 0x20;
+}
+
+/** Finds the first byte in [p, end) that has to be escaped, or end. */
+static const char* find_escape(const char* p, const char* end) {
+#ifdef __SSE2__
+    const __m128i quote = _mm_set1_epi8('"');
+    const __m128i backslash = _mm_set1_epi8('\\');
+    const __m128i control = _mm_set1_epi8(0x1f);
+    for (; end - p >= 16; p += 16) {
+        __m128i block = _mm_loadu_si128((const __m128i*)p);
+        __m128i low = _mm_cmpeq_epi8(_mm_max_epu8(block, control), control);     // bytes <= 0x1f
+        __m128i hits = _mm_or_si128(low, _mm_or_si128(_mm_cmpeq_epi8(block, quote), _mm_cmpeq_epi8(block, backslash)));
+        unsigned mask = (unsigned)_mm_movemask_epi8(hits);
+        if (mask) return p + __builtin_ctz(mask);
+    }
+#endif
+    for (; p < end; p++) {
+        if (needs_escape((unsigned char)*p)) return p;
+    }
+    return end;
+}
+
+static void write_string(JsonBuffer* buffer, const char* text, size_t length) {
+    static const char hex[] = "0123456789abcdef";
+    const char* end = text + length;
+
+    buffer_reserve(buffer, length + 2);
+    buffer->data[buffer->length++] = '"';
+    while (text < end) {
+        const char* special = find_escape(text, end);
+        buffer_append(buffer, text, special - text);
+        if (special == end) break;
+
+        unsigned char c = (unsigned char)*special;
+        char escape[6] = {'\\', 0};
+        size_t n = 2;
+        switch (c) {
+            case '"': escape[1] = '"'; break;
+            case '\\': escape[1] = '\\'; break;
+            case '\b': escape[1] = 'b'; break;
+            case '\f': escape[1] = 'f'; break;
+            case '\n': escape[1] = 'n'; break;
+            case '\r': escape[1] = 'r'; break;
+            case '\t': escape[1] = 't'; break;
+            default:
+                memcpy(escape + 1, "u00", 3);
+                escape[4] = hex[c >> 4];
+                escape[5] = hex[c & 15];
+                n = 6;
+                break;
+        }
+        buffer_append(buffer, escape, n);
+        text = special + 1;
+    }
+    buffer_char(buffer, '"');
+}
+
+/* ---- Numbers ---- */
+
+static void write_number(JsonBuffer* buffer, double d) {
+    if (isnan(d) || isinf(d)) {
+        buffer_append(buffer, "null", 4);
+        return;
+    }
+
+    char text[32];
+    int n;
+    if (d == floor(d) && fabs(d) < 1e15) {
+        /* Whole numbers, which is most of them, without going through printf. */
+        char* p = text + sizeof(text);
+        long long v = (long long)d;
+        unsigned long long magnitude = v < 0 ? -(unsigned long long)v : (unsigned long long)v;
+        do {
+            *--p = (char)('0' + magnitude % 10);
+            magnitude /= 10;
+        } while (magnitude);
+        if (v < 0) *--p = '-';
+        buffer_append(buffer, p, text + sizeof(text) - p);
+        return;
+    }
+    n = snprintf(text, sizeof(text), "%1.15g", d);
+    if (strtod(text, NULL) != d) n = snprintf(text, sizeof(text), "%1.17g", d);
+    buffer_append(buffer, text, n);
+}
+
+/* ---- Values ---- */
+
+static void write_value(JsonBuffer* buffer, Value value, int depth) {
+    if (depth > JSON_MAX_DEPTH) {
+        buffer_append(buffer, "null", 4);
+        return;
+    }
+
+    switch (VALUE_TYPE(value)) {
+        case VAL_NIL:
+            buffer_append(buffer, "null", 4);
+            break;
+        case VAL_BOOL:
+            if (AS_BOOL(value)) buffer_append(buffer, "true", 4);
+            else buffer_append(buffer, "false", 5);
+            break;
+        case VAL_NUMBER:
+            write_number(buffer, AS_NUMBER(value));
+            break;
+        case VAL_STRING:
+            write_string(buffer, AS_STRING(value), strlen(AS_STRING(value)));
+            break;
+        case VAL_ARRAY: {
+            ValueArray* arr = AS_ARRAY(value);
+            buffer_char(buffer, '[');
+            for (int i = 0; i < arr->count; i++) {
+                if (i > 0) buffer_char(buffer, ',');
+                write_value(buffer, arr->values[i], depth + 1);
+            }
+            buffer_char(buffer, ']');
+            break;
+        }
+        case VAL_MAP: {
+            HashMap* map = AS_MAP(value);
+            bool first = true;
+            buffer_char(buffer, '{');
+            for (int i = 0; i < map->capacity; i++) {
+                Entry* entry = &map->entries[i];
+                if (entry->key == NULL) continue;
+                if (!first) buffer_char(buffer, ',');
+                first = false;
+                write_string(buffer, entry->key, strlen(entry->key));
+                buffer_char(buffer, ':');
+                write_value(buffer, entry->value, depth + 1);
+            }
+            buffer_char(buffer, '}');
+            break;
+        }
+        case VAL_INSTANCE: {
+            /* Newest field first, as the cJSON encoder added them. */
+            Instance* inst = AS_INSTANCE(value);
+            buffer_char(buffer, '{');
+            for (int i = inst->shape ? inst->shape->slot_count - 1 : -1; i >= 0; i--) {
+                ObjString* name = inst->shape->names[i];
+                write_string(buffer, name->chars, name->length);
+                buffer_char(buffer, ':');
+                write_value(buffer, inst->fields[i], depth + 1);
+                if (i > 0) buffer_char(buffer, ',');
+            }
+            buffer_char(buffer, '}');
+            break;
+        }
+        case VAL_FUNCTION:
+        case VAL_NATIVE:
+            buffer_append(buffer, "\"<Function>\"", 12);
+            break;
+        case VAL_CLASS: {
+            char text[160];
+            int n = snprintf(text, sizeof(text), "<Class %s>", AS_CLASS(value)->name);
+            write_string(buffer, text, n < (int)sizeof(text) ? (size_t)n : sizeof(text) - 1);
+            break;
+        }
+        default:
+            buffer_append(buffer, "null", 4);
+            break;
+    }
+}
+
+void json_write_value(JsonBuffer* buffer, Value value) {
+    write_value(buffer, value, 0);
+}
+
+const char* json_encode(Value value, size_t* length) {
+    static __thread JsonBuffer buffer;
+    if (buffer.capacity > JSON_BUFFER_KEEP) json_buffer_free(&buffer);
+    buffer.length = 0;
+    write_value(&buffer, value, 0);
+    buffer_char(&buffer, '\0');
+    *length = --buffer.length;
+    return buffer.data;
+}
@@ -5,7 +5,6 @@
 #include <math.h>
 #include <errno.h>
 #include <curl/curl.h>
-#include <cjson/cJSON.h>
 #include <time.h>
 /**
  * @include socket built in
@@ -30,6 +29,7 @@
 #include "value.h"
 #include "parser.h"
 #include "eval.h"
+#include "resolver.h"
 #include "native/native_registry.h"
 
 /**
@@ -40,6 +40,12 @@
  * @include compiler option
  */
 #include "compiler/compiler.h"
+#include "compiler/jlo.h"
+#include "module.h"
+#include "gc.h"
+#include "async.h"
+#include "string_object.h"
+#include "json/json_writer.h"
 #include "vm/vm.h"
 
 #include "socket/net_utils.h"
@@ -56,7 +62,7 @@ Value builtin_vm_memory(int argCount, Value *args)
 {
     (void)argCount;
     (void)args;
-    return (Value){VAL_NUMBER, {.number = (double)bytesAllocated}};
+    return NUMBER_VAL((double)bytesAllocated);
 }
 
 /**
@@ -95,14 +101,14 @@ struct Memory
 
 Value builtin_net_listen(int argCount, Value *args)
 {
-    if (argCount != 1 || args[0].type != VAL_NUMBER)
-        return (Value){VAL_NIL, {0}};
+    if (argCount != 1 || VALUE_TYPE(args[0]) != VAL_NUMBER)
+        return NIL_VAL;
 
-    int port = (int)args[0].as.number;
+    int port = (int)AS_NUMBER(args[0]);
     int server_fd = socket(AF_INET, SOCK_STREAM, 0);
 
     if (server_fd == -1)
-        return (Value){VAL_NUMBER, {.number = -1.0}};
+        return NUMBER_VAL(-1.0);
 
     struct sockaddr_in address;
     address.sin_family = AF_INET;
@@ -112,66 +118,66 @@ Value builtin_net_listen(int argCount, Value *args)
     if (bind(server_fd, (struct sockaddr *)&address, sizeof(address)) < 0)
     {
         close(server_fd);
-        return (Value){VAL_NUMBER, {.number = -1.0}};
+        return NUMBER_VAL(-1.0);
     }
 
     if (listen(server_fd, 5) < 0)
     {
         close(server_fd);
-        return (Value){VAL_NUMBER, {.number = -1.0}};
+        return NUMBER_VAL(-1.0);
     }
 
-    return (Value){VAL_NUMBER, {.number = (double)server_fd}};
+    return NUMBER_VAL((double)server_fd);
 }
 
 Value builtin_net_accept(int argCount, Value *args)
 {
-    if (argCount != 1 || args[0].type != VAL_NUMBER)
-        return (Value){VAL_NIL, {0}};
+    if (argCount != 1 || VALUE_TYPE(args[0]) != VAL_NUMBER)
+        return NIL_VAL;
 
-    int server_fd = (int)args[0].as.number;
+    int server_fd = (int)AS_NUMBER(args[0]);
     struct sockaddr_in address;
     socklen_t addrlen = sizeof(address);
     int new_socket = accept(server_fd, (struct sockaddr *)&address, &addrlen);
 
     if (new_socket < 0)
-        return (Value){VAL_NUMBER, {.number = -1.0}};
+        return NUMBER_VAL(-1.0);
 
-    return (Value){VAL_NUMBER, {.number = (double)new_socket}};
+    return NUMBER_VAL((double)new_socket);
 }
 
 Value builtin_net_send(int argCount, Value *args)
 {
-    if (argCount != 2 || args[0].type != VAL_NUMBER || args[1].type != VAL_STRING)
-        return (Value){VAL_NIL, {0}};
+    if (argCount != 2 || VALUE_TYPE(args[0]) != VAL_NUMBER || VALUE_TYPE(args[1]) != VAL_STRING)
+        return NIL_VAL;
 
-    int socket_fd = (int)args[0].as.number;
-    const char *message = args[1].as.string;
+    int socket_fd = (int)AS_NUMBER(args[0]);
+    const char *message = AS_STRING(args[1]);
 
     ssize_t sent = send(socket_fd, message, strlen(message), 0);
-    return (Value){VAL_NUMBER, {.number = (double)sent}};
+    return NUMBER_VAL((double)sent);
 }
 
 Value builtin_net_close(int argCount, Value *args)
 {
-    if (argCount != 1 || args[0].type != VAL_NUMBER)
-        return (Value){VAL_NIL, {0}};
+    if (argCount != 1 || VALUE_TYPE(args[0]) != VAL_NUMBER)
+        return NIL_VAL;
 
-    int socket_fd = (int)args[0].as.number;
+    int socket_fd = (int)AS_NUMBER(args[0]);
     int res = close(socket_fd);
-    return (Value){VAL_NUMBER, {.number = (double)res}};
+    return NUMBER_VAL((double)res);
 }
 
 
 Value builtin_net_resolve_ip(int argCount, Value *args)
 {
-    if (argCount != 1 || args[0].type != VAL_STRING)
+    if (argCount != 1 || VALUE_TYPE(args[0]) != VAL_STRING)
     {
         print_error("resolve_ip() requires one string argument (hostname).");
-        return (Value){VAL_NIL, {0}};
+        return NIL_VAL;
     }
 
-    const char *hostname = args[0].as.string;
+    const char *hostname = AS_STRING(args[0]);
     struct addrinfo hints, *res, *p;
     int status;
     char ipstr[INET6_ADDRSTRLEN];
@@ -183,7 +189,7 @@ Value builtin_net_resolve_ip(int argCount, Value *args)
     if ((status = getaddrinfo(hostname, NULL, &hints, &res)) != 0)
     {
         print_error("getaddrinfo error: %s", gai_strerror(status));
-        return (Value){VAL_NIL, {0}};
+        return NIL_VAL;
     }
 
     for (p = res; p != NULL; p = p->ai_next)
@@ -213,13 +219,10 @@ Value builtin_net_resolve_ip(int argCount, Value *args)
     if (ipstr[0] == '\0')
     {
         print_error("Could not find IP address for hostname '%s'.", hostname);
-        return (Value){VAL_NIL, {0}};
+        return NIL_VAL;
     }
 
-    char *ip_copy = malloc(strlen(ipstr) + 1);
-    strcpy(ip_copy, ipstr);
-
-    return (Value){VAL_STRING, {.string = ip_copy}};
+    return string_copy(ipstr);
 }
 
 static size_t WriteMemoryCallback(void *contents, size_t size, size_t nmemb, void *userp)
@@ -244,19 +247,19 @@ static size_t WriteMemoryCallback(void *contents, size_t size, size_t nmemb, voi
 
 Value builtin_http_request(int argCount, Value *args)
 {
-    if (argCount < 2 || args[0].type != VAL_STRING || args[1].type != VAL_STRING)
+    if (argCount < 2 || VALUE_TYPE(args[0]) != VAL_STRING || VALUE_TYPE(args[1]) != VAL_STRING)
     {
         print_error("Usage: http_request(method, url, [body], [headers_map])");
-        return (Value){VAL_NIL, {0}};
+        return NIL_VAL;
     }
 
-    const char *method = args[0].as.string;
-    const char *url = args[1].as.string;
-    const char *body = (argCount > 2 && args[2].type == VAL_STRING) ? args[2].as.string : NULL;
+    const char *method = AS_STRING(args[0]);
+    const char *url = AS_STRING(args[1]);
+    const char *body = (argCount > 2 && VALUE_TYPE(args[2]) == VAL_STRING) ? AS_STRING(args[2]) : NULL;
 
     CURL *curl_handle = curl_easy_init();
     if (!curl_handle)
-        return (Value){VAL_NIL, {0}};
+        return NIL_VAL;
 
     struct Memory chunk = {.memory = malloc(1), .size = 0};
     struct curl_slist *headers = NULL;
@@ -267,9 +270,9 @@ Value builtin_http_request(int argCount, Value *args)
     curl_easy_setopt(curl_handle, CURLOPT_TIMEOUT, 30L);
     curl_easy_setopt(curl_handle, CURLOPT_FOLLOWLOCATION, 1L);
 
-    if (argCount > 3 && args[3].type == VAL_MAP)
+    if (argCount > 3 && VALUE_TYPE(args[3]) == VAL_MAP)
     {
-        HashMap *map = args[3].as.map;
+        HashMap *map = AS_MAP(args[3]);
         for (int i = 0; i < map->capacity; i++)
         {
             Entry *entry = &map->entries[i];
@@ -316,7 +319,9 @@ Value builtin_http_request(int argCount, Value *args)
             curl_easy_setopt(curl_handle, CURLOPT_POSTFIELDS, body);
     }
 
+    gc_blocking_begin();
     CURLcode res = curl_easy_perform(curl_handle);
+    gc_blocking_end();
 
     if (res != CURLE_OK)
     {
@@ -336,9 +341,7 @@ cleanup:
     curl_slist_free_all(headers);
     curl_easy_cleanup(curl_handle);
 
-    Value result;
-    result.type = VAL_STRING;
-    result.as.string = strdup(chunk.memory); 
+    Value result = string_copy(chunk.memory);
 
     free(chunk.memory);
     return result;
@@ -348,53 +351,35 @@ Value builtin_json_encode(int argCount, Value *args)
     if (argCount != 1)
     {
         print_error("json_encode requires one argument.");
-        return (Value){VAL_NIL, {0}};
-    }
-
-    cJSON *root = jackal_value_to_cjson(args[0]);
-
-    if (root == NULL)
-    {
-        print_error("json_encode failed to serialize object (Unsupported type).");
-        return (Value){VAL_NIL, {0}};
+        return NIL_VAL;
     }
 
-    char *json_string = cJSON_PrintUnformatted(root);
-    cJSON_Delete(root);
-
-    if (json_string == NULL)
-    {
-        print_error("cJSON_PrintUnformatted failed.");
-        return (Value){VAL_NIL, {0}};
-    }
-
-    Value result = (Value){VAL_STRING, {.string = json_string}};
-
-    return result;
+    size_t length;
+    const char *json_string = json_encode(args[0], &length);
+    return string_new(json_string, length);
 }
 
 Value builtin_time_sleep(int argCount, Value *args)
 {
-    if (argCount != 1 || args[0].type != VAL_NUMBER)
-        return (Value){VAL_NIL, {0}};
+    if (argCount != 1 || VALUE_TYPE(args[0]) != VAL_NUMBER)
+        return NIL_VAL;
 
-    long ms = (long)args[0].as.number;
-    usleep(ms * 1000);
-    return (Value){VAL_NIL, {0}};
+    async_sleep_ms(AS_NUMBER(args[0]));
+    return NIL_VAL;
 }
 
 Value builtin_time_now(int argCount, Value *args)
 {
     if (argCount != 0)
-        return (Value){VAL_NIL, {0}};
+        return NIL_VAL;
 
     time_t current_time = time(NULL);
-    return (Value){VAL_NUMBER, {.number = (double)current_time}};
+    return NUMBER_VAL((double)current_time);
 }
 Value builtin_time_get_local_hour(int argCount, Value *args)
 {
     if (argCount != 0)
-        return (Value){VAL_NIL, {0}};
+        return NIL_VAL;
 
     time_t rawtime;
     struct tm *info;
@@ -402,7 +387,7 @@ Value builtin_time_get_local_hour(int argCount, Value *args)
     time(&rawtime);
     info = localtime(&rawtime);
 
-    return (Value){VAL_NUMBER, {.number = (double)info->tm_hour}};
+    return NUMBER_VAL((double)info->tm_hour);
 }
 /**
  * this method is part of std.io library
@@ -414,113 +399,114 @@ Value builtin_time_get_local_hour(int argCount, Value *args)
 Value builtin_io_open(int argCount, Value *args)
 {
 
-    if (argCount != 2 || args[0].type != VAL_STRING || args[1].type != VAL_STRING)
-        return (Value){VAL_NIL, {0}};
+    if (argCount != 2 || VALUE_TYPE(args[0]) != VAL_STRING || VALUE_TYPE(args[1]) != VAL_STRING)
+        return NIL_VAL;
 
-    FILE *f = fopen(args[0].as.string, args[1].as.string);
+    FILE *f = fopen(AS_STRING(args[0]), AS_STRING(args[1]));
 
     if (f == NULL)
-        return (Value){VAL_NIL, {0}};
-    return (Value){VAL_FILE, {.file = f}};
+        return NIL_VAL;
+    return FILE_VAL(f);
 }
 
 Value builtin_io_readAll(int argCount, Value *args)
 {
 
-    if (argCount != 1 || args[0].type != VAL_FILE)
-        return (Value){VAL_NIL, {0}};
+    if (argCount != 1 || VALUE_TYPE(args[0]) != VAL_FILE)
+        return NIL_VAL;
 
-    FILE *f = args[0].as.file;
+    FILE *f = AS_FILE(args[0]);
 
     if (f == NULL)
-        return (Value){VAL_NIL, {0}};
+        return NIL_VAL;
 
     fseek(f, 0, SEEK_END);
     long fsize = ftell(f);
     rewind(f);
     char *content = malloc(fsize + 1);
-    fread(content, 1, fsize, f);
-    content[fsize] = '\0';
-    return (Value){VAL_STRING, {.string = content}};
+    size_t length = fread(content, 1, fsize, f);
+    Value result = string_new(content, length);
+    free(content);
+    return result;
 }
 
 Value builtin_io_write(int argCount, Value *args)
 {
-    if (argCount != 2 || args[0].type != VAL_FILE || args[1].type != VAL_STRING)
-        return (Value){VAL_NIL, {0}};
-    FILE *f = args[0].as.file;
+    if (argCount != 2 || VALUE_TYPE(args[0]) != VAL_FILE || VALUE_TYPE(args[1]) != VAL_STRING)
+        return NIL_VAL;
+    FILE *f = AS_FILE(args[0]);
     if (f == NULL)
-        return (Value){VAL_NIL, {0}};
-    fputs(args[1].as.string, f);
-    return (Value){VAL_NIL, {0}};
+        return NIL_VAL;
+    fputs(AS_STRING(args[1]), f);
+    return NIL_VAL;
 }
 
 Value builtin_io_close(int argCount, Value *args)
 {
-    if (argCount != 1 || args[0].type != VAL_FILE)
-        return (Value){VAL_NIL, {0}};
-    FILE *f = args[0].as.file;
+    if (argCount != 1 || VALUE_TYPE(args[0]) != VAL_FILE)
+        return NIL_VAL;
+    FILE *f = AS_FILE(args[0]);
     if (f == NULL)
-        return (Value){VAL_NIL, {0}};
+        return NIL_VAL;
     fclose(f);
-    return (Value){VAL_NIL, {0}};
+    return NIL_VAL;
 }
 
 Value builtin_net_htons(int argCount, Value *args)
 {
-    if (argCount != 1 || args[0].type != VAL_NUMBER)
+    if (argCount != 1 || VALUE_TYPE(args[0]) != VAL_NUMBER)
     {
         print_error("htons() requires one number argument (port).");
-        return (Value){VAL_NUMBER, {.number = -1.0}};
+        return NUMBER_VAL(-1.0);
     }
 
-    uint16_t port = (uint16_t)args[0].as.number;
+    uint16_t port = (uint16_t)AS_NUMBER(args[0]);
 
     uint16_t net_port = htons(port);
 
-    return (Value){VAL_NUMBER, {.number = (double)net_port}};
+    return NUMBER_VAL((double)net_port);
 }
 
 Value builtin_math_fmod(int argCount, Value *args)
 {
-    if (argCount != 2 || args[0].type != VAL_NUMBER || args[1].type != VAL_NUMBER)
+    if (argCount != 2 || VALUE_TYPE(args[0]) != VAL_NUMBER || VALUE_TYPE(args[1]) != VAL_NUMBER)
     {
         print_error("fmod() requires two number arguments (numerator, denominator).");
-        return (Value){VAL_NIL, {0}};
+        return NIL_VAL;
     }
-    return (Value){VAL_NUMBER, {.number = fmod(args[0].as.number, args[1].as.number)}};
+    return NUMBER_VAL(fmod(AS_NUMBER(args[0]), AS_NUMBER(args[1])));
 }
 
 Value builtin_net_aton(int argCount, Value *args)
 {
-    if (argCount != 1 || args[0].type != VAL_STRING)
+    if (argCount != 1 || VALUE_TYPE(args[0]) != VAL_STRING)
     {
         print_error("aton() requires one string argument (IPv4 address).");
-        return (Value){VAL_NUMBER, {.number = -1.0}};
+        return NUMBER_VAL(-1.0);
     }
 
-    const char *ip_string = args[0].as.string;
+    const char *ip_string = AS_STRING(args[0]);
 
     in_addr_t binary_address = inet_addr(ip_string);
 
     if (binary_address == INADDR_NONE)
     {
         print_error("Invalid IPv4 address format: %s", ip_string);
-        return (Value){VAL_NUMBER, {.number = -1.0}};
+        return NUMBER_VAL(-1.0);
     }
 
-    return (Value){VAL_NUMBER, {.number = (double)binary_address}};
+    return NUMBER_VAL((double)binary_address);
 }
 
 Value builtin_net_ntoa(int argCount, Value *args)
 {
-    if (argCount != 1 || args[0].type != VAL_NUMBER)
+    if (argCount != 1 || VALUE_TYPE(args[0]) != VAL_NUMBER)
     {
         print_error("ntoa() requires one number argument (binary IP).");
-        return (Value){VAL_NIL, {0}};
+        return NIL_VAL;
     }
 
-    in_addr_t binary_address = (in_addr_t)args[0].as.number;
+    in_addr_t binary_address = (in_addr_t)AS_NUMBER(args[0]);
 
     struct in_addr addr;
     addr.s_addr = binary_address;
@@ -529,23 +515,19 @@ Value builtin_net_ntoa(int argCount, Value *args)
 
     if (ip_string == NULL)
     {
-        return (Value){VAL_NIL, {0}};
+        return NIL_VAL;
     }
 
-    char *ip_copy = malloc(strlen(ip_string) + 1);
-    strcpy(ip_copy, ip_string);
-
-    return (Value){VAL_STRING, {.string = ip_copy}};
+    return string_copy(ip_string);
 }
 
 Value builtin_jackal_sleep(int argCount, Value *args)
 {
-    if (argCount != 1 || args[0].type != VAL_NUMBER)
-        return (Value){VAL_NIL, {0}};
+    if (argCount != 1 || VALUE_TYPE(args[0]) != VAL_NUMBER)
+        return NIL_VAL;
 
-    long ms = (long)args[0].as.number;
-    usleep(ms * 1000);
-    return (Value){VAL_NIL, {0}};
+    async_sleep_ms(AS_NUMBER(args[0]));
+    return NIL_VAL;
 }
 
 /**
@@ -584,13 +566,13 @@ Value builtin_typeof(int argCount, Value *args)
     if (argCount != 1)
     {
         fprintf(stderr, "Runtime Error: typeof() takes exactly 1 argument.\n");
-        return (Value){VAL_NIL, {0}};
+        return NIL_VAL;
     }
 
     Value arg = args[0];
     const char *type_string;
 
-    switch (arg.type)
+    switch (VALUE_TYPE(arg))
     {
     case VAL_NIL:
         type_string = "nil";
@@ -628,14 +610,27 @@ Value builtin_typeof(int argCount, Value *args)
     case VAL_FILE:
         type_string = "file";
         break;
+    case VAL_TASK:
+        type_string = "task";
+        break;
+    case VAL_PROMISE:
+        type_string = "promise";
+        break;
+    case VAL_DATAFRAME:
+        type_string = "dataframe";
+        break;
+    case VAL_CSV_CURSOR:
+        type_string = "csvcursor";
+        break;
+    case VAL_CSV_WRITER:
+        type_string = "csvwriter";
+        break;
     default:
         type_string = "unknown";
         break;
     }
 
-    char *str_copy = malloc(strlen(type_string) + 1);
-    strcpy(str_copy, type_string);
-    return (Value){VAL_STRING, {.string = str_copy}};
+    return string_copy(type_string);
 }
 
 /**
@@ -651,53 +646,33 @@ Value builtin_file_open(int argCount, Value *args)
     if (argCount != 2)
     {
         fprintf(stderr, "[DEBUG] Error: Argumen File() kurang atau lebih dari 2\n");
-        return (Value){VAL_NIL, {0}};
+        return NIL_VAL;
     }
-    if (args[0].type != VAL_STRING || args[1].type != VAL_STRING)
+    if (VALUE_TYPE(args[0]) != VAL_STRING || VALUE_TYPE(args[1]) != VAL_STRING)
     {
         fprintf(stderr, "[DEBUG] Error: Argumen File() bukan string\n");
-        return (Value){VAL_NIL, {0}};
+        return NIL_VAL;
     }
 
-    const char *path = args[0].as.string;
-    const char *mode = args[1].as.string;
+    const char *path = AS_STRING(args[0]);
+    const char *mode = AS_STRING(args[1]);
 
     FILE *f = fopen(path, mode);
     if (f == NULL)
     {
         perror("");
-        return (Value){VAL_NIL, {0}};
+        return NIL_VAL;
     }
 
-    return (Value){VAL_FILE, {.file = f}};
+    return FILE_VAL(f);
 }
 
 void load_jackal_file(const char *path, Env *env)
 {
-    char *source = read_file_content(path);
-    if (!source)
+    if (!module_run(env, path))
     {
         printf("Warning: Standard library file '%s' not found or empty.\n", path);
-        return;
-    }
-
-    Lexer L;
-    Parser P;
-
-    lexer_init(&L, source);
-    parser_init(&P, &L);
-
-    while (P.current.kind != TOKEN_END)
-    {
-        Node *stmt = parse_stmt(&P);
-        if (stmt)
-        {
-            Value result = eval_node(env, stmt);
-            free_value(result);
-            free_node(stmt);
-        }
     }
-    free(source);
 }
 
 /**
@@ -712,29 +687,29 @@ Value builtin_len(int argCount, Value *args)
     if (argCount != 1)
     {
         fprintf(stderr, "Runtime Error: 'len' takes exactly 1 argument.\n");
-        return (Value){VAL_NIL, {0}};
+        return NIL_VAL;
     }
 
     Value arg = args[0];
 
-    if (arg.type == VAL_STRING)
+    if (VALUE_TYPE(arg) == VAL_STRING)
     {
-        return (Value){VAL_NUMBER, {.number = (double)strlen(arg.as.string)}};
+        return NUMBER_VAL((double)strlen(AS_STRING(arg)));
     }
 
-    if (arg.type == VAL_ARRAY)
+    if (VALUE_TYPE(arg) == VAL_ARRAY)
     {
-        return (Value){VAL_NUMBER, {.number = (double)arg.as.array->count}};
+        return NUMBER_VAL((double)AS_ARRAY(arg)->count);
     }
 
-    fprintf(stderr, "[DEBUG] len() called on invalid type: %d\n", arg.type);
+    fprintf(stderr, "[DEBUG] len() called on invalid type: %d\n", VALUE_TYPE(arg));
 
-    if (arg.type == VAL_NIL)
+    if (VALUE_TYPE(arg) == VAL_NIL)
     {
         fprintf(stderr, "Runtime Error: Argument to 'len' is NIL (variable might be empty).\n");
     }
 
-    return (Value){VAL_NIL, {0}};
+    return NIL_VAL;
 }
 
 /**
@@ -748,15 +723,15 @@ Value builtin_push(int argCount, Value *args)
     if (argCount != 2)
     {
         fprintf(stderr, "Runtime Error: 'push' takes exactly 2 arguments (array, value).\n");
-        return (Value){VAL_NIL, {0}};
+        return NIL_VAL;
     }
-    if (args[0].type != VAL_ARRAY)
+    if (VALUE_TYPE(args[0]) != VAL_ARRAY)
     {
         fprintf(stderr, "Runtime Error: First argument to 'push' must be an array.\n");
-        return (Value){VAL_NIL, {0}};
+        return NIL_VAL;
     }
-    array_append(args[0].as.array, copy_value(args[1]));
-    return (Value){VAL_NIL, {0}};
+    array_append(AS_ARRAY(args[0]), copy_value(args[1]));
+    return NIL_VAL;
 }
 
 /**
@@ -771,14 +746,14 @@ Value builtin_pop(int argCount, Value *args)
     if (argCount != 1)
     {
         fprintf(stderr, "Runtime Error: 'pop' takes exactly 1 argument (array).\n");
-        return (Value){VAL_NIL, {0}};
+        return NIL_VAL;
     }
-    if (args[0].type != VAL_ARRAY)
+    if (VALUE_TYPE(args[0]) != VAL_ARRAY)
     {
         fprintf(stderr, "Runtime Error: Argument to 'pop' must be an array.\n");
-        return (Value){VAL_NIL, {0}};
+        return NIL_VAL;
     }
-    return array_pop(args[0].as.array);
+    return array_pop(AS_ARRAY(args[0]));
 }
 
 /**
@@ -793,25 +768,25 @@ Value builtin_remove(int argCount, Value *args)
     if (argCount != 2)
     {
         fprintf(stderr, "Runtime Error: 'remove' takes exactly 2 arguments (array, index).\n");
-        return (Value){VAL_NIL, {0}};
+        return NIL_VAL;
     }
-    if (args[0].type != VAL_ARRAY || args[1].type != VAL_NUMBER)
+    if (VALUE_TYPE(args[0]) != VAL_ARRAY || VALUE_TYPE(args[1]) != VAL_NUMBER)
     {
         fprintf(stderr, "Runtime Error: Invalid arguments for 'remove'. Expected (array, index number).\n");
-        return (Value){VAL_NIL, {0}};
+        return NIL_VAL;
     }
 
-    int index = (int)args[1].as.number;
-    ValueArray *arr = args[0].as.array;
+    int index = (int)AS_NUMBER(args[1]);
+    ValueArray *arr = AS_ARRAY(args[0]);
 
     if (index < 0 || index >= arr->count)
     {
         fprintf(stderr, "Runtime Error: Array index out of bounds.\n");
-        return (Value){VAL_NIL, {0}};
+        return NIL_VAL;
     }
 
     array_delete(arr, index);
-    return (Value){VAL_NIL, {0}};
+    return NIL_VAL;
 }
 
 /**
@@ -834,6 +809,7 @@ void execute_source(const char *source, Env *env)
         Node *stmt = parse_stmt(&P);
         if (stmt)
         {
+            resolve_stmt(stmt);
             Value result = eval_node(env, stmt);
             free_value(result);
             free_node(stmt);
@@ -844,6 +820,9 @@ void execute_source(const char *source, Env *env)
             break;
         }
     }
+
+    /* Let @async calls the program left running finish. */
+    async_run();
 }
 
 /**
@@ -867,6 +846,7 @@ void runRepl(Env *env) {
         if (strncmp(line, ".clear", 6) == 0) {
             env_free(env);
             env = env_new(NULL);
+            gc_add_root_env(env);
             register_all_natives(env);
             buffer[0] = '\0';
             brace_level = 0;
@@ -915,23 +895,84 @@ void runFile(const char *path, Env *env)
     source[len] = '\0';
     fclose(f);
 
-    set_var(env, "__name__", (Value){VAL_STRING, {.string = strdup("main")}}, true, "");
+    set_var(env, "__name__", string_copy("main"), true, "");
 
     execute_source(source, env);
     free(source);
 }
+/**
+ * Runfile on the bytecode VM.
+ * Each top-level statement is compiled and run before the next one is parsed,
+ * as execute_source does; the AST and chunks stay alive for the closures and
+ * OP_EVAL instructions that refer to them.
+ */
+void runFileVM(const char *path, Env *env)
+{
+    char *source = read_file_content(path);
+    if (!source)
+    {
+        perror("Failed to open file");
+        exit(1);
+    }
+
+    set_var(env, "__name__", string_copy("main"), true, "");
+    load_jackal_file("std/io.jackal", env);
+
+    static VM vm;
+    initVM(&vm, env);
+
+    Lexer L;
+    Parser P;
+    lexer_init(&L, source);
+    parser_init(&P, &L);
+
+    while (P.current.kind != TOKEN_END)
+    {
+        Node *stmt = parse_stmt(&P);
+        if (!stmt)
+            break;
+
+        resolve_stmt(stmt);
+        Chunk *chunk = newChunk();
+        if (!compile(stmt, chunk))
+        {
+            fprintf(stderr, "Compile Error: statement at line %d is too large for the VM.\n", stmt->line);
+            exit(65);
+        }
+        if (interpret(&vm, chunk) != INTERPRET_OK)
+            exit(70);
+    }
+
+    async_run();
+    freeVM(&vm);
+}
+
 int global_argc;
 char** global_argv;
 
 
 int main(int argc, char **argv)
 {
+    gc_init();
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "--trace-imports") == 0)
+        {
+            trace_imports = true;
+            memmove(&argv[i], &argv[i + 1], sizeof(char *) * (argc - i));
+            argc--;
+            i--;
+        }
+    }
+
     global_argc = argc;
     global_argv = argv;
 
     net_init();
     Env *env = env_new(NULL);
     global_env = env;
+    gc_add_root_env(env);
     register_all_natives(env);
     load_jackal_file("std/io.jackal", env);
     load_jackal_file("std/stream.jackal", env);
@@ -981,6 +1022,7 @@ int main(int argc, char **argv)
             Node *stmt = parse_stmt(&P);
             if (stmt)
             {
+                resolve_stmt(stmt);
                 if (!root)
                 {
                     root = stmt;
@@ -998,7 +1040,12 @@ int main(int argc, char **argv)
             }
         }
 
-        compile_to_binary(root, dest_file);
+        if (!compile_to_binary(root, dest_file, jlo_hash(source, strlen(source))))
+        {
+            printf("Error: Failed to write %s.\n", dest_file);
+            free(source);
+            return 1;
+        }
         free(source);
         return 0;
     }
@@ -1031,6 +1078,7 @@ int main(int argc, char **argv)
             Node *stmt = parse_stmt(&P);
             if (stmt)
             {
+                resolve_stmt(stmt);
                 if (!root)
                 {
                     root = stmt;
@@ -1044,22 +1092,26 @@ int main(int argc, char **argv)
             }
         }
 
-        const char *temp_file = "dump_temp.jlo";
-        compile_to_binary(root, temp_file);
+        Chunk chunk;
+        initChunk(&chunk);
+        compile(root, &chunk);
+        disassemble_chunk(&chunk, source_path);
+        freeChunk(&chunk);
 
-        FILE *f = fopen(temp_file, "rb");
-        fseek(f, 0, SEEK_END);
-        long fsize = ftell(f);
-        rewind(f);
-        uint8_t *bytecode = malloc(fsize);
-        fread(bytecode, 1, fsize, f);
-        fclose(f);
+        free(source);
+        return 0;
+    }
 
-        disassemble_chunk(source_path, bytecode, fsize);
+    if (strcmp(argv[1], "--vm") == 0)
+    {
+        if (argc < 3)
+        {
+            printf("Usage: ./jackal --vm <file.jackal>\n");
+            return 1;
+        }
 
-        free(source);
-        free(bytecode);
-        remove(temp_file);
+        runFileVM(argv[2], env);
+        net_cleanup();
         return 0;
     }
 
@@ -1067,11 +1119,14 @@ int main(int argc, char **argv)
 
     if (has_extension(filename, ".jlo"))
     {
-        // run_binary(filename);
+        set_var(env, "__name__", string_copy("main"), true, "");
+        load_jackal_file("std/io.jackal", env);
+        run_binary(filename, env);
+        async_run();
     }
     else
     {
-        set_var(env, "__name__", (Value){VAL_STRING, {.string = strdup("main")}}, true, "");
+        set_var(env, "__name__", string_copy("main"), true, "");
         runFile(filename, env);
         // env_free(env);
     }
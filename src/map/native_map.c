@@ -6,13 +6,14 @@
 #include <sys/stat.h>
 #include <float.h>
 #include "env.h"
+#include "string_object.h"
 
 #define MAP_REGISTER(env, name, func)                                           \
     do                                                                           \
     {                                                                            \
         if (func != NULL)                                                        \
         {                                                                        \
-            set_var(env, name, (Value){VAL_NATIVE, {.native = func}}, true, ""); \
+            set_var(env, name, NATIVE_VAL(func), true, ""); \
         }                                                                        \
         else                                                                     \
         {                                                                        \
@@ -21,66 +22,62 @@
     } while (0)
 
  Value native_map_init_manual(int arity, Value *args) {
-    Value map = (Value){VAL_MAP, {.map = map_new()}};
+    Value map = MAP_VAL(map_new());
     return map;
 }
 
 Value native_map_set_manual(int arity, Value* args) {
  
-    if (arity < 3 || args[0].type != VAL_MAP || args[1].type != VAL_STRING) {
-        return (Value){VAL_NIL}; 
+    if (arity < 3 || VALUE_TYPE(args[0]) != VAL_MAP || VALUE_TYPE(args[1]) != VAL_STRING) {
+        return NIL_VAL; 
     }
 
-    HashMap* map = args[0].as.map;
-    const char* key = args[1].as.string;
+    HashMap* map = AS_MAP(args[0]);
+    const char* key = AS_STRING(args[1]);
     Value val = args[2];
 
     map_set(map, key, val);
 
-    return val; 
+    return copy_value(val);
 }
 
 
 Value native_map_keys(int arity, Value* args) {
-    if (arity < 1 || args[0].type != VAL_MAP) {
+    if (arity < 1 || VALUE_TYPE(args[0]) != VAL_MAP) {
         ValueArray* empty_va = array_new();
-        return (Value){VAL_ARRAY, {.array = empty_va}};
+        return ARRAY_VAL(empty_va);
     }
 
-    HashMap* map = args[0].as.map;
+    HashMap* map = AS_MAP(args[0]);
     ValueArray* keys_va = array_new();
 
     if (map == NULL || map->entries == NULL || map->capacity <= 0) {
-        return (Value){VAL_ARRAY, {.array = keys_va}};
+        return ARRAY_VAL(keys_va);
     }
 
     for (int i = 0; i < map->capacity; i++) {
         Entry* entry = &map->entries[i];
         
         if (entry->key != NULL) {
-            Value key_val;
-            key_val.type = VAL_STRING;
-            key_val.as.string = strdup(entry->key);
-            
-            array_append(keys_va, key_val);
+            array_append(keys_va, string_value(STRING_OBJECT(entry->key)));
         }
     }
 
-    return (Value){VAL_ARRAY, {.array = keys_va}};
+    return ARRAY_VAL(keys_va);
 }
 
 Value native_map_remove_manual(int arity, Value* args) {
 
-    if (arity < 2 || args[0].type != VAL_MAP || args[1].type != VAL_STRING) {
-        return (Value){VAL_BOOL, {.boolean = false}}; 
+    if (arity < 2 || VALUE_TYPE(args[0]) != VAL_MAP || VALUE_TYPE(args[1]) != VAL_STRING) {
+        return BOOL_VAL(false); 
     }
 
-    HashMap* map = args[0].as.map;
-    const char* key = args[1].as.string;
+    HashMap* map = AS_MAP(args[0]);
+    const char* key = AS_STRING(args[1]);
 
     bool success = map_delete(map, key);
 
-    return (Value){VAL_BOOL, {.boolean = success}}; 
+    return BOOL_VAL(success); 
 }
 
 void register_map_natives(Env *env){
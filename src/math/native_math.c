@@ -1,4 +1,6 @@
 #include"math/native_math.h"
+#include "methods.h"
+#include "string_object.h"
 #include<stdlib.h>
 #include<string.h>
 #include<errno.h>
@@ -7,7 +9,7 @@
 #define MATH_REGISTER(env, name, func) \
     do { \
         if (func != NULL) { \
-            set_var(env, name, (Value){VAL_NATIVE, {.native = func}}, true, ""); \
+            set_var(env, name, NATIVE_VAL(func), true, ""); \
         } else { \
             printf("Error: Native function '%s' not implemented!\n", name); \
         } \
@@ -15,74 +17,84 @@
 
 
 Value native_math_abs(int arg_count, Value* args) {
-    if (arg_count < 1 || args[0].type != VAL_NUMBER) return (Value){VAL_NUMBER, {.number = 0}};
-    return (Value){VAL_NUMBER, {.number = fabs(args[0].as.number)}};
+    if (arg_count < 1 || VALUE_TYPE(args[0]) != VAL_NUMBER) return NUMBER_VAL(0);
+    return NUMBER_VAL(fabs(AS_NUMBER(args[0])));
 }
 
 Value native_math_sqrt(int arg_count, Value* args) {
-    if (arg_count < 1 || args[0].type != VAL_NUMBER) return (Value){VAL_NUMBER, {.number = 0}};
-    return (Value){VAL_NUMBER, {.number = sqrt(args[0].as.number)}};
+    if (arg_count < 1 || VALUE_TYPE(args[0]) != VAL_NUMBER) return NUMBER_VAL(0);
+    return NUMBER_VAL(sqrt(AS_NUMBER(args[0])));
 }
 
 Value native_math_round(int arg_count, Value* args) {
-    if (arg_count < 1 || args[0].type != VAL_NUMBER) return (Value){VAL_NUMBER, {.number = 0}};
-    return (Value){VAL_NUMBER, {.number = round(args[0].as.number)}};
+    if (arg_count < 1 || VALUE_TYPE(args[0]) != VAL_NUMBER) return NUMBER_VAL(0);
+    return NUMBER_VAL(round(AS_NUMBER(args[0])));
 }
 
 Value native_math_pow(int arg_count, Value* args) {
-    if (arg_count < 2 || args[0].type != VAL_NUMBER || args[1].type != VAL_NUMBER) {
-        return (Value){VAL_NUMBER, {.number = 0}};
+    if (arg_count < 2 || VALUE_TYPE(args[0]) != VAL_NUMBER || VALUE_TYPE(args[1]) != VAL_NUMBER) {
+        return NUMBER_VAL(0);
     }
-    return (Value){VAL_NUMBER, {.number = pow(args[0].as.number, args[1].as.number)}};
+    return NUMBER_VAL(pow(AS_NUMBER(args[0]), AS_NUMBER(args[1])));
 }
 
 Value native_math_floor(int arg_count, Value* args) {
-    if (arg_count < 1 || args[0].type != VAL_NUMBER) return (Value){VAL_NUMBER, {.number = 0}};
-    return (Value){VAL_NUMBER, {.number = floor(args[0].as.number)}};
+    if (arg_count < 1 || VALUE_TYPE(args[0]) != VAL_NUMBER) return NUMBER_VAL(0);
+    return NUMBER_VAL(floor(AS_NUMBER(args[0])));
 }
 
 Value native_math_ceil(int arg_count, Value* args) {
-    if (arg_count < 1 || args[0].type != VAL_NUMBER) return (Value){VAL_NUMBER, {.number = 0}};
-    return (Value){VAL_NUMBER, {.number = ceil(args[0].as.number)}};
+    if (arg_count < 1 || VALUE_TYPE(args[0]) != VAL_NUMBER) return NUMBER_VAL(0);
+    return NUMBER_VAL(ceil(AS_NUMBER(args[0])));
 }
 
 Value native_math_random(int arity, Value *args) {
-    return (Value){VAL_NUMBER, {.number = (double)rand() / (double)RAND_MAX}};
+    return NUMBER_VAL((double)rand() / (double)RAND_MAX);
 }
 
 Value native_math_sin(int arity, Value *args) {
-    if (arity < 1 || args[0].type != VAL_NUMBER) return (Value){VAL_NUMBER, {.number = 0}};
-    return (Value){VAL_NUMBER, {.number = sin(args[0].as.number)}};
+    if (arity < 1 || VALUE_TYPE(args[0]) != VAL_NUMBER) return NUMBER_VAL(0);
+    return NUMBER_VAL(sin(AS_NUMBER(args[0])));
 }
 
 Value native_math_atan2(int arity, Value *args) {
-    if (arity < 2 || args[0].type != VAL_NUMBER || args[1].type != VAL_NUMBER) {
-        return (Value){VAL_NUMBER, {.number = 0}};
+    if (arity < 2 || VALUE_TYPE(args[0]) != VAL_NUMBER || VALUE_TYPE(args[1]) != VAL_NUMBER) {
+        return NUMBER_VAL(0);
     }
-    return (Value){VAL_NUMBER, {.number = atan2(args[0].as.number, args[1].as.number)}};
+    return NUMBER_VAL(atan2(AS_NUMBER(args[0]), AS_NUMBER(args[1])));
 }
 
 Value native_math_min(int arity, Value *args) {
-    if (arity < 2) return arity == 1 ? args[0] : (Value){VAL_NUMBER, {.number = 0}};
-    double min_val = args[0].as.number;
+    if (arity < 2) return arity == 1 ? args[0] : NUMBER_VAL(0);
+    double min_val = AS_NUMBER(args[0]);
     for (int i = 1; i < arity; i++) {
-        if (args[i].as.number < min_val) min_val = args[i].as.number;
+        if (AS_NUMBER(args[i]) < min_val) min_val = AS_NUMBER(args[i]);
     }
-    return (Value){VAL_NUMBER, {.number = min_val}};
+    return NUMBER_VAL(min_val);
 }
 
 Value native_math_max(int arity, Value *args) {
-    if (arity < 2) return arity == 1 ? args[0] : (Value){VAL_NUMBER, {.number = 0}};
-    double max_val = args[0].as.number;
+    if (arity < 2) return arity == 1 ? args[0] : NUMBER_VAL(0);
+    double max_val = AS_NUMBER(args[0]);
     for (int i = 1; i < arity; i++) {
-        if (args[i].as.number > max_val) max_val = args[i].as.number;
+        if (AS_NUMBER(args[i]) > max_val) max_val = AS_NUMBER(args[i]);
     }
-    return (Value){VAL_NUMBER, {.number = max_val}};
+    return NUMBER_VAL(max_val);
 }
 
 Value native_math_isnan(int arity, Value *args) {
-    if (arity < 1 || args[0].type != VAL_NUMBER) return (Value){VAL_NUMBER, {.number = 1}};
-    return (Value){VAL_NUMBER, {.number = isnan(args[0].as.number)}};
+    if (arity < 1 || VALUE_TYPE(args[0]) != VAL_NUMBER) return NUMBER_VAL(1);
+    return NUMBER_VAL(isnan(AS_NUMBER(args[0])));
+}
+
+/* ---- Methods of numbers, called as n.name() ---- */
+
+static Value number_method_to_string(Env *env, Value receiver, int arg_count, Value *args)
+{
+    char buffer[64];
+
+    int length = sprintf(buffer, "%g", AS_NUMBER(receiver));
+    return string_new(buffer, length);
 }
 
 void register_math_natives(Env* env){
@@ -98,4 +110,6 @@ void register_math_natives(Env* env){
     MATH_REGISTER(env,"__math_min",native_math_min);
     MATH_REGISTER(env,"__math_max",native_math_max);
     MATH_REGISTER(env,"__math_isnan",native_math_isnan);
+
+    register_method(VAL_NUMBER, "toString", number_method_to_string);
 }
\ No newline at end of file
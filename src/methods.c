@@ -0,0 +1,99 @@
+#include "methods.h"
+#include "parser.h"
+#include "gc.h"
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define TYPE_COUNT (VAL_CSV_WRITER + 1)
+
+typedef struct {
+    ObjString *name;
+    BuiltinMethod method;
+} MethodEntry;
+
+typedef struct {
+    MethodEntry *entries;
+    int count;
+    int capacity;
+} MethodTable;
+
+static MethodTable tables[TYPE_COUNT];
+static atomic_uint method_cache_epoch = 0;
+
+void register_method(ValueType type, const char *name, BuiltinMethod method)
+{
+    MethodTable *table = &tables[type];
+    ObjString *key = string_intern_pinned(name);
+
+    for (int i = 0; i < table->count; i++)
+    {
+        if (table->entries[i].name == key)
+        {
+            table->entries[i].method = method;
+            method_cache_flush();
+            return;
+        }
+    }
+
+    if (table->count == table->capacity)
+    {
+        table->capacity = table->capacity < 8 ? 8 : table->capacity * 2;
+        table->entries = realloc(table->entries, sizeof(MethodEntry) * table->capacity);
+    }
+    table->entries[table->count++] = (MethodEntry){key, method};
+    method_cache_flush();
+}
+
+BuiltinMethod builtin_method(ValueType type, ObjString *name, MethodCache *cache)
+{
+    unsigned epoch = atomic_load(&method_cache_epoch);
+    if (cache && cache->builtin && cache->type == type && cache->epoch == epoch)
+        return cache->builtin;
+
+    MethodTable *table = &tables[type];
+    BuiltinMethod method = NULL;
+    for (int i = 0; i < table->count; i++)
+    {
+        if (table->entries[i].name == name)
+        {
+            method = table->entries[i].method;
+            break;
+        }
+    }
+
+    /* A cache entry spans several words, so only fill it while no other
+       thread can be reading it. */
+    if (cache && method && !gc_threads_running())
+        *cache = (MethodCache){NULL, NULL, type, method, epoch};
+    return method;
+}
+
+Var *class_method(Class *klass, const char *name, MethodCache *cache)
+{
+    unsigned epoch = atomic_load(&method_cache_epoch);
+    if (cache && cache->klass == klass && cache->epoch == epoch)
+        return cache->method;
+
+    Var *method = NULL;
+    for (Class *c = klass; c && !method; c = c->superclass)
+    {
+        for (Var *v = c->methods->vars; v; v = v->next)
+        {
+            if (strcmp(v->name, name) == 0)
+            {
+                method = v;
+                break;
+            }
+        }
+    }
+
+    if (cache && method && !gc_threads_running())
+        *cache = (MethodCache){klass, method, VAL_NIL, NULL, epoch};
+    return method;
+}
+
+void method_cache_flush(void)
+{
+    atomic_fetch_add(&method_cache_epoch, 1);
+}
@@ -0,0 +1,253 @@
+#include "module.h"
+#include "env.h"
+#include "eval.h"
+#include "compiler/jlo.h"
+#include "value.h"
+#include "gc.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <pthread.h>
+#include <setjmp.h>
+#include <time.h>
+
+extern Env *global_env;
+
+bool trace_imports = false;
+
+/**
+ * @typedef @struct MODULE
+ * A file that has been imported during this process.
+ */
+typedef struct
+{
+    char *path;     // canonical path, the registry key
+    Env *env;       // the module's top-level bindings
+    double load_ms;
+    bool loading;
+    pthread_t loader;   // the thread running it while it loads
+} Module;
+
+/* Imports may run on any thread (in @parallel tasks and __serve__
+   handlers), so the registry is only read or changed under modules_lock.
+   Modules are allocated one by one, so a Module* stays valid as the
+   registry grows. */
+static Module **modules = NULL;
+static int module_count = 0;
+static int module_capacity = 0;
+static pthread_mutex_t modules_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t module_loaded = PTHREAD_COND_INITIALIZER;
+static __thread int import_depth = 0;
+
+static double clock_ms(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000.0 + ts.tv_nsec / 1e6;
+}
+
+/**
+ * Prints one --trace-imports line, indented by the import depth.
+ */
+static void trace(const char *path, double ms, const char *how)
+{
+    fprintf(stderr, "[import] %*s%s  %.3f ms (%s)\n", import_depth * 2, "", path, ms, how);
+}
+
+/**
+ * Resolves symlinks and relative segments so one file has one key.
+ * Falls back to the path as written when it does not exist.
+ */
+static char *canonical_path(const char *path)
+{
+    char *real = realpath(path, NULL);
+    return real ? real : strdup(path);
+}
+
+/** Call with modules_lock held. */
+static Module *find_module(const char *canonical)
+{
+    for (int i = 0; i < module_count; i++)
+    {
+        if (strcmp(modules[i]->path, canonical) == 0)
+            return modules[i];
+    }
+    return NULL;
+}
+
+/**
+ * Keeps every module environment alive; they are never unloaded. Runs
+ * while every other thread is idle or parked outside the registry, so it
+ * does not take modules_lock.
+ */
+static void mark_modules(void *ctx)
+{
+    (void)ctx;
+    for (int i = 0; i < module_count; i++)
+        gc_mark_env(modules[i]->env);
+}
+
+/** Call with modules_lock held. */
+static Module *add_module(char *canonical)
+{
+    if (module_count == 0)
+        gc_add_root_marker(mark_modules, NULL);
+
+    if (module_count == module_capacity)
+    {
+        module_capacity = module_capacity < 8 ? 8 : module_capacity * 2;
+        modules = realloc(modules, sizeof(Module *) * module_capacity);
+    }
+    Module *module = malloc(sizeof(Module));
+    *module = (Module){canonical, NULL, 0, true, pthread_self()};
+    modules[module_count++] = module;
+    return module;
+}
+
+/** Marks a module loaded and wakes the threads waiting for it. */
+static void finish_module(Module *module, double load_ms)
+{
+    pthread_mutex_lock(&modules_lock);
+    module->loading = false;
+    module->load_ms = load_ms;
+    pthread_cond_broadcast(&module_loaded);
+    pthread_mutex_unlock(&modules_lock);
+}
+
+/**
+ * Binds a module's top-level variables in the importing environment. The
+ * importer shares them rather than copying them, so it sees assignments
+ * the module's own functions make later.
+ */
+static void export_module(Env *module_env, Env *into)
+{
+    into->is_dynamic = true;
+    if (module_env == into)
+        return;
+
+    for (int i = 0; i < module_env->count; i++)
+        link_var(into, module_env->slots[i]);
+}
+
+/**
+ * Loads a file once and exports it into env. A thread importing a module
+ * that another thread is loading waits for it; one importing a module it
+ * is itself loading (an import cycle) gets what is defined so far.
+ * @param nested Whether the file gets its own environment below the
+ * global one or runs directly in env.
+ */
+static bool load_module(Env *env, const char *path, bool nested)
+{
+    char *canonical = canonical_path(path);
+    JloModule jlo;
+    bool parsed = false;
+    bool cache_hit = false;
+    double start = 0;
+
+    pthread_mutex_lock(&modules_lock);
+    Module *module = find_module(canonical);
+    while (module == NULL && !parsed)
+    {
+        /* Read outside the lock; another thread may register it meanwhile. */
+        pthread_mutex_unlock(&modules_lock);
+        start = clock_ms();
+        if (!jlo_load_cached(path, &jlo, &cache_hit))
+        {
+            free(canonical);
+            return false;
+        }
+        parsed = true;
+        pthread_mutex_lock(&modules_lock);
+        module = find_module(canonical);
+    }
+
+    if (module)
+    {
+        bool cycle = module->loading && pthread_equal(module->loader, pthread_self());
+        while (module->loading && !cycle)
+            pthread_cond_wait(&module_loaded, &modules_lock);
+        pthread_mutex_unlock(&modules_lock);
+
+        if (parsed)
+        {
+            for (int i = 0; i < jlo.count; i++)
+                free_node(jlo.stmts[i]);
+            jlo_free(&jlo);
+        }
+        free(canonical);
+        if (trace_imports)
+            trace(path, 0, cycle ? "cycle" : "reused");
+        export_module(module->env, env);
+        return true;
+    }
+    module = add_module(canonical);
+    pthread_mutex_unlock(&modules_lock);
+
+    /* A nested module sits below the global environment, not the importer's,
+       which may be a call frame: it must not keep that frame alive. A run
+       module's functions close over env, which then lives for the rest of
+       the process together with its chain. */
+    Env *module_env = env;
+    if (nested)
+    {
+        module_env = env_new(global_env);
+        module_env->is_dynamic = true;
+        module_env->is_captured = true;
+    }
+    else
+    {
+        for (Env *e = env; e && !e->is_captured; e = e->outer)
+            e->is_captured = true;
+    }
+    module->env = module_env;
+
+    /* A throw out of the module's top level still marks it loaded, so
+       other threads waiting for it go on, and then carries on outwards. */
+    jmp_buf old_buf;
+    memcpy(old_buf, global_ex_state.buf, sizeof(jmp_buf));
+    int was_active = global_ex_state.active;
+    int depth = import_depth;
+
+    global_ex_state.active = 1;
+    if (setjmp(global_ex_state.buf) != 0)
+    {
+        memcpy(global_ex_state.buf, old_buf, sizeof(jmp_buf));
+        global_ex_state.active = was_active;
+        import_depth = depth;
+        jlo_free(&jlo);
+        finish_module(module, clock_ms() - start);
+        throw_value(global_ex_state.error_val);
+    }
+
+    import_depth++;
+    for (int i = 0; i < jlo.count; i++)
+    {
+        Value res = eval_node(module_env, jlo.stmts[i]);
+        free_value(res);
+        free_node(jlo.stmts[i]);
+    }
+    import_depth--;
+
+    memcpy(global_ex_state.buf, old_buf, sizeof(jmp_buf));
+    global_ex_state.active = was_active;
+    jlo_free(&jlo);
+
+    double load_ms = clock_ms() - start;
+    finish_module(module, load_ms);
+    if (trace_imports)
+        trace(path, load_ms, cache_hit ? "cached" : "compiled");
+
+    export_module(module_env, env);
+    return true;
+}
+
+bool module_import(Env *env, const char *path)
+{
+    return load_module(env, path, true);
+}
+
+bool module_run(Env *env, const char *path)
+{
+    return load_module(env, path, false);
+}
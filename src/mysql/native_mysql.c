@@ -5,6 +5,7 @@
 #include <stdio.h>
 #include <string.h>
 #include "env.h"
+#include "string_object.h"
 
 #if __has_include(<mysql/mysql.h>)
     #include <mysql/mysql.h>
@@ -16,47 +17,47 @@
 #define MSQL_REGISTER(env, name, func)                                           \
     do                                                                           \
     {                                                                            \
-        set_var(env, name, (Value){VAL_NATIVE, {.native = func}}, true, "");     \
+        set_var(env, name, NATIVE_VAL(func), true, "");     \
     } while (0)
 
 
 Value native_mysql_connect(int arity, Value* args) {
 #if HAS_MYSQL
-    if (arity < 4) return (Value){VAL_NIL};
+    if (arity < 4) return NIL_VAL;
 
     MYSQL *conn = mysql_init(NULL);
-    if (!mysql_real_connect(conn, args[0].as.string, args[1].as.string, 
-                            args[2].as.string, args[3].as.string, 0, NULL, 0)) {
-        return (Value){VAL_NIL};
+    if (!mysql_real_connect(conn, AS_STRING(args[0]), AS_STRING(args[1]), 
+                            AS_STRING(args[2]), AS_STRING(args[3]), 0, NULL, 0)) {
+        return NIL_VAL;
     }
-    return (Value){VAL_NUMBER, {.number = (uintptr_t)conn}};
+    return NUMBER_VAL((uintptr_t)conn);
 #else
     fprintf(stderr, "Error: MySQL support not compiled into Jackal.\n");
-    return (Value){VAL_NIL};
+    return NIL_VAL;
 #endif
 }
 
 Value native_mysql_query(int arity, Value* args) {
 #if HAS_MYSQL
-    if (arity < 2 || args[0].type != VAL_NUMBER) {
-        return (Value){VAL_NIL};
+    if (arity < 2 || VALUE_TYPE(args[0]) != VAL_NUMBER) {
+        return NIL_VAL;
     }
 
-    MYSQL *conn = (MYSQL*)(uintptr_t)args[0].as.number;
-    const char* sql = args[1].as.string;
+    MYSQL *conn = (MYSQL*)(uintptr_t)AS_NUMBER(args[0]);
+    const char* sql = AS_STRING(args[1]);
 
     if (mysql_query(conn, sql)) {
         fprintf(stderr, "MySQL Query Error: %s\n", mysql_error(conn));
-        return (Value){VAL_NIL};
+        return NIL_VAL;
     }
 
     MYSQL_RES *result = mysql_store_result(conn);
     
     if (result == NULL) {
         if (mysql_field_count(conn) == 0) {
-            return (Value){VAL_BOOL, {.boolean = 1}};
+            return BOOL_VAL(1);
         } else {
-            return (Value){VAL_NIL};
+            return NIL_VAL;
         }
     }
 
@@ -71,31 +72,31 @@ Value native_mysql_query(int arity, Value* args) {
         for (int i = 0; i < num_fields; i++) {
             Value val;
             if (row[i]) {
-                val = (Value){VAL_STRING, {.string = strdup(row[i])}};
+                val = string_copy(row[i]);
             } else {
-                val = (Value){VAL_NIL};
+                val = NIL_VAL;
             }
             map_set(map, fields[i].name, val);
         }
-        array_append(va, (Value){VAL_MAP, {.map = map}});
+        array_append(va, MAP_VAL(map));
     }
 
     mysql_free_result(result);
-    return (Value){VAL_ARRAY, {.array = va}};
+    return ARRAY_VAL(va);
 #else
-    return (Value){VAL_NIL};
+    return NIL_VAL;
 #endif
 }
 
 Value native_mysql_create_table(int arity, Value* args) {
 #if HAS_MYSQL
-    if (arity < 3 || args[0].type != VAL_NUMBER || args[2].type != VAL_MAP) {
-        return (Value){VAL_NIL};
+    if (arity < 3 || VALUE_TYPE(args[0]) != VAL_NUMBER || VALUE_TYPE(args[2]) != VAL_MAP) {
+        return NIL_VAL;
     }
 
-    MYSQL *conn = (MYSQL*)(uintptr_t)args[0].as.number;
-    const char* table_name = args[1].as.string;
-    HashMap* columns = args[2].as.map;
+    MYSQL *conn = (MYSQL*)(uintptr_t)AS_NUMBER(args[0]);
+    const char* table_name = AS_STRING(args[1]);
+    HashMap* columns = AS_MAP(args[2]);
 
     char sql[2048];
     sprintf(sql, "CREATE TABLE IF NOT EXISTS %s (", table_name);
@@ -105,7 +106,7 @@ Value native_mysql_create_table(int arity, Value* args) {
             strcat(sql, columns->entries[i].key);
             strcat(sql, " ");
 
-            const char* user_type = columns->entries[i].value.as.string;
+            const char* user_type = AS_STRING(columns->entries[i].value);
             
             if (strcmp(user_type, "int") == 0) strcat(sql, "INT");
             else if (strcmp(user_type, "string") == 0) strcat(sql, "VARCHAR(255)");
@@ -123,23 +124,23 @@ Value native_mysql_create_table(int arity, Value* args) {
 
     if (mysql_query(conn, sql)) {
         fprintf(stderr, "MySQL Create Error: %s\n", mysql_error(conn));
-        return (Value){VAL_BOOL, {.boolean = 0}};
+        return BOOL_VAL(0);
     }
-    return (Value){VAL_BOOL, {.boolean = 1}};
+    return BOOL_VAL(1);
 #else
-    return (Value){VAL_BOOL, {.boolean = 0}};
+    return BOOL_VAL(0);
 #endif
 }
 
 Value native_mysql_insert(int arity, Value* args) {
 #if HAS_MYSQL
-    if (arity < 3 || args[0].type != VAL_NUMBER || args[2].type != VAL_MAP) {
-        return (Value){VAL_NIL};
+    if (arity < 3 || VALUE_TYPE(args[0]) != VAL_NUMBER || VALUE_TYPE(args[2]) != VAL_MAP) {
+        return NIL_VAL;
     }
 
-    MYSQL *conn = (MYSQL*)(uintptr_t)args[0].as.number;
-    const char* table_name = args[1].as.string;
-    HashMap* data = args[2].as.map;
+    MYSQL *conn = (MYSQL*)(uintptr_t)AS_NUMBER(args[0]);
+    const char* table_name = AS_STRING(args[1]);
+    HashMap* data = AS_MAP(args[2]);
 
     char sql[4096];
     char columns[2048] = "";
@@ -153,16 +154,16 @@ Value native_mysql_insert(int arity, Value* args) {
             strcat(columns, ", ");
 
             Value val = data->entries[i].value;
-            if (val.type == VAL_STRING) {
+            if (VALUE_TYPE(val) == VAL_STRING) {
                 strcat(values, "'");
-                strcat(values, val.as.string);
+                strcat(values, AS_STRING(val));
                 strcat(values, "'");
-            } else if (val.type == VAL_NUMBER) {
+            } else if (VALUE_TYPE(val) == VAL_NUMBER) {
                 char num_str[32];
-                sprintf(num_str, "%g", val.as.number);
+                sprintf(num_str, "%g", AS_NUMBER(val));
                 strcat(values, num_str);
-            } else if (val.type == VAL_BOOL) {
-                strcat(values, val.as.boolean ? "1" : "0");
+            } else if (VALUE_TYPE(val) == VAL_BOOL) {
+                strcat(values, AS_BOOL(val) ? "1" : "0");
             } else {
                 strcat(values, "NULL");
             }
@@ -180,33 +181,33 @@ Value native_mysql_insert(int arity, Value* args) {
 
     if (mysql_query(conn, sql)) {
         fprintf(stderr, "MySQL Insert Error: %s\n", mysql_error(conn));
-        return (Value){VAL_BOOL, {.boolean = 0}};
+        return BOOL_VAL(0);
     }
-    return (Value){VAL_BOOL, {.boolean = 1}};
+    return BOOL_VAL(1);
 #else
-    return (Value){VAL_BOOL, {.boolean = 0}};
+    return BOOL_VAL(0);
 #endif
 }
 
 Value native_mysql_find_all(int arity, Value* args) {
 #if HAS_MYSQL
-    if (arity < 2 || args[0].type != VAL_NUMBER || args[1].type != VAL_STRING) {
-        return (Value){VAL_NIL};
+    if (arity < 2 || VALUE_TYPE(args[0]) != VAL_NUMBER || VALUE_TYPE(args[1]) != VAL_STRING) {
+        return NIL_VAL;
     }
 
-    MYSQL *conn = (MYSQL*)(uintptr_t)args[0].as.number;
-    const char* table_name = args[1].as.string;
+    MYSQL *conn = (MYSQL*)(uintptr_t)AS_NUMBER(args[0]);
+    const char* table_name = AS_STRING(args[1]);
 
     char sql[256];
     snprintf(sql, sizeof(sql), "SELECT * FROM %s", table_name);
 
     if (mysql_query(conn, sql)) {
         fprintf(stderr, "MySQL FindAll Error: %s\n", mysql_error(conn));
-        return (Value){VAL_NIL};
+        return NIL_VAL;
     }
 
     MYSQL_RES *result = mysql_store_result(conn);
-    if (result == NULL) return (Value){VAL_NIL};
+    if (result == NULL) return NIL_VAL;
 
     int num_fields = mysql_num_fields(result);
     MYSQL_FIELD *fields = mysql_fetch_fields(result);
@@ -219,51 +220,51 @@ Value native_mysql_find_all(int arity, Value* args) {
         for (int i = 0; i < num_fields; i++) {
             Value val;
             if (row[i]) {
-                val = (Value){VAL_STRING, {.string = strdup(row[i])}};
+                val = string_copy(row[i]);
             } else {
-                val = (Value){VAL_NIL};
+                val = NIL_VAL;
             }
             map_set(map, fields[i].name, val);
         }
-        array_append(va, (Value){VAL_MAP, {.map = map}});
+        array_append(va, MAP_VAL(map));
     }
 
     mysql_free_result(result);
-    return (Value){VAL_ARRAY, {.array = va}};
+    return ARRAY_VAL(va);
 #else
-    return (Value){VAL_NIL};
+    return NIL_VAL;
 #endif
 }
 
 Value native_mysql_select_builder(int arity, Value* args) {
 #if HAS_MYSQL
-    if (arity == 0 || args[0].type == VAL_NIL) return (Value){VAL_STRING, {.string = strdup("*")}};
+    if (arity == 0 || VALUE_TYPE(args[0]) == VAL_NIL) return string_copy("*");
 
     char buffer[2048] = "";
     Value input = args[0];
 
-    if (input.type == VAL_MAP) {
-        HashMap* map = input.as.map;
+    if (VALUE_TYPE(input) == VAL_MAP) {
+        HashMap* map = AS_MAP(input);
         for (int j = 0; j < map->capacity; j++) {
             if (map->entries[j].key != NULL) {
                 strcat(buffer, map->entries[j].key);
                 strcat(buffer, " AS ");
-                if (map->entries[j].value.type == VAL_STRING) {
-                    strcat(buffer, map->entries[j].value.as.string);
+                if (VALUE_TYPE(map->entries[j].value) == VAL_STRING) {
+                    strcat(buffer, AS_STRING(map->entries[j].value));
                 }
                 strcat(buffer, ", ");
             }
         }
-    } else if (input.type == VAL_ARRAY) {
-        ValueArray* arr = input.as.array;
+    } else if (VALUE_TYPE(input) == VAL_ARRAY) {
+        ValueArray* arr = AS_ARRAY(input);
         for (int i = 0; i < arr->count; i++) {
-            if (arr->values[i].type == VAL_STRING) {
-                strcat(buffer, arr->values[i].as.string);
+            if (VALUE_TYPE(arr->values[i]) == VAL_STRING) {
+                strcat(buffer, AS_STRING(arr->values[i]));
                 strcat(buffer, ", ");
             }
         }
-    } else if (input.type == VAL_STRING) {
-        strcat(buffer, input.as.string);
+    } else if (VALUE_TYPE(input) == VAL_STRING) {
+        strcat(buffer, AS_STRING(input));
     }
 
     int len = strlen(buffer);
@@ -271,23 +272,23 @@ Value native_mysql_select_builder(int arity, Value* args) {
         buffer[len - 2] = '\0';
     }
 
-    if (strlen(buffer) == 0) return (Value){VAL_STRING, {.string = strdup("*")}};
-    return (Value){VAL_STRING, {.string = strdup(buffer)}};
+    if (strlen(buffer) == 0) return string_copy("*");
+    return string_copy(buffer);
 #else
-    return (Value){VAL_STRING, {.string = strdup("*")}};
+    return string_copy("*");
 #endif
 }
 
 Value native_mysql_update(int arity, Value* args) {
 #if HAS_MYSQL
-    if (arity < 4 || args[0].type != VAL_NUMBER || args[2].type != VAL_MAP) {
-        return (Value){VAL_BOOL, {.boolean = 0}};
+    if (arity < 4 || VALUE_TYPE(args[0]) != VAL_NUMBER || VALUE_TYPE(args[2]) != VAL_MAP) {
+        return BOOL_VAL(0);
     }
 
-    MYSQL *conn = (MYSQL*)(uintptr_t)args[0].as.number;
-    const char* table_name = args[1].as.string;
-    HashMap* data = args[2].as.map;
-    const char* where_clause = args[3].as.string;
+    MYSQL *conn = (MYSQL*)(uintptr_t)AS_NUMBER(args[0]);
+    const char* table_name = AS_STRING(args[1]);
+    HashMap* data = AS_MAP(args[2]);
+    const char* where_clause = AS_STRING(args[3]);
 
     char sql[4096] = "";
     char set_part[2048] = "";
@@ -298,16 +299,16 @@ Value native_mysql_update(int arity, Value* args) {
             strcat(set_part, " = ");
 
             Value val = data->entries[i].value;
-            if (val.type == VAL_STRING) {
+            if (VALUE_TYPE(val) == VAL_STRING) {
                 strcat(set_part, "'");
-                strcat(set_part, val.as.string);
+                strcat(set_part, AS_STRING(val));
                 strcat(set_part, "'");
-            } else if (val.type == VAL_NUMBER) {
+            } else if (VALUE_TYPE(val) == VAL_NUMBER) {
                 char num_str[32];
-                sprintf(num_str, "%g", val.as.number);
+                sprintf(num_str, "%g", AS_NUMBER(val));
                 strcat(set_part, num_str);
-            } else if (val.type == VAL_BOOL) {
-                strcat(set_part, val.as.boolean ? "1" : "0");
+            } else if (VALUE_TYPE(val) == VAL_BOOL) {
+                strcat(set_part, AS_BOOL(val) ? "1" : "0");
             } else {
                 strcat(set_part, "NULL");
             }
@@ -324,37 +325,37 @@ Value native_mysql_update(int arity, Value* args) {
 
     if (mysql_query(conn, sql)) {
         fprintf(stderr, "MySQL Update Error: %s\n", mysql_error(conn));
-        return (Value){VAL_BOOL, {.boolean = 0}};
+        return BOOL_VAL(0);
     }
 
-    return (Value){VAL_BOOL, {.boolean = 1}};
+    return BOOL_VAL(1);
 #else
-    return (Value){VAL_BOOL, {.boolean = 0}};
+    return BOOL_VAL(0);
 #endif
 }
 
 Value native_mysql_delete(int arity, Value* args) {
 #if HAS_MYSQL
-    if (arity < 2 || args[0].type != VAL_NUMBER) {
-        return (Value){VAL_BOOL, {.boolean = 0}};
+    if (arity < 2 || VALUE_TYPE(args[0]) != VAL_NUMBER) {
+        return BOOL_VAL(0);
     }
 
     
-    MYSQL *conn = (MYSQL*)(uintptr_t)args[0].as.number;
-    const char* table_name = args[1].as.string;
-    const char* where_clause = (arity > 2) ? args[2].as.string : "";
+    MYSQL *conn = (MYSQL*)(uintptr_t)AS_NUMBER(args[0]);
+    const char* table_name = AS_STRING(args[1]);
+    const char* where_clause = (arity > 2) ? AS_STRING(args[2]) : "";
 
     char sql[2048] = "";
     snprintf(sql, sizeof(sql), "DELETE FROM %s%s", table_name, where_clause);
 
     if (mysql_query(conn, sql)) {
         fprintf(stderr, "MySQL Delete Error: %s\n", mysql_error(conn));
-        return (Value){VAL_BOOL, {.boolean = 0}};
+        return BOOL_VAL(0);
     }
 
-    return (Value){VAL_BOOL, {.boolean = 1}};
+    return BOOL_VAL(1);
 #else
-    return (Value){VAL_BOOL, {.boolean = 0}};
+    return BOOL_VAL(0);
 #endif
 }
 
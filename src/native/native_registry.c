@@ -13,6 +13,9 @@
 #include "mysql/native_mysql.h"
 #include "array/native_array.h"
 #include "Env/native_env.h"
+#include "gc.h"
+#include "task.h"
+#include "async.h"
 
 
 /**
@@ -20,6 +23,9 @@
  */
 #include"Jweb/native_jweb.h"
 #include "Jweb/native_session.h"
+#include "Jweb/server.h"
+#include "Jweb/router.h"
+#include "Jweb/response_writer.h"
 
 
 /**
@@ -29,7 +35,7 @@
 #define SAFE_REGISTER(env, name, func) \
     do { \
         if (func != NULL) { \
-            set_var(env, name, (Value){VAL_NATIVE, {.native = func}}, true, ""); \
+            set_var(env, name, NATIVE_VAL(func), true, ""); \
         } else { \
             print_error("Native function '%s' is not implemented!", name); \
         } \
@@ -40,8 +46,8 @@
 void register_all_natives(Env* env) {
     if (env == NULL) return;
 
-    REGISTER_CONST(env, "nil", ((Value){VAL_NIL, {0}}));
-    REGISTER_CONST(env, "__math_PI", ((Value){VAL_NUMBER, {.number = 3.1415926535}}));
+    REGISTER_CONST(env, "nil", (NIL_VAL));
+    REGISTER_CONST(env, "__math_PI", (NUMBER_VAL(3.1415926535)));
 
     SAFE_REGISTER(env, "typeof", builtin_typeof);
     SAFE_REGISTER(env, "__typeof", builtin_type);
@@ -153,10 +159,16 @@ void register_all_natives(Env* env) {
     register_mysql_natives(env);
     register_array_natives(env);
     register_env_natives(env);
+    register_gc_natives(env);
+    register_task_natives(env);
+    register_async_natives(env);
 
     /**
      * Jweb library
      */
     register_jweb_natives(env);
+    register_jweb_server_natives(env);
+    register_jweb_router_natives(env);
+    register_jweb_writer_natives(env);
     register_session_native(env);
 }
\ No newline at end of file
@@ -1805,6 +1805,7 @@ Node *parse_stmt(Parser *P)
 
         n->is_main = meta_node.is_main;
         n->is_paralel = meta_node.is_paralel;
+        n->is_async = meta_node.is_async;
         n->is_memoize = meta_node.is_memoize;
         n->is_override = meta_node.is_override;
         n->is_deprecated = meta_node.is_deprecated;
@@ -2749,6 +2750,30 @@ static Node *parse_logical_or(Parser *P)
     return left;
 }
 
+static inline bool is_ident(Parser *P, const char *s)
+{
+    return P->current.kind == TOKEN_IDENT &&
+           P->current.text &&
+           strcmp(P->current.text, s) == 0;
+}
+
+/**
+ * @brief Whether the current token starts an await expression.
+ * `await` is not reserved: it is a keyword only when a name follows it, as
+ * in `await fetch(url)` or `await task`, so scripts may still use it as an
+ * identifier (`let await = 1`, `await(x)`, `obj.await`).
+ * @param P Pointer to the Parser.
+ */
+static bool is_await(Parser *P)
+{
+    if (!is_ident(P, "await"))
+        return false;
+    Lexer saved = *P->lexer;
+    TokenKind following = lexer_next(P->lexer).kind;
+    *P->lexer = saved;
+    return following == TOKEN_IDENT || following == TOKEN_THIS;
+}
+
 /**
  * @brief Parses a unary operator.
  * @param P Pointer to the Parser.
@@ -2767,14 +2792,16 @@ static Node *parse_unary(Parser *P)
         return n;
     }
 
-    return parse_postfix(P);
-}
+    if (is_await(P))
+    {
+        Node *n = new_node(NODE_AWAIT);
+        next(P);
 
-static inline bool is_ident(Parser *P, const char *s)
-{
-    return P->current.kind == TOKEN_IDENT &&
-           P->current.text &&
-           strcmp(P->current.text, s) == 0;
+        n->left = parse_unary(P);
+        return n;
+    }
+
+    return parse_postfix(P);
 }
 
 static void parse_annotations(Parser *P, Node *n)
@@ -2785,6 +2812,7 @@ static void parse_annotations(Parser *P, Node *n)
     n->is_main = false;
     n->is_memoize = false;
     n->is_paralel = false;
+    n->is_async = false;
     n->is_static = false;
     n->is_platform_specific = false;
     n->is_main = false;
@@ -2998,8 +3026,12 @@ void free_node(Node *n)
 {
     if (!n)
         return;
-    free_node(n->left);
-    free_node(n->right);
+    /* Closures created from a function expression keep using its parameters and body. */
+    if (n->kind != NODE_FUNC_EXPR)
+    {
+        free_node(n->left);
+        free_node(n->right);
+    }
     free_node(n->next);
     free(n);
 }
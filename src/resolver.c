@@ -0,0 +1,553 @@
+#include "resolver.h"
+#include <stdlib.h>
+#include <string.h>
+
+/**
+ * @typedef @struct SCOPE
+ * Compile-time mirror of one runtime Env.
+ * slots holds the names declared so far in the order the evaluator will
+ * create them; declared holds every name the scope declares anywhere.
+ */
+typedef struct Scope
+{
+    struct Scope *outer;
+    const char **slots;
+    int count;
+    int capacity;
+    const char **declared;
+    int declared_count;
+    int declared_capacity;
+    bool is_root;
+    bool is_opaque;
+} Scope;
+
+static void resolve_node(Scope *s, Node *n);
+
+static void scope_init(Scope *s, Scope *outer)
+{
+    memset(s, 0, sizeof(Scope));
+    s->outer = outer;
+}
+
+static void scope_release(Scope *s)
+{
+    free(s->slots);
+    free(s->declared);
+}
+
+static int name_index(const char **names, int count, const char *name)
+{
+    for (int i = 0; i < count; i++)
+    {
+        if (strcmp(names[i], name) == 0)
+            return i;
+    }
+    return -1;
+}
+
+static int name_append(const char ***names, int *count, int *capacity, const char *name)
+{
+    if (*count == *capacity)
+    {
+        int new_capacity = *capacity < 8 ? 8 : *capacity * 2;
+        const char **grown = realloc(*names, sizeof(char *) * new_capacity);
+        if (!grown)
+            return -1;
+        *names = grown;
+        *capacity = new_capacity;
+    }
+    (*names)[*count] = name;
+    return (*count)++;
+}
+
+/**
+ * Records that a scope declares a name somewhere, without giving it a slot yet.
+ */
+static void scope_note(Scope *s, const char *name)
+{
+    if (name_index(s->declared, s->declared_count, name) < 0)
+        name_append(&s->declared, &s->declared_count, &s->declared_capacity, name);
+}
+
+/**
+ * Declares a name in a scope and returns its slot.
+ * Redeclarations reuse the slot, matching define_var at runtime.
+ * @return The slot, or -1 for root and opaque scopes whose layout is unknown.
+ */
+static int scope_declare(Scope *s, const char *name)
+{
+    if (s->is_root || s->is_opaque)
+        return -1;
+
+    scope_note(s, name);
+    int slot = name_index(s->slots, s->count, name);
+    if (slot >= 0)
+        return slot;
+    return name_append(&s->slots, &s->count, &s->capacity, name);
+}
+
+/**
+ * Notes the names a statement declares into the current scope.
+ * Only looks through statements that do not open a scope of their own.
+ */
+static void collect_stmt(Scope *s, Node *n)
+{
+    if (!n)
+        return;
+
+    switch (n->kind)
+    {
+    case NODE_VARDECL:
+    case NODE_CONSTDECL:
+        if (n->left && n->left->kind == NODE_DESTRUCTURE)
+        {
+            for (Node *v = n->left->left; v; v = v->next)
+                scope_note(s, v->name);
+        }
+        else
+        {
+            scope_note(s, n->name);
+        }
+        break;
+
+    case NODE_FUNC_DEF:
+    case NODE_CLASS_DEF:
+    case NODE_STRUCT_DEF:
+    case NODE_ENUM_DEF:
+    case NODE_INTERFACE_DEF:
+    case NODE_NAMESPACES:
+        scope_note(s, n->name);
+        break;
+
+    case NODE_IF_STMT:
+        if (n->right)
+        {
+            collect_stmt(s, n->right->left);
+            collect_stmt(s, n->right->right);
+        }
+        break;
+
+    case NODE_MATCH_STMT:
+        for (Node *c = n->right; c; c = c->next)
+            collect_stmt(s, c->right);
+        break;
+
+    default:
+        break;
+    }
+}
+
+static void collect_list(Scope *s, Node *head)
+{
+    for (Node *n = head; n; n = n->next)
+        collect_stmt(s, n);
+}
+
+/**
+ * Binds a name reference to the nearest scope that declares it.
+ * Stops without binding when it meets an opaque scope or a name the scope
+ * only declares later, since the runtime answer then depends on execution order.
+ */
+static void resolve_ref(Scope *s, Node *n)
+{
+    n->resolve_kind = RESOLVE_NONE;
+
+    int depth = 0;
+    for (Scope *scope = s; scope; scope = scope->outer, depth++)
+    {
+        if (scope->is_opaque)
+            return;
+
+        if (scope->is_root)
+        {
+            n->resolve_kind = RESOLVE_ROOT;
+            n->scope_depth = depth;
+            n->scope_slot = -1;
+            return;
+        }
+
+        int slot = name_index(scope->slots, scope->count, n->name);
+        if (slot >= 0)
+        {
+            n->resolve_kind = RESOLVE_LOCAL;
+            n->scope_depth = depth;
+            n->scope_slot = slot;
+            return;
+        }
+
+        if (name_index(scope->declared, scope->declared_count, n->name) >= 0)
+            return;
+    }
+}
+
+static void resolve_decl(Scope *s, Node *n)
+{
+    int slot = scope_declare(s, n->name);
+    n->resolve_kind = slot >= 0 ? RESOLVE_LOCAL : RESOLVE_NONE;
+    n->scope_depth = 0;
+    n->scope_slot = slot;
+}
+
+static void resolve_list(Scope *s, Node *head)
+{
+    for (Node *n = head; n; n = n->next)
+        resolve_node(s, n);
+}
+
+static void resolve_block(Scope *outer, Node *block)
+{
+    Scope scope;
+    scope_init(&scope, outer);
+    collect_list(&scope, block->left);
+    resolve_list(&scope, block->left);
+    scope_release(&scope);
+}
+
+/**
+ * Resolves a function body against its call environment.
+ * Parameters take the first slots; methods bind 'this' right after them.
+ */
+static void resolve_function(Scope *outer, Node *params, Node *body, bool is_method)
+{
+    Scope scope;
+    scope_init(&scope, outer);
+
+    for (Node *p = params; p; p = p->next)
+        scope_declare(&scope, p->name);
+    if (is_method)
+        scope_declare(&scope, "this");
+
+    collect_stmt(&scope, body);
+    resolve_node(&scope, body);
+    scope_release(&scope);
+}
+
+static void resolve_class(Scope *s, Node *n)
+{
+    Scope scope;
+    scope_init(&scope, s);
+
+    for (Node *m = n->left; m; m = m->next)
+    {
+        if (m->kind == NODE_FUNC_DEF || m->kind == NODE_VARDECL)
+            scope_declare(&scope, m->name);
+    }
+
+    for (Node *m = n->left; m; m = m->next)
+    {
+        if (m->kind == NODE_FUNC_DEF)
+        {
+            resolve_function(&scope, m->left, m->right, true);
+        }
+        else
+        {
+            resolve_node(&scope, m);
+        }
+    }
+
+    scope_release(&scope);
+    scope_declare(s, n->name);
+}
+
+static void resolve_node(Scope *s, Node *n)
+{
+    if (!n)
+        return;
+
+    switch (n->kind)
+    {
+    case NODE_IDENT:
+    case NODE_THIS:
+        resolve_ref(s, n);
+        break;
+
+    case NODE_ASSIGN:
+        resolve_node(s, n->right);
+        resolve_ref(s, n);
+        break;
+
+    case NODE_VARDECL:
+    case NODE_CONSTDECL:
+        resolve_node(s, n->right);
+        if (n->left && n->left->kind == NODE_DESTRUCTURE)
+        {
+            for (Node *v = n->left->left; v; v = v->next)
+                scope_declare(s, v->name);
+        }
+        else
+        {
+            resolve_decl(s, n);
+        }
+        break;
+
+    case NODE_FUNC_DEF:
+        scope_declare(s, n->name);
+        resolve_function(s, n->left, n->right, false);
+        break;
+
+    case NODE_FUNC_EXPR:
+        resolve_function(s, n->left, n->right, false);
+        break;
+
+    case NODE_EXTENSION:
+        for (Node *m = n->left; m; m = m->next)
+            resolve_function(s, m->left, m->right, true);
+        break;
+
+    case NODE_CLASS_DEF:
+        resolve_class(s, n);
+        break;
+
+    case NODE_STRUCT_DEF:
+    case NODE_ENUM_DEF:
+    case NODE_INTERFACE_DEF:
+        scope_declare(s, n->name);
+        break;
+
+    case NODE_NAMESPACES:
+    {
+        Scope scope;
+        scope_init(&scope, s);
+        collect_list(&scope, n->left);
+        resolve_list(&scope, n->left);
+        scope_release(&scope);
+        scope_declare(s, n->name);
+        break;
+    }
+
+    case NODE_BLOCK:
+        resolve_block(s, n);
+        break;
+
+    case NODE_IF_STMT:
+        resolve_node(s, n->left);
+        if (n->right)
+        {
+            resolve_node(s, n->right->left);
+            resolve_node(s, n->right->right);
+        }
+        break;
+
+    case NODE_WHILE_STMT:
+        resolve_node(s, n->left);
+        resolve_node(s, n->right);
+        break;
+
+    case NODE_FOR_STMT:
+    {
+        Scope scope;
+        scope_init(&scope, s);
+        Node *body = (n->right && n->right->right) ? n->right->right->right : NULL;
+        collect_stmt(&scope, n->left);
+        collect_stmt(&scope, body);
+        resolve_node(&scope, n->left);
+        if (n->right)
+        {
+            resolve_node(&scope, n->right->left);
+            if (n->right->right)
+                resolve_node(&scope, n->right->right->left);
+        }
+        resolve_node(&scope, body);
+        scope_release(&scope);
+        break;
+    }
+
+    case NODE_FOR_EACH:
+    {
+        resolve_node(s, n->right);
+        Scope scope;
+        scope_init(&scope, s);
+        scope_declare(&scope, n->left->name);
+        collect_stmt(&scope, n->super_template_types);
+        resolve_node(&scope, n->super_template_types);
+        scope_release(&scope);
+        break;
+    }
+
+    case NODE_FOR_IN:
+    {
+        resolve_node(s, n->next);
+        Scope scope;
+        scope_init(&scope, s);
+        scope_declare(&scope, n->left->name);
+        scope_declare(&scope, n->right->name);
+        resolve_node(&scope, n->super_template_types);
+        scope_release(&scope);
+        break;
+    }
+
+    case NODE_WHERE:
+    {
+        resolve_node(s, n->left);
+        Scope scope;
+        scope_init(&scope, s);
+        scope_declare(&scope, "it");
+        resolve_node(&scope, n->right);
+        scope_release(&scope);
+        break;
+    }
+
+    case NODE_WITH:
+    {
+        resolve_node(s, n->left);
+        Scope scope;
+        scope_init(&scope, s);
+        scope.is_opaque = true;
+        resolve_node(&scope, n->right);
+        scope_release(&scope);
+        break;
+    }
+
+    case NODE_TRY_STMT:
+    {
+        resolve_node(s, n->left);
+        Scope scope;
+        scope_init(&scope, s);
+        scope_declare(&scope, n->name);
+        resolve_node(&scope, n->right);
+        scope_release(&scope);
+        break;
+    }
+
+    case NODE_EVERY_LOOP:
+    {
+        Scope scope;
+        scope_init(&scope, s);
+        resolve_node(&scope, n->left);
+        if (n->right)
+        {
+            resolve_node(&scope, n->right->left);
+            resolve_node(&scope, n->right->right);
+        }
+        scope_release(&scope);
+        break;
+    }
+
+    case NODE_MATCH_STMT:
+        resolve_node(s, n->left);
+        for (Node *c = n->right; c; c = c->next)
+        {
+            resolve_node(s, c->left);
+            resolve_node(s, c->right);
+        }
+        break;
+
+    case NODE_WHEN_EXPR:
+        for (Node *c = n->left; c; c = c->next)
+        {
+            resolve_node(s, c->left);
+            resolve_node(s, c->right);
+        }
+        break;
+
+    case NODE_OBSERVE_STMT:
+        for (Node *c = n->right; c; c = c->next)
+        {
+            resolve_node(s, c->left);
+            resolve_node(s, c->right);
+        }
+        break;
+
+    case NODE_FUNC_CALL:
+        resolve_node(s, n->left);
+        resolve_list(s, n->right);
+        break;
+
+    case NODE_ARRAY_LITERAL:
+        resolve_list(s, n->left);
+        break;
+
+    case NODE_MAP_LITERAL:
+        for (Node *entry = n->left; entry; entry = entry->next)
+            resolve_node(s, entry->left);
+        break;
+
+    case NODE_SET:
+        if (n->left)
+            resolve_node(s, n->left->left);
+        resolve_node(s, n->right);
+        break;
+
+    case NODE_GET:
+    case NODE_RETURN_STMT:
+    case NODE_THROW_STMT:
+    case NODE_AWAIT:
+    case NODE_POST_INC:
+    case NODE_POST_DEC:
+        resolve_node(s, n->left);
+        break;
+
+    case NODE_BINOP:
+    case NODE_UNARY:
+    case NODE_RANGE_EXPR:
+    case NODE_ARRAY_ACCESS:
+    case NODE_ARRAY_ASSIGN:
+    case NODE_PRINT:
+        resolve_node(s, n->left);
+        resolve_node(s, n->right);
+        break;
+
+    default:
+        break;
+    }
+}
+
+/**
+ * Whether evaluating a node can leave its environment reachable after the
+ * scope that created it returns.
+ */
+static bool creates_closure(Node *n)
+{
+    switch (n->kind)
+    {
+    case NODE_FUNC_DEF:
+    case NODE_FUNC_EXPR:
+    case NODE_CLASS_DEF:
+    case NODE_STRUCT_DEF:
+    case NODE_EXTENSION:
+    case NODE_NAMESPACES:
+    case NODE_IMPORT:
+    case NODE_USE:
+    case NODE_PACK:
+        return true;
+    default:
+        return false;
+    }
+}
+
+static bool mark_frames(Node *n);
+
+static bool mark_frames_list(Node *head)
+{
+    bool captures = false;
+    for (Node *n = head; n; n = n->next)
+        captures |= mark_frames(n);
+    return captures;
+}
+
+/**
+ * Sets is_frame_local on every node whose subtree creates no closures, so
+ * the scopes it opens can live in the frame arena (see env_push).
+ * @return Whether the subtree creates a closure.
+ */
+static bool mark_frames(Node *n)
+{
+    bool captures = creates_closure(n);
+    captures |= mark_frames_list(n->left);
+    captures |= mark_frames_list(n->right);
+    captures |= mark_frames_list(n->super_template_types);
+    captures |= mark_frames_list(n->template_types);
+    n->is_frame_local = !captures;
+    return captures;
+}
+
+void resolve_stmt(Node *stmt)
+{
+    Scope root;
+    scope_init(&root, NULL);
+    root.is_root = true;
+    resolve_node(&root, stmt);
+    scope_release(&root);
+    if (stmt)
+        mark_frames(stmt);
+}
@@ -0,0 +1,129 @@
+#include "shape.h"
+#include "string_object.h"
+#include "value.h"
+#include "gc.h"
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* Guards the transition lists, which threads running @parallel code may
+   extend at the same time. */
+static pthread_mutex_t shape_lock = PTHREAD_MUTEX_INITIALIZER;
+
+Shape *shape_new_root(void)
+{
+    return calloc(1, sizeof(Shape));
+}
+
+int shape_slot(Shape *shape, ObjString *name)
+{
+    for (int i = shape->slot_count - 1; i >= 0; i--)
+    {
+        if (shape->names[i] == name)
+            return i;
+    }
+    return -1;
+}
+
+Shape *shape_add(Shape *shape, ObjString *name)
+{
+    name->is_pinned = true;
+
+    pthread_mutex_lock(&shape_lock);
+    for (int i = 0; i < shape->transition_count; i++)
+    {
+        Shape *child = shape->transitions[i];
+        if (child->names[child->slot_count - 1] == name)
+        {
+            pthread_mutex_unlock(&shape_lock);
+            return child;
+        }
+    }
+
+    Shape *child = calloc(1, sizeof(Shape));
+    child->parent = shape;
+    child->slot_count = shape->slot_count + 1;
+    child->names = malloc(sizeof(ObjString *) * child->slot_count);
+    if (shape->slot_count > 0)
+        memcpy(child->names, shape->names, sizeof(ObjString *) * shape->slot_count);
+    child->names[shape->slot_count] = name;
+
+    if (shape->transition_count == shape->transition_capacity)
+    {
+        shape->transition_capacity = shape->transition_capacity < 4 ? 4 : shape->transition_capacity * 2;
+        shape->transitions = realloc(shape->transitions, sizeof(Shape *) * shape->transition_capacity);
+    }
+    shape->transitions[shape->transition_count++] = child;
+    pthread_mutex_unlock(&shape_lock);
+    return child;
+}
+
+Instance *instance_new(Value klass_val)
+{
+    Instance *inst = gc_allocate(sizeof(Instance), GC_INSTANCE);
+    inst->class_val = malloc(sizeof(Value));
+    *inst->class_val = klass_val;
+    inst->shape = AS_CLASS(klass_val)->shape;
+    return inst;
+}
+
+/* Cache entries are written without a lock, so each use copies the entry
+   and checks it against the receiver's shape, which never changes, before
+   trusting it. */
+
+Value *instance_field(Instance *inst, ObjString *name, FieldCache *cache)
+{
+    Shape *shape = inst->shape;
+    if (cache)
+    {
+        FieldCache entry = *cache;
+        if (entry.shape == shape && entry.slot >= 0 && entry.slot < shape->slot_count &&
+            shape->names[entry.slot] == name)
+            return &inst->fields[entry.slot];
+    }
+
+    int slot = shape_slot(shape, name);
+    if (slot < 0)
+        return NULL;
+    if (cache)
+        *cache = (FieldCache){shape, slot, NULL};
+    return &inst->fields[slot];
+}
+
+void instance_set_field(Instance *inst, ObjString *name, Value value, FieldCache *cache)
+{
+    Value *field = instance_field(inst, name, cache);
+    if (field)
+    {
+        Value old = *field;
+        *field = copy_value(value);
+        free_value(old);
+        return;
+    }
+
+    Value copy = copy_value(value);
+    Shape *shape = inst->shape;
+    Shape *next = NULL;
+    if (cache)
+    {
+        FieldCache entry = *cache;
+        if (entry.shape == shape && entry.transition && entry.transition->parent == shape &&
+            entry.transition->names[shape->slot_count] == name)
+            next = entry.transition;
+    }
+    if (next == NULL)
+    {
+        next = shape_add(shape, name);
+        if (cache)
+            *cache = (FieldCache){shape, -1, next};
+    }
+
+    if (next->slot_count > inst->field_capacity)
+    {
+        int capacity = inst->field_capacity < 4 ? 4 : inst->field_capacity * 2;
+        inst->fields = realloc(inst->fields, sizeof(Value) * capacity);
+        inst->field_capacity = capacity;
+    }
+    inst->fields[next->slot_count - 1] = copy;
+    inst->shape = next;
+}
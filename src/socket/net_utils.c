@@ -1,5 +1,9 @@
 #include "socket/net_utils.h"
+#include "async.h"
 #include <string.h>
+#ifndef _WIN32
+    #include <fcntl.h>
+#endif
 
 void net_init(void) {
 #ifdef _WIN32
@@ -49,5 +53,29 @@ int net_socket_connect(socket_t s, const char* host, int port) {
     if ((he = gethostbyname(host)) == NULL) return SOCKET_ERROR_VAL;
     memcpy(&addr.sin_addr, he->h_addr_list[0], he->h_length);
     
+#ifdef _WIN32
     return connect(s, (struct sockaddr*)&addr, sizeof(addr));
+#else
+    /* Connect without blocking and wait for the handshake in the event
+       loop, so other fibers keep running meanwhile. */
+    int flags = fcntl(s, F_GETFL, 0);
+    fcntl(s, F_SETFL, flags | O_NONBLOCK);
+    int res = connect(s, (struct sockaddr*)&addr, sizeof(addr));
+    if (res < 0 && errno == EINPROGRESS) {
+        int err = ETIMEDOUT;
+        socklen_t len = sizeof(err);
+        if (async_wait_fd(s, ASYNC_WRITE, -1))
+            getsockopt(s, SOL_SOCKET, SO_ERROR, &err, &len);
+        res = err == 0 ? 0 : SOCKET_ERROR_VAL;
+        errno = err;
+    }
+    fcntl(s, F_SETFL, flags);
+    return res;
+#endif
+}
+
+socket_t net_socket_accept(socket_t s) {
+    struct sockaddr_in addr;
+    socklen_t len = sizeof(addr);
+    return accept(s, (struct sockaddr*)&addr, &len);
 }
\ No newline at end of file
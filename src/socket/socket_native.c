@@ -1,5 +1,7 @@
 #include "socket/socket_native.h"
 #include "socket/net_utils.h"
+#include "async.h"
+#include "string_object.h"
 #include <stdlib.h>
 #include <string.h>
 #include <errno.h>
@@ -10,10 +12,17 @@
     #include <sys/time.h>
 #endif
 
+#ifndef MSG_NOSIGNAL
+    #define MSG_NOSIGNAL 0
+#endif
+#ifndef MSG_DONTWAIT
+    #define MSG_DONTWAIT 0
+#endif
+
 #define SOCKET_REGISTER(env, name, func) \
     do { \
         if (func != NULL) { \
-            set_var(env, name, (Value){VAL_NATIVE, {.native = func}}, true, ""); \
+            set_var(env, name, NATIVE_VAL(func), true, ""); \
         } else { \
             printf("Socket Error: Native function '%s' not implemented!\n", name); \
         } \
@@ -36,81 +45,98 @@ char* net_resolve_host(const char* host) {
 }
 
 Value native_net_htons(int arg_count, Value* args) {
-    if (arg_count < 1 || args[0].type != VAL_NUMBER) return (Value){VAL_NUMBER, {.number = 0}};
+    if (arg_count < 1 || VALUE_TYPE(args[0]) != VAL_NUMBER) return NUMBER_VAL(0);
     
-    uint16_t port = (uint16_t)args[0].as.number;
-    return (Value){VAL_NUMBER, {.number = (double)htons(port)}};
+    uint16_t port = (uint16_t)AS_NUMBER(args[0]);
+    return NUMBER_VAL((double)htons(port));
 }
 
 Value native_net_aton(int arg_count, Value* args) {
-    if (arg_count < 1 || args[0].type != VAL_STRING) return (Value){VAL_NIL, {0}};
+    if (arg_count < 1 || VALUE_TYPE(args[0]) != VAL_STRING) return NIL_VAL;
     
-    const char* ip_str = args[0].as.string;
+    const char* ip_str = AS_STRING(args[0]);
     struct in_addr addr;
     
-    if (inet_aton(ip_str, &addr) == 0) return (Value){VAL_NIL, {0}};
+    if (inet_aton(ip_str, &addr) == 0) return NIL_VAL;
     
-    return (Value){VAL_NUMBER, {.number = (double)addr.s_addr}};
+    return NUMBER_VAL((double)addr.s_addr);
 }
 Value native_net_ntoa(int arg_count, Value* args) {
-    if (arg_count < 1 || args[0].type != VAL_NUMBER) return (Value){VAL_NIL, {0}};
+    if (arg_count < 1 || VALUE_TYPE(args[0]) != VAL_NUMBER) return NIL_VAL;
     
     struct in_addr addr;
-    addr.s_addr = (uint32_t)args[0].as.number;
+    addr.s_addr = (uint32_t)AS_NUMBER(args[0]);
     
     char* ip_str = inet_ntoa(addr);
-    return (Value){VAL_STRING, {.string = strdup(ip_str)}};
+    return string_copy(ip_str);
 }
 
 Value native_socket_get_local_ip(int arg_count, Value* args) {
     char hostname[256];
     if (gethostname(hostname, sizeof(hostname)) == -1) {
-        return (Value){VAL_NIL, {0}};
+        return NIL_VAL;
     }
 
     struct hostent *he = gethostbyname(hostname);
     if (he == NULL) {
-        return (Value){VAL_NIL, {0}};
+        return NIL_VAL;
     }
 
     struct in_addr **addr_list = (struct in_addr **)he->h_addr_list;
     if (addr_list[0] != NULL) {
         char* ip = inet_ntoa(*addr_list[0]);
-        return (Value){VAL_STRING, {.string = strdup(ip)}};
+        return string_copy(ip);
     }
 
-    return (Value){VAL_NIL, {0}};
+    return NIL_VAL;
 }
 
 Value native_socket_resolve(int arg_count, Value* args) {
-    if (arg_count < 1 || args[0].type != VAL_STRING) {
-        return (Value){VAL_NIL, {0}};
+    if (arg_count < 1 || VALUE_TYPE(args[0]) != VAL_STRING) {
+        return NIL_VAL;
     }
 
-    const char* host = args[0].as.string;
+    const char* host = AS_STRING(args[0]);
     char* ip = net_resolve_host(host);
 
     if (ip == NULL) {
-        return (Value){VAL_NIL, {0}};
+        return NIL_VAL;
     }
 
-    char* res_str = strdup(ip);
-    return (Value){VAL_STRING, {.string = res_str}};
+    return string_copy(ip);
+}
+
+/**
+ * Reads the SO_RCVTIMEO / SO_SNDTIMEO timeout of a socket in milliseconds,
+ * -1 if it has none, so waits in the event loop honour socket_set_timeout.
+ */
+static int socket_timeout_ms(socket_t s, int option) {
+#ifdef _WIN32
+    DWORD timeout = 0;
+    int len = sizeof(timeout);
+    if (getsockopt(s, SOL_SOCKET, option, (char*)&timeout, &len) != 0 || timeout == 0) return -1;
+    return (int)timeout;
+#else
+    struct timeval tv = {0, 0};
+    socklen_t len = sizeof(tv);
+    if (getsockopt(s, SOL_SOCKET, option, &tv, &len) != 0 || (tv.tv_sec == 0 && tv.tv_usec == 0)) return -1;
+    return (int)(tv.tv_sec * 1000 + tv.tv_usec / 1000);
+#endif
 }
 
 Value native_socket_create(int arg_count, Value* args) {
-    if (arg_count < 2) return (Value){VAL_NIL, {0}};
+    if (arg_count < 2) return NIL_VAL;
     
-    socket_t s = net_socket_create((int)args[0].as.number, (int)args[1].as.number, 0);
-    return (Value){VAL_NUMBER, {.number = (double)s}};
+    socket_t s = net_socket_create((int)AS_NUMBER(args[0]), (int)AS_NUMBER(args[1]), 0);
+    return NUMBER_VAL((double)s);
 }
 
 Value native_socket_bind(int arg_count, Value* args) {
-    if (arg_count < 3) return (Value){VAL_NUMBER, {.number = -1}};
+    if (arg_count < 3) return NUMBER_VAL(-1);
     
-    socket_t s = (socket_t)args[0].as.number;
-    const char* ip = args[1].as.string;
-    int port = (int)args[2].as.number;
+    socket_t s = (socket_t)AS_NUMBER(args[0]);
+    const char* ip = AS_STRING(args[1]);
+    int port = (int)AS_NUMBER(args[2]);
     
     int result = net_socket_bind(s, ip, port);
     
@@ -118,76 +144,106 @@ Value native_socket_bind(int arg_count, Value* args) {
         printf("Socket Error: Bind failed with code: %d\n", net_get_last_error());
     }
     
-    return (Value){VAL_NUMBER, {.number = (double)result}};
+    return NUMBER_VAL((double)result);
 }
 
 
 Value native_socket_send(int arg_count, Value* args) {
-    if (arg_count < 2 || args[0].type != VAL_NUMBER || args[1].type != VAL_STRING) 
-        return (Value){VAL_NUMBER, {.number = -1}};
-
-    socket_t s = (socket_t)args[0].as.number;
-    const char* data = args[1].as.string;
-    
-    int sent = send(s, data, (int)strlen(data), 0);
-    return (Value){VAL_NUMBER, {.number = (double)sent}};
+    if (arg_count < 2 || VALUE_TYPE(args[0]) != VAL_NUMBER || VALUE_TYPE(args[1]) != VAL_STRING) 
+        return NUMBER_VAL(-1);
+
+    socket_t s = (socket_t)AS_NUMBER(args[0]);
+    const char* data = AS_STRING(args[1]);
+    int length = (int)strlen(data);
+
+    /* Sends what fits without blocking; while the socket buffer is full,
+       waits in the event loop so other fibers keep running. */
+    int sent = 0;
+    while (sent < length) {
+        int n = send(s, data + sent, length - sent, MSG_DONTWAIT | MSG_NOSIGNAL);
+        if (n >= 0) {
+            sent += n;
+            continue;
+        }
+        if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+            if (sent == 0) sent = -1;
+            break;
+        }
+        if (!async_wait_fd(s, ASYNC_WRITE, socket_timeout_ms(s, SO_SNDTIMEO))) break;
+    }
+    return NUMBER_VAL((double)sent);
 }
 
 Value native_socket_recv(int arg_count, Value* args) {
-    if (arg_count < 2 || args[0].type != VAL_NUMBER || args[1].type != VAL_NUMBER)
-        return (Value){VAL_NIL, {0}};
+    if (arg_count < 2 || VALUE_TYPE(args[0]) != VAL_NUMBER || VALUE_TYPE(args[1]) != VAL_NUMBER)
+        return NIL_VAL;
 
-    socket_t s = (socket_t)args[0].as.number;
-    int buffer_size = (int)args[1].as.number;
+    socket_t s = (socket_t)AS_NUMBER(args[0]);
+    int buffer_size = (int)AS_NUMBER(args[1]);
     
     char* buffer = malloc(buffer_size + 1);
-    int bytes_received = recv(s, buffer, buffer_size, 0);
+    int bytes_received;
+    for (;;) {
+        bytes_received = recv(s, buffer, buffer_size, MSG_DONTWAIT);
+        if (bytes_received >= 0 || (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)) break;
+        if (!async_wait_fd(s, ASYNC_READ, socket_timeout_ms(s, SO_RCVTIMEO))) break;
+    }
 
     if (bytes_received <= 0) {
         free(buffer);
-        return (Value){VAL_NIL, {0}};
+        return NIL_VAL;
     }
 
-    buffer[bytes_received] = '\0';
-    Value res = (Value){VAL_STRING, {.string = buffer}};
+    Value res = string_new(buffer, bytes_received);
+    free(buffer);
     return res;
 }
 
 
 
 Value native_socket_listen(int arg_count, Value* args) {
-    if (arg_count < 2) return (Value){VAL_NUMBER, {.number = -1}};
+    if (arg_count < 2) return NUMBER_VAL(-1);
     
-    socket_t s = (socket_t)args[0].as.number;
-    int backlog = (int)args[1].as.number;
+    socket_t s = (socket_t)AS_NUMBER(args[0]);
+    int backlog = (int)AS_NUMBER(args[1]);
     
     int result = listen(s, backlog);
-    return (Value){VAL_NUMBER, {.number = (double)result}};
+    return NUMBER_VAL((double)result);
+}
+
+Value native_socket_accept(int arg_count, Value* args) {
+    if (arg_count < 1 || VALUE_TYPE(args[0]) != VAL_NUMBER) return NUMBER_VAL(-1);
+    socket_t s = (socket_t)AS_NUMBER(args[0]);
+
+    if (!async_wait_fd(s, ASYNC_READ, socket_timeout_ms(s, SO_RCVTIMEO)))
+        return NUMBER_VAL(-1);
+    socket_t client = net_socket_accept(s);
+    return NUMBER_VAL((double)client);
 }
 
 Value native_socket_close(int arg_count, Value* args) {
-    if (arg_count < 1) return (Value){VAL_NIL, {0}};
-    socket_t s = (socket_t)args[0].as.number;
+    if (arg_count < 1) return NIL_VAL;
+    socket_t s = (socket_t)AS_NUMBER(args[0]);
     CLOSE_SOCKET(s);
-    return (Value){VAL_NIL, {0}};
+    return NIL_VAL;
 }
 
 Value native_socket_connect(int arg_count, Value* args) {
-    if (arg_count < 3) return (Value){VAL_NUMBER, {.number = -1}};
-    socket_t s = (socket_t)args[0].as.number;
-    const char* host = args[1].as.string;
-    int port = (int)args[2].as.number;
+    if (arg_count < 3) return NUMBER_VAL(-1);
+    socket_t s = (socket_t)AS_NUMBER(args[0]);
+    const char* host = AS_STRING(args[1]);
+    int port = (int)AS_NUMBER(args[2]);
     int res = net_socket_connect(s, host, port);
-    return (Value){VAL_NUMBER, {.number = (double)res}};
+    return NUMBER_VAL((double)res);
 }
 
 Value native_socket_set_timeout(int arg_count, Value* args) {
-    if (arg_count < 2 || args[0].type != VAL_NUMBER || args[1].type != VAL_NUMBER) {
-        return (Value){VAL_NUMBER, {.number = -1}};
+    if (arg_count < 2 || VALUE_TYPE(args[0]) != VAL_NUMBER || VALUE_TYPE(args[1]) != VAL_NUMBER) {
+        return NUMBER_VAL(-1);
     }
 
-    socket_t s = (socket_t)args[0].as.number;
-    int ms = (int)args[1].as.number;
+    socket_t s = (socket_t)AS_NUMBER(args[0]);
+    int ms = (int)AS_NUMBER(args[1]);
 
 #ifdef _WIN32
     DWORD timeout = ms;
@@ -200,19 +256,20 @@ Value native_socket_set_timeout(int arg_count, Value* args) {
     setsockopt(s, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
     int res = setsockopt(s, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
 #endif
-    return (Value){VAL_NUMBER, {.number = (double)res}};
+    return NUMBER_VAL((double)res);
 }
 
 void register_socket_natives(Env* env) {
 
-    set_var(env, "AF_INET", (Value){VAL_NUMBER, {.number = 2}}, true, "");
-    set_var(env, "SOCK_STREAM", (Value){VAL_NUMBER, {.number = 1}}, true, "");
-    set_var(env, "SOCK_DGRAM", (Value){VAL_NUMBER, {.number = 2}}, true, "");
-    set_var(env, "SOL_SOCKET", (Value){VAL_NUMBER, {.number = 0xFFFF}}, true, "");
+    set_var(env, "AF_INET", NUMBER_VAL(2), true, "");
+    set_var(env, "SOCK_STREAM", NUMBER_VAL(1), true, "");
+    set_var(env, "SOCK_DGRAM", NUMBER_VAL(2), true, "");
+    set_var(env, "SOL_SOCKET", NUMBER_VAL(0xFFFF), true, "");
 
     SOCKET_REGISTER(env, "socket_create", native_socket_create);
     SOCKET_REGISTER(env, "socket_bind", native_socket_bind);
     SOCKET_REGISTER(env, "socket_listen", native_socket_listen);
+    SOCKET_REGISTER(env, "socket_accept", native_socket_accept);
     SOCKET_REGISTER(env, "socket_close", native_socket_close);
     SOCKET_REGISTER(env, "socket_send", native_socket_send);
     SOCKET_REGISTER(env, "socket_recv", native_socket_recv);
@@ -5,13 +5,14 @@
 #include <errno.h>
 #include <sys/stat.h>
 #include "env.h"
+#include "string_object.h"
 
 #define SQLITE_REGISTER(env, name, func)                                         \
     do                                                                           \
     {                                                                            \
         if (func != NULL)                                                        \
         {                                                                        \
-            set_var(env, name, (Value){VAL_NATIVE, {.native = func}}, true, ""); \
+            set_var(env, name, NATIVE_VAL(func), true, ""); \
         }                                                                        \
         else                                                                     \
         {                                                                        \
@@ -24,45 +25,45 @@ Value native_db_open(int arity, Value *args) {
     call_count++;
     printf("--- DEBUG: native_db_execute dipanggil ke-%d ---\n", call_count);
 
-    if (arity < 1 || args[0].type != VAL_STRING) {
+    if (arity < 1 || VALUE_TYPE(args[0]) != VAL_STRING) {
         print_error("db_open expects a string path.");
-        return (Value){VAL_NIL, {0}};
+        return NIL_VAL;
     }
 
-    const char* db_name = args[0].as.string;
+    const char* db_name = AS_STRING(args[0]);
     sqlite3 *db;
     int rc = sqlite3_open(db_name, &db);
 
     if (rc != SQLITE_OK) {
         printf("SQLite Error: %s\n", sqlite3_errmsg(db));
         sqlite3_close(db);
-        return (Value){VAL_NIL, {0}};
+        return NIL_VAL;
     }
 
     printf("Successfully connected to database: %s\n", db_name);
     
-    return (Value){VAL_FILE, {.file = (FILE*)db}};
+    return FILE_VAL((FILE*)db);
 }
 
 Value native_db_execute(int arity, Value *args) {
     if (arity < 2) {
         print_error("db_execute expects 2 arguments: (handle, sql_string)");
-        return (Value){VAL_BOOL, {.boolean = false}};
+        return BOOL_VAL(false);
     }
 
-    if (args[0].type == VAL_NIL || args[0].as.file == NULL) {
-        return (Value){VAL_BOOL, {.boolean = false}};
+    if (VALUE_TYPE(args[0]) == VAL_NIL || AS_FILE(args[0]) == NULL) {
+        return BOOL_VAL(false);
     }
 
-    if (args[1].type != VAL_STRING) {
-        return (Value){VAL_BOOL, {.boolean = false}};
+    if (VALUE_TYPE(args[1]) != VAL_STRING) {
+        return BOOL_VAL(false);
     }
 
-    sqlite3 *db = (sqlite3*)args[0].as.file;
-    const char* sql = args[1].as.string;
+    sqlite3 *db = (sqlite3*)AS_FILE(args[0]);
+    const char* sql = AS_STRING(args[1]);
 
     if (sql == NULL) {
-        return (Value){VAL_BOOL, {.boolean = false}};
+        return BOOL_VAL(false);
     }
 
     char *err_msg = NULL;
@@ -73,47 +74,47 @@ Value native_db_execute(int arity, Value *args) {
             printf("SQL Error: %s\n", err_msg);
             sqlite3_free(err_msg);
         }
-        return (Value){VAL_BOOL, {.boolean = false}};
+        return BOOL_VAL(false);
     }
 
-    return (Value){VAL_BOOL, {.boolean = true}};
+    return BOOL_VAL(true);
 }
 Value native_db_connect(int arity, Value *args) {
-    if (arity < 1 || args[0].type != VAL_STRING) {
+    if (arity < 1 || VALUE_TYPE(args[0]) != VAL_STRING) {
         print_error("db_connect expects a string path.");
-        return (Value){VAL_NIL, {0}};
+        return NIL_VAL;
     }
 
-    const char* db_name = args[0].as.string;
+    const char* db_name = AS_STRING(args[0]);
     sqlite3 *db;
     
     int rc = sqlite3_open_v2(db_name, &db, SQLITE_OPEN_READWRITE, NULL);
 
     if (rc != SQLITE_OK) {
         sqlite3_close(db);
-        return (Value){VAL_NIL, {0}};
+        return NIL_VAL;
     }
 
-    return (Value){VAL_FILE, {.file = (FILE*)db}};
+    return FILE_VAL((FILE*)db);
 }
 Value native_db_query(int arity, Value *args) {
     if (arity < 2) {
         print_error("db_query expects 2 arguments: (handle, sql_string)");
-        return (Value){VAL_NIL, {0}};
+        return NIL_VAL;
     }
 
-    sqlite3 *db = (sqlite3*)args[0].as.file;
+    sqlite3 *db = (sqlite3*)AS_FILE(args[0]);
     if (db == NULL) {
         printf("--- NATIVE DEBUG: dbHandle is NULL ---\n");
-        return (Value){VAL_NIL, {0}};
+        return NIL_VAL;
     }
 
-    const char* sql = args[1].as.string;
+    const char* sql = AS_STRING(args[1]);
     sqlite3_stmt *stmt;
     int rc = sqlite3_prepare_v2(db, sql, -1, &stmt, NULL);
     if (rc != SQLITE_OK) {
         printf("--- NATIVE DEBUG: Prepare Error: %s ---\n", sqlite3_errmsg(db));
-        return (Value){VAL_NIL, {0}};
+        return NIL_VAL;
     }
 
     ValueArray *results = array_new(); 
@@ -131,62 +132,55 @@ Value native_db_query(int arity, Value *args) {
 
             int type = sqlite3_column_type(stmt, i);
             if (type == SQLITE_INTEGER) {
-                val = (Value){VAL_NUMBER, {.number = (double)sqlite3_column_int(stmt, i)}};
+                val = NUMBER_VAL((double)sqlite3_column_int(stmt, i));
             } else if (type == SQLITE_FLOAT) {
-                val = (Value){VAL_NUMBER, {.number = sqlite3_column_double(stmt, i)}};
+                val = NUMBER_VAL(sqlite3_column_double(stmt, i));
             } else if (type == SQLITE_TEXT) {
                 const char *text = (const char*)sqlite3_column_text(stmt, i);
-                val = (Value){VAL_STRING, {.string = strdup(text)}};
+                val = string_copy(text);
             } else {
-                val = (Value){VAL_NIL, {0}};
+                val = NIL_VAL;
             }
 
             map_set(row, col_name, val);
         }
         
-        Value row_val;
-        row_val.type = VAL_MAP;
-        row_val.as.map = row;
-        
-        array_append(results, row_val);
+        array_append(results, MAP_VAL(row));
     }
 
 
     sqlite3_finalize(stmt);
 
-    Value final_result;
-    final_result.type = VAL_ARRAY;
-    final_result.as.array = results;
-    return final_result;
+    return ARRAY_VAL(results);
 }
 Value native_db_close(int arity, Value *args) {
     if (arity < 1) {
-        return (Value){VAL_BOOL, {.boolean = false}};
+        return BOOL_VAL(false);
     }
 
-    if (args[0].type == VAL_NIL || args[0].as.file == NULL) {
-        return (Value){VAL_BOOL, {.boolean = true}};
+    if (VALUE_TYPE(args[0]) == VAL_NIL || AS_FILE(args[0]) == NULL) {
+        return BOOL_VAL(true);
     }
 
-    sqlite3 *db = (sqlite3*)args[0].as.file;
+    sqlite3 *db = (sqlite3*)AS_FILE(args[0]);
     int rc = sqlite3_close(db);
 
     if (rc != SQLITE_OK) {
         printf("SQL Error: Gagal menutup database. %s\n", sqlite3_errmsg(db));
-        return (Value){VAL_BOOL, {.boolean = false}};
+        return BOOL_VAL(false);
     }
 
-    return (Value){VAL_BOOL, {.boolean = true}};
+    return BOOL_VAL(true);
 }
 Value native_db_create(int arity, Value *args) {
-    if (arity < 3 || args[2].type != VAL_MAP) {
+    if (arity < 3 || VALUE_TYPE(args[2]) != VAL_MAP) {
         printf("Runtime Error: create() butuh (handle, table_name, schema_map)\n");
-        return (Value){VAL_NIL, {0}};
+        return NIL_VAL;
     }
 
-    sqlite3 *db = (sqlite3*)args[0].as.file;
-    const char* table_name = args[1].as.string;
-    HashMap *schema = args[2].as.map;
+    sqlite3 *db = (sqlite3*)AS_FILE(args[0]);
+    const char* table_name = AS_STRING(args[1]);
+    HashMap *schema = AS_MAP(args[2]);
 
     char sql[2048]; 
     snprintf(sql, sizeof(sql), "CREATE TABLE IF NOT EXISTS %s (", table_name);
@@ -199,7 +193,7 @@ Value native_db_create(int arity, Value *args) {
         if (!first) strcat(sql, ", ");
         
         const char* column_name = entry->key;
-        const char* type_alias = entry->value.as.string;
+        const char* type_alias = AS_STRING(entry->value);
         const char* real_type = "TEXT";
 
         if (strcmp(type_alias, "primary") == 0) {
@@ -233,20 +227,20 @@ Value native_db_create(int arity, Value *args) {
     if (rc != SQLITE_OK) {
         printf("SQL Error: %s\n", err_msg);
         sqlite3_free(err_msg);
-        return (Value){VAL_BOOL, {.boolean = false}};
+        return BOOL_VAL(false);
     }
 
-    return (Value){VAL_BOOL, {.boolean = true}};
+    return BOOL_VAL(true);
 }
 Value native_db_insert(int arity, Value *args) {
-    if (arity < 3 || args[2].type != VAL_MAP) {
+    if (arity < 3 || VALUE_TYPE(args[2]) != VAL_MAP) {
         printf("Runtime Error: insert() butuh (handle, table_name, data_map)\n");
-        return (Value){VAL_BOOL, {.boolean = false}};
+        return BOOL_VAL(false);
     }
 
-    sqlite3 *db = (sqlite3*)args[0].as.file;
-    const char* table_name = args[1].as.string;
-    HashMap *data = args[2].as.map;
+    sqlite3 *db = (sqlite3*)AS_FILE(args[0]);
+    const char* table_name = AS_STRING(args[1]);
+    HashMap *data = AS_MAP(args[2]);
 
     char columns[1024] = "";
     char values[1024] = "";
@@ -263,16 +257,16 @@ Value native_db_insert(int arity, Value *args) {
 
         strcat(columns, entry->key);
 
-        if (entry->value.type == VAL_NUMBER) {
+        if (VALUE_TYPE(entry->value) == VAL_NUMBER) {
             char num_str[32];
-            sprintf(num_str, "%g", entry->value.as.number);
+            sprintf(num_str, "%g", AS_NUMBER(entry->value));
             strcat(values, num_str);
-        } else if (entry->value.type == VAL_STRING) {
+        } else if (VALUE_TYPE(entry->value) == VAL_STRING) {
             strcat(values, "'");
-            strcat(values, entry->value.as.string);
+            strcat(values, AS_STRING(entry->value));
             strcat(values, "'");
-        } else if (entry->value.type == VAL_BOOL) {
-            strcat(values, entry->value.as.boolean ? "1" : "0");
+        } else if (VALUE_TYPE(entry->value) == VAL_BOOL) {
+            strcat(values, AS_BOOL(entry->value) ? "1" : "0");
         } else {
             strcat(values, "NULL");
         }
@@ -289,20 +283,20 @@ Value native_db_insert(int arity, Value *args) {
     if (rc != SQLITE_OK) {
         printf("SQL Error: %s\n", err_msg);
         sqlite3_free(err_msg);
-        return (Value){VAL_BOOL, {.boolean = false}};
+        return BOOL_VAL(false);
     }
 
-    return (Value){VAL_BOOL, {.boolean = true}};
+    return BOOL_VAL(true);
 }
 Value native_db_where(int arity, Value *args) {
-    if (arity < 1 || args[0].type != VAL_MAP) {
-        return (Value){VAL_STRING, {.string = strdup("")}};
+    if (arity < 1 || VALUE_TYPE(args[0]) != VAL_MAP) {
+        return string_copy("");
     }
 
-    HashMap *criteria = args[0].as.map;
+    HashMap *criteria = AS_MAP(args[0]);
     
     if (criteria->count == 0) {
-        return (Value){VAL_STRING, {.string = strdup("")}};
+        return string_copy("");
     }
 
     char buffer[1024] = " WHERE ";
@@ -319,8 +313,8 @@ Value native_db_where(int arity, Value *args) {
         char op[4] = "=";
         char val_content[256] = "";
 
-        if (entry->value.type == VAL_STRING) {
-            const char* str_val = entry->value.as.string;
+        if (VALUE_TYPE(entry->value) == VAL_STRING) {
+            const char* str_val = AS_STRING(entry->value);
             
             if (str_val[0] == '>' || str_val[0] == '<' || str_val[0] == '!') {
                 if (str_val[0] == '!') {
@@ -340,8 +334,8 @@ Value native_db_where(int arity, Value *args) {
             strcat(buffer, val_content);
             strcat(buffer, "'");
         } 
-        else if (entry->value.type == VAL_NUMBER) {
-            sprintf(val_content, "%g", entry->value.as.number);
+        else if (VALUE_TYPE(entry->value) == VAL_NUMBER) {
+            sprintf(val_content, "%g", AS_NUMBER(entry->value));
             strcat(buffer, " = ");
             strcat(buffer, val_content);
         }
@@ -349,15 +343,15 @@ Value native_db_where(int arity, Value *args) {
         first = false;
     }
 
-    return (Value){VAL_STRING, {.string = strdup(buffer)}};
+    return string_copy(buffer);
 }
 Value native_db_join(int arity, Value *args) {
-    if (arity < 2 || args[1].type != VAL_MAP) {
-        return (Value){VAL_STRING, {.string = strdup("")}};
+    if (arity < 2 || VALUE_TYPE(args[1]) != VAL_MAP) {
+        return string_copy("");
     }
 
-    const char* target_table = args[0].as.string;
-    HashMap *relations = args[1].as.map;
+    const char* target_table = AS_STRING(args[0]);
+    HashMap *relations = AS_MAP(args[1]);
     
     char buffer[1024];
     snprintf(buffer, sizeof(buffer), " INNER JOIN %s ON ", target_table);
@@ -372,24 +366,24 @@ Value native_db_join(int arity, Value *args) {
         strcat(buffer, entry->key); 
         strcat(buffer, " = ");
         
-        if (entry->value.type == VAL_STRING) {
-            strcat(buffer, entry->value.as.string); 
+        if (VALUE_TYPE(entry->value) == VAL_STRING) {
+            strcat(buffer, AS_STRING(entry->value)); 
         }
         
         first = false;
     }
 
-    return (Value){VAL_STRING, {.string = strdup(buffer)}};
+    return string_copy(buffer);
 }
 
 Value native_db_select(int arity, Value *args) {
-    if (arity < 1 || args[0].type != VAL_MAP) {
-        return (Value){VAL_STRING, {.string = strdup("*")}};
+    if (arity < 1 || VALUE_TYPE(args[0]) != VAL_MAP) {
+        return string_copy("*");
     }
 
-    HashMap *columns = args[0].as.map;
+    HashMap *columns = AS_MAP(args[0]);
     if (columns->count == 0) {
-        return (Value){VAL_STRING, {.string = strdup("*")}};
+        return string_copy("*");
     }
 
     char buffer[1024] = "";
@@ -403,27 +397,27 @@ Value native_db_select(int arity, Value *args) {
 
         strcat(buffer, entry->key); 
         
-        if (entry->value.type == VAL_STRING) {
+        if (VALUE_TYPE(entry->value) == VAL_STRING) {
             strcat(buffer, " AS ");
-            strcat(buffer, entry->value.as.string);
+            strcat(buffer, AS_STRING(entry->value));
         }
         
         first = false;
     }
 
-    return (Value){VAL_STRING, {.string = strdup(buffer)}};
+    return string_copy(buffer);
 }
 
 Value native_db_count(int arg_count, Value* args) {
-    if (arg_count < 2) return (Value){VAL_NUMBER, {.number = 0}};
+    if (arg_count < 2) return NUMBER_VAL(0);
 
-    sqlite3* db = (sqlite3*)args[0].as.string; 
+    sqlite3* db = (sqlite3*)AS_STRING(args[0]); 
 
-    const char* sql = args[1].as.string;
+    const char* sql = AS_STRING(args[1]);
 
     sqlite3_stmt* stmt;
     if (sqlite3_prepare_v2(db, sql, -1, &stmt, NULL) != SQLITE_OK) {
-        return (Value){VAL_NUMBER, {.number = 0}};
+        return NUMBER_VAL(0);
     }
 
     double count = 0;
@@ -433,17 +427,17 @@ Value native_db_count(int arg_count, Value* args) {
 
     sqlite3_finalize(stmt);
 
-    return (Value){VAL_NUMBER, {.number = count}};
+    return NUMBER_VAL(count);
 }
 
 
 Value native_db_update(int arg_count, Value* args) {
-    if (arg_count < 4) return (Value){VAL_NUMBER, {.number = 0}};
+    if (arg_count < 4) return NUMBER_VAL(0);
 
-    sqlite3* db = (sqlite3*)args[0].as.string;
-    const char* table = args[1].as.string;
-    struct HashMap* map = args[2].as.map;
-    const char* where = args[3].as.string;
+    sqlite3* db = (sqlite3*)AS_STRING(args[0]);
+    const char* table = AS_STRING(args[1]);
+    struct HashMap* map = AS_MAP(args[2]);
+    const char* where = AS_STRING(args[3]);
 
     char sql[2048] = {0};
     sprintf(sql, "UPDATE %s SET ", table);
@@ -461,7 +455,7 @@ Value native_db_update(int arg_count, Value* args) {
 
     sqlite3_stmt* stmt;
     if (sqlite3_prepare_v2(db, sql, -1, &stmt, NULL) != SQLITE_OK) {
-        return (Value){VAL_NUMBER, {.number = 0}};
+        return NUMBER_VAL(0);
     }
 
     int index = 1;
@@ -469,10 +463,10 @@ Value native_db_update(int arg_count, Value* args) {
         if (map->entries[i].key == NULL) continue;
 
         Value val = map->entries[i].value;
-        if (val.type == VAL_NUMBER) {
-            sqlite3_bind_double(stmt, index++, val.as.number);
-        } else if (val.type == VAL_STRING) {
-            sqlite3_bind_text(stmt, index++, val.as.string, -1, SQLITE_TRANSIENT);
+        if (VALUE_TYPE(val) == VAL_NUMBER) {
+            sqlite3_bind_double(stmt, index++, AS_NUMBER(val));
+        } else if (VALUE_TYPE(val) == VAL_STRING) {
+            sqlite3_bind_text(stmt, index++, AS_STRING(val), -1, SQLITE_TRANSIENT);
         }
     }
 
@@ -482,15 +476,15 @@ Value native_db_update(int arg_count, Value* args) {
     }
 
     sqlite3_finalize(stmt);
-    return (Value){VAL_NUMBER, {.number = (double)affected}};
+    return NUMBER_VAL((double)affected);
 }
 
 Value native_db_delete(int arg_count, Value* args) {
-    if (arg_count < 3) return (Value){VAL_NUMBER, {.number = 0}};
+    if (arg_count < 3) return NUMBER_VAL(0);
 
-    sqlite3* db = (sqlite3*)args[0].as.string;
-    const char* table = args[1].as.string;
-    const char* where = args[2].as.string;
+    sqlite3* db = (sqlite3*)AS_STRING(args[0]);
+    const char* table = AS_STRING(args[1]);
+    const char* where = AS_STRING(args[2]);
 
     char sql[1024] = {0};
     sprintf(sql, "DELETE FROM %s%s", table, where);
@@ -503,7 +497,7 @@ Value native_db_delete(int arg_count, Value* args) {
         affected = sqlite3_changes(db);
     }
 
-    return (Value){VAL_NUMBER, {.number = (double)affected}};
+    return NUMBER_VAL((double)affected);
 }
 
 
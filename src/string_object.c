@@ -0,0 +1,208 @@
+#include "string_object.h"
+#include "gc.h"
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define TABLE_MAX_LOAD 0.75
+#define TABLE_TOMBSTONE ((ObjString *)1)
+
+/* Open-addressed set of interned strings, keyed by content. */
+static pthread_mutex_t intern_lock = PTHREAD_MUTEX_INITIALIZER;
+static ObjString **table = NULL;
+static size_t table_capacity = 0;
+static size_t table_used = 0;   // live entries and tombstones
+static size_t table_live = 0;
+
+uint32_t string_hash(const char *chars, size_t length)
+{
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < length; i++)
+    {
+        hash ^= (uint8_t)chars[i];
+        hash *= 16777619;
+    }
+    return hash;
+}
+
+/**
+ * Allocates a managed string and fills in its header.
+ */
+static ObjString *allocate_string(const char *chars, size_t length, uint32_t hash)
+{
+    ObjString *string = gc_allocate(sizeof(ObjString) + length + 1, GC_STRING);
+    string->length = (uint32_t)length;
+    string->hash = hash;
+    memcpy(string->chars, chars, length);
+    string->chars[length] = '\0';
+    return string;
+}
+
+Value string_value(ObjString *string)
+{
+    return STRING_VAL(string->chars);
+}
+
+Value string_new(const char *chars, size_t length)
+{
+    return string_value(allocate_string(chars, length, string_hash(chars, length)));
+}
+
+Value string_copy(const char *chars)
+{
+    if (chars == NULL)
+        return STRING_VAL(NULL);
+    return string_new(chars, strlen(chars));
+}
+
+Value string_concat(const char *a, size_t a_length, const char *b, size_t b_length)
+{
+    size_t length = a_length + b_length;
+    ObjString *string = gc_allocate(sizeof(ObjString) + length + 1, GC_STRING);
+    memcpy(string->chars, a, a_length);
+    memcpy(string->chars + a_length, b, b_length);
+    string->chars[length] = '\0';
+    string->length = (uint32_t)length;
+    string->hash = string_hash(string->chars, length);
+    return string_value(string);
+}
+
+ObjString *string_object(Value value)
+{
+    if (!IS_STRING(value) || AS_STRING(value) == NULL)
+        return NULL;
+    ObjString *string = STRING_OBJECT(AS_STRING(value));
+#ifdef JACKAL_CHECKED_VALUES
+    if (!gc_is_string(string))
+    {
+        fprintf(stderr, "string Value %p is not a managed string\n", (void *)AS_STRING(value));
+        abort();
+    }
+#endif
+    return string;
+}
+
+bool string_equals(Value a, Value b)
+{
+    if (AS_STRING(a) == AS_STRING(b))
+        return true;
+    if (AS_STRING(a) == NULL || AS_STRING(b) == NULL)
+        return false;
+
+    ObjString *x = string_object(a);
+    ObjString *y = string_object(b);
+    if (x && y)
+    {
+        if (x->length != y->length || x->hash != y->hash)
+            return false;
+        if (x->is_interned && y->is_interned)
+            return false;
+        return memcmp(x->chars, y->chars, x->length) == 0;
+    }
+    return strcmp(AS_STRING(a), AS_STRING(b)) == 0;
+}
+
+/* ---- Intern table; the caller holds intern_lock ---- */
+
+static ObjString *table_find(const char *chars, size_t length, uint32_t hash)
+{
+    if (table_capacity == 0)
+        return NULL;
+    size_t i = hash & (table_capacity - 1);
+    while (table[i] != NULL)
+    {
+        ObjString *s = table[i];
+        if (s != TABLE_TOMBSTONE && s->hash == hash && s->length == length &&
+            memcmp(s->chars, chars, length) == 0)
+            return s;
+        i = (i + 1) & (table_capacity - 1);
+    }
+    return NULL;
+}
+
+static void table_insert_slot(ObjString **slots, size_t capacity, ObjString *string)
+{
+    size_t i = string->hash & (capacity - 1);
+    while (slots[i] != NULL && slots[i] != TABLE_TOMBSTONE)
+        i = (i + 1) & (capacity - 1);
+    slots[i] = string;
+}
+
+static void table_insert(ObjString *string)
+{
+    if (table_used + 1 > table_capacity * TABLE_MAX_LOAD)
+    {
+        size_t capacity = table_capacity < 256 ? 256 : table_capacity;
+        while ((table_live + 1) * 2 > capacity)
+            capacity *= 2;
+
+        ObjString **slots = calloc(capacity, sizeof(ObjString *));
+        for (size_t i = 0; i < table_capacity; i++)
+        {
+            if (table[i] != NULL && table[i] != TABLE_TOMBSTONE)
+                table_insert_slot(slots, capacity, table[i]);
+        }
+        free(table);
+        table = slots;
+        table_capacity = capacity;
+        table_used = table_live;
+    }
+
+    table_insert_slot(table, table_capacity, string);
+    table_used++;
+    table_live++;
+}
+
+ObjString *string_intern(const char *chars, size_t length)
+{
+    uint32_t hash = string_hash(chars, length);
+
+    pthread_mutex_lock(&intern_lock);
+    ObjString *found = table_find(chars, length, hash);
+    pthread_mutex_unlock(&intern_lock);
+    if (found)
+        return found;
+
+    /* Allocate without holding the lock: the allocation may run a
+       collection, whose sweep calls string_forget. */
+    ObjString *string = allocate_string(chars, length, hash);
+    string->is_interned = true;
+
+    pthread_mutex_lock(&intern_lock);
+    found = table_find(chars, length, hash);
+    if (!found)
+        table_insert(string);
+    pthread_mutex_unlock(&intern_lock);
+
+    if (found)
+    {
+        gc_free(string);
+        return found;
+    }
+    return string;
+}
+
+ObjString *string_intern_pinned(const char *chars)
+{
+    ObjString *string = string_intern(chars, strlen(chars));
+    string->is_pinned = true;
+    return string;
+}
+
+void string_forget(ObjString *string)
+{
+    pthread_mutex_lock(&intern_lock);
+    size_t i = string->hash & (table_capacity - 1);
+    while (table[i] != NULL)
+    {
+        if (table[i] == string)
+        {
+            table[i] = TABLE_TOMBSTONE;
+            table_live--;
+            break;
+        }
+        i = (i + 1) & (table_capacity - 1);
+    }
+    pthread_mutex_unlock(&intern_lock);
+}
@@ -0,0 +1,355 @@
+#include "task.h"
+#include "eval.h"
+#include "env.h"
+#include "value.h"
+#include "gc.h"
+#include "methods.h"
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+/**
+ * @typedef @struct TASKDEQUE
+ * Ring buffer of queued tasks. The owning worker pushes and pops at the
+ * bottom; other threads steal from the top.
+ */
+typedef struct {
+    pthread_mutex_t lock;
+    Task** items;
+    int top;        // index of the oldest task
+    int count;
+    int capacity;
+} TaskDeque;
+
+typedef struct {
+    pthread_t thread;
+    TaskDeque deque;
+    int index;
+} Worker;
+
+static Worker* workers = NULL;
+static int worker_count = 0;
+static pthread_once_t pool_once = PTHREAD_ONCE_INIT;
+
+/* Idle workers sleep on idle_cond until queued_count goes up. */
+static pthread_mutex_t idle_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t idle_cond = PTHREAD_COND_INITIALIZER;
+static atomic_int queued_count = 0;
+static atomic_uint next_deque = 0;
+
+/* Index of the worker running on this thread, -1 outside the pool. */
+static __thread int worker_index = -1;
+
+/* ---- Deques ---- */
+
+static void deque_push(TaskDeque* deque, Task* task)
+{
+    pthread_mutex_lock(&deque->lock);
+    if (deque->count == deque->capacity)
+    {
+        int capacity = deque->capacity < 16 ? 16 : deque->capacity * 2;
+        Task** items = malloc(sizeof(Task*) * capacity);
+        for (int i = 0; i < deque->count; i++)
+            items[i] = deque->items[(deque->top + i) % deque->capacity];
+        free(deque->items);
+        deque->items = items;
+        deque->top = 0;
+        deque->capacity = capacity;
+    }
+    deque->items[(deque->top + deque->count) % deque->capacity] = task;
+    deque->count++;
+    pthread_mutex_unlock(&deque->lock);
+}
+
+/** Takes the newest task, which the owner pushed last and is most likely still in cache. */
+static Task* deque_pop(TaskDeque* deque)
+{
+    Task* task = NULL;
+    pthread_mutex_lock(&deque->lock);
+    if (deque->count > 0)
+    {
+        deque->count--;
+        task = deque->items[(deque->top + deque->count) % deque->capacity];
+    }
+    pthread_mutex_unlock(&deque->lock);
+    return task;
+}
+
+/** Takes the oldest task, usually the root of the largest piece of remaining work. */
+static Task* deque_steal(TaskDeque* deque)
+{
+    /* Unlocked peek, so idle threads scanning for work skip empty deques cheaply. */
+    if (__atomic_load_n(&deque->count, __ATOMIC_RELAXED) == 0)
+        return NULL;
+
+    Task* task = NULL;
+    pthread_mutex_lock(&deque->lock);
+    if (deque->count > 0)
+    {
+        task = deque->items[deque->top];
+        deque->top = (deque->top + 1) % deque->capacity;
+        deque->count--;
+    }
+    pthread_mutex_unlock(&deque->lock);
+    return task;
+}
+
+/**
+ * Finds work for a thread: its own deque first, then the other workers'.
+ * @param self The calling worker, or -1 for a thread outside the pool.
+ */
+static Task* find_task(int self)
+{
+    Task* task = NULL;
+    if (self >= 0)
+        task = deque_pop(&workers[self].deque);
+
+    int start = self >= 0 ? self + 1 : (int)(atomic_load(&next_deque) % worker_count);
+    for (int i = 0; i < worker_count && task == NULL; i++)
+    {
+        int victim = (start + i) % worker_count;
+        if (victim != self)
+            task = deque_steal(&workers[victim].deque);
+    }
+
+    if (task)
+        atomic_fetch_sub(&queued_count, 1);
+    return task;
+}
+
+/* ---- Running ---- */
+
+static void task_run(Task* task)
+{
+    atomic_store(&task->state, TASK_RUNNING);
+
+    /* A throw inside the task must not unwind into whatever try block the
+       thread that picked it up happens to be in: it is kept on the task
+       and thrown again by whoever joins it. */
+    ExceptionState saved = global_ex_state;
+    Func* saved_func = current_executing_func;
+    Env* saved_frame = frame_top();
+    bool failed = false;
+
+    Value volatile result = NIL_VAL;
+    global_ex_state.active = 1;
+    if (setjmp(global_ex_state.buf) == 0)
+    {
+        if (task->work)
+            task->work(task->ctx, task->chunk);
+        else
+            result = call_function(AS_FUNCTION(task->func)->env, AS_FUNCTION(task->func), task->arg_count, task->args);
+    }
+    else
+    {
+        frame_unwind(saved_frame);
+        result = global_ex_state.error_val;
+        failed = true;
+    }
+
+    current_executing_func = saved_func;
+    global_ex_state = saved;
+
+    pthread_mutex_lock(&task->lock);
+    task->result = result;
+    task->failed = failed;
+    atomic_store(&task->state, TASK_DONE);
+    pthread_cond_broadcast(&task->done);
+    pthread_mutex_unlock(&task->lock);
+
+    gc_thread_end();
+}
+
+static void* worker_main(void* arg)
+{
+    Worker* worker = arg;
+    worker_index = worker->index;
+
+    for (;;)
+    {
+        Task* task = find_task(worker_index);
+        if (task)
+        {
+            task_run(task);
+            continue;
+        }
+
+        pthread_mutex_lock(&idle_lock);
+        while (atomic_load(&queued_count) == 0)
+            pthread_cond_wait(&idle_cond, &idle_lock);
+        pthread_mutex_unlock(&idle_lock);
+    }
+    return NULL;
+}
+
+static void pool_start(void)
+{
+    const char* configured = getenv("JACKAL_THREADS");
+    long count = configured ? strtol(configured, NULL, 10) : sysconf(_SC_NPROCESSORS_ONLN);
+    if (count < 1)
+        count = 1;
+
+    worker_count = (int)count;
+    workers = calloc(worker_count, sizeof(Worker));
+    for (int i = 0; i < worker_count; i++)
+    {
+        workers[i].index = i;
+        pthread_mutex_init(&workers[i].deque.lock, NULL);
+    }
+    for (int i = 0; i < worker_count; i++)
+    {
+        pthread_create(&workers[i].thread, NULL, worker_main, &workers[i]);
+        pthread_detach(workers[i].thread);
+    }
+}
+
+int task_pool_size(void)
+{
+    pthread_once(&pool_once, pool_start);
+    return worker_count;
+}
+
+static Task* task_new(void)
+{
+    task_pool_size();
+
+    /* Counted before anything is allocated, so no collection can run
+       between here and the end of the task. */
+    gc_thread_begin();
+
+    Task* task = gc_allocate(sizeof(Task), GC_TASK);
+    atomic_init(&task->state, TASK_QUEUED);
+    pthread_mutex_init(&task->lock, NULL);
+    pthread_cond_init(&task->done, NULL);
+    return task;
+}
+
+static void task_submit(Task* task)
+{
+    /* Tasks spawned by a task stay with its worker until someone steals
+       them; the rest are spread over the workers. */
+    int target = worker_index >= 0 ? worker_index : (int)(atomic_fetch_add(&next_deque, 1) % worker_count);
+    deque_push(&workers[target].deque, task);
+
+    atomic_fetch_add(&queued_count, 1);
+    pthread_mutex_lock(&idle_lock);
+    pthread_cond_signal(&idle_cond);
+    pthread_mutex_unlock(&idle_lock);
+}
+
+Value task_spawn(Value func, int arg_count, Value* args)
+{
+    Task* task = task_new();
+    task->func = copy_value(func);
+    task->arg_count = arg_count;
+    task->args = arg_count > 0 ? malloc(sizeof(Value) * arg_count) : NULL;
+    for (int i = 0; i < arg_count; i++)
+        task->args[i] = copy_value(args[i]);
+    task_submit(task);
+    return TASK_VAL(task);
+}
+
+static void task_wait(Task* task)
+{
+    while (atomic_load(&task->state) != TASK_DONE)
+    {
+        Task* other = find_task(worker_index);
+        if (other)
+        {
+            task_run(other);
+            continue;
+        }
+
+        /* Nothing to help with: sleep until the task finishes, but wake up
+           now and then in case its runner queues work only we can pick up. */
+        struct timespec deadline;
+        clock_gettime(CLOCK_REALTIME, &deadline);
+        deadline.tv_nsec += 1000000;
+        if (deadline.tv_nsec >= 1000000000)
+        {
+            deadline.tv_sec++;
+            deadline.tv_nsec -= 1000000000;
+        }
+        pthread_mutex_lock(&task->lock);
+        if (atomic_load(&task->state) != TASK_DONE)
+            pthread_cond_timedwait(&task->done, &task->lock, &deadline);
+        pthread_mutex_unlock(&task->lock);
+    }
+}
+
+Value task_join(Task* task)
+{
+    task_wait(task);
+    if (task->failed)
+        throw_value(copy_value(task->result));
+    return copy_value(task->result);
+}
+
+void task_parallel_for(int chunks, TaskWork work, void* ctx)
+{
+    if (chunks <= 1)
+    {
+        if (chunks == 1)
+            work(ctx, 0);
+        return;
+    }
+
+    /* The tasks are only reachable from this malloc'd array, which is fine:
+       nothing is collected until the last of them finishes. */
+    Task** tasks = malloc(sizeof(Task*) * chunks);
+    for (int i = 0; i < chunks; i++)
+    {
+        tasks[i] = task_new();
+        tasks[i]->work = work;
+        tasks[i]->ctx = ctx;
+        tasks[i]->chunk = i;
+    }
+    for (int i = 1; i < chunks; i++)
+        task_submit(tasks[i]);
+
+    task_run(tasks[0]);
+    for (int i = 1; i < chunks; i++)
+        task_wait(tasks[i]);
+
+    Task* failed = NULL;
+    for (int i = 0; i < chunks && failed == NULL; i++)
+        if (tasks[i]->failed)
+            failed = tasks[i];
+    free(tasks);
+    if (failed)
+        throw_value(copy_value(failed->result));
+}
+
+void task_post(TaskWork work, void* ctx)
+{
+    Task* task = task_new();
+    task->work = work;
+    task->ctx = ctx;
+    task_submit(task);
+}
+
+void task_finalize(Task* task)
+{
+    free(task->args);
+    pthread_mutex_destroy(&task->lock);
+    pthread_cond_destroy(&task->done);
+}
+
+/* ---- Methods ---- */
+
+static Value task_method_join(Env* env, Value receiver, int arg_count, Value* args)
+{
+    return task_join(AS_TASK(receiver));
+}
+
+static Value task_method_is_done(Env* env, Value receiver, int arg_count, Value* args)
+{
+    return BOOL_VAL(atomic_load(&AS_TASK(receiver)->state) == TASK_DONE);
+}
+
+void register_task_natives(struct Env* env)
+{
+    register_method(VAL_TASK, "join", task_method_join);
+    register_method(VAL_TASK, "isDone", task_method_is_done);
+}
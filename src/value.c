@@ -7,6 +7,10 @@
 #include "parser.h"
 #include "eval.h"
 #include "env.h"
+#include "gc.h"
+#include "string_object.h"
+#include "csv/csv_reader.h"
+#include "csv/dataframe.h"
 
 /**
  * @include collections dsa
@@ -51,17 +55,12 @@ typedef struct
  */
 ValueArray *array_new(void)
 {
-    ValueArray *arr = jackal_allocate_gc(sizeof(ValueArray));
+    ValueArray *arr = gc_allocate(sizeof(ValueArray), GC_ARRAY);
     arr->capacity = 8;
     arr->count = 0;
     arr->values = malloc(sizeof(Value) * arr->capacity);
     arr->element_type[0] = '\0';
 
-    for (int i = 0; i < arr->capacity; i++)
-    {
-        arr->values[i].gc_info = NULL;
-    }
-
     return arr;
 }
 
@@ -72,7 +71,7 @@ ValueArray *get_minor(ValueArray *matrix, int col_to_remove)
 
     for (int i = 1; i < n; i++)
     {
-        ValueArray *row = matrix->values[i].as.array;
+        ValueArray *row = AS_ARRAY(matrix->values[i]);
         ValueArray *new_row = array_new();
         for (int j = 0; j < n; j++)
         {
@@ -80,7 +79,7 @@ ValueArray *get_minor(ValueArray *matrix, int col_to_remove)
                 continue;
             array_append(new_row, row->values[j]);
         }
-        array_append(minor, (Value){VAL_ARRAY, {.array = new_row}});
+        array_append(minor, ARRAY_VAL(new_row));
     }
     return minor;
 }
@@ -96,7 +95,7 @@ void array_append(ValueArray *arr, Value val)
         const char *val_type = get_value_type_name(val);
         if (strcmp(arr->element_type, "int") == 0 || strcmp(arr->element_type, "number") == 0)
         {
-            if (val.type != VAL_NUMBER)
+            if (VALUE_TYPE(val) != VAL_NUMBER)
             {
                 print_error("Type Mismatch: Array<%s> cannot accept %s", arr->element_type, val_type);
                 return;
@@ -144,24 +143,24 @@ void array_free(ValueArray *arr)
 char* value_to_string(Value value) {
     char buffer[1024]; 
 
-    switch (value.type) {
+    switch (VALUE_TYPE(value)) {
         case VAL_NIL:
             return strdup("nil");
 
         case VAL_NUMBER:
       
             if (is_integer_value(value)) {
-                snprintf(buffer, sizeof(buffer), "%lld", (long long)value.as.number);
+                snprintf(buffer, sizeof(buffer), "%lld", (long long)AS_NUMBER(value));
             } else {
-                snprintf(buffer, sizeof(buffer), "%g", value.as.number);
+                snprintf(buffer, sizeof(buffer), "%g", AS_NUMBER(value));
             }
             return strdup(buffer);
 
         case VAL_BOOL:
-            return strdup(value.as.boolean ? "true" : "false");
+            return strdup(AS_BOOL(value) ? "true" : "false");
 
         case VAL_STRING:
-            return strdup(value.as.string);
+            return strdup(AS_STRING(value));
 
         case VAL_ARRAY:
             return strdup("[Array]");
@@ -170,11 +169,11 @@ char* value_to_string(Value value) {
             return strdup("[Map]");
 
         case VAL_CLASS:
-            snprintf(buffer, sizeof(buffer), "<class %s>", value.as.class_obj->name);
+            snprintf(buffer, sizeof(buffer), "<class %s>", AS_CLASS(value)->name);
             return strdup(buffer);
 
         case VAL_INSTANCE:
-            snprintf(buffer, sizeof(buffer), "<%s instance>", value.as.instance->class_val->as.class_obj->name);
+            snprintf(buffer, sizeof(buffer), "<%s instance>", AS_CLASS(*AS_INSTANCE(value)->class_val)->name);
             return strdup(buffer);
 
         case VAL_NATIVE:
@@ -194,15 +193,15 @@ char* value_to_string(Value value) {
  */
 void print_value(Value value)
 {
-    switch (value.type)
+    switch (VALUE_TYPE(value))
     {
 
     case VAL_BOOL:
-        printf(value.as.boolean ? "true" : "false");
+        printf(AS_BOOL(value) ? "true" : "false");
         break;
 
     case VAL_BYTE:
-        printf("0x%02X", value.as.byte);
+        printf("0x%02X", AS_BYTE(value));
         break;
 
     case VAL_NATIVE:
@@ -214,7 +213,7 @@ void print_value(Value value)
         break;
     case VAL_NUMBER:
     {
-        double n = value.as.number;
+        double n = AS_NUMBER(value);
         if (n == (long long)n)
         {
             printf("%lld", (long long)n);
@@ -226,20 +225,20 @@ void print_value(Value value)
     }
     break;
     case VAL_STRING:
-        printf("%s", value.as.string);
+        printf("%s", AS_STRING(value));
         break;
     case VAL_FUNCTION:
         printf("<function>");
         break;
     case VAL_RETURN:
-        print_value(*value.as.return_val);
+        print_value(*AS_RETURN(value));
         break;
     case VAL_ARRAY:
  
-        for (int i = 0; i < value.as.array->count; i++)
+        for (int i = 0; i < AS_ARRAY(value)->count; i++)
         {
-            print_value(value.as.array->values[i]);
-            if (i < value.as.array->count - 1)
+            print_value(AS_ARRAY(value)->values[i]);
+            if (i < AS_ARRAY(value)->count - 1)
             {
                 printf(","); 
             }
@@ -247,12 +246,12 @@ void print_value(Value value)
     
         break;
     case VAL_INTERFACE:
-        printf("<interface %s>", value.as.interface_obj->name);
+        printf("<interface %s>", AS_INTERFACE(value)->name);
         break;
     case VAL_CLASS:
-        if (value.as.class_obj)
+        if (AS_CLASS(value))
         {
-            printf("<class %s>", value.as.class_obj->name);
+            printf("<class %s>", AS_CLASS(value)->name);
         }
         else
         {
@@ -260,9 +259,9 @@ void print_value(Value value)
         }
         break;
     case VAL_INSTANCE:
-        if (value.as.instance && value.as.instance->class_val)
+        if (AS_INSTANCE(value) && AS_INSTANCE(value)->class_val)
         {
-            printf("<instance %s>", value.as.instance->class_val->as.class_obj->name);
+            printf("<instance %s>", AS_CLASS(*AS_INSTANCE(value)->class_val)->name);
         }
         else
         {
@@ -270,7 +269,7 @@ void print_value(Value value)
         }
         break;
     case VAL_FILE:
-        if (value.as.file)
+        if (AS_FILE(value))
         {
             printf("<file>");
         }
@@ -280,10 +279,25 @@ void print_value(Value value)
         }
         break;
     case VAL_LINKEDLIST:
-        printf("<linkedlist size %d>", value.as.list->count);
+        printf("<linkedlist size %d>", AS_LINKEDLIST(value)->count);
         break;
     case VAL_ENUM:
-        printf("<enum %s>", value.as.enum_obj->name);
+        printf("<enum %s>", AS_ENUM(value)->name);
+        break;
+    case VAL_TASK:
+        printf("<task>");
+        break;
+    case VAL_PROMISE:
+        printf("<promise>");
+        break;
+    case VAL_DATAFRAME:
+        printf("<dataframe %zu rows x %d columns>", AS_DATAFRAME(value)->rows, AS_DATAFRAME(value)->column_count);
+        break;
+    case VAL_CSV_CURSOR:
+        printf("<csv cursor>");
+        break;
+    case VAL_CSV_WRITER:
+        printf("<csv writer>");
         break;
     }
 }
@@ -294,21 +308,16 @@ void print_value(Value value)
  */
 void free_value(Value value)
 {
-    if (value.gc_info != NULL)
-    {
-        return;
-    }
-
-    switch (value.type)
+    switch (VALUE_TYPE(value))
     {
     case VAL_STRING:
         break;
     case VAL_FUNCTION:
-        free(value.as.function);
+        gc_free(AS_FUNCTION(value));
         break;
     case VAL_RETURN:
-        free_value(*value.as.return_val);
-        free(value.as.return_val);
+        free_value(*AS_RETURN(value));
+        gc_free(AS_RETURN(value));
         break;
     case VAL_ARRAY:
         break;
@@ -333,15 +342,16 @@ void free_value(Value value)
 
 Value copy_value(Value value)
 {
-    switch (value.type)
+    switch (VALUE_TYPE(value))
     {
     case VAL_STRING:
-        return (Value){VAL_STRING, {.string = strdup(value.as.string)}};
+        /* Strings are immutable and managed, so copies share them. */
+        return value;
     case VAL_FUNCTION:
     {
-        Func *new_func = malloc(sizeof(Func));
-        memcpy(new_func, value.as.function, sizeof(Func));
-        return (Value){VAL_FUNCTION, {.function = new_func}};
+        Func *new_func = gc_allocate(sizeof(Func), GC_FUNCTION);
+        memcpy(new_func, AS_FUNCTION(value), sizeof(Func));
+        return FUNCTION_VAL(new_func);
     }
     case VAL_ARRAY:
         return value;
@@ -372,27 +382,27 @@ Value copy_value(Value value)
  */
 bool is_value_truthy(Value value)
 {
-    switch (value.type)
+    switch (VALUE_TYPE(value))
     {
 
     case VAL_BYTE:
-        return value.as.byte != 0;
+        return AS_BYTE(value) != 0;
     case VAL_BOOL:
-        return value.as.boolean;
+        return AS_BOOL(value);
     case VAL_NIL:
         return false;
     case VAL_NUMBER:
-        return value.as.number != 0;
+        return AS_NUMBER(value) != 0;
     case VAL_STRING:
-        return strlen(value.as.string) > 0;
+        return AS_STRING(value)[0] != '\0';
     case VAL_FUNCTION:
         return true;
     case VAL_ARRAY:
-        return value.as.array->count > 0;
+        return AS_ARRAY(value)->count > 0;
     case VAL_MAP:
-        return value.as.map && value.as.map->count > 0;
+        return AS_MAP(value) && AS_MAP(value)->count > 0;
     case VAL_FILE:
-        return value.as.file != NULL;
+        return AS_FILE(value) != NULL;
     case VAL_CLASS:
         return true;
     case VAL_NATIVE:
@@ -409,9 +419,15 @@ bool is_value_truthy(Value value)
     case VAL_ENUM:
         return true;
     case VAL_LINKEDLIST:
-        return value.as.list->count > 0;
+        return AS_LINKEDLIST(value)->count > 0;
     case VAL_RETURN:
-        return is_value_truthy(*value.as.return_val);
+        return is_value_truthy(*AS_RETURN(value));
+    case VAL_TASK:
+    case VAL_PROMISE:
+    case VAL_DATAFRAME:
+    case VAL_CSV_CURSOR:
+    case VAL_CSV_WRITER:
+        return true;
     default : 
      return false;
     }
@@ -427,58 +443,58 @@ bool is_value_truthy(Value value)
 Value eval_equals(Value a, Value b)
 {
     double result = 0.0;
-    if (a.type != b.type)
+    if (VALUE_TYPE(a) != VALUE_TYPE(b))
     {
         result = 0.0;
     }
     else
     {
         bool res = false;
-        switch (a.type)
+        switch (VALUE_TYPE(a))
         {
 
         case VAL_NIL:
             result = 1.0;
             break;
         case VAL_BYTE:
-            res = (a.as.byte == b.as.byte);
+            res = (AS_BYTE(a) == AS_BYTE(b));
             break;
         case VAL_FILE:
-            return (Value){VAL_NUMBER, {.number = (a.as.file == b.as.file)}};
+            return NUMBER_VAL((AS_FILE(a) == AS_FILE(b)));
         case VAL_NUMBER:
-            result = (a.as.number == b.as.number);
+            result = (AS_NUMBER(a) == AS_NUMBER(b));
             break;
         case VAL_STRING:
-            result = (strcmp(a.as.string, b.as.string) == 0);
+            result = string_equals(a, b);
             break;
         case VAL_FUNCTION:
-            result = (a.as.function == b.as.function);
+            result = (AS_FUNCTION(a) == AS_FUNCTION(b));
             break;
         case VAL_ARRAY:
-            result = (a.as.array == b.as.array);
+            result = (AS_ARRAY(a) == AS_ARRAY(b));
             break;
         case VAL_CLASS:
-            result = (a.as.class_obj == b.as.class_obj);
+            result = (AS_CLASS(a) == AS_CLASS(b));
             break;
         case VAL_INSTANCE:
-            result = (a.as.instance == b.as.instance);
+            result = (AS_INSTANCE(a) == AS_INSTANCE(b));
             break;
         case VAL_INTERFACE:
-            return (Value){VAL_NUMBER, {.number = (a.as.interface_obj == b.as.interface_obj)}};
+            return NUMBER_VAL((AS_INTERFACE(a) == AS_INTERFACE(b)));
         case VAL_ENUM:
-            return (Value){VAL_NUMBER, {.number = (a.as.enum_obj == b.as.enum_obj)}};
+            return NUMBER_VAL((AS_ENUM(a) == AS_ENUM(b)));
         case VAL_BREAK:
-            return (Value){VAL_NUMBER, {.number = 0.0}};
+            return NUMBER_VAL(0.0);
         case VAL_CONTINUE:
-            return (Value){VAL_NUMBER, {.number = 0.0}};
+            return NUMBER_VAL(0.0);
         case VAL_LINKEDLIST:
-            return (Value){VAL_NUMBER, {.number = (a.as.list == b.as.list)}};
+            return NUMBER_VAL((AS_LINKEDLIST(a) == AS_LINKEDLIST(b)));
         default:
             result = 0.0;
             break;
         }
     }
-    return (Value){VAL_NUMBER, {.number = result}};
+    return NUMBER_VAL(result);
 }
 
 Value builtin_writeline(int argCount, Value *args)
@@ -493,7 +509,7 @@ Value builtin_writeline(int argCount, Value *args)
     }
     printf("\n");
     fflush(stdout);
-    return (Value){VAL_NIL, {0}};
+    return NIL_VAL;
 }
 
 Value builtin_write(int argCount, Value *args)
@@ -507,7 +523,7 @@ Value builtin_write(int argCount, Value *args)
         }
     }
     fflush(stdout);
-    return (Value){VAL_NIL, {0}};
+    return NIL_VAL;
 }
 /**
  * Reads a line from standard input and returns it as a Value of type VAL_STRING.
@@ -530,11 +546,9 @@ Value builtin_read(int arity, Value *args)
             buffer[len - 1] = '\0';
         }
 
-        char *str_copy = malloc(strlen(buffer) + 1);
-        strcpy(str_copy, buffer);
-        return (Value){VAL_STRING, {.string = str_copy}};
+        return string_copy(buffer);
     }
-    return (Value){VAL_NIL, .as = {0}};
+    return NIL_VAL;
 }
 
 /**
@@ -567,33 +581,18 @@ Value array_pop(ValueArray *arr)
 {
     if (arr->count == 0)
     {
-        return (Value){VAL_NIL, {0}};
+        return NIL_VAL;
     }
     return arr->values[--arr->count];
 }
 
-/**
- * @brief Hashes a string using the FNV-1a algorithm.
- * @param key The string to be hashed.
- * @return The resulting hash value.
- */
-static uint32_t hash_string(const char *key)
-{
-    uint32_t hash = 2166136261u;
-    for (int i = 0; key[i] != '\0'; i++)
-    {
-        hash ^= (uint8_t)key[i];
-        hash *= 16777619;
-    }
-    return hash;
-}
 /**
  * Creates a new HashMap.
  * @return Pointer to the newly created HashMap.
  */
 HashMap *map_new(void)
 {
-    HashMap *map = malloc(sizeof(HashMap));
+    HashMap *map = gc_allocate(sizeof(HashMap), GC_MAP);
     map->count = 0;
     map->capacity = 0;
     map->entries = NULL;
@@ -602,34 +601,30 @@ HashMap *map_new(void)
 
 
 /**
- * Frees the memory associated with a HashMap.
+ * Empties a HashMap. The map itself is reclaimed by the collector once
+ * nothing refers to it.
  * @param map The HashMap to be freed.
  */
 void map_free(HashMap *map)
 {
     if (!map)
         return;
-    for (int i = 0; i < map->capacity; i++)
-    {
-        if (map->entries[i].key != NULL)
-        {
-            free(map->entries[i].key);
-        }
-    }
     free(map->entries);
-    free(map);
+    map->entries = NULL;
+    map->count = 0;
+    map->capacity = 0;
 }
 
 bool map_delete(HashMap *map, const char *key) {
     if (map->count == 0) return false;
 
-    Entry *entry = find_entry(map->entries, map->capacity, key);
+    size_t length = strlen(key);
+    Entry *entry = find_entry(map->entries, map->capacity, key, length, string_hash(key, length), false);
     if (entry->key == NULL) return false;
 
-    free(entry->key);
     entry->key = NULL;
     
-    entry->value = (Value){VAL_BOOL, {.boolean = true}};
+    entry->value = BOOL_VAL(true);
 
     map->count--;
     return true;
@@ -637,26 +632,38 @@ bool map_delete(HashMap *map, const char *key) {
 
 /**
  * @brief Finds an entry in the HashMap by key.
+ * Keys are interned, so an interned lookup key only has to be compared by
+ * pointer; any other key is compared by cached hash and length first.
  * @param entries The array of entries in the HashMap.
- * @param capacity The capacity of the HashMap.
+ * @param capacity The capacity of the HashMap, a power of two.
  * @param key The key to search for.
+ * @param length Length of the key.
+ * @param hash string_hash of the key.
+ * @param interned Whether key is the chars of an interned string.
  */
-static Entry *find_entry(Entry *entries, int capacity, const char *key)
+static Entry *find_entry(Entry *entries, int capacity, const char *key, size_t length, uint32_t hash, bool interned)
 {
-    uint32_t index = hash_string(key) % capacity;
+    uint32_t index = hash & (capacity - 1);
     for (;;)
     {
         Entry *entry = &entries[index];
         if (entry->key == NULL)
         {
-            if (entry->value.type == VAL_NIL)
+            if (VALUE_TYPE(entry->value) == VAL_NIL)
                 return entry; 
         }
-        else if (strcmp(entry->key, key) == 0)
+        else if (entry->key == key)
         {
             return entry; // Key found
         }
-        index = (index + 1) % capacity;
+        else if (!interned)
+        {
+            ObjString *entry_key = STRING_OBJECT(entry->key);
+            if (entry_key->hash == hash && entry_key->length == length &&
+                memcmp(entry->key, key, length) == 0)
+                return entry;
+        }
+        index = (index + 1) & (capacity - 1);
     }
 }
 
@@ -674,7 +681,8 @@ static void map_adjust_capacity(HashMap *map, int capacity)
         Entry *entry = &map->entries[i];
         if (entry->key == NULL)
             continue;
-        Entry *dest = find_entry(entries, capacity, entry->key);
+        ObjString *key = STRING_OBJECT(entry->key);
+        Entry *dest = find_entry(entries, capacity, key->chars, key->length, key->hash, true);
         dest->key = entry->key;
         dest->value = entry->value;
         map->count++;
@@ -685,16 +693,36 @@ static void map_adjust_capacity(HashMap *map, int capacity)
 }
 
 /**
- * Sets a key-value pair in the HashMap.
- * @param map The HashMap to set the key-value pair in.
- * @param key The key as a string.
- * @param value The Value to associate with the key.
+ * Gets the Value stored under a key.
+ * @param map The HashMap to search.
+ * @param key The key as a C string.
+ * @param out_val Receives the Value if the key is present.
+ * @return true if the key is present.
  */
 bool map_get(HashMap *map, const char *key, Value *out_val)
 {
     if (map->count == 0)
         return false;
-    Entry *entry = find_entry(map->entries, map->capacity, key);
+    size_t length = strlen(key);
+    Entry *entry = find_entry(map->entries, map->capacity, key, length, string_hash(key, length), false);
+    if (entry->key == NULL)
+        return false;
+    *out_val = entry->value;
+    return true;
+}
+
+/**
+ * Gets the Value stored under a managed string key, using its cached hash.
+ * @param map The HashMap to search.
+ * @param key The key.
+ * @param out_val Receives the Value if the key is present.
+ * @return true if the key is present.
+ */
+bool map_get_string(HashMap *map, ObjString *key, Value *out_val)
+{
+    if (map->count == 0)
+        return false;
+    Entry *entry = find_entry(map->entries, map->capacity, key->chars, key->length, key->hash, key->is_interned);
     if (entry->key == NULL)
         return false;
     *out_val = entry->value;
@@ -707,22 +735,37 @@ bool map_get(HashMap *map, const char *key, Value *out_val)
  * @param key The key of the Value to set.
  * @param val The Value to set.
  */
-
 void map_set(HashMap *map, const char *key, Value val)
 {
+    map_set_string(map, string_intern(key, strlen(key)), val);
+}
+
+/**
+ * Sets a key-value pair in the HashMap under a managed string key,
+ * interning the key first if it is not interned yet.
+ * @param map The HashMap to set the value in.
+ * @param key The key of the Value to set.
+ * @param val The Value to set.
+ */
+void map_set_string(HashMap *map, ObjString *key, Value val)
+{
+    if (!key->is_interned)
+        key = string_intern(key->chars, key->length);
+
+    Value copy = copy_value(val);
     if (map->count + 1 > map->capacity * 0.75)
     {
         int capacity = map->capacity < 8 ? 8 : map->capacity * 2;
         map_adjust_capacity(map, capacity);
     }
-    Entry *entry = find_entry(map->entries, map->capacity, key);
+    Entry *entry = find_entry(map->entries, map->capacity, key->chars, key->length, key->hash, true);
     bool is_new_key = (entry->key == NULL);
     if (is_new_key)
     {
         map->count++;
-        entry->key = strdup(key);
+        entry->key = key->chars;
     }
-    entry->value = copy_value(val);
+    entry->value = copy;
 }
 
 Value builtin_read_line(int arity, Value *args)
@@ -731,14 +774,14 @@ Value builtin_read_line(int arity, Value *args)
     {
         print_error("Error: '__io_read' expects zero arguments.");
 
-        return (Value){VAL_NIL, .as = {0}};
+        return NIL_VAL;
     }
 
     char buffer[1024];
 
     if (fgets(buffer, sizeof(buffer), stdin) == NULL)
     {
-        return (Value){VAL_NIL, .as = {0}};
+        return NIL_VAL;
     }
 
     size_t len = strlen(buffer);
@@ -747,16 +790,7 @@ Value builtin_read_line(int arity, Value *args)
         buffer[len - 1] = '\0';
     }
 
-    char *str_copy = malloc(strlen(buffer) + 1);
-
-    if (str_copy == NULL)
-    {
-        return (Value){VAL_NIL, .as = {0}};
-    }
-
-    strcpy(str_copy, buffer);
-
-    return (Value){VAL_STRING, {.string = str_copy}};
+    return string_copy(buffer);
 }
 
 Value builtin_read_array(int arity, Value *args)
@@ -764,21 +798,21 @@ Value builtin_read_array(int arity, Value *args)
     if (arity != 1)
     {
         print_error("Error: '__io_read_array' expects one argument (delimiter).");
-        return (Value){VAL_NIL, .as = {0}};
+        return NIL_VAL;
     }
 
-    if (args[0].type != VAL_STRING)
+    if (VALUE_TYPE(args[0]) != VAL_STRING)
     {
         print_error("Error: Delimiter must be a String.");
-        return (Value){VAL_NIL, .as = {0}};
+        return NIL_VAL;
     }
 
-    const char *delimiter = args[0].as.string;
+    const char *delimiter = AS_STRING(args[0]);
 
     char buffer[1024];
     if (fgets(buffer, sizeof(buffer), stdin) == NULL)
     {
-        return (Value){VAL_ARRAY, .as.array = array_new()};
+        return ARRAY_VAL(array_new());
     }
 
     size_t len = strlen(buffer);
@@ -790,7 +824,7 @@ Value builtin_read_array(int arity, Value *args)
     char *input_copy = strdup(buffer);
     if (input_copy == NULL)
     {
-        return (Value){VAL_ARRAY, .as.array = array_new()};
+        return ARRAY_VAL(array_new());
     }
 
     ValueArray *result_array = array_new();
@@ -804,20 +838,13 @@ Value builtin_read_array(int arity, Value *args)
             token++;
         }
 
-        char *token_copy = malloc(strlen(token) + 1);
-        if (token_copy != NULL)
-        {
-            strcpy(token_copy, token);
-            Value token_val = (Value){VAL_STRING, {.string = token_copy}};
-
-            array_append(result_array, token_val);
-        }
+        array_append(result_array, string_copy(token));
 
         token = strtok(NULL, delimiter);
     }
 
     free(input_copy);
-    return (Value){VAL_ARRAY, .as.array = result_array};
+    return ARRAY_VAL(result_array);
 }
 
 Value builtin_print_table(int argCount, Value *args)
@@ -825,18 +852,18 @@ Value builtin_print_table(int argCount, Value *args)
     if (argCount != 1)
     {
         print_error("print_table() requires exactly one argument (Array).");
-        return (Value){VAL_NIL, {0}};
+        return NIL_VAL;
     }
 
     Value arg = args[0];
 
-    if (arg.type != VAL_ARRAY)
+    if (VALUE_TYPE(arg) != VAL_ARRAY)
     {
         print_error("print_table() only supports Array type.");
-        return (Value){VAL_NIL, {0}};
+        return NIL_VAL;
     }
 
-    ValueArray *arr = arg.as.array;
+    ValueArray *arr = AS_ARRAY(arg);
 
     printf("\n+-------+-----------------------------+\n");
     printf("| Index | Value                       |\n");
@@ -861,7 +888,7 @@ Value builtin_print_table(int argCount, Value *args)
     printf("+-------+-----------------------------+\n");
     fflush(stdout);
 
-    return (Value){VAL_NIL, {0}};
+    return NIL_VAL;
 }
 
 
@@ -914,33 +941,33 @@ Value builtin_map_forEach(int argCount, Value *args)
     if (argCount != 2)
     {
         print_error("MapStream.forEach() requires 2 arguments: map and callback.");
-        return (Value){VAL_NIL, {0}};
+        return NIL_VAL;
     }
 
     Value map_val = args[0];
     Value callback_val = args[1];
 
-    if (map_val.type != VAL_MAP)
+    if (VALUE_TYPE(map_val) != VAL_MAP)
     {
         print_error("First argument to MapStream::Flush must be a Map.");
-        return (Value){VAL_NIL, {0}};
+        return NIL_VAL;
     }
 
-    if (callback_val.type != VAL_FUNCTION)
+    if (VALUE_TYPE(callback_val) != VAL_FUNCTION)
     {
         print_error("Second argument to MapStream.forEach() must be a Function.");
-        return (Value){VAL_NIL, {0}};
+        return NIL_VAL;
     }
 
-    Func *func = callback_val.as.function;
+    Func *func = AS_FUNCTION(callback_val);
 
     if (func->arity != 2)
     {
         print_error("Callback in MapStream.forEach() must accept 2 arguments (key, value).");
-        return (Value){VAL_NIL, {0}};
+        return NIL_VAL;
     }
 
-    HashMap *map = map_val.as.map;
+    HashMap *map = AS_MAP(map_val);
 
     for (int i = 0; i < map->capacity; i++)
     {
@@ -949,10 +976,9 @@ Value builtin_map_forEach(int argCount, Value *args)
         if (entry->key != NULL)
         {
 
-            Env *call_env = env_new(func->env);
+            Env *call_env = env_push(func->env, func->body_head);
 
-            char *key_copy = strdup(entry->key);
-            Value key_val = (Value){VAL_STRING, {.string = key_copy}};
+            Value key_val = string_value(STRING_OBJECT(entry->key));
 
             Value value_copy = copy_value(entry->value);
 
@@ -970,7 +996,7 @@ Value builtin_map_forEach(int argCount, Value *args)
 
             env_free(call_env);
 
-            if (result.type == VAL_RETURN || result.type == VAL_BREAK || result.type == VAL_CONTINUE)
+            if (VALUE_TYPE(result) == VAL_RETURN || VALUE_TYPE(result) == VAL_BREAK || VALUE_TYPE(result) == VAL_CONTINUE)
             {
                 free_value(result);
             }
@@ -981,7 +1007,7 @@ Value builtin_map_forEach(int argCount, Value *args)
         }
     }
 
-    return (Value){VAL_NIL, {0}};
+    return NIL_VAL;
 }
 
 Value builtin_map_keys(int argCount, Value *args)
@@ -989,18 +1015,18 @@ Value builtin_map_keys(int argCount, Value *args)
     if (argCount != 1)
     {
         print_error("MapStream.keys() requires exactly one argument (Map).");
-        return (Value){VAL_NIL, {0}};
+        return NIL_VAL;
     }
 
     Value map_val = args[0];
 
-    if (map_val.type != VAL_MAP)
+    if (VALUE_TYPE(map_val) != VAL_MAP)
     {
         print_error("Argument to MapStream.keys() must be a Map.");
-        return (Value){VAL_NIL, {0}};
+        return NIL_VAL;
     }
 
-    HashMap *map = map_val.as.map;
+    HashMap *map = AS_MAP(map_val);
     ValueArray *keys_array = array_new();
 
     for (int i = 0; i < map->capacity; i++)
@@ -1009,14 +1035,11 @@ Value builtin_map_keys(int argCount, Value *args)
 
         if (entry->key != NULL)
         {
-            char *key_copy = strdup(entry->key);
-            Value key_val = (Value){VAL_STRING, {.string = key_copy}};
-
-            array_append(keys_array, key_val);
+            array_append(keys_array, string_value(STRING_OBJECT(entry->key)));
         }
     }
 
-    return (Value){VAL_ARRAY, {.array = keys_array}};
+    return ARRAY_VAL(keys_array);
 }
 
 Value builtin_map_values(int argCount, Value *args)
@@ -1024,18 +1047,18 @@ Value builtin_map_values(int argCount, Value *args)
     if (argCount != 1)
     {
         print_error("MapStream.values() requires exactly one argument (Map).");
-        return (Value){VAL_NIL, {0}};
+        return NIL_VAL;
     }
 
     Value map_val = args[0];
 
-    if (map_val.type != VAL_MAP)
+    if (VALUE_TYPE(map_val) != VAL_MAP)
     {
         print_error("Argument to MapStream.values() must be a Map.");
-        return (Value){VAL_NIL, {0}};
+        return NIL_VAL;
     }
 
-    HashMap *map = map_val.as.map;
+    HashMap *map = AS_MAP(map_val);
     ValueArray *values_array = array_new();
 
     for (int i = 0; i < map->capacity; i++)
@@ -1050,7 +1073,7 @@ Value builtin_map_values(int argCount, Value *args)
         }
     }
 
-    return (Value){VAL_ARRAY, {.array = values_array}};
+    return ARRAY_VAL(values_array);
 }
 
 // Value builtin_array_distinct(int argCount, Value *args)
@@ -1262,31 +1285,31 @@ Value builtin_map_values(int argCount, Value *args)
 Value builtin_os_platform(int argCount, Value *args)
 {
 #ifdef _WIN32
-    return (Value){VAL_STRING, {.string = "win32"}};
+    return string_copy("win32");
 #elif __apple__
-    return (Value){VAL_STRING, {.string = "darwin"}};
+    return string_copy("darwin");
 #else
-    return (Value){VAL_STRING, {.string = "linux"}};
+    return string_copy("linux");
 #endif
 }
 
 Value builtin_array_statistics(int argCount, Value *args)
 {
-    ValueArray *arr = args[-1].as.array;
+    ValueArray *arr = AS_ARRAY(args[-1]);
 
     if (arr->count == 0)
-        return (Value){VAL_NIL, {0}};
+        return NIL_VAL;
 
     double sum = 0;
-    double min = arr->values[0].as.number;
-    double max = arr->values[0].as.number;
+    double min = AS_NUMBER(arr->values[0]);
+    double max = AS_NUMBER(arr->values[0]);
 
     for (int i = 0; i < arr->count; i++)
     {
-        if (arr->values[i].type != VAL_NUMBER)
+        if (VALUE_TYPE(arr->values[i]) != VAL_NUMBER)
             continue;
 
-        double val = arr->values[i].as.number;
+        double val = AS_NUMBER(arr->values[i]);
         sum += val;
         if (val < min)
             min = val;
@@ -1296,36 +1319,33 @@ Value builtin_array_statistics(int argCount, Value *args)
 
     HashMap *statsMap = map_new();
 
-    map_set(statsMap, "sum", (Value){VAL_NUMBER, {.number = sum}});
-    map_set(statsMap, "min", (Value){VAL_NUMBER, {.number = min}});
-    map_set(statsMap, "max", (Value){VAL_NUMBER, {.number = max}});
-    map_set(statsMap, "count", (Value){VAL_NUMBER, {.number = (double)arr->count}});
-    map_set(statsMap, "mean", (Value){VAL_NUMBER, {.number = sum / arr->count}});
+    map_set(statsMap, "sum", NUMBER_VAL(sum));
+    map_set(statsMap, "min", NUMBER_VAL(min));
+    map_set(statsMap, "max", NUMBER_VAL(max));
+    map_set(statsMap, "count", NUMBER_VAL((double)arr->count));
+    map_set(statsMap, "mean", NUMBER_VAL(sum / arr->count));
 
-    return (Value){VAL_MAP, {.map = statsMap}};
+    return MAP_VAL(statsMap);
 }
 
 Value builtin_map_get(int argCount, Value *args)
 {
-    if (argCount != 1 || args[0].type != VAL_STRING)
+    if (argCount != 1 || VALUE_TYPE(args[0]) != VAL_STRING)
     {
         print_error("get() expects 1 string argument.");
-        return (Value){VAL_NIL, {0}};
+        return NIL_VAL;
     }
 
-    HashMap *map = args[-1].as.map;
-    char *key = args[0].as.string;
+    HashMap *map = AS_MAP(args[-1]);
+    ObjString *key = string_object(args[0]);
+    Value result;
 
-    for (int i = 0; i < map->capacity; i++)
+    if (key ? map_get_string(map, key, &result) : map_get(map, AS_STRING(args[0]), &result))
     {
-        Entry *entry = &map->entries[i];
-        if (entry->key != NULL && strcmp(entry->key, key) == 0)
-        {
-            return copy_value(entry->value);
-        }
+        return copy_value(result);
     }
 
-    return (Value){VAL_NIL, {0}};
+    return NIL_VAL;
 }
 // Value builtin_array_mean(int argCount, Value *args)
 // {
@@ -1513,55 +1533,54 @@ Value builtin_type(int argCount, Value *args)
 {
     if (argCount != 1)
     {
-        return (Value){VAL_NIL, {0}};
+        return NIL_VAL;
     }
 
-    Value val;
-    val.type = VAL_STRING;
+    const char *type_string;
 
-    switch (args[0].type)
+    switch (VALUE_TYPE(args[0]))
     {
     case VAL_NUMBER:
-        val.as.string = strdup("number");
+        type_string = "number";
         break;
     case VAL_STRING:
-        val.as.string = strdup("string");
+        type_string = "string";
         break;
     case TOKEN_TRUE:
     case TOKEN_FALSE:
-        val.as.string = strdup("bool");
+        type_string = "bool";
         break;
     case VAL_MAP:
-        val.as.string = strdup("map");
+        type_string = "map";
         break;
     case VAL_ARRAY:
-        val.as.string = strdup("array");
+        type_string = "array";
         break;
     case VAL_NIL:
-        val.as.string = strdup("nil");
+        type_string = "nil";
         break;
     case VAL_CLASS:
-        val.as.string = strdup("class");
+        type_string = "class";
         break;
 
     default:
-        val.as.string = strdup("unknown");
+        type_string = "unknown";
         break;
     }
 
-    return val;
+    return string_copy(type_string);
 }
 
 Value builtin_plot(int argCount, Value *args)
 {
-    if (argCount < 1 || args[0].type != VAL_ARRAY)
+    if (argCount < 1 || VALUE_TYPE(args[0]) != VAL_ARRAY)
     {
-        return (Value){VAL_NIL, {0}};
+        return NIL_VAL;
     }
 
-    ValueArray *mainArr = args[0].as.array;
+    ValueArray *mainArr = AS_ARRAY(args[0]);
     if (mainArr->count == 0)
-        return (Value){VAL_NIL, {0}};
+        return NIL_VAL;
 
     printf("\n--- Jackal Multi-Plot ---\n");
 
@@ -1569,16 +1588,16 @@ Value builtin_plot(int argCount, Value *args)
     {
         Value item = mainArr->values[i];
 
-        if (item.type == VAL_ARRAY)
+        if (VALUE_TYPE(item) == VAL_ARRAY)
         {
-            ValueArray *subArr = item.as.array;
+            ValueArray *subArr = AS_ARRAY(item);
             printf("Group %d | ", i + 1);
 
             for (int j = 0; j < subArr->count; j++)
             {
-                if (subArr->values[j].type == VAL_NUMBER)
+                if (VALUE_TYPE(subArr->values[j]) == VAL_NUMBER)
                 {
-                    int val = (int)subArr->values[j].as.number;
+                    int val = (int)AS_NUMBER(subArr->values[j]);
                     if (val > 20)
                         val = 20;
 
@@ -1589,10 +1608,10 @@ Value builtin_plot(int argCount, Value *args)
             }
             printf("\n");
         }
-        else if (item.type == VAL_NUMBER)
+        else if (VALUE_TYPE(item) == VAL_NUMBER)
         {
             printf("Data %d  | ", i + 1);
-            int val = (int)item.as.number;
+            int val = (int)AS_NUMBER(item);
             for (int k = 0; k < val; k++)
                 printf("*");
             printf("\n");
@@ -1600,7 +1619,7 @@ Value builtin_plot(int argCount, Value *args)
     }
     printf("         +----------------------------------\n\n");
 
-    return (Value){VAL_NIL, {0}};
+    return NIL_VAL;
 }
 
 static char *base64_encode(const char *data, size_t input_length)
@@ -1628,10 +1647,10 @@ static char *base64_encode(const char *data, size_t input_length)
 }
 Value builtin_web_show(int argCount, Value *args)
 {
-    if (argCount < 1 || args[0].type != VAL_STRING)
-        return (Value){VAL_NIL, {0}};
+    if (argCount < 1 || VALUE_TYPE(args[0]) != VAL_STRING)
+        return NIL_VAL;
 
-    char *html_raw = args[0].as.string;
+    char *html_raw = AS_STRING(args[0]);
 
     FILE *f = fopen("/tmp/jackal_web.html", "w");
     if (f)
@@ -1641,18 +1660,18 @@ Value builtin_web_show(int argCount, Value *args)
         system("open /tmp/jackal_web.html");
     }
 
-    return (Value){VAL_NIL, {0}};
+    return NIL_VAL;
 }
 
 Value builtin_web_sync(int argCount, Value *args)
 {
-    if (argCount < 1 || args[0].type != VAL_STRING)
+    if (argCount < 1 || VALUE_TYPE(args[0]) != VAL_STRING)
     {
-        return (Value){VAL_NIL, {0}};
+        return NIL_VAL;
     }
 
     const char *path = "/tmp/jackal_live.html";
-    char *html_content = args[0].as.string;
+    char *html_content = AS_STRING(args[0]);
 
     FILE *file = fopen(path, "w");
     if (file != NULL)
@@ -1661,33 +1680,33 @@ Value builtin_web_sync(int argCount, Value *args)
         fclose(file);
     }
 
-    return (Value){VAL_NIL, {0}};
+    return NIL_VAL;
 }
 
 Value builtin_system(int argCount, Value *args)
 {
-    if (argCount < 1 || args[0].type != VAL_STRING)
+    if (argCount < 1 || VALUE_TYPE(args[0]) != VAL_STRING)
     {
-        return (Value){VAL_NIL, {0}};
+        return NIL_VAL;
     }
 
-    const char *command = args[0].as.string;
+    const char *command = AS_STRING(args[0]);
 
     int result = system(command);
 
-    return (Value){VAL_NUMBER, {.number = (double)result}};
+    return NUMBER_VAL((double)result);
 }
 Value builtin_http_serve(int argCount, Value *args)
 {
     if (argCount < 2)
-        return (Value){VAL_NIL, {0}};
+        return NIL_VAL;
 
-    int port = (int)args[0].as.number;
-    char *html_content = args[1].as.string;
+    int port = (int)AS_NUMBER(args[0]);
+    char *html_content = AS_STRING(args[1]);
 
     int server_fd = socket(AF_INET, SOCK_STREAM, 0);
     if (server_fd < 0)
-        return (Value){VAL_NIL, {0}};
+        return NIL_VAL;
 
     int opt = 1;
     setsockopt(server_fd, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt));
@@ -1701,7 +1720,7 @@ Value builtin_http_serve(int argCount, Value *args)
     if (bind(server_fd, (struct sockaddr *)&address, sizeof(address)) < 0)
     {
         close(server_fd);
-        return (Value){VAL_NIL, {0}};
+        return NIL_VAL;
     }
 
     listen(server_fd, 5);
@@ -1722,7 +1741,7 @@ Value builtin_http_serve(int argCount, Value *args)
     }
 
     close(server_fd);
-    return (Value){VAL_NIL, {0}};
+    return NIL_VAL;
 }
 
 void inorder_traverse_logic(ValueArray *source, ValueArray *dest, int index)
@@ -1784,7 +1803,7 @@ Value native_plot(int arg_count, Value *args)
     if (arg_count == 0)
     {
         printf("Error: plot() requires at least 1 argument.\n");
-        return (Value){VAL_NIL, .as = {0}};
+        return NIL_VAL;
     }
 
     if (arg_count == 1)
@@ -1794,9 +1813,9 @@ Value native_plot(int arg_count, Value *args)
     }
     else
     {
-        if (args[0].type == VAL_STRING)
+        if (VALUE_TYPE(args[0]) == VAL_STRING)
         {
-            printf("%s:", args[0].as.string);
+            printf("%s:", AS_STRING(args[0]));
         }
         else
         {
@@ -1806,30 +1825,30 @@ Value native_plot(int arg_count, Value *args)
     }
 
     printf("\n");
-    return (Value){VAL_NIL, .as = {0}};
+    return NIL_VAL;
 }
 
 Value native_transpose(int arg_count, Value *args)
 {
 
-    if (arg_count < 1 || args[0].type != VAL_ARRAY)
+    if (arg_count < 1 || VALUE_TYPE(args[0]) != VAL_ARRAY)
     {
         printf("Error: transpose() expects an array.\n");
-        return (Value){VAL_NIL, .as = {0}};
+        return NIL_VAL;
     }
 
-    ValueArray *matrix = args[0].as.array;
+    ValueArray *matrix = AS_ARRAY(args[0]);
     int row_count = matrix->count;
     if (row_count == 0)
         return args[0];
 
-    if (matrix->values[0].type != VAL_ARRAY)
+    if (VALUE_TYPE(matrix->values[0]) != VAL_ARRAY)
     {
         printf("Error: transpose() expects a 2D array.\n");
-        return (Value){VAL_NIL, .as = {0}};
+        return NIL_VAL;
     }
 
-    int col_count = matrix->values[0].as.array->count;
+    int col_count = AS_ARRAY(matrix->values[0])->count;
 
     ValueArray *result = array_new();
 
@@ -1840,7 +1859,7 @@ Value native_transpose(int arg_count, Value *args)
         for (int i = 0; i < row_count; i++)
         {
 
-            ValueArray *current_row = matrix->values[i].as.array;
+            ValueArray *current_row = AS_ARRAY(matrix->values[i]);
 
             if (j < current_row->count)
             {
@@ -1848,34 +1867,28 @@ Value native_transpose(int arg_count, Value *args)
             }
             else
             {
-                array_append(new_row, (Value){VAL_NIL, .as = {0}});
+                array_append(new_row, NIL_VAL);
             }
         }
 
-        Value row_val;
-        row_val.type = VAL_ARRAY;
-        row_val.as.array = new_row;
-        array_append(result, row_val);
+        array_append(result, ARRAY_VAL(new_row));
     }
 
-    Value final_val;
-    final_val.type = VAL_ARRAY;
-    final_val.as.array = result;
-    return final_val;
+    return ARRAY_VAL(result);
 }
 
 Value native_linear_regression(int arg_count, Value *args)
 {
 
-    ValueArray *x_arr = args[0].as.array;
-    ValueArray *y_arr = args[1].as.array;
+    ValueArray *x_arr = AS_ARRAY(args[0]);
+    ValueArray *y_arr = AS_ARRAY(args[1]);
     int n = x_arr->count;
 
     double sum_x = 0, sum_y = 0, sum_xy = 0, sum_xx = 0;
     for (int i = 0; i < n; i++)
     {
-        double x = x_arr->values[i].as.number;
-        double y = y_arr->values[i].as.number;
+        double x = AS_NUMBER(x_arr->values[i]);
+        double y = AS_NUMBER(y_arr->values[i]);
         sum_x += x;
         sum_y += y;
         sum_xx += x * x;
@@ -1886,19 +1899,19 @@ Value native_linear_regression(int arg_count, Value *args)
     double intercept = (sum_y - slope * sum_x) / n;
 
     ValueArray *res = array_new();
-    array_append(res, (Value){VAL_NUMBER, {.number = slope}});
-    array_append(res, (Value){VAL_NUMBER, {.number = intercept}});
-    return (Value){VAL_ARRAY, {.array = res}};
+    array_append(res, NUMBER_VAL(slope));
+    array_append(res, NUMBER_VAL(intercept));
+    return ARRAY_VAL(res);
 }
 
 Value native_standardize(int arg_count, Value *args)
 {
-    if (arg_count != 1 || args[0].type != VAL_ARRAY)
+    if (arg_count != 1 || VALUE_TYPE(args[0]) != VAL_ARRAY)
     {
-        return (Value){VAL_NIL};
+        return NIL_VAL;
     }
 
-    ValueArray *arr = args[0].as.array;
+    ValueArray *arr = AS_ARRAY(args[0]);
     int n = arr->count;
     if (n == 0)
         return args[0];
@@ -1906,14 +1919,14 @@ Value native_standardize(int arg_count, Value *args)
     double sum = 0;
     for (int i = 0; i < n; i++)
     {
-        sum += arr->values[i].as.number;
+        sum += AS_NUMBER(arr->values[i]);
     }
     double mean = sum / n;
 
     double sq_sum = 0;
     for (int i = 0; i < n; i++)
     {
-        double diff = arr->values[i].as.number - mean;
+        double diff = AS_NUMBER(arr->values[i]) - mean;
         sq_sum += diff * diff;
     }
     double std_dev = sqrt(sq_sum / n);
@@ -1921,23 +1934,23 @@ Value native_standardize(int arg_count, Value *args)
     ValueArray *res = array_new();
     for (int i = 0; i < n; i++)
     {
-        double z = (arr->values[i].as.number - mean) / std_dev;
-        Value val = {VAL_NUMBER, {.number = z}};
+        double z = (AS_NUMBER(arr->values[i]) - mean) / std_dev;
+        Value val = NUMBER_VAL(z);
         array_append(res, val);
     }
 
-    return (Value){VAL_ARRAY, {.array = res}};
+    return ARRAY_VAL(res);
 }
 
 Value native_smooth(int arg_count, Value *args)
 {
-    if (arg_count != 2 || args[0].type != VAL_ARRAY || args[1].type != VAL_NUMBER)
+    if (arg_count != 2 || VALUE_TYPE(args[0]) != VAL_ARRAY || VALUE_TYPE(args[1]) != VAL_NUMBER)
     {
-        return (Value){VAL_NIL};
+        return NIL_VAL;
     }
 
-    ValueArray *input = args[0].as.array;
-    int period = (int)args[1].as.number;
+    ValueArray *input = AS_ARRAY(args[0]);
+    int period = (int)AS_NUMBER(args[1]);
     int n = input->count;
 
     if (period <= 0 || period > n)
@@ -1950,36 +1963,36 @@ Value native_smooth(int arg_count, Value *args)
         double sum = 0;
         for (int j = 0; j < period; j++)
         {
-            sum += input->values[i + j].as.number;
+            sum += AS_NUMBER(input->values[i + j]);
         }
         double avg = sum / period;
-        array_append(res, (Value){VAL_NUMBER, {.number = avg}});
+        array_append(res, NUMBER_VAL(avg));
     }
 
-    return (Value){VAL_ARRAY, {.array = res}};
+    return ARRAY_VAL(res);
 }
 
 Value native_correlate(int arg_count, Value *args)
 {
-    if (arg_count != 2 || args[0].type != VAL_ARRAY || args[1].type != VAL_ARRAY)
+    if (arg_count != 2 || VALUE_TYPE(args[0]) != VAL_ARRAY || VALUE_TYPE(args[1]) != VAL_ARRAY)
     {
-        return (Value){VAL_NIL};
+        return NIL_VAL;
     }
 
-    ValueArray *arrX = args[0].as.array;
-    ValueArray *arrY = args[1].as.array;
+    ValueArray *arrX = AS_ARRAY(args[0]);
+    ValueArray *arrY = AS_ARRAY(args[1]);
     int n = arrX->count;
 
     if (n != arrY->count || n == 0)
-        return (Value){VAL_NUMBER, {.number = 0}};
+        return NUMBER_VAL(0);
 
     double sumX = 0, sumY = 0, sumXY = 0;
     double sumX2 = 0, sumY2 = 0;
 
     for (int i = 0; i < n; i++)
     {
-        double x = arrX->values[i].as.number;
-        double y = arrY->values[i].as.number;
+        double x = AS_NUMBER(arrX->values[i]);
+        double y = AS_NUMBER(arrY->values[i]);
 
         sumX += x;
         sumY += y;
@@ -1992,9 +2005,9 @@ Value native_correlate(int arg_count, Value *args)
     double denominator = sqrt((n * sumX2 - sumX * sumX) * (n * sumY2 - sumY * sumY));
 
     if (denominator == 0)
-        return (Value){VAL_NUMBER, {.number = 0}};
+        return NUMBER_VAL(0);
 
-    return (Value){VAL_NUMBER, {.number = numerator / denominator}};
+    return NUMBER_VAL(numerator / denominator);
 }
 
 int compareNeighbors(const void *a, const void *b)
@@ -2007,39 +2020,58 @@ int compareNeighbors(const void *a, const void *b)
         return 1;
     return 0;
 }
-Value native_knn_nd(int arg_count, Value *args)
+/**
+ * Distances from newPoint to every row of history, nearest first.
+ * history is read column by column, so a DataFrame is read in place.
+ * @return NULL if history is neither a DataFrame nor an array of rows.
+ */
+static Neighbor *nearest_neighbors(ValueArray *newPoint, Value history, ValueArray *labels, int *count)
 {
+    FeatureMatrix m;
+    if (!features_from_value(history, &m))
+        return NULL;
 
-    if (arg_count != 4)
-        return (Value){VAL_NIL};
-
-    ValueArray *newPoint = args[0].as.array;
-    ValueArray *history = args[1].as.array;
-    ValueArray *labels = args[2].as.array;
-    int k = (int)args[3].as.number;
-
-    int n_history = history->count;
-    Neighbor *neighbors = malloc(sizeof(Neighbor) * n_history);
+    int n_history = m.rows;
+    double *sums = calloc(n_history ? n_history : 1, sizeof(double));
+    for (int j = 0; j < newPoint->count && j < m.cols; j++)
+    {
+        double val1 = AS_NUMBER(newPoint->values[j]);
+        const double *column = m.columns[j];
+        for (int i = 0; i < n_history; i++)
+        {
+            double diff = val1 - column[i];
+            sums[i] += diff * diff;
+        }
+    }
 
+    Neighbor *neighbors = malloc(sizeof(Neighbor) * (n_history ? n_history : 1));
     for (int i = 0; i < n_history; i++)
     {
-        ValueArray *refPoint = history->values[i].as.array;
-        double sum_sq = 0;
+        neighbors[i].distance = sqrt(sums[i]);
+        neighbors[i].label = (int)AS_NUMBER(labels->values[i]);
+    }
+    qsort(neighbors, n_history, sizeof(Neighbor), compareNeighbors);
 
-        for (int j = 0; j < newPoint->count; j++)
-        {
-            double val1 = newPoint->values[j].as.number;
-            double val2 = refPoint->values[j].as.number;
+    free(sums);
+    features_free(&m);
+    *count = n_history;
+    return neighbors;
+}
 
-            double diff = val1 - val2;
-            sum_sq += diff * diff;
-        }
+Value native_knn_nd(int arg_count, Value *args)
+{
 
-        neighbors[i].distance = sqrt(sum_sq);
-        neighbors[i].label = (int)labels->values[i].as.number;
-    }
+    if (arg_count != 4)
+        return NIL_VAL;
 
-    qsort(neighbors, n_history, sizeof(Neighbor), compareNeighbors);
+    ValueArray *newPoint = AS_ARRAY(args[0]);
+    ValueArray *labels = AS_ARRAY(args[2]);
+    int k = (int)AS_NUMBER(args[3]);
+
+    int n_history;
+    Neighbor *neighbors = nearest_neighbors(newPoint, args[1], labels, &n_history);
+    if (neighbors == NULL)
+        return NIL_VAL;
 
     int votes0 = 0;
     int votes1 = 0;
@@ -2053,50 +2085,52 @@ Value native_knn_nd(int arg_count, Value *args)
 
     free(neighbors);
 
-    return (Value){VAL_NUMBER, {.number = (votes1 > votes0 ? 1 : 0)}};
+    return NUMBER_VAL((votes1 > votes0 ? 1 : 0));
 }
 Value native_accuracy(int arg_count, Value *args)
 {
-    if (arg_count != 2 || args[0].type != VAL_ARRAY || args[1].type != VAL_ARRAY)
+    if (arg_count != 2 || VALUE_TYPE(args[0]) != VAL_ARRAY || VALUE_TYPE(args[1]) != VAL_ARRAY)
     {
-        return (Value){VAL_NIL};
+        return NIL_VAL;
     }
 
-    ValueArray *predictions = args[0].as.array;
-    ValueArray *actual = args[1].as.array;
+    ValueArray *predictions = AS_ARRAY(args[0]);
+    ValueArray *actual = AS_ARRAY(args[1]);
 
     if (predictions->count != actual->count || predictions->count == 0)
     {
-        return (Value){VAL_NUMBER, {.number = 0.0}};
+        return NUMBER_VAL(0.0);
     }
 
     int correct = 0;
     for (int i = 0; i < predictions->count; i++)
     {
-        if (predictions->values[i].as.number == actual->values[i].as.number)
+        if (AS_NUMBER(predictions->values[i]) == AS_NUMBER(actual->values[i]))
         {
             correct++;
         }
     }
 
     double score = (double)correct / predictions->count;
-    return (Value){VAL_NUMBER, {.number = score}};
+    return NUMBER_VAL(score);
 }
 
 Value native_normalize_nd(int arg_count, Value *args)
 {
-    if (arg_count != 1 || args[0].type != VAL_ARRAY)
-        return (Value){VAL_NIL};
+    FeatureMatrix m;
+    if (arg_count != 1 || !features_from_value(args[0], &m))
+        return NIL_VAL;
 
-    ValueArray *matrix = args[0].as.array;
-    int rows = matrix->count;
+    int rows = m.rows;
+    int cols = m.cols;
     if (rows == 0)
-        return (Value){VAL_NIL};
-
-    int cols = matrix->values[0].as.array->count;
+    {
+        features_free(&m);
+        return NIL_VAL;
+    }
 
-    double *min_vals = malloc(sizeof(double) * cols);
-    double *max_vals = malloc(sizeof(double) * cols);
+    double *min_vals = malloc(sizeof(double) * (cols ? cols : 1));
+    double *max_vals = malloc(sizeof(double) * (cols ? cols : 1));
 
     for (int j = 0; j < cols; j++)
     {
@@ -2104,58 +2138,69 @@ Value native_normalize_nd(int arg_count, Value *args)
         max_vals[j] = -INFINITY;
         for (int i = 0; i < rows; i++)
         {
-            double val = matrix->values[i].as.array->values[j].as.number;
+            double val = m.columns[j][i];
             if (val < min_vals[j])
                 min_vals[j] = val;
             if (val > max_vals[j])
                 max_vals[j] = val;
         }
     }
-    ValueArray *newMatrix = array_new();
-    for (int i = 0; i < rows; i++)
+
+    Value result;
+    if (VALUE_TYPE(args[0]) == VAL_DATAFRAME)
     {
-        ValueArray *newRow = array_new();
-        for (int j = 0; j < cols; j++)
+        /* The numeric columns, each scaled to [0, 1]. */
+        DataFrame *source = AS_DATAFRAME(args[0]);
+        DataFrame *frame = frame_new(cols, rows);
+        int j = 0;
+        for (int c = 0; c < source->column_count; c++)
         {
-            double val = matrix->values[i].as.array->values[j].as.number;
-            double norm_val = (max_vals[j] - min_vals[j] == 0) ? 0 : (val - min_vals[j]) / (max_vals[j] - min_vals[j]);
-            array_append(newRow, (Value){VAL_NUMBER, {.number = norm_val}});
+            if (source->columns[c].type == COLUMN_STRING)
+                continue;
+            frame_column_init(frame, j, source->columns[c].name, COLUMN_DOUBLE);
+            double range = max_vals[j] - min_vals[j];
+            for (int i = 0; i < rows; i++)
+                frame->columns[j].data.doubles[i] = range == 0 ? 0 : (m.columns[j][i] - min_vals[j]) / range;
+            j++;
         }
-        array_append(newMatrix, (Value){VAL_ARRAY, {.array = newRow}});
+        result = DATAFRAME_VAL(frame);
+    }
+    else
+    {
+        ValueArray *newMatrix = array_new();
+        for (int i = 0; i < rows; i++)
+        {
+            ValueArray *newRow = array_new();
+            for (int j = 0; j < cols; j++)
+            {
+                double val = m.columns[j][i];
+                double norm_val = (max_vals[j] - min_vals[j] == 0) ? 0 : (val - min_vals[j]) / (max_vals[j] - min_vals[j]);
+                array_append(newRow, NUMBER_VAL(norm_val));
+            }
+            array_append(newMatrix, ARRAY_VAL(newRow));
+        }
+        result = ARRAY_VAL(newMatrix);
     }
 
     free(min_vals);
     free(max_vals);
-    return (Value){VAL_ARRAY, {.array = newMatrix}};
+    features_free(&m);
+    return result;
 }
 
 Value native_knn_prob(int arg_count, Value *args)
 {
     if (arg_count != 4)
-        return (Value){VAL_NIL};
+        return NIL_VAL;
 
-    ValueArray *newPoint = args[0].as.array;
-    ValueArray *history = args[1].as.array;
-    ValueArray *labels = args[2].as.array;
-    int k = (int)args[3].as.number;
-
-    int n_history = history->count;
-    Neighbor *neighbors = malloc(sizeof(Neighbor) * n_history);
-
-    for (int i = 0; i < n_history; i++)
-    {
-        ValueArray *refPoint = history->values[i].as.array;
-        double sum_sq = 0;
-        for (int j = 0; j < newPoint->count; j++)
-        {
-            double diff = newPoint->values[j].as.number - refPoint->values[j].as.number;
-            sum_sq += diff * diff;
-        }
-        neighbors[i].distance = sqrt(sum_sq);
-        neighbors[i].label = (int)labels->values[i].as.number;
-    }
+    ValueArray *newPoint = AS_ARRAY(args[0]);
+    ValueArray *labels = AS_ARRAY(args[2]);
+    int k = (int)AS_NUMBER(args[3]);
 
-    qsort(neighbors, n_history, sizeof(Neighbor), compareNeighbors);
+    int n_history;
+    Neighbor *neighbors = nearest_neighbors(newPoint, args[1], labels, &n_history);
+    if (neighbors == NULL)
+        return NIL_VAL;
 
     int count1 = 0;
     for (int i = 0; i < k && i < n_history; i++)
@@ -2167,16 +2212,16 @@ Value native_knn_prob(int arg_count, Value *args)
     double probability = (double)count1 / k;
 
     free(neighbors);
-    return (Value){VAL_NUMBER, {.number = probability}};
+    return NUMBER_VAL(probability);
 }
 
 Value native_confusion_matrix(int arg_count, Value *args)
 {
     if (arg_count != 2)
-        return (Value){VAL_NIL};
+        return NIL_VAL;
 
-    ValueArray *prediksi = args[0].as.array;
-    ValueArray *kunci = args[1].as.array;
+    ValueArray *prediksi = AS_ARRAY(args[0]);
+    ValueArray *kunci = AS_ARRAY(args[1]);
 
     int tp = 0;
     int tn = 0;
@@ -2185,8 +2230,8 @@ Value native_confusion_matrix(int arg_count, Value *args)
 
     for (int i = 0; i < prediksi->count; i++)
     {
-        int p = (int)prediksi->values[i].as.number;
-        int k = (int)kunci->values[i].as.number;
+        int p = (int)AS_NUMBER(prediksi->values[i]);
+        int k = (int)AS_NUMBER(kunci->values[i]);
 
         if (p == 1 && k == 1)
             tp++;
@@ -2199,20 +2244,34 @@ Value native_confusion_matrix(int arg_count, Value *args)
     }
 
     ValueArray *result = array_new();
-    array_append(result, (Value){VAL_NUMBER, {.number = (double)tp}});
-    array_append(result, (Value){VAL_NUMBER, {.number = (double)tn}});
-    array_append(result, (Value){VAL_NUMBER, {.number = (double)fp}});
-    array_append(result, (Value){VAL_NUMBER, {.number = (double)fn}});
+    array_append(result, NUMBER_VAL((double)tp));
+    array_append(result, NUMBER_VAL((double)tn));
+    array_append(result, NUMBER_VAL((double)fp));
+    array_append(result, NUMBER_VAL((double)fn));
 
-    return (Value){VAL_ARRAY, {.array = result}};
+    return ARRAY_VAL(result);
 }
 Value native_split(int arg_count, Value *args)
 {
     if (arg_count != 2)
-        return (Value){VAL_NIL};
+        return NIL_VAL;
+
+    double ratio = AS_NUMBER(args[1]);
+
+    if (VALUE_TYPE(args[0]) == VAL_DATAFRAME)
+    {
+        DataFrame *frame = AS_DATAFRAME(args[0]);
+        size_t trainLimit = (size_t)(frame->rows * ratio);
+        if (trainLimit == 0 && frame->rows > 0 && ratio > 0)
+            trainLimit = 1;
+
+        ValueArray *result = array_new();
+        array_append(result, DATAFRAME_VAL(frame_slice(frame, 0, trainLimit)));
+        array_append(result, DATAFRAME_VAL(frame_slice(frame, trainLimit, frame->rows - trainLimit)));
+        return ARRAY_VAL(result);
+    }
 
-    ValueArray *data = args[0].as.array;
-    double ratio = args[1].as.number;
+    ValueArray *data = AS_ARRAY(args[0]);
 
     int totalCount = data->count;
     int trainLimit = (int)(totalCount * ratio);
@@ -2238,25 +2297,60 @@ Value native_split(int arg_count, Value *args)
     }
 
     ValueArray *result = array_new();
-    array_append(result, (Value){VAL_ARRAY, {.array = trainArray}});
-    array_append(result, (Value){VAL_ARRAY, {.array = testArray}});
+    array_append(result, ARRAY_VAL(trainArray));
+    array_append(result, ARRAY_VAL(testArray));
 
-    return (Value){VAL_ARRAY, {.array = result}};
+    return ARRAY_VAL(result);
 }
 
 Value native_sync_shuffle(int arg_count, Value *args)
 {
 
-    if (arg_count != 2 || args[0].type != VAL_ARRAY || args[1].type != VAL_ARRAY)
+    if (arg_count != 2 || (VALUE_TYPE(args[0]) != VAL_ARRAY && VALUE_TYPE(args[0]) != VAL_DATAFRAME) || VALUE_TYPE(args[1]) != VAL_ARRAY)
     {
-        return (Value){VAL_NIL};
+        return NIL_VAL;
+    }
+
+    ValueArray *labels = AS_ARRAY(args[1]);
+
+    if (VALUE_TYPE(args[0]) == VAL_DATAFRAME)
+    {
+        /* The same swaps, recorded as an order the frame's columns are gathered by. */
+        DataFrame *frame = AS_DATAFRAME(args[0]);
+        if (frame->rows != (size_t)labels->count)
+            return NIL_VAL;
+
+        int n = labels->count;
+        size_t *order = malloc(sizeof(size_t) * (n ? n : 1));
+        for (int i = 0; i < n; i++)
+            order[i] = i;
+        srand(time(NULL));
+
+        for (int i = n - 1; i > 0; i--)
+        {
+            int j = rand() % (i + 1);
+
+            size_t tempRow = order[i];
+            order[i] = order[j];
+            order[j] = tempRow;
+
+            Value tempLabel = labels->values[i];
+            labels->values[i] = labels->values[j];
+            labels->values[j] = tempLabel;
+        }
+        frame_permute(frame, order);
+        free(order);
+
+        ValueArray *result = array_new();
+        array_append(result, args[0]);
+        array_append(result, ARRAY_VAL(labels));
+        return ARRAY_VAL(result);
     }
 
-    ValueArray *data = args[0].as.array;
-    ValueArray *labels = args[1].as.array;
+    ValueArray *data = AS_ARRAY(args[0]);
 
     if (data->count != labels->count)
-        return (Value){VAL_NIL};
+        return NIL_VAL;
 
     int n = data->count;
     srand(time(NULL));
@@ -2275,24 +2369,24 @@ Value native_sync_shuffle(int arg_count, Value *args)
     }
 
     ValueArray *result = array_new();
-    array_append(result, (Value){VAL_ARRAY, {.array = data}});
-    array_append(result, (Value){VAL_ARRAY, {.array = labels}});
+    array_append(result, ARRAY_VAL(data));
+    array_append(result, ARRAY_VAL(labels));
 
-    return (Value){VAL_ARRAY, {.array = result}};
+    return ARRAY_VAL(result);
 }
 
 Value native_zip(int arg_count, Value *args)
 {
     if (arg_count != 2)
-        return (Value){VAL_NIL};
-    if (args[0].type != VAL_ARRAY || args[1].type != VAL_ARRAY)
+        return NIL_VAL;
+    if (VALUE_TYPE(args[0]) != VAL_ARRAY || VALUE_TYPE(args[1]) != VAL_ARRAY)
     {
         printf("Runtime Error: zip() expects two arrays.\n");
-        return (Value){VAL_NIL};
+        return NIL_VAL;
     }
 
-    ValueArray *arr1 = args[0].as.array;
-    ValueArray *arr2 = args[1].as.array;
+    ValueArray *arr1 = AS_ARRAY(args[0]);
+    ValueArray *arr2 = AS_ARRAY(args[1]);
 
     int length = (arr1->count < arr2->count) ? arr1->count : arr2->count;
 
@@ -2303,91 +2397,94 @@ Value native_zip(int arg_count, Value *args)
         array_append(pair, arr1->values[i]);
         array_append(pair, arr2->values[i]);
 
-        array_append(result, (Value){VAL_ARRAY, {.array = pair}});
+        array_append(result, ARRAY_VAL(pair));
     }
 
-    return (Value){VAL_ARRAY, {.array = result}};
+    return ARRAY_VAL(result);
 }
 Value native_logistic_predict(int arg_count, Value *args)
 {
     if (arg_count != 2)
-        return (Value){VAL_NIL};
+        return NIL_VAL;
 
-    ValueArray *newPoint = args[0].as.array;
-    ValueArray *model = args[1].as.array;
+    ValueArray *newPoint = AS_ARRAY(args[0]);
+    ValueArray *model = AS_ARRAY(args[1]);
 
-    ValueArray *weights = model->values[0].as.array;
-    double bias = model->values[1].as.number;
+    ValueArray *weights = AS_ARRAY(model->values[0]);
+    double bias = AS_NUMBER(model->values[1]);
 
     if (newPoint->count != weights->count)
-        return (Value){VAL_NIL};
+        return NIL_VAL;
 
     double z = bias;
     for (int j = 0; j < newPoint->count; j++)
     {
-        z += newPoint->values[j].as.number * weights->values[j].as.number;
+        z += AS_NUMBER(newPoint->values[j]) * AS_NUMBER(weights->values[j]);
     }
 
     double probability = 1.0 / (1.0 + exp(-z));
     double result = (probability >= 0.5) ? 1.0 : 0.0;
 
-    return (Value){VAL_NUMBER, {.number = result}};
+    return NUMBER_VAL(result);
 }
 
 Value native_logistic_fit(int arg_count, Value *args)
 {
-    if (arg_count != 4)
-        return (Value){VAL_NIL};
+    FeatureMatrix m;
+    if (arg_count != 4 || !features_from_value(args[0], &m))
+        return NIL_VAL;
 
-    ValueArray *data = args[0].as.array;
-    ValueArray *labels = args[1].as.array;
-    double lr = args[2].as.number;
-    int iterations = (int)args[3].as.number;
+    ValueArray *labels = AS_ARRAY(args[1]);
+    double lr = AS_NUMBER(args[2]);
+    int iterations = (int)AS_NUMBER(args[3]);
 
-    int n_samples = data->count;
-    int n_features = data->values[0].as.array->count;
+    int n_samples = m.rows;
+    int n_features = m.cols;
 
-    double *weights = malloc(sizeof(double) * n_features);
-    for (int f = 0; f < n_features; f++)
-        weights[f] = 0.0;
+    double *weights = calloc(n_features ? n_features : 1, sizeof(double));
     double bias = 0.0;
 
-    for (int iter = 0; iter < iterations; iter++)
-    {
-        double *dW_sum = malloc(sizeof(double) * n_features);
-        for (int f = 0; f < n_features; f++)
-            dW_sum[f] = 0.0;
-        double dB_sum = 0.0;
+    /* Whole columns at a time: z and the error for every sample, then each feature's gradient. */
+    double *z = malloc(sizeof(double) * (n_samples ? n_samples : 1));
+    double *dW_sum = malloc(sizeof(double) * (n_features ? n_features : 1));
 
+    for (int iter = 0; iter < iterations && n_samples > 0; iter++)
+    {
         for (int i = 0; i < n_samples; i++)
+            z[i] = bias;
+        for (int j = 0; j < n_features; j++)
         {
-            ValueArray *row = data->values[i].as.array;
-            double y_true = labels->values[i].as.number;
-
-            double z = bias;
-            for (int j = 0; j < n_features; j++)
-            {
-                z += row->values[j].as.number * weights[j];
-            }
+            const double *column = m.columns[j];
+            double w = weights[j];
+            for (int i = 0; i < n_samples; i++)
+                z[i] += column[i] * w;
+        }
 
+        double dB_sum = 0.0;
+        for (int i = 0; i < n_samples; i++)
+        {
             double y_pred;
-            if (z >= 0)
+            if (z[i] >= 0)
             {
-                y_pred = 1.0 / (1.0 + exp(-z));
+                y_pred = 1.0 / (1.0 + exp(-z[i]));
             }
             else
             {
-                double ez = exp(z);
+                double ez = exp(z[i]);
                 y_pred = ez / (1.0 + ez);
             }
 
-            double error = y_pred - y_true;
+            z[i] = y_pred - AS_NUMBER(labels->values[i]);    // the error, from here on
+            dB_sum += z[i];
+        }
 
-            for (int j = 0; j < n_features; j++)
-            {
-                dW_sum[j] += error * row->values[j].as.number;
-            }
-            dB_sum += error;
+        for (int j = 0; j < n_features; j++)
+        {
+            const double *column = m.columns[j];
+            double sum = 0.0;
+            for (int i = 0; i < n_samples; i++)
+                sum += z[i] * column[i];
+            dW_sum[j] = sum;
         }
 
         for (int j = 0; j < n_features; j++)
@@ -2395,91 +2492,83 @@ Value native_logistic_fit(int arg_count, Value *args)
             weights[j] -= lr * (dW_sum[j] / n_samples);
         }
         bias -= lr * (dB_sum / n_samples);
-
-        free(dW_sum);
     }
 
     ValueArray *final_weights = array_new();
     for (int j = 0; j < n_features; j++)
     {
-        Value w_val = {VAL_NUMBER, {.number = weights[j]}};
+        Value w_val = NUMBER_VAL(weights[j]);
         array_append(final_weights, w_val);
     }
 
     ValueArray *result = array_new();
-    Value weights_wrap = {VAL_ARRAY, {.array = final_weights}};
+    Value weights_wrap = ARRAY_VAL(final_weights);
     array_append(result, weights_wrap);
 
-    Value bias_wrap = {VAL_NUMBER, {.number = bias}};
+    Value bias_wrap = NUMBER_VAL(bias);
     array_append(result, bias_wrap);
 
+    free(z);
+    free(dW_sum);
     free(weights);
-    return (Value){VAL_ARRAY, {.array = result}};
+    features_free(&m);
+    return ARRAY_VAL(result);
 }
 
 Value native_nb_fit(int arg_count, Value *args)
 {
-    ValueArray *data = args[0].as.array;
-    ValueArray *labels = args[1].as.array;
+    FeatureMatrix m;
+    if (arg_count < 2 || !features_from_value(args[0], &m))
+        return NIL_VAL;
+
+    ValueArray *labels = AS_ARRAY(args[1]);
 
-    int n_samples = data->count;
-    int n_features = data->values[0].as.array->count;
+    int n_samples = m.rows;
+    int n_features = m.cols;
 
-    double *mean0 = malloc(sizeof(double) * n_features);
-    double *var0 = malloc(sizeof(double) * n_features);
-    double *mean1 = malloc(sizeof(double) * n_features);
-    double *var1 = malloc(sizeof(double) * n_features);
+    double *mean0 = calloc(n_features ? n_features : 1, sizeof(double));
+    double *var0 = calloc(n_features ? n_features : 1, sizeof(double));
+    double *mean1 = calloc(n_features ? n_features : 1, sizeof(double));
+    double *var1 = calloc(n_features ? n_features : 1, sizeof(double));
+    char *is_one = malloc(n_samples ? n_samples : 1);
 
     int count0 = 0, count1 = 0;
 
-    for (int f = 0; f < n_features; f++)
+    for (int i = 0; i < n_samples; i++)
     {
-        mean0[f] = var0[f] = mean1[f] = var1[f] = 0.0;
+        is_one[i] = (int)AS_NUMBER(labels->values[i]) != 0;
+        if (is_one[i])
+            count1++;
+        else
+            count0++;
     }
 
-    for (int i = 0; i < n_samples; i++)
+    for (int f = 0; f < n_features; f++)
     {
-        int label = (int)labels->values[i].as.number;
-        ValueArray *row = data->values[i].as.array;
-        if (label == 0)
-        {
-            count0++;
-            for (int f = 0; f < n_features; f++)
-                mean0[f] += row->values[f].as.number;
-        }
-        else
+        const double *column = m.columns[f];
+        for (int i = 0; i < n_samples; i++)
         {
-            count1++;
-            for (int f = 0; f < n_features; f++)
-                mean1[f] += row->values[f].as.number;
+            if (is_one[i])
+                mean1[f] += column[i];
+            else
+                mean0[f] += column[i];
         }
-    }
-
-    if (count0 > 0)
-        for (int f = 0; f < n_features; f++)
+        if (count0 > 0)
             mean0[f] /= count0;
-    if (count1 > 0)
-        for (int f = 0; f < n_features; f++)
+        if (count1 > 0)
             mean1[f] /= count1;
 
-    for (int i = 0; i < n_samples; i++)
-    {
-        int label = (int)labels->values[i].as.number;
-        ValueArray *row = data->values[i].as.array;
-        if (label == 0)
+        for (int i = 0; i < n_samples; i++)
         {
-            for (int f = 0; f < n_features; f++)
+            if (is_one[i])
             {
-                double diff = row->values[f].as.number - mean0[f];
-                var0[f] += diff * diff;
+                double diff = column[i] - mean1[f];
+                var1[f] += diff * diff;
             }
-        }
-        else
-        {
-            for (int f = 0; f < n_features; f++)
+            else
             {
-                double diff = row->values[f].as.number - mean1[f];
-                var1[f] += diff * diff;
+                double diff = column[i] - mean0[f];
+                var0[f] += diff * diff;
             }
         }
     }
@@ -2491,41 +2580,43 @@ Value native_nb_fit(int arg_count, Value *args)
 
     for (int f = 0; f < n_features; f++)
     {
-        array_append(v_mean0, (Value){VAL_NUMBER, {.number = mean0[f]}});
-        array_append(v_var0, (Value){VAL_NUMBER, {.number = (var0[f] / (count0 > 0 ? count0 : 1)) + 1e-9}});
-        array_append(v_mean1, (Value){VAL_NUMBER, {.number = mean1[f]}});
-        array_append(v_var1, (Value){VAL_NUMBER, {.number = (var1[f] / (count1 > 0 ? count1 : 1)) + 1e-9}});
+        array_append(v_mean0, NUMBER_VAL(mean0[f]));
+        array_append(v_var0, NUMBER_VAL((var0[f] / (count0 > 0 ? count0 : 1)) + 1e-9));
+        array_append(v_mean1, NUMBER_VAL(mean1[f]));
+        array_append(v_var1, NUMBER_VAL((var1[f] / (count1 > 0 ? count1 : 1)) + 1e-9));
     }
 
     ValueArray *final_model = array_new();
-    array_append(final_model, (Value){VAL_ARRAY, {.array = v_mean0}});
-    array_append(final_model, (Value){VAL_ARRAY, {.array = v_var0}});
-    array_append(final_model, (Value){VAL_ARRAY, {.array = v_mean1}});
-    array_append(final_model, (Value){VAL_ARRAY, {.array = v_var1}});
-    array_append(final_model, (Value){VAL_NUMBER, {.number = (double)count0}});
-    array_append(final_model, (Value){VAL_NUMBER, {.number = (double)count1}});
+    array_append(final_model, ARRAY_VAL(v_mean0));
+    array_append(final_model, ARRAY_VAL(v_var0));
+    array_append(final_model, ARRAY_VAL(v_mean1));
+    array_append(final_model, ARRAY_VAL(v_var1));
+    array_append(final_model, NUMBER_VAL((double)count0));
+    array_append(final_model, NUMBER_VAL((double)count1));
 
     free(mean0);
     free(var0);
     free(mean1);
     free(var1);
+    free(is_one);
+    features_free(&m);
 
-    return (Value){VAL_ARRAY, {.array = final_model}};
+    return ARRAY_VAL(final_model);
 }
 Value native_nb_predict(int arg_count, Value *args)
 {
     if (arg_count != 2)
-        return (Value){VAL_NIL};
+        return NIL_VAL;
 
-    ValueArray *point = args[0].as.array;
-    ValueArray *model = args[1].as.array;
+    ValueArray *point = AS_ARRAY(args[0]);
+    ValueArray *model = AS_ARRAY(args[1]);
 
-    ValueArray *mean0 = model->values[0].as.array;
-    ValueArray *var0 = model->values[1].as.array;
-    ValueArray *mean1 = model->values[2].as.array;
-    ValueArray *var1 = model->values[3].as.array;
-    double count0 = model->values[4].as.number;
-    double count1 = model->values[5].as.number;
+    ValueArray *mean0 = AS_ARRAY(model->values[0]);
+    ValueArray *var0 = AS_ARRAY(model->values[1]);
+    ValueArray *mean1 = AS_ARRAY(model->values[2]);
+    ValueArray *var1 = AS_ARRAY(model->values[3]);
+    double count0 = AS_NUMBER(model->values[4]);
+    double count1 = AS_NUMBER(model->values[5]);
 
     int n_features = point->count;
     double log_probs[2];
@@ -2535,36 +2626,36 @@ Value native_nb_predict(int arg_count, Value *args)
 
     for (int f = 0; f < n_features; f++)
     {
-        double x = point->values[f].as.number;
+        double x = AS_NUMBER(point->values[f]);
 
-        double m0 = mean0->values[f].as.number;
-        double v0 = var0->values[f].as.number;
+        double m0 = AS_NUMBER(mean0->values[f]);
+        double v0 = AS_NUMBER(var0->values[f]);
         log_probs[0] += -0.5 * log(2 * M_PI * v0) - pow(x - m0, 2) / (2 * v0);
 
-        double m1 = mean1->values[f].as.number;
-        double v1 = var1->values[f].as.number;
+        double m1 = AS_NUMBER(mean1->values[f]);
+        double v1 = AS_NUMBER(var1->values[f]);
         log_probs[1] += -0.5 * log(2 * M_PI * v1) - pow(x - m1, 2) / (2 * v1);
     }
 
     double result = (log_probs[1] > log_probs[0]) ? 1.0 : 0.0;
-    return (Value){VAL_NUMBER, {.number = result}};
+    return NUMBER_VAL(result);
 }
 
 Value native_kmeans_predict(int arg_count, Value *args)
 {
-    ValueArray *point = args[0].as.array;
-    ValueArray *centroids = args[1].as.array;
+    ValueArray *point = AS_ARRAY(args[0]);
+    ValueArray *centroids = AS_ARRAY(args[1]);
 
     double min_dist = 1e18;
     int best_cluster = 0;
 
     for (int i = 0; i < centroids->count; i++)
     {
-        ValueArray *centroid = centroids->values[i].as.array;
+        ValueArray *centroid = AS_ARRAY(centroids->values[i]);
         double dist = 0;
         for (int f = 0; f < point->count; f++)
         {
-            double diff = point->values[f].as.number - centroid->values[f].as.number;
+            double diff = AS_NUMBER(point->values[f]) - AS_NUMBER(centroid->values[f]);
             dist += diff * diff;
         }
         if (dist < min_dist)
@@ -2574,45 +2665,53 @@ Value native_kmeans_predict(int arg_count, Value *args)
         }
     }
 
-    return (Value){VAL_NUMBER, {.number = (double)best_cluster}};
+    return NUMBER_VAL((double)best_cluster);
 }
 
 Value native_kmeans_fit(int arg_count, Value *args)
 {
-    ValueArray *data = args[0].as.array;
-    int k = (int)args[1].as.number;
-    int iterations = (int)args[2].as.number;
+    FeatureMatrix m;
+    if (arg_count < 3 || !features_from_value(args[0], &m))
+        return NIL_VAL;
 
-    int n_samples = data->count;
-    int n_features = data->values[0].as.array->count;
+    int k = (int)AS_NUMBER(args[1]);
+    int iterations = (int)AS_NUMBER(args[2]);
+
+    int n_samples = m.rows;
+    int n_features = m.cols;
+    if (n_samples == 0 || k <= 0)
+    {
+        features_free(&m);
+        return ARRAY_VAL(array_new());
+    }
 
     double **centroids = malloc(sizeof(double *) * k);
     for (int i = 0; i < k; i++)
     {
-        centroids[i] = malloc(sizeof(double) * n_features);
-        ValueArray *random_row = data->values[i % n_samples].as.array;
+        centroids[i] = malloc(sizeof(double) * (n_features ? n_features : 1));
         for (int f = 0; f < n_features; f++)
         {
-            centroids[i][f] = random_row->values[f].as.number;
+            centroids[i][f] = m.columns[f][i % n_samples];
         }
     }
 
+    int *assignments = malloc(sizeof(int) * n_samples);
+    double *sums = malloc(sizeof(double) * k * (n_features ? n_features : 1));
+    int *counts = malloc(sizeof(int) * k);
+
     for (int iter = 0; iter < iterations; iter++)
     {
-        int *assignments = malloc(sizeof(int) * n_samples);
-
         for (int i = 0; i < n_samples; i++)
         {
             double min_dist = 1e18;
             int best_cluster = 0;
-            ValueArray *row = data->values[i].as.array;
 
             for (int j = 0; j < k; j++)
             {
                 double dist = 0;
                 for (int f = 0; f < n_features; f++)
                 {
-                    double diff = row->values[f].as.number - centroids[j][f];
+                    double diff = m.columns[f][i] - centroids[j][f];
                     dist += diff * diff;
                 }
                 if (dist < min_dist)
@@ -2624,34 +2723,30 @@ Value native_kmeans_fit(int arg_count, Value *args)
             assignments[i] = best_cluster;
         }
 
-        for (int j = 0; j < k; j++)
+        /* Every cluster's new mean in one pass over the samples. */
+        memset(sums, 0, sizeof(double) * k * n_features);
+        memset(counts, 0, sizeof(int) * k);
+        for (int i = 0; i < n_samples; i++)
+            counts[assignments[i]]++;
+        for (int f = 0; f < n_features; f++)
         {
-            double *new_mean = malloc(sizeof(double) * n_features);
-            for (int f = 0; f < n_features; f++)
-                new_mean[f] = 0;
-            int count = 0;
-
+            const double *column = m.columns[f];
             for (int i = 0; i < n_samples; i++)
-            {
-                if (assignments[i] == j)
-                {
-                    count++;
-                    for (int f = 0; f < n_features; f++)
-                    {
-                        new_mean[f] += data->values[i].as.array->values[f].as.number;
-                    }
-                }
-            }
+                sums[assignments[i] * n_features + f] += column[i];
+        }
 
-            if (count > 0)
+        for (int j = 0; j < k; j++)
+        {
+            if (counts[j] > 0)
             {
                 for (int f = 0; f < n_features; f++)
-                    centroids[j][f] = new_mean[f] / count;
+                    centroids[j][f] = sums[j * n_features + f] / counts[j];
             }
-            free(new_mean);
         }
-        free(assignments);
     }
+    free(assignments);
+    free(sums);
+    free(counts);
 
     ValueArray *final_centroids = array_new();
     for (int i = 0; i < k; i++)
@@ -2659,33 +2754,36 @@ Value native_kmeans_fit(int arg_count, Value *args)
         ValueArray *c_row = array_new();
         for (int f = 0; f < n_features; f++)
         {
-            array_append(c_row, (Value){VAL_NUMBER, {.number = centroids[i][f]}});
+            array_append(c_row, NUMBER_VAL(centroids[i][f]));
         }
-        array_append(final_centroids, (Value){VAL_ARRAY, {.array = c_row}});
+        array_append(final_centroids, ARRAY_VAL(c_row));
         free(centroids[i]);
     }
     free(centroids);
+    features_free(&m);
 
-    return (Value){VAL_ARRAY, {.array = final_centroids}};
+    return ARRAY_VAL(final_centroids);
 }
 
 Value native_kmeans_loss(int arg_count, Value *args)
 {
-    ValueArray *data = args[0].as.array;
-    ValueArray *centroids = args[1].as.array;
+    FeatureMatrix m;
+    if (arg_count < 2 || !features_from_value(args[0], &m))
+        return NIL_VAL;
+
+    ValueArray *centroids = AS_ARRAY(args[1]);
     double total_sse = 0;
 
-    for (int i = 0; i < data->count; i++)
+    for (int i = 0; i < m.rows; i++)
     {
         double min_dist = 1e18;
-        ValueArray *row = data->values[i].as.array;
         for (int j = 0; j < centroids->count; j++)
         {
             double dist = 0;
-            ValueArray *c = centroids->values[j].as.array;
-            for (int f = 0; f < row->count; f++)
+            ValueArray *c = AS_ARRAY(centroids->values[j]);
+            for (int f = 0; f < m.cols; f++)
             {
-                double diff = row->values[f].as.number - c->values[f].as.number;
+                double diff = m.columns[f][i] - AS_NUMBER(c->values[f]);
                 dist += diff * diff;
             }
             if (dist < min_dist)
@@ -2693,25 +2791,26 @@ Value native_kmeans_loss(int arg_count, Value *args)
         }
         total_sse += min_dist;
     }
-    return (Value){VAL_NUMBER, {.number = total_sse}};
+    features_free(&m);
+    return NUMBER_VAL(total_sse);
 }
 
 Value native_matrix_dot(int arg_count, Value *args)
 {
     if (arg_count != 2)
-        return (Value){VAL_NIL};
+        return NIL_VAL;
 
-    ValueArray *A = args[0].as.array;
-    ValueArray *B = args[1].as.array;
+    ValueArray *A = AS_ARRAY(args[0]);
+    ValueArray *B = AS_ARRAY(args[1]);
 
     int rowsA = A->count;
-    int colsA = A->values[0].as.array->count;
+    int colsA = AS_ARRAY(A->values[0])->count;
     int rowsB = B->count;
-    int colsB = B->values[0].as.array->count;
+    int colsB = AS_ARRAY(B->values[0])->count;
 
     if (colsA != rowsB)
     {
-        return (Value){VAL_NIL};
+        return NIL_VAL;
     }
 
     ValueArray *result = array_new();
@@ -2719,87 +2818,87 @@ Value native_matrix_dot(int arg_count, Value *args)
     for (int i = 0; i < rowsA; i++)
     {
         ValueArray *new_row = array_new();
-        ValueArray *rowA = A->values[i].as.array;
+        ValueArray *rowA = AS_ARRAY(A->values[i]);
 
         for (int j = 0; j < colsB; j++)
         {
             double sum = 0;
             for (int k = 0; k < colsA; k++)
             {
-                double valA = rowA->values[k].as.number;
-                double valB = B->values[k].as.array->values[j].as.number;
+                double valA = AS_NUMBER(rowA->values[k]);
+                double valB = AS_NUMBER(AS_ARRAY(B->values[k])->values[j]);
                 sum += valA * valB;
             }
-            array_append(new_row, (Value){VAL_NUMBER, {.number = sum}});
+            array_append(new_row, NUMBER_VAL(sum));
         }
-        array_append(result, (Value){VAL_ARRAY, {.array = new_row}});
+        array_append(result, ARRAY_VAL(new_row));
     }
 
-    return (Value){VAL_ARRAY, {.array = result}};
+    return ARRAY_VAL(result);
 }
 
 Value native_matrix_add(int arg_count, Value *args)
 {
-    ValueArray *A = args[0].as.array;
-    ValueArray *B = args[1].as.array;
+    ValueArray *A = AS_ARRAY(args[0]);
+    ValueArray *B = AS_ARRAY(args[1]);
 
     int rows = A->count;
-    int cols = A->values[0].as.array->count;
+    int cols = AS_ARRAY(A->values[0])->count;
 
-    if (rows != B->count || cols != B->values[0].as.array->count)
+    if (rows != B->count || cols != AS_ARRAY(B->values[0])->count)
     {
-        return (Value){VAL_NIL};
+        return NIL_VAL;
     }
 
     ValueArray *result = array_new();
 
     for (int i = 0; i < rows; i++)
     {
-        ValueArray *rowA = A->values[i].as.array;
-        ValueArray *rowB = B->values[i].as.array;
+        ValueArray *rowA = AS_ARRAY(A->values[i]);
+        ValueArray *rowB = AS_ARRAY(B->values[i]);
         ValueArray *new_row = array_new();
 
         for (int j = 0; j < cols; j++)
         {
-            double sum = rowA->values[j].as.number + rowB->values[j].as.number;
-            array_append(new_row, (Value){VAL_NUMBER, {.number = sum}});
+            double sum = AS_NUMBER(rowA->values[j]) + AS_NUMBER(rowB->values[j]);
+            array_append(new_row, NUMBER_VAL(sum));
         }
-        array_append(result, (Value){VAL_ARRAY, {.array = new_row}});
+        array_append(result, ARRAY_VAL(new_row));
     }
 
-    return (Value){VAL_ARRAY, {.array = result}};
+    return ARRAY_VAL(result);
 }
 
 Value native_matrix_sub(int arg_count, Value *args)
 {
-    ValueArray *A = args[0].as.array;
-    ValueArray *B = args[1].as.array;
+    ValueArray *A = AS_ARRAY(args[0]);
+    ValueArray *B = AS_ARRAY(args[1]);
 
     int rows = A->count;
-    int cols = A->values[0].as.array->count;
+    int cols = AS_ARRAY(A->values[0])->count;
 
-    if (rows != B->count || cols != B->values[0].as.array->count)
+    if (rows != B->count || cols != AS_ARRAY(B->values[0])->count)
     {
-        return (Value){VAL_NIL};
+        return NIL_VAL;
     }
 
     ValueArray *result = array_new();
 
     for (int i = 0; i < rows; i++)
     {
-        ValueArray *rowA = A->values[i].as.array;
-        ValueArray *rowB = B->values[i].as.array;
+        ValueArray *rowA = AS_ARRAY(A->values[i]);
+        ValueArray *rowB = AS_ARRAY(B->values[i]);
         ValueArray *new_row = array_new();
 
         for (int j = 0; j < cols; j++)
         {
-            double diff = rowA->values[j].as.number - rowB->values[j].as.number;
-            array_append(new_row, (Value){VAL_NUMBER, {.number = diff}});
+            double diff = AS_NUMBER(rowA->values[j]) - AS_NUMBER(rowB->values[j]);
+            array_append(new_row, NUMBER_VAL(diff));
         }
-        array_append(result, (Value){VAL_ARRAY, {.array = new_row}});
+        array_append(result, ARRAY_VAL(new_row));
     }
 
-    return (Value){VAL_ARRAY, {.array = result}};
+    return ARRAY_VAL(result);
 }
 
 double calculate_determinant(ValueArray *matrix)
@@ -2807,25 +2906,25 @@ double calculate_determinant(ValueArray *matrix)
     int n = matrix->count;
 
     if (n == 1)
-        return matrix->values[0].as.array->values[0].as.number;
+        return AS_NUMBER(AS_ARRAY(matrix->values[0])->values[0]);
 
     if (n == 2)
     {
-        double a = matrix->values[0].as.array->values[0].as.number;
-        double b = matrix->values[0].as.array->values[1].as.number;
-        double c = matrix->values[1].as.array->values[0].as.number;
-        double d = matrix->values[1].as.array->values[1].as.number;
+        double a = AS_NUMBER(AS_ARRAY(matrix->values[0])->values[0]);
+        double b = AS_NUMBER(AS_ARRAY(matrix->values[0])->values[1]);
+        double c = AS_NUMBER(AS_ARRAY(matrix->values[1])->values[0]);
+        double d = AS_NUMBER(AS_ARRAY(matrix->values[1])->values[1]);
         return (a * d) - (b * c);
     }
 
     double det = 0;
     int sign = 1;
-    ValueArray *first_row = matrix->values[0].as.array;
+    ValueArray *first_row = AS_ARRAY(matrix->values[0]);
 
     for (int j = 0; j < n; j++)
     {
         ValueArray *minor = get_minor(matrix, j);
-        det += sign * first_row->values[j].as.number * calculate_determinant(minor);
+        det += sign * AS_NUMBER(first_row->values[j]) * calculate_determinant(minor);
         sign = -sign;
     }
     return det;
@@ -2833,23 +2932,23 @@ double calculate_determinant(ValueArray *matrix)
 
 Value native_matrix_det(int arg_count, Value *args)
 {
-    ValueArray *matrix = args[0].as.array;
+    ValueArray *matrix = AS_ARRAY(args[0]);
     int rows = matrix->count;
-    int cols = matrix->values[0].as.array->count;
+    int cols = AS_ARRAY(matrix->values[0])->count;
 
     if (rows != cols)
-        return (Value){VAL_NIL};
+        return NIL_VAL;
 
     double result = calculate_determinant(matrix);
-    return (Value){VAL_NUMBER, {.number = result}};
+    return NUMBER_VAL(result);
 }
 
 Value native_matrix_scalar_mul(int arg_count, Value *args)
 {
-    ValueArray *M = args[0].as.array;
-    double scalar = args[1].as.number;
+    ValueArray *M = AS_ARRAY(args[0]);
+    double scalar = AS_NUMBER(args[1]);
     int rows = M->count;
-    int cols = M->values[0].as.array->count;
+    int cols = AS_ARRAY(M->values[0])->count;
 
     ValueArray *result = array_new();
     for (int i = 0; i < rows; i++)
@@ -2857,128 +2956,102 @@ Value native_matrix_scalar_mul(int arg_count, Value *args)
         ValueArray *new_row = array_new();
         for (int j = 0; j < cols; j++)
         {
-            double val = M->values[i].as.array->values[j].as.number;
-            array_append(new_row, (Value){VAL_NUMBER, {.number = val * scalar}});
+            double val = AS_NUMBER(AS_ARRAY(M->values[i])->values[j]);
+            array_append(new_row, NUMBER_VAL(val * scalar));
         }
-        array_append(result, (Value){VAL_ARRAY, {.array = new_row}});
+        array_append(result, ARRAY_VAL(new_row));
     }
-    return (Value){VAL_ARRAY, {.array = result}};
+    return ARRAY_VAL(result);
 }
 
 
 
 Value native_load_csv_smart(int arg_count, Value *args)
 {
-    const char *filename = args[0].as.string;
-    FILE *file = fopen(filename, "r");
-    if (!file)
-        return (Value){VAL_NIL};
+    if (arg_count < 1 || VALUE_TYPE(args[0]) != VAL_STRING)
+        return NIL_VAL;
 
-    ValueArray *all_rows = array_new();
-    char line[10240];
-
-    while (fgets(line, sizeof(line), file))
-    {
-        ValueArray *row = array_new();
-        char *token = strtok(line, ",");
-        while (token)
-        {
-            token[strcspn(token, "\r\n")] = 0;
-
-            char *endptr;
-            double val = strtod(token, &endptr);
-
-            if (endptr == token)
-            {
-                array_append(row, (Value){VAL_STRING, {.string = strdup(token)}});
-            }
-            else
-            {
-                array_append(row, (Value){VAL_NUMBER, {.number = val}});
-            }
-            token = strtok(NULL, ",");
-        }
-        array_append(all_rows, (Value){VAL_ARRAY, {.array = row}});
-    }
-    fclose(file);
-    return (Value){VAL_ARRAY, {.array = all_rows}};
+    ValueArray *all_rows = csv_read_file(AS_STRING(args[0]), ',', true);
+    if (!all_rows)
+        return NIL_VAL;
+    return ARRAY_VAL(all_rows);
 }
 
 Value native_tensor_add(int arg_count, Value *args)
 {
-    ValueArray *a = args[0].as.array;
-    double scalar = args[1].as.number;
+    ValueArray *a = AS_ARRAY(args[0]);
+    double scalar = AS_NUMBER(args[1]);
     ValueArray *result = array_new();
 
     for (int i = 0; i < a->count; i++)
     {
-        double val = a->values[i].as.number;
-        array_append(result, (Value){VAL_NUMBER, {.number = val + scalar}});
+        double val = AS_NUMBER(a->values[i]);
+        array_append(result, NUMBER_VAL(val + scalar));
     }
-    return (Value){VAL_ARRAY, {.array = result}};
+    return ARRAY_VAL(result);
 }
 
 Value native_tensor_sub(int arg_count, Value *args)
 {
-    ValueArray *a = args[0].as.array;
-    double scalar = args[1].as.number;
+    ValueArray *a = AS_ARRAY(args[0]);
+    double scalar = AS_NUMBER(args[1]);
     ValueArray *result = array_new();
 
     for (int i = 0; i < a->count; i++)
     {
-        double val = a->values[i].as.number;
-        array_append(result, (Value){VAL_NUMBER, {.number = val - scalar}});
+        double val = AS_NUMBER(a->values[i]);
+        array_append(result, NUMBER_VAL(val - scalar));
     }
-    return (Value){VAL_ARRAY, {.array = result}};
+    return ARRAY_VAL(result);
 }
 
 Value native_tensor_mul(int arg_count, Value *args)
 {
-    ValueArray *a = args[0].as.array;
-    double scalar = args[1].as.number;
+    ValueArray *a = AS_ARRAY(args[0]);
+    double scalar = AS_NUMBER(args[1]);
     ValueArray *result = array_new();
 
     for (int i = 0; i < a->count; i++)
     {
-        double val = a->values[i].as.number;
-        array_append(result, (Value){VAL_NUMBER, {.number = val * scalar}});
+        double val = AS_NUMBER(a->values[i]);
+        array_append(result, NUMBER_VAL(val * scalar));
     }
-    return (Value){VAL_ARRAY, {.array = result}};
+    return ARRAY_VAL(result);
 }
 
 Value native_tensor_check_shape(int arg_count, Value *args)
 {
-    ValueArray *data = args[0].as.array;
-    ValueArray *new_shape = args[1].as.array;
+    ValueArray *data = AS_ARRAY(args[0]);
+    ValueArray *new_shape = AS_ARRAY(args[1]);
 
     int current_size = data->count;
     long target_size = 1;
 
     for (int i = 0; i < new_shape->count; i++)
     {
-        target_size *= (int)new_shape->values[i].as.number;
+        target_size *= (int)AS_NUMBER(new_shape->values[i]);
     }
 
     if (current_size == (int)target_size)
     {
-        return (Value){VAL_NUMBER, {.number = 1}};
+        return NUMBER_VAL(1);
     }
-    return (Value){VAL_NUMBER, {.number = 0}};
+    return NUMBER_VAL(0);
 }
 
 Value native_save_jml(int arg_count, Value *args)
 {
-    const char *filename = args[0].as.string;
-    ValueArray *data = args[1].as.array;
-    ValueArray *shape = args[2].as.array;
+    const char *filename = AS_STRING(args[0]);
+    ValueArray *data = AS_ARRAY(args[1]);
+    ValueArray *shape = AS_ARRAY(args[2]);
 
     FILE *file = fopen(filename, "w");
     if (!file)
-        return (Value){VAL_NUMBER, {.number = 0}};
+        return NUMBER_VAL(0);
 
     for (int i = 0; i < shape->count; i++)
     {
-        fprintf(file, "%f", shape->values[i].as.number);
+        fprintf(file, "%f", AS_NUMBER(shape->values[i]));
         if (i < shape->count - 1)
             fprintf(file, ",");
     }
@@ -2986,21 +3059,21 @@ Value native_save_jml(int arg_count, Value *args)
 
     for (int i = 0; i < data->count; i++)
     {
-        fprintf(file, "%f", data->values[i].as.number);
+        fprintf(file, "%f", AS_NUMBER(data->values[i]));
         if (i < data->count - 1)
             fprintf(file, ",");
     }
 
     fclose(file);
-    return (Value){VAL_NUMBER, {.number = 1}};
+    return NUMBER_VAL(1);
 }
 
 Value native_load_jml(int arg_count, Value *args)
 {
-    const char *filename = args[0].as.string;
+    const char *filename = AS_STRING(args[0]);
     FILE *file = fopen(filename, "r");
     if (!file)
-        return (Value){VAL_NIL};
+        return NIL_VAL;
 
     ValueArray *result = array_new();
     char line[4096];
@@ -3011,52 +3084,52 @@ Value native_load_jml(int arg_count, Value *args)
         char *token = strtok(line, ",");
         while (token)
         {
-            array_append(row, (Value){VAL_NUMBER, {.number = atof(token)}});
+            array_append(row, NUMBER_VAL(atof(token)));
             token = strtok(NULL, ",");
         }
-        array_append(result, (Value){VAL_ARRAY, {.array = row}});
+        array_append(result, ARRAY_VAL(row));
     }
 
     fclose(file);
-    return (Value){VAL_ARRAY, {.array = result}};
+    return ARRAY_VAL(result);
 }
 
 Value native_tensor_sum(int arg_count, Value *args)
 {
-    ValueArray *a = args[0].as.array;
+    ValueArray *a = AS_ARRAY(args[0]);
     double total = 0;
 
     for (int i = 0; i < a->count; i++)
     {
-        total += a->values[i].as.number;
+        total += AS_NUMBER(a->values[i]);
     }
-    return (Value){VAL_NUMBER, {.number = total}};
+    return NUMBER_VAL(total);
 }
 
 Value native_tensor_mean(int arg_count, Value *args)
 {
-    ValueArray *a = args[0].as.array;
+    ValueArray *a = AS_ARRAY(args[0]);
     if (a->count == 0)
-        return (Value){VAL_NUMBER, {.number = 0}};
+        return NUMBER_VAL(0);
 
     Value sum_val = native_tensor_sum(arg_count, args);
-    return (Value){VAL_NUMBER, {.number = sum_val.as.number / a->count}};
+    return NUMBER_VAL(AS_NUMBER(sum_val) / a->count);
 }
 
 Value native_tensor_dot(int arg_count, Value *args)
 {
-    ValueArray *data_a = args[0].as.array;
-    ValueArray *shape_a = args[1].as.array;
-    ValueArray *data_b = args[2].as.array;
-    ValueArray *shape_b = args[3].as.array;
+    ValueArray *data_a = AS_ARRAY(args[0]);
+    ValueArray *shape_a = AS_ARRAY(args[1]);
+    ValueArray *data_b = AS_ARRAY(args[2]);
+    ValueArray *shape_b = AS_ARRAY(args[3]);
 
-    int r1 = (int)shape_a->values[0].as.number;
-    int c1 = (int)shape_a->values[1].as.number;
-    int r2 = (int)shape_b->values[0].as.number;
-    int c2 = (int)shape_b->values[1].as.number;
+    int r1 = (int)AS_NUMBER(shape_a->values[0]);
+    int c1 = (int)AS_NUMBER(shape_a->values[1]);
+    int r2 = (int)AS_NUMBER(shape_b->values[0]);
+    int c2 = (int)AS_NUMBER(shape_b->values[1]);
 
     if (c1 != r2)
-        return (Value){VAL_NIL};
+        return NIL_VAL;
 
     ValueArray *result = array_new();
     for (int i = 0; i < r1; i++)
@@ -3066,53 +3139,53 @@ Value native_tensor_dot(int arg_count, Value *args)
             double sum = 0;
             for (int k = 0; k < c1; k++)
             {
-                sum += data_a->values[i * c1 + k].as.number * data_b->values[k * c2 + j].as.number;
+                sum += AS_NUMBER(data_a->values[i * c1 + k]) * AS_NUMBER(data_b->values[k * c2 + j]);
             }
-            array_append(result, (Value){VAL_NUMBER, {.number = sum}});
+            array_append(result, NUMBER_VAL(sum));
         }
     }
-    return (Value){VAL_ARRAY, {.array = result}};
+    return ARRAY_VAL(result);
 }
 
 Value native_vector_dot(int arg_count, Value *args)
 {
-    ValueArray *a = args[0].as.array;
-    ValueArray *b = args[1].as.array;
+    ValueArray *a = AS_ARRAY(args[0]);
+    ValueArray *b = AS_ARRAY(args[1]);
     double result = 0;
 
     for (int i = 0; i < a->count; i++)
     {
-        result += a->values[i].as.number * b->values[i].as.number;
+        result += AS_NUMBER(a->values[i]) * AS_NUMBER(b->values[i]);
     }
-    return (Value){VAL_NUMBER, {.number = result}};
+    return NUMBER_VAL(result);
 }
 
 Value native_vector_norm(int arg_count, Value *args)
 {
-    ValueArray *a = args[0].as.array;
+    ValueArray *a = AS_ARRAY(args[0]);
     double sum_sq = 0;
 
     for (int i = 0; i < a->count; i++)
     {
-        double val = a->values[i].as.number;
+        double val = AS_NUMBER(a->values[i]);
         sum_sq += val * val;
     }
-    return (Value){VAL_NUMBER, {.number = sqrt(sum_sq)}};
+    return NUMBER_VAL(sqrt(sum_sq));
 }
 
 Value native_math_acos(int arg_count, Value *args)
 {
-    if (args[0].type != VAL_NUMBER)
+    if (VALUE_TYPE(args[0]) != VAL_NUMBER)
     {
-        return (Value){VAL_NIL};
+        return NIL_VAL;
     }
 
-    double val = args[0].as.number;
+    double val = AS_NUMBER(args[0]);
 
     if (val < -1.0)
         val = -1.0;
     if (val > 1.0)
         val = 1.0;
 
-    return (Value){VAL_NUMBER, {.number = acos(val)}};
+    return NUMBER_VAL(acos(val));
 }
\ No newline at end of file
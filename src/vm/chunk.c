@@ -0,0 +1,114 @@
+#include "vm/chunk.h"
+#include "value.h"
+#include "string_object.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define GROW_CAPACITY(capacity) ((capacity) < 8 ? 8 : (capacity) * 2)
+
+void initChunk(Chunk *chunk)
+{
+    memset(chunk, 0, sizeof(Chunk));
+}
+
+Chunk *newChunk(void)
+{
+    Chunk *chunk = malloc(sizeof(Chunk));
+    if (!chunk)
+    {
+        fprintf(stderr, "Fatal Error: Out of Memory!\n");
+        exit(1);
+    }
+    initChunk(chunk);
+    return chunk;
+}
+
+void writeChunk(Chunk *chunk, uint8_t byte, int line)
+{
+    if (chunk->count == chunk->capacity)
+    {
+        chunk->capacity = GROW_CAPACITY(chunk->capacity);
+        chunk->code = realloc(chunk->code, chunk->capacity);
+        chunk->lines = realloc(chunk->lines, sizeof(int) * chunk->capacity);
+    }
+
+    chunk->code[chunk->count] = byte;
+    chunk->lines[chunk->count] = line;
+    chunk->count++;
+}
+
+int addConstant(Chunk *chunk, Value value)
+{
+    ValueArray *pool = &chunk->constants;
+
+    /* String constants are pinned interned strings: the VM pushes them
+       without copying, and equal names share one pool slot by pointer. */
+    if (VALUE_TYPE(value) == VAL_STRING)
+        value = string_value(string_intern_pinned(AS_STRING(value)));
+
+    for (int i = 0; i < pool->count; i++)
+    {
+        Value existing = pool->values[i];
+        if (VALUE_TYPE(existing) != VALUE_TYPE(value))
+            continue;
+        if (VALUE_TYPE(value) == VAL_NUMBER && AS_NUMBER(existing) == AS_NUMBER(value))
+            return i;
+        if (VALUE_TYPE(value) == VAL_STRING && AS_STRING(existing) == AS_STRING(value))
+            return i;
+    }
+
+    if (pool->count == pool->capacity)
+    {
+        pool->capacity = GROW_CAPACITY(pool->capacity);
+        pool->values = realloc(pool->values, sizeof(Value) * pool->capacity);
+    }
+
+    pool->values[pool->count] = value;
+    return pool->count++;
+}
+
+int addNode(Chunk *chunk, Node *node)
+{
+    for (int i = chunk->node_count - 1; i >= 0; i--)
+    {
+        if (chunk->nodes[i] == node)
+            return i;
+    }
+
+    if (chunk->node_count == chunk->node_capacity)
+    {
+        chunk->node_capacity = GROW_CAPACITY(chunk->node_capacity);
+        chunk->nodes = realloc(chunk->nodes, sizeof(Node *) * chunk->node_capacity);
+    }
+
+    chunk->nodes[chunk->node_count] = node;
+    return chunk->node_count++;
+}
+
+int addProto(Chunk *chunk, Node *decl, Chunk *body)
+{
+    if (chunk->proto_count == chunk->proto_capacity)
+    {
+        chunk->proto_capacity = GROW_CAPACITY(chunk->proto_capacity);
+        chunk->protos = realloc(chunk->protos, sizeof(FuncProto) * chunk->proto_capacity);
+    }
+
+    chunk->protos[chunk->proto_count] = (FuncProto){decl, body};
+    return chunk->proto_count++;
+}
+
+void freeChunk(Chunk *chunk)
+{
+    for (int i = 0; i < chunk->proto_count; i++)
+    {
+        freeChunk(chunk->protos[i].body);
+        free(chunk->protos[i].body);
+    }
+
+    free(chunk->code);
+    free(chunk->lines);
+    free(chunk->constants.values);
+    free(chunk->nodes);
+    free(chunk->protos);
+    initChunk(chunk);
+}
@@ -3,80 +3,105 @@
 #include "../../include/vm/debug.h"
 #include "../../include/vm/opcode.h"
 
-static int simple_instruction(const char *name, int offset)
+static uint16_t read_short(Chunk *chunk, int offset)
 {
-    printf("%-16s\n", name);
-    return offset + 1;
+    return (uint16_t)(chunk->code[offset] << 8 | chunk->code[offset + 1]);
 }
 
-static int const_num_instruction(const char *name, uint8_t *code, int offset)
+static const char *node_label(Node *node)
 {
-    double value;
-    memcpy(&value, code + offset + 1, sizeof(double));
-    printf("%-16s %g\n", name, value);
-    return offset + 1 + sizeof(double);
+    return node->name[0] != '\0' ? node->name : "<expr>";
 }
 
-static int const_str_instruction(const char *name, uint8_t *code, int offset)
+static int simple_instruction(const char *name, int offset)
 {
-    int len;
-    memcpy(&len, code + offset + 1, sizeof(int));
+    printf("%s\n", name);
+    return offset + 1;
+}
 
-    printf("%-16s \"", name);
-    for (int i = 0; i < len; i++)
-    {
-        printf("%c", code[offset + 1 + sizeof(int) + i]);
-    }
-    printf("\"\n");
+static int constant_instruction(const char *name, Chunk *chunk, int offset)
+{
+    uint16_t index = read_short(chunk, offset + 1);
+    Value constant = chunk->constants.values[index];
 
-    return offset + 1 + sizeof(int) + len;
+    printf("%-16s %4d ", name, index);
+    if (VALUE_TYPE(constant) == VAL_NUMBER)
+        printf("%g\n", AS_NUMBER(constant));
+    else
+        printf("\"%s\"\n", AS_STRING(constant));
+    return offset + 3;
 }
 
-static int jump_instruction(const char *name, int sign, uint8_t *code, int offset)
+static int node_instruction(const char *name, Chunk *chunk, int offset)
 {
-    uint16_t jump = (uint16_t)(code[offset + 1] << 8 | code[offset + 2]);
-    printf("%-16s %4d -> %d\n", name, offset, offset + 3 + sign * jump);
+    uint16_t index = read_short(chunk, offset + 1);
+    printf("%-16s %4d '%s'\n", name, index, node_label(chunk->nodes[index]));
     return offset + 3;
 }
 
-static int loop_instruction(const char *name, uint8_t *code, int offset)
+static int proto_instruction(const char *name, Chunk *chunk, int offset)
 {
-    uint16_t jump = (uint16_t)(code[offset + 1] << 8 | code[offset + 2]);
-    printf("%-16s %4d -> %d\n", name, offset, offset + 3 - jump);
+    uint16_t index = read_short(chunk, offset + 1);
+    printf("%-16s %4d <fn %s>\n", name, index, node_label(chunk->protos[index].decl));
     return offset + 3;
 }
 
-static int invoke_instruction(const char *name, uint8_t *code, int offset)
+static int jump_instruction(const char *name, int sign, Chunk *chunk, int offset)
 {
-    offset++;
-
-    int len;
-    memcpy(&len, code + offset, sizeof(int));
-    offset += sizeof(int);
+    uint16_t jump = read_short(chunk, offset + 1);
+    printf("%-16s %4d -> %d\n", name, offset, offset + 3 + sign * jump);
+    return offset + 3;
+}
 
-    printf("%-16s \"", name);
-    for (int i = 0; i < len; i++)
-        printf("%c", code[offset + i]);
-    printf("\"");
-    offset += len;
+static int byte_instruction(const char *name, Chunk *chunk, int offset)
+{
+    printf("%-16s %4d\n", name, chunk->code[offset + 1]);
+    return offset + 2;
+}
 
-    uint8_t args = code[offset];
-    printf(" (%d args)\n", args);
-    offset++;
+static int outer_instruction(const char *name, Chunk *chunk, int offset)
+{
+    uint16_t index = read_short(chunk, offset + 1);
+    uint8_t depth = chunk->code[offset + 3];
+    if (depth == OUTER_BY_NAME)
+        printf("%-16s %4d '%s' (by name)\n", name, index, node_label(chunk->nodes[index]));
+    else
+        printf("%-16s %4d '%s' (depth %d)\n", name, index, node_label(chunk->nodes[index]), depth);
+    return offset + 4;
+}
 
-    return offset;
+static int short_instruction(const char *name, Chunk *chunk, int offset)
+{
+    printf("%-16s %4d\n", name, read_short(chunk, offset + 1));
+    return offset + 3;
 }
 
-int disassemble_instruction(uint8_t *code, int offset)
+int disassemble_instruction(Chunk *chunk, int offset)
 {
-    printf("%04d  ", offset);
+    printf("%04d ", offset);
+    if (offset > 0 && chunk->lines[offset] == chunk->lines[offset - 1])
+        printf("   | ");
+    else
+        printf("%4d ", chunk->lines[offset]);
 
-    uint8_t instruction = code[offset];
+    uint8_t instruction = chunk->code[offset];
 
     switch (instruction)
     {
     case OP_HALT:
         return simple_instruction("OP_HALT", offset);
+    case OP_CONST_NUM:
+        return constant_instruction("OP_CONST_NUM", chunk, offset);
+    case OP_CONST_STR:
+        return constant_instruction("OP_CONST_STR", chunk, offset);
+    case OP_NIL:
+        return simple_instruction("OP_NIL", offset);
+    case OP_TRUE:
+        return simple_instruction("OP_TRUE", offset);
+    case OP_FALSE:
+        return simple_instruction("OP_FALSE", offset);
+    case OP_POP:
+        return simple_instruction("OP_POP", offset);
 
     case OP_ADD:
         return simple_instruction("OP_ADD", offset);
@@ -86,57 +111,137 @@ int disassemble_instruction(uint8_t *code, int offset)
         return simple_instruction("OP_MUL", offset);
     case OP_DIV:
         return simple_instruction("OP_DIV", offset);
-
-    case OP_POP:
-        return simple_instruction("OP_POP", offset);
-    case OP_DUP:
-        return simple_instruction("OP_DUP", offset);
-
+    case OP_MOD:
+        return simple_instruction("OP_MOD", offset);
     case OP_EQUAL:
         return simple_instruction("OP_EQUAL", offset);
+    case OP_NOT_EQUAL:
+        return simple_instruction("OP_NOT_EQUAL", offset);
     case OP_GREATER:
         return simple_instruction("OP_GREATER", offset);
+    case OP_GREATER_EQUAL:
+        return simple_instruction("OP_GREATER_EQUAL", offset);
     case OP_LESS:
         return simple_instruction("OP_LESS", offset);
+    case OP_LESS_EQUAL:
+        return simple_instruction("OP_LESS_EQUAL", offset);
     case OP_NOT:
-        return simple_instruction("OP_NOT", offset); 
-
-    case OP_PRINT:
-        return simple_instruction("OP_PRINT", offset);
+        return simple_instruction("OP_NOT", offset);
+    case OP_NEGATE:
+        return simple_instruction("OP_NEGATE", offset);
+    case OP_CAST:
+        return constant_instruction("OP_CAST", chunk, offset);
 
-    case OP_CONST_NUM:
-        return const_num_instruction("OP_CONST_NUM", code, offset);
-    case OP_CONST_STR:
-        return const_str_instruction("OP_CONST_STR", code, offset);
-    case OP_SET_VAR:
-        return const_str_instruction("OP_SET_VAR", code, offset);
     case OP_GET_VAR:
-        return const_str_instruction("OP_GET_VAR", code, offset);
+        return node_instruction("OP_GET_VAR", chunk, offset);
+    case OP_SET_VAR:
+        return node_instruction("OP_SET_VAR", chunk, offset);
+    case OP_DEF_VAR:
+        return node_instruction("OP_DEF_VAR", chunk, offset);
+    case OP_POST_INC:
+        return node_instruction("OP_POST_INC", chunk, offset);
+    case OP_POST_DEC:
+        return node_instruction("OP_POST_DEC", chunk, offset);
+    case OP_PUSH_SCOPE:
+        return node_instruction("OP_PUSH_SCOPE", chunk, offset);
+    case OP_POP_SCOPE:
+        return simple_instruction("OP_POP_SCOPE", offset);
+    case OP_GET_LOCAL:
+        return byte_instruction("OP_GET_LOCAL", chunk, offset);
+    case OP_SET_LOCAL:
+        return byte_instruction("OP_SET_LOCAL", chunk, offset);
+    case OP_DEF_LOCAL:
+        return byte_instruction("OP_DEF_LOCAL", chunk, offset);
+    case OP_POST_INC_LOCAL:
+        return byte_instruction("OP_POST_INC_LOCAL", chunk, offset);
+    case OP_POST_DEC_LOCAL:
+        return byte_instruction("OP_POST_DEC_LOCAL", chunk, offset);
+    case OP_GET_OUTER:
+        return outer_instruction("OP_GET_OUTER", chunk, offset);
+    case OP_SET_OUTER:
+        return outer_instruction("OP_SET_OUTER", chunk, offset);
 
     case OP_JUMP:
-        return jump_instruction("OP_JUMP", 1, code, offset);
+        return jump_instruction("OP_JUMP", 1, chunk, offset);
     case OP_JUMP_IF_FALSE:
-        return jump_instruction("OP_JUMP_IF_FALSE", 1, code, offset);
+        return jump_instruction("OP_JUMP_IF_FALSE", 1, chunk, offset);
+    case OP_JUMP_IF_TRUE:
+        return jump_instruction("OP_JUMP_IF_TRUE", 1, chunk, offset);
     case OP_LOOP:
-        return loop_instruction("OP_LOOP", code, offset);
+        return jump_instruction("OP_LOOP", -1, chunk, offset);
+    case OP_ITER_INIT:
+        return jump_instruction("OP_ITER_INIT", 1, chunk, offset);
+    case OP_ITER_NEXT:
+    {
+        uint16_t index = read_short(chunk, offset + 1);
+        uint16_t jump = read_short(chunk, offset + 3);
+        printf("%-16s %4d '%s' -> %d\n", "OP_ITER_NEXT", index, node_label(chunk->nodes[index]), offset + 5 + jump);
+        return offset + 5;
+    }
+    case OP_ITER_NEXT_LOCAL:
+    {
+        uint8_t slot = chunk->code[offset + 1];
+        uint16_t jump = read_short(chunk, offset + 2);
+        printf("%-16s %4d -> %d\n", "OP_ITER_NEXT_LOCAL", slot, offset + 4 + jump);
+        return offset + 4;
+    }
 
+    case OP_CLOSURE:
+        return proto_instruction("OP_CLOSURE", chunk, offset);
     case OP_DEF_FUNC:
-        return const_str_instruction("OP_DEF_FUNC", code, offset);
+        return node_instruction("OP_DEF_FUNC", chunk, offset);
+    case OP_IS_MAIN:
+        return simple_instruction("OP_IS_MAIN", offset);
+    case OP_CALL:
+    {
+        uint8_t args = chunk->code[offset + 1];
+        printf("%-16s (%d args)\n", "OP_CALL", args);
+        return offset + 4;
+    }
     case OP_RETURN:
         return simple_instruction("OP_RETURN", offset);
+    case OP_RETURN_END:
+        return simple_instruction("OP_RETURN_END", offset);
+
     case OP_CLASS:
-        return const_str_instruction("OP_CLASS", code, offset);
+    {
+        uint16_t index = read_short(chunk, offset + 1);
+        printf("%-16s %4d '%s'\n", "OP_CLASS", index, node_label(chunk->nodes[index]));
+        return offset + 5;
+    }
     case OP_METHOD:
-        return const_str_instruction("OP_METHOD", code, offset);
+        return proto_instruction("OP_METHOD", chunk, offset);
+    case OP_END_CLASS:
+        return node_instruction("OP_END_CLASS", chunk, offset);
     case OP_GET_PROP:
-        return const_str_instruction("OP_GET_PROP", code, offset);
+        return node_instruction("OP_GET_PROP", chunk, offset);
     case OP_SET_PROP:
-        return const_str_instruction("OP_SET_PROP", code, offset);
-
-    case OP_CALL:
-        return invoke_instruction("OP_CALL", code, offset);
+        return node_instruction("OP_SET_PROP", chunk, offset);
     case OP_INVOKE:
-        return invoke_instruction("OP_INVOKE", code, offset);
+    {
+        uint16_t index = read_short(chunk, offset + 1);
+        uint8_t args = chunk->code[offset + 3];
+        printf("%-16s %4d '%s' (%d args)\n", "OP_INVOKE", index, node_label(chunk->nodes[index]), args);
+        return offset + 5;
+    }
+
+    case OP_ARRAY:
+        return short_instruction("OP_ARRAY", chunk, offset);
+    case OP_MAP:
+        return short_instruction("OP_MAP", chunk, offset);
+    case OP_INDEX_GET:
+        return simple_instruction("OP_INDEX_GET", offset);
+    case OP_INDEX_SET:
+        return simple_instruction("OP_INDEX_SET", offset);
+    case OP_RANGE:
+        return simple_instruction("OP_RANGE", offset);
+
+    case OP_EVAL:
+    {
+        uint16_t index = read_short(chunk, offset + 1);
+        printf("%-16s %4d (node kind %d, line %d)\n", "OP_EVAL", index, chunk->nodes[index]->kind, chunk->nodes[index]->line);
+        return offset + 3;
+    }
 
     default:
         printf("Unknown opcode %d\n", instruction);
@@ -144,20 +249,20 @@ int disassemble_instruction(uint8_t *code, int offset)
     }
 }
 
-void disassemble_chunk(const char *name, uint8_t *code, int length)
+void disassemble_chunk(Chunk *chunk, const char *name)
 {
-    printf("== %s Dump ==\n", name);
+    printf("== %s ==\n", name);
 
     int offset = 0;
-
-    if (length > 3 && code[0] == 'J' && code[1] == 'L' && code[2] == 'O')
+    while (offset < chunk->count)
     {
-        printf("Header: JLO v1 (Skipping 3 bytes)\n");
-        offset = 3;
+        offset = disassemble_instruction(chunk, offset);
     }
 
-    while (offset < length)
+    for (int i = 0; i < chunk->proto_count; i++)
     {
-        offset = disassemble_instruction(code, offset);
+        char label[300];
+        snprintf(label, sizeof(label), "%s/%s", name, node_label(chunk->protos[i].decl));
+        disassemble_chunk(chunk->protos[i].body, label);
     }
-}
\ No newline at end of file
+}
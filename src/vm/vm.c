@@ -1,102 +1,307 @@
 #include "vm/vm.h"
+#include "compiler/jlo.h"
+#include "gc.h"
+#include "string_object.h"
 #include "vm/opcode.h"
 #include "common.h"
+#include "eval.h"
+#include "csv/csv_stream.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <math.h>
 
-static void runtimeError(VM *vm, const char *format, ...);
-
-#define READ_BYTE() (*vm->ip++)
+#define READ_BYTE() (*frame->ip++)
 
 // Membaca 2 byte operand (index/offset)
 #define READ_SHORT() \
-    (vm->ip += 2, (uint16_t)((vm->ip[-2] << 8) | vm->ip[-1]))
+    (frame->ip += 2, (uint16_t)((frame->ip[-2] << 8) | frame->ip[-1]))
 
 // Mengambil konstanta dari Constant Pool
-#define READ_CONSTANT() (vm->chunk->constants.values[READ_SHORT()])
-
-// Macro untuk mengulang loop eksekusi binary (Pop 2, Lakukan Op, Push 1)
-#define BINARY_OP(op_token, op)                                                \
-    do                                                                         \
-    {                                                                          \
-        Value b = pop(vm);                                                     \
-        Value a = pop(vm);                                                     \
-        if (a.type != VAL_NUMBER || b.type != VAL_NUMBER)                      \
-        {                                                                      \
-            runtimeError(vm, "Operands for '" #op_token "' must be numbers."); \
-            return INTERPRET_RUNTIME_ERROR;                                    \
-        }                                                                      \
-        push(vm, (Value){VAL_NUMBER, {.number = a.as.number op b.as.number}}); \
+#define READ_CONSTANT() (frame->chunk->constants.values[READ_SHORT()])
+
+#define READ_NODE() (frame->chunk->nodes[READ_SHORT()])
+
+// Angka diproses langsung; tipe lain lewat eval_binary_op seperti di evaluator
+#define NUMBER_OP(token, expr)                                          \
+    do                                                                  \
+    {                                                                   \
+        Value b = pop(vm);                                              \
+        Value a = pop(vm);                                              \
+        if (IS_NUMBER(a) && IS_NUMBER(b))                               \
+        {                                                               \
+            double x = AS_NUMBER(a);                                    \
+            double y = AS_NUMBER(b);                                    \
+            push(vm, NUMBER_VAL(expr));                                 \
+        }                                                               \
+        else                                                            \
+        {                                                               \
+            push(vm, eval_binary_op(token, a, b));                      \
+        }                                                               \
     } while (0)
 
-// Macro untuk mengulang loop eksekusi perbandingan (Pop 2, Lakukan Comp, Push Boolean)
-#define COMPARE_OP(op)                                                                       \
-    do                                                                                       \
-    {                                                                                        \
-        Value b = pop(vm);                                                                   \
-        Value a = pop(vm);                                                                   \
-        if (a.type != VAL_NUMBER || b.type != VAL_NUMBER)                                    \
-        {                                                                                    \
-            runtimeError(vm, "Comparison operands must be numbers.");                        \
-            return INTERPRET_RUNTIME_ERROR;                                                  \
-        }                                                                                    \
-        push(vm, (Value){VAL_NUMBER, {.number = (a.as.number op b.as.number) ? 1.0 : 0.0}}); \
+#define COMPARE_OP(token, op)                                                    \
+    do                                                                           \
+    {                                                                            \
+        Value b = pop(vm);                                                       \
+        Value a = pop(vm);                                                       \
+        if (IS_NUMBER(a) && IS_NUMBER(b))                                        \
+        {                                                                        \
+            push(vm, BOOL_VAL(AS_NUMBER(a) op AS_NUMBER(b)));                    \
+        }                                                                        \
+        else                                                                     \
+        {                                                                        \
+            push(vm, eval_binary_op(token, a, b));                               \
+        }                                                                        \
     } while (0)
 
 // --- Fungsi Utilitas VM ---
 
-static void push(VM *vm, Value value)
+static inline void push(VM *vm, Value value)
 {
-    if (vm->stackTop - vm->stack >= STACK_MAX)
-    {
-        runtimeError(vm, "Stack overflow.");
-        return;
-    }
     *vm->stackTop = value;
     vm->stackTop++;
 }
 
-static Value pop(VM *vm)
+static inline Value pop(VM *vm)
 {
     vm->stackTop--;
     return *vm->stackTop;
 }
 
-static void runtimeError(VM *vm, const char *format, ...)
+static inline Value peek(VM *vm, int distance)
+{
+    return vm->stackTop[-1 - distance];
+}
+
+static void runtimeError(VM *vm, const char *format)
+{
+    CallFrame *frame = &vm->frames[vm->frameCount - 1];
+    size_t instruction = frame->ip - frame->chunk->code - 1;
+
+    fprintf(stderr, "Runtime Error: %s\n", format);
+    fprintf(stderr, "[line %d]\n", frame->chunk->lines[instruction]);
+}
+
+/**
+ * Frees the values from slot upwards and drops them from the stack.
+ */
+static void drop_from(VM *vm, Value *slot)
+{
+    while (vm->stackTop > slot)
+    {
+        free_value(pop(vm));
+    }
+}
+
+/**
+ * Closes the scopes a frame opened with OP_PUSH_SCOPE.
+ */
+static void close_scopes(CallFrame *frame)
+{
+    while (frame->env != frame->base_env)
+    {
+        Env *scope = frame->env;
+        frame->env = scope->outer;
+        env_free(scope);
+    }
+}
+
+/**
+ * Pushes a frame for a function body compiled to a chunk.
+ * The callee and its arguments stay on the stack until the frame returns.
+ * A body with stack slots gets exactly its parameters there, followed by
+ * its locals; it runs in the closure environment itself.
+ * @return false when the call depth limit is reached.
+ */
+static bool push_frame(VM *vm, Func *func, Env *call_env, FrameKind kind, Value receiver, int arg_count)
+{
+    if (vm->frameCount == FRAMES_MAX || vm->stackTop - vm->stack > STACK_MAX - 512)
+    {
+        runtimeError(vm, "Stack overflow.");
+        return false;
+    }
+
+    Chunk *chunk = func->chunk;
+    Value *slots = vm->stackTop - arg_count - 1;
+    if (chunk->slot_count > 0)
+    {
+        drop_from(vm, slots + 1 + chunk->arity);
+        while (vm->stackTop < slots + chunk->slot_count)
+            push(vm, NIL_VAL);
+    }
+
+    CallFrame *frame = &vm->frames[vm->frameCount++];
+    frame->chunk = chunk;
+    frame->ip = chunk->code;
+    frame->env = call_env;
+    frame->base_env = call_env;
+    frame->func = func;
+    frame->receiver = receiver;
+    frame->slots = slots;
+    frame->kind = kind;
+    return true;
+}
+
+/**
+ * Whether a call can run in a slot frame. Too few arguments leave parameters
+ * undefined, which only the evaluator reports, so those calls go through
+ * call_value and call_method instead.
+ */
+static bool fits_slots(Chunk *chunk, int arg_count, bool has_receiver)
+{
+    return chunk->has_receiver == has_receiver && arg_count >= chunk->arity;
+}
+
+/**
+ * Frees the call environment of a function frame. Slot frames run in the
+ * closure environment, which is not theirs to free.
+ */
+static void release_call_env(CallFrame *frame)
+{
+    if (frame->chunk->slot_count == 0)
+        env_free(frame->base_env);
+}
+
+/**
+ * Pushes the value of a variable read by OP_GET_VAR or OP_GET_OUTER,
+ * reporting a missing one the way eval_node does.
+ */
+static void push_var(VM *vm, Var *v, Node *node)
+{
+    if (!v)
+    {
+        if (node->kind == NODE_THIS)
+            print_error("'this' is not defined.");
+        else
+            print_error("Undefined identifier '%s'.", node->name);
+        push(vm, NIL_VAL);
+        return;
+    }
+    push(vm, copy_value(v->value));
+}
+
+/**
+ * Advances the for-each loop whose collection and index are on top of the stack.
+ * @param item Receives the next element, still owned by the collection.
+ * @return false once the collection is exhausted.
+ */
+static bool iter_next(VM *vm, Value *item)
+{
+    if (VALUE_TYPE(peek(vm, 1)) == VAL_CSV_CURSOR)
+    {
+        ValueArray *row = csv_cursor_next(AS_CSV_CURSOR(peek(vm, 1)));
+        if (row == NULL)
+            return false;
+        *item = ARRAY_VAL(row);
+        return true;
+    }
+
+    ValueArray *arr = AS_ARRAY(peek(vm, 1));
+    int index = (int)AS_NUMBER(vm->stackTop[-1]);
+    if (index >= arr->count)
+        return false;
+    *item = arr->values[index];
+    vm->stackTop[-1] = NUMBER_VAL(AS_NUMBER(vm->stackTop[-1]) + 1);
+    return true;
+}
+
+/**
+ * Leaves the current frame, producing the value of the call the way
+ * call_value, construct_instance and invoke_method do for tree-walked bodies.
+ * @param result The returned value, owned by the frame.
+ * @param is_explicit Whether it came from a return statement rather than
+ * falling off the end of the body.
+ * @return false once the script frame has returned.
+ */
+static bool return_from_frame(VM *vm, Value result, bool is_explicit)
 {
-    va_list args;
-    va_start(args, format);
-    vfprintf(stderr, "Runtime Error: ", args);
-    vfprintf(stderr, format, args);
-    va_end(args);
-    fprintf(stderr, "\n");
-
-    // Tunjukkan di mana error terjadi (offset)
-    size_t instruction = vm->ip - vm->chunk->code - 1;
-    fprintf(stderr, "[Bytecode offset %zu]\n", instruction);
+    CallFrame *frame = &vm->frames[vm->frameCount - 1];
+    close_scopes(frame);
+
+    switch (frame->kind)
+    {
+    case FRAME_SCRIPT:
+        free_value(result);
+        drop_from(vm, frame->slots);
+        vm->frameCount--;
+        return false;
+
+    case FRAME_FUNCTION:
+        release_call_env(frame);
+        result = check_return_type(frame->func, result);
+        break;
+
+    case FRAME_METHOD:
+        release_call_env(frame);
+        if (!is_explicit)
+        {
+            free_value(result);
+            result = NIL_VAL;
+        }
+        break;
+
+    case FRAME_INIT:
+        release_call_env(frame);
+        free_value(result);
+        result = frame->receiver;
+        break;
+    }
+
+    drop_from(vm, frame->slots);
+    vm->frameCount--;
+    push(vm, result);
+    return true;
 }
 
 // --- Implementasi VM ---
 
-void initVM(VM *vm)
+/**
+ * Marks the VM's roots: values on its stack and the scopes of its frames.
+ */
+static void mark_vm_roots(void *ctx)
+{
+    VM *vm = ctx;
+    for (Value *slot = vm->stack; slot < vm->stackTop; slot++)
+        gc_mark_value(*slot);
+
+    for (int i = 0; i < vm->frameCount; i++)
+    {
+        CallFrame *frame = &vm->frames[i];
+        gc_mark_env(frame->env);
+        gc_mark_env(frame->base_env);
+        gc_mark_value(frame->receiver);
+        if (frame->func)
+            gc_mark_value(FUNCTION_VAL(frame->func));
+    }
+    gc_mark_env(vm->globalEnv);
+}
+
+void initVM(VM *vm, Env *globals)
 {
-    vm->chunk = NULL;
-    vm->ip = NULL;
+    vm->frameCount = 0;
+    vm->stack = malloc(sizeof(Value) * STACK_MAX);
+    if (!vm->stack)
+    {
+        fprintf(stderr, "Fatal Error: Out of Memory!\n");
+        exit(1);
+    }
     vm->stackTop = vm->stack;
-    vm->globalEnv = env_new(NULL); // Inisialisasi Environment Global
+    vm->globalEnv = globals;
+    gc_add_root_marker(mark_vm_roots, vm);
 }
 
 void freeVM(VM *vm)
 {
-    env_free(vm->globalEnv);
+    gc_remove_root_marker(mark_vm_roots, vm);
+    free(vm->stack);
+    vm->stack = NULL;
+    vm->stackTop = NULL;
 }
 
-InterpretResult interpret(VM *vm, Chunk *chunk)
+static InterpretResult run(VM *vm)
 {
-    vm->chunk = chunk;
-    vm->ip = chunk->code;
+    CallFrame *frame = &vm->frames[vm->frameCount - 1];
 
     // --- Dispatch Loop (Mesin Eksekusi Utama) ---
     for (;;)
@@ -107,266 +312,610 @@ InterpretResult interpret(VM *vm, Chunk *chunk)
         {
 
         case OP_HALT:
+            close_scopes(frame);
+            drop_from(vm, frame->slots);
+            vm->frameCount--;
             return INTERPRET_OK;
 
         case OP_CONST_NUM:
-        {
-            Value constant = READ_CONSTANT(); // Membaca 2-byte index
-            push(vm, constant);
+            push(vm, READ_CONSTANT());
             break;
-        }
+
         case OP_CONST_STR:
-        {
-            Value constant = READ_CONSTANT(); // Membaca 2-byte index
-            push(vm, constant);
+            push(vm, copy_value(READ_CONSTANT()));
             break;
-        }
 
         case OP_NIL:
-            push(vm, (Value){VAL_NIL, {0}});
+            push(vm, NIL_VAL);
+            break;
+        case OP_TRUE:
+            push(vm, BOOL_VAL(true));
+            break;
+        case OP_FALSE:
+            push(vm, BOOL_VAL(false));
             break;
 
         case OP_POP:
-        {
-            pop(vm);
-            break;
-        }
-        case OP_DUP:
-        {
-            Value value = pop(vm);
-            push(vm, copy_value(value)); // Duplikasi
-            push(vm, value);
+            free_value(pop(vm));
             break;
-        }
 
         case OP_ADD:
-            BINARY_OP(+, +);
+            NUMBER_OP(TOKEN_PLUS, x + y);
             break;
         case OP_SUB:
-            BINARY_OP(-, -);
+            NUMBER_OP(TOKEN_MINUS, x - y);
             break;
         case OP_MUL:
-            BINARY_OP(*, *);
+            NUMBER_OP(TOKEN_STAR, x * y);
             break;
         case OP_DIV:
+            NUMBER_OP(TOKEN_SLASH, x / y);
+            break;
+        case OP_MOD:
+            NUMBER_OP(TOKEN_PERCENT, fmod(x, y));
+            break;
+
+        case OP_EQUAL:
+            COMPARE_OP(TOKEN_EQUAL_EQUAL, ==);
+            break;
+        case OP_NOT_EQUAL:
+            COMPARE_OP(TOKEN_BANG_EQUAL, !=);
+            break;
+        case OP_GREATER:
+            COMPARE_OP(TOKEN_GREATER, >);
+            break;
+        case OP_GREATER_EQUAL:
+            COMPARE_OP(TOKEN_GREATER_EQUAL, >=);
+            break;
+        case OP_LESS:
+            COMPARE_OP(TOKEN_LESS, <);
+            break;
+        case OP_LESS_EQUAL:
+            COMPARE_OP(TOKEN_LESS_EQUAL, <=);
+            break;
+
+        case OP_NOT:
         {
-            Value b = pop(vm);
-            Value a = pop(vm);
-            if (a.type != VAL_NUMBER || b.type != VAL_NUMBER)
-            {
-                runtimeError(vm, "Operands for '/' must be numbers.");
-                return INTERPRET_RUNTIME_ERROR;
-            }
-            if (b.as.number == 0)
-            {
-                runtimeError(vm, "Division by zero.");
-                return INTERPRET_RUNTIME_ERROR;
-            }
-            push(vm, (Value){VAL_NUMBER, {.number = a.as.number / b.as.number}});
+            Value val = pop(vm);
+            bool is_truthy = is_value_truthy(val);
+            free_value(val);
+            push(vm, NUMBER_VAL(is_truthy ? 0.0 : 1.0));
             break;
         }
 
         case OP_NEGATE:
         {
             Value val = pop(vm);
-            if (val.type != VAL_NUMBER)
+            if (!IS_NUMBER(val))
             {
-                runtimeError(vm, "Operand for negate must be a number.");
-                return INTERPRET_RUNTIME_ERROR;
+                print_error("Operand for '-' must be a number.");
+                free_value(val);
+                push(vm, NIL_VAL);
+                break;
             }
-            push(vm, (Value){VAL_NUMBER, {.number = -val.as.number}});
+            push(vm, NUMBER_VAL(-AS_NUMBER(val)));
             break;
         }
 
-        case OP_GREATER:
-            COMPARE_OP(>);
+        case OP_CAST:
+        {
+            const char *target_type = AS_STRING(READ_CONSTANT());
+            push(vm, eval_cast(pop(vm), target_type));
             break;
-        case OP_LESS:
-            COMPARE_OP(<);
+        }
+
+        case OP_GET_VAR:
+        {
+            Node *node = READ_NODE();
+            push_var(vm, find_resolved_var(frame->env, node), node);
             break;
+        }
 
-        case OP_EQUAL:
+        case OP_SET_VAR:
         {
-            Value b = pop(vm);
-            Value a = pop(vm);
-            Value result = eval_equals(a, b);
-            push(vm, result);
+            Node *node = READ_NODE();
+            push(vm, assign_ident(frame->env, node, pop(vm)));
             break;
         }
-        case OP_NOT:
+
+        case OP_DEF_VAR:
+        {
+            Node *node = READ_NODE();
+            free_value(declare_var(frame->env, node, pop(vm)));
+            break;
+        }
+
+        case OP_POST_INC:
+        case OP_POST_DEC:
+        {
+            Node *node = READ_NODE();
+            Var *v = find_resolved_var(frame->env, node);
+            if (v == NULL || !IS_NUMBER(v->value))
+            {
+                print_error(instruction == OP_POST_INC ? "Operand for '++' must be a number variable."
+                                                       : "Operand for '--' must be a number variable.");
+                push(vm, NIL_VAL);
+                break;
+            }
+            push(vm, v->value);
+            v->value = NUMBER_VAL(AS_NUMBER(v->value) + (instruction == OP_POST_INC ? 1 : -1));
+            break;
+        }
+
+        case OP_PUSH_SCOPE:
+            /* Like eval_node: scopes that no closure captures go on the
+               frame arena instead of the heap. */
+            frame->env = env_push(frame->env, READ_NODE());
+            break;
+
+        case OP_POP_SCOPE:
         {
+            Env *scope = frame->env;
+            frame->env = scope->outer;
+            env_free(scope);
+            break;
+        }
+
+        case OP_GET_LOCAL:
+            push(vm, copy_value(frame->slots[READ_BYTE()]));
+            break;
+
+        case OP_SET_LOCAL:
+        {
+            Value *slot = &frame->slots[READ_BYTE()];
             Value val = pop(vm);
-            bool is_truthy = is_value_truthy(val);
-            push(vm, (Value){VAL_NUMBER, {.number = is_truthy ? 0.0 : 1.0}});
+            free_value(*slot);
+            *slot = val;
+            push(vm, copy_value(val));
             break;
         }
 
-        case OP_PRINT:
+        case OP_DEF_LOCAL:
         {
-            Value val_to_print = pop(vm);
+            Value *slot = &frame->slots[READ_BYTE()];
+            free_value(*slot);
+            *slot = pop(vm);
+            break;
+        }
 
-            print_value(val_to_print);
+        case OP_POST_INC_LOCAL:
+        case OP_POST_DEC_LOCAL:
+        {
+            Value *slot = &frame->slots[READ_BYTE()];
+            if (!IS_NUMBER(*slot))
+            {
+                print_error(instruction == OP_POST_INC_LOCAL ? "Operand for '++' must be a number variable."
+                                                             : "Operand for '--' must be a number variable.");
+                push(vm, NIL_VAL);
+                break;
+            }
+            push(vm, *slot);
+            *slot = NUMBER_VAL(AS_NUMBER(*slot) + (instruction == OP_POST_INC_LOCAL ? 1 : -1));
+            break;
+        }
 
-            printf("\n");
-            fflush(stdout);
+        case OP_GET_OUTER:
+        {
+            Node *node = READ_NODE();
+            int depth = READ_BYTE();
+            push_var(vm, find_var_at(frame->env, node, depth == OUTER_BY_NAME ? -1 : depth), node);
+            break;
+        }
 
+        case OP_SET_OUTER:
+        {
+            Node *node = READ_NODE();
+            int depth = READ_BYTE();
+            Var *v = find_var_at(frame->env, node, depth == OUTER_BY_NAME ? -1 : depth);
+            push(vm, assign_to_var(v, node, pop(vm)));
             break;
         }
 
         case OP_JUMP:
         {
             uint16_t offset = READ_SHORT();
-            vm->ip += offset;
+            frame->ip += offset;
             break;
         }
 
         case OP_JUMP_IF_FALSE:
         {
             uint16_t offset = READ_SHORT();
-            Value condition = pop(vm);
-            if (!is_value_truthy(condition))
+            if (!is_value_truthy(peek(vm, 0)))
+                frame->ip += offset;
+            break;
+        }
+
+        case OP_JUMP_IF_TRUE:
+        {
+            uint16_t offset = READ_SHORT();
+            if (is_value_truthy(peek(vm, 0)))
+                frame->ip += offset;
+            break;
+        }
+
+        case OP_LOOP:
+        {
+            uint16_t offset = READ_SHORT();
+            frame->ip -= offset;
+            break;
+        }
+
+        case OP_ITER_INIT:
+        {
+            uint16_t offset = READ_SHORT();
+            if (!IS_ARRAY(peek(vm, 0)) && VALUE_TYPE(peek(vm, 0)) != VAL_CSV_CURSOR)
             {
-                vm->ip += offset;
+                free_value(pop(vm));
+                frame->ip += offset;
+                break;
             }
+            push(vm, NUMBER_VAL(0));
             break;
         }
 
+        case OP_ITER_NEXT:
+        {
+            Node *item = READ_NODE();
+            uint16_t offset = READ_SHORT();
+            Value next;
+            if (!iter_next(vm, &next))
+            {
+                frame->ip += offset;
+                break;
+            }
+            set_var(frame->env, item->name, next, false, "");
+            break;
+        }
 
-        default:
-            runtimeError(vm, "Unknown opcode: %d", instruction);
-            return INTERPRET_RUNTIME_ERROR;
+        case OP_ITER_NEXT_LOCAL:
+        {
+            Value *slot = &frame->slots[READ_BYTE()];
+            uint16_t offset = READ_SHORT();
+            Value next;
+            if (!iter_next(vm, &next))
+            {
+                frame->ip += offset;
+                break;
+            }
+            free_value(*slot);
+            *slot = copy_value(next);
+            break;
         }
-    }
-}
 
-static Value read_constant_from_binary(FILE *f)
-{
-    uint8_t type_byte;
-    if (fread(&type_byte, sizeof(uint8_t), 1, f) != 1)
-    {
-        fprintf(stderr, "Error reading constant type.\n");
-        return (Value){VAL_NIL, {0}};
-    }
+        case OP_CLOSURE:
+        {
+            FuncProto *proto = &frame->chunk->protos[READ_SHORT()];
+            Value func_val = make_function(frame->env, proto->decl);
+            if (IS_FUNCTION(func_val))
+                AS_FUNCTION(func_val)->chunk = proto->body;
+            push(vm, func_val);
+            break;
+        }
 
-    ValueType type = (ValueType)type_byte;
+        case OP_DEF_FUNC:
+        {
+            Node *node = READ_NODE();
+            Value func_val = pop(vm);
+            if (IS_FUNCTION(func_val))
+                set_var(frame->env, node->name, func_val, true, "");
+            free_value(func_val);
+            break;
+        }
 
-    switch (type)
-    {
-    case VAL_NUMBER:
-    {
-        double num;
-        if (fread(&num, sizeof(double), 1, f) != 1)
+        case OP_IS_MAIN:
         {
-            fprintf(stderr, "Error reading number constant.\n");
-            return (Value){VAL_NIL, {0}};
+            Var *name_var = find_var(frame->env, "__name__");
+            bool is_main = name_var && IS_STRING(name_var->value) &&
+                           strcmp(AS_STRING(name_var->value), "main") == 0;
+            push(vm, BOOL_VAL(is_main));
+            break;
         }
-        return (Value){VAL_NUMBER, {.number = num}};
-    }
-    case VAL_STRING:
-    {
-        int len;
-        if (fread(&len, sizeof(int), 1, f) != 1)
+
+        case OP_CALL:
         {
-            fprintf(stderr, "Error reading string length.\n");
-            return (Value){VAL_NIL, {0}};
+            int arg_count = READ_BYTE();
+            Node *call = READ_NODE();
+            Value callee = peek(vm, arg_count);
+            Value *args = vm->stackTop - arg_count;
+
+            /* @parallel and @async calls go through call_value, which hands them to the
+               task pool or the event loop. */
+            if (IS_FUNCTION(callee) && AS_FUNCTION(callee)->chunk && !AS_FUNCTION(callee)->is_parallel &&
+                !AS_FUNCTION(callee)->is_async && AS_FUNCTION(callee)->chunk->slot_count > 0 &&
+                fits_slots(AS_FUNCTION(callee)->chunk, arg_count, false))
+            {
+                if (!push_frame(vm, AS_FUNCTION(callee), AS_FUNCTION(callee)->env, FRAME_FUNCTION, NIL_VAL, arg_count))
+                    return INTERPRET_RUNTIME_ERROR;
+                frame = &vm->frames[vm->frameCount - 1];
+                break;
+            }
+
+            if (IS_FUNCTION(callee) && AS_FUNCTION(callee)->chunk && !AS_FUNCTION(callee)->is_parallel &&
+                !AS_FUNCTION(callee)->is_async && AS_FUNCTION(callee)->chunk->slot_count == 0)
+            {
+                Func *func = AS_FUNCTION(callee);
+                Env *call_env = env_new(func->env);
+                if (!bind_call_args(frame->env, call_env, func, arg_count, args))
+                {
+                    env_free(call_env);
+                    drop_from(vm, args - 1);
+                    push(vm, NIL_VAL);
+                    break;
+                }
+                if (!push_frame(vm, func, call_env, FRAME_FUNCTION, NIL_VAL, arg_count))
+                    return INTERPRET_RUNTIME_ERROR;
+                frame = &vm->frames[vm->frameCount - 1];
+                break;
+            }
+
+            if (IS_CLASS(callee))
+            {
+                Var *init = find_method(AS_CLASS(callee), "init");
+                if (init && AS_FUNCTION(init->value)->chunk)
+                {
+                    Func *func = AS_FUNCTION(init->value);
+                    Value instance = new_instance(callee, call->template_types, arg_count, args);
+                    Env *call_env = env_new(func->env);
+                    if (!bind_init_args(call_env, func, instance, arg_count, args))
+                    {
+                        env_free(call_env);
+                        drop_from(vm, args - 1);
+                        push(vm, NIL_VAL);
+                        break;
+                    }
+                    if (!push_frame(vm, func, call_env, FRAME_INIT, instance, arg_count))
+                        return INTERPRET_RUNTIME_ERROR;
+                    frame = &vm->frames[vm->frameCount - 1];
+                    break;
+                }
+            }
+
+            Value result = call_value(frame->env, callee, call->template_types, arg_count, args);
+            drop_from(vm, args - 1);
+            push(vm, result);
+            break;
         }
-        char *str = malloc(len + 1);
-        if (!str)
+
+        case OP_RETURN:
+        case OP_RETURN_END:
         {
-            fprintf(stderr, "Out of memory for string constant.\n");
-            return (Value){VAL_NIL, {0}};
+            Value result = pop(vm);
+            if (!return_from_frame(vm, result, instruction == OP_RETURN))
+                return INTERPRET_OK;
+            frame = &vm->frames[vm->frameCount - 1];
+            break;
         }
-        if (fread(str, 1, len, f) != (size_t)len)
+
+        case OP_CLASS:
         {
-            fprintf(stderr, "Error reading string content.\n");
-            free(str);
-            return (Value){VAL_NIL, {0}};
+            Node *node = READ_NODE();
+            uint16_t offset = READ_SHORT();
+            Class *klass = begin_class(frame->env, node);
+            if (!klass)
+            {
+                frame->ip += offset;
+                break;
+            }
+            push(vm, CLASS_VAL(klass));
+            break;
         }
-        str[len] = '\0';
-        return (Value){VAL_STRING, {.string = str}};
-    }
-    default:
-        fprintf(stderr, "Unknown value type in binary file: %d\n", type);
-        return (Value){VAL_NIL, {0}};
-    }
-}
 
-void run_binary(const char *path)
-{
-    FILE *f = fopen(path, "rb");
-    if (!f)
-    {
-        perror("Failed to open compiled file");
-        return;
-    }
+        case OP_METHOD:
+        {
+            FuncProto *proto = &frame->chunk->protos[READ_SHORT()];
+            Class *klass = AS_CLASS(peek(vm, 0));
+            Value method_val = make_function(klass->methods, proto->decl);
+            if (IS_FUNCTION(method_val))
+            {
+                AS_FUNCTION(method_val)->chunk = proto->body;
+                set_var(klass->methods, proto->decl->name, method_val, true, "");
+            }
+            free_value(method_val);
+            break;
+        }
 
-    Chunk chunk;
-    initChunk(&chunk);
-    bool success = false;
+        case OP_END_CLASS:
+        {
+            Node *node = READ_NODE();
+            Value klass = pop(vm);
+            end_class(frame->env, node, AS_CLASS(klass));
+            break;
+        }
 
-    // --- 1. Deserialize Code Array ---
-    int code_size;
-    if (fread(&code_size, sizeof(int), 1, f) != 1)
-    {
-        fprintf(stderr, "Error reading code size from binary file.\n");
-        goto cleanup;
-    }
+        case OP_GET_PROP:
+        {
+            Node *node = READ_NODE();
+            push(vm, get_property(pop(vm), node_key(node), &node->field_cache));
+            break;
+        }
 
-    if (code_size > 0)
-    {
-        chunk.code = malloc(code_size);
-        if (!chunk.code)
+        case OP_SET_PROP:
         {
-            fprintf(stderr, "Out of memory for bytecode.\n");
-            goto cleanup;
+            Node *node = READ_NODE();
+            Value val = pop(vm);
+            Value obj = pop(vm);
+            push(vm, set_property(obj, node_key(node), val, &node->field_cache));
+            break;
         }
-        if (fread(chunk.code, sizeof(uint8_t), code_size, f) != (size_t)code_size)
+
+        case OP_INVOKE:
         {
-            fprintf(stderr, "Error reading bytecode from binary file.\n");
-            free(chunk.code);
-            goto cleanup;
+            Node *node = READ_NODE();
+            const char *name = node->name;
+            int arg_count = READ_BYTE();
+            bool from_this = READ_BYTE();
+            Value receiver = peek(vm, arg_count);
+            Value *args = vm->stackTop - arg_count;
+            Value result;
+
+            if (IS_INSTANCE(receiver))
+            {
+                Func *method = lookup_method(receiver, name, from_this, &node->method_cache);
+                if (method && method->chunk && method->chunk->slot_count > 0 && fits_slots(method->chunk, arg_count, true))
+                {
+                    if (!push_frame(vm, method, method->env, FRAME_METHOD, receiver, arg_count))
+                        return INTERPRET_RUNTIME_ERROR;
+                    frame = &vm->frames[vm->frameCount - 1];
+                    break;
+                }
+                if (method && method->chunk && method->chunk->slot_count == 0)
+                {
+                    Env *call_env = env_new(method->env);
+                    bind_method_args(call_env, method, receiver, arg_count, args);
+                    if (!push_frame(vm, method, call_env, FRAME_METHOD, receiver, arg_count))
+                        return INTERPRET_RUNTIME_ERROR;
+                    frame = &vm->frames[vm->frameCount - 1];
+                    break;
+                }
+                result = method ? call_method(method, receiver, arg_count, args) : NIL_VAL;
+            }
+            else
+            {
+                result = invoke_method(frame->env, receiver, node_key(node), arg_count, args, from_this, &node->method_cache);
+            }
+
+            drop_from(vm, args - 1);
+            push(vm, result);
+            break;
         }
-        chunk.count = code_size;
-        chunk.capacity = code_size;
-    }
 
-    // --- 2. Deserialize Constant Pool ---
-    int constant_count;
-    if (fread(&constant_count, sizeof(int), 1, f) != 1)
-    {
-        fprintf(stderr, "Error reading constant count from binary file.\n");
-        goto cleanup;
-    }
+        case OP_ARRAY:
+        {
+            int count = READ_SHORT();
+            ValueArray *arr = array_new();
+            Value *items = vm->stackTop - count;
+            for (int i = 0; i < count; i++)
+            {
+                array_append(arr, items[i]);
+            }
+            vm->stackTop = items;
+            push(vm, ARRAY_VAL(arr));
+            break;
+        }
 
-    for (int i = 0; i < constant_count; i++)
-    {
-        Value constant = read_constant_from_binary(f);
-        if (constant.type == VAL_NIL && i < constant_count)
+        case OP_MAP:
         {
-            // Asumsi VAL_NIL hanya dikembalikan saat error membaca
-            goto cleanup;
+            Node *node = READ_NODE();
+            int count = 0;
+            for (Node *entry = node->left; entry; entry = entry->next)
+                count++;
+
+            HashMap *map = map_new();
+            Value *values = vm->stackTop - count;
+            Node *entry = node->left;
+            for (int i = 0; i < count; i++, entry = entry->next)
+            {
+                map_set_string(map, node_key(entry), values[i]);
+                free_value(values[i]);
+            }
+            vm->stackTop = values;
+            push(vm, MAP_VAL(map));
+            break;
         }
-        addConstant(&chunk, constant); // Tambahkan ke Chunk
-        free_value(constant);          // addConstant sudah menyalin nilainya, jadi bebaskan yang sementara
-    }
 
-    // --- 3. Execute VM ---
-    VM vm;
-    initVM(&vm);
+        case OP_INDEX_GET:
+        {
+            Value index = pop(vm);
+            Value container = pop(vm);
+            push(vm, index_get(container, index));
+            break;
+        }
 
-    InterpretResult result = interpret(&vm, &chunk);
+        case OP_INDEX_SET:
+        {
+            Value index = pop(vm);
+            Value container = pop(vm);
+            Value new_val = pop(vm);
+            push(vm, index_set(container, index, new_val));
+            break;
+        }
+
+        case OP_RANGE:
+        {
+            Value step = pop(vm);
+            Value end = pop(vm);
+            Value start = pop(vm);
+            push(vm, make_range(start, end, step));
+            break;
+        }
+
+        case OP_EVAL:
+        {
+            Node *node = READ_NODE();
+            Value result = eval_node(frame->env, node);
+
+            if (IS_RETURN(result))
+            {
+                Value ret = *AS_RETURN(result);
+                gc_free(AS_RETURN(result));
+                if (!return_from_frame(vm, ret, true))
+                    return INTERPRET_OK;
+                frame = &vm->frames[vm->frameCount - 1];
+                break;
+            }
+            if (VALUE_TYPE(result) == VAL_BREAK || VALUE_TYPE(result) == VAL_CONTINUE)
+            {
+                result = NIL_VAL;
+            }
+            push(vm, result);
+            break;
+        }
 
+        default:
+            runtimeError(vm, "Unknown opcode.");
+            return INTERPRET_RUNTIME_ERROR;
+        }
+    }
+}
+
+InterpretResult interpret(VM *vm, Chunk *chunk)
+{
+    CallFrame *frame = &vm->frames[vm->frameCount++];
+    frame->chunk = chunk;
+    frame->ip = chunk->code;
+    frame->env = vm->globalEnv;
+    frame->base_env = vm->globalEnv;
+    frame->func = NULL;
+    frame->receiver = NIL_VAL;
+    frame->slots = vm->stackTop;
+    frame->kind = FRAME_SCRIPT;
+    for (int i = 0; i < chunk->slot_count; i++)
+        push(vm, NIL_VAL);
+
+    InterpretResult result = run(vm);
     if (result != INTERPRET_OK)
     {
-        fprintf(stderr, "Jackal VM exited with an error during binary execution.\n");
+        while (vm->frameCount > 0)
+        {
+            CallFrame *top = &vm->frames[--vm->frameCount];
+            close_scopes(top);
+            if (top->kind != FRAME_SCRIPT)
+                release_call_env(top);
+        }
+        drop_from(vm, vm->stack);
     }
-    else
+    return result;
+}
+
+void run_binary(const char *path, Env *env)
+{
+    JloModule module;
+    if (!jlo_read(path, &module, 0, false))
+    {
+        fprintf(stderr, "Error: '%s' is not a valid .jlo file for this version of Jackal.\n", path);
+        return;
+    }
+
+    static VM vm;
+    initVM(&vm, env);
+    for (int i = 0; i < module.count; i++)
     {
-        success = true;
+        if (interpret(&vm, module.chunks[i]) != INTERPRET_OK)
+            break;
     }
+    freeVM(&vm);
 
-cleanup:
-    freeChunk(&chunk);
-    fclose(f);
-    // Note: freeVM tidak dipanggil di sini karena globalEnv dikelola di main
-}
\ No newline at end of file
+    /* The statements stay alive: functions defined by the chunks refer to them. */
+    jlo_free(&module);
+}
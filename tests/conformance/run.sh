@@ -0,0 +1,28 @@
+#!/bin/sh
+# Runs every conformance script with the tree-walking evaluator and with the
+# bytecode VM (--vm) and fails if the two outputs differ.
+# Run from the repository root so std/ is found: sh tests/conformance/run.sh
+
+JACKAL=${JACKAL:-./jackal}
+DIR=$(dirname "$0")
+failed=0
+total=0
+
+for script in "$DIR"/*.jackal; do
+    total=$((total + 1))
+    expected=$("$JACKAL" "$script" 2>&1)
+    actual=$("$JACKAL" --vm "$script" 2>&1)
+
+    if [ "$expected" = "$actual" ]; then
+        echo "ok    $(basename "$script")"
+    else
+        echo "FAIL  $(basename "$script")"
+        printf '%s\n' "$expected" > /tmp/jackal_conformance_eval.out
+        printf '%s\n' "$actual" > /tmp/jackal_conformance_vm.out
+        diff /tmp/jackal_conformance_eval.out /tmp/jackal_conformance_vm.out | head -20
+        failed=$((failed + 1))
+    fi
+done
+
+echo "$((total - failed))/$total scripts match"
+[ "$failed" -eq 0 ]
@@ -0,0 +1,29 @@
+#!/bin/sh
+# A module loaded from its .jlo cache must run like the source it was
+# compiled from. Calls a module function on a cold run, which writes the
+# cache, and on a cached run, and checks both allocate the same.
+
+JACKAL=$(cd "$(dirname "${JACKAL:-./jackal}")" && pwd)/$(basename "${JACKAL:-./jackal}")
+DIR=$(mktemp -d /tmp/jackal_jlo_cache.XXXXXX)
+trap 'rm -rf "$DIR"' EXIT
+
+cat > "$DIR/lib.jackal" <<'JACKAL'
+func work(n) {
+    let total = 0
+    for (let i = 0; i < n; i++) { total = total + i }
+    return total
+}
+JACKAL
+
+cat > "$DIR/main.jackal" <<'JACKAL'
+import lib;
+let before = __gc_stats()["allocations"]
+for (let i = 0; i < 10000; i++) { work(3) }
+println(__gc_stats()["allocations"] - before)
+JACKAL
+
+cold=$(cd "$DIR" && "$JACKAL" main.jackal 2>/dev/null | tail -n 1)
+[ -f "$DIR/lib.jlo" ] || { echo "no cache written"; exit 1; }
+cached=$(cd "$DIR" && "$JACKAL" main.jackal 2>/dev/null | tail -n 1)
+echo "allocations: cold $cold, cached $cached"
+[ -n "$cold" ] && [ "$cold" = "$cached" ] || { echo "the cached module allocates differently"; exit 1; }
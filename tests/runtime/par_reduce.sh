@@ -0,0 +1,15 @@
+#!/bin/sh
+# Runs par_reduce.jackal with one to eight workers: a non-identity initial
+# value must count once, whatever the number of chunks.
+
+JACKAL=${JACKAL:-./jackal}
+DIR=$(dirname "$0")
+
+for threads in 1 2 3 4 8; do
+    actual=$(JACKAL_THREADS=$threads "$JACKAL" "$DIR/par_reduce.jackal" 2>&1)
+    if [ "$actual" != "$(cat "$DIR/par_reduce.expected")" ]; then
+        echo "JACKAL_THREADS=$threads:"
+        printf '%s\n' "$actual"
+        exit 1
+    fi
+done
@@ -0,0 +1,41 @@
+#!/bin/sh
+# Runs the runtime tests. A .jackal script passes when its output matches
+# the .expected file next to it; a .sh script passes when it exits 0.
+# Run from the repository root so std/ is found: sh tests/runtime/run.sh
+
+JACKAL=${JACKAL:-./jackal}
+export JACKAL
+DIR=$(dirname "$0")
+failed=0
+total=0
+
+for script in "$DIR"/*.jackal; do
+    [ -e "$script" ] || continue
+    total=$((total + 1))
+    expected="${script%.jackal}.expected"
+    actual=$("$JACKAL" "$script" 2>&1)
+
+    if [ "$actual" = "$(cat "$expected")" ]; then
+        echo "ok    $(basename "$script")"
+    else
+        echo "FAIL  $(basename "$script")"
+        printf '%s\n' "$actual" > /tmp/jackal_runtime.out
+        diff "$expected" /tmp/jackal_runtime.out | head -20
+        failed=$((failed + 1))
+    fi
+done
+
+for script in "$DIR"/*.sh; do
+    [ "$(basename "$script")" = "run.sh" ] && continue
+    total=$((total + 1))
+    if output=$(sh "$script" 2>&1); then
+        echo "ok    $(basename "$script")"
+    else
+        echo "FAIL  $(basename "$script")"
+        printf '%s\n' "$output" | head -20
+        failed=$((failed + 1))
+    fi
+done
+
+echo "$((total - failed))/$total tests pass"
+[ "$failed" -eq 0 ]
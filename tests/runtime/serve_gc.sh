@@ -0,0 +1,39 @@
+#!/bin/sh
+# Handlers allocate on worker threads; the collector must still run while
+# __serve__ is up. Serves requests that each make 2000 strings and checks
+# gc.stats reports collections and a bounded heap.
+
+JACKAL=${JACKAL:-./jackal}
+PORT=${SERVE_GC_PORT:-18791}
+REQUESTS=300
+SCRIPT=$(mktemp /tmp/jackal_serve_gc.XXXXXX)
+
+cat > "$SCRIPT" <<JACKAL
+func handle(req) {
+    if (req["path"] == "/stats") { return __gc_stats() }
+    let parts = []
+    for (let i = 0; i < 2000; i++) { parts.push("item " + i.toString()) }
+    return {"count": parts.length()}
+}
+if (__listen__($PORT)) { __serve__(handle) }
+JACKAL
+
+"$JACKAL" "$SCRIPT" > /dev/null 2>&1 &
+server=$!
+trap 'kill $server 2>/dev/null; rm -f "$SCRIPT"' EXIT
+
+ready=0
+for _ in $(seq 1 50); do
+    curl -s "http://localhost:$PORT/stats" > /dev/null && { ready=1; break; }
+    sleep 0.1
+done
+[ "$ready" -eq 1 ] || { echo "server did not start"; exit 1; }
+
+seq 1 $REQUESTS | xargs -P 8 -I{} curl -s -o /dev/null "http://localhost:$PORT/work"
+stats=$(curl -s "http://localhost:$PORT/stats")
+echo "$stats"
+
+collections=$(printf '%s' "$stats" | sed -n 's/.*"collections":\([0-9]*\).*/\1/p')
+bytes=$(printf '%s' "$stats" | sed -n 's/.*"bytes":\([0-9]*\).*/\1/p')
+[ -n "$collections" ] && [ "$collections" -gt 0 ] || { echo "no collections while serving"; exit 1; }
+[ "$bytes" -lt 16000000 ] || { echo "live heap kept growing: $bytes bytes"; exit 1; }
@@ -0,0 +1,116 @@
+#!/bin/sh
+# Requests must be parsed however their bytes arrive. Sends a head split
+# across several writes, a chunked body split inside a chunk, two pipelined
+# requests, a body large enough to go to a temporary file, and requests
+# the parser must reject, then checks the responses. Last, floods pipelined
+# requests behind a slow one and checks the server stops reading instead of
+# buffering them all.
+
+JACKAL=${JACKAL:-./jackal}
+PORT=${SERVE_REQUESTS_PORT:-18793}
+SCRIPT=$(mktemp /tmp/jackal_serve_requests.XXXXXX)
+
+cat > "$SCRIPT" <<JACKAL
+func handle(req) {
+    if (req["path"] == "/slow") { __jackal_sleep(3000) }
+    if (req["path"] == "/size") { return {"size": __io_readAll(req["body"]).length()} }
+    return {"method": req["method"], "path": req["path"], "body": req["body"]}
+}
+if (__listen__($PORT)) { __serve__(handle) }
+JACKAL
+
+# The slow request holds a worker; the others need one of their own.
+JACKAL_THREADS=4 "$JACKAL" "$SCRIPT" > /dev/null 2>&1 &
+server=$!
+trap 'kill $server 2>/dev/null; rm -f "$SCRIPT"' EXIT
+
+ready=0
+for _ in $(seq 1 50); do
+    curl -s -o /dev/null "http://localhost:$PORT/" && { ready=1; break; }
+    sleep 0.1
+done
+[ "$ready" -eq 1 ] || { echo "server did not start"; exit 1; }
+
+python3 - "$PORT" "$server" <<'PYTHON'
+import socket, sys, time
+
+port = int(sys.argv[1])
+server = sys.argv[2]
+failed = False
+
+def send(name, pieces, expect):
+    global failed
+    s = socket.create_connection(("localhost", port), timeout=5)
+    for piece in pieces:
+        s.sendall(piece)
+        time.sleep(0.05)
+    s.shutdown(socket.SHUT_WR)
+    reply = b""
+    while True:
+        data = s.recv(65536)
+        if not data:
+            break
+        reply += data
+    s.close()
+    for want in expect:
+        if want not in reply:
+            print("%s: missing %r in %r" % (name, want, reply[:300]))
+            failed = True
+
+send("split head", [b"POST /sp", b"lit HTTP/1.1\r\nHost: x\r\nConn",
+                    b"ection: close\r\nContent-Le", b"ngth: 5\r\n\r", b"\nhel", b"lo"],
+     [b"200 OK", b'"path":"/split"', b'"body":"hello"'])
+
+send("chunked", [b"POST /chunked HTTP/1.1\r\nHost: x\r\nConnection: close\r\n"
+                 b"Transfer-Encoding: chunked\r\n\r\n4\r\nWi", b"ki\r\n5;ext=1\r\npedia\r\n",
+                 b"0\r\nX-Trailer: y\r\n\r\n"],
+     [b"200 OK", b'"body":"Wikipedia"'])
+
+send("pipelined", [b"GET /one HTTP/1.1\r\nHost: x\r\n\r\n"
+                   b"POST /two HTTP/1.1\r\nHost: x\r\nConnection: close\r\nContent-Length: 3\r\n\r\nabc"],
+     [b'"path":"/one"', b'"path":"/two"', b'"body":"abc"'])
+
+big = b"x" * (3 * 1024 * 1024)
+send("large body", [b"POST /size HTTP/1.1\r\nHost: x\r\nConnection: close\r\n"
+                    b"Content-Length: %d\r\n\r\n" % len(big), big[:5000], big[5000:]],
+     [b"200 OK", b'"size":%d' % len(big)])
+
+send("conflicting lengths", [b"POST /x HTTP/1.1\r\nHost: x\r\nContent-Length: 3\r\n"
+                             b"Content-Length: 4\r\n\r\nabcd"],
+     [b"400 "])
+
+send("length and chunked", [b"POST /x HTTP/1.1\r\nHost: x\r\nContent-Length: 3\r\n"
+                            b"Transfer-Encoding: chunked\r\n\r\n3\r\nabc\r\n0\r\n\r\n"],
+     [b"400 "])
+
+send("bad chunk size", [b"POST /x HTTP/1.1\r\nHost: x\r\nTransfer-Encoding: chunked\r\n\r\nzz\r\n"],
+     [b"400 "])
+
+def rss_mb():
+    with open("/proc/%s/status" % server) as status:
+        for line in status:
+            if line.startswith("VmRSS:"):
+                return int(line.split()[1]) // 1024
+    return 0
+
+s = socket.create_connection(("localhost", port), timeout=0.2)
+s.sendall(b"GET /slow HTTP/1.1\r\nHost: x\r\n\r\n")
+batch = b"GET / HTTP/1.1\r\nHost: x\r\n\r\n" * 2048
+sent = 0
+deadline = time.time() + 2
+while time.time() < deadline:
+    try:
+        sent += s.send(batch)
+    except socket.timeout:
+        pass
+rss = rss_mb()
+s.close()
+if sent > 64 * 1024 * 1024 or rss > 256:
+    print("pipelined flood: server took %d MB and grew to %d MB" % (sent >> 20, rss))
+    failed = True
+
+send("after flood", [b"GET /after HTTP/1.1\r\nHost: x\r\nConnection: close\r\n\r\n"],
+     [b"200 OK", b'"path":"/after"'])
+
+sys.exit(1 if failed else 0)
+PYTHON
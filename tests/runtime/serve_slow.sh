@@ -0,0 +1,48 @@
+#!/bin/sh
+# A handler parked in a long sleep must neither keep the collector from
+# running nor hold up other requests once a collection is due. Keeps one
+# 6 s request in flight while timing requests that each make 2000 strings.
+
+JACKAL=${JACKAL:-./jackal}
+PORT=${SERVE_SLOW_PORT:-18792}
+REQUESTS=100
+SCRIPT=$(mktemp /tmp/jackal_serve_slow.XXXXXX)
+TIMES=$(mktemp /tmp/jackal_serve_slow_times.XXXXXX)
+
+cat > "$SCRIPT" <<JACKAL
+func handle(req) {
+    if (req["path"] == "/stats") { return __gc_stats() }
+    if (req["path"] == "/slow") { __jackal_sleep(6000); return "slow" }
+    let parts = []
+    for (let i = 0; i < 2000; i++) { parts.push("item " + i.toString()) }
+    return {"count": parts.length()}
+}
+if (__listen__($PORT)) { __serve__(handle) }
+JACKAL
+
+# Enough workers that the sleeping handler does not take the only one.
+JACKAL_THREADS=4 "$JACKAL" "$SCRIPT" > /dev/null 2>&1 &
+server=$!
+trap 'kill $server 2>/dev/null; rm -f "$SCRIPT" "$TIMES"' EXIT
+
+ready=0
+for _ in $(seq 1 50); do
+    curl -s "http://localhost:$PORT/stats" > /dev/null && { ready=1; break; }
+    sleep 0.1
+done
+[ "$ready" -eq 1 ] || { echo "server did not start"; exit 1; }
+
+before=$(curl -s "http://localhost:$PORT/stats" | sed -n 's/.*"collections":\([0-9]*\).*/\1/p')
+curl -s -o /dev/null "http://localhost:$PORT/slow" &
+slow=$!
+sleep 0.2
+
+seq 1 $REQUESTS | xargs -P 4 -I{} curl -s -o /dev/null -w '%{time_total}\n' "http://localhost:$PORT/work" > "$TIMES"
+after=$(curl -s "http://localhost:$PORT/stats" | sed -n 's/.*"collections":\([0-9]*\).*/\1/p')
+kill -0 $slow 2>/dev/null || { echo "the slow request finished too early to test anything"; exit 1; }
+wait $slow
+
+worst=$(sort -n "$TIMES" | tail -1)
+echo "collections while the slow request ran: $((after - before)), slowest other request: ${worst}s"
+[ "$after" -gt "$before" ] || { echo "no collection while a handler slept"; exit 1; }
+awk -v t="$worst" 'BEGIN { exit !(t < 1.0) }' || { echo "requests stalled behind the sleeping handler"; exit 1; }